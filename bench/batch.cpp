@@ -0,0 +1,252 @@
+/*
+ *		Check and benchmark of the batch prediction of multi-class models.
+ *
+ * Copyright (c) 2008,2009 Naoaki Okazaki
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the names of the authors nor the names of its contributors
+ *       may be used to endorse or promote products derived from this
+ *       software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* $Id$ */
+
+/*
+This program checks that the batch prediction of multi-class models
+(multi_scores(), multi_probs(), and multi_argmax() in batch.h) computes the
+same scores, probabilities, and labels as the classifier objects
+(linear_multi_logistic) on synthetic data sets:
+
+    classias-bench-batch [LABELS [ATTRIBUTES [INSTANCES]]]
+
+The data sets cover the dense and sparse feature generators, the explicit
+and implicit (all 1) attribute values, and the models of weights in double
+and single precision. The program reports the time of each computation and
+the maximum differences, and exits with a non-zero status if the results of
+a batch function differ from those of the classifier, so that it also runs
+as a check of "make check".
+*/
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <ctime>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <classias/classias.h>
+#include <classias/classify/linear/multi.h>
+#include <classias/classify/linear/batch.h>
+
+// A linear congruential generator, so that the data sets do not depend on
+// the implementation of rand().
+static unsigned int rng_state = 12345;
+static double uniform()
+{
+    rng_state = rng_state * 1103515245 + 12345;
+    return ((rng_state >> 8) & 0xFFFFFF) / (double)0x1000000;
+}
+
+static std::string to_string(int i)
+{
+    std::ostringstream ss;
+    ss << i;
+    return ss.str();
+}
+
+template <class data_type>
+static void generate_data(data_type& data, int L, int A, int N, bool implicit)
+{
+    for (int l = 0;l < L;++l) {
+        data.labels(to_string(l));
+    }
+    for (int a = 0;a < A;++a) {
+        data.attributes(to_string(a));
+    }
+
+    // Each label prefers a few attributes; the rest are noise.
+    for (int i = 0;i < N;++i) {
+        typename data_type::instance_type& inst = data.new_element();
+        int l = (int)(uniform() * L);
+        inst.set_label(l);
+        for (int k = 0;k < 4;++k) {
+            inst.append((l * 7 + k) % A, implicit ? 1. : uniform());
+        }
+        for (int k = 0;k < 8;++k) {
+            inst.append((int)(uniform() * A), implicit ? 1. : uniform());
+        }
+    }
+
+    data.generate_features();
+}
+
+/**
+ * The CSR arrays of a data set, on which the blocks are built.
+ */
+struct csr_instances
+{
+    std::vector<size_t> offsets;
+    std::vector<int> ids;
+    std::vector<double> values;
+
+    template <class data_type>
+    csr_instances(const data_type& data)
+    {
+        offsets.push_back(0);
+        typename data_type::const_iterator it;
+        for (it = data.begin();it != data.end();++it) {
+            typename data_type::instance_type::const_iterator e;
+            for (e = it->begin();e != it->end();++e) {
+                ids.push_back(e->first);
+                values.push_back(e->second);
+            }
+            offsets.push_back(ids.size());
+        }
+    }
+};
+
+static double difference(double x, double y)
+{
+    return std::fabs(x - y) / (1. + std::fabs(y));
+}
+
+/**
+ * Compares the batch functions with linear_multi_logistic on a data set.
+ *  @return bool        \c true if the results agree.
+ */
+template <class data_type, class model_type>
+static bool check(
+    std::ostream& os,
+    const std::string& name,
+    const data_type& data,
+    const model_type& model,
+    bool implicit,
+    bool fast_exp
+    )
+{
+    typedef classias::classify::linear_multi_logistic<model_type> classifier_type;
+    const size_t n = data.size();
+    const int L = data.num_labels();
+    csr_instances arrays(data);
+    classias::classify::csr_block block(
+        n, &arrays.offsets[0], &arrays.ids[0],
+        implicit ? NULL : &arrays.values[0]);
+
+    // Score the instances with the batch functions.
+    std::vector<double> scores(n * L), probs(n * L);
+    std::vector<int> argmax(n);
+    clock_t begin = std::clock();
+    classias::classify::multi_scores(
+        model, data.feature_generator, block, L, &scores[0]);
+    classias::classify::multi_argmax(n, L, &scores[0], &argmax[0]);
+    double batch = (std::clock() - begin) / (double)CLOCKS_PER_SEC;
+    classias::classify::multi_probs(
+        model, data.feature_generator, block, L, &probs[0], fast_exp);
+
+    // Score the instances with the classifier one by one.
+    std::vector<double> ref_scores(n * L), ref_probs(n * L);
+    std::vector<int> ref_argmax(n);
+    classifier_type cls(model);
+    cls.set_fast_exp(fast_exp);
+    begin = std::clock();
+    for (size_t i = 0;i < n;++i) {
+        cls.inner_product_instance(data.feature_generator, data[i], L);
+        cls.finalize();
+        ref_argmax[i] = cls.argmax();
+        for (int l = 0;l < L;++l) {
+            ref_scores[i * L + l] = cls.score(l);
+        }
+    }
+    double single = (std::clock() - begin) / (double)CLOCKS_PER_SEC;
+    for (size_t i = 0;i < n;++i) {
+        cls.inner_product_instance(data.feature_generator, data[i], L);
+        cls.finalize();
+        for (int l = 0;l < L;++l) {
+            ref_probs[i * L + l] = cls.prob(l);
+        }
+    }
+
+    double score_diff = 0., prob_diff = 0.;
+    int mismatches = 0;
+    for (size_t i = 0;i < n;++i) {
+        for (int l = 0;l < L;++l) {
+            const size_t k = i * L + l;
+            score_diff = std::max(score_diff, difference(scores[k], ref_scores[k]));
+            prob_diff = std::max(prob_diff, difference(probs[k], ref_probs[k]));
+        }
+        if (argmax[i] != ref_argmax[i]) {
+            ++mismatches;
+        }
+    }
+
+    const bool ok = (score_diff < 1e-9 && prob_diff < 1e-9 && mismatches == 0);
+    os << name << (implicit ? ", implicit values" : "") <<
+        (fast_exp ? ", fast soft-max" : "") << ": " <<
+        (ok ? "OK" : "FAILED") << std::endl;
+    os << "  batch: " << batch << " sec, linear_multi: " << single <<
+        " sec" << std::endl;
+    os << "  max difference of scores: " << score_diff <<
+        ", of probabilities: " << prob_diff <<
+        ", labels mismatched: " << mismatches << std::endl;
+    return ok;
+}
+
+template <class data_type>
+static bool check_data(std::ostream& os, const std::string& name, int L, int A, int N)
+{
+    bool ok = true;
+    for (int implicit = 0;implicit < 2;++implicit) {
+        data_type data;
+        generate_data(data, L, A, N, implicit == 1);
+
+        classias::weight_vector w(data.num_features());
+        for (size_t f = 0;f < w.size();++f) {
+            w[f] = 2. * uniform() - 1.;
+        }
+        classias::float_weight_vector fw;
+        fw.assign(w.begin(), w.end());
+
+        ok &= check(os, name, data, w, implicit == 1, false);
+        ok &= check(os, name, data, w, implicit == 1, true);
+        ok &= check(os, name + " (float weights)", data, fw, implicit == 1, false);
+    }
+    return ok;
+}
+
+int main(int argc, char *argv[])
+{
+    const int L = (1 < argc ? std::atoi(argv[1]) : 50);
+    const int A = (2 < argc ? std::atoi(argv[2]) : 2000);
+    const int N = (3 < argc ? std::atoi(argv[3]) : 2000);
+    std::ostream& os = std::cout;
+
+    os << "Instruction set: " << classias::simd::isa_name() << std::endl;
+    os << N << " instances, " << L << " labels, " << A << " attributes" <<
+        std::endl;
+
+    bool ok = true;
+    ok &= check_data<classias::msdata>(os, "dense features", L, A, N);
+    ok &= check_data<classias::nsdata>(os, "sparse features", L, A, N);
+    return (ok ? 0 : 1);
+}
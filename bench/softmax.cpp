@@ -0,0 +1,197 @@
+/*
+ *		Benchmark of the soft-max computation in multi-class training.
+ *
+ * Copyright (c) 2008,2009 Naoaki Okazaki
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the names of the authors nor the names of its contributors
+ *       may be used to endorse or promote products derived from this
+ *       software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* $Id$ */
+
+/*
+This program compares the exact and fast modes of computing soft-max
+probabilities (the parameter "softmax" of L-BFGS) on a synthetic multi-class
+data set:
+
+    classias-bench-softmax [LABELS [ATTRIBUTES [INSTANCES [ITERATIONS]]]]
+
+It reports the time of finalize() of the classifier for each mode, and the
+training time and the final training loss of L-BFGS for each mode. The loss
+is measured with the exact mode for both models, so that the difference in
+the loss shows the effect of the approximation on the training.
+*/
+
+#include <cmath>
+#include <cstdlib>
+#include <ctime>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <classias/classias.h>
+#include <classias/classify/linear/multi.h>
+#include <classias/train/lbfgs.h>
+
+typedef classias::train::lbfgs_logistic_multi<classias::msdata> trainer_type;
+typedef classias::classify::linear_multi_logistic<classias::weight_vector>
+    classifier_type;
+
+// A linear congruential generator, so that the data set does not depend on
+// the implementation of rand().
+static unsigned int rng_state = 12345;
+static double uniform()
+{
+    rng_state = rng_state * 1103515245 + 12345;
+    return ((rng_state >> 8) & 0xFFFFFF) / (double)0x1000000;
+}
+
+static std::string to_string(int i)
+{
+    std::ostringstream ss;
+    ss << i;
+    return ss.str();
+}
+
+static void generate_data(classias::msdata& data, int L, int A, int N)
+{
+    for (int l = 0;l < L;++l) {
+        data.labels(to_string(l));
+    }
+    for (int a = 0;a < A;++a) {
+        data.attributes(to_string(a));
+    }
+
+    // Each label prefers a few attributes; the rest are noise.
+    for (int i = 0;i < N;++i) {
+        classias::minstance& inst = data.new_element();
+        int l = (int)(uniform() * L);
+        inst.set_label(l);
+        for (int k = 0;k < 4;++k) {
+            inst.append((l * 7 + k) % A, 1.0);
+        }
+        for (int k = 0;k < 8;++k) {
+            inst.append((int)(uniform() * A), uniform());
+        }
+    }
+
+    data.generate_features();
+}
+
+static double loss(const classias::msdata& data, const classias::weight_vector& w)
+{
+    double sum = 0.;
+    classifier_type cls(w);
+    for (classias::msdata::const_iterator it = data.begin();it != data.end();++it) {
+        cls.inner_product_instance(data.feature_generator, *it, data.num_labels());
+        cls.finalize();
+        sum -= cls.logprob(it->get_label());
+    }
+    return sum;
+}
+
+static void bench_finalize(std::ostream& os, int L)
+{
+    const int R = 20000000 / (L + 1) + 1;
+    classias::weight_vector w(L, 0.);
+    for (int l = 0;l < L;++l) {
+        w[l] = 10. * uniform() - 5.;
+    }
+    classias::sparse_attributes v;
+    v.append(0, 1.0);
+
+    classias::dense_feature_generator fgen;
+    fgen.set_num_attributes(1);
+    fgen.set_num_labels(L);
+
+    std::vector<double> probs[2];
+    double elapsed[2];
+    for (int mode = 0;mode < 2;++mode) {
+        classifier_type cls(w);
+        cls.set_fast_exp(mode == 1);
+        cls.inner_product_labels(fgen, v.begin(), v.end(), L);
+
+        clock_t begin = std::clock();
+        for (int r = 0;r < R;++r) {
+            cls.finalize();
+        }
+        elapsed[mode] = (std::clock() - begin) / (double)CLOCKS_PER_SEC;
+
+        for (int l = 0;l < L;++l) {
+            probs[mode].push_back(cls.prob(l));
+        }
+    }
+
+    double maxerr = 0.;
+    for (int l = 0;l < L;++l) {
+        double err = std::fabs(probs[1][l] - probs[0][l]) / probs[0][l];
+        maxerr = (maxerr < err ? err : maxerr);
+    }
+
+    os << "Instruction set: " << classias::simd::isa_name() << std::endl;
+    os << "finalize() x " << R << " (" << L << " labels)" << std::endl;
+    os << "  exact: " << elapsed[0] << " sec" << std::endl;
+    os << "  fast: " << elapsed[1] << " sec" << std::endl;
+    os << "  max relative error of probabilities: " << maxerr << std::endl;
+}
+
+int main(int argc, char *argv[])
+{
+    const int L = (1 < argc ? std::atoi(argv[1]) : 1000);
+    const int A = (2 < argc ? std::atoi(argv[2]) : 5000);
+    const int N = (3 < argc ? std::atoi(argv[3]) : 5000);
+    const int T = (4 < argc ? std::atoi(argv[4]) : 30);
+    std::ostream& os = std::cout;
+
+    bench_finalize(os, L);
+    os << std::endl;
+
+    classias::msdata data;
+    generate_data(data, L, A, N);
+    os << "Training: " << N << " instances, " << L << " labels, " <<
+        A << " attributes, " << T << " iterations" << std::endl;
+
+    static const char *modes[] = {"exact", "fast"};
+    double losses[2];
+    for (int mode = 0;mode < 2;++mode) {
+        trainer_type tr;
+        tr.params().set("max_iterations", T);
+        tr.params().set("softmax", std::string(modes[mode]));
+
+        std::ostringstream log;
+        clock_t begin = std::clock();
+        tr.train(data, log);
+        double elapsed = (std::clock() - begin) / (double)CLOCKS_PER_SEC;
+
+        losses[mode] = loss(data, tr.model());
+        os << "  " << modes[mode] << ": " << elapsed << " sec, loss " <<
+            std::setprecision(12) << losses[mode] << std::setprecision(6) <<
+            std::endl;
+    }
+    os << "  difference in loss: " << (losses[1] - losses[0]) << std::endl;
+
+    return 0;
+}
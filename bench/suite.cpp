@@ -0,0 +1,685 @@
+/*
+ *		Benchmark suite of ingestion, scoring, training, and tagging.
+ *
+ * Copyright (c) 2008,2009 Naoaki Okazaki
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the names of the authors nor the names of its contributors
+ *       may be used to endorse or promote products derived from this
+ *       software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* $Id$ */
+
+/*
+This program measures the throughput of the main stages of Classias on
+synthetic data sets, and writes the results in JSON so that the numbers of
+two releases (or two builds) can be compared by a script:
+
+    classias-bench [OPTIONS]
+
+    -n INSTANCES    the number of instances (default: 20000)
+    -a ATTRIBUTES   the number of distinct attributes (default: 100000)
+    -k ATTRIBUTES   the number of attributes per instance (default: 20)
+    -l LABELS       the number of labels of the multi-class data (default: 20)
+    -v RATIO        the ratio of attribute values other than 1 (default: 0.5);
+                    0 makes every attribute binary
+    -r REPEATS      the number of repetitions of each benchmark; the fastest
+                    one is reported (default: 3)
+    -s SEED         the seed of the data generator (default: 12345)
+    -t PROGRAM      the path to classias-tag for measuring the tagging
+                    throughput (default: ../frontend/tag/classias-tag)
+    -w PREFIX       the prefix of temporary files (default: classias-bench)
+    -o FILE         the output file of the results (default: stdout)
+
+The benchmarks are:
+
+    parse_line                      tokenizing lines of training data
+    quark.intern                    assigning identifiers to attribute names
+    linear_binary.inner_product     scoring binary instances
+    linear_multi.inner_product      scoring multi-class instances for all labels
+    linear_multi_logistic.finalize  soft-max probabilities of the labels
+    lbfgs.*.loss_and_gradient       one evaluation of the L-BFGS objective
+    *.epoch                         one epoch of an online training algorithm
+    classias-tag.*                  tagging the data with a model file
+
+Every result reports the number of items processed (lines, names, or
+instances), the elapsed (wall-clock) time, and the items per second.
+*/
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#if defined(_MSC_VER)
+#include <windows.h>
+#else
+#include <sys/time.h>
+#endif
+
+#include <classias/classias.h>
+#include <classias/version.h>
+#include <classias/classify/linear/binary.h>
+#include <classias/classify/linear/multi.h>
+#include <classias/train/lbfgs.h>
+#include <classias/train/averaged_perceptron.h>
+#include <classias/train/pegasos.h>
+#include <classias/train/truncated_gradient.h>
+#include <classias/train/online_scheduler.h>
+
+#include "option.h"
+#include "ingest.h"
+
+typedef std::vector<std::string> lines_type;
+
+/**
+ * A result of a benchmark.
+ */
+struct result
+{
+    std::string name;
+    double items;
+    double seconds;
+};
+
+typedef std::vector<result> results_type;
+
+/**
+ * The configuration of the benchmarks.
+ */
+struct config
+{
+    int instances;
+    int attributes;
+    int per_instance;
+    int labels;
+    double value_ratio;
+    int repeats;
+    unsigned int seed;
+    std::string tag;
+    std::string prefix;
+    std::string output;
+
+    config() :
+        instances(20000), attributes(100000), per_instance(20), labels(20),
+        value_ratio(0.5), repeats(3), seed(12345),
+        tag("../frontend/tag/classias-tag"), prefix("classias-bench"),
+        output("")
+    {
+    }
+};
+
+// A linear congruential generator, so that the data set does not depend on
+// the implementation of rand().
+static unsigned int rng_state = 12345;
+static double uniform()
+{
+    rng_state = rng_state * 1103515245 + 12345;
+    return ((rng_state >> 8) & 0xFFFFFF) / (double)0x1000000;
+}
+
+// Results of the computations are stored here so that the compiler does not
+// remove the computations.
+static volatile double sink;
+
+static double now()
+{
+#if defined(_MSC_VER)
+    return GetTickCount() * 1e-3;
+#else
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec * 1e-6;
+#endif
+}
+
+/**
+ * Generates the lines of a data set.
+ *  Attributes are drawn from a Zipf-like distribution so that some names
+ *  are frequent as in natural-language data; a label prefers a few
+ *  attributes so that the training has something to learn.
+ *  @param  lines       The lines generated.
+ *  @param  cfg         The configuration.
+ *  @param  L           The number of labels; 0 generates binary data.
+ */
+static void generate_lines(lines_type& lines, const config& cfg, int L)
+{
+    lines.clear();
+    for (int i = 0;i < cfg.instances;++i) {
+        std::ostringstream os;
+        int l;
+        if (L == 0) {
+            l = (uniform() < 0.5 ? 1 : 0);
+            os << (l ? "+1" : "-1");
+        } else {
+            l = (int)(uniform() * L);
+            os << 'L' << l;
+        }
+
+        for (int k = 0;k < cfg.per_instance;++k) {
+            int a;
+            if (k < 2) {
+                a = (l * 7 + k) % cfg.attributes;
+            } else {
+                a = (int)(std::pow((double)cfg.attributes, uniform())) - 1;
+            }
+            os << ' ' << 'f' << a;
+            if (uniform() < cfg.value_ratio) {
+                os << ':' << std::setprecision(4) << uniform();
+            }
+        }
+        lines.push_back(os.str());
+    }
+}
+
+/**
+ * Stores parsed lines to a binary data set.
+ */
+static void store_lines(classias::bsdata& data, const lines_type& lines, const option& opt)
+{
+    parsed_line p;
+    attribute_filter filter;
+    for (size_t i = 0;i < lines.size();++i) {
+        p.line = lines[i];
+        p.lines = (int)i + 1;
+        parse_line(p, opt, filter);
+
+        classias::binstance& inst = data.new_element();
+        inst.set_label(p.label == "+1");
+        parsed_line::fields_type::const_iterator it;
+        for (it = p.fields.begin();it != p.fields.end();++it) {
+            inst.append((int)data.attributes(it->first), it->second);
+        }
+    }
+}
+
+/**
+ * Stores parsed lines to a multi-class data set.
+ */
+static void store_lines(classias::msdata& data, const lines_type& lines, const option& opt)
+{
+    parsed_line p;
+    attribute_filter filter;
+    for (size_t i = 0;i < lines.size();++i) {
+        p.line = lines[i];
+        p.lines = (int)i + 1;
+        parse_line(p, opt, filter);
+
+        classias::minstance& inst = data.new_element();
+        inst.set_label((int)data.labels(p.label));
+        parsed_line::fields_type::const_iterator it;
+        for (it = p.fields.begin();it != p.fields.end();++it) {
+            inst.append((int)data.attributes(it->first), it->second);
+        }
+    }
+    data.generate_features();
+}
+
+static void random_weights(classias::weight_vector& w, size_t K)
+{
+    w.resize(K);
+    for (size_t k = 0;k < K;++k) {
+        w[k] = 2. * uniform() - 1.;
+    }
+}
+
+static void report(results_type& results, const std::string& name, double items, double seconds)
+{
+    result r;
+    r.name = name;
+    r.items = items;
+    r.seconds = seconds;
+    results.push_back(r);
+    std::cerr << name << ": " << seconds << " sec" << std::endl;
+}
+
+/**
+ * The benchmark of parse_line().
+ */
+static void bench_parse(results_type& results, const config& cfg, const lines_type& lines)
+{
+    option opt;
+    opt.type = option::TYPE_BINARY;
+
+    double best = -1.;
+    for (int r = 0;r < cfg.repeats;++r) {
+        parsed_line p;
+        attribute_filter filter;
+        double begin = now();
+        for (size_t i = 0;i < lines.size();++i) {
+            p.line = lines[i];
+            p.lines = (int)i + 1;
+            parse_line(p, opt, filter);
+        }
+        double elapsed = now() - begin;
+        best = (best < 0. || elapsed < best) ? elapsed : best;
+    }
+    report(results, "parse_line", (double)lines.size(), best);
+}
+
+/**
+ * The benchmark of interning attribute names.
+ */
+static void bench_quark(results_type& results, const config& cfg, const lines_type& lines)
+{
+    option opt;
+    opt.type = option::TYPE_BINARY;
+
+    // Parse the lines in advance.
+    std::vector<std::string> names;
+    parsed_line p;
+    attribute_filter filter;
+    for (size_t i = 0;i < lines.size();++i) {
+        p.line = lines[i];
+        parse_line(p, opt, filter);
+        for (size_t j = 0;j < p.fields.size();++j) {
+            names.push_back(p.fields[j].first);
+        }
+    }
+
+    double best = -1.;
+    for (int r = 0;r < cfg.repeats;++r) {
+        classias::quark q;
+        double begin = now();
+        for (size_t i = 0;i < names.size();++i) {
+            q(names[i]);
+        }
+        double elapsed = now() - begin;
+        best = (best < 0. || elapsed < best) ? elapsed : best;
+    }
+    report(results, "quark.intern", (double)names.size(), best);
+}
+
+/**
+ * The benchmark of scoring binary instances.
+ */
+static void bench_binary_scoring(results_type& results, const config& cfg, const classias::bsdata& data)
+{
+    classias::weight_vector w;
+    random_weights(w, data.num_features());
+    classias::classify::linear_binary<classias::weight_vector> cls(w);
+
+    double best = -1.;
+    for (int r = 0;r < cfg.repeats;++r) {
+        double begin = now();
+        for (classias::bsdata::const_iterator it = data.begin();it != data.end();++it) {
+            cls.inner_product(it->begin(), it->end());
+            sink = cls.score();
+        }
+        double elapsed = now() - begin;
+        best = (best < 0. || elapsed < best) ? elapsed : best;
+    }
+    report(results, "linear_binary.inner_product", (double)data.size(), best);
+}
+
+/**
+ * The benchmarks of scoring multi-class instances and of soft-max.
+ */
+static void bench_multi_scoring(results_type& results, const config& cfg, const classias::msdata& data)
+{
+    typedef classias::classify::linear_multi_logistic<classias::weight_vector> classifier_type;
+    const int L = data.num_labels();
+    classias::weight_vector w;
+    random_weights(w, data.num_features());
+    classifier_type cls(w);
+
+    double best = -1.;
+    for (int r = 0;r < cfg.repeats;++r) {
+        double begin = now();
+        for (classias::msdata::const_iterator it = data.begin();it != data.end();++it) {
+            cls.inner_product_instance(data.feature_generator, *it, L);
+            sink = cls.score(0);
+        }
+        double elapsed = now() - begin;
+        best = (best < 0. || elapsed < best) ? elapsed : best;
+    }
+    report(results, "linear_multi.inner_product", (double)data.size(), best);
+
+    // The scores of the last instance are reused for every call.
+    best = -1.;
+    for (int r = 0;r < cfg.repeats;++r) {
+        double begin = now();
+        for (size_t i = 0;i < data.size();++i) {
+            cls.finalize();
+            sink = cls.prob(0);
+        }
+        double elapsed = now() - begin;
+        best = (best < 0. || elapsed < best) ? elapsed : best;
+    }
+    report(results, "linear_multi_logistic.finalize", (double)data.size(), best);
+}
+
+/**
+ * A trainer exposing one evaluation of the loss and gradients.
+ */
+template <class data_type>
+class binary_objective : public classias::train::lbfgs_logistic_binary<data_type>
+{
+public:
+    double evaluate(const data_type& data, std::vector<double>& g)
+    {
+        const int K = (int)data.num_features();
+        this->m_data = &data;
+        this->initialize_weights(K);
+        g.resize(K);
+        return this->loss_and_gradient(&this->m_w[0], &g[0], K);
+    }
+};
+
+template <class data_type>
+class multi_objective : public classias::train::lbfgs_logistic_multi<data_type>
+{
+public:
+    double evaluate(const data_type& data, std::vector<double>& g)
+    {
+        const int K = (int)data.num_features();
+        this->m_data = &data;
+        this->initialize_weights(K);
+        delete[] this->m_oexps;
+        this->m_oexps = new double[K];
+        for (int k = 0;k < K;++k) {
+            this->m_oexps[k] = 0.;
+        }
+        g.resize(K);
+        return this->loss_and_gradient(&this->m_w[0], &g[0], K);
+    }
+};
+
+template <class objective_type, class data_type>
+static void bench_objective(results_type& results, const config& cfg, const data_type& data, const std::string& name)
+{
+    std::vector<double> g;
+    double best = -1.;
+    for (int r = 0;r < cfg.repeats;++r) {
+        objective_type obj;
+        double begin = now();
+        obj.evaluate(data, g);
+        double elapsed = now() - begin;
+        best = (best < 0. || elapsed < best) ? elapsed : best;
+    }
+    report(results, name, (double)data.size(), best);
+}
+
+/**
+ * The benchmark of one epoch of an online training algorithm.
+ */
+template <class trainer_type, class data_type>
+static void bench_epoch(results_type& results, const config& cfg, const data_type& data, const std::string& name)
+{
+    double best = -1.;
+    for (int r = 0;r < cfg.repeats;++r) {
+        trainer_type tr;
+        tr.params().set("max_iterations", 1);
+        tr.params().set("sample", std::string("cycle"));
+
+        std::ostringstream log;
+        double begin = now();
+        tr.train(data, log);
+        double elapsed = now() - begin;
+        best = (best < 0. || elapsed < best) ? elapsed : best;
+    }
+    report(results, name, (double)data.size(), best);
+}
+
+static void bench_training(results_type& results, const config& cfg, const classias::bsdata& bdata, const classias::msdata& mdata)
+{
+    typedef classias::weight_vector W;
+    namespace ct = classias::train;
+    namespace cc = classias::classify;
+    typedef classias::bsdata B;
+    typedef classias::msdata M;
+
+    bench_objective<binary_objective<B> >(results, cfg, bdata, "lbfgs.binary.loss_and_gradient");
+    bench_objective<multi_objective<M> >(results, cfg, mdata, "lbfgs.multi.loss_and_gradient");
+
+    bench_epoch<ct::online_scheduler_binary<B, ct::averaged_perceptron_binary<cc::linear_binary<W> > > >(
+        results, cfg, bdata, "averaged_perceptron.binary.epoch");
+    bench_epoch<ct::online_scheduler_binary<B, ct::pegasos_binary<cc::linear_binary_logistic<W> > > >(
+        results, cfg, bdata, "pegasos.logistic.binary.epoch");
+    bench_epoch<ct::online_scheduler_binary<B, ct::pegasos_binary<cc::linear_binary_hinge<W> > > >(
+        results, cfg, bdata, "pegasos.hinge.binary.epoch");
+    bench_epoch<ct::online_scheduler_binary<B, ct::truncated_gradient_binary<cc::linear_binary_logistic<W> > > >(
+        results, cfg, bdata, "truncated_gradient.logistic.binary.epoch");
+    bench_epoch<ct::online_scheduler_binary<B, ct::truncated_gradient_binary<cc::linear_binary_hinge<W> > > >(
+        results, cfg, bdata, "truncated_gradient.hinge.binary.epoch");
+
+    bench_epoch<ct::online_scheduler_multi<M, ct::averaged_perceptron_multi<cc::linear_multi<W> > > >(
+        results, cfg, mdata, "averaged_perceptron.multi.epoch");
+    bench_epoch<ct::online_scheduler_multi<M, ct::pegasos_multi<cc::linear_multi_logistic<W> > > >(
+        results, cfg, mdata, "pegasos.logistic.multi.epoch");
+    bench_epoch<ct::online_scheduler_multi<M, ct::truncated_gradient_multi<cc::linear_multi_logistic<W> > > >(
+        results, cfg, mdata, "truncated_gradient.logistic.multi.epoch");
+}
+
+static bool write_lines(const std::string& filename, const lines_type& lines)
+{
+    std::ofstream ofs(filename.c_str());
+    for (size_t i = 0;i < lines.size();++i) {
+        ofs << lines[i] << std::endl;
+    }
+    return !ofs.fail();
+}
+
+static bool write_binary_model(const std::string& filename, const classias::bsdata& data)
+{
+    std::ofstream ofs(filename.c_str());
+    ofs << "@classias\tlinear\tbinary" << std::endl;
+    for (size_t i = 0;i < data.attributes.size();++i) {
+        ofs << (2. * uniform() - 1.) << '\t' << data.attributes.to_item(i) << std::endl;
+    }
+    return !ofs.fail();
+}
+
+static bool write_multi_model(const std::string& filename, const classias::msdata& data)
+{
+    std::ofstream ofs(filename.c_str());
+    ofs << "@classias\tlinear\tmulti\t" << data.feature_generator.name() << std::endl;
+    for (size_t l = 0;l < data.labels.size();++l) {
+        ofs << "@label\t" << data.labels.to_item(l) << std::endl;
+    }
+    for (size_t i = 0;i < data.attributes.size();++i) {
+        for (size_t l = 0;l < data.labels.size();++l) {
+            ofs << (2. * uniform() - 1.) << '\t' << data.attributes.to_item(i) <<
+                '\t' << data.labels.to_item(l) << std::endl;
+        }
+    }
+    return !ofs.fail();
+}
+
+/**
+ * The benchmark of classias-tag on a data file.
+ */
+static void bench_tag(
+    results_type& results,
+    const config& cfg,
+    const std::string& name,
+    const std::string& data,
+    const std::string& model,
+    double items
+    )
+{
+    std::string command =
+        cfg.tag + " -s spc -m " + model + " < " + data + " > " +
+#if defined(_MSC_VER)
+        "NUL";
+#else
+        "/dev/null";
+#endif
+
+    double best = -1.;
+    for (int r = 0;r < cfg.repeats;++r) {
+        double begin = now();
+        if (std::system(command.c_str()) != 0) {
+            std::cerr << "ERROR: failed to run: " << command << std::endl;
+            return;
+        }
+        double elapsed = now() - begin;
+        best = (best < 0. || elapsed < best) ? elapsed : best;
+    }
+    report(results, name, items, best);
+}
+
+static void bench_tagging(
+    results_type& results,
+    const config& cfg,
+    const lines_type& blines,
+    const classias::bsdata& bdata,
+    const lines_type& mlines,
+    const classias::msdata& mdata
+    )
+{
+    const std::string bfile = cfg.prefix + "-binary.txt";
+    const std::string bmodel = cfg.prefix + "-binary.model";
+    const std::string mfile = cfg.prefix + "-multi.txt";
+    const std::string mmodel = cfg.prefix + "-multi.model";
+
+    if (write_lines(bfile, blines) && write_binary_model(bmodel, bdata)) {
+        bench_tag(results, cfg, "classias-tag.binary", bfile, bmodel, (double)blines.size());
+    } else {
+        std::cerr << "ERROR: failed to write " << bfile << std::endl;
+    }
+    if (write_lines(mfile, mlines) && write_multi_model(mmodel, mdata)) {
+        bench_tag(results, cfg, "classias-tag.multi", mfile, mmodel, (double)mlines.size());
+    } else {
+        std::cerr << "ERROR: failed to write " << mfile << std::endl;
+    }
+
+    std::remove(bfile.c_str());
+    std::remove(bmodel.c_str());
+    std::remove(mfile.c_str());
+    std::remove(mmodel.c_str());
+}
+
+static void output_json(std::ostream& os, const config& cfg, const results_type& results)
+{
+    os << "{" << std::endl;
+    os << "  \"version\": \"" << CLASSIAS_VERSION << "\"," << std::endl;
+    os << "  \"isa\": \"" << classias::simd::isa_name() << "\"," << std::endl;
+    os << "  \"config\": {" << std::endl;
+    os << "    \"instances\": " << cfg.instances << "," << std::endl;
+    os << "    \"attributes\": " << cfg.attributes << "," << std::endl;
+    os << "    \"attributes_per_instance\": " << cfg.per_instance << "," << std::endl;
+    os << "    \"labels\": " << cfg.labels << "," << std::endl;
+    os << "    \"value_ratio\": " << cfg.value_ratio << "," << std::endl;
+    os << "    \"repeats\": " << cfg.repeats << "," << std::endl;
+    os << "    \"seed\": " << cfg.seed << std::endl;
+    os << "  }," << std::endl;
+    os << "  \"results\": [" << std::endl;
+    for (size_t i = 0;i < results.size();++i) {
+        const result& r = results[i];
+        double rate = (0. < r.seconds ? r.items / r.seconds : 0.);
+        os << "    {\"name\": \"" << r.name << "\", ";
+        os << std::setprecision(12);
+        os << "\"items\": " << r.items << ", ";
+        os << "\"seconds\": " << r.seconds << ", ";
+        os << "\"items_per_second\": " << rate << "}";
+        os << std::setprecision(6);
+        os << (i + 1 < results.size() ? "," : "") << std::endl;
+    }
+    os << "  ]" << std::endl;
+    os << "}" << std::endl;
+}
+
+static int usage(const char *argv0)
+{
+    std::cerr << "USAGE: " << argv0 << " [-n INSTANCES] [-a ATTRIBUTES] [-k ATTRIBUTES]" << std::endl;
+    std::cerr << "       [-l LABELS] [-v RATIO] [-r REPEATS] [-s SEED] [-t PROGRAM]" << std::endl;
+    std::cerr << "       [-w PREFIX] [-o FILE]" << std::endl;
+    return 1;
+}
+
+int main(int argc, char *argv[])
+{
+    config cfg;
+
+    for (int i = 1;i < argc;++i) {
+        const std::string arg = argv[i];
+        if (arg.size() != 2 || arg[0] != '-' || argc <= i + 1) {
+            return usage(argv[0]);
+        }
+        const char *value = argv[++i];
+        switch (arg[1]) {
+        case 'n':   cfg.instances = std::atoi(value);       break;
+        case 'a':   cfg.attributes = std::atoi(value);      break;
+        case 'k':   cfg.per_instance = std::atoi(value);    break;
+        case 'l':   cfg.labels = std::atoi(value);          break;
+        case 'v':   cfg.value_ratio = std::atof(value);     break;
+        case 'r':   cfg.repeats = std::atoi(value);         break;
+        case 's':   cfg.seed = (unsigned int)std::atol(value);  break;
+        case 't':   cfg.tag = value;                        break;
+        case 'w':   cfg.prefix = value;                     break;
+        case 'o':   cfg.output = value;                     break;
+        default:    return usage(argv[0]);
+        }
+    }
+    if (cfg.instances <= 0 || cfg.attributes <= 0 || cfg.per_instance <= 0 ||
+        cfg.labels <= 1 || cfg.repeats <= 0) {
+        return usage(argv[0]);
+    }
+    rng_state = cfg.seed;
+
+    // Generate the data sets.
+    option opt;
+    lines_type blines, mlines;
+    classias::bsdata bdata;
+    classias::msdata mdata;
+    generate_lines(blines, cfg, 0);
+    generate_lines(mlines, cfg, cfg.labels);
+    opt.type = option::TYPE_BINARY;
+    store_lines(bdata, blines, opt);
+    opt.type = option::TYPE_MULTI_DENSE;
+    store_lines(mdata, mlines, opt);
+
+    results_type results;
+    try {
+        bench_parse(results, cfg, blines);
+        bench_quark(results, cfg, blines);
+        bench_binary_scoring(results, cfg, bdata);
+        bench_multi_scoring(results, cfg, mdata);
+        bench_training(results, cfg, bdata, mdata);
+        if (!cfg.tag.empty()) {
+            bench_tagging(results, cfg, blines, bdata, mlines, mdata);
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "ERROR: " << e.what() << std::endl;
+        return 1;
+    }
+
+    if (cfg.output.empty()) {
+        output_json(std::cout, cfg, results);
+    } else {
+        std::ofstream ofs(cfg.output.c_str());
+        if (ofs.fail()) {
+            std::cerr << "ERROR: failed to open " << cfg.output << std::endl;
+            return 1;
+        }
+        output_json(ofs, cfg, results);
+    }
+    return 0;
+}
@@ -0,0 +1,923 @@
+/*
+ *		Python extension for scoring instances with compiled models.
+ *
+ * Copyright (c) 2008,2009 Naoaki Okazaki
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the names of the authors nor the names of its contributors
+ *       may be used to endorse or promote products derived from this
+ *       software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* $Id$ */
+
+/*
+The module wraps a compiled model (classias-train --model-format=binary),
+which is mapped to the memory without parsing. A batch of instances is
+given either as lists of attributes or as a CSR matrix of attribute
+identifiers of the model (any object with the buffer protocol, e.g., NumPy
+arrays and array.array, or a sequence of numbers), and is scored by the
+classifiers of the library on multiple threads without holding the GIL.
+
+    import classias
+    m = classias.Model('model.bin')
+    m.scores([['a', ('b', 0.5)], ['c']])
+    indptr, indices, data = m.encode([['a', ('b', 0.5)], ['c']])
+    m.predict_csr(indptr, indices, data, threads=4)
+
+The rows of a candidate model are the candidates; the instances are given
+as lists of candidates, or as the offsets (groups) of the candidates of
+the instances in the CSR matrix.
+*/
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#include <cmath>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <classias/thread.h>
+#include <classias/classify/linear/binary.h>
+#include <classias/classify/linear/multi.h>
+
+#include <model_file.h>
+#include <compiled_model.h>
+
+/**
+ * A batch of instances in the CSR layout.
+ *  The key of an element is the position of the weight for a binary model,
+ *  or the attribute identifier for a multi-class or candidate model.
+ */
+struct batch
+{
+    typedef std::pair<size_t, double> element_type;
+
+    /// The offsets of the rows in the elements (the number of rows + 1).
+    std::vector<size_t> rows;
+    /// The elements.
+    std::vector<element_type> elements;
+    /// The offsets of the instances in the rows of a candidate model.
+    std::vector<size_t> groups;
+
+    batch() : rows(1, 0)
+    {
+    }
+
+    size_t num_rows() const
+    {
+        return rows.size() - 1;
+    }
+};
+
+/**
+ * The outputs of scoring.
+ */
+enum {
+    OUTPUT_SCORES = 0,
+    OUTPUT_PROBABILITIES,
+    OUTPUT_PREDICT,
+};
+
+typedef classias::classify::linear_binary_logistic<compiled_weights> binary_classifier_type;
+typedef classias::classify::linear_multi_logistic<compiled_weights> multi_classifier_type;
+
+/**
+ * A task scoring a range of the rows (or instances of a candidate model).
+ */
+struct score_task
+{
+    const model_file* mf;
+    const batch* b;
+    int output;
+    size_t first;
+    size_t last;
+    double* values;
+    long* labels;
+
+    void run()
+    {
+        compiled_weights model(*mf);
+        compiled_feature_generator fgen(*mf);
+        const std::vector<size_t>& rows = b->rows;
+        const batch::element_type* e = b->elements.empty() ? NULL : &b->elements[0];
+
+        switch (mf->type()) {
+        case MODEL_FILE_BINARY:
+            {
+                binary_classifier_type cls(model);
+                for (size_t i = first;i < last;++i) {
+                    cls.inner_product(e + rows[i], e + rows[i+1]);
+                    if (output == OUTPUT_SCORES) {
+                        values[i] = cls.score();
+                    } else if (output == OUTPUT_PROBABILITIES) {
+                        values[i] = cls.prob();
+                    } else {
+                        labels[i] = static_cast<long>(static_cast<bool>(cls));
+                    }
+                }
+            }
+            break;
+
+        case MODEL_FILE_CANDIDATE:
+            {
+                multi_classifier_type cls(model);
+                const std::vector<size_t>& groups = b->groups;
+                for (size_t g = first;g < last;++g) {
+                    const size_t begin = groups[g];
+                    const int C = (int)(groups[g+1] - begin);
+                    cls.clear();
+                    cls.resize(C);
+                    for (int c = 0;c < C;++c) {
+                        const size_t i = begin + c;
+                        cls.inner_product(c, fgen, e + rows[i], e + rows[i+1], 0);
+                    }
+                    cls.finalize();
+                    if (output == OUTPUT_SCORES) {
+                        for (int c = 0;c < C;++c) {
+                            values[begin + c] = cls.score(c);
+                        }
+                    } else if (output == OUTPUT_PROBABILITIES) {
+                        for (int c = 0;c < C;++c) {
+                            values[begin + c] = cls.prob(c);
+                        }
+                    } else {
+                        labels[g] = (long)cls.argmax();
+                    }
+                }
+            }
+            break;
+
+        default:
+            {
+                multi_classifier_type cls(model);
+                const int L = mf->num_labels();
+                for (size_t i = first;i < last;++i) {
+                    cls.clear();
+                    cls.inner_product_postings(fgen, e + rows[i], e + rows[i+1], L);
+                    cls.finalize();
+                    if (output == OUTPUT_SCORES) {
+                        for (int l = 0;l < L;++l) {
+                            values[i * L + l] = cls.score(l);
+                        }
+                    } else if (output == OUTPUT_PROBABILITIES) {
+                        for (int l = 0;l < L;++l) {
+                            values[i * L + l] = cls.prob(l);
+                        }
+                    } else {
+                        labels[i] = (long)cls.argmax();
+                    }
+                }
+            }
+            break;
+        }
+    }
+};
+
+
+
+/**
+ * The Python object of a model.
+ */
+typedef struct {
+    PyObject_HEAD
+    model_file* mf;
+    /// The attribute of the bias feature (-1 if none).
+    int bias;
+} model_object;
+
+/// The type array.array for the results.
+static PyObject* array_type = NULL;
+
+static bool is_candidate(const model_object* self)
+{
+    return (self->mf->type() == MODEL_FILE_CANDIDATE);
+}
+
+static bool is_multi(const model_object* self)
+{
+    return (
+        self->mf->type() == MODEL_FILE_MULTI_SPARSE ||
+        self->mf->type() == MODEL_FILE_MULTI_DENSE);
+}
+
+/**
+ * Creates an array.array from a block of memory.
+ */
+static PyObject* make_array(const char *typecode, const void *data, size_t bytes)
+{
+    return PyObject_CallFunction(
+        array_type, (char*)"sy#", typecode,
+        (const char*)data, (Py_ssize_t)bytes);
+}
+
+/**
+ * Appends an element of an attribute to a batch.
+ *  Attributes that the model does not have are skipped.
+ */
+static void append_element(const model_object* self, batch& b, int a, double value)
+{
+    const model_file& mf = *self->mf;
+    if (mf.type() == MODEL_FILE_BINARY) {
+        // The weight of an attribute is the first (only) one in its row.
+        if (mf.row_begin(a) < mf.row_end(a)) {
+            b.elements.push_back(batch::element_type(mf.row_begin(a), value));
+        }
+    } else {
+        b.elements.push_back(batch::element_type((size_t)a, value));
+    }
+}
+
+/**
+ * Closes a row of a batch, appending the bias feature if the model has it.
+ */
+static void close_row(const model_object* self, batch& b)
+{
+    if (0 <= self->bias && !is_candidate(self)) {
+        append_element(self, b, self->bias, 1.);
+    }
+    b.rows.push_back(b.elements.size());
+}
+
+/**
+ * Parses an attribute, a string or a pair of a string and a value.
+ */
+static bool parse_attribute(PyObject* item, const char*& name, Py_ssize_t& n, double& value)
+{
+    PyObject* str = item;
+    value = 1.;
+    if (PyTuple_Check(item) || PyList_Check(item)) {
+        if (PySequence_Size(item) != 2) {
+            PyErr_SetString(PyExc_TypeError, "an attribute must be a string or a pair (name, value)");
+            return false;
+        }
+        str = PySequence_Fast_GET_ITEM(item, 0);
+        value = PyFloat_AsDouble(PySequence_Fast_GET_ITEM(item, 1));
+        if (value == -1. && PyErr_Occurred()) {
+            return false;
+        }
+    }
+
+    if (PyUnicode_Check(str)) {
+        name = PyUnicode_AsUTF8AndSize(str, &n);
+        return (name != NULL);
+    } else if (PyBytes_Check(str)) {
+        name = PyBytes_AS_STRING(str);
+        n = PyBytes_GET_SIZE(str);
+        return true;
+    }
+    PyErr_SetString(PyExc_TypeError, "an attribute name must be a string");
+    return false;
+}
+
+/**
+ * Appends a row given by a list of attributes to a batch.
+ */
+static bool append_row(const model_object* self, batch& b, PyObject* row)
+{
+    PyObject* seq = PySequence_Fast(row, "a row must be a sequence of attributes");
+    if (seq == NULL) {
+        return false;
+    }
+
+    const Py_ssize_t n = PySequence_Fast_GET_SIZE(seq);
+    for (Py_ssize_t i = 0;i < n;++i) {
+        const char *name = NULL;
+        Py_ssize_t len = 0;
+        double value = 1.;
+        if (!parse_attribute(PySequence_Fast_GET_ITEM(seq, i), name, len, value)) {
+            Py_DECREF(seq);
+            return false;
+        }
+        int a = self->mf->find(name, (size_t)len);
+        if (0 <= a) {
+            append_element(self, b, a, value);
+        }
+    }
+    Py_DECREF(seq);
+
+    close_row(self, b);
+    return true;
+}
+
+/**
+ * Builds a batch from lists of attributes (or lists of candidates).
+ */
+static bool read_lists(const model_object* self, batch& b, PyObject* obj)
+{
+    PyObject* seq = PySequence_Fast(obj, "instances must be a sequence");
+    if (seq == NULL) {
+        return false;
+    }
+
+    const Py_ssize_t n = PySequence_Fast_GET_SIZE(seq);
+    bool ret = true;
+    if (is_candidate(self)) {
+        b.groups.assign(1, 0);
+    }
+    for (Py_ssize_t i = 0;ret && i < n;++i) {
+        PyObject* inst = PySequence_Fast_GET_ITEM(seq, i);
+        if (is_candidate(self)) {
+            PyObject* cands = PySequence_Fast(inst, "an instance must be a sequence of candidates");
+            if (cands == NULL) {
+                ret = false;
+                break;
+            }
+            const Py_ssize_t C = PySequence_Fast_GET_SIZE(cands);
+            for (Py_ssize_t c = 0;ret && c < C;++c) {
+                ret = append_row(self, b, PySequence_Fast_GET_ITEM(cands, c));
+            }
+            Py_DECREF(cands);
+            b.groups.push_back(b.num_rows());
+        } else {
+            ret = append_row(self, b, inst);
+        }
+    }
+    Py_DECREF(seq);
+    return ret;
+}
+
+/**
+ * Reads the numbers of an object with the buffer protocol, or of a
+ * sequence of numbers.
+ *  @param  obj         The object.
+ *  @param  out         The vector to which this function stores the numbers.
+ *  @param  integral    \c true to accept integers only.
+ *  @param  name        The name of the argument for error messages.
+ */
+template <class value_type>
+static bool read_numbers(PyObject* obj, std::vector<value_type>& out, bool integral, const char *name)
+{
+    out.clear();
+
+    if (PyObject_CheckBuffer(obj)) {
+        Py_buffer view;
+        if (PyObject_GetBuffer(obj, &view, PyBUF_C_CONTIGUOUS | PyBUF_FORMAT) != 0) {
+            return false;
+        }
+
+        // Accept the native byte order only.
+        const char *fmt = (view.format != NULL ? view.format : "B");
+        if (*fmt == '@' || *fmt == '=') {
+            ++fmt;
+        } else if (*fmt == '<' || *fmt == '>' || *fmt == '!') {
+            const int one = 1;
+            const bool little = (*reinterpret_cast<const char*>(&one) == 1);
+            if ((*fmt == '<') != little) {
+                PyBuffer_Release(&view);
+                PyErr_Format(PyExc_ValueError, "%s must be in the native byte order", name);
+                return false;
+            }
+            ++fmt;
+        }
+
+        const Py_ssize_t n = (0 < view.itemsize ? view.len / view.itemsize : 0);
+        const char *p = reinterpret_cast<const char*>(view.buf);
+        out.resize((size_t)n);
+        bool ok = (fmt[0] != 0 && fmt[1] == 0);
+        for (Py_ssize_t i = 0;ok && i < n;++i) {
+            const char *q = p + i * view.itemsize;
+            switch (fmt[0]) {
+            case 'b': out[i] = (value_type)*reinterpret_cast<const signed char*>(q); break;
+            case 'B': out[i] = (value_type)*reinterpret_cast<const unsigned char*>(q); break;
+            case 'h': out[i] = (value_type)*reinterpret_cast<const short*>(q); break;
+            case 'H': out[i] = (value_type)*reinterpret_cast<const unsigned short*>(q); break;
+            case 'i': out[i] = (value_type)*reinterpret_cast<const int*>(q); break;
+            case 'I': out[i] = (value_type)*reinterpret_cast<const unsigned int*>(q); break;
+            case 'l': out[i] = (value_type)*reinterpret_cast<const long*>(q); break;
+            case 'L': out[i] = (value_type)*reinterpret_cast<const unsigned long*>(q); break;
+            case 'q': out[i] = (value_type)*reinterpret_cast<const PY_LONG_LONG*>(q); break;
+            case 'Q': out[i] = (value_type)*reinterpret_cast<const unsigned PY_LONG_LONG*>(q); break;
+            case 'n': out[i] = (value_type)*reinterpret_cast<const Py_ssize_t*>(q); break;
+            case 'N': out[i] = (value_type)*reinterpret_cast<const size_t*>(q); break;
+            case 'f': out[i] = (value_type)*reinterpret_cast<const float*>(q); ok = !integral; break;
+            case 'd': out[i] = (value_type)*reinterpret_cast<const double*>(q); ok = !integral; break;
+            default: ok = false; break;
+            }
+        }
+        PyBuffer_Release(&view);
+        if (!ok) {
+            PyErr_Format(PyExc_TypeError, "%s has an unsupported element type '%s'",
+                name, (view.format != NULL ? view.format : "B"));
+            return false;
+        }
+        return true;
+    }
+
+    PyObject* seq = PySequence_Fast(obj, "an array or a sequence of numbers is expected");
+    if (seq == NULL) {
+        return false;
+    }
+    const Py_ssize_t n = PySequence_Fast_GET_SIZE(seq);
+    out.resize((size_t)n);
+    for (Py_ssize_t i = 0;i < n;++i) {
+        PyObject* x = PySequence_Fast_GET_ITEM(seq, i);
+        if (integral) {
+            long v = PyLong_AsLong(x);
+            if (v == -1 && PyErr_Occurred()) {
+                Py_DECREF(seq);
+                return false;
+            }
+            out[i] = (value_type)v;
+        } else {
+            double v = PyFloat_AsDouble(x);
+            if (v == -1. && PyErr_Occurred()) {
+                Py_DECREF(seq);
+                return false;
+            }
+            out[i] = (value_type)v;
+        }
+    }
+    Py_DECREF(seq);
+    return true;
+}
+
+/**
+ * Checks the offsets of a CSR matrix.
+ */
+static bool check_offsets(const std::vector<PY_LONG_LONG>& offsets, size_t n, const char *name)
+{
+    if (offsets.empty() || offsets[0] != 0 || (size_t)offsets.back() != n) {
+        PyErr_Format(PyExc_ValueError,
+            "%s must start with 0 and end with the number of elements", name);
+        return false;
+    }
+    for (size_t i = 1;i < offsets.size();++i) {
+        if (offsets[i] < offsets[i-1]) {
+            PyErr_Format(PyExc_ValueError, "%s must be non-decreasing", name);
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Builds a batch from a CSR matrix.
+ */
+static bool read_csr(
+    const model_object* self, batch& b,
+    PyObject* indptr, PyObject* indices, PyObject* data, PyObject* groups)
+{
+    std::vector<PY_LONG_LONG> offsets, ids;
+    std::vector<double> values;
+    if (!read_numbers(indptr, offsets, true, "indptr") ||
+        !read_numbers(indices, ids, true, "indices")) {
+        return false;
+    }
+    if (data != NULL && data != Py_None) {
+        if (!read_numbers(data, values, false, "data")) {
+            return false;
+        }
+        if (values.size() != ids.size()) {
+            PyErr_SetString(PyExc_ValueError, "data and indices must have the same length");
+            return false;
+        }
+    }
+    if (!check_offsets(offsets, ids.size(), "indptr")) {
+        return false;
+    }
+
+    const PY_LONG_LONG A = self->mf->num_attributes();
+    b.elements.reserve(ids.size());
+    for (size_t r = 0;r + 1 < offsets.size();++r) {
+        for (PY_LONG_LONG k = offsets[r];k < offsets[r+1];++k) {
+            if (ids[k] < 0 || A <= ids[k]) {
+                PyErr_Format(PyExc_ValueError, "attribute identifier out of range: %lld", ids[k]);
+                return false;
+            }
+            append_element(self, b, (int)ids[k], values.empty() ? 1. : values[k]);
+        }
+        close_row(self, b);
+    }
+
+    if (is_candidate(self)) {
+        if (groups != NULL && groups != Py_None) {
+            std::vector<PY_LONG_LONG> g;
+            if (!read_numbers(groups, g, true, "groups") ||
+                !check_offsets(g, b.num_rows(), "groups")) {
+                return false;
+            }
+            b.groups.assign(g.begin(), g.end());
+        } else {
+            // Every candidate forms an instance by itself.
+            b.groups.resize(b.num_rows() + 1);
+            for (size_t i = 0;i < b.groups.size();++i) {
+                b.groups[i] = i;
+            }
+        }
+    }
+    return true;
+}
+
+/**
+ * Scores a batch on multiple threads while the GIL is released.
+ */
+static PyObject* score(model_object* self, const batch& b, int output, int threads)
+{
+    if (threads < 1) {
+        PyErr_SetString(PyExc_ValueError, "the number of threads must be positive");
+        return NULL;
+    }
+
+    // Candidate models are split by instances, the others by rows.
+    const size_t R = b.num_rows();
+    const size_t M = is_candidate(self) ? b.groups.size() - 1 : R;
+    const int L = is_multi(self) ? self->mf->num_labels() : 1;
+    std::vector<double> values;
+    std::vector<long> labels;
+    if (output == OUTPUT_PREDICT) {
+        labels.resize(M);
+    } else {
+        values.resize(R * L);
+    }
+
+    size_t N = (size_t)threads;
+    if (M < N) {
+        N = (0 < M) ? M : 1;
+    }
+    std::vector<score_task> tasks(N);
+    for (size_t t = 0;t < N;++t) {
+        tasks[t].mf = self->mf;
+        tasks[t].b = &b;
+        tasks[t].output = output;
+        tasks[t].first = M * t / N;
+        tasks[t].last = M * (t+1) / N;
+        tasks[t].values = values.empty() ? NULL : &values[0];
+        tasks[t].labels = labels.empty() ? NULL : &labels[0];
+    }
+
+    std::string error;
+    Py_BEGIN_ALLOW_THREADS
+    try {
+        classias::run_tasks(tasks);
+    } catch (const std::exception& e) {
+        error = e.what();
+    }
+    Py_END_ALLOW_THREADS
+    if (!error.empty()) {
+        PyErr_SetString(PyExc_RuntimeError, error.c_str());
+        return NULL;
+    }
+
+    if (output == OUTPUT_PREDICT) {
+        return make_array("l", labels.empty() ? NULL : &labels[0], sizeof(long) * labels.size());
+    }
+    return make_array("d", values.empty() ? NULL : &values[0], sizeof(double) * values.size());
+}
+
+static PyObject* score_lists(model_object* self, PyObject* args, PyObject* kwds, int output)
+{
+    static char *kwlist[] = {(char*)"instances", (char*)"threads", NULL};
+    PyObject* instances = NULL;
+    int threads = 1;
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O|i", kwlist, &instances, &threads)) {
+        return NULL;
+    }
+
+    batch b;
+    if (!read_lists(self, b, instances)) {
+        return NULL;
+    }
+    return score(self, b, output, threads);
+}
+
+static PyObject* score_csr(model_object* self, PyObject* args, PyObject* kwds, int output)
+{
+    static char *kwlist[] = {
+        (char*)"indptr", (char*)"indices", (char*)"data",
+        (char*)"groups", (char*)"threads", NULL};
+    PyObject *indptr = NULL, *indices = NULL, *data = NULL, *groups = NULL;
+    int threads = 1;
+    if (!PyArg_ParseTupleAndKeywords(
+            args, kwds, "OO|OOi", kwlist, &indptr, &indices, &data, &groups, &threads)) {
+        return NULL;
+    }
+
+    batch b;
+    if (!read_csr(self, b, indptr, indices, data, groups)) {
+        return NULL;
+    }
+    return score(self, b, output, threads);
+}
+
+static PyObject* model_scores(model_object* self, PyObject* args, PyObject* kwds)
+{
+    return score_lists(self, args, kwds, OUTPUT_SCORES);
+}
+
+static PyObject* model_probabilities(model_object* self, PyObject* args, PyObject* kwds)
+{
+    return score_lists(self, args, kwds, OUTPUT_PROBABILITIES);
+}
+
+static PyObject* model_predict(model_object* self, PyObject* args, PyObject* kwds)
+{
+    return score_lists(self, args, kwds, OUTPUT_PREDICT);
+}
+
+static PyObject* model_scores_csr(model_object* self, PyObject* args, PyObject* kwds)
+{
+    return score_csr(self, args, kwds, OUTPUT_SCORES);
+}
+
+static PyObject* model_probabilities_csr(model_object* self, PyObject* args, PyObject* kwds)
+{
+    return score_csr(self, args, kwds, OUTPUT_PROBABILITIES);
+}
+
+static PyObject* model_predict_csr(model_object* self, PyObject* args, PyObject* kwds)
+{
+    return score_csr(self, args, kwds, OUTPUT_PREDICT);
+}
+
+static PyObject* model_encode(model_object* self, PyObject* args)
+{
+    PyObject* instances = NULL;
+    if (!PyArg_ParseTuple(args, "O", &instances)) {
+        return NULL;
+    }
+
+    // Encode the attributes without the bias feature, which the scoring
+    // functions append to every row.
+    const int bias = self->bias;
+    const int type = self->mf->type();
+    batch b;
+    self->bias = -1;
+    bool ok = read_lists(self, b, instances);
+    self->bias = bias;
+    if (!ok) {
+        return NULL;
+    }
+
+    std::vector<PY_LONG_LONG> indptr(b.rows.begin(), b.rows.end());
+    std::vector<int> indices(b.elements.size());
+    std::vector<double> data(b.elements.size());
+    for (size_t k = 0;k < b.elements.size();++k) {
+        indices[k] = (int)b.elements[k].first;
+        data[k] = b.elements[k].second;
+    }
+    if (type == MODEL_FILE_BINARY) {
+        // Translate the positions of the weights back to the attributes.
+        const model_file& mf = *self->mf;
+        for (size_t k = 0;k < indices.size();++k) {
+            int lo = 0, hi = mf.num_attributes();
+            while (lo < hi) {
+                int mid = lo + (hi - lo) / 2;
+                if (mf.row_begin(mid) < b.elements[k].first) {
+                    lo = mid + 1;
+                } else {
+                    hi = mid;
+                }
+            }
+            while (mf.row_end(lo) == mf.row_begin(lo)) {
+                ++lo;
+            }
+            indices[k] = lo;
+        }
+    }
+
+    PyObject* ret = PyTuple_New(is_candidate(self) ? 4 : 3);
+    if (ret == NULL) {
+        return NULL;
+    }
+    PyTuple_SET_ITEM(ret, 0, make_array(
+        "q", &indptr[0], sizeof(PY_LONG_LONG) * indptr.size()));
+    PyTuple_SET_ITEM(ret, 1, make_array(
+        "i", indices.empty() ? NULL : &indices[0], sizeof(int) * indices.size()));
+    PyTuple_SET_ITEM(ret, 2, make_array(
+        "d", data.empty() ? NULL : &data[0], sizeof(double) * data.size()));
+    if (is_candidate(self)) {
+        std::vector<PY_LONG_LONG> groups(b.groups.begin(), b.groups.end());
+        PyTuple_SET_ITEM(ret, 3, make_array(
+            "q", &groups[0], sizeof(PY_LONG_LONG) * groups.size()));
+    }
+    for (Py_ssize_t i = 0;i < PyTuple_GET_SIZE(ret);++i) {
+        if (PyTuple_GET_ITEM(ret, i) == NULL) {
+            Py_DECREF(ret);
+            return NULL;
+        }
+    }
+    return ret;
+}
+
+static PyObject* model_find(model_object* self, PyObject* args)
+{
+    const char *name = NULL;
+    Py_ssize_t n = 0;
+    if (!PyArg_ParseTuple(args, "s#", &name, &n)) {
+        return NULL;
+    }
+    return PyLong_FromLong(self->mf->find(name, (size_t)n));
+}
+
+static PyObject* model_attribute(model_object* self, PyObject* args)
+{
+    int a = 0;
+    if (!PyArg_ParseTuple(args, "i", &a)) {
+        return NULL;
+    }
+    if (a < 0 || self->mf->num_attributes() <= a) {
+        PyErr_SetString(PyExc_IndexError, "attribute identifier out of range");
+        return NULL;
+    }
+    const std::string str = self->mf->attribute(a);
+    return PyUnicode_FromStringAndSize(str.c_str(), (Py_ssize_t)str.length());
+}
+
+static PyObject* model_get_type(model_object* self, void*)
+{
+    switch (self->mf->type()) {
+    case MODEL_FILE_BINARY:
+        return PyUnicode_FromString("binary");
+    case MODEL_FILE_CANDIDATE:
+        return PyUnicode_FromString("candidate");
+    default:
+        return PyUnicode_FromString("multi");
+    }
+}
+
+static PyObject* model_get_labels(model_object* self, void*)
+{
+    const int L = self->mf->num_labels();
+    PyObject* ret = PyList_New(L);
+    if (ret == NULL) {
+        return NULL;
+    }
+    for (int l = 0;l < L;++l) {
+        const std::string str = self->mf->label(l);
+        PyObject* s = PyUnicode_FromStringAndSize(str.c_str(), (Py_ssize_t)str.length());
+        if (s == NULL) {
+            Py_DECREF(ret);
+            return NULL;
+        }
+        PyList_SET_ITEM(ret, l, s);
+    }
+    return ret;
+}
+
+static PyObject* model_get_num_attributes(model_object* self, void*)
+{
+    return PyLong_FromLong(self->mf->num_attributes());
+}
+
+static int model_init(model_object* self, PyObject* args, PyObject* kwds)
+{
+    static char *kwlist[] = {(char*)"filename", NULL};
+    const char *filename = NULL;
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "s", kwlist, &filename)) {
+        return -1;
+    }
+
+    model_file* mf = new model_file;
+    try {
+        if (!mf->open(filename)) {
+            delete mf;
+            PyErr_Format(PyExc_ValueError,
+                "not a compiled model (write it by classias-train --model-format=binary): %s",
+                filename);
+            return -1;
+        }
+    } catch (const std::exception& e) {
+        delete mf;
+        PyErr_SetString(PyExc_ValueError, e.what());
+        return -1;
+    }
+
+    delete self->mf;
+    self->mf = mf;
+    self->bias = mf->find("__BIAS__");
+    return 0;
+}
+
+static void model_dealloc(model_object* self)
+{
+    delete self->mf;
+    Py_TYPE(self)->tp_free(reinterpret_cast<PyObject*>(self));
+}
+
+static PyObject* model_new(PyTypeObject* type, PyObject*, PyObject*)
+{
+    model_object* self = reinterpret_cast<model_object*>(type->tp_alloc(type, 0));
+    if (self != NULL) {
+        self->mf = NULL;
+        self->bias = -1;
+    }
+    return reinterpret_cast<PyObject*>(self);
+}
+
+#define SCORING_ARGS(x) \
+    x "\n\nReturns an array.array of doubles: a score for every row of a binary or\n" \
+    "candidate model, or the scores of the labels for every row of a multi-class\n" \
+    "model (row-major). The threads argument sets the number of threads."
+
+static PyMethodDef model_methods[] = {
+    {"scores", (PyCFunction)model_scores, METH_VARARGS | METH_KEYWORDS,
+     SCORING_ARGS("scores(instances, threads=1): scores the instances, each of which\n"
+     "is a list of attributes (a name or a pair of a name and a value), or a list\n"
+     "of candidates for a candidate model.")},
+    {"probabilities", (PyCFunction)model_probabilities, METH_VARARGS | METH_KEYWORDS,
+     "probabilities(instances, threads=1): computes the probabilities of the\n"
+     "positive label (binary), the labels (multi), or the candidates of the\n"
+     "instances (candidate) in the layout of scores()."},
+    {"predict", (PyCFunction)model_predict, METH_VARARGS | METH_KEYWORDS,
+     "predict(instances, threads=1): returns an array.array of the predicted\n"
+     "labels: 0/1 (binary), label indices (multi), or candidate indices\n"
+     "(candidate) of the instances."},
+    {"scores_csr", (PyCFunction)model_scores_csr, METH_VARARGS | METH_KEYWORDS,
+     SCORING_ARGS("scores_csr(indptr, indices, data=None, groups=None, threads=1):\n"
+     "scores the rows of a CSR matrix of attribute identifiers (data=None for\n"
+     "values of 1); groups are the offsets of the candidates of the instances\n"
+     "for a candidate model.")},
+    {"probabilities_csr", (PyCFunction)model_probabilities_csr, METH_VARARGS | METH_KEYWORDS,
+     "probabilities_csr(indptr, indices, data=None, groups=None, threads=1):\n"
+     "probabilities() for a CSR matrix."},
+    {"predict_csr", (PyCFunction)model_predict_csr, METH_VARARGS | METH_KEYWORDS,
+     "predict_csr(indptr, indices, data=None, groups=None, threads=1):\n"
+     "predict() for a CSR matrix."},
+    {"encode", (PyCFunction)model_encode, METH_VARARGS,
+     "encode(instances): converts the instances into a CSR matrix, a tuple\n"
+     "(indptr, indices, data) of array.array (and groups for a candidate model);\n"
+     "attributes unknown to the model are dropped. The bias feature is appended\n"
+     "by the scoring functions."},
+    {"find", (PyCFunction)model_find, METH_VARARGS,
+     "find(name): returns the identifier of an attribute, or -1."},
+    {"attribute", (PyCFunction)model_attribute, METH_VARARGS,
+     "attribute(i): returns the name of the attribute #i."},
+    {NULL, NULL, 0, NULL}
+};
+
+static PyGetSetDef model_getset[] = {
+    {(char*)"type", (getter)model_get_type, NULL,
+     (char*)"The model type: 'binary', 'multi', or 'candidate'.", NULL},
+    {(char*)"labels", (getter)model_get_labels, NULL,
+     (char*)"The names of the labels of a multi-class model.", NULL},
+    {(char*)"num_attributes", (getter)model_get_num_attributes, NULL,
+     (char*)"The number of attributes.", NULL},
+    {NULL, NULL, NULL, NULL, NULL}
+};
+
+static PyTypeObject model_type = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    "classias.Model",
+};
+
+static struct PyModuleDef classias_module = {
+    PyModuleDef_HEAD_INIT,
+    "classias",
+    "Scoring instances with compiled classias models.",
+    -1,
+    NULL,
+};
+
+PyMODINIT_FUNC PyInit_classias(void)
+{
+    model_type.tp_basicsize = sizeof(model_object);
+    model_type.tp_flags = Py_TPFLAGS_DEFAULT;
+    model_type.tp_doc = "Model(filename): a compiled model mapped to the memory.";
+    model_type.tp_new = model_new;
+    model_type.tp_init = (initproc)model_init;
+    model_type.tp_dealloc = (destructor)model_dealloc;
+    model_type.tp_methods = model_methods;
+    model_type.tp_getset = model_getset;
+    if (PyType_Ready(&model_type) < 0) {
+        return NULL;
+    }
+
+    PyObject* array = PyImport_ImportModule("array");
+    if (array == NULL) {
+        return NULL;
+    }
+    array_type = PyObject_GetAttrString(array, "array");
+    Py_DECREF(array);
+    if (array_type == NULL) {
+        return NULL;
+    }
+
+    PyObject* m = PyModule_Create(&classias_module);
+    if (m == NULL) {
+        return NULL;
+    }
+    Py_INCREF(&model_type);
+    PyModule_AddObject(m, "Model", reinterpret_cast<PyObject*>(&model_type));
+    return m;
+}
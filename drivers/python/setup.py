@@ -0,0 +1,34 @@
+# $Id$
+#
+# Builds the extension module for scoring compiled models:
+#     python setup.py build_ext --inplace
+
+import os
+from setuptools import setup, Extension
+
+top = os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', '..')
+
+macros = []
+libraries = []
+if os.name == 'posix':
+    macros = [('HAVE_SYS_MMAN_H', None), ('HAVE_STDINT_H', None), ('HAVE_LIBPTHREAD', None)]
+    libraries = ['pthread']
+
+classias = Extension(
+    'classias',
+    sources=['classiasmodule.cpp'],
+    include_dirs=[
+        os.path.join(top, 'include'),
+        os.path.join(top, 'frontend', 'include'),
+        os.path.join(top, 'frontend', 'tag'),
+        ],
+    define_macros=macros,
+    libraries=libraries,
+    language='c++',
+    )
+
+setup(
+    name='classias',
+    description='Scoring instances with compiled classias models',
+    ext_modules=[classias],
+    )
@@ -0,0 +1,806 @@
+/*
+ *		Exporting a model as C++ code.
+ *
+ * Copyright (c) 2008,2009 Naoaki Okazaki
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the names of the authors nor the names of its contributors
+ *       may be used to endorse or promote products derived from this
+ *       software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* $Id$ */
+
+#ifndef __EXPORT_H__
+#define __EXPORT_H__
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <model_file.h>
+#include <util.h>
+
+/**
+ * A model to be exported, in the layout of a compiled model.
+ *  The attributes are sorted, and the weights of the attribute #a are
+ *  found in [rows[a], rows[a+1]) of row_labels and row_weights.
+ */
+struct export_model
+{
+    struct entry_type
+    {
+        std::string attribute;
+        int label;
+        double weight;
+
+        bool operator<(const entry_type& x) const
+        {
+            int c = attribute.compare(x.attribute);
+            return (c < 0 || (c == 0 && label < x.label));
+        }
+    };
+
+    int type;
+    std::vector<std::string> labels;
+    std::vector<std::string> attributes;
+    std::vector<size_t> rows;
+    std::vector<int> row_labels;
+    std::vector<double> row_weights;
+
+    export_model() : type(MODEL_FILE_NONE)
+    {
+    }
+
+    size_t num_weights() const
+    {
+        return row_weights.size();
+    }
+};
+
+/**
+ * Reads a compiled model.
+ *  @param  m           The model to which this function stores the weights.
+ *  @param  mf          The compiled model.
+ */
+inline static void read_compiled_model(export_model& m, const model_file& mf)
+{
+    m.type = mf.type();
+    for (int l = 0;l < mf.num_labels();++l) {
+        m.labels.push_back(mf.label(l));
+    }
+    m.rows.push_back(0);
+    for (int a = 0;a < mf.num_attributes();++a) {
+        m.attributes.push_back(mf.attribute(a));
+        for (size_t k = mf.row_begin(a);k < mf.row_end(a);++k) {
+            m.row_labels.push_back(mf.row_label(k));
+            m.row_weights.push_back(mf.row_weight(k));
+        }
+        m.rows.push_back(m.row_weights.size());
+    }
+}
+
+/**
+ * Reads a model in the text format.
+ *  @param  m           The model to which this function stores the weights.
+ *  @param  is          The input stream of the model.
+ */
+inline static void read_text_model(export_model& m, std::istream& is)
+{
+    typedef export_model::entry_type entry_type;
+
+    std::string line;
+    std::getline(is, line);
+    if (line == "@classias\tlinear\tbinary") {
+        m.type = MODEL_FILE_BINARY;
+    } else if (line == "@classias\tlinear\tmulti\tdense") {
+        m.type = MODEL_FILE_MULTI_DENSE;
+    } else if (line == "@classias\tlinear\tmulti\tsparse") {
+        m.type = MODEL_FILE_MULTI_SPARSE;
+    } else if (line == "@classias\tlinear\tcandidate") {
+        m.type = MODEL_FILE_CANDIDATE;
+    } else {
+        throw invalid_model("unknown model type", line);
+    }
+    const bool multi = (m.type == MODEL_FILE_MULTI_DENSE || m.type == MODEL_FILE_MULTI_SPARSE);
+
+    std::vector<entry_type> entries;
+    for (;;) {
+        std::getline(is, line);
+        if (is.eof()) {
+            break;
+        }
+
+        if (line.compare(0, 7, "@label\t") == 0) {
+            m.labels.push_back(line.substr(7));
+            continue;
+        } else if (line.compare(0, 6, "@hash\t") == 0) {
+            throw invalid_model("a model with hashed attributes cannot be exported", line);
+        } else if (line.compare(0, 1, "@") == 0) {
+            continue;
+        }
+
+        std::string::size_type pos = line.find('\t');
+        if (pos == line.npos) {
+            throw invalid_model("feature weight is missing", line);
+        }
+        if (++pos == line.size()) {
+            throw invalid_model("feature name is missing", line);
+        }
+
+        entry_type e;
+        e.weight = std::atof(line.c_str());
+        e.label = 0;
+        if (multi) {
+            std::string::size_type lpos = line.rfind('\t');
+            if (lpos < pos) {
+                throw invalid_model("label is missing", line);
+            }
+            std::vector<std::string>::const_iterator it = std::find(
+                m.labels.begin(), m.labels.end(), line.substr(lpos+1));
+            if (it == m.labels.end()) {
+                throw invalid_model("undeclared label", line);
+            }
+            e.label = (int)(it - m.labels.begin());
+            e.attribute = line.substr(pos, lpos-pos);
+        } else {
+            e.attribute = line.substr(pos);
+        }
+        if (e.weight != 0.) {
+            entries.push_back(e);
+        }
+    }
+
+    // Arrange the weights in the layout of a compiled model.
+    std::sort(entries.begin(), entries.end());
+    m.rows.push_back(0);
+    for (size_t i = 0;i < entries.size();++i) {
+        if (m.attributes.empty() || m.attributes.back() != entries[i].attribute) {
+            if (!m.attributes.empty()) {
+                m.rows.push_back(i);
+            }
+            m.attributes.push_back(entries[i].attribute);
+        } else if (entries[i].label == entries[i-1].label) {
+            throw invalid_model("duplicated feature", entries[i].attribute);
+        }
+        m.row_labels.push_back(entries[i].label);
+        m.row_weights.push_back(entries[i].weight);
+    }
+    if (!m.attributes.empty()) {
+        m.rows.push_back(entries.size());
+    }
+}
+
+/**
+ * The hash function of the attribute names in an exported model.
+ *  This must agree with attribute_hash() in the generated code; the value
+ *  is computed in 32 bits on any size of unsigned long.
+ *  @param  seed        The seed (0 for the displacement table).
+ *  @param  str         The pointer to the attribute name.
+ *  @param  n           The length of the attribute name.
+ */
+inline static unsigned long export_hash(unsigned long seed, const char *str, size_t n)
+{
+    unsigned long h = (2166136261UL ^ (seed * 2654435769UL)) & 0xFFFFFFFFUL;
+    for (size_t i = 0;i < n;++i) {
+        h ^= (unsigned char)str[i];
+        h = (h * 16777619UL) & 0xFFFFFFFFUL;
+    }
+    h ^= h >> 16;
+    h = (h * 2246822507UL) & 0xFFFFFFFFUL;
+    h ^= h >> 13;
+    return h;
+}
+
+static const char *export_hash_code =
+    "inline unsigned long attribute_hash(unsigned long seed, const char *str, size_t n)\n"
+    "{\n"
+    "    unsigned long h = (2166136261UL ^ (seed * 2654435769UL)) & 0xFFFFFFFFUL;\n"
+    "    for (size_t i = 0;i < n;++i) {\n"
+    "        h ^= (unsigned char)str[i];\n"
+    "        h = (h * 16777619UL) & 0xFFFFFFFFUL;\n"
+    "    }\n"
+    "    h ^= h >> 16;\n"
+    "    h = (h * 2246822507UL) & 0xFFFFFFFFUL;\n"
+    "    h ^= h >> 13;\n"
+    "    return h;\n"
+    "}\n";
+
+/**
+ * Builds a minimal perfect hash of attribute names (hash and displace).
+ *  The attributes are distributed to M buckets by export_hash(0, ...)
+ *  (M is the number of attributes). From the largest bucket, the seed d of
+ *  a bucket is searched so that export_hash(d, ...) % M puts the attributes
+ *  of the bucket into free slots; a bucket with a single attribute takes a
+ *  free slot directly, which is stored as -(slot+1).
+ *  @param  attributes      The attribute names.
+ *  @param  displacements   The seed or slot of every bucket.
+ *  @param  slots           The attribute placed in every slot.
+ */
+inline static void
+build_perfect_hash(
+    const std::vector<std::string>& attributes,
+    std::vector<int>& displacements,
+    std::vector<int>& slots
+    )
+{
+    const size_t M = attributes.size();
+    std::vector<std::vector<int> > buckets(M);
+    for (size_t i = 0;i < M;++i) {
+        const std::string& s = attributes[i];
+        buckets[export_hash(0, s.c_str(), s.length()) % M].push_back((int)i);
+    }
+
+    // Process the buckets in descending order of their sizes.
+    std::vector<std::pair<size_t, size_t> > order(M);
+    for (size_t b = 0;b < M;++b) {
+        order[b] = std::make_pair(M - buckets[b].size(), b);
+    }
+    std::sort(order.begin(), order.end());
+
+    displacements.assign(M, 0);
+    slots.assign(M, -1);
+    size_t i = 0;
+    std::vector<size_t> placed;
+    for (;i < M;++i) {
+        const std::vector<int>& bucket = buckets[order[i].second];
+        if (bucket.size() <= 1) {
+            break;
+        }
+
+        for (unsigned long d = 1;;++d) {
+            if (10000000UL < d) {
+                throw std::runtime_error("failed to build a perfect hash of the attributes");
+            }
+            placed.clear();
+            for (size_t j = 0;j < bucket.size();++j) {
+                const std::string& s = attributes[bucket[j]];
+                size_t p = export_hash(d, s.c_str(), s.length()) % M;
+                if (slots[p] != -1 ||
+                    std::find(placed.begin(), placed.end(), p) != placed.end()) {
+                    break;
+                }
+                placed.push_back(p);
+            }
+            if (placed.size() == bucket.size()) {
+                for (size_t j = 0;j < bucket.size();++j) {
+                    slots[placed[j]] = bucket[j];
+                }
+                displacements[order[i].second] = (int)d;
+                break;
+            }
+        }
+    }
+
+    // Put the attributes of the singleton buckets into the free slots.
+    size_t p = 0;
+    for (;i < M;++i) {
+        const std::vector<int>& bucket = buckets[order[i].second];
+        if (bucket.empty()) {
+            break;
+        }
+        while (slots[p] != -1) {
+            ++p;
+        }
+        slots[p] = bucket[0];
+        displacements[order[i].second] = -(int)p - 1;
+    }
+}
+
+/**
+ * A writer of an exported model.
+ */
+class export_writer
+{
+public:
+    enum {
+        WEIGHT_DOUBLE = 0,      /// Double precision.
+        WEIGHT_FLOAT,           /// Single precision.
+    };
+
+protected:
+    std::ostream& os;
+    const export_model& m;
+    std::string m_namespace;
+    int m_weight_type;
+
+    /// The attribute placed in every slot of the perfect hash.
+    std::vector<int> m_slots;
+    /// The seed or slot of every bucket of the perfect hash.
+    std::vector<int> m_displacements;
+    /// The slot of the bias feature, or -1.
+    int m_bias;
+    /// Whether the weights of a multi-class model are stored in a matrix.
+    bool m_dense;
+
+public:
+    /**
+     * Constructs the object.
+     *  @param  _os         The output stream for the code.
+     *  @param  _m          The model.
+     *  @param  name        The namespace of the code.
+     *  @param  weight_type The type of the weights (WEIGHT_*).
+     */
+    export_writer(std::ostream& _os, const export_model& _m, const std::string& name, int weight_type)
+        : os(_os), m(_m), m_namespace(name), m_weight_type(weight_type), m_bias(-1), m_dense(false)
+    {
+    }
+
+    /**
+     * Writes the header.
+     *  @param  source      The file name of the model for the comment.
+     */
+    void write(const std::string& source)
+    {
+        const size_t A = m.attributes.size();
+        const size_t L = m.labels.size();
+        if (A == 0) {
+            throw invalid_model("the model has no weight");
+        }
+
+        build_perfect_hash(m.attributes, m_displacements, m_slots);
+        if (m.type != MODEL_FILE_CANDIDATE) {
+            std::vector<std::string>::const_iterator it = std::lower_bound(
+                m.attributes.begin(), m.attributes.end(), std::string("__BIAS__"));
+            if (it != m.attributes.end() && *it == "__BIAS__") {
+                const int a = (int)(it - m.attributes.begin());
+                m_bias = (int)(std::find(m_slots.begin(), m_slots.end(), a) - m_slots.begin());
+            }
+        }
+
+        // Store the weights of a multi-class model in a matrix if the
+        // matrix is not larger than the sparse rows (labels and offsets).
+        const size_t wsize = (m_weight_type == WEIGHT_FLOAT ? sizeof(float) : sizeof(double));
+        m_dense = is_multi() && (
+            A * L * wsize <= m.num_weights() * (wsize + sizeof(int)) + (A + 1) * sizeof(size_t));
+
+        std::string guard = "__";
+        for (size_t i = 0;i < m_namespace.length();++i) {
+            guard += (char)std::toupper((unsigned char)m_namespace[i]);
+        }
+        guard += "_H__";
+
+        os << "/*" << std::endl;
+        os << " *\t\tA " << type_name() << " model exported by classias-export." << std::endl;
+        os << " *" << std::endl;
+        os << " * Generated from " << source << "; do not edit." << std::endl;
+        os << " */" << std::endl;
+        os << std::endl;
+        os << "#ifndef " << guard << std::endl;
+        os << "#define " << guard << std::endl;
+        os << std::endl;
+        os << "#include <cmath>" << std::endl;
+        os << "#include <cstddef>" << std::endl;
+        os << "#include <cstring>" << std::endl;
+        os << std::endl;
+        os << "namespace " << m_namespace << std::endl;
+        os << "{" << std::endl;
+        os << std::endl;
+        os << "enum {" << std::endl;
+        os << "    NUM_LABELS = " << L << "," << std::endl;
+        os << "    NUM_ATTRIBUTES = " << A << "," << std::endl;
+        os << "    BIAS = " << m_bias << std::endl;
+        os << "};" << std::endl;
+        os << std::endl;
+        os << "typedef " << (m_weight_type == WEIGHT_FLOAT ? "float" : "double") << " weight_type;" << std::endl;
+        os << std::endl;
+
+        write_tables();
+        write_find();
+        os << std::endl;
+        if (is_multi()) {
+            write_multi_classifier();
+        } else {
+            write_linear_classifier();
+        }
+
+        os << std::endl;
+        os << "}" << std::endl;
+        os << std::endl;
+        os << "#endif/*" << guard << "*/" << std::endl;
+    }
+
+protected:
+    bool is_multi() const
+    {
+        return (m.type == MODEL_FILE_MULTI_DENSE || m.type == MODEL_FILE_MULTI_SPARSE);
+    }
+
+    const char *type_name() const
+    {
+        switch (m.type) {
+        case MODEL_FILE_BINARY:
+            return "binary";
+        case MODEL_FILE_CANDIDATE:
+            return "candidate";
+        default:
+            return "multi-class";
+        }
+    }
+
+    void write_tables()
+    {
+        const size_t A = m.attributes.size();
+        const size_t L = m.labels.size();
+
+        if (0 < L) {
+            os << "/// The label names." << std::endl;
+            os << "static const char *const labels[NUM_LABELS] = {" << std::endl;
+            for (size_t l = 0;l < L;++l) {
+                os << "    " << quote(m.labels[l]) << "," << std::endl;
+            }
+            os << "};" << std::endl;
+            os << std::endl;
+        }
+
+        os << "/// The attribute names in the slots of the perfect hash." << std::endl;
+        os << "static const char *const attributes[NUM_ATTRIBUTES] = {" << std::endl;
+        for (size_t s = 0;s < A;++s) {
+            os << "    " << quote(m.attributes[m_slots[s]]) << "," << std::endl;
+        }
+        os << "};" << std::endl;
+        os << std::endl;
+
+        os << "/// The lengths of the attribute names." << std::endl;
+        os << "static const size_t attribute_lengths[NUM_ATTRIBUTES] = {";
+        for (size_t s = 0;s < A;++s) {
+            separate(s, 12);
+            os << m.attributes[m_slots[s]].length() << ",";
+        }
+        os << std::endl << "};" << std::endl;
+        os << std::endl;
+
+        os << "/// The seed (> 0) or slot (-1 - value) of every bucket of the perfect hash." << std::endl;
+        os << "static const int displacements[NUM_ATTRIBUTES] = {";
+        for (size_t b = 0;b < A;++b) {
+            separate(b, 12);
+            os << m_displacements[b] << ",";
+        }
+        os << std::endl << "};" << std::endl;
+        os << std::endl;
+
+        if (!is_multi()) {
+            os << "/// The weights of the attributes." << std::endl;
+            os << "static const weight_type weights[NUM_ATTRIBUTES] = {";
+            for (size_t s = 0;s < A;++s) {
+                const int a = m_slots[s];
+                separate(s, 4);
+                write_weight(m.rows[a] < m.rows[a+1] ? m.row_weights[m.rows[a]] : 0.);
+            }
+            os << std::endl << "};" << std::endl;
+            os << std::endl;
+
+        } else if (m_dense) {
+            os << "/// The weights of the attributes (rows) and labels (columns)." << std::endl;
+            os << "static const weight_type weights[NUM_ATTRIBUTES][NUM_LABELS] = {" << std::endl;
+            std::vector<double> row(L);
+            for (size_t s = 0;s < A;++s) {
+                const int a = m_slots[s];
+                std::fill(row.begin(), row.end(), 0.);
+                for (size_t k = m.rows[a];k < m.rows[a+1];++k) {
+                    row[m.row_labels[k]] = m.row_weights[k];
+                }
+                os << "    {";
+                for (size_t l = 0;l < L;++l) {
+                    if (l != 0 && l % 4 == 0) {
+                        os << std::endl << "    ";
+                    }
+                    write_weight(row[l]);
+                }
+                os << "}," << std::endl;
+            }
+            os << "};" << std::endl;
+            os << std::endl;
+
+        } else {
+            os << "/// The offsets of the weights of the attributes." << std::endl;
+            os << "static const size_t rows[NUM_ATTRIBUTES+1] = {";
+            size_t offset = 0;
+            for (size_t s = 0;s <= A;++s) {
+                separate(s, 8);
+                os << offset << ",";
+                if (s < A) {
+                    const int a = m_slots[s];
+                    offset += m.rows[a+1] - m.rows[a];
+                }
+            }
+            os << std::endl << "};" << std::endl;
+            os << std::endl;
+
+            os << "/// The labels of the weights." << std::endl;
+            os << "static const int row_labels[" << m.num_weights() << "] = {";
+            size_t i = 0;
+            for (size_t s = 0;s < A;++s) {
+                const int a = m_slots[s];
+                for (size_t k = m.rows[a];k < m.rows[a+1];++k, ++i) {
+                    separate(i, 12);
+                    os << m.row_labels[k] << ",";
+                }
+            }
+            os << std::endl << "};" << std::endl;
+            os << std::endl;
+
+            os << "/// The weights." << std::endl;
+            os << "static const weight_type row_weights[" << m.num_weights() << "] = {";
+            i = 0;
+            for (size_t s = 0;s < A;++s) {
+                const int a = m_slots[s];
+                for (size_t k = m.rows[a];k < m.rows[a+1];++k, ++i) {
+                    separate(i, 4);
+                    write_weight(m.row_weights[k]);
+                }
+            }
+            os << std::endl << "};" << std::endl;
+            os << std::endl;
+        }
+    }
+
+    void write_find()
+    {
+        os << export_hash_code;
+        os << std::endl;
+        os << "/**" << std::endl;
+        os << " * Finds an attribute." << std::endl;
+        os << " *  @param  str         The pointer to the attribute name." << std::endl;
+        os << " *  @param  n           The length of the attribute name." << std::endl;
+        os << " *  @return int         The attribute identifier, or -1 if the attribute is" << std::endl;
+        os << " *                      not in the model." << std::endl;
+        os << " */" << std::endl;
+        os << "inline int find(const char *str, size_t n)" << std::endl;
+        os << "{" << std::endl;
+        os << "    const int d = displacements[attribute_hash(0, str, n) % NUM_ATTRIBUTES];" << std::endl;
+        os << "    const int a = (d < 0) ?" << std::endl;
+        os << "        -d - 1 : (int)(attribute_hash((unsigned long)d, str, n) % NUM_ATTRIBUTES);" << std::endl;
+        os << "    if (attribute_lengths[a] == n && std::memcmp(attributes[a], str, n) == 0) {" << std::endl;
+        os << "        return a;" << std::endl;
+        os << "    }" << std::endl;
+        os << "    return -1;" << std::endl;
+        os << "}" << std::endl;
+        os << std::endl;
+        os << "inline int find(const char *str)" << std::endl;
+        os << "{" << std::endl;
+        os << "    return find(str, std::strlen(str));" << std::endl;
+        os << "}" << std::endl;
+    }
+
+    void write_linear_classifier()
+    {
+        const bool binary = (m.type == MODEL_FILE_BINARY);
+        os << "/**" << std::endl;
+        if (binary) {
+            os << " * A binary classifier." << std::endl;
+        } else {
+            os << " * A scorer of a candidate; the candidate with the highest score is the" << std::endl;
+            os << " * prediction for an instance." << std::endl;
+        }
+        os << " */" << std::endl;
+        os << "class classifier" << std::endl;
+        os << "{" << std::endl;
+        os << "protected:" << std::endl;
+        os << "    double m_score;" << std::endl;
+        os << std::endl;
+        os << "public:" << std::endl;
+        os << "    classifier()" << std::endl;
+        os << "    {" << std::endl;
+        os << "        clear();" << std::endl;
+        os << "    }" << std::endl;
+        os << std::endl;
+        os << "    void clear()" << std::endl;
+        os << "    {" << std::endl;
+        if (0 <= m_bias) {
+            os << "        m_score = weights[BIAS];" << std::endl;
+        } else {
+            os << "        m_score = 0.;" << std::endl;
+        }
+        os << "    }" << std::endl;
+        os << std::endl;
+        os << "    void add(int a, double value = 1.)" << std::endl;
+        os << "    {" << std::endl;
+        os << "        if (0 <= a) {" << std::endl;
+        os << "            m_score += weights[a] * value;" << std::endl;
+        os << "        }" << std::endl;
+        os << "    }" << std::endl;
+        write_add_name();
+        os << std::endl;
+        os << "    double score() const" << std::endl;
+        os << "    {" << std::endl;
+        os << "        return m_score;" << std::endl;
+        os << "    }" << std::endl;
+        if (binary) {
+            os << std::endl;
+            os << "    double prob() const" << std::endl;
+            os << "    {" << std::endl;
+            os << "        return (-100. < m_score ? 1. / (1. + std::exp(-m_score)) : 0.);" << std::endl;
+            os << "    }" << std::endl;
+            os << std::endl;
+            os << "    bool label() const" << std::endl;
+            os << "    {" << std::endl;
+            os << "        return (0. < m_score);" << std::endl;
+            os << "    }" << std::endl;
+        }
+        os << "};" << std::endl;
+    }
+
+    void write_multi_classifier()
+    {
+        os << "/**" << std::endl;
+        os << " * A multi-class classifier." << std::endl;
+        os << " *  Call finalize() after adding the attributes to compute prob()." << std::endl;
+        os << " */" << std::endl;
+        os << "class classifier" << std::endl;
+        os << "{" << std::endl;
+        os << "protected:" << std::endl;
+        os << "    double m_scores[NUM_LABELS];" << std::endl;
+        os << "    double m_probs[NUM_LABELS];" << std::endl;
+        os << std::endl;
+        os << "public:" << std::endl;
+        os << "    classifier()" << std::endl;
+        os << "    {" << std::endl;
+        os << "        clear();" << std::endl;
+        os << "    }" << std::endl;
+        os << std::endl;
+        os << "    void clear()" << std::endl;
+        os << "    {" << std::endl;
+        os << "        for (int l = 0;l < NUM_LABELS;++l) {" << std::endl;
+        os << "            m_scores[l] = 0.;" << std::endl;
+        os << "            m_probs[l] = 0.;" << std::endl;
+        os << "        }" << std::endl;
+        if (0 <= m_bias) {
+            os << "        add(BIAS, 1.);" << std::endl;
+        }
+        os << "    }" << std::endl;
+        os << std::endl;
+        os << "    void add(int a, double value = 1.)" << std::endl;
+        os << "    {" << std::endl;
+        os << "        if (0 <= a) {" << std::endl;
+        if (m_dense) {
+            os << "            const weight_type* w = weights[a];" << std::endl;
+            os << "            for (int l = 0;l < NUM_LABELS;++l) {" << std::endl;
+            os << "                m_scores[l] += w[l] * value;" << std::endl;
+            os << "            }" << std::endl;
+        } else {
+            os << "            for (size_t k = rows[a];k < rows[a+1];++k) {" << std::endl;
+            os << "                m_scores[row_labels[k]] += row_weights[k] * value;" << std::endl;
+            os << "            }" << std::endl;
+        }
+        os << "        }" << std::endl;
+        os << "    }" << std::endl;
+        write_add_name();
+        os << std::endl;
+        os << "    void finalize()" << std::endl;
+        os << "    {" << std::endl;
+        os << "        const double smax = m_scores[argmax()];" << std::endl;
+        os << "        double sum = 0.;" << std::endl;
+        os << "        for (int l = 0;l < NUM_LABELS;++l) {" << std::endl;
+        os << "            m_probs[l] = std::exp(m_scores[l] - smax);" << std::endl;
+        os << "            sum += m_probs[l];" << std::endl;
+        os << "        }" << std::endl;
+        os << "        for (int l = 0;l < NUM_LABELS;++l) {" << std::endl;
+        os << "            m_probs[l] /= sum;" << std::endl;
+        os << "        }" << std::endl;
+        os << "    }" << std::endl;
+        os << std::endl;
+        os << "    int argmax() const" << std::endl;
+        os << "    {" << std::endl;
+        os << "        int l = 0;" << std::endl;
+        os << "        for (int i = 1;i < NUM_LABELS;++i) {" << std::endl;
+        os << "            if (m_scores[l] < m_scores[i]) {" << std::endl;
+        os << "                l = i;" << std::endl;
+        os << "            }" << std::endl;
+        os << "        }" << std::endl;
+        os << "        return l;" << std::endl;
+        os << "    }" << std::endl;
+        os << std::endl;
+        os << "    double score(int l) const" << std::endl;
+        os << "    {" << std::endl;
+        os << "        return m_scores[l];" << std::endl;
+        os << "    }" << std::endl;
+        os << std::endl;
+        os << "    double prob(int l) const" << std::endl;
+        os << "    {" << std::endl;
+        os << "        return m_probs[l];" << std::endl;
+        os << "    }" << std::endl;
+        os << "};" << std::endl;
+    }
+
+    void write_add_name()
+    {
+        os << std::endl;
+        os << "    void add(const char *str, size_t n, double value = 1.)" << std::endl;
+        os << "    {" << std::endl;
+        os << "        add(find(str, n), value);" << std::endl;
+        os << "    }" << std::endl;
+        os << std::endl;
+        os << "    void add(const char *str, double value = 1.)" << std::endl;
+        os << "    {" << std::endl;
+        os << "        add(find(str), value);" << std::endl;
+        os << "    }" << std::endl;
+    }
+
+    void separate(size_t i, size_t n)
+    {
+        if (i % n == 0) {
+            os << std::endl << "    ";
+        } else {
+            os << ' ';
+        }
+    }
+
+    /**
+     * Writes a weight with the shortest digits that read back as the same
+     * value of the weight type.
+     */
+    void write_weight(double w)
+    {
+        char buffer[64];
+        if (m_weight_type == WEIGHT_FLOAT) {
+            const float f = (float)w;
+            for (int digits = 6;digits <= 9;++digits) {
+                std::snprintf(buffer, sizeof(buffer), "%.*g", digits, (double)f);
+                if ((float)std::strtod(buffer, NULL) == f) {
+                    break;
+                }
+            }
+            os << buffer << (std::strpbrk(buffer, ".en") == NULL ? ".f," : "f,");
+        } else {
+            for (int digits = 15;digits <= 17;++digits) {
+                std::snprintf(buffer, sizeof(buffer), "%.*g", digits, w);
+                if (std::strtod(buffer, NULL) == w) {
+                    break;
+                }
+            }
+            os << buffer << ",";
+        }
+    }
+
+    /**
+     * Quotes a string as a C++ string literal.
+     *  Characters other than printable ASCII ones are written in octal,
+     *  and '?' is escaped against trigraphs.
+     */
+    static std::string quote(const std::string& str)
+    {
+        std::string ret = "\"";
+        for (size_t i = 0;i < str.length();++i) {
+            const unsigned char c = (unsigned char)str[i];
+            if (c == '"' || c == '\\' || c == '?') {
+                ret += '\\';
+                ret += (char)c;
+            } else if (c < 0x20 || 0x7F <= c) {
+                char buffer[8];
+                std::snprintf(buffer, sizeof(buffer), "\\%03o", (unsigned int)c);
+                ret += buffer;
+            } else {
+                ret += (char)c;
+            }
+        }
+        ret += '"';
+        return ret;
+    }
+};
+
+#endif/*__EXPORT_H__*/
@@ -0,0 +1,215 @@
+/*
+ *		Frontend for exporting a model as C++ code.
+ *
+ * Copyright (c) 2008,2009 Naoaki Okazaki
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the names of the authors nor the names of its contributors
+ *       may be used to endorse or promote products derived from this
+ *       software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* $Id$ */
+
+#ifdef  HAVE_CONFIG_H
+#include <config.h>
+#endif/*HAVE_CONFIG_H*/
+
+#include <cctype>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <typeinfo>
+#include <classias/version.h>
+#include <optparse.h>
+#include <model_file.h>
+
+#include "option.h"
+#include "export.h"
+
+class optionparser : public option, public optparse
+{
+public:
+    optionparser(
+        std::istream& _is = std::cin,
+        std::ostream& _os = std::cout,
+        std::ostream& _es = std::cerr
+        ) : option(_is, _os, _es)
+    {
+    }
+
+    BEGIN_OPTION_MAP_INLINE()
+        ON_OPTION_WITH_ARG(SHORTOPT('m') || LONGOPT("model"))
+            model = arg;
+
+        ON_OPTION_WITH_ARG(SHORTOPT('o') || LONGOPT("output"))
+            output = arg;
+
+        ON_OPTION_WITH_ARG(SHORTOPT('n') || LONGOPT("namespace"))
+            bool valid = (*arg != 0 && !std::isdigit((unsigned char)*arg));
+            for (const char *p = arg;*p;++p) {
+                if (!std::isalnum((unsigned char)*p) && *p != '_') {
+                    valid = false;
+                }
+            }
+            if (!valid) {
+                std::stringstream ss;
+                ss << "the namespace must be a C++ identifier: " << arg;
+                throw invalid_value(ss.str());
+            }
+            name = arg;
+
+        ON_OPTION_WITH_ARG(LONGOPT("weight-type"))
+            if (strcmp(arg, "double") == 0) {
+                weight_type = WEIGHT_DOUBLE;
+            } else if (strcmp(arg, "float") == 0) {
+                weight_type = WEIGHT_FLOAT;
+            } else {
+                std::stringstream ss;
+                ss << "unknown weight type specified: " << arg;
+                throw invalid_value(ss.str());
+            }
+
+        ON_OPTION(SHORTOPT('v') || LONGOPT("version"))
+            mode = MODE_VERSION;
+
+        ON_OPTION(SHORTOPT('h') || LONGOPT("help"))
+            mode = MODE_HELP;
+
+    END_OPTION_MAP()
+};
+
+static void usage(std::ostream& os, const char *argv0)
+{
+    os << "USAGE: " << argv0 << " [OPTIONS]" << std::endl;
+    os << "This utility writes a model as a self-contained C++ header, which finds" << std::endl;
+    os << "attributes by a perfect hash and scores instances on constant tables of the" << std::endl;
+    os << "weights without loading files or allocating memory." << std::endl;
+    os << std::endl;
+    os << "OPTIONS:" << std::endl;
+    os << "  -m, --model=FILE      load the model from FILE (a text model or a compiled" << std::endl;
+    os << "                        model; a model with hashed attributes is not supported)" << std::endl;
+    os << "  -o, --output=FILE     write the header to FILE (DEFAULT: STDOUT)" << std::endl;
+    os << "  -n, --namespace=NAME  put the code in the namespace NAME" << std::endl;
+    os << "                        (DEFAULT='classias_model')" << std::endl;
+    os << "      --weight-type=TYPE store the weights in TYPE (DEFAULT='double'):" << std::endl;
+    os << "      double                double precision" << std::endl;
+    os << "      float                 single precision" << std::endl;
+    os << "  -v, --version         show the version and copyright information" << std::endl;
+    os << "  -h, --help            show this help message and exit" << std::endl;
+    os << std::endl;
+    os << "The header defines a class 'classifier' in the namespace: add(name, value)" << std::endl;
+    os << "accumulates the weights of an attribute, and score(), prob(), and label()" << std::endl;
+    os << "(binary) or finalize(), score(l), prob(l), and argmax() (multi-class) return" << std::endl;
+    os << "the results; a candidate model scores a candidate by score()." << std::endl;
+    os << std::endl;
+}
+
+static int export_model_file(option& opt)
+{
+    std::ostream& es = opt.es;
+    export_model m;
+
+    try {
+        // Read a compiled model or a text model.
+        model_file mf;
+        if (mf.open(opt.model)) {
+            read_compiled_model(m, mf);
+        } else {
+            std::ifstream ifs(opt.model.c_str());
+            if (ifs.fail()) {
+                es << "ERROR: failed to open the model file: " << opt.model << std::endl;
+                return 1;
+            }
+            read_text_model(m, ifs);
+        }
+
+        const int weight_type = (opt.weight_type == option::WEIGHT_FLOAT ?
+            export_writer::WEIGHT_FLOAT : export_writer::WEIGHT_DOUBLE);
+
+        // Write the header.
+        if (opt.output.empty()) {
+            export_writer writer(opt.os, m, opt.name, weight_type);
+            writer.write(opt.model);
+            opt.os.flush();
+        } else {
+            std::ofstream ofs(opt.output.c_str());
+            if (ofs.fail()) {
+                es << "ERROR: failed to open the output file: " << opt.output << std::endl;
+                return 1;
+            }
+            export_writer writer(ofs, m, opt.name, weight_type);
+            writer.write(opt.model);
+            ofs.close();
+            if (ofs.fail()) {
+                es << "ERROR: failed to write the output file: " << opt.output << std::endl;
+                return 1;
+            }
+        }
+    } catch (const std::exception& e) {
+        es << "ERROR: " << typeid(e).name() << ": " << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    int ret = 0;
+    optionparser opt;
+
+    std::ostream& os = opt.os;
+    std::ostream& es = opt.es;
+
+    // Parse the command-line options.
+    try { 
+        opt.parse(argv, argc);
+    } catch (const optparse::unrecognized_option& e) {
+        es << "ERROR: unrecognized option: " << e.what() << std::endl;
+        return 1;
+    } catch (const optparse::invalid_value& e) {
+        es << "ERROR: " << e.what() << std::endl;
+        return 1;
+    }
+
+    // Show the help message and exit.
+    if (opt.mode == option::MODE_HELP) {
+        usage(os, argv[0]);
+        return ret;
+    } else if (opt.mode == option::MODE_VERSION) {
+        // Show the copyright information.
+        os << CLASSIAS_NAME " ";
+        os << CLASSIAS_VERSION << " ";
+        os << "exporter ";
+        os << CLASSIAS_COPYRIGHT << std::endl;
+        os << std::endl;
+        return ret;
+    }
+
+    if (opt.model.empty()) {
+        es << "ERROR: no model specified (-m)" << std::endl;
+        return 1;
+    }
+
+    return export_model_file(opt);
+}
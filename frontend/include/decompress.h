@@ -0,0 +1,987 @@
+/*
+ *		In-process decompression of input streams.
+ *
+ * Copyright (c) 2008,2009 Naoaki Okazaki
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the names of the authors nor the names of its contributors
+ *       may be used to endorse or promote products derived from this
+ *       software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* $Id$ */
+
+#ifndef __DECOMPRESS_H__
+#define __DECOMPRESS_H__
+
+#include <algorithm>
+#include <cstring>
+#include <streambuf>
+#include <string>
+#include <vector>
+#include <classias/thread.h>
+#include <util.h>
+
+#if     defined(HAVE_ZLIB_H) && defined(HAVE_LIBZ)
+#define DECOMPRESS_GZIP
+#include <zlib.h>
+#endif/*defined(HAVE_ZLIB_H) && defined(HAVE_LIBZ)*/
+
+#if     defined(HAVE_BZLIB_H) && defined(HAVE_LIBBZ2)
+#define DECOMPRESS_BZIP2
+#include <bzlib.h>
+#endif/*defined(HAVE_BZLIB_H) && defined(HAVE_LIBBZ2)*/
+
+#if     defined(HAVE_LZMA_H) && defined(HAVE_LIBLZMA)
+#define DECOMPRESS_XZ
+#include <lzma.h>
+#endif/*defined(HAVE_LZMA_H) && defined(HAVE_LIBLZMA)*/
+
+#if     defined(HAVE_ZSTD_H) && defined(HAVE_LIBZSTD)
+#define DECOMPRESS_ZSTD
+#include <zstd.h>
+#include <zstd_errors.h>
+#endif/*defined(HAVE_ZSTD_H) && defined(HAVE_LIBZSTD)*/
+
+/**
+ * The size of the buffers for compressed and decompressed bytes.
+ */
+#define DECOMPRESS_BUFFER_SIZE  (1 << 18)
+
+/**
+ * The number of compressed bytes given to a thread at a time.
+ */
+#define DECOMPRESS_BLOCK_SIZE   (1 << 20)
+
+/**
+ * The maximum size of a compressed frame decoded by a thread.
+ */
+#define DECOMPRESS_MAX_FRAME    (1 << 26)
+
+/**
+ * A buffer of bytes read from a source stream.
+ */
+class compressed_input
+{
+protected:
+    std::streambuf* m_src;
+    std::vector<char> m_buffer;
+    size_t m_begin;
+    size_t m_end;
+    bool m_eof;
+
+public:
+    /**
+     * Constructs a buffer.
+     *  @param  src         The source stream.
+     */
+    compressed_input(std::streambuf* src)
+        : m_src(src), m_buffer(DECOMPRESS_BUFFER_SIZE),
+        m_begin(0), m_end(0), m_eof(false)
+    {
+    }
+
+    /**
+     * Returns the pointer to the bytes in the buffer.
+     *  @return const char* The pointer to the first byte.
+     */
+    inline const char* data() const
+    {
+        return &m_buffer[0] + m_begin;
+    }
+
+    /**
+     * Returns the number of bytes in the buffer.
+     *  @return size_t      The number of bytes.
+     */
+    inline size_t size() const
+    {
+        return m_end - m_begin;
+    }
+
+    /**
+     * Removes bytes from the beginning of the buffer.
+     *  @param  n           The number of bytes.
+     */
+    inline void consume(size_t n)
+    {
+        m_begin += n;
+    }
+
+    /**
+     * Reads bytes from the source stream until the buffer has n bytes.
+     *  Existing bytes move to the beginning of the buffer, the buffer grows
+     *  if it is smaller than n bytes, and the remaining space is filled.
+     *  @param  n           The number of bytes required.
+     *  @param  partial     \c true to read only the bytes available without
+     *                      blocking (after at least one byte).
+     *  @return bool        \c true if the buffer has n bytes; \c false if
+     *                      the source stream ended before.
+     */
+    bool fill(size_t n = 1, bool partial = false)
+    {
+        if (m_begin == m_end) {
+            m_begin = m_end = 0;
+        } else if (0 < m_begin) {
+            std::memmove(&m_buffer[0], &m_buffer[m_begin], m_end - m_begin);
+            m_end -= m_begin;
+            m_begin = 0;
+        }
+        if (m_buffer.size() < n) {
+            m_buffer.resize(std::max(n, m_buffer.size() * 2));
+        }
+
+        while (size() < n && !m_eof) {
+            std::streamsize k = (std::streamsize)(m_buffer.size() - m_end);
+            if (partial) {
+                std::streamsize avail = m_src->in_avail();
+                if (avail <= 0) {
+                    if (m_src->sgetc() == std::streambuf::traits_type::eof()) {
+                        m_eof = true;
+                        break;
+                    }
+                    avail = std::max(m_src->in_avail(), (std::streamsize)1);
+                }
+                k = std::min(k, avail);
+            }
+            k = m_src->sgetn(&m_buffer[m_end], k);
+            if (k <= 0) {
+                m_eof = true;
+            } else {
+                m_end += (size_t)k;
+            }
+        }
+        return n <= size();
+    }
+};
+
+/**
+ * A decoder of a compressed stream.
+ */
+class stream_decoder
+{
+public:
+    virtual ~stream_decoder()
+    {
+    }
+
+    /**
+     * Decodes the next bytes.
+     *  @param  p           The pointer receiving the decoded bytes, which
+     *                      are valid until the next call.
+     *  @param  n           The number of the decoded bytes (not zero).
+     *  @return bool        \c false at the end of the stream.
+     *  @throws invalid_data    The stream is corrupted or truncated.
+     */
+    virtual bool next(const char*& p, size_t& n) = 0;
+};
+
+/**
+ * A decoder passing uncompressed bytes through.
+ */
+class raw_decoder : public stream_decoder
+{
+protected:
+    compressed_input& m_in;
+
+public:
+    raw_decoder(compressed_input& in) : m_in(in)
+    {
+    }
+
+    virtual bool next(const char*& p, size_t& n)
+    {
+        if (m_in.size() == 0 && !m_in.fill(1, true)) {
+            return false;
+        }
+        p = m_in.data();
+        n = m_in.size();
+        m_in.consume(n);
+        return true;
+    }
+};
+
+#ifdef  DECOMPRESS_GZIP
+/**
+ * A decoder of gzip streams (with any number of members) by zlib.
+ */
+class gzip_decoder : public stream_decoder
+{
+protected:
+    compressed_input& m_in;
+    std::vector<char> m_out;
+    z_stream m_strm;
+    bool m_end;
+
+public:
+    gzip_decoder(compressed_input& in)
+        : m_in(in), m_out(DECOMPRESS_BUFFER_SIZE), m_end(false)
+    {
+        std::memset(&m_strm, 0, sizeof(m_strm));
+        if (inflateInit2(&m_strm, 15 + 16) != Z_OK) {
+            throw invalid_data("failed to initialize zlib");
+        }
+    }
+
+    virtual ~gzip_decoder()
+    {
+        inflateEnd(&m_strm);
+    }
+
+    virtual bool next(const char*& p, size_t& n)
+    {
+        m_strm.next_out = (Bytef*)&m_out[0];
+        m_strm.avail_out = (uInt)m_out.size();
+        while (!m_end && m_strm.avail_out != 0) {
+            if (m_in.size() == 0) {
+                m_in.fill();
+            }
+            const size_t avail = m_in.size();
+            m_strm.next_in = (Bytef*)m_in.data();
+            m_strm.avail_in = (uInt)avail;
+            int ret = inflate(&m_strm, Z_NO_FLUSH);
+            m_in.consume(avail - m_strm.avail_in);
+
+            if (ret == Z_STREAM_END) {
+                // Continue with the next member if any.
+                if (m_in.size() == 0 && !m_in.fill()) {
+                    m_end = true;
+                } else {
+                    inflateReset(&m_strm);
+                }
+            } else if (ret == Z_BUF_ERROR) {
+                if (avail == 0) {
+                    throw invalid_data("gzip: unexpected end of the stream");
+                }
+            } else if (ret != Z_OK) {
+                throw invalid_data(
+                    std::string("gzip: ") +
+                    (m_strm.msg != NULL ? m_strm.msg : "corrupted data"));
+            }
+        }
+        p = &m_out[0];
+        n = m_out.size() - m_strm.avail_out;
+        return 0 < n;
+    }
+};
+#endif/*DECOMPRESS_GZIP*/
+
+#ifdef  DECOMPRESS_BZIP2
+/**
+ * A decoder of bzip2 streams (with any number of streams) by libbz2.
+ */
+class bzip2_decoder : public stream_decoder
+{
+protected:
+    compressed_input& m_in;
+    std::vector<char> m_out;
+    bz_stream m_strm;
+    bool m_end;
+
+    void init()
+    {
+        std::memset(&m_strm, 0, sizeof(m_strm));
+        if (BZ2_bzDecompressInit(&m_strm, 0, 0) != BZ_OK) {
+            throw invalid_data("failed to initialize libbz2");
+        }
+    }
+
+public:
+    bzip2_decoder(compressed_input& in)
+        : m_in(in), m_out(DECOMPRESS_BUFFER_SIZE), m_end(false)
+    {
+        init();
+    }
+
+    virtual ~bzip2_decoder()
+    {
+        BZ2_bzDecompressEnd(&m_strm);
+    }
+
+    virtual bool next(const char*& p, size_t& n)
+    {
+        m_strm.next_out = &m_out[0];
+        m_strm.avail_out = (unsigned int)m_out.size();
+        while (!m_end && m_strm.avail_out != 0) {
+            if (m_in.size() == 0) {
+                m_in.fill();
+            }
+            const size_t avail = m_in.size();
+            const unsigned int avail_out = m_strm.avail_out;
+            m_strm.next_in = const_cast<char*>(m_in.data());
+            m_strm.avail_in = (unsigned int)avail;
+            int ret = BZ2_bzDecompress(&m_strm);
+            m_in.consume(avail - m_strm.avail_in);
+
+            if (ret == BZ_STREAM_END) {
+                // Continue with the next stream if any.
+                if (m_in.size() == 0 && !m_in.fill()) {
+                    m_end = true;
+                } else {
+                    char* next_out = m_strm.next_out;
+                    unsigned int left = m_strm.avail_out;
+                    BZ2_bzDecompressEnd(&m_strm);
+                    init();
+                    m_strm.next_out = next_out;
+                    m_strm.avail_out = left;
+                }
+            } else if (ret != BZ_OK) {
+                throw invalid_data("bzip2: corrupted data");
+            } else if (avail == 0 && m_strm.avail_out == avail_out) {
+                throw invalid_data("bzip2: unexpected end of the stream");
+            }
+        }
+        p = &m_out[0];
+        n = m_out.size() - m_strm.avail_out;
+        return 0 < n;
+    }
+};
+#endif/*DECOMPRESS_BZIP2*/
+
+#ifdef  DECOMPRESS_XZ
+/**
+ * A decoder of xz streams (with any number of streams) by liblzma.
+ */
+class xz_decoder : public stream_decoder
+{
+protected:
+    compressed_input& m_in;
+    std::vector<char> m_out;
+    lzma_stream m_strm;
+    bool m_end;
+
+public:
+    xz_decoder(compressed_input& in)
+        : m_in(in), m_out(DECOMPRESS_BUFFER_SIZE), m_end(false)
+    {
+        lzma_stream init = LZMA_STREAM_INIT;
+        m_strm = init;
+        if (lzma_stream_decoder(&m_strm, ~(uint64_t)0, LZMA_CONCATENATED) != LZMA_OK) {
+            throw invalid_data("failed to initialize liblzma");
+        }
+    }
+
+    virtual ~xz_decoder()
+    {
+        lzma_end(&m_strm);
+    }
+
+    virtual bool next(const char*& p, size_t& n)
+    {
+        m_strm.next_out = (uint8_t*)&m_out[0];
+        m_strm.avail_out = m_out.size();
+        while (!m_end && m_strm.avail_out != 0) {
+            if (m_in.size() == 0) {
+                m_in.fill();
+            }
+            const size_t avail = m_in.size();
+            m_strm.next_in = (const uint8_t*)m_in.data();
+            m_strm.avail_in = avail;
+            lzma_ret ret = lzma_code(&m_strm, avail == 0 ? LZMA_FINISH : LZMA_RUN);
+            m_in.consume(avail - m_strm.avail_in);
+
+            if (ret == LZMA_STREAM_END) {
+                m_end = true;
+            } else if (ret == LZMA_BUF_ERROR) {
+                throw invalid_data("xz: unexpected end of the stream");
+            } else if (ret != LZMA_OK) {
+                throw invalid_data("xz: corrupted data");
+            }
+        }
+        p = &m_out[0];
+        n = m_out.size() - m_strm.avail_out;
+        return 0 < n;
+    }
+};
+#endif/*DECOMPRESS_XZ*/
+
+#ifdef  DECOMPRESS_ZSTD
+/**
+ * A decoder of zstd streams (with any number of frames) by libzstd.
+ */
+class zstd_decoder : public stream_decoder
+{
+protected:
+    compressed_input& m_in;
+    std::vector<char> m_out;
+    ZSTD_DStream* m_strm;
+    size_t m_hint;
+    bool m_end;
+
+public:
+    zstd_decoder(compressed_input& in)
+        : m_in(in), m_out(DECOMPRESS_BUFFER_SIZE), m_strm(ZSTD_createDStream()),
+        m_hint(1), m_end(false)
+    {
+        if (m_strm == NULL || ZSTD_isError(ZSTD_initDStream(m_strm))) {
+            throw invalid_data("failed to initialize libzstd");
+        }
+    }
+
+    virtual ~zstd_decoder()
+    {
+        ZSTD_freeDStream(m_strm);
+    }
+
+    virtual bool next(const char*& p, size_t& n)
+    {
+        ZSTD_outBuffer out = {&m_out[0], m_out.size(), 0};
+        while (!m_end && out.pos < out.size) {
+            if (m_in.size() == 0 && !m_in.fill() && m_hint == 0) {
+                // The last frame is complete.
+                m_end = true;
+                break;
+            }
+            const size_t pos = out.pos;
+            ZSTD_inBuffer in = {m_in.data(), m_in.size(), 0};
+            m_hint = ZSTD_decompressStream(m_strm, &out, &in);
+            if (ZSTD_isError(m_hint)) {
+                throw invalid_data(
+                    std::string("zstd: ") + ZSTD_getErrorName(m_hint));
+            }
+            m_in.consume(in.pos);
+            if (in.size == 0 && out.pos == pos) {
+                throw invalid_data("zstd: unexpected end of the stream");
+            }
+        }
+        p = &m_out[0];
+        n = out.pos;
+        return 0 < n;
+    }
+};
+#endif/*DECOMPRESS_ZSTD*/
+
+/**
+ * Decodes a complete member (a gzip member or zstd frame) to a buffer.
+ *  This is the work of a thread of parallel_decoder.
+ */
+struct member_task
+{
+    /// The format of the member (decompress_streambuf::FORMAT_*).
+    int format;
+    /// The pointer to the first compressed member.
+    const char* first;
+    /// The offset of the members from the beginning of the input.
+    size_t offset;
+    /// The sizes of the consecutive compressed members.
+    std::vector<size_t> sizes;
+    /// The decoded bytes.
+    std::vector<char> output;
+    /// The error message if the members could not be decoded.
+    std::string error;
+
+    void run()
+    {
+        output.clear();
+        try {
+            const char* p = first;
+            for (size_t i = 0;i < sizes.size();++i) {
+                decode(p, sizes[i]);
+                p += sizes[i];
+            }
+        } catch (const std::exception& e) {
+            error = e.what();
+        }
+    }
+
+protected:
+    void decode(const char* p, size_t n);
+};
+
+/**
+ * A decoder running threads on independent members of a stream.
+ *  A gzip stream with the BGZF extra field (bgzip) stores the size of every
+ *  member in its header, and the size of a zstd frame can be found from its
+ *  headers; the members of such streams are distributed to threads and the
+ *  decoded bytes are returned in the order of the stream. The decoder falls
+ *  back to a sequential decoder at the first member whose size is unknown.
+ */
+class parallel_decoder : public stream_decoder
+{
+protected:
+    compressed_input& m_in;
+    int m_format;
+    std::vector<member_task> m_tasks;
+    size_t m_current;
+    stream_decoder* m_sequential;
+
+public:
+    /**
+     * Constructs a decoder.
+     *  @param  in          The compressed input.
+     *  @param  format      The format (decompress_streambuf::FORMAT_*).
+     *  @param  threads     The number of threads.
+     */
+    parallel_decoder(compressed_input& in, int format, int threads)
+        : m_in(in), m_format(format), m_tasks(threads), m_current(threads),
+        m_sequential(NULL)
+    {
+        for (size_t i = 0;i < m_tasks.size();++i) {
+            m_tasks[i].format = format;
+        }
+    }
+
+    virtual ~parallel_decoder()
+    {
+        delete m_sequential;
+    }
+
+    /**
+     * Finds the size of a member.
+     *  @param  format      The format (decompress_streambuf::FORMAT_*).
+     *  @param  p           The pointer to the beginning of the member.
+     *  @param  n           The number of bytes available.
+     *  @param  need        Receives the number of bytes required to find the
+     *                      size if the return value is zero.
+     *  @return size_t      The size of the member; zero if more bytes are
+     *                      required; \c (size_t)-1 if the size is unknown.
+     */
+    static size_t member_size(int format, const char* p, size_t n, size_t& need);
+
+    virtual bool next(const char*& p, size_t& n);
+
+protected:
+    bool decode_members();
+};
+
+/**
+ * A stream buffer decompressing the bytes from another stream buffer.
+ *  The format is detected from the magic bytes at the beginning of the
+ *  source: gzip, bzip2, xz, and zstd are decoded if the corresponding
+ *  library is available, and any other stream is passed through as it is.
+ */
+class decompress_streambuf : public std::streambuf
+{
+public:
+    enum {
+        FORMAT_NONE = 0,
+        FORMAT_GZIP,
+        FORMAT_BZIP2,
+        FORMAT_XZ,
+        FORMAT_ZSTD
+    };
+
+protected:
+    compressed_input m_in;
+    stream_decoder* m_decoder;
+    int m_format;
+    std::string m_error;
+
+public:
+    /**
+     * Constructs a stream buffer.
+     *  @param  src         The source stream buffer.
+     *  @param  threads     The number of threads for decoding independent
+     *                      members of a stream.
+     */
+    decompress_streambuf(std::streambuf* src, int threads = 1)
+        : m_in(src), m_decoder(NULL), m_format(FORMAT_NONE)
+    {
+        try {
+            m_format = detect();
+            m_decoder = create(threads);
+        } catch (const std::exception& e) {
+            m_error = e.what();
+        }
+    }
+
+    virtual ~decompress_streambuf()
+    {
+        delete m_decoder;
+    }
+
+    /**
+     * Returns the format of the source.
+     *  @return int         The format (FORMAT_*).
+     */
+    int format() const
+    {
+        return m_format;
+    }
+
+    /**
+     * Returns the name of the format of the source.
+     *  @return const char* The name, or an empty string if not compressed.
+     */
+    const char* format_name() const
+    {
+        switch (m_format) {
+        case FORMAT_GZIP:   return "gzip";
+        case FORMAT_BZIP2:  return "bzip2";
+        case FORMAT_XZ:     return "xz";
+        case FORMAT_ZSTD:   return "zstd";
+        }
+        return "";
+    }
+
+    /**
+     * Tests whether the source can be decoded in this process.
+     *  @return bool        \c false if the library for the compression
+     *                      format is unavailable.
+     */
+    bool supported() const
+    {
+        return m_decoder != NULL || !m_error.empty();
+    }
+
+    /**
+     * Passes the bytes of the source through without decoding them.
+     *  This is for a source to be decoded by an external command when the
+     *  library for its compression format is unavailable.
+     */
+    void pass()
+    {
+        delete m_decoder;
+        m_decoder = new raw_decoder(m_in);
+    }
+
+    /**
+     * Returns the error that stopped decoding.
+     *  @return const std::string&  The error message, or an empty string.
+     */
+    const std::string& error() const
+    {
+        return m_error;
+    }
+
+protected:
+    virtual int_type underflow()
+    {
+        if (gptr() < egptr()) {
+            return traits_type::to_int_type(*gptr());
+        }
+        if (m_decoder == NULL || !m_error.empty()) {
+            return traits_type::eof();
+        }
+
+        try {
+            const char* p = NULL;
+            size_t n = 0;
+            if (!m_decoder->next(p, n)) {
+                return traits_type::eof();
+            }
+            char* q = const_cast<char*>(p);
+            setg(q, q, q + n);
+            return traits_type::to_int_type(*gptr());
+        } catch (const std::exception& e) {
+            m_error = e.what();
+            return traits_type::eof();
+        }
+    }
+
+    int detect()
+    {
+        static const char* magics[] = {
+            "", "\x1F\x8B", "BZh", "\xFD" "7zXZ\x00", "\x28\xB5\x2F\xFD",
+        };
+        static const size_t lengths[] = {0, 2, 3, 6, 4};
+
+        // Read the bytes only while they may be a magic number so that an
+        // uncompressed stream is passed on without waiting for more bytes.
+        for (size_t n = 1;n <= 6;++n) {
+            if (m_in.size() < n && !m_in.fill(n, true)) {
+                return FORMAT_NONE;
+            }
+            bool prefix = false;
+            for (int f = FORMAT_GZIP;f <= FORMAT_ZSTD;++f) {
+                const size_t k = std::min(n, lengths[f]);
+                if (std::memcmp(m_in.data(), magics[f], k) == 0) {
+                    if (n >= lengths[f]) {
+                        return f;
+                    }
+                    prefix = true;
+                }
+            }
+            if (!prefix) {
+                return FORMAT_NONE;
+            }
+        }
+        return FORMAT_NONE;
+    }
+
+    stream_decoder* create(int threads)
+    {
+        switch (m_format) {
+        case FORMAT_NONE:
+            return new raw_decoder(m_in);
+#ifdef  DECOMPRESS_GZIP
+        case FORMAT_GZIP:
+            if (1 < threads) {
+                // Use threads if the first member is in the BGZF format.
+                size_t need = 12, size = 0;
+                while (m_in.fill(need) && (size = parallel_decoder::member_size(
+                    m_format, m_in.data(), m_in.size(), need)) == 0) {
+                    ;
+                }
+                if (size != 0 && size != (size_t)-1) {
+                    return new parallel_decoder(m_in, m_format, threads);
+                }
+            }
+            return new gzip_decoder(m_in);
+#endif/*DECOMPRESS_GZIP*/
+#ifdef  DECOMPRESS_BZIP2
+        case FORMAT_BZIP2:
+            return new bzip2_decoder(m_in);
+#endif/*DECOMPRESS_BZIP2*/
+#ifdef  DECOMPRESS_XZ
+        case FORMAT_XZ:
+            return new xz_decoder(m_in);
+#endif/*DECOMPRESS_XZ*/
+#ifdef  DECOMPRESS_ZSTD
+        case FORMAT_ZSTD:
+            if (1 < threads) {
+                return new parallel_decoder(m_in, m_format, threads);
+            }
+            return new zstd_decoder(m_in);
+#endif/*DECOMPRESS_ZSTD*/
+        }
+        return NULL;
+    }
+};
+
+inline void member_task::decode(const char* p, size_t n)
+{
+    switch (format) {
+#ifdef  DECOMPRESS_GZIP
+    case decompress_streambuf::FORMAT_GZIP:
+        {
+            // The size of the decoded member (modulo 2^32) is in the trailer.
+            const unsigned char* t = (const unsigned char*)p + n - 4;
+            const size_t isize = t[0] | (t[1] << 8) | (t[2] << 16) | ((size_t)t[3] << 24);
+            const size_t base = output.size();
+            output.resize(base + isize + 1);
+
+            z_stream strm;
+            std::memset(&strm, 0, sizeof(strm));
+            if (inflateInit2(&strm, 15 + 16) != Z_OK) {
+                throw invalid_data("failed to initialize zlib");
+            }
+            strm.next_in = (Bytef*)p;
+            strm.avail_in = (uInt)n;
+            strm.next_out = (Bytef*)&output[base];
+            strm.avail_out = (uInt)(isize + 1);
+            int ret = inflate(&strm, Z_FINISH);
+            const size_t m = isize + 1 - strm.avail_out;
+            const bool complete = (ret == Z_STREAM_END && strm.avail_in == 0);
+            inflateEnd(&strm);
+            if (!complete) {
+                throw invalid_data("gzip: corrupted data");
+            }
+            output.resize(base + m);
+        }
+        break;
+#endif/*DECOMPRESS_GZIP*/
+#ifdef  DECOMPRESS_ZSTD
+    case decompress_streambuf::FORMAT_ZSTD:
+        {
+            const unsigned long long size = ZSTD_getFrameContentSize(p, n);
+            if (size == ZSTD_CONTENTSIZE_ERROR) {
+                throw invalid_data("zstd: corrupted data");
+            }
+
+            ZSTD_DStream* strm = ZSTD_createDStream();
+            if (strm == NULL || ZSTD_isError(ZSTD_initDStream(strm))) {
+                ZSTD_freeDStream(strm);
+                throw invalid_data("failed to initialize libzstd");
+            }
+            ZSTD_inBuffer in = {p, n, 0};
+            size_t ret = 1;
+            while (ret != 0) {
+                const size_t base = output.size();
+                size_t grow = DECOMPRESS_BUFFER_SIZE;
+                if (size != ZSTD_CONTENTSIZE_UNKNOWN && base == 0) {
+                    grow = (size_t)size + 1;
+                }
+                output.resize(base + grow);
+                ZSTD_outBuffer out = {&output[base], grow, 0};
+                ret = ZSTD_decompressStream(strm, &out, &in);
+                output.resize(base + out.pos);
+                if (ZSTD_isError(ret) || (in.pos == in.size && out.pos == 0 && ret != 0)) {
+                    ZSTD_freeDStream(strm);
+                    throw invalid_data(
+                        ZSTD_isError(ret) ?
+                        std::string("zstd: ") + ZSTD_getErrorName(ret) :
+                        std::string("zstd: unexpected end of the frame"));
+                }
+            }
+            ZSTD_freeDStream(strm);
+        }
+        break;
+#endif/*DECOMPRESS_ZSTD*/
+    default:
+        throw invalid_data("unsupported format for parallel decoding");
+    }
+}
+
+inline size_t parallel_decoder::member_size(
+    int format, const char* p, size_t n, size_t& need)
+{
+    const unsigned char* b = (const unsigned char*)p;
+
+    switch (format) {
+    case decompress_streambuf::FORMAT_GZIP:
+        // Find the BGZF subfield ('B', 'C') with the size of the member.
+        if (n < 12) {
+            need = 12;
+            return 0;
+        }
+        if (b[0] != 0x1F || b[1] != 0x8B || b[2] != 8 || !(b[3] & 4)) {
+            return (size_t)-1;
+        } else {
+            const size_t xlen = b[10] | (b[11] << 8);
+            if (n < 12 + xlen) {
+                need = 12 + xlen;
+                return 0;
+            }
+            for (size_t i = 12;i + 4 <= 12 + xlen;) {
+                const size_t slen = b[i+2] | (b[i+3] << 8);
+                if (b[i] == 'B' && b[i+1] == 'C' && slen == 2 && i + 6 <= 12 + xlen) {
+                    return (size_t)(b[i+4] | (b[i+5] << 8)) + 1;
+                }
+                i += 4 + slen;
+            }
+        }
+        return (size_t)-1;
+
+#ifdef  DECOMPRESS_ZSTD
+    case decompress_streambuf::FORMAT_ZSTD:
+        {
+            size_t ret = ZSTD_findFrameCompressedSize(p, n);
+            if (!ZSTD_isError(ret)) {
+                return ret;
+            }
+            if (ZSTD_getErrorCode(ret) == ZSTD_error_srcSize_wrong && n < DECOMPRESS_MAX_FRAME) {
+                need = std::max(n * 2, (size_t)DECOMPRESS_BUFFER_SIZE);
+                return 0;
+            }
+        }
+        return (size_t)-1;
+#endif/*DECOMPRESS_ZSTD*/
+    }
+    return (size_t)-1;
+}
+
+inline bool parallel_decoder::next(const char*& p, size_t& n)
+{
+    if (m_sequential != NULL) {
+        return m_sequential->next(p, n);
+    }
+
+    for (;;) {
+        // Return the bytes decoded by the next thread.
+        for (;m_current < m_tasks.size();++m_current) {
+            if (!m_tasks[m_current].output.empty()) {
+                p = &m_tasks[m_current].output[0];
+                n = m_tasks[m_current].output.size();
+                ++m_current;
+                return true;
+            }
+        }
+
+        if (!decode_members()) {
+            break;
+        }
+    }
+
+    // Decode the rest of the stream sequentially.
+    if (m_in.size() == 0 && !m_in.fill()) {
+        return false;
+    }
+    switch (m_format) {
+#ifdef  DECOMPRESS_GZIP
+    case decompress_streambuf::FORMAT_GZIP:
+        m_sequential = new gzip_decoder(m_in);
+        break;
+#endif/*DECOMPRESS_GZIP*/
+#ifdef  DECOMPRESS_ZSTD
+    case decompress_streambuf::FORMAT_ZSTD:
+        m_sequential = new zstd_decoder(m_in);
+        break;
+#endif/*DECOMPRESS_ZSTD*/
+    default:
+        return false;
+    }
+    return m_sequential->next(p, n);
+}
+
+/**
+ * Distributes the next members to the threads and decodes them.
+ *  @return bool        \c false if no member with a known size is left.
+ */
+inline bool parallel_decoder::decode_members()
+{
+    size_t offset = 0;
+    bool stop = false;
+    for (size_t t = 0;t < m_tasks.size();++t) {
+        member_task& task = m_tasks[t];
+        task.offset = offset;
+        task.sizes.clear();
+        task.output.clear();
+        task.error.clear();
+
+        size_t bytes = 0;
+        while (!stop && bytes < DECOMPRESS_BLOCK_SIZE) {
+            if (m_in.size() <= offset && !m_in.fill(offset + 1)) {
+                stop = true;
+                break;
+            }
+
+            size_t need = 0;
+            size_t size = member_size(
+                m_format, m_in.data() + offset, m_in.size() - offset, need);
+            if (size == 0) {
+                if (!m_in.fill(offset + need)) {
+                    // Leave a truncated member to the sequential decoder.
+                    stop = true;
+                }
+                continue;
+            }
+            if (size == (size_t)-1 || (m_in.size() < offset + size && !m_in.fill(offset + size))) {
+                stop = true;
+                break;
+            }
+            task.sizes.push_back(size);
+            offset += size;
+            bytes += size;
+        }
+    }
+
+    if (offset == 0) {
+        return false;
+    }
+
+    // Decode the members concurrently.
+    for (size_t t = 0;t < m_tasks.size();++t) {
+        m_tasks[t].first = m_in.data() + m_tasks[t].offset;
+    }
+    classias::run_tasks(m_tasks);
+    for (size_t t = 0;t < m_tasks.size();++t) {
+        if (!m_tasks[t].error.empty()) {
+            throw invalid_data(m_tasks[t].error);
+        }
+    }
+    m_in.consume(offset);
+    m_current = 0;
+    return true;
+}
+
+#endif/*__DECOMPRESS_H__*/
@@ -0,0 +1,183 @@
+/*
+ *		Decompression of a stream by an external command.
+ *
+ * Copyright (c) 2008,2009 Naoaki Okazaki
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the names of the authors nor the names of its contributors
+ *       may be used to endorse or promote products derived from this
+ *       software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* $Id$ */
+
+#ifndef __DECOMPRESS_COMMAND_H__
+#define __DECOMPRESS_COMMAND_H__
+
+#include <stdexcept>
+#include <streambuf>
+#include <string>
+#include <classias/thread.h>
+#include <libexecstream/exec-stream.h>
+#include <decompress.h>
+
+/**
+ * A decompressor of a stream running an external command.
+ *  This is the fallback of decompress_streambuf for a stream whose
+ *  compression library is not built in: a thread writes the compressed
+ *  bytes to the command ('gzip -dc', 'bzip2 -dc', 'xz -dc', or 'zstd -dc')
+ *  while the reader reads the decompressed bytes from its output.
+ */
+class decompress_command
+{
+protected:
+    /**
+     * The task writing the compressed bytes to the command.
+     */
+    struct feeder
+    {
+        std::streambuf* src;
+        exec_stream_t* proc;
+
+        feeder() : src(NULL), proc(NULL)
+        {
+        }
+
+        void run()
+        {
+            try {
+                std::ostream& os = proc->in();
+                char buffer[65536];
+                std::streamsize n;
+                while (os && 0 < (n = src->sgetn(buffer, sizeof(buffer)))) {
+                    os.write(buffer, n);
+                }
+                proc->close_in();
+            } catch (const std::exception&) {
+                // The command exited; its exit code reports the error.
+            }
+        }
+    };
+
+    exec_stream_t m_proc;
+    feeder m_feeder;
+    classias::thread m_thread;
+    std::string m_name;
+
+public:
+    /**
+     * Constructs an object.
+     */
+    decompress_command()
+    {
+    }
+
+    /**
+     * Destructs the object, stopping the command if it is running.
+     */
+    virtual ~decompress_command()
+    {
+        finish(true);
+    }
+
+    /**
+     * Starts the command decompressing a stream.
+     *  @param  buf         The stream, whose compression format is detected
+     *                      but not supported in this process. The bytes of
+     *                      the stream are passed to the command as they are.
+     *  @throws std::runtime_error  The command or the thread cannot start.
+     */
+    void start(decompress_streambuf& buf)
+    {
+        m_name = buf.format_name();
+        try {
+            // Bound the buffers of the pipes, and wait for the input as long
+            // as needed (a whole number of seconds, which the library
+            // requires).
+            m_proc.set_buffer_limit(exec_stream_t::s_in | exec_stream_t::s_out, 1 << 20);
+            m_proc.set_wait_timeout(exec_stream_t::s_in | exec_stream_t::s_out, 2000000000UL);
+            m_proc.start(m_name, "-dc");
+        } catch (const std::exception& e) {
+            throw std::runtime_error(
+                std::string("Failed to run '") + m_name + " -dc': " + e.what());
+        }
+
+        buf.pass();
+        m_feeder.src = &buf;
+        m_feeder.proc = &m_proc;
+        try {
+            m_thread.start(m_feeder);
+        } catch (const classias::thread_error&) {
+            m_feeder.proc = NULL;
+            m_proc.kill();
+            throw;
+        }
+    }
+
+    /**
+     * Returns the stream buffer of the decompressed bytes.
+     *  @return std::streambuf*     The stream buffer.
+     */
+    std::streambuf* rdbuf()
+    {
+        return m_proc.out().rdbuf();
+    }
+
+    /**
+     * Waits for the command to exit.
+     *  @param  abort       \c true to stop the command before the end of
+     *                      its output is read.
+     *  @return int         The exit code of the command.
+     */
+    int finish(bool abort = false)
+    {
+        if (m_feeder.proc == NULL) {
+            return 0;
+        }
+        if (abort) {
+            // Stop the command, which may wait for its output read.
+            try {
+                m_proc.kill();
+            } catch (const std::exception&) {
+            }
+        }
+        m_thread.join();
+        m_feeder.proc = NULL;
+        try {
+            m_proc.close();
+            return abort ? 0 : m_proc.exit_code();
+        } catch (const std::exception&) {
+            return abort ? 0 : -1;
+        }
+    }
+
+    /**
+     * Returns the name of the command.
+     *  @return const std::string&  The name.
+     */
+    const std::string& name() const
+    {
+        return m_name;
+    }
+};
+
+#endif/*__DECOMPRESS_COMMAND_H__*/
@@ -0,0 +1,194 @@
+/*
+ *		Read-only memory-mapped files.
+ *
+ * Copyright (c) 2008,2009 Naoaki Okazaki
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the names of the authors nor the names of its contributors
+ *       may be used to endorse or promote products derived from this
+ *       software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* $Id$ */
+
+#ifndef __MAPPED_FILE_H__
+#define __MAPPED_FILE_H__
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#if defined(HAVE_SYS_MMAN_H)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif/*HAVE_SYS_MMAN_H*/
+
+/**
+ * A read-only view of the whole content of a file.
+ *  The file is mapped to the memory with mmap(2) if available, so that
+ *  processes reading the same file share the pages; otherwise, the content
+ *  is read into a buffer.
+ */
+class mapped_file
+{
+protected:
+    const char* m_block;
+    size_t m_size;
+    bool m_mapped;
+    std::vector<char> m_buffer;
+
+public:
+    mapped_file() : m_block(NULL), m_size(0), m_mapped(false)
+    {
+    }
+
+    virtual ~mapped_file()
+    {
+        close();
+    }
+
+    /**
+     * Opens a file.
+     *  @param  filename    The file name.
+     *  @return bool        \c true if the file is opened and not empty.
+     */
+    bool open(const std::string& filename)
+    {
+        close();
+
+#if defined(HAVE_SYS_MMAN_H)
+        int fd = ::open(filename.c_str(), O_RDONLY);
+        if (fd == -1) {
+            return false;
+        }
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size == 0) {
+            ::close(fd);
+            return false;
+        }
+        void *block = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (block != MAP_FAILED) {
+            m_block = reinterpret_cast<const char*>(block);
+            m_size = (size_t)st.st_size;
+            m_mapped = true;
+            return true;
+        }
+#endif/*HAVE_SYS_MMAN_H*/
+
+        std::ifstream ifs(filename.c_str(), std::ios::in | std::ios::binary);
+        if (ifs.fail()) {
+            return false;
+        }
+        ifs.seekg(0, std::ios::end);
+        m_buffer.resize((size_t)ifs.tellg());
+        ifs.seekg(0, std::ios::beg);
+        if (m_buffer.empty() || !ifs.read(&m_buffer[0], m_buffer.size())) {
+            m_buffer.clear();
+            return false;
+        }
+        m_block = &m_buffer[0];
+        m_size = m_buffer.size();
+        return true;
+    }
+
+    /**
+     * Closes the file.
+     */
+    void close()
+    {
+#if defined(HAVE_SYS_MMAN_H)
+        if (m_mapped) {
+            munmap(const_cast<char*>(m_block), m_size);
+        }
+#endif/*HAVE_SYS_MMAN_H*/
+        m_buffer.clear();
+        m_block = NULL;
+        m_size = 0;
+        m_mapped = false;
+    }
+
+    /**
+     * Returns the pointer to the content.
+     */
+    const char* data() const
+    {
+        return m_block;
+    }
+
+    /**
+     * Returns the size of the content in bytes.
+     */
+    size_t size() const
+    {
+        return m_size;
+    }
+
+    /**
+     * Advises the kernel that a range of the content will be read soon, so
+     * that the pages are read ahead while the caller works on other ranges.
+     *  @param  offset      The offset of the range in bytes.
+     *  @param  size        The size of the range in bytes.
+     */
+    void will_need(size_t offset, size_t size) const
+    {
+        advise(offset, size, true);
+    }
+
+    /**
+     * Advises the kernel that a range of the content will not be read for
+     * a while, so that the pages are released from the memory of the
+     * process.
+     *  @param  offset      The offset of the range in bytes.
+     *  @param  size        The size of the range in bytes.
+     */
+    void dont_need(size_t offset, size_t size) const
+    {
+        advise(offset, size, false);
+    }
+
+protected:
+    void advise(size_t offset, size_t size, bool need) const
+    {
+#if defined(HAVE_SYS_MMAN_H)
+        if (m_mapped && offset < m_size && 0 < size) {
+            // Extend the range to the page boundaries.
+            const size_t page = (size_t)sysconf(_SC_PAGESIZE);
+            size_t first = offset - offset % page;
+            size_t last = (m_size - offset < size ? m_size : offset + size);
+            madvise(
+                const_cast<char*>(m_block) + first, last - first,
+                need ? MADV_WILLNEED : MADV_DONTNEED);
+        }
+#endif/*HAVE_SYS_MMAN_H*/
+    }
+
+private:
+    mapped_file(const mapped_file&);
+    mapped_file& operator=(const mapped_file&);
+};
+
+#endif/*__MAPPED_FILE_H__*/
@@ -0,0 +1,546 @@
+/*
+ *		Compiled (binary) model files.
+ *
+ * Copyright (c) 2008,2009 Naoaki Okazaki
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the names of the authors nor the names of its contributors
+ *       may be used to endorse or promote products derived from this
+ *       software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* $Id$ */
+
+#ifndef __MODEL_FILE_H__
+#define __MODEL_FILE_H__
+
+/*
+A compiled model stores the feature weights as a sparse matrix of attributes
+by labels in the CSR format, with the attribute names sorted in byte order
+so that the tagger can look up an attribute by a binary search directly on
+the mapped image. Binary and candidate models have no label and store one
+weight (with the label #0) per attribute. All values are written in the
+native byte order, and every section starts at an 8-byte boundary.
+
+The weights are stored in double or single precision, or as 16-bit or 8-bit
+integers quantized with a scale for every block of B consecutive weights in
+the rows (see classias::compact_vector_base). Models of the version 1 have
+no encoding fields in the header and store the weights in double precision.
+
+<model>         ::= <header> <strings: labels> <strings: attributes> <rows>
+<header>        ::= "CLSMODEL" <uint32: version> <uint32: type> <uint32: L> <uint32: A> <uint64: nnz> <uint32: encoding> <uint32: B>
+<strings>       ::= <uint64: offset>{N+1} <char>{offset[N]} <padding>
+<rows>          ::= <uint64: offset>{A+1} <int32: label>{nnz} <padding> <weights>
+<weights>       ::= <double: weight>{nnz}
+                  | <float: weight>{nnz} <padding>
+                  | <float: scale>{ceil(nnz/B)} <padding> <int16|int8: code>{nnz} <padding>
+*/
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+
+#include <classias/compact_vector.h>
+
+#include "mapped_file.h"
+#include "util.h"
+
+#define CLASSIAS_MODEL_MAGIC    "CLSMODEL"
+#define CLASSIAS_MODEL_VERSION  2
+
+/**
+ * Model types (identical to the TYPE_* values of the frontends).
+ */
+enum {
+    MODEL_FILE_NONE = 0,
+    MODEL_FILE_BINARY,
+    MODEL_FILE_MULTI_SPARSE,
+    MODEL_FILE_MULTI_DENSE,
+    MODEL_FILE_CANDIDATE,
+};
+
+/**
+ * Encodings of the weights of a compiled model (identical to the WEIGHT_*
+ * values of the frontends).
+ */
+enum {
+    MODEL_WEIGHT_DOUBLE = 0,
+    MODEL_WEIGHT_FLOAT,
+    MODEL_WEIGHT_INT16,
+    MODEL_WEIGHT_INT8,
+};
+
+/**
+ * The default number of weights sharing a scale in a quantized model.
+ */
+#define MODEL_WEIGHT_BLOCK  64
+
+/**
+ * A writer of a compiled model.
+ */
+class model_file_writer
+{
+protected:
+    struct entry_type
+    {
+        std::string attribute;
+        int label;
+        double weight;
+
+        bool operator<(const entry_type& x) const
+        {
+            int c = attribute.compare(x.attribute);
+            return (c < 0 || (c == 0 && label < x.label));
+        }
+    };
+
+    int m_type;
+    int m_encoding;
+    int m_block_size;
+    std::vector<std::string> m_labels;
+    std::vector<entry_type> m_entries;
+
+public:
+    /**
+     * Constructs the object.
+     *  @param  type        The model type (MODEL_FILE_*).
+     *  @param  encoding    The encoding of the weights (MODEL_WEIGHT_*).
+     *  @param  block_size  The number of weights sharing a scale in a
+     *                      quantized encoding.
+     */
+    model_file_writer(
+        int type,
+        int encoding = MODEL_WEIGHT_DOUBLE,
+        int block_size = MODEL_WEIGHT_BLOCK
+        ) :
+        m_type(type), m_encoding(encoding),
+        m_block_size(block_size < 1 ? 1 : block_size)
+    {
+    }
+
+    /**
+     * Appends a label. Labels are numbered in the order of appearance.
+     *  @param  label       The label name.
+     */
+    void add_label(const std::string& label)
+    {
+        m_labels.push_back(label);
+    }
+
+    /**
+     * Appends a non-zero weight.
+     *  @param  attribute   The attribute name.
+     *  @param  label       The label index (0 for binary/candidate models).
+     *  @param  weight      The weight.
+     */
+    void add(const std::string& attribute, int label, double weight)
+    {
+        m_entries.push_back(entry_type());
+        entry_type& e = m_entries.back();
+        e.attribute = attribute;
+        e.label = label;
+        e.weight = weight;
+    }
+
+    /**
+     * Writes the model to a file.
+     *  @param  filename    The file name.
+     *  @return bool        \c true if successful.
+     */
+    bool write(const std::string& filename)
+    {
+        std::ofstream ofs(filename.c_str(), std::ios::out | std::ios::binary);
+        if (ofs.fail()) {
+            return false;
+        }
+
+        // Sort the weights by attribute names and labels.
+        std::sort(m_entries.begin(), m_entries.end());
+
+        // Collect the unique attribute names and the row offsets.
+        std::vector<std::string> attributes;
+        std::vector<uint64_t> offsets;
+        for (size_t i = 0;i < m_entries.size();++i) {
+            if (attributes.empty() || attributes.back() != m_entries[i].attribute) {
+                attributes.push_back(m_entries[i].attribute);
+                offsets.push_back((uint64_t)i);
+            }
+        }
+        offsets.push_back((uint64_t)m_entries.size());
+
+        // The header.
+        ofs.write(CLASSIAS_MODEL_MAGIC, 8);
+        put(ofs, (uint32_t)CLASSIAS_MODEL_VERSION);
+        put(ofs, (uint32_t)m_type);
+        put(ofs, (uint32_t)m_labels.size());
+        put(ofs, (uint32_t)attributes.size());
+        put(ofs, (uint64_t)m_entries.size());
+        put(ofs, (uint32_t)m_encoding);
+        put(ofs, (uint32_t)m_block_size);
+
+        // The string tables.
+        put_strings(ofs, m_labels);
+        put_strings(ofs, attributes);
+
+        // The rows.
+        for (size_t i = 0;i < offsets.size();++i) {
+            put(ofs, offsets[i]);
+        }
+        for (size_t i = 0;i < m_entries.size();++i) {
+            put(ofs, (int32_t)m_entries[i].label);
+        }
+        pad(ofs, m_entries.size() * sizeof(int32_t));
+        switch (m_encoding) {
+        case MODEL_WEIGHT_FLOAT:
+            put_compact<float>(ofs);
+            break;
+        case MODEL_WEIGHT_INT16:
+            put_compact<int16_t>(ofs);
+            break;
+        case MODEL_WEIGHT_INT8:
+            put_compact<int8_t>(ofs);
+            break;
+        default:
+            for (size_t i = 0;i < m_entries.size();++i) {
+                put(ofs, (double)m_entries[i].weight);
+            }
+            break;
+        }
+
+        ofs.close();
+        return !ofs.fail();
+    }
+
+protected:
+    template <class value_type>
+    static void put(std::ofstream& ofs, const value_type& value)
+    {
+        ofs.write(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+
+    template <class code_type>
+    void put_compact(std::ofstream& ofs)
+    {
+        std::vector<double> weights(m_entries.size());
+        for (size_t i = 0;i < m_entries.size();++i) {
+            weights[i] = m_entries[i].weight;
+        }
+        classias::compact_vector_base<code_type> cv(m_block_size);
+        cv.assign(weights.begin(), weights.end());
+
+        if (cv.scales() != NULL) {
+            const size_t nb = (cv.size() + m_block_size - 1) / m_block_size;
+            ofs.write(reinterpret_cast<const char*>(cv.scales()), sizeof(float) * nb);
+            pad(ofs, sizeof(float) * nb);
+        }
+        if (cv.codes() != NULL) {
+            ofs.write(reinterpret_cast<const char*>(cv.codes()), sizeof(code_type) * cv.size());
+        }
+        pad(ofs, sizeof(code_type) * cv.size());
+    }
+
+    static void pad(std::ofstream& ofs, size_t size)
+    {
+        static const char zeros[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+        ofs.write(zeros, (8 - size % 8) % 8);
+    }
+
+    static void put_strings(std::ofstream& ofs, const std::vector<std::string>& strs)
+    {
+        uint64_t offset = 0;
+        put(ofs, offset);
+        for (size_t i = 0;i < strs.size();++i) {
+            offset += strs[i].length();
+            put(ofs, offset);
+        }
+        for (size_t i = 0;i < strs.size();++i) {
+            ofs.write(strs[i].c_str(), strs[i].length());
+        }
+        pad(ofs, (size_t)offset);
+    }
+};
+
+/**
+ * A reader of a compiled model.
+ *  This class accesses the weights directly on the (memory-mapped) image of
+ *  the file without copying them.
+ */
+class model_file
+{
+protected:
+    mapped_file m_file;
+    int m_type;
+    int m_encoding;
+    size_t m_block_size;
+    int m_num_labels;
+    int m_num_attributes;
+    const uint64_t* m_label_offsets;
+    const char* m_label_strings;
+    const uint64_t* m_attribute_offsets;
+    const char* m_attribute_strings;
+    const uint64_t* m_rows;
+    const int32_t* m_row_labels;
+    const double* m_row_weights;
+    const float* m_row_floats;
+    const int16_t* m_row_int16;
+    const int8_t* m_row_int8;
+    const float* m_row_scales;
+
+public:
+    model_file() :
+        m_type(MODEL_FILE_NONE), m_encoding(MODEL_WEIGHT_DOUBLE),
+        m_block_size(1), m_num_labels(0), m_num_attributes(0)
+    {
+    }
+
+    /**
+     * Opens a compiled model.
+     *  @param  filename    The file name.
+     *  @return bool        \c true if the file is a compiled model, \c false
+     *                      if the file cannot be opened or is not a compiled
+     *                      model (e.g., a model in the text format).
+     */
+    bool open(const std::string& filename)
+    {
+        if (!m_file.open(filename)) {
+            return false;
+        }
+        const char* p = m_file.data();
+        const char* last = p + m_file.size();
+        if (m_file.size() < 32 || std::memcmp(p, CLASSIAS_MODEL_MAGIC, 8) != 0) {
+            m_file.close();
+            return false;
+        }
+
+        uint32_t version = *reinterpret_cast<const uint32_t*>(p + 8);
+        if (version < 1 || CLASSIAS_MODEL_VERSION < version) {
+            throw invalid_model("unsupported version of a compiled model", filename);
+        }
+        m_type = (int)*reinterpret_cast<const uint32_t*>(p + 12);
+        m_num_labels = (int)*reinterpret_cast<const uint32_t*>(p + 16);
+        m_num_attributes = (int)*reinterpret_cast<const uint32_t*>(p + 20);
+        uint64_t nnz = *reinterpret_cast<const uint64_t*>(p + 24);
+        p += 32;
+
+        // The encoding of the weights (since the version 2).
+        m_encoding = MODEL_WEIGHT_DOUBLE;
+        m_block_size = 1;
+        if (2 <= version) {
+            if (m_file.size() < 40) {
+                throw invalid_model("a compiled model is broken", filename);
+            }
+            m_encoding = (int)*reinterpret_cast<const uint32_t*>(p);
+            m_block_size = (size_t)*reinterpret_cast<const uint32_t*>(p + 4);
+            p += 8;
+            if (m_block_size < 1) {
+                throw invalid_model("a compiled model is broken", filename);
+            }
+        }
+
+        if (!get_strings(p, last, m_num_labels, m_label_offsets, m_label_strings) ||
+            !get_strings(p, last, m_num_attributes, m_attribute_offsets, m_attribute_strings) ||
+            !get_block(p, last, sizeof(uint64_t) * (m_num_attributes + 1), m_rows) ||
+            !get_block(p, last, align(sizeof(int32_t) * (size_t)nnz), m_row_labels) ||
+            !get_weights(p, last, (size_t)nnz) ||
+            m_rows[m_num_attributes] != nnz) {
+            throw invalid_model("a compiled model is broken", filename);
+        }
+        return true;
+    }
+
+    /// Returns the encoding of the weights (MODEL_WEIGHT_*).
+    int encoding() const
+    {
+        return m_encoding;
+    }
+
+    /// Returns the model type (MODEL_FILE_*).
+    int type() const
+    {
+        return m_type;
+    }
+
+    /// Returns the number of labels.
+    int num_labels() const
+    {
+        return m_num_labels;
+    }
+
+    /// Returns the name of a label.
+    std::string label(int i) const
+    {
+        return std::string(
+            m_label_strings + m_label_offsets[i],
+            (size_t)(m_label_offsets[i+1] - m_label_offsets[i]));
+    }
+
+    /// Returns the number of attributes.
+    int num_attributes() const
+    {
+        return m_num_attributes;
+    }
+
+    /// Returns the name of an attribute.
+    std::string attribute(int i) const
+    {
+        return std::string(
+            m_attribute_strings + m_attribute_offsets[i],
+            (size_t)(m_attribute_offsets[i+1] - m_attribute_offsets[i]));
+    }
+
+    /**
+     * Finds an attribute.
+     *  @param  str         The pointer to the attribute name.
+     *  @param  n           The length of the attribute name.
+     *  @return int         The attribute index, or -1 if the attribute is
+     *                      not in the model.
+     */
+    int find(const char *str, size_t n) const
+    {
+        int lo = 0, hi = m_num_attributes;
+        while (lo < hi) {
+            int mid = lo + (hi - lo) / 2;
+            const char* s = m_attribute_strings + m_attribute_offsets[mid];
+            size_t len = (size_t)(m_attribute_offsets[mid+1] - m_attribute_offsets[mid]);
+            int c = std::memcmp(s, str, std::min(len, n));
+            if (c == 0) {
+                c = (len < n) ? -1 : (n < len ? 1 : 0);
+            }
+            if (c == 0) {
+                return mid;
+            } else if (c < 0) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        return -1;
+    }
+
+    int find(const std::string& str) const
+    {
+        return find(str.c_str(), str.length());
+    }
+
+    /// Returns the index of the first weight of an attribute.
+    size_t row_begin(int a) const
+    {
+        return (size_t)m_rows[a];
+    }
+
+    /// Returns the index just beyond the last weight of an attribute.
+    size_t row_end(int a) const
+    {
+        return (size_t)m_rows[a+1];
+    }
+
+    /// Returns the label associated with the k-th weight.
+    int row_label(size_t k) const
+    {
+        return (int)m_row_labels[k];
+    }
+
+    /// Returns the k-th weight.
+    double row_weight(size_t k) const
+    {
+        switch (m_encoding) {
+        case MODEL_WEIGHT_FLOAT:
+            return m_row_floats[k];
+        case MODEL_WEIGHT_INT16:
+            return m_row_int16[k] * (double)m_row_scales[k / m_block_size];
+        case MODEL_WEIGHT_INT8:
+            return m_row_int8[k] * (double)m_row_scales[k / m_block_size];
+        default:
+            return m_row_weights[k];
+        }
+    }
+
+    /**
+     * Returns the weight for a pair of an attribute and a label.
+     *  @param  a           The attribute index.
+     *  @param  l           The label index.
+     *  @return double      The weight, or zero if the pair is not in the model.
+     */
+    double weight(int a, int l) const
+    {
+        for (size_t k = row_begin(a);k < row_end(a);++k) {
+            if (m_row_labels[k] == l) {
+                return row_weight(k);
+            }
+        }
+        return 0.;
+    }
+
+protected:
+    static size_t align(size_t size)
+    {
+        return (size + 7) & ~(size_t)7;
+    }
+
+    template <class value_type>
+    static bool get_block(const char*& p, const char* last, size_t size, const value_type*& ptr)
+    {
+        if ((size_t)(last - p) < size) {
+            return false;
+        }
+        ptr = reinterpret_cast<const value_type*>(p);
+        p += size;
+        return true;
+    }
+
+    bool get_weights(const char*& p, const char* last, size_t nnz)
+    {
+        const size_t nb = (nnz + m_block_size - 1) / m_block_size;
+        switch (m_encoding) {
+        case MODEL_WEIGHT_DOUBLE:
+            return get_block(p, last, sizeof(double) * nnz, m_row_weights);
+        case MODEL_WEIGHT_FLOAT:
+            return get_block(p, last, align(sizeof(float) * nnz), m_row_floats);
+        case MODEL_WEIGHT_INT16:
+            return
+                get_block(p, last, align(sizeof(float) * nb), m_row_scales) &&
+                get_block(p, last, align(sizeof(int16_t) * nnz), m_row_int16);
+        case MODEL_WEIGHT_INT8:
+            return
+                get_block(p, last, align(sizeof(float) * nb), m_row_scales) &&
+                get_block(p, last, align(sizeof(int8_t) * nnz), m_row_int8);
+        default:
+            return false;
+        }
+    }
+
+    static bool get_strings(
+        const char*& p, const char* last, int n,
+        const uint64_t*& offsets, const char*& strings)
+    {
+        if (!get_block(p, last, sizeof(uint64_t) * (n + 1), offsets)) {
+            return false;
+        }
+        return get_block(p, last, align((size_t)offsets[n]), strings);
+    }
+};
+
+#endif/*__MODEL_FILE_H__*/
@@ -229,4 +229,249 @@ public:
 
 typedef basic_tokenizer<char> tokenizer;
 
+/**
+ * A token referring to a range of characters in a string.
+ *  A view does not own the characters; the string must outlive the view.
+ */
+template <class char_type>
+class basic_token_view
+{
+protected:
+    typedef typename std::basic_string<char_type> string_type;
+
+    const char_type* m_first;
+    const char_type* m_last;
+
+public:
+    /**
+     * Constructs an empty view.
+     */
+    basic_token_view() : m_first(0), m_last(0)
+    {
+    }
+
+    /**
+     * Constructs a view of a range of characters.
+     *  @param  first       The pointer to the first character.
+     *  @param  last        The pointer just beyond the last character.
+     */
+    basic_token_view(const char_type* first, const char_type* last)
+        : m_first(first), m_last(last)
+    {
+    }
+
+    /**
+     * Returns the pointer to the first character.
+     *  @retval const char_type*    The pointer to the first character.
+     */
+    inline const char_type* begin() const
+    {
+        return m_first;
+    }
+
+    /**
+     * Returns the pointer just beyond the last character.
+     *  @retval const char_type*    The pointer beyond the last character.
+     */
+    inline const char_type* end() const
+    {
+        return m_last;
+    }
+
+    /**
+     * Returns the number of characters.
+     *  @retval size_t      The number of characters.
+     */
+    inline size_t size() const
+    {
+        return (size_t)(m_last - m_first);
+    }
+
+    /**
+     * Tests whether the token is empty.
+     *  @retval bool        \c true if the token has no character.
+     */
+    inline bool empty() const
+    {
+        return m_first == m_last;
+    }
+
+    /**
+     * Copies the characters to a string.
+     *  @param  str         The string receiving the characters; its storage
+     *                      is reused if large enough.
+     */
+    inline void assign_to(string_type& str) const
+    {
+        str.assign(m_first, m_last);
+    }
+
+    /**
+     * Returns a copy of the characters.
+     *  @retval string_type The string.
+     */
+    inline string_type str() const
+    {
+        return string_type(m_first, m_last);
+    }
+};
+
+/**
+ * A tokenizer returning views of tokens instead of copies.
+ *  Unlike basic_tokenizer, this tokenizer neither copies the source string
+ *  nor the tokens; the string must outlive the tokenizer and its iterators.
+ */
+template <class char_type>
+class basic_view_tokenizer
+{
+protected:
+    typedef typename std::basic_string<char_type> string_type;
+
+public:
+    typedef basic_token_view<char_type> token_type;
+
+    /**
+     * Iterator class for view_tokenizer.
+     */
+    class iterator
+    {
+    protected:
+        char_type m_sep;
+        const char_type* m_it;
+        const char_type* m_prev;
+        const char_type* m_end;
+        token_type m_token;
+
+    public:
+        /**
+         * Constructs an iterator.
+         */
+        iterator()
+            : m_sep(' '), m_it(0), m_prev(0), m_end(0)
+        {
+        }
+
+        /**
+         * Constructs an iterator.
+         *  @param  it          The pointer to the first character.
+         *  @param  end         The pointer just beyond the last character.
+         *  @param  sep         A separator.
+         */
+        iterator(const char_type* it, const char_type* end, char_type sep)
+            : m_sep(sep), m_it(it), m_prev(it), m_end(end)
+        {
+            next();
+        }
+
+        /**
+         * Accesses to the current token.
+         *  @retval token_type  The current token.
+         */
+        inline const token_type& operator*() const
+        {
+            return m_token;
+        }
+
+        /**
+         * Accesses to the pointer to the current token.
+         *  @retval token_type* The pointer to the current token.
+         */
+        inline const token_type* operator->() const
+        {
+            return &m_token;
+        }
+
+        /**
+         * Advances to the next token.
+         *  @retval iterator&   The reference to this object.
+         */
+        inline iterator& operator++()
+        {
+            next();
+            return *this;
+        }
+
+        /**
+         * Tests the iterator for equality with a specified iterator.
+         *  @param  x           The iterator that is to be compared to the
+         *                      target iterator for equality.
+         *  @retval bool        \c true if the iterators are the same;
+         *                      \c false if they are different.
+         */
+        inline bool operator==(const iterator& x) const
+        {
+            return (m_prev == x.m_prev);
+        }
+
+        /**
+         * Tests the iterator for inequality with a specified iterator.
+         *  @param  x           The iterator that is to be compared to the
+         *                      target iterator for inequality.
+         *  @retval bool        \c true if the iterators are different;
+         *                      \c false if they are the same.
+         */
+        inline bool operator!=(const iterator& x) const
+        {
+            return !operator==(x);
+        }
+
+    protected:
+        inline void next()
+        {
+            m_prev = m_it;
+
+            if (m_it != m_end) {
+                const char_type* first = m_it;
+                while (m_it != m_end && *m_it != m_sep) {
+                    ++m_it;
+                }
+                m_token = token_type(first, m_it);
+                if (m_it != m_end) {
+                    ++m_it;
+                }
+            }
+        }
+    };
+
+protected:
+    const char_type* m_first;
+    const char_type* m_last;
+    char_type m_sep;
+
+public:
+    /**
+     * Constructs a tokenizer object.
+     *  @param  str         the string to be tokenized.
+     *  @param  sep         a separator character for tokenization.
+     */
+    basic_view_tokenizer(const string_type& str, const char_type sep = '\t')
+        : m_first(str.data()), m_last(str.data() + str.size()), m_sep(sep)
+    {
+    }
+
+    /**
+     * Returns a forward input iterator to the first token.
+     *  @retval iterator        A forward input iterator (for read-only)
+     *                          addressing the first token in the string or
+     *                          to the location succeeding an empty token.
+     */
+    inline iterator begin() const
+    {
+        return iterator(m_first, m_last, m_sep);
+    }
+
+    /**
+     * Returns a forward input iterator pointing just beyond the last token.
+     *  @retval iterator        A forward input iterator (for read-only)
+     *                          addressing the end of the token.
+     */
+    inline iterator end() const
+    {
+        return iterator(m_last, m_last, m_sep);
+    }
+};
+
+typedef basic_token_view<char> token_view;
+typedef basic_view_tokenizer<char> view_tokenizer;
+
 #endif/*__TOKENIZE_H__*/
@@ -39,6 +39,7 @@
 #include <sstream>
 #include <stdexcept>
 #include <string>
+#include <classias/metrics.h>
 
 class invalid_data : public std::exception
 {
@@ -101,11 +102,46 @@ public:
     }
 };
 
+/**
+ * An exception thrown when a data set exceeds the memory limit.
+ */
+class memory_exceeded : public std::runtime_error
+{
+public:
+    /// The number of bytes used when the limit was exceeded.
+    double bytes;
+    /// The memory limit in bytes.
+    double limit;
+    /// The number of attributes read so far.
+    size_t attributes;
+
+    memory_exceeded(double _bytes, double _limit, size_t _attributes)
+        : std::runtime_error(format(_bytes, _limit)),
+        bytes(_bytes), limit(_limit), attributes(_attributes)
+    {
+    }
+
+protected:
+    static std::string format(double bytes, double limit)
+    {
+        std::stringstream ss;
+        ss << "The memory limit is exceeded: " <<
+            bytes / 1048576. << " MB used (" <<
+            limit / 1048576. << " MB allowed)";
+        return ss.str();
+    }
+};
+
+/**
+ * A stopwatch measuring the wall-clock time and the CPU time.
+ */
 class stopwatch
 {
 protected:
-    clock_t begin;
-    clock_t end;
+    double begin;
+    double end;
+    double cpu_begin;
+    double cpu_end;
 
 public:
     stopwatch()
@@ -115,35 +151,144 @@ public:
 
     void start()
     {
-        begin = end = std::clock();
+        begin = end = classias::wall_clock();
+        cpu_begin = cpu_end = classias::cpu_clock();
     }
 
     double stop()
     {
-        end = std::clock();
+        end = classias::wall_clock();
+        cpu_end = classias::cpu_clock();
         return get();
     }
 
+    /**
+     * Returns the wall-clock seconds between start() and stop().
+     */
     double get() const
     {
-        return (end - begin) / (double)CLOCKS_PER_SEC;
+        return end - begin;
+    }
+
+    /**
+     * Returns the CPU seconds (of all threads) between start() and stop().
+     */
+    double get_cpu() const
+    {
+        return cpu_end - cpu_begin;
     }
 };
 
+/**
+ * Converts a decimal number in a range of characters to a double value.
+ *  A number of the form [+-]digits[.digits][(e|E)[+-]digits] with at most
+ *  19 significant digits and a decimal exponent within [-22, 22] is converted
+ *  exactly (as the product or quotient of two exact doubles) without
+ *  depending on the locale; other strings are converted by std::strtod()
+ *  as std::atof() would do.
+ *  @param  first       The pointer to the first character.
+ *  @param  last        The pointer just beyond the last character.
+ *  @return double      The value.
+ */
+inline static double
+parse_double(const char* first, const char* last)
+{
+    static const double pow10[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+    };
+
+    const char* p = first;
+    bool negative = false;
+    if (p != last && (*p == '-' || *p == '+')) {
+        negative = (*p == '-');
+        ++p;
+    }
+
+    // Read the significand.
+    unsigned long long m = 0;
+    int digits = 0, significant = 0, e = 0;
+    for (;p != last && '0' <= *p && *p <= '9';++p, ++digits) {
+        if (m != 0 || *p != '0') {
+            m = m * 10 + (*p - '0');
+            ++significant;
+        }
+    }
+    if (p != last && *p == '.') {
+        for (++p;p != last && '0' <= *p && *p <= '9';++p, ++digits) {
+            if (m != 0 || *p != '0') {
+                m = m * 10 + (*p - '0');
+                ++significant;
+            }
+            --e;
+        }
+    }
+
+    // Read the exponent.
+    if (0 < digits && p != last && (*p == 'e' || *p == 'E')) {
+        const char* q = p + 1;
+        bool eneg = false;
+        if (q != last && (*q == '-' || *q == '+')) {
+            eneg = (*q == '-');
+            ++q;
+        }
+        int x = 0;
+        if (q != last && '0' <= *q && *q <= '9') {
+            for (;q != last && '0' <= *q && *q <= '9' && x < 10000;++q) {
+                x = x * 10 + (*q - '0');
+            }
+            e += (eneg ? -x : x);
+            p = q;
+        }
+    }
+
+    if (0 < digits && p == last && significant <= 19 &&
+        m <= (1ULL << 53) && -22 <= e && e <= 22) {
+        double v = (double)m;
+        v = (e < 0 ? v / pow10[-e] : v * pow10[e]);
+        return negative ? -v : v;
+    }
+
+    // Fall back to the C library for the other strings.
+    std::string str(first, last);
+    return std::strtod(str.c_str(), NULL);
+}
+
+/**
+ * Splits a field into the name and value.
+ *  @param  first       The pointer to the first character of the field.
+ *  @param  last        The pointer just beyond the last character.
+ *  @param  name        The string receiving the name.
+ *  @param  value       The value (1 if the field has no value).
+ *  @param  separator   The separator of the name and value.
+ */
 inline static void
 get_name_value(
-    const std::string& str, std::string& name, double& value, char separator)
+    const char* first, const char* last,
+    std::string& name, double& value, char separator)
 {
-    size_t col = str.rfind(separator);
-    if (col == str.npos) {
-        name = str;
+    const char* col = last;
+    while (col != first) {
+        if (*--col == separator) {
+            break;
+        }
+    }
+    if (col == last || *col != separator) {
+        name.assign(first, last);
         value = 1.;
     } else {
-        value = std::atof(str.c_str() + col + 1);
-        name = str.substr(0, col);
+        value = parse_double(col + 1, last);
+        name.assign(first, col);
     }
 }
 
+inline static void
+get_name_value(
+    const std::string& str, std::string& name, double& value, char separator)
+{
+    get_name_value(str.data(), str.data() + str.size(), name, value, separator);
+}
+
 template <class char_type, class traits_type>
 inline std::basic_ostream<char_type, traits_type>&
 timestamp(std::basic_ostream<char_type, traits_type>& os)
@@ -46,11 +46,17 @@
 #include "option.h"
 #include "tokenize.h"
 #include "defaultmap.h"
+#include "compiled_model.h"
+#include "hashed_model.h"
+#include "output.h"
+#include "pipeline.h"
+#include "model_group.h"
+#include "server.h"
 #include <util.h>
 
 typedef defaultmap<std::string, double> model_type;
-typedef classias::classify::linear_binary_logistic<model_type> classifier_type;
 
+template <class classifier_type>
 static void
 parse_line(
     classifier_type& inst,
@@ -63,15 +69,15 @@ parse_line(
     double value;
     std::string name;
 
-    // Split the line with tab characters.
-    tokenizer values(line, opt.token_separator);
-    tokenizer::iterator itv = values.begin();
+    // Split the line with tab characters (into views of the line).
+    view_tokenizer values(line, opt.token_separator);
+    view_tokenizer::iterator itv = values.begin();
     if (itv == values.end()) {
         throw invalid_data("no field found in the line", line, lines);
     }
 
     // The first field always presents a label, which can be empty.
-    get_name_value(*itv, name, value, opt.value_separator);
+    get_name_value(itv->begin(), itv->end(), name, value, opt.value_separator);
     if (name == "+1" || name == "1") {
         rl = true;
     } else if (name == "-1") {
@@ -86,7 +92,7 @@ parse_line(
     // Set featuress for the instance.
     for (++itv;itv != values.end();++itv) {
         if (!itv->empty()) {
-            get_name_value(*itv, name, value, opt.value_separator);
+            get_name_value(itv->begin(), itv->end(), name, value, opt.value_separator);
             inst.set(name, value);
         }
     }
@@ -95,6 +101,8 @@ parse_line(
 static void
 read_model(
     model_type& model,
+    classias::hashed_quark& attributes,
+    bool& hashed,
     std::istream& is,
     option& opt
     )
@@ -107,6 +115,7 @@ read_model(
         }
 
         if (line.compare(0, 1, "@") == 0) {
+            read_hash_declarative(line, attributes, hashed);
             continue;
         }
 
@@ -124,39 +133,53 @@ read_model(
     }
 }
 
-int binary_tag(option& opt, std::ifstream& ifs)
+/**
+ * A tagger of instances for binary classification.
+ */
+template <class model_type>
+class binary_tagger
 {
-    int lines = 0;
-    std::istream& is = opt.is;
-    std::ostream& os = opt.os;
-    classias::accuracy acc;
-    classias::precall pr(2);
+public:
+    typedef classias::classify::linear_binary_logistic<model_type> classifier_type;
+    /// The predicted and reference labels of an instance.
+    typedef std::pair<int, int> outcome_type;
 
-    // Load a model.
-    model_type model;
-    read_model(model, ifs, opt);
+protected:
+    const option& m_opt;
+    const model_type& m_model;
 
-    for (;;) {
-        // Read a line.
-        std::string line;
-        std::getline(is, line);
-        if (is.eof()) {
-            break;
-        }
-        ++lines;
+public:
+    binary_tagger(const option& opt, const model_type& model)
+        : m_opt(opt), m_model(model)
+    {
+    }
+
+    bool boundary(const std::string& line) const
+    {
+        return true;
+    }
+
+    bool tag(
+        const std::string& line,
+        int lines,
+        std::ostream& os,
+        outcome_type& outcome
+        )
+    {
+        const option& opt = m_opt;
 
         // An empty line or comment line.
         if (line.empty() || line.compare(0, 1, "#") == 0) {
             // Output the comment line if necessary.
             if (opt.output & option::OUTPUT_COMMENT) {
-                os << line << std::endl;
+                os << line << end_of_line(opt);
             }
-            continue;
+            return false;
         }
 
         // Parse the line and classify the instance.
         bool rlabel;
-        classifier_type inst(model);
+        classifier_type inst(m_model);
         parse_line(inst, rlabel, opt, line, lines);
 
         // Determine whether we output this instance or not.
@@ -173,29 +196,168 @@ int binary_tag(option& opt, std::ifstream& ifs)
 
             // Output the score/probability if necessary.
             if (opt.output & option::OUTPUT_PROBABILITY) {
-                os << opt.value_separator << inst.prob();
+                os << opt.value_separator << formatted_value(inst.prob(), opt);
             } else if (opt.output & option::OUTPUT_SCORE) {
-                os << opt.value_separator << inst.score();
+                os << opt.value_separator << formatted_value(inst.score(), opt);
             }
 
-            os << std::endl;
+            os << end_of_line(opt);
         }
 
-        // Accumulate the performance.
+        // Report the labels for the performance.
         if (opt.test) {
-            int rl = static_cast<int>(rlabel);
-            int ml = static_cast<int>(static_cast<bool>(inst));
-            acc.set(ml == rl);
-            pr.set(ml, rl);
+            outcome.first = static_cast<int>(static_cast<bool>(inst));
+            outcome.second = static_cast<int>(rlabel);
+            return true;
+        }
+        return false;
+    }
+};
+
+/**
+ * An evaluator accumulating the performance of binary classification.
+ */
+struct binary_evaluator
+{
+    classias::accuracy acc;
+    classias::precall pr;
+
+    binary_evaluator() : pr(2)
+    {
+    }
+
+    void operator()(const std::pair<int, int>& outcome)
+    {
+        acc.set(outcome.first == outcome.second);
+        pr.set(outcome.first, outcome.second);
+    }
+};
+
+/**
+ * A scorer of a binary model in a group of models (multiple -m options).
+ */
+template <class model_type>
+class binary_scorer : public instance_scorer
+{
+public:
+    typedef classias::classify::linear_binary_logistic<model_type> classifier_type;
+
+protected:
+    const option& m_opt;
+    const model_type& m_model;
+    bool m_label;
+    double m_score;
+    double m_prob;
+    binary_evaluator m_eval;
+
+public:
+    binary_scorer(const option& opt, const model_type& model)
+        : m_opt(opt), m_model(model), m_label(false), m_score(0.), m_prob(0.)
+    {
+    }
+
+    virtual instance_scorer* clone() const
+    {
+        return new binary_scorer(*this);
+    }
+
+    virtual int classify(const parsed_instance& x)
+    {
+        const option& opt = m_opt;
+        if (opt.test && x.label != "+1" && x.label != "1" && x.label != "-1") {
+            throw invalid_data("a class label must be either '+1', '1', or '-1'", *x.line, x.lines);
+        }
+
+        classifier_type inst(m_model);
+        inst.set("__BIAS__", 1.0);
+        for (size_t i = 0;i < x.size;++i) {
+            inst.set(x.fields[i].first, x.fields[i].second);
+        }
+
+        m_label = static_cast<bool>(inst);
+        m_score = inst.score();
+        if (opt.output & option::OUTPUT_PROBABILITY) {
+            m_prob = inst.prob();
+        }
+        return static_cast<int>(m_label);
+    }
+
+    virtual void output(std::ostream& os)
+    {
+        const option& opt = m_opt;
+        os << (m_label ? "+1" : "-1");
+        if (opt.output & option::OUTPUT_PROBABILITY) {
+            os << opt.value_separator << formatted_value(m_prob, opt);
+        } else if (opt.output & option::OUTPUT_SCORE) {
+            os << opt.value_separator << formatted_value(m_score, opt);
         }
     }
 
+    virtual void evaluate(int pl, const std::string& rl)
+    {
+        m_eval(std::make_pair(pl, static_cast<int>(rl == "+1" || rl == "1")));
+    }
+
+    virtual void output_performance(std::ostream& os) const
+    {
+        int positive_labels[] = {1};
+        m_eval.acc.output(os);
+        m_eval.pr.output_micro(os, positive_labels, positive_labels+1);
+    }
+};
+
+template <class model_type>
+static int
+tag(option& opt, const model_type& model)
+{
+    std::ostream& os = opt.os;
+
+    // Register the model to the group of models if necessary.
+    if (opt.group != NULL) {
+        binary_scorer<model_type> scorer(opt, model);
+        return opt.group->add(scorer);
+    }
+
+    binary_tagger<model_type> tagger(opt, model);
+
+    // Serve the requests of clients in the server mode.
+    if (opt.server != NULL) {
+        return serve_requests(opt, tagger);
+    }
+    binary_evaluator eval;
+
+    tag_lines(opt, tagger, eval);
+
     // Output the performance if necessary.
     if (opt.test) {
         int positive_labels[] = {1};
-        acc.output(os);
-        pr.output_micro(os, positive_labels, positive_labels+1);
+        eval.acc.output(os);
+        eval.pr.output_micro(os, positive_labels, positive_labels+1);
     }
 
     return 0;
 }
+
+int binary_tag(option& opt, std::ifstream& ifs)
+{
+    // Load a model.
+    model_type model;
+    classias::hashed_quark attributes;
+    bool hashed = false;
+    read_model(model, attributes, hashed, ifs, opt);
+
+    // Map the attribute identifiers of a hashed model to the buckets.
+    if (hashed) {
+        hashed_attribute_model hmodel(attributes);
+        hmodel.assign(model.begin(), model.end());
+        model_type().swap(model);
+        return tag(opt, hmodel);
+    }
+    return tag(opt, model);
+}
+
+int binary_tag(option& opt, const model_file& mf)
+{
+    compiled_attribute_model model(mf);
+    return tag(opt, model);
+}
@@ -47,12 +47,16 @@
 #include "option.h"
 #include "tokenize.h"
 #include "defaultmap.h"
+#include "compiled_model.h"
+#include "hashed_model.h"
+#include "output.h"
+#include "pipeline.h"
+#include "server.h"
 #include <util.h>
 
 typedef defaultmap<std::string, double> model_type;
 typedef std::vector<std::string> labels_type;
 typedef std::vector<std::string> comments_type;
-typedef classias::classify::linear_multi_logistic<model_type> classifier_type;
 
 class feature_generator
 {
@@ -81,6 +85,7 @@ public:
     }
 };
 
+template <class classifier_type>
 static void
 parse_line(
     classifier_type& inst,
@@ -95,9 +100,9 @@ parse_line(
     double value;
     std::string name;
 
-    // Split the line with tab characters.
-    tokenizer values(line, opt.token_separator);
-    tokenizer::iterator itv = values.begin();
+    // Split the line with tab characters (into views of the line).
+    view_tokenizer values(line, opt.token_separator);
+    view_tokenizer::iterator itv = values.begin();
     if (itv == values.end()) {
         throw invalid_data("no field found in the line", line, lines);
     }
@@ -108,15 +113,15 @@ parse_line(
     }
 
     // Set the truth value for this candidate.
-    if (itv->compare(0, 1, "+") == 0) {
+    if (*itv->begin() == '+') {
         truth = true;
-    } else if (itv->compare(0, 1, "-") == 0) {
+    } else if (*itv->begin() == '-') {
         truth = false;
     } else {
         throw invalid_data("a class label must begins with '+' or '-'", line, lines);
     }
 
-    label = itv->substr(1);
+    label.assign(itv->begin() + 1, itv->end());
 
     // Create a new candidate.
     int i = inst.size();
@@ -125,15 +130,44 @@ parse_line(
     // Set featuress for the instance.
     for (++itv;itv != values.end();++itv) {
         if (!itv->empty()) {
-            get_name_value(*itv, name, value, opt.value_separator);
+            get_name_value(itv->begin(), itv->end(), name, value, opt.value_separator);
             inst.set(i, fgen, name, 0, value);
         }
     }
 }
 
+template <class classifier_type>
+static void
+parse_shared(
+    classifier_type& shared,
+    const feature_generator& fgen,
+    const option& opt,
+    const std::string& line
+    )
+{
+    double value;
+    std::string name;
+
+    // Accumulate the score of the shared features in the first candidate.
+    if (shared.size() == 0) {
+        shared.resize(1);
+    }
+
+    view_tokenizer values(line, opt.token_separator);
+    view_tokenizer::iterator itv = values.begin();
+    for (++itv;itv != values.end();++itv) {
+        if (!itv->empty()) {
+            get_name_value(itv->begin(), itv->end(), name, value, opt.value_separator);
+            shared.set(0, fgen, name, 0, value);
+        }
+    }
+}
+
 static void
 read_model(
     model_type& model,
+    classias::hashed_quark& attributes,
+    bool& hashed,
     std::istream& is,
     const option& opt
     )
@@ -145,6 +179,10 @@ read_model(
             break;
         }
 
+        if (read_hash_declarative(line, attributes, hashed)) {
+            continue;
+        }
+
         int pos = line.find('\t');
         if (pos == line.npos) {
             throw invalid_model("feature weight is missing", line);
@@ -159,6 +197,7 @@ read_model(
     }
 }
 
+template <class classifier_type>
 static void output_model_candidates(
     std::ostream& os,
     classifier_type& inst,
@@ -184,18 +223,19 @@ static void output_model_candidates(
 
         // Output the probability or score.
         if (opt.output & option::OUTPUT_PROBABILITY) {
-            os << opt.value_separator << inst.prob(i);
+            os << opt.value_separator << formatted_value(inst.prob(i), opt);
         } else if (opt.output & option::OUTPUT_SCORE) {
-            os << opt.value_separator << inst.score(i);
+            os << opt.value_separator << formatted_value(inst.score(i), opt);
         }
 
-        os << std::endl;
+        os << end_of_line(opt);
         os << comments[i];
     }
 
-    os << "@eoi" << std::endl;
+    os << "@eoi" << end_of_line(opt);
 }
 
+template <class classifier_type>
 static void output_model_label(
     std::ostream& os,
     classifier_type& inst,
@@ -209,45 +249,62 @@ static void output_model_label(
 
     // Output the probability or score.
     if (opt.output & option::OUTPUT_PROBABILITY) {
-        os << opt.value_separator << inst.prob(inst.argmax());
+        os << opt.value_separator << formatted_value(inst.prob(inst.argmax()), opt);
     } else if (opt.output & option::OUTPUT_SCORE) {
-        os << opt.value_separator << inst.score(inst.argmax());
+        os << opt.value_separator << formatted_value(inst.score(inst.argmax()), opt);
     }
 
-    os << std::endl;
+    os << end_of_line(opt);
 }
 
-int candidate_tag(option& opt, std::ifstream& ifs)
+/**
+ * A tagger of instances for candidate ranking.
+ *  An instance spans the lines from "@boi" to "@eoi", which is a boundary
+ *  of the tagging pipeline.
+ */
+template <class model_type>
+class candidate_tagger
 {
-    int rl = -1;
-    int lines = 0;
-    feature_generator fgen;
-    std::istream& is = opt.is;
-    std::ostream& os = opt.os;
-    bool inner = false;
-    std::string comment_outer, comment_inner;
-    comments_type comments;
-
-    // Load a model.
-    model_type model;
-    read_model(model, ifs, opt);
+public:
+    typedef classias::classify::linear_multi_logistic<model_type> classifier_type;
+    /// The predicted and reference candidates of an instance.
+    typedef std::pair<int, int> outcome_type;
+
+protected:
+    const option& m_opt;
+    feature_generator m_fgen;
+    classifier_type m_inst;
+    classifier_type m_shared;
+    labels_type m_labels;
+    comments_type m_comments;
+    std::vector<int> m_top;
+    std::string m_comment_outer, m_comment_inner;
+    bool m_inner;
+    int m_rl;
 
-    // Create an instance of a classifier on the model.
-    classifier_type inst(model);
-    labels_type labels;
+public:
+    candidate_tagger(const option& opt, const model_type& model)
+        : m_opt(opt), m_inst(model), m_shared(model), m_inner(false), m_rl(-1)
+    {
+    }
 
-    // Objects for performance evaluation.
-    classias::accuracy acc;
-    classias::precall pr(labels.size());
+    bool boundary(const std::string& line) const
+    {
+        return (line == "@eoi");
+    }
 
-    for (;;) {
-        // Read a line.
-        std::string line;
-        std::getline(is, line);
-        if (is.eof()) {
-            break;
-        }
-        ++lines;
+    bool tag(
+        const std::string& line,
+        int lines,
+        std::ostream& os,
+        outcome_type& outcome
+        )
+    {
+        const option& opt = m_opt;
+        classifier_type& inst = m_inst;
+        labels_type& labels = m_labels;
+        comments_type& comments = m_comments;
+        int& rl = m_rl;
 
         // An empty line or comment line.
         if (line.empty() || line.compare(0, 1, "#") == 0) {
@@ -256,26 +313,33 @@ int candidate_tag(option& opt, std::ifstream& ifs)
                     // Store the comment line to the current instance.
                     comments[inst.size()-1] += line;
                     comments[inst.size()-1] += '\n';
-                } else if (inner) {
-                    comment_inner += line;
-                    comment_inner += '\n';
+                } else if (m_inner) {
+                    m_comment_inner += line;
+                    m_comment_inner += '\n';
                 } else {
-                    comment_outer += line;
-                    comment_outer += '\n';
+                    m_comment_outer += line;
+                    m_comment_outer += '\n';
                 }
             }
-            continue;
+            return false;
         }
 
         if (line.compare(0, 4, "@boi") == 0) {
             // Begin of an instance.
             rl = -1;
             inst.clear();
+            m_shared.clear();
             labels.clear();
             comments.clear();
-            inner = true;
+            m_inner = true;
 
         } else if (line == "@eoi") {
+            // Add the score of the shared features to every candidate.
+            if (0 < m_shared.size()) {
+                for (int i = 0;i < inst.size();++i) {
+                    inst.add(i, m_shared.score(0));
+                }
+            }
             inst.finalize();
 
             // Determine whether we output this instance or not.
@@ -283,12 +347,19 @@ int candidate_tag(option& opt, std::ifstream& ifs)
                 (opt.condition == option::CONDITION_FALSE && rl != inst.argmax())) {
 
                 // Output BOI.
-                os << comment_outer;
-                os << "@boi" << std::endl;
-                os << comment_inner;
+                os << m_comment_outer;
+                os << "@boi" << end_of_line(opt);
+                os << m_comment_inner;
+
+                if ((opt.output & option::OUTPUT_ALL) || 0 < opt.top) {
+                    // Output all candidates or the k best ones.
+                    if (0 < opt.top) {
+                        inst.top(opt.top, m_top);
+                    }
+                    const int n = (0 < opt.top) ? (int)m_top.size() : inst.size();
 
-                if (opt.output & option::OUTPUT_ALL) {
-                    for (int i = 0;i < inst.size();++i) {
+                    for (int j = 0;j < n;++j) {
+                        const int i = (0 < opt.top) ? m_top[j] : j;
                         // Output the reference label.
                         if (opt.output & option::OUTPUT_RLABEL) {
                             os << ((i == rl) ? '+' : '-');
@@ -299,12 +370,12 @@ int candidate_tag(option& opt, std::ifstream& ifs)
 
                         // Output the score/probability if necessary.
                         if (opt.output & option::OUTPUT_PROBABILITY) {
-                            os << opt.value_separator << inst.prob(i);
+                            os << opt.value_separator << formatted_value(inst.prob(i), opt);
                         } else if (opt.output & option::OUTPUT_SCORE) {
-                            os << opt.value_separator << inst.score(i);
+                            os << opt.value_separator << formatted_value(inst.score(i), opt);
                         }
 
-                        os << std::endl;
+                        os << end_of_line(opt);
                         os << comments[i];
                     }
 
@@ -318,36 +389,42 @@ int candidate_tag(option& opt, std::ifstream& ifs)
 
                     // Output the score/probability if necessary.
                     if (opt.output & option::OUTPUT_PROBABILITY) {
-                        os << opt.value_separator << inst.prob(inst.argmax());
+                        os << opt.value_separator << formatted_value(inst.prob(inst.argmax()), opt);
                     } else if (opt.output & option::OUTPUT_SCORE) {
-                        os << opt.value_separator << inst.score(inst.argmax());
+                        os << opt.value_separator << formatted_value(inst.score(inst.argmax()), opt);
                     }
 
-                    os << std::endl;
+                    os << end_of_line(opt);
 
                 }
 
                 // Output EOI.
-                os << "@eoi" << std::endl;
+                os << "@eoi" << end_of_line(opt);
             }
 
-            // Accumulate the performance.
-            if (opt.test) {
-                acc.set(inst.argmax() == rl);
-            }
+            // Report the candidates for the performance.
+            outcome.first = inst.argmax();
+            outcome.second = rl;
 
             rl = -1;
             inst.clear();
+            m_shared.clear();
             labels.clear();
             comments.clear();
-            comment_inner.clear();
-            comment_outer.clear();
-            inner = false;
+            m_comment_inner.clear();
+            m_comment_outer.clear();
+            m_inner = false;
+            return opt.test;
+
+        } else if (line.compare(0, 7, "@shared") == 0 &&
+            (line.size() == 7 || line[7] == opt.token_separator)) {
+            // Features shared by the candidates.
+            parse_shared(m_shared, m_fgen, opt, line);
 
         } else {
             std::string label;
             bool truth = false;
-            parse_line(inst, fgen, label, truth, opt, line, lines);
+            parse_line(inst, m_fgen, label, truth, opt, line, lines);
             if (truth) {
                 rl = inst.size() - 1;
             }
@@ -359,12 +436,73 @@ int candidate_tag(option& opt, std::ifstream& ifs)
                 comments.resize(inst.size());
             }
         }
+        return false;
+    }
+};
+
+/**
+ * An evaluator accumulating the accuracy of candidate ranking.
+ */
+struct candidate_evaluator
+{
+    classias::accuracy acc;
+
+    void operator()(const std::pair<int, int>& outcome)
+    {
+        acc.set(outcome.first == outcome.second);
+    }
+};
+
+template <class model_type>
+static int
+tag(option& opt, const model_type& model)
+{
+    std::ostream& os = opt.os;
+
+    // An instance of candidates spans lines whereas a group of models
+    // scores the instances of single lines.
+    if (opt.group != NULL) {
+        throw invalid_model("a candidate model cannot be used with other models (-m)");
     }
 
+    candidate_tagger<model_type> tagger(opt, model);
+
+    // Serve the requests of clients in the server mode.
+    if (opt.server != NULL) {
+        return serve_requests(opt, tagger);
+    }
+    candidate_evaluator eval;
+
+    tag_lines(opt, tagger, eval);
+
     // Output the performance if necessary.
     if (opt.test) {
-        acc.output(os);
+        eval.acc.output(os);
     }
 
     return 0;
 }
+
+int candidate_tag(option& opt, std::ifstream& ifs)
+{
+    // Load a model.
+    model_type model;
+    classias::hashed_quark attributes;
+    bool hashed = false;
+    read_model(model, attributes, hashed, ifs, opt);
+
+    // Map the attribute identifiers of a hashed model to the buckets.
+    if (hashed) {
+        hashed_attribute_model hmodel(attributes);
+        hmodel.assign(model.begin(), model.end());
+        model_type().swap(model);
+        return tag(opt, hmodel);
+    }
+    return tag(opt, model);
+}
+
+int candidate_tag(option& opt, const model_file& mf)
+{
+    compiled_attribute_model model(mf);
+    return tag(opt, model);
+}
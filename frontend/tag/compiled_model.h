@@ -0,0 +1,148 @@
+/*
+ *		Weight lookup on compiled models.
+ *
+ * Copyright (c) 2008,2009 Naoaki Okazaki
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the names of the authors nor the names of its contributors
+ *       may be used to endorse or promote products derived from this
+ *       software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* $Id$ */
+
+#ifndef __COMPILED_MODEL_H__
+#define __COMPILED_MODEL_H__
+
+#include <string>
+#include <model_file.h>
+
+/**
+ * A read-only weight vector indexed by attribute names on a compiled model.
+ *  This class exposes the same interface as defaultmap<std::string, double>
+ *  for the classifiers; a missing attribute has the weight of zero.
+ */
+class compiled_attribute_model
+{
+public:
+    typedef std::string key_type;
+    typedef double value_type;
+
+protected:
+    const model_file& m_mf;
+
+public:
+    compiled_attribute_model(const model_file& mf) : m_mf(mf)
+    {
+    }
+
+    value_type operator[](const key_type& key) const
+    {
+        int a = m_mf.find(key);
+        return (0 <= a ? m_mf.weight(a, 0) : 0.);
+    }
+};
+
+/**
+ * A read-only weight vector of a compiled model indexed by the positions
+ * of the weights in the CSR matrix.
+ */
+class compiled_weights
+{
+public:
+    typedef size_t key_type;
+    typedef double value_type;
+
+protected:
+    const model_file& m_mf;
+
+public:
+    compiled_weights(const model_file& mf) : m_mf(mf)
+    {
+    }
+
+    value_type operator[](const key_type& k) const
+    {
+        return m_mf.row_weight(k);
+    }
+};
+
+/**
+ * A feature generator on a compiled model.
+ *  This class maps a pair of attribute and label identifiers to the
+ *  position of its weight in the CSR matrix by a binary search within the
+ *  row of the attribute (whose labels are sorted in ascending order). The
+ *  row of an attribute also serves as its posting list of labels.
+ */
+class compiled_feature_generator
+{
+public:
+    typedef int attribute_type;
+    typedef int label_type;
+    typedef size_t feature_type;
+
+protected:
+    const model_file& m_mf;
+
+public:
+    compiled_feature_generator(const model_file& mf) : m_mf(mf)
+    {
+    }
+
+    inline bool forward(
+        const attribute_type& a,
+        const label_type& l,
+        feature_type& f
+        ) const
+    {
+        size_t lo = m_mf.row_begin(a), hi = m_mf.row_end(a);
+        while (lo < hi) {
+            size_t mid = lo + (hi - lo) / 2;
+            int x = m_mf.row_label(mid);
+            if (x == l) {
+                f = mid;
+                return true;
+            } else if (x < l) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        return false;
+    }
+
+    /**
+     * Calls func(l, f) for every label l having a weight f for an attribute.
+     *  @param  a           The attribute.
+     *  @param  func        The function object.
+     */
+    template <class function_type>
+    inline void postings(const attribute_type& a, function_type& func) const
+    {
+        const size_t last = m_mf.row_end(a);
+        for (size_t k = m_mf.row_begin(a);k < last;++k) {
+            func(m_mf.row_label(k), k);
+        }
+    }
+};
+
+#endif/*__COMPILED_MODEL_H__*/
@@ -0,0 +1,151 @@
+/*
+ *		Weight lookup on models with hashed attributes.
+ *
+ *
+ * Copyright (c) 2008,2009 Naoaki Okazaki
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the names of the authors nor the names of its contributors
+ *       may be used to endorse or promote products derived from this
+ *       software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* $Id$ */
+
+#ifndef __HASHED_MODEL_H__
+#define __HASHED_MODEL_H__
+
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <classias/hashed_quark.h>
+#include <classias/memory.h>
+#include <util.h>
+
+/**
+ * Reads a declarative of the attribute hashing in a text model.
+ *  A model trained with --hash-bits has a line "@hash <bits> <signed>" and
+ *  lines "@reserve <name>" for the attributes with reserved identifiers in
+ *  the header, and the weights of the other attributes are written by their
+ *  identifiers.
+ *  @param  line        The line of the model.
+ *  @param  attributes  The hashed quark configured by the declaratives.
+ *  @param  hashed      Set to \c true if the line declares the hashing.
+ *  @return bool        \c true if the line is a declarative of the hashing.
+ */
+inline static bool
+read_hash_declarative(
+    const std::string& line,
+    classias::hashed_quark& attributes,
+    bool& hashed
+    )
+{
+    if (line.compare(0, 6, "@hash\t") == 0) {
+        std::string::size_type pos = line.find('\t', 6);
+        if (pos == line.npos) {
+            throw invalid_model("the sign of attribute hashing is missing", line);
+        }
+        int bits = std::atoi(line.c_str() + 6);
+        if (bits < 1 || 30 < bits) {
+            throw invalid_model("invalid number of hash bits", line);
+        }
+        attributes.set_bits(bits);
+        attributes.set_signed(line.substr(pos+1) == "signed");
+        hashed = true;
+        return true;
+    } else if (line.compare(0, 9, "@reserve\t") == 0) {
+        attributes.reserve(line.substr(9));
+        return true;
+    }
+    return false;
+}
+
+/**
+ * Returns the identifier of an attribute name written in a hashed model.
+ *  @param  attributes  The hashed quark.
+ *  @param  name        The name of a reserved attribute or an identifier.
+ *  @return size_t      The identifier.
+ */
+inline static size_t
+hashed_attribute_id(
+    const classias::hashed_quark& attributes,
+    const std::string& name
+    )
+{
+    double sign;
+    const size_t R = attributes.num_reserved();
+    size_t a = attributes.to_value(name, sign);
+    if (R <= a) {
+        char *end = NULL;
+        a = (size_t)std::strtoul(name.c_str(), &end, 10);
+        if (name.empty() || *end != 0 || a < R || attributes.size() <= a) {
+            throw invalid_model("invalid attribute identifier in a hashed model", name);
+        }
+    }
+    return a;
+}
+
+/**
+ * A read-only weight vector indexed by attribute names on a hashed model.
+ *  This class exposes the same interface as defaultmap<std::string, double>
+ *  for the classifiers; the weight of an attribute is that of its bucket
+ *  multiplied by the sign of the attribute.
+ */
+class hashed_attribute_model
+{
+public:
+    typedef std::string key_type;
+    typedef double value_type;
+
+protected:
+    const classias::hashed_quark& m_attributes;
+    std::vector<double, classias::placed_allocator<double> > m_weights;
+
+public:
+    hashed_attribute_model(const classias::hashed_quark& attributes)
+        : m_attributes(attributes), m_weights(attributes.size(), 0.)
+    {
+    }
+
+    /**
+     * Sets the weights from a map of attribute names to weights.
+     *  @param  first       The iterator for the first weight.
+     *  @param  last        The iterator for the element just beyond the
+     *                      last weight.
+     */
+    template <class iterator_type>
+    void assign(iterator_type first, iterator_type last)
+    {
+        for (;first != last;++first) {
+            m_weights[hashed_attribute_id(m_attributes, first->first)] = first->second;
+        }
+    }
+
+    value_type operator[](const key_type& key) const
+    {
+        double sign;
+        size_t a = m_attributes.to_value(key, sign);
+        return sign * m_weights[a];
+    }
+};
+
+#endif/*__HASHED_MODEL_H__*/
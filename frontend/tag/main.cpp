@@ -40,12 +40,21 @@
 #include <typeinfo>
 #include <classias/version.h>
 #include <optparse.h>
+#include <decompress.h>
+#include <decompress_command.h>
+#include <model_file.h>
 
 #include "option.h"
+#include "output.h"
+#include "model_group.h"
+#include "server.h"
 
 int binary_tag(option& opt, std::ifstream& ifs);
 int multi_tag(option& opt, std::ifstream& ifs);
 int candidate_tag(option& opt, std::ifstream& ifs);
+int binary_tag(option& opt, const model_file& mf);
+int multi_tag(option& opt, const model_file& mf);
+int candidate_tag(option& opt, const model_file& mf);
 
 class optionparser : public option, public optparse
 {
@@ -61,6 +70,85 @@ public:
     BEGIN_OPTION_MAP_INLINE()
         ON_OPTION_WITH_ARG(SHORTOPT('m') || LONGOPT("model"))
             model = arg;
+            models.push_back(arg);
+
+        ON_OPTION_WITH_ARG(LONGOPT("weight-type"))
+            if (strcmp(arg, "double") == 0) {
+                weight_type = WEIGHT_DOUBLE;
+            } else if (strcmp(arg, "float") == 0) {
+                weight_type = WEIGHT_FLOAT;
+            } else if (strcmp(arg, "int16") == 0) {
+                weight_type = WEIGHT_INT16;
+            } else if (strcmp(arg, "int8") == 0) {
+                weight_type = WEIGHT_INT8;
+            } else {
+                std::stringstream ss;
+                ss << "unknown weight type specified: " << arg;
+                throw invalid_value(ss.str());
+            }
+
+        ON_OPTION_WITH_ARG(LONGOPT("precision"))
+            if (strcmp(arg, "shortest") == 0) {
+                precision = PRECISION_SHORTEST;
+            } else {
+                char *end = NULL;
+                long n = strtol(arg, &end, 10);
+                if (*arg == 0 || *end != 0 || n < 0 || 17 < n) {
+                    std::stringstream ss;
+                    ss << "precision must be 'shortest' or an integer within [0, 17]: " << arg;
+                    throw invalid_value(ss.str());
+                }
+                precision = (int)n;
+            }
+
+        ON_OPTION(LONGOPT("line-buffered"))
+            line_buffered = true;
+
+        ON_OPTION_WITH_ARG(LONGOPT("threads"))
+            threads = atoi(arg);
+            if (threads < 1) {
+                std::stringstream ss;
+                ss << "the number of threads for tagging must be positive: " << arg;
+                throw invalid_value(ss.str());
+            }
+
+        ON_OPTION_WITH_ARG(LONGOPT("huge-pages"))
+            if (!classias::parse_huge_pages(memory, arg)) {
+                std::stringstream ss;
+                ss << "unknown size of huge pages specified: " << arg;
+                throw invalid_value(ss.str());
+            }
+            if (!classias::memory_policy::huge_pages_supported()) {
+                throw invalid_value("huge pages are not supported in this build");
+            }
+
+        ON_OPTION_WITH_ARG(LONGOPT("numa"))
+            if (!classias::parse_numa_policy(memory, arg)) {
+                std::stringstream ss;
+                ss << "unknown NUMA policy specified: " << arg;
+                throw invalid_value(ss.str());
+            }
+            if (memory.numa != classias::memory_policy::NUMA_LOCAL &&
+                !classias::memory_policy::numa_supported()) {
+                throw invalid_value("NUMA policies are not supported on this system");
+            }
+            if (memory.numa == classias::memory_policy::NUMA_BIND &&
+                classias::memory_policy::num_nodes() <= memory.node) {
+                std::stringstream ss;
+                ss << "no such NUMA node: " << memory.node;
+                throw invalid_value(ss.str());
+            }
+
+        ON_OPTION_WITH_ARG(LONGOPT("serve"))
+            serve = arg;
+
+        ON_OPTION_WITH_ARG(LONGOPT("latency-budget"))
+            latency_budget = atof(arg);
+            if (latency_budget < 0.) {
+                std::stringstream ss;
+                ss << "the latency budget must be non-negative: " << arg;
+                throw invalid_value(ss.str());
+            }
 
         ON_OPTION(SHORTOPT('t') || LONGOPT("test"))
             test = true;
@@ -109,6 +197,17 @@ public:
         ON_OPTION(SHORTOPT('a') || LONGOPT("all"))
             output |= OUTPUT_ALL;
 
+        ON_OPTION_WITH_ARG(LONGOPT("top"))
+            top = atoi(arg);
+            if (top < 1) {
+                std::stringstream ss;
+                ss << "the number of the best labels must be positive: " << arg;
+                throw invalid_value(ss.str());
+            }
+
+        ON_OPTION(LONGOPT("prune"))
+            prune = true;
+
         ON_OPTION(SHORTOPT('f') || LONGOPT("false"))
             condition = CONDITION_FALSE;
             output |= OUTPUT_RLABEL;
@@ -128,10 +227,23 @@ public:
 static void usage(std::ostream& os, const char *argv0)
 {
     os << "USAGE: " << argv0 << " [OPTIONS]" << std::endl;
-    os << "This utility tags labels for a data set read from STDIN." << std::endl;
+    os << "This utility tags labels for a data set read from STDIN; the data set may be" << std::endl;
+    os << "compressed by gzip, bzip2, xz, or zstd." << std::endl;
     os << std::endl;
     os << "OPTIONS:" << std::endl;
     os << "  -m, --model=FILE      load the model from FILE" << std::endl;
+    os << "                        (a text model or a compiled model that is mapped to" << std::endl;
+    os << "                        the memory without parsing); with multiple -m options," << std::endl;
+    os << "                        every line is parsed once and the predictions of" << std::endl;
+    os << "                        the binary and multi-class models are written as" << std::endl;
+    os << "                        columns in the order of the options" << std::endl;
+    os << "      --weight-type=TYPE hold the weights of a multi-class text model in TYPE" << std::endl;
+    os << "                        (DEFAULT='double'); a compiled model uses the type" << std::endl;
+    os << "                        with which it was written:" << std::endl;
+    os << "      double                double precision" << std::endl;
+    os << "      float                 single precision" << std::endl;
+    os << "      int16, int8           16/8-bit integers with a scale for every attribute" << std::endl;
+    os << "                            (dense models) or block of 64 weights" << std::endl;
     os << "  -t, --test            evaluate the tagging performance on the labeled data" << std::endl;
     os << "  -n, --negative=LABEL  assume LABEL to be a negative label" << std::endl;
     os << "  -w, --score           output scores for the labels" << std::endl;
@@ -139,8 +251,41 @@ static void usage(std::ostream& os, const char *argv0)
     os << "  -r, --reference       output reference labels as well as predicted labels" << std::endl;
     os << "  -k, --comment         output comment lines in the tagging output" << std::endl;
     os << "  -a, --all             output all candidate labels in the tagging output" << std::endl;
+    os << "      --top=K           output the K candidate labels of the highest scores in" << std::endl;
+    os << "                        descending order, in the format of --all" << std::endl;
+    os << "      --prune           skip the labels that cannot enter the K best ones of" << std::endl;
+    os << "                        --top with the remaining attributes (a sparse or" << std::endl;
+    os << "                        compiled multi-class model without -p); this pays off" << std::endl;
+    os << "                        when a few attributes dominate the scores" << std::endl;
     os << "  -f, --false           output false instances only" << std::endl;
     os << "  -q, --quiet           suppress tagging results from the output" << std::endl;
+    os << "      --precision=N     output scores and probabilities with N digits after" << std::endl;
+    os << "                        the decimal point, or 'shortest' for the shortest" << std::endl;
+    os << "                        digits that read back as the same values" << std::endl;
+    os << "                        (DEFAULT: six significant digits)" << std::endl;
+    os << "      --line-buffered   write every line of the output immediately instead of" << std::endl;
+    os << "                        writing the output in large blocks" << std::endl;
+    os << "      --threads=N       tag the instances with N threads while a thread reads" << std::endl;
+    os << "                        lines and another one writes the results in the input" << std::endl;
+    os << "                        order (ignored with --line-buffered)" << std::endl;
+    os << "      --huge-pages=MODE back the large memory blocks (the weights of a" << std::endl;
+    os << "                        model) with huge pages:" << std::endl;
+    os << "      none                  the page size of the system (DEFAULT)" << std::endl;
+    os << "      transparent           transparent huge pages" << std::endl;
+    os << "      2mb, 1gb              explicit huge pages reserved in the system, falling" << std::endl;
+    os << "                            back to transparent huge pages" << std::endl;
+    os << "      --numa=POLICY     place the large memory blocks on NUMA nodes by POLICY:" << std::endl;
+    os << "      local                 the node of the thread touching a page first" << std::endl;
+    os << "                            (DEFAULT)" << std::endl;
+    os << "      interleave            interleave the pages over all nodes" << std::endl;
+    os << "      bind:N                bind the pages to the node N" << std::endl;
+    os << "      --serve=ADDR      load the model once and tag the lines sent by clients" << std::endl;
+    os << "                        to ADDR, HOST:PORT (TCP) or unix:PATH (a Unix domain" << std::endl;
+    os << "                        socket), with the threads of --threads; SIGHUP reloads" << std::endl;
+    os << "                        the model without dropping requests, and the line" << std::endl;
+    os << "                        '@stats' returns the counters and latency histogram" << std::endl;
+    os << "      --latency-budget=MS wait up to MS milliseconds for more requests to be" << std::endl;
+    os << "                        tagged in a batch in the server mode (DEFAULT=0)" << std::endl;
     os << "  -s, --token-separator=SEP assume SEP character as a token separator:" << std::endl;
     os << "      ' ',  s, spc, space       a SPACE (' ') character (DEFAULT)" << std::endl;
     os << "      '\\t', t, tab              a TAB ('\\t') character" << std::endl;
@@ -173,40 +318,33 @@ static int check_model(std::istream& is)
     }
 }
 
-int main(int argc, char *argv[])
+static int tag_data(option& opt)
 {
     int ret = 0;
-    int arg_used = 0;
-    optionparser opt;
-    std::istream& is = opt.is;
-    std::ostream& os = opt.os;
     std::ostream& es = opt.es;
 
-    // Parse the command-line options.
-    try { 
-        arg_used = opt.parse(argv, argc);
-    } catch (const optparse::unrecognized_option& e) {
-        es << "ERROR: unrecognized option: " << e.what() << std::endl;
-        return 1;
-    } catch (const optparse::invalid_value& e) {
-        es << "ERROR: " << e.what() << std::endl;
+    // Use a compiled model if the model file is in the binary format.
+    try {
+        model_file mf;
+        if (mf.open(opt.model)) {
+            switch (mf.type()) {
+            case option::TYPE_BINARY:
+                return binary_tag(opt, mf);
+            case option::TYPE_MULTI_SPARSE:
+            case option::TYPE_MULTI_DENSE:
+                return multi_tag(opt, mf);
+            case option::TYPE_CANDIDATE:
+                return candidate_tag(opt, mf);
+            default:
+                es << "ERROR: unknown model type" << std::endl;
+                return 1;
+            }
+        }
+    } catch (const std::exception& e) {
+        es << "ERROR: " << typeid(e).name() << ": " << e.what() << std::endl;
         return 1;
     }
 
-    // Show the help message and exit.
-    if (opt.mode == option::MODE_HELP) {
-        usage(os, argv[0]);
-        return ret;
-    } else if (opt.mode == option::MODE_VERSION) {
-        // Show the copyright information.
-        os << CLASSIAS_NAME " ";
-        os << CLASSIAS_VERSION << " ";
-        os << "tagger ";
-        os << CLASSIAS_COPYRIGHT << std::endl;
-        os << std::endl;
-        return ret;
-    }
-
     // Open the model file.
     std::ifstream ifs(opt.model.c_str());
     if (ifs.fail()) {
@@ -242,3 +380,125 @@ int main(int argc, char *argv[])
 
     return ret;
 }
+
+int main(int argc, char *argv[])
+{
+    int ret = 0;
+    optionparser opt;
+
+    // Do not synchronize the standard streams with C stdio so that the
+    // decompressor reads the bytes of STDIN as they are available.
+    std::ios::sync_with_stdio(false);
+
+    std::istream& is = opt.is;
+    std::ostream& os = opt.os;
+    std::ostream& es = opt.es;
+
+    // Parse the command-line options.
+    try { 
+        opt.parse(argv, argc);
+    } catch (const optparse::unrecognized_option& e) {
+        es << "ERROR: unrecognized option: " << e.what() << std::endl;
+        return 1;
+    } catch (const optparse::invalid_value& e) {
+        es << "ERROR: " << e.what() << std::endl;
+        return 1;
+    }
+
+    // Show the help message and exit.
+    if (opt.mode == option::MODE_HELP) {
+        usage(os, argv[0]);
+        return ret;
+    } else if (opt.mode == option::MODE_VERSION) {
+        // Show the copyright information.
+        os << CLASSIAS_NAME " ";
+        os << CLASSIAS_VERSION << " ";
+        os << "tagger ";
+        os << CLASSIAS_COPYRIGHT << std::endl;
+        os << std::endl;
+        return ret;
+    }
+
+    if (opt.prune && opt.top == 0) {
+        es << "ERROR: pruning the labels requires the number of the best labels (--top)" << std::endl;
+        return 1;
+    }
+    if (opt.prune && (opt.output & option::OUTPUT_PROBABILITY)) {
+        es << "ERROR: pruning the labels cannot output probabilities (-p)" << std::endl;
+        return 1;
+    }
+
+    // A group of models writes the predicted labels in columns.
+    if (1 < opt.models.size()) {
+        if (!opt.serve.empty()) {
+            es << "ERROR: the server mode cannot tag with multiple models (-m)" << std::endl;
+            return 1;
+        }
+        if ((opt.output & option::OUTPUT_ALL) || 0 < opt.top) {
+            es << "ERROR: multiple models (-m) cannot output all candidate labels (-a, --top)" << std::endl;
+            return 1;
+        }
+        if (opt.condition == option::CONDITION_FALSE) {
+            es << "ERROR: multiple models (-m) cannot output false instances only (-f)" << std::endl;
+            return 1;
+        }
+    }
+
+    // Place the large memory blocks allocated from now on.
+    classias::global_memory_policy() = opt.memory;
+
+    // Run the tagging server.
+    if (!opt.serve.empty()) {
+        if (opt.test) {
+            es << "ERROR: the server mode cannot evaluate the tagging performance (-t)" << std::endl;
+            return 1;
+        }
+        tag_server server(opt, tag_data);
+        opt.server = &server;
+        return server.run();
+    }
+
+    // Decompress the input data if necessary (by an external command if
+    // the library is not built in).
+    decompress_streambuf buf(is.rdbuf());
+    decompress_command command;
+    const bool external = !buf.supported();
+    std::streambuf* src = NULL;
+    if (!external) {
+        src = is.rdbuf(&buf);
+    } else {
+        try {
+            command.start(buf);
+        } catch (const std::exception& e) {
+            es << "ERROR: " << e.what() << std::endl;
+            return 1;
+        }
+        src = is.rdbuf(command.rdbuf());
+    }
+
+    model_group group(opt, tag_data);
+    if (opt.line_buffered) {
+        ret = (1 < opt.models.size() ? group.run() : tag_data(opt));
+    } else {
+        // Write the output in large blocks.
+        block_output obuf(os.rdbuf());
+        std::streambuf* dst = os.rdbuf(&obuf);
+        ret = (1 < opt.models.size() ? group.run() : tag_data(opt));
+        os.flush();
+        os.rdbuf(dst);
+    }
+    is.rdbuf(src);
+    if (ret == 0 && !buf.error().empty()) {
+        es << "ERROR: " << buf.error() << std::endl;
+        ret = 1;
+    }
+    if (external) {
+        int code = command.finish(ret != 0);
+        if (ret == 0 && code != 0) {
+            es << "ERROR: " << command.name() << " failed to decompress the input data (exit_code = " << code << ")" << std::endl;
+            ret = 1;
+        }
+    }
+
+    return ret;
+}
@@ -0,0 +1,356 @@
+/*
+ *		Tagging with multiple models in a single pass over the input.
+ *
+ *
+ * Copyright (c) 2008,2009 Naoaki Okazaki
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the names of the authors nor the names of its contributors
+ *       may be used to endorse or promote products derived from this
+ *       software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* $Id$ */
+
+#ifndef __MODEL_GROUP_H__
+#define __MODEL_GROUP_H__
+
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+#include <tokenize.h>
+#include <util.h>
+#include "option.h"
+#include "output.h"
+#include "pipeline.h"
+
+/*
+With multiple -m options, classias-tag parses every line of the input only
+once and scores the instance with all the models, writing the predictions
+of the models as the columns of a line. The models are loaded by the same
+functions as a single model; instead of tagging the input, the function
+loading the model #k registers a scorer of the model to the model_group,
+which then loads the model #k+1 while the previous models stay alive in the
+frames of the callers. The last model starts the tagging of the input.
+*/
+
+/**
+ * An instance parsed from a line of the input data.
+ */
+struct parsed_instance
+{
+    /// The line.
+    const std::string* line;
+    /// The line number.
+    int lines;
+    /// The label (the first field).
+    std::string label;
+    /// The attributes and values (the first \c size elements are valid).
+    std::vector<std::pair<std::string, double> > fields;
+    /// The number of attributes.
+    size_t size;
+
+    parsed_instance() : line(NULL), lines(0), size(0)
+    {
+    }
+};
+
+/**
+ * The interface of a model scoring the parsed instances.
+ *  A scorer is copied by clone() to every tagging thread, whereas the
+ *  performance is accumulated only by the scorer registered to the group.
+ */
+class instance_scorer
+{
+public:
+    virtual ~instance_scorer()
+    {
+    }
+
+    /**
+     * Returns a copy of the scorer for a tagging thread.
+     */
+    virtual instance_scorer* clone() const = 0;
+
+    /**
+     * Classifies an instance.
+     *  @param  inst        The instance.
+     *  @return int         The predicted label.
+     */
+    virtual int classify(const parsed_instance& inst) = 0;
+
+    /**
+     * Writes the prediction for the instance classified last.
+     *  @param  os          The output stream.
+     */
+    virtual void output(std::ostream& os) = 0;
+
+    /**
+     * Accumulates the performance with an instance.
+     *  @param  pl          The predicted label.
+     *  @param  rl          The reference label.
+     */
+    virtual void evaluate(int pl, const std::string& rl) = 0;
+
+    /**
+     * Writes the performance.
+     *  @param  os          The output stream.
+     */
+    virtual void output_performance(std::ostream& os) const = 0;
+};
+
+/**
+ * A tagger scoring every instance with all the models of a group.
+ */
+class model_group_tagger
+{
+public:
+    /// The predicted labels by the models and the reference label.
+    typedef std::pair<std::vector<int>, std::string> outcome_type;
+
+protected:
+    const option* m_opt;
+    std::vector<instance_scorer*> m_scorers;
+    parsed_instance m_inst;
+
+public:
+    model_group_tagger(const option& opt, const std::vector<instance_scorer*>& scorers)
+        : m_opt(&opt)
+    {
+        clone(scorers);
+    }
+
+    model_group_tagger(const model_group_tagger& rho)
+        : m_opt(rho.m_opt)
+    {
+        clone(rho.m_scorers);
+    }
+
+    model_group_tagger& operator=(const model_group_tagger& rho)
+    {
+        if (this != &rho) {
+            release();
+            m_opt = rho.m_opt;
+            clone(rho.m_scorers);
+        }
+        return *this;
+    }
+
+    virtual ~model_group_tagger()
+    {
+        release();
+    }
+
+    bool boundary(const std::string& line) const
+    {
+        return true;
+    }
+
+    bool tag(
+        const std::string& line,
+        int lines,
+        std::ostream& os,
+        outcome_type& outcome
+        )
+    {
+        const option& opt = *m_opt;
+
+        // An empty line or comment line.
+        if (line.empty() || line.compare(0, 1, "#") == 0) {
+            // Output the comment line if necessary.
+            if (opt.output & option::OUTPUT_COMMENT) {
+                os << line << end_of_line(opt);
+            }
+            return false;
+        }
+
+        // Parse the line once for all the models.
+        parse(line, lines);
+
+        // Classify the instance with every model.
+        outcome.first.resize(m_scorers.size());
+        for (size_t i = 0;i < m_scorers.size();++i) {
+            outcome.first[i] = m_scorers[i]->classify(m_inst);
+        }
+
+        if (opt.condition == option::CONDITION_ALL) {
+            // Output the reference label.
+            if (opt.output & option::OUTPUT_RLABEL) {
+                os << m_inst.label << opt.token_separator;
+            }
+
+            // Output the predictions of the models as columns.
+            for (size_t i = 0;i < m_scorers.size();++i) {
+                if (0 < i) {
+                    os << opt.token_separator;
+                }
+                m_scorers[i]->output(os);
+            }
+            os << end_of_line(opt);
+        }
+
+        // Report the labels for the performance.
+        outcome.second = m_inst.label;
+        return opt.test;
+    }
+
+protected:
+    void parse(const std::string& line, int lines)
+    {
+        const option& opt = *m_opt;
+        double value;
+
+        // Split the line with tab characters (into views of the line).
+        view_tokenizer values(line, opt.token_separator);
+        view_tokenizer::iterator itv = values.begin();
+        if (itv == values.end()) {
+            throw invalid_data("no field found in the line", line, lines);
+        }
+
+        // The first field always presents a label, which can be empty.
+        m_inst.line = &line;
+        m_inst.lines = lines;
+        get_name_value(itv->begin(), itv->end(), m_inst.label, value, opt.value_separator);
+
+        // Store the attributes, reusing the strings of the previous lines.
+        m_inst.size = 0;
+        for (++itv;itv != values.end();++itv) {
+            if (!itv->empty()) {
+                if (m_inst.size == m_inst.fields.size()) {
+                    m_inst.fields.resize(m_inst.size + 1);
+                }
+                std::pair<std::string, double>& field = m_inst.fields[m_inst.size++];
+                get_name_value(
+                    itv->begin(), itv->end(), field.first, field.second,
+                    opt.value_separator);
+            }
+        }
+    }
+
+    void clone(const std::vector<instance_scorer*>& scorers)
+    {
+        for (size_t i = 0;i < scorers.size();++i) {
+            m_scorers.push_back(scorers[i]->clone());
+        }
+    }
+
+    void release()
+    {
+        for (size_t i = 0;i < m_scorers.size();++i) {
+            delete m_scorers[i];
+        }
+        m_scorers.clear();
+    }
+};
+
+/**
+ * An evaluator passing the outcomes to the scorers of a group.
+ */
+struct model_group_evaluator
+{
+    const std::vector<instance_scorer*>* scorers;
+
+    void operator()(const model_group_tagger::outcome_type& outcome)
+    {
+        for (size_t i = 0;i < scorers->size();++i) {
+            (*scorers)[i]->evaluate(outcome.first[i], outcome.second);
+        }
+    }
+};
+
+/**
+ * A group of models tagging the input data together.
+ */
+class model_group
+{
+public:
+    /// The type of a function loading the model of option::model.
+    typedef int (*load_function)(option& opt);
+
+protected:
+    option& m_opt;
+    load_function m_load;
+    std::vector<instance_scorer*> m_scorers;
+
+public:
+    model_group(option& opt, load_function load)
+        : m_opt(opt), m_load(load)
+    {
+    }
+
+    /**
+     * Loads the models of option::models and tags the input data.
+     *  @return int         The exit code of the program.
+     */
+    int run()
+    {
+        m_opt.group = this;
+        m_opt.model = m_opt.models[0];
+        int ret = m_load(m_opt);
+        m_opt.group = NULL;
+        return ret;
+    }
+
+    /**
+     * Registers the scorer of the model loaded last.
+     *  This function loads the next model, or tags the input data if all
+     *  the models are loaded; it returns after the tagging finishes so that
+     *  the caller can release the model.
+     *  @param  scorer      The scorer of the model.
+     *  @return int         The exit code of the program.
+     */
+    int add(instance_scorer& scorer)
+    {
+        int ret = 0;
+        m_scorers.push_back(&scorer);
+        if (m_scorers.size() < m_opt.models.size()) {
+            m_opt.model = m_opt.models[m_scorers.size()];
+            ret = m_load(m_opt);
+        } else {
+            ret = tag();
+        }
+        m_scorers.pop_back();
+        return ret;
+    }
+
+protected:
+    int tag()
+    {
+        std::ostream& os = m_opt.os;
+        model_group_tagger tagger(m_opt, m_scorers);
+        model_group_evaluator eval = {&m_scorers};
+
+        tag_lines(m_opt, tagger, eval);
+
+        // Output the performance of every model if necessary.
+        if (m_opt.test) {
+            for (size_t i = 0;i < m_scorers.size();++i) {
+                os << "===== Model " << (i + 1) << ": " << m_opt.models[i] << " =====" << std::endl;
+                m_scorers[i]->output_performance(os);
+            }
+        }
+        return 0;
+    }
+};
+
+#endif/*__MODEL_GROUP_H__*/
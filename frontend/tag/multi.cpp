@@ -46,49 +46,184 @@
 
 #include "option.h"
 #include "tokenize.h"
-#include "defaultmap.h"
+#include "compiled_model.h"
+#include "hashed_model.h"
+#include "output.h"
+#include "pipeline.h"
+#include "model_group.h"
+#include "server.h"
 #include <util.h>
 
-typedef defaultmap<std::string, double> model_type;
 typedef std::vector<std::string> labels_type;
 typedef std::vector<int> positive_labels_type;
-typedef classias::classify::linear_multi_logistic<model_type> classifier_type;
+typedef std::vector<double> bounds_type;
 
-class feature_generator
+/*
+The tagger resolves every attribute in an instance to an integer identifier
+only once, and computes the scores of all labels from the identifiers with
+a feature generator on integers:
+- a text model of a high density is expanded to a dense matrix of
+  attributes by labels (dense_feature_generator);
+- a sparse text model associates (attribute, label) pairs to features with
+  a hash table on integers (sparse_feature_generator), and scores only the
+  labels in the posting list of every attribute;
+- a compiled model is accessed as a CSR matrix on the mapped image
+  (compiled_feature_generator), whose rows are the posting lists;
+- a model with hashed attributes (--hash-bits) is expanded to a dense
+  matrix of buckets by labels, and attributes are hashed to the buckets
+  without a dictionary.
+With --top and --prune, the scoring on the posting lists stops updating the
+labels outside the k best ones as soon as the maximum absolute weights of the
+remaining attributes show that these labels cannot reach the k best scores.
+*/
+
+/**
+ * Returns the identifier of an attribute, or -1 if the attribute is unknown.
+ *  The value of the attribute is multiplied by the sign of signed hashing.
+ */
+static inline int
+find_attribute(const classias::quark& attributes, const std::string& name, double& value)
 {
-public:
-    typedef std::string attribute_type;
-    typedef std::string label_type;
-    typedef std::string feature_type;
+    return attributes.to_value(name, -1);
+}
 
-public:
-    feature_generator()
-    {
-    }
+static inline int
+find_attribute(const model_file& mf, const std::string& name, double& value)
+{
+    return mf.find(name);
+}
 
-    virtual ~feature_generator()
-    {
-    }
+static inline int
+find_attribute(const classias::hashed_quark& attributes, const std::string& name, double& value)
+{
+    double sign;
+    int a = (int)attributes.to_value(name, sign);
+    value *= sign;
+    return a;
+}
 
-    inline bool forward(
-        const std::string& a,
-        const std::string& l,
-        std::string& f
-        ) const
-    {
-        f  = a;
-        f += '\t';
-        f += l;
-        return true;
+/**
+ * Computes the scores of the labels for the attributes of an instance.
+ *  A feature generator without posting lists ignores the pruning.
+ *  @param  k           The number of the best labels whose scores must be
+ *                      exact, or zero for all labels.
+ *  @param  bounds      The bounds of the weights of the attributes.
+ */
+template <class classifier_type, class feature_generator_type>
+static inline void
+score_labels(
+    classifier_type& inst,
+    const feature_generator_type& fgen,
+    const classias::sparse_attributes& v,
+    int L,
+    int k,
+    const bounds_type& bounds
+    )
+{
+    inst.inner_product_labels(fgen, v.begin(), v.end(), L);
+}
+
+template <class classifier_type, class feature_generator_type>
+static inline void
+score_postings(
+    classifier_type& inst,
+    const feature_generator_type& fgen,
+    const classias::sparse_attributes& v,
+    int L,
+    int k,
+    const bounds_type& bounds
+    )
+{
+    if (0 < k && !bounds.empty()) {
+        inst.inner_product_postings_top(fgen, v.begin(), v.end(), L, k, bounds);
+    } else {
+        inst.inner_product_postings(fgen, v.begin(), v.end(), L);
     }
-};
+}
+
+template <class classifier_type>
+static inline void
+score_labels(
+    classifier_type& inst,
+    const classias::sparse_feature_generator& fgen,
+    const classias::sparse_attributes& v,
+    int L,
+    int k,
+    const bounds_type& bounds
+    )
+{
+    score_postings(inst, fgen, v, L, k, bounds);
+}
+
+/**
+ * Computes the scores of the labels from the rows of a compiled model,
+ * which only hold the labels having weights for the attributes.
+ */
+template <class classifier_type>
+static inline void
+score_labels(
+    classifier_type& inst,
+    const compiled_feature_generator& fgen,
+    const classias::sparse_attributes& v,
+    int L,
+    int k,
+    const bounds_type& bounds
+    )
+{
+    score_postings(inst, fgen, v, L, k, bounds);
+}
 
+/**
+ * Computes the bounds of the weights of the attributes for pruning.
+ *  The bounds are left empty for a feature generator without posting lists.
+ */
+template <class model_type, class feature_generator_type, class attributes_type>
+static void
+weight_bounds(
+    bounds_type& bounds,
+    const model_type& model,
+    const feature_generator_type& fgen,
+    const attributes_type& attributes
+    )
+{
+}
+
+template <class model_type>
+static void
+weight_bounds(
+    bounds_type& bounds,
+    const model_type& model,
+    const classias::sparse_feature_generator& fgen,
+    const classias::quark& attributes
+    )
+{
+    classias::classify::linear_multi<model_type>(model).posting_bounds(
+        fgen, (int)attributes.size(), bounds);
+}
+
+template <class model_type>
+static void
+weight_bounds(
+    bounds_type& bounds,
+    const model_type& model,
+    const compiled_feature_generator& fgen,
+    const model_file& mf
+    )
+{
+    classias::classify::linear_multi<model_type>(model).posting_bounds(
+        fgen, mf.num_attributes(), bounds);
+}
+
+template <class classifier_type, class feature_generator_type, class attributes_type>
 static void
 parse_line(
     classifier_type& inst,
-    const feature_generator& fgen,
+    const feature_generator_type& fgen,
+    const attributes_type& attributes,
+    int bias,
     std::string& rl,
     const classias::quark& labels,
+    const bounds_type& bounds,
     const option& opt,
     const std::string& line,
     int lines = 0
@@ -96,48 +231,63 @@ parse_line(
 {
     double value;
     std::string name;
+    classias::sparse_attributes v;
 
-    // Split the line with tab characters.
-    tokenizer values(line, opt.token_separator);
-    tokenizer::iterator itv = values.begin();
+    // Split the line with tab characters (into views of the line).
+    view_tokenizer values(line, opt.token_separator);
+    view_tokenizer::iterator itv = values.begin();
     if (itv == values.end()) {
         throw invalid_data("no field found in the line", line, lines);
     }
 
     // Parse the instance label.
-    get_name_value(*itv, name, value, opt.value_separator);
+    get_name_value(itv->begin(), itv->end(), name, value, opt.value_separator);
     rl = name;
 
     // Initialize the classifier.
     inst.clear();
-    inst.resize(labels.size());
 
-    // Set attributes for the instance.
+    // Resolve the attributes of the instance (ignoring unknown ones).
     for (++itv;itv != values.end();++itv) {
         if (!itv->empty()) {
-            double value;
-            std::string name;
-            get_name_value(*itv, name, value, opt.value_separator);
+            get_name_value(itv->begin(), itv->end(), name, value, opt.value_separator);
 
-            for (int i = 0;i < (int)labels.size();++i) {
-                inst.set(i, fgen, name, labels.to_item(i), value);
+            int a = find_attribute(attributes, name, value);
+            if (0 <= a) {
+                v.append(a, value);
             }
         }
     }
 
     // Apply the bias feature if any.
-    for (int i = 0;i < (int)labels.size();++i) {
-        inst.set(i, fgen, "__BIAS__", labels.to_item(i), 1.0);
+    if (0 <= bias) {
+        v.append(bias, 1.0);
     }
 
+    // Compute the scores of the labels.
+    score_labels(inst, fgen, v, (int)labels.size(), (opt.prune ? opt.top : 0), bounds);
+
     // Finalize the instance.
     inst.finalize();
 }
 
+/**
+ * A weight with its attribute and label identifiers read from a text model.
+ */
+struct weight_entry
+{
+    int a;
+    int l;
+    double w;
+};
+
 static void
 read_model(
-    model_type& model,
+    std::vector<weight_entry>& weights,
+    classias::quark& attributes,
     classias::quark& labels,
+    classias::hashed_quark& hattributes,
+    bool& hashed,
     std::istream& is,
     option& opt
     )
@@ -156,6 +306,7 @@ read_model(
         }
 
         if (line.compare(0, 1, "@") == 0) {
+            read_hash_declarative(line, hattributes, hashed);
             continue;
         }
 
@@ -169,81 +320,105 @@ read_model(
             throw invalid_model("feature name is missing", line);
         }
 
-        model.insert(model_type::pair_type(line.substr(pos), w));
-    }
-}
+        // Split the feature name into the attribute and label.
+        int lpos = line.rfind('\t');
+        if (lpos < pos) {
+            throw invalid_model("label is missing", line);
+        }
+        int l = labels.to_value(line.substr(lpos+1), -1);
+        if (l < 0) {
+            throw invalid_model("undeclared label", line);
+        }
 
-static void output_model_label(
-    std::ostream& os,
-    classifier_type& inst,
-    const classias::quark& labels,
-    option& opt
-    )
-{
+        weight_entry e;
+        e.a = attributes(line.substr(pos, lpos-pos));
+        e.l = l;
+        e.w = w;
+        weights.push_back(e);
+    }
 }
 
-int multi_tag(option& opt, std::ifstream& ifs)
+/**
+ * A tagger of instances for multi-class classification.
+ */
+template <class model_type, class feature_generator_type, class attributes_type>
+class multi_tagger
 {
-    int lines = 0;
-    feature_generator fgen;
-    std::istream& is = opt.is;
-    std::ostream& os = opt.os;
-
-    // Load a model.
-    model_type model;
-    classias::quark labels;
-    read_model(model, labels, ifs, opt);
-
-    // Create an instance of a classifier on the model.
-    classifier_type inst(model);
+public:
+    typedef classias::classify::linear_multi_logistic<model_type> classifier_type;
+    /// The predicted label and the reference label of an instance.
+    typedef std::pair<int, std::string> outcome_type;
+
+protected:
+    const option& m_opt;
+    const feature_generator_type& m_fgen;
+    const attributes_type& m_attributes;
+    const classias::quark& m_labels;
+    const bounds_type& m_bounds;
+    classifier_type m_inst;
+    std::vector<int> m_top;
+    int m_bias;
 
-    // Generate a set of positive labels (necessary only for evaluation).
-    positive_labels_type positives;
-    if (opt.test) {
-        for (int i = 0;i < (int)labels.size();++i) {
-            if (opt.negative_labels.find(labels.to_item(i)) == opt.negative_labels.end()) {
-                positives.push_back(i);
-            }
-        }
+public:
+    multi_tagger(
+        const option& opt,
+        const model_type& model,
+        const feature_generator_type& fgen,
+        const attributes_type& attributes,
+        const classias::quark& labels,
+        const bounds_type& bounds
+        ) :
+        m_opt(opt), m_fgen(fgen), m_attributes(attributes), m_labels(labels),
+        m_bounds(bounds), m_inst(model)
+    {
+        // Resolve the bias attribute.
+        double value = 1.;
+        m_bias = find_attribute(attributes, "__BIAS__", value);
     }
 
-    // Objects for performance evaluation.
-    classias::accuracy acc;
-    classias::precall pr(labels.size());
-
-    // Create another quark for labels unseen in the training stage.
-    classias::quark rlabels = labels;
+    bool boundary(const std::string& line) const
+    {
+        return true;
+    }
 
-    for (;;) {
-        // Read a line.
-        std::string line;
-        std::getline(is, line);
-        if (is.eof()) {
-            break;
-        }
-        ++lines;
+    bool tag(
+        const std::string& line,
+        int lines,
+        std::ostream& os,
+        outcome_type& outcome
+        )
+    {
+        const option& opt = m_opt;
+        const classias::quark& labels = m_labels;
+        classifier_type& inst = m_inst;
 
         // An empty line or comment line.
         if (line.empty() || line.compare(0, 1, "#") == 0) {
             // Output the comment line if necessary.
             if (opt.output & option::OUTPUT_COMMENT) {
-                os << line << std::endl;
+                os << line << end_of_line(opt);
             }
-            continue;
+            return false;
         }
 
         // Parse the line and classify the instance.
-        std::string rlabel;
-        parse_line(inst, fgen, rlabel, labels, opt, line, lines);
+        std::string& rlabel = outcome.second;
+        parse_line(inst, m_fgen, m_attributes, m_bias, rlabel, labels, m_bounds, opt, line, lines);
 
         // Determine whether we output this instance or not.
         if (opt.condition == option::CONDITION_ALL ||
             (opt.condition == option::CONDITION_FALSE && labels.to_item(inst.argmax()) != rlabel)) {
-            if (opt.output & option::OUTPUT_ALL) {
-                // Output all candidates
-                os << "@boi" << std::endl;
+            if ((opt.output & option::OUTPUT_ALL) || 0 < opt.top) {
+                // Output all candidates or the k best ones.
+                os << "@boi" << end_of_line(opt);
+
+                if (0 < opt.top) {
+                    inst.top(opt.top, m_top);
+                }
+                const int n = (0 < opt.top) ? (int)m_top.size() : inst.size();
 
-                for (int i = 0;i < inst.size();++i) {
+                for (int j = 0;j < n;++j) {
+                    const int i = (0 < opt.top) ? m_top[j] : j;
                     // Output the reference label.
                     if (opt.output & option::OUTPUT_RLABEL) {
                         os << ((labels.to_item(i) == rlabel) ? '+' : '-');
@@ -254,15 +429,15 @@ int multi_tag(option& opt, std::ifstream& ifs)
 
                     // Output the score/probability if necessary.
                     if (opt.output & option::OUTPUT_PROBABILITY) {
-                        os << opt.value_separator << inst.prob(i);
+                        os << opt.value_separator << formatted_value(inst.prob(i), opt);
                     } else if (opt.output & option::OUTPUT_SCORE) {
-                        os << opt.value_separator << inst.score(i);
+                        os << opt.value_separator << formatted_value(inst.score(i), opt);
                     }
 
-                    os << std::endl;
+                    os << end_of_line(opt);
                 }
 
-                os << "@eoi" << std::endl;
+                os << "@eoi" << end_of_line(opt);
 
             } else  {
                 // Output the predicted candidate only.
@@ -277,38 +452,326 @@ int multi_tag(option& opt, std::ifstream& ifs)
 
                 // Output the score/probability if necessary.
                 if (opt.output & option::OUTPUT_PROBABILITY) {
-                    os << opt.value_separator << inst.prob(inst.argmax());
+                    os << opt.value_separator << formatted_value(inst.prob(inst.argmax()), opt);
                 } else if (opt.output & option::OUTPUT_SCORE) {
-                    os << opt.value_separator << inst.score(inst.argmax());
+                    os << opt.value_separator << formatted_value(inst.score(inst.argmax()), opt);
                 }
 
-                os << std::endl;
+                os << end_of_line(opt);
+            }
+
+        }
+
+        // Report the labels for the performance.
+        outcome.first = inst.argmax();
+        return opt.test;
+    }
+};
+
+/**
+ * An evaluator accumulating the performance of multi-class classification.
+ */
+struct multi_evaluator
+{
+    classias::accuracy acc;
+    classias::precall pr;
+    /// Another quark for labels unseen in the training stage.
+    classias::quark rlabels;
+
+    multi_evaluator(const classias::quark& labels)
+        : pr(labels.size()), rlabels(labels)
+    {
+    }
+
+    void operator()(const std::pair<int, std::string>& outcome)
+    {
+        int pl = outcome.first;
+        int rl = rlabels.to_value(outcome.second, rlabels.size());
+        if (rl != rlabels.size()) {
+            acc.set(pl == rl);
+            pr.set(pl, rl);
+        } else {
+            int rl = rlabels(outcome.second);
+            pr.resize(rlabels.size());
+            pr.set(pl, rl);
+        }
+    }
+};
+
+/**
+ * A scorer of a multi-class model in a group of models (multiple -m
+ * options).
+ */
+template <class model_type, class feature_generator_type, class attributes_type>
+class multi_scorer : public instance_scorer
+{
+public:
+    typedef classias::classify::linear_multi_logistic<model_type> classifier_type;
+
+protected:
+    const option& m_opt;
+    const feature_generator_type& m_fgen;
+    const attributes_type& m_attributes;
+    const classias::quark& m_labels;
+    const positive_labels_type& m_positives;
+    bounds_type m_bounds;
+    classifier_type m_inst;
+    classias::sparse_attributes m_v;
+    int m_bias;
+    multi_evaluator m_eval;
+
+public:
+    multi_scorer(
+        const option& opt,
+        const model_type& model,
+        const feature_generator_type& fgen,
+        const attributes_type& attributes,
+        const classias::quark& labels,
+        const positive_labels_type& positives
+        ) :
+        m_opt(opt), m_fgen(fgen), m_attributes(attributes), m_labels(labels),
+        m_positives(positives), m_inst(model), m_eval(labels)
+    {
+        // Resolve the bias attribute.
+        double value = 1.;
+        m_bias = find_attribute(attributes, "__BIAS__", value);
+    }
+
+    virtual instance_scorer* clone() const
+    {
+        return new multi_scorer(*this);
+    }
+
+    virtual int classify(const parsed_instance& x)
+    {
+        classifier_type& inst = m_inst;
+        inst.clear();
+
+        // Resolve the attributes of the instance (ignoring unknown ones).
+        m_v.clear();
+        for (size_t i = 0;i < x.size;++i) {
+            double value = x.fields[i].second;
+            int a = find_attribute(m_attributes, x.fields[i].first, value);
+            if (0 <= a) {
+                m_v.append(a, value);
             }
+        }
+        if (0 <= m_bias) {
+            m_v.append(m_bias, 1.0);
+        }
+
+        // Compute the scores of the labels.
+        score_labels(inst, m_fgen, m_v, (int)m_labels.size(), 0, m_bounds);
+        inst.finalize();
+        return inst.argmax();
+    }
 
+    virtual void output(std::ostream& os)
+    {
+        const option& opt = m_opt;
+        classifier_type& inst = m_inst;
+        os << m_labels.to_item(inst.argmax());
+        if (opt.output & option::OUTPUT_PROBABILITY) {
+            os << opt.value_separator << formatted_value(inst.prob(inst.argmax()), opt);
+        } else if (opt.output & option::OUTPUT_SCORE) {
+            os << opt.value_separator << formatted_value(inst.score(inst.argmax()), opt);
         }
+    }
+
+    virtual void evaluate(int pl, const std::string& rl)
+    {
+        m_eval(std::make_pair(pl, rl));
+    }
+
+    virtual void output_performance(std::ostream& os) const
+    {
+        m_eval.acc.output(os);
+        m_eval.pr.output_labelwise(os, m_labels, m_positives.begin(), m_positives.end());
+        m_eval.pr.output_micro(os, m_positives.begin(), m_positives.end());
+        m_eval.pr.output_macro(os, m_positives.begin(), m_positives.end());
+    }
+};
 
-        // Accumulate the performance.
-        if (opt.test) {
-            int pl = inst.argmax();
-            int rl = rlabels.to_value(rlabel, rlabels.size());
-            if (rl != rlabels.size()) {
-                acc.set(pl == rl);
-                pr.set(pl, rl);
-            } else {
-                int rl = rlabels(rlabel);
-                pr.resize(rlabels.size());
-                pr.set(pl, rl);
+template <class model_type, class feature_generator_type, class attributes_type>
+static int
+tag(
+    option& opt,
+    const model_type& model,
+    const feature_generator_type& fgen,
+    const attributes_type& attributes,
+    const classias::quark& labels
+    )
+{
+    std::ostream& os = opt.os;
+
+    // Generate a set of positive labels (necessary only for evaluation).
+    positive_labels_type positives;
+    if (opt.test) {
+        for (int i = 0;i < (int)labels.size();++i) {
+            if (opt.negative_labels.find(labels.to_item(i)) == opt.negative_labels.end()) {
+                positives.push_back(i);
             }
         }
     }
 
+    // Register the model to the group of models if necessary.
+    if (opt.group != NULL) {
+        multi_scorer<model_type, feature_generator_type, attributes_type> scorer(
+            opt, model, fgen, attributes, labels, positives);
+        return opt.group->add(scorer);
+    }
+
+    // Find the bounds of the weights for pruning the labels.
+    bounds_type bounds;
+    if (opt.prune && 0 < opt.top) {
+        weight_bounds(bounds, model, fgen, attributes);
+    }
+
+    multi_tagger<model_type, feature_generator_type, attributes_type> tagger(
+        opt, model, fgen, attributes, labels, bounds);
+
+    // Serve the requests of clients in the server mode.
+    if (opt.server != NULL) {
+        return serve_requests(opt, tagger);
+    }
+
+    multi_evaluator eval(labels);
+
+    tag_lines(opt, tagger, eval);
+
     // Output the performance if necessary.
     if (opt.test) {
-        acc.output(os);
-        pr.output_labelwise(os, labels, positives.begin(), positives.end());
-        pr.output_micro(os, positives.begin(), positives.end());
-        pr.output_macro(os, positives.begin(), positives.end());
+        eval.acc.output(os);
+        eval.pr.output_labelwise(os, labels, positives.begin(), positives.end());
+        eval.pr.output_micro(os, positives.begin(), positives.end());
+        eval.pr.output_macro(os, positives.begin(), positives.end());
     }
 
     return 0;
 }
+
+/**
+ * Tags the instances with a compact weight vector (model_type).
+ */
+template <class model_type, class feature_generator_type, class attributes_type>
+static int
+tag_compact(
+    option& opt,
+    classias::weight_vector& model,
+    size_t block_size,
+    const feature_generator_type& fgen,
+    const attributes_type& attributes,
+    const classias::quark& labels
+    )
+{
+    model_type cmodel(block_size);
+    cmodel.assign(model.begin(), model.end());
+    classias::weight_vector().swap(model);
+    return tag(opt, cmodel, fgen, attributes, labels);
+}
+
+/**
+ * Tags the instances after converting the weights into the weight type
+ * specified by the option.
+ *  @param  opt         The options.
+ *  @param  model       The weights, which are released after the conversion.
+ *  @param  block_size  The number of weights sharing a scale in a quantized
+ *                      weight vector.
+ */
+template <class feature_generator_type, class attributes_type>
+static int
+tag_weights(
+    option& opt,
+    classias::weight_vector& model,
+    size_t block_size,
+    const feature_generator_type& fgen,
+    const attributes_type& attributes,
+    const classias::quark& labels
+    )
+{
+    switch (opt.weight_type) {
+    case option::WEIGHT_FLOAT:
+        return tag_compact<classias::float_weight_vector>(
+            opt, model, block_size, fgen, attributes, labels);
+    case option::WEIGHT_INT16:
+        return tag_compact<classias::int16_weight_vector>(
+            opt, model, block_size, fgen, attributes, labels);
+    case option::WEIGHT_INT8:
+        return tag_compact<classias::int8_weight_vector>(
+            opt, model, block_size, fgen, attributes, labels);
+    default:
+        return tag(opt, model, fgen, attributes, labels);
+    }
+}
+
+int multi_tag(option& opt, std::ifstream& ifs)
+{
+    // Load a model.
+    std::vector<weight_entry> weights;
+    classias::quark attributes, labels;
+    classias::hashed_quark hattributes;
+    bool hashed = false;
+    read_model(weights, attributes, labels, hattributes, hashed, ifs, opt);
+
+    const size_t A = attributes.size();
+    const size_t L = labels.size();
+    classias::weight_vector model;
+
+    if (hashed) {
+        // Expand the weights to a dense matrix of buckets.
+        classias::dense_feature_generator fgen;
+        fgen.set_num_attributes(hattributes.size());
+        fgen.set_num_labels(L);
+        model.resize(fgen.num_features(), 0.);
+        for (size_t i = 0;i < weights.size();++i) {
+            int f;
+            int a = (int)hashed_attribute_id(hattributes, attributes.to_item(weights[i].a));
+            fgen.forward(a, weights[i].l, f);
+            model[f] += weights[i].w;
+        }
+        std::vector<weight_entry>().swap(weights);
+        return tag_weights(opt, model, L, fgen, hattributes, labels);
+    }
+
+    if (A * L <= 2 * weights.size()) {
+        // Expand the weights to a dense matrix.
+        classias::dense_feature_generator fgen;
+        fgen.set_num_attributes(A);
+        fgen.set_num_labels(L);
+        model.resize(fgen.num_features(), 0.);
+        for (size_t i = 0;i < weights.size();++i) {
+            int f;
+            fgen.forward(weights[i].a, weights[i].l, f);
+            model[f] += weights[i].w;
+        }
+        std::vector<weight_entry>().swap(weights);
+        return tag_weights(opt, model, L, fgen, attributes, labels);
+
+    } else {
+        // Associate the weights with (attribute, label) pairs.
+        classias::sparse_feature_generator fgen;
+        fgen.set_num_attributes(A);
+        fgen.set_num_labels(L);
+        for (size_t i = 0;i < weights.size();++i) {
+            int f = fgen.regist(weights[i].a, weights[i].l);
+            if ((int)model.size() <= f) {
+                model.resize(f+1, 0.);
+            }
+            model[f] += weights[i].w;
+        }
+        std::vector<weight_entry>().swap(weights);
+        return tag_weights(opt, model, 64, fgen, attributes, labels);
+    }
+}
+
+int multi_tag(option& opt, const model_file& mf)
+{
+    classias::quark labels;
+    for (int i = 0;i < mf.num_labels();++i) {
+        labels(mf.label(i));
+    }
+
+    compiled_weights model(mf);
+    compiled_feature_generator fgen(mf);
+    return tag(opt, model, fgen, mf, labels);
+}
@@ -36,11 +36,16 @@
 #include <vector>
 #include <set>
 #include <string>
+#include <classias/memory.h>
+
+class tag_server;
+class model_group;
 
 class option
 {
 public:
     typedef std::set<std::string> labelset_type;
+    typedef std::vector<std::string> models_type;
 
 public:
     enum {
@@ -74,15 +79,39 @@ public:
         OUTPUT_PROBABILITY =    0x0020,
     };
 
+    enum {
+        WEIGHT_DOUBLE = 0,      /// Double precision.
+        WEIGHT_FLOAT,           /// Single precision.
+        WEIGHT_INT16,           /// 16-bit integers with block scales.
+        WEIGHT_INT8,            /// 8-bit integers with block scales.
+    };
+
+    enum {
+        PRECISION_DEFAULT = -1,     /// Six significant digits.
+        PRECISION_SHORTEST = -2,    /// Shortest round-trip digits.
+    };
+
     std::istream&   is;
     std::ostream&   os;
     std::ostream&   es;
 
     int         mode;
     std::string model;
+    models_type models;
     bool        test;
     int         condition;
     int         output;
+    int         weight_type;
+    int         precision;
+    bool        line_buffered;
+    int         threads;
+    int         top;
+    bool        prune;
+    std::string serve;
+    double      latency_budget;
+    tag_server* server;
+    model_group* group;
+    classias::memory_policy memory;
 
     char        token_separator;
     char        value_separator;
@@ -97,6 +126,10 @@ public:
         is(_is), os(_os), es(_es),
         mode(MODE_NORMAL),
         test(false), condition(CONDITION_ALL), output(OUTPUT_MLABEL),
+        weight_type(WEIGHT_DOUBLE),
+        precision(PRECISION_DEFAULT), line_buffered(false), threads(1),
+        top(0), prune(false),
+        latency_budget(0.), server(NULL), group(NULL),
         token_separator(' '), value_separator(':')
     {
     }
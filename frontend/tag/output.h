@@ -0,0 +1,175 @@
+/*
+ *		Buffered output of tagging results.
+ *
+ *
+ * Copyright (c) 2008,2009 Naoaki Okazaki
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the names of the authors nor the names of its contributors
+ *       may be used to endorse or promote products derived from this
+ *       software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* $Id$ */
+
+#ifndef __OUTPUT_H__
+#define __OUTPUT_H__
+
+#include <cstdio>
+#include <cstdlib>
+#include <ostream>
+#include <streambuf>
+#include <vector>
+#include "option.h"
+
+/**
+ * The size of the output buffer of classias-tag.
+ */
+#define OUTPUT_BUFFER_SIZE  (1 << 20)
+
+/**
+ * A stream buffer writing blocks to another stream buffer.
+ *  The tagging results are accumulated in a large buffer and written to the
+ *  destination (e.g., STDOUT) when the buffer fills or the stream is flushed,
+ *  instead of a write per line.
+ */
+class block_output : public std::streambuf
+{
+protected:
+    std::streambuf* m_dst;
+    std::vector<char> m_buffer;
+
+public:
+    /**
+     * Constructs a stream buffer.
+     *  @param  dst         The destination stream buffer.
+     *  @param  size        The size of the buffer.
+     */
+    block_output(std::streambuf* dst, size_t size = OUTPUT_BUFFER_SIZE)
+        : m_dst(dst), m_buffer(size)
+    {
+        setp(&m_buffer[0], &m_buffer[0] + m_buffer.size());
+    }
+
+    virtual ~block_output()
+    {
+        sync();
+    }
+
+protected:
+    virtual int_type overflow(int_type c)
+    {
+        if (!write_buffer()) {
+            return traits_type::eof();
+        }
+        if (!traits_type::eq_int_type(c, traits_type::eof())) {
+            *pptr() = traits_type::to_char_type(c);
+            pbump(1);
+        }
+        return traits_type::not_eof(c);
+    }
+
+    virtual int sync()
+    {
+        if (!write_buffer()) {
+            return -1;
+        }
+        return m_dst->pubsync();
+    }
+
+    bool write_buffer()
+    {
+        const std::streamsize n = pptr() - pbase();
+        if (0 < n && m_dst->sputn(pbase(), n) != n) {
+            return false;
+        }
+        setp(&m_buffer[0], &m_buffer[0] + m_buffer.size());
+        return true;
+    }
+};
+
+/**
+ * A manipulator ending an output line.
+ *  The stream is flushed only in the line-buffered mode (--line-buffered)
+ *  whereas std::endl would flush every line.
+ */
+struct end_of_line
+{
+    bool flush;
+
+    explicit end_of_line(const option& opt) : flush(opt.line_buffered)
+    {
+    }
+};
+
+inline std::ostream& operator<<(std::ostream& os, const end_of_line& x)
+{
+    os.put('\n');
+    if (x.flush) {
+        os.flush();
+    }
+    return os;
+}
+
+/**
+ * A manipulator writing a score or probability in the format of --precision.
+ */
+struct formatted_value
+{
+    double value;
+    int precision;
+
+    formatted_value(double v, const option& opt)
+        : value(v), precision(opt.precision)
+    {
+    }
+};
+
+inline std::ostream& operator<<(std::ostream& os, const formatted_value& x)
+{
+    char buffer[64];
+    int n = 0;
+    if (x.precision == option::PRECISION_DEFAULT) {
+        // The format of std::ostream (six significant digits).
+        n = snprintf(buffer, sizeof(buffer), "%g", x.value);
+    } else if (x.precision == option::PRECISION_SHORTEST) {
+        // The shortest representation that reads back as the same value
+        // (any number of up to 15 significant digits is found by "%.15g").
+        for (int digits = 15;digits <= 17;++digits) {
+            n = snprintf(buffer, sizeof(buffer), "%.*g", digits, x.value);
+            if (std::strtod(buffer, NULL) == x.value) {
+                break;
+            }
+        }
+    } else {
+        // A fixed number of digits after the decimal point.
+        n = snprintf(buffer, sizeof(buffer), "%.*f", x.precision, x.value);
+    }
+    if (0 < n && n < (int)sizeof(buffer)) {
+        os.write(buffer, n);
+    } else {
+        os << x.value;
+    }
+    return os;
+}
+
+#endif/*__OUTPUT_H__*/
@@ -0,0 +1,334 @@
+/*
+ *		Pipeline of threads tagging instances.
+ *
+ *
+ * Copyright (c) 2008,2009 Naoaki Okazaki
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the names of the authors nor the names of its contributors
+ *       may be used to endorse or promote products derived from this
+ *       software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* $Id$ */
+
+#ifndef __PIPELINE_H__
+#define __PIPELINE_H__
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <classias/thread.h>
+#include <util.h>
+#include "option.h"
+
+/**
+ * The minimum number of lines in a batch of the tagging pipeline.
+ */
+#define TAG_BATCH_LINES     4096
+
+/*
+A tagger processes the lines of the input data one by one and implements:
+- typedef outcome_type: the result of an instance for the evaluation;
+- bool boundary(const std::string& line) const: returns true if no instance
+  continues after the line, i.e., the line can end a batch;
+- bool tag(const std::string& line, int lines, std::ostream& os,
+  outcome_type& outcome): writes the tagging result of the line to os, and
+  returns true if the line completes an instance to be evaluated, which is
+  described by outcome.
+The tagger is copied to every thread of the pipeline whereas the evaluator,
+a function object receiving the outcomes, is called by a single thread in
+the order of the instances.
+*/
+
+/**
+ * A batch of consecutive lines in the input data.
+ *  The lines are split into units, each of which ends with a boundary line
+ *  of the tagger. A tagging thread processes a range of consecutive units
+ *  and writes the results to an output of its own.
+ */
+template <class outcome_type>
+struct tag_batch
+{
+    /// The lines (the first \c size elements are valid).
+    std::vector<std::string> lines;
+    /// The number of lines in the batch.
+    size_t size;
+    /// The line number in the input data before the batch.
+    int first;
+    /// The line offsets just beyond the units.
+    std::vector<size_t> units;
+    /// The tagging results written by every thread.
+    std::vector<std::string> outputs;
+    /// The error messages of every thread.
+    std::vector<std::string> errors;
+    /// The outcomes of the units.
+    std::vector<outcome_type> outcomes;
+    /// The flags indicating the units that have outcomes.
+    std::vector<char> evaluated;
+
+    tag_batch() : size(0), first(0)
+    {
+    }
+
+    /**
+     * Gets the range of units processed by a tagging thread.
+     *  @param  index       The index of the thread.
+     *  @param  n           The number of the tagging threads.
+     *  @param  first       The index of the first unit.
+     *  @param  last        The index just beyond the last unit.
+     */
+    void range(int index, int n, size_t& first, size_t& last) const
+    {
+        first = units.size() * index / n;
+        last = units.size() * (index + 1) / n;
+    }
+};
+
+/**
+ * A stage of the tagging pipeline.
+ *  Each round of the pipeline runs the three stages concurrently: the reader
+ *  fills a batch with the next lines from the input stream, the taggers
+ *  process the units of the previous batch, and the writer outputs the
+ *  results of the batch before the previous one and evaluates its outcomes.
+ *  The output and the evaluation are thus the same as those of a single
+ *  thread.
+ */
+template <class tagger_type, class evaluator_type>
+struct tag_task
+{
+    typedef typename tagger_type::outcome_type outcome_type;
+    typedef tag_batch<outcome_type> batch_type;
+
+    enum {
+        READ = 0,
+        TAG,
+        WRITE
+    };
+
+    int role;
+    int index;
+    int num_taggers;
+    const option* opt;
+    tagger_type tagger;
+    evaluator_type* evaluate;
+    batch_type* batch;
+    int* lines;
+    bool* eof;
+    std::string* error;
+
+    tag_task(const tagger_type& _tagger) : tagger(_tagger)
+    {
+    }
+
+    void run()
+    {
+        switch (role) {
+        case READ:
+            read();
+            break;
+        case TAG:
+            tag();
+            break;
+        case WRITE:
+            write();
+            break;
+        }
+    }
+
+protected:
+    void read()
+    {
+        std::istream& is = opt->is;
+        batch->size = 0;
+        batch->first = *lines;
+        batch->units.clear();
+        for (;;) {
+            if (batch->size == batch->lines.size()) {
+                batch->lines.resize(batch->size + 1);
+            }
+            std::string& line = batch->lines[batch->size];
+            std::getline(is, line);
+            if (is.eof()) {
+                *eof = true;
+                break;
+            }
+            ++(*lines);
+            ++batch->size;
+
+            // Close the batch at a boundary when it has enough lines.
+            if (tagger.boundary(line)) {
+                batch->units.push_back(batch->size);
+                if (TAG_BATCH_LINES <= batch->size) {
+                    break;
+                }
+            }
+        }
+
+        // The lines of an instance unterminated by the end of the stream.
+        if (batch->size != (batch->units.empty() ? 0 : batch->units.back())) {
+            batch->units.push_back(batch->size);
+        }
+        batch->outcomes.resize(batch->units.size());
+        batch->evaluated.resize(batch->units.size());
+        batch->outputs.resize(num_taggers);
+        batch->errors.resize(num_taggers);
+    }
+
+    void tag()
+    {
+        size_t first, last;
+        std::ostringstream os;
+        batch->range(index, num_taggers, first, last);
+        batch->errors[index].clear();
+
+        try {
+            for (size_t u = first;u < last;++u) {
+                bool evaluated = false;
+                size_t i = (u == 0 ? 0 : batch->units[u-1]);
+                for (;i < batch->units[u];++i) {
+                    const int lines = batch->first + (int)i + 1;
+                    if (tagger.tag(batch->lines[i], lines, os, batch->outcomes[u])) {
+                        evaluated = true;
+                    }
+                }
+                batch->evaluated[u] = evaluated;
+            }
+        } catch (const std::exception& e) {
+            batch->errors[index] = e.what();
+        }
+        batch->outputs[index] = os.str();
+    }
+
+    void write()
+    {
+        std::ostream& os = opt->os;
+        for (int j = 0;j < num_taggers;++j) {
+            size_t first, last;
+            batch->range(j, num_taggers, first, last);
+            os << batch->outputs[j];
+            if (!batch->errors[j].empty()) {
+                *error = batch->errors[j];
+                return;
+            }
+            for (size_t u = first;u < last;++u) {
+                if (batch->evaluated[u]) {
+                    (*evaluate)(batch->outcomes[u]);
+                }
+            }
+        }
+    }
+};
+
+/**
+ * Tags the lines of the input data.
+ *  If the option threads is greater than one, the lines are read, tagged,
+ *  and written by a pipeline of threads (see tag_task). The line-buffered
+ *  mode tags the lines on a single thread so that every result is written
+ *  as soon as its line is read.
+ *  @param  opt         The options.
+ *  @param  tagger      The tagger.
+ *  @param  evaluate    The evaluator receiving the outcomes.
+ */
+template <class tagger_type, class evaluator_type>
+static void
+tag_lines(
+    const option& opt,
+    tagger_type& tagger,
+    evaluator_type& evaluate
+    )
+{
+    typedef typename tagger_type::outcome_type outcome_type;
+    int lines = 0;
+
+    if (opt.threads <= 1 || opt.line_buffered) {
+        std::istream& is = opt.is;
+        std::ostream& os = opt.os;
+        outcome_type outcome;
+        for (;;) {
+            // Read a line.
+            std::string line;
+            std::getline(is, line);
+            if (is.eof()) {
+                break;
+            }
+            ++lines;
+
+            // Tag the line and accumulate the performance.
+            if (tagger.tag(line, lines, os, outcome)) {
+                evaluate(outcome);
+            }
+        }
+        return;
+    }
+
+    typedef tag_task<tagger_type, evaluator_type> task_type;
+    const int num_taggers = opt.threads;
+    bool eof = false;
+    std::string error;
+    typename task_type::batch_type batches[3], none;
+    none.outputs.resize(num_taggers);
+    none.errors.resize(num_taggers);
+
+    std::vector<task_type> tasks(num_taggers + 2, task_type(tagger));
+    for (size_t j = 0;j < tasks.size();++j) {
+        tasks[j].role = task_type::TAG;
+        tasks[j].index = (int)j - 1;
+        tasks[j].num_taggers = num_taggers;
+        tasks[j].opt = &opt;
+        tasks[j].evaluate = &evaluate;
+        tasks[j].lines = &lines;
+        tasks[j].eof = &eof;
+        tasks[j].error = &error;
+    }
+    tasks.front().role = task_type::WRITE;
+    tasks.back().role = task_type::READ;
+
+    // The batch #k is read, tagged, and written at the rounds k, k+1, and
+    // k+2, respectively, until the batch #last that hits the end of stream
+    // goes through the pipeline. A stage without a batch works on an empty
+    // one.
+    for (int k = 0, last = -1;last < 0 || k <= last + 2;++k) {
+        typename task_type::batch_type* r = (last < 0 ? &batches[k % 3] : &none);
+        typename task_type::batch_type* t = ((1 <= k && (last < 0 || k - 1 <= last)) ? &batches[(k - 1) % 3] : &none);
+        typename task_type::batch_type* w = ((2 <= k && (last < 0 || k - 2 <= last)) ? &batches[(k - 2) % 3] : &none);
+
+        for (size_t j = 0;j < tasks.size();++j) {
+            switch (tasks[j].role) {
+            case task_type::READ:   tasks[j].batch = r;   break;
+            case task_type::TAG:    tasks[j].batch = t;   break;
+            case task_type::WRITE:  tasks[j].batch = w;   break;
+            }
+        }
+
+        classias::run_tasks(tasks);
+        if (!error.empty()) {
+            throw invalid_data(error);
+        }
+        if (last < 0 && eof) {
+            last = k;
+        }
+    }
+}
+
+#endif/*__PIPELINE_H__*/
@@ -0,0 +1,624 @@
+/*
+ *		Tagging server.
+ *
+ *
+ * Copyright (c) 2008,2009 Naoaki Okazaki
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the names of the authors nor the names of its contributors
+ *       may be used to endorse or promote products derived from this
+ *       software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* $Id$ */
+
+#ifdef  HAVE_CONFIG_H
+#include <config.h>
+#endif/*HAVE_CONFIG_H*/
+
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <list>
+#include <string>
+
+#include "option.h"
+#include "server.h"
+
+#ifdef  TAG_SERVER
+#include <netdb.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif/*TAG_SERVER*/
+
+/*
+A client sends lines in the format of the input data and receives the
+tagging results in the order of the lines; the results of an instance are
+sent once all of its lines have been received. A line that cannot be tagged
+yields "@error<TAB>message" in place of the results of its instance. The
+line "@stats" requests the statistics of the server, which are sent as
+"name<TAB>value" lines terminated by "@end".
+*/
+
+static volatile sig_atomic_t server_hangup = 0;
+static volatile sig_atomic_t server_terminate = 0;
+
+static void server_signal(int sig)
+{
+    if (sig == SIGINT || sig == SIGTERM) {
+        server_terminate = 1;
+    } else {
+        server_hangup = 1;
+    }
+}
+
+/**
+ * A thread loading a model and serving requests with it.
+ */
+struct tag_server::generation_task
+{
+    tag_server* server;
+    bool finished;
+    int ret;
+    classias::thread thread;
+
+    generation_task() : server(NULL), finished(false), ret(0)
+    {
+    }
+
+    void run()
+    {
+        int r = server->m_serve(server->m_opt);
+        classias::scoped_lock lock(server->m_mutex);
+        ret = r;
+        finished = true;
+        server->m_changed.broadcast();
+    }
+};
+
+/**
+ * A thread receiving the lines of a client.
+ */
+struct tag_server::connection_task
+{
+    tag_server* server;
+    int fd;
+    bool finished;
+    classias::thread thread;
+
+    connection_task() : server(NULL), fd(-1), finished(false)
+    {
+    }
+
+    void run()
+    {
+        server->serve_connection(fd);
+        classias::scoped_lock lock(server->m_mutex);
+        finished = true;
+    }
+};
+
+tag_server::tag_server(option& opt, serve_function serve) :
+    m_opt(opt), m_serve(serve),
+    m_queued_lines(0), m_generation(0), m_activations(0), m_stopping(false),
+    m_socket(-1), m_start(now()), m_loaded(0.),
+    m_requests(0), m_lines(0), m_errors(0)
+{
+    for (int i = 0;i < SERVER_LATENCY_BUCKETS;++i) {
+        m_histogram[i] = 0;
+    }
+}
+
+tag_server::~tag_server()
+{
+}
+
+double tag_server::now()
+{
+#ifdef  TAG_SERVER
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec * 1e-6;
+#else
+    return 0.;
+#endif/*TAG_SERVER*/
+}
+
+int tag_server::activate()
+{
+    classias::scoped_lock lock(m_mutex);
+    m_generation = ++m_activations;
+    m_loaded = now();
+    m_queued.broadcast();
+    m_changed.broadcast();
+    return m_generation;
+}
+
+bool tag_server::take(int generation, serve_batch& batch)
+{
+    const double budget = m_opt.latency_budget * 1e-3;
+    classias::scoped_lock lock(m_mutex);
+
+    batch.clear();
+    for (;;) {
+        if (m_stopping || m_generation != generation) {
+            return false;
+        }
+        if (m_queue.empty()) {
+            m_queued.wait(m_mutex);
+            continue;
+        }
+
+        // Wait for more requests within the latency budget.
+        const double rest = m_queue.front()->arrival + budget - now();
+        if (TAG_BATCH_LINES <= m_queued_lines || rest <= 0.) {
+            break;
+        }
+        m_queued.wait(m_mutex, rest);
+    }
+
+    size_t n = 0;
+    while (!m_queue.empty()) {
+        serve_request* req = m_queue.front();
+        if (!batch.empty() && TAG_BATCH_LINES < n + req->lines.size()) {
+            break;
+        }
+        n += req->lines.size();
+        batch.push_back(req);
+        m_queue.pop_front();
+    }
+    m_queued_lines -= n;
+    return true;
+}
+
+void tag_server::complete(serve_batch& batch, int errors)
+{
+    classias::scoped_lock lock(m_mutex);
+    const double t = now();
+
+    for (size_t i = 0;i < batch.size();++i) {
+        serve_request& req = *batch[i];
+
+        // Count the latency in the histogram of powers of two.
+        int b = 0;
+        const double usec = (t - req.arrival) * 1e6;
+        while (b + 1 < SERVER_LATENCY_BUCKETS && (double)(1 << b) < usec) {
+            ++b;
+        }
+        ++m_histogram[b];
+        ++m_requests;
+        m_lines += req.consumed;
+
+        req.done = true;
+        req.completed.signal();
+    }
+    m_errors += errors;
+}
+
+bool tag_server::submit(serve_request& req)
+{
+    classias::scoped_lock lock(m_mutex);
+    if (m_stopping) {
+        return false;
+    }
+
+    req.done = false;
+    req.consumed = 0;
+    req.arrival = now();
+    m_queue.push_back(&req);
+    m_queued_lines += req.lines.size();
+    m_queued.broadcast();
+
+    while (!req.done && !m_stopping) {
+        req.completed.wait(m_mutex);
+    }
+    return req.done;
+}
+
+std::string tag_server::statistics()
+{
+    classias::scoped_lock lock(m_mutex);
+    std::ostringstream ss;
+    const double t = now();
+    const double uptime = t - m_start;
+
+    ss << std::fixed << std::setprecision(3);
+    ss << "uptime\t" << uptime << '\n';
+    ss << "model\t" << m_generation << '\n';
+    ss << "model_age\t" << (t - m_loaded) << '\n';
+    ss << "requests\t" << m_requests << '\n';
+    ss << "lines\t" << m_lines << '\n';
+    ss << "errors\t" << m_errors << '\n';
+    ss << "queued\t" << m_queue.size() << '\n';
+    ss << "requests_per_second\t" << (0. < uptime ? m_requests / uptime : 0.) << '\n';
+    ss << "lines_per_second\t" << (0. < uptime ? m_lines / uptime : 0.) << '\n';
+    for (int i = 0;i < SERVER_LATENCY_BUCKETS;++i) {
+        if (m_histogram[i] != 0) {
+            ss << "latency_us\t" << (1LL << i) << '\t' << m_histogram[i] << '\n';
+        }
+    }
+    ss << "@end\n";
+    return ss.str();
+}
+
+#ifdef  TAG_SERVER
+
+/**
+ * Sends a string to a socket.
+ */
+static bool send_string(int fd, const std::string& str)
+{
+    const char *p = str.data();
+    size_t n = str.size();
+    while (0 < n) {
+        ssize_t m = send(fd, p, n, 0);
+        if (m <= 0) {
+            return false;
+        }
+        p += m;
+        n -= (size_t)m;
+    }
+    return true;
+}
+
+static std::string unix_socket_path(const std::string& addr)
+{
+    if (addr.compare(0, 5, "unix:") == 0) {
+        return addr.substr(5);
+    } else if (addr.find(':') == addr.npos) {
+        return addr;
+    }
+    return "";
+}
+
+bool tag_server::open_socket()
+{
+    std::ostream& es = m_opt.es;
+    const std::string& addr = m_opt.serve;
+    const std::string path = unix_socket_path(addr);
+
+    if (!path.empty()) {
+        // A Unix domain socket.
+        struct sockaddr_un sa;
+        std::memset(&sa, 0, sizeof(sa));
+        if (sizeof(sa.sun_path) <= path.size()) {
+            es << "ERROR: the path of the socket is too long: " << path << std::endl;
+            return false;
+        }
+        sa.sun_family = AF_UNIX;
+        std::strcpy(sa.sun_path, path.c_str());
+
+        m_socket = socket(AF_UNIX, SOCK_STREAM, 0);
+        unlink(path.c_str());
+        if (m_socket < 0 || bind(m_socket, (struct sockaddr*)&sa, sizeof(sa)) != 0) {
+            es << "ERROR: failed to bind the socket: " << path << ": " << std::strerror(errno) << std::endl;
+            return false;
+        }
+
+    } else {
+        // A TCP socket on host:port (any address if the host is empty).
+        size_t pos = addr.rfind(':');
+        std::string host = addr.substr(0, pos);
+        std::string port = addr.substr(pos + 1);
+        if (2 <= host.size() && host[0] == '[' && host[host.size()-1] == ']') {
+            host = host.substr(1, host.size() - 2);
+        }
+
+        struct addrinfo hints, *res = NULL;
+        std::memset(&hints, 0, sizeof(hints));
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        hints.ai_flags = AI_PASSIVE;
+        int ret = getaddrinfo(host.empty() ? NULL : host.c_str(), port.c_str(), &hints, &res);
+        if (ret != 0) {
+            es << "ERROR: failed to resolve the address: " << addr << ": " << gai_strerror(ret) << std::endl;
+            return false;
+        }
+
+        for (struct addrinfo* ai = res;ai != NULL;ai = ai->ai_next) {
+            int on = 1;
+            m_socket = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+            if (m_socket < 0) {
+                continue;
+            }
+            setsockopt(m_socket, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+            if (bind(m_socket, ai->ai_addr, ai->ai_addrlen) == 0) {
+                break;
+            }
+            close(m_socket);
+            m_socket = -1;
+        }
+        freeaddrinfo(res);
+        if (m_socket < 0) {
+            es << "ERROR: failed to bind the socket: " << addr << ": " << std::strerror(errno) << std::endl;
+            return false;
+        }
+    }
+
+    if (listen(m_socket, SOMAXCONN) != 0) {
+        es << "ERROR: failed to listen on the socket: " << addr << ": " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void tag_server::accept_connections()
+{
+    std::list<connection_task*> tasks;
+
+    for (;;) {
+        // Wait for a connection while checking the termination.
+        struct pollfd p;
+        p.fd = m_socket;
+        p.events = POLLIN;
+        p.revents = 0;
+        int r = poll(&p, 1, 200);
+
+        // Release the threads of the connections closed.
+        {
+            classias::scoped_lock lock(m_mutex);
+            std::list<connection_task*>::iterator it = tasks.begin();
+            while (it != tasks.end()) {
+                if ((*it)->finished) {
+                    (*it)->thread.join();
+                    delete *it;
+                    it = tasks.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+            if (m_stopping) {
+                // Close the connections, which end the threads.
+                std::set<int>::const_iterator itc;
+                for (itc = m_connections.begin();itc != m_connections.end();++itc) {
+                    shutdown(*itc, SHUT_RDWR);
+                }
+                break;
+            }
+        }
+
+        if (r <= 0) {
+            continue;
+        }
+
+        int fd = accept(m_socket, NULL, NULL);
+        if (fd < 0) {
+            continue;
+        }
+
+        classias::scoped_lock lock(m_mutex);
+        m_connections.insert(fd);
+        connection_task* task = new connection_task;
+        task->server = this;
+        task->fd = fd;
+        try {
+            task->thread.start(*task);
+            tasks.push_back(task);
+        } catch (const classias::thread_error&) {
+            m_connections.erase(fd);
+            close(fd);
+            delete task;
+        }
+    }
+
+    for (std::list<connection_task*>::iterator it = tasks.begin();it != tasks.end();++it) {
+        (*it)->thread.join();
+        delete *it;
+    }
+}
+
+void tag_server::serve_connection(int fd)
+{
+    serve_request req;
+    std::string buffer;
+    char chunk[65536];
+    bool eof = false;
+    bool alive = true;
+
+    while (alive && !eof) {
+        ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+        if (n <= 0) {
+            eof = true;
+        } else {
+            buffer.append(chunk, (size_t)n);
+        }
+
+        // Split the data received into lines.
+        size_t begin = 0, end;
+        while ((end = buffer.find('\n', begin)) != buffer.npos) {
+            size_t last = end;
+            if (begin < last && buffer[last-1] == '\r') {
+                --last;
+            }
+            req.lines.push_back(buffer.substr(begin, last - begin));
+            begin = end + 1;
+
+            if (req.lines.back() == "@stats") {
+                // Answer the statistics after the results of the lines
+                // before the request.
+                req.lines.pop_back();
+                if (!req.lines.empty() && !(alive = submit(req))) {
+                    break;
+                }
+                std::string output = req.output;
+                req.lines.erase(req.lines.begin(), req.lines.begin() + req.consumed);
+                req.first += (int)req.consumed;
+                req.output.clear();
+                req.consumed = 0;
+                if (!(alive = send_string(fd, output + statistics()))) {
+                    break;
+                }
+            }
+        }
+        buffer.erase(0, begin);
+
+        // The last line without a newline character.
+        if (eof && !buffer.empty()) {
+            req.lines.push_back(buffer);
+            buffer.clear();
+        }
+
+        if (alive && !req.lines.empty()) {
+            req.last = eof;
+            if (!(alive = submit(req))) {
+                break;
+            }
+            req.lines.erase(req.lines.begin(), req.lines.begin() + req.consumed);
+            req.first += (int)req.consumed;
+            req.consumed = 0;
+            alive = send_string(fd, req.output);
+            req.output.clear();
+        }
+    }
+
+    classias::scoped_lock lock(m_mutex);
+    m_connections.erase(fd);
+    close(fd);
+}
+
+struct acceptor_task
+{
+    tag_server* server;
+    void (tag_server::*accept)();
+
+    void run()
+    {
+        (server->*accept)();
+    }
+};
+
+int tag_server::run()
+{
+    std::ostream& es = m_opt.es;
+    if (!open_socket()) {
+        if (0 <= m_socket) {
+            close(m_socket);
+        }
+        return 1;
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+    signal(SIGHUP, server_signal);
+    signal(SIGINT, server_signal);
+    signal(SIGTERM, server_signal);
+
+    // Load the model on a thread, which serves requests with the model.
+    generation_task generations[2];
+    int current = 0;
+    generations[current].server = this;
+    generations[current].thread.start(generations[current]);
+    {
+        classias::scoped_lock lock(m_mutex);
+        while (m_activations == 0 && !generations[current].finished) {
+            m_changed.wait(m_mutex);
+        }
+    }
+    if (m_activations == 0) {
+        generations[current].thread.join();
+        close(m_socket);
+        return 1;
+    }
+
+    es << "Serving the model on " << m_opt.serve << " with " << m_opt.threads << " thread(s)" << std::endl;
+
+    // Accept connections on another thread.
+    acceptor_task acceptor;
+    classias::thread acceptor_thread;
+    acceptor.server = this;
+    acceptor.accept = &tag_server::accept_connections;
+    acceptor_thread.start(acceptor);
+
+    bool loading = false;
+    int activations = 0;
+    while (!server_terminate) {
+        const int next = 1 - current;
+        if (server_hangup && !loading) {
+            // Load the new model on another thread.
+            server_hangup = 0;
+            es << "Reloading the model: " << m_opt.model << std::endl;
+            activations = m_activations;
+            generations[next].server = this;
+            generations[next].finished = false;
+            generations[next].thread.start(generations[next]);
+            loading = true;
+        }
+
+        bool activated = false, failed = false;
+        {
+            classias::scoped_lock lock(m_mutex);
+            m_changed.wait(m_mutex, 0.2);
+            if (loading) {
+                activated = (m_activations != activations);
+                failed = (!activated && generations[next].finished);
+            }
+        }
+
+        if (activated) {
+            // The workers of the current model exit after their batches.
+            generations[current].thread.join();
+            current = next;
+            loading = false;
+            es << "Reloaded the model" << std::endl;
+        } else if (failed) {
+            generations[next].thread.join();
+            loading = false;
+            es << "ERROR: failed to reload the model; serving the current model" << std::endl;
+        }
+    }
+
+    // Stop the workers and connections.
+    {
+        classias::scoped_lock lock(m_mutex);
+        m_stopping = true;
+        m_queued.broadcast();
+        for (size_t i = 0;i < m_queue.size();++i) {
+            m_queue[i]->completed.broadcast();
+        }
+    }
+    acceptor_thread.join();
+    generations[0].thread.join();
+    generations[1].thread.join();
+    close(m_socket);
+
+    const std::string path = unix_socket_path(m_opt.serve);
+    if (!path.empty()) {
+        unlink(path.c_str());
+    }
+    es << "Stopped the server" << std::endl;
+    return 0;
+}
+
+#else
+
+int tag_server::run()
+{
+    m_opt.es << "ERROR: the server mode is not supported on this platform" << std::endl;
+    return 1;
+}
+
+#endif/*TAG_SERVER*/
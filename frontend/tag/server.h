@@ -0,0 +1,275 @@
+/*
+ *		Tagging server.
+ *
+ *
+ * Copyright (c) 2008,2009 Naoaki Okazaki
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the names of the authors nor the names of its contributors
+ *       may be used to endorse or promote products derived from this
+ *       software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* $Id$ */
+
+#ifndef __SERVER_H__
+#define __SERVER_H__
+
+#include <deque>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <classias/thread.h>
+#include "option.h"
+#include "pipeline.h"
+
+#if     defined(HAVE_SYS_SOCKET_H) && defined(HAVE_SYS_UN_H) && defined(HAVE_NETDB_H) && defined(HAVE_POLL_H)
+#define TAG_SERVER  1
+#endif
+
+/**
+ * The number of buckets of the latency histogram (powers of two in
+ * microseconds).
+ */
+#define SERVER_LATENCY_BUCKETS  32
+
+/**
+ * A request of a client: the lines received from a connection.
+ *  A worker tags the units of the lines that end with a boundary of the
+ *  tagger (all of the lines if the connection has been closed), and leaves
+ *  the remaining lines of an incomplete instance to the next request.
+ */
+struct serve_request
+{
+    /// The lines received.
+    std::vector<std::string> lines;
+    /// The line number in the connection before the request.
+    int first;
+    /// The flag indicating that the client sends no more lines.
+    bool last;
+    /// The time when the request was queued.
+    double arrival;
+    /// The number of lines processed by the worker.
+    size_t consumed;
+    /// The tagging results.
+    std::string output;
+    /// The flag indicating that the request has been processed.
+    bool done;
+    /// The condition signaled when the request has been processed.
+    classias::condition completed;
+
+    serve_request() : first(0), last(false), arrival(0.), consumed(0), done(false)
+    {
+    }
+};
+
+typedef std::vector<serve_request*> serve_batch;
+
+/**
+ * A server tagging the lines sent by clients.
+ *  Connection threads receive lines from clients and queue them as
+ *  requests; the worker threads of the active model take the requests in
+ *  micro-batches and tag them. A new model (SIGHUP) is loaded on a thread
+ *  of its own while the current model keeps serving, and replaces the
+ *  current model once it has been loaded; the workers of the replaced model
+ *  finish their batches and exit, so that no request is dropped.
+ */
+class tag_server
+{
+public:
+    /// The type of the function loading the model and serving requests.
+    typedef int (*serve_function)(option& opt);
+
+protected:
+    struct generation_task;
+    struct connection_task;
+    friend struct generation_task;
+    friend struct connection_task;
+
+    option& m_opt;
+    serve_function m_serve;
+
+    classias::mutex m_mutex;
+    classias::condition m_queued;
+    classias::condition m_changed;
+    std::deque<serve_request*> m_queue;
+    size_t m_queued_lines;
+    int m_generation;
+    int m_activations;
+    bool m_stopping;
+
+    int m_socket;
+    std::set<int> m_connections;
+
+    double m_start;
+    double m_loaded;
+    long long m_requests;
+    long long m_lines;
+    long long m_errors;
+    long long m_histogram[SERVER_LATENCY_BUCKETS];
+
+public:
+    /**
+     * Constructs a server.
+     *  @param  opt         The options.
+     *  @param  serve       The function loading the model and calling
+     *                      serve_requests() with a tagger.
+     */
+    tag_server(option& opt, serve_function serve);
+
+    virtual ~tag_server();
+
+    /**
+     * Runs the server until it receives SIGINT or SIGTERM.
+     *  @return int         The exit code of the program.
+     */
+    int run();
+
+    /**
+     * Makes the caller the workers of the active model.
+     *  @return int         The generation number of the model.
+     */
+    int activate();
+
+    /**
+     * Takes a micro-batch of requests.
+     *  This function waits for a request, and then for more requests until
+     *  the batch has TAG_BATCH_LINES lines or the oldest request has waited
+     *  for the latency budget.
+     *  @param  generation  The generation number of the caller.
+     *  @param  batch       The batch receiving the requests.
+     *  @return bool        \c false if the model of the caller has been
+     *                      replaced or the server is stopping.
+     */
+    bool take(int generation, serve_batch& batch);
+
+    /**
+     * Completes the requests in a batch.
+     *  @param  batch       The batch of requests processed.
+     *  @param  errors      The number of units that failed.
+     */
+    void complete(serve_batch& batch, int errors);
+
+    /**
+     * Gets the time in seconds from an arbitrary origin.
+     */
+    static double now();
+
+protected:
+    bool open_socket();
+    void accept_connections();
+    void serve_connection(int fd);
+    bool submit(serve_request& req);
+    std::string statistics();
+};
+
+/**
+ * A worker serving requests with a tagger.
+ */
+template <class tagger_type>
+struct serve_task
+{
+    tag_server* server;
+    int generation;
+    const tagger_type* prototype;
+
+    void run()
+    {
+        typename tagger_type::outcome_type outcome;
+        tagger_type* tagger = new tagger_type(*prototype);
+        serve_batch batch;
+        std::ostringstream os;
+
+        while (server->take(generation, batch)) {
+            int errors = 0;
+            for (size_t r = 0;r < batch.size();++r) {
+                serve_request& req = *batch[r];
+                size_t i = 0, end = req.lines.size();
+
+                // Leave the lines of an incomplete instance to the next
+                // request unless the client sends no more lines.
+                if (!req.last) {
+                    while (0 < end && !tagger->boundary(req.lines[end-1])) {
+                        --end;
+                    }
+                }
+
+                os.str(std::string());
+                while (i < end) {
+                    try {
+                        for (;;) {
+                            const std::string& line = req.lines[i++];
+                            tagger->tag(line, req.first + (int)i, os, outcome);
+                            if (i == end || tagger->boundary(line)) {
+                                break;
+                            }
+                        }
+                    } catch (const std::exception& e) {
+                        // Report the error for the unit and skip its lines.
+                        os << "@error\t" << e.what() << '\n';
+                        while (i < end && !tagger->boundary(req.lines[i-1])) {
+                            ++i;
+                        }
+                        delete tagger;
+                        tagger = new tagger_type(*prototype);
+                        ++errors;
+                    }
+                }
+
+                // Discard the state of an unterminated instance.
+                if (req.last) {
+                    delete tagger;
+                    tagger = new tagger_type(*prototype);
+                }
+                req.consumed = end;
+                req.output = os.str();
+            }
+            server->complete(batch, errors);
+        }
+        delete tagger;
+    }
+};
+
+/**
+ * Serves the requests of the server with a tagger until the model is
+ * replaced.
+ *  @param  opt         The options; opt.threads workers serve requests.
+ *  @param  tagger      The tagger on the model.
+ *  @return int         The exit code.
+ */
+template <class tagger_type>
+static int
+serve_requests(option& opt, const tagger_type& tagger)
+{
+    std::vector<serve_task<tagger_type> > tasks(opt.threads);
+    const int generation = opt.server->activate();
+    for (size_t i = 0;i < tasks.size();++i) {
+        tasks[i].server = opt.server;
+        tasks[i].generation = generation;
+        tasks[i].prototype = &tagger;
+    }
+    classias::run_tasks(tasks);
+    return 0;
+}
+
+#endif/*__SERVER_H__*/
@@ -0,0 +1,36 @@
+#!/bin/sh
+# $Id$
+#
+# Tests that a data set read from a cache trains the same model as the data
+# set read from the source file.
+
+. "${srcdir:-.}/common.sh"
+
+binary_data 500 > "$tmpdir/binary.txt"
+multi_data 500 > "$tmpdir/multi.txt"
+
+for type in b n; do
+    case $type in
+    b)  data="$tmpdir/binary.txt";;
+    n)  data="$tmpdir/multi.txt";;
+    esac
+    cache="$tmpdir/$type.cache"
+
+    train -t$type -m "$tmpdir/$type.plain" "$data"
+    train -t$type --cache="$cache" -m "$tmpdir/$type.stored" "$data"
+    grep -q "cache (stored)" "$tmpdir/train.log" || fail "-t$type: the cache is not stored"
+    train -t$type --cache="$cache" -m "$tmpdir/$type.cached" "$data"
+    grep -q -- "- cache: " "$tmpdir/train.log" || fail "-t$type: the cache is not used"
+    train -t$type --cache="$cache" -m "$tmpdir/$type.alone" < /dev/null
+
+    same "$tmpdir/$type.plain" "$tmpdir/$type.stored" "-t$type --cache (stored)"
+    same "$tmpdir/$type.plain" "$tmpdir/$type.cached" "-t$type --cache (read)"
+    same "$tmpdir/$type.plain" "$tmpdir/$type.alone" "-t$type --cache (without the source)"
+done
+
+# A cache read without the source file must have the same reader options.
+"$CLASSIAS_TRAIN" -tn --cache="$tmpdir/b.cache" < /dev/null > "$tmpdir/train.log" 2>&1 &&
+    fail "a cache of binary data is read for -tn"
+"$CLASSIAS_TRAIN" -tb -b 0 --cache="$tmpdir/b.cache" < /dev/null > "$tmpdir/train.log" 2>&1 &&
+    fail "a cache with the bias feature is read for -b 0"
+exit 0
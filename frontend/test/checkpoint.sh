@@ -0,0 +1,23 @@
+#!/bin/sh
+# $Id$
+#
+# Tests that an online algorithm resumed from a checkpoint (--resume) trains
+# the same model as the training without interruption.
+
+. "${srcdir:-.}/common.sh"
+
+binary_data 500 > "$tmpdir/binary.txt"
+
+for algorithm in averaged_perceptron pegasos.logistic svrg.logistic; do
+    checkpoint="$tmpdir/$algorithm"
+    train -tb -a $algorithm -p sample=shuffle -p max_iterations=10 \
+        -m "$tmpdir/full.model" "$tmpdir/binary.txt"
+    train -tb -a $algorithm -p sample=shuffle -p max_iterations=5 \
+        --checkpoint="$checkpoint" "$tmpdir/binary.txt"
+    train -tb -a $algorithm -p sample=shuffle -p max_iterations=10 \
+        --checkpoint="$checkpoint" --resume -m "$tmpdir/resumed.model" "$tmpdir/binary.txt"
+    grep -q "Resumed from the checkpoint of iteration #5" "$tmpdir/train.log" ||
+        fail "$algorithm: the training does not resume"
+    same "$tmpdir/full.model" "$tmpdir/resumed.model" "$algorithm --resume"
+done
+exit 0
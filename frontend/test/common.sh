@@ -0,0 +1,81 @@
+#!/bin/sh
+# $Id$
+#
+# Common definitions of the round-trip tests of classias-train and
+# classias-tag (sourced by the test scripts).
+
+CLASSIAS_TRAIN=${CLASSIAS_TRAIN:-../train/classias-train}
+CLASSIAS_TAG=${CLASSIAS_TAG:-../tag/classias-tag}
+
+# The temporary directory, removed when the test exits.
+tmpdir=`mktemp -d "${TMPDIR:-/tmp}/classias-test.XXXXXX"` || exit 1
+trap 'rm -rf "$tmpdir"' 0
+
+fail()
+{
+    echo "FAIL: $*" >&2
+    exit 1
+}
+
+# Trains a model; the arguments are passed to classias-train.
+train()
+{
+    "$CLASSIAS_TRAIN" "$@" > "$tmpdir/train.log" 2>&1 ||
+        fail "classias-train $*: `tail -n 1 "$tmpdir/train.log"`"
+}
+
+# Tags a data set from STDIN; the arguments are passed to classias-tag.
+tag()
+{
+    "$CLASSIAS_TAG" "$@" || fail "classias-tag $*"
+}
+
+# Tests whether two files are identical.
+same()
+{
+    cmp -s "$1" "$2" || fail "$3: $1 and $2 differ"
+}
+
+# Writes a binary data set of N instances to STDOUT. Attributes a0, ..., a7
+# are correlated with the labels, and the values are multiples of 1/4
+# (exactly represented by float).
+binary_data()
+{
+    awk -v n="$1" 'BEGIN {
+        srand(1);
+        for (i = 0;i < n;++i) {
+            y = (rand() < 0.5) ? 0 : 1;
+            line = y ? "+1" : "-1";
+            for (j = 0;j < 8;++j) {
+                if (rand() < 0.3) {
+                    a = y * 4 + int(rand() * 4);
+                } else {
+                    a = 8 + int(rand() * 56);
+                }
+                line = line " a" a ":" (1 + int(rand() * 8)) / 4;
+            }
+            print line;
+        }
+    }'
+}
+
+# Writes a multi-class data set of N instances with four labels to STDOUT.
+multi_data()
+{
+    awk -v n="$1" 'BEGIN {
+        srand(2);
+        for (i = 0;i < n;++i) {
+            y = int(rand() * 4);
+            line = "L" y;
+            for (j = 0;j < 8;++j) {
+                if (rand() < 0.3) {
+                    a = y * 4 + int(rand() * 4);
+                } else {
+                    a = 16 + int(rand() * 48);
+                }
+                line = line " a" a ":" (1 + int(rand() * 8)) / 4;
+            }
+            print line;
+        }
+    }'
+}
@@ -0,0 +1,16 @@
+#!/bin/sh
+# $Id$
+#
+# Tests that the compressed CSR storage (--compress) trains the same models
+# as the plain CSR storage (--csr) on values exactly represented by float.
+
+. "${srcdir:-.}/common.sh"
+
+binary_data 500 > "$tmpdir/binary.txt"
+
+for algorithm in lbfgs.logistic averaged_perceptron pegasos.logistic truncated_gradient.logistic dcd.hinge; do
+    train -tb -a $algorithm --csr -m "$tmpdir/csr.model" "$tmpdir/binary.txt"
+    train -tb -a $algorithm --compress -m "$tmpdir/compress.model" "$tmpdir/binary.txt"
+    same "$tmpdir/csr.model" "$tmpdir/compress.model" "$algorithm --compress"
+done
+exit 0
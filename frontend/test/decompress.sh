@@ -0,0 +1,35 @@
+#!/bin/sh
+# $Id$
+#
+# Tests that classias-train and classias-tag read compressed data (files and
+# STDIN) in the same way as the uncompressed data, decompressing them in the
+# process or by the external command.
+
+. "${srcdir:-.}/common.sh"
+
+binary_data 500 > "$tmpdir/binary.txt"
+train -tb -m "$tmpdir/b.model" "$tmpdir/binary.txt"
+tag -m "$tmpdir/b.model" -r < "$tmpdir/binary.txt" > "$tmpdir/b.out"
+
+tested=0
+for c in gzip bzip2 xz zstd; do
+    "$c" -c < /dev/null > /dev/null 2>&1 || continue
+    tested=1
+    "$c" -c < "$tmpdir/binary.txt" > "$tmpdir/binary.$c"
+
+    train -tb -m "$tmpdir/$c.model" "$tmpdir/binary.$c"
+    same "$tmpdir/b.model" "$tmpdir/$c.model" "classias-train ($c file)"
+    train -tb -m "$tmpdir/$c.model" < "$tmpdir/binary.$c"
+    same "$tmpdir/b.model" "$tmpdir/$c.model" "classias-train ($c STDIN)"
+
+    tag -m "$tmpdir/b.model" -r < "$tmpdir/binary.$c" > "$tmpdir/$c.out"
+    same "$tmpdir/b.out" "$tmpdir/$c.out" "classias-tag ($c)"
+
+    # A truncated stream is an error.
+    head -c 100 "$tmpdir/binary.$c" > "$tmpdir/truncated.$c"
+    if "$CLASSIAS_TAG" -m "$tmpdir/b.model" < "$tmpdir/truncated.$c" > /dev/null 2>&1; then
+        fail "classias-tag accepted a truncated $c stream"
+    fi
+done
+test $tested = 1 || exit 77
+exit 0
@@ -0,0 +1,53 @@
+#!/bin/sh
+# $Id$
+#
+# Tests the attribute filter (--filter): a model trained with the filter
+# must be identical to the model trained on the data from which the
+# attributes not matched by the regular expression are removed, with one or
+# four parsing threads, with the count pass of --min-count, and on STDIN.
+
+. "${srcdir:-.}/common.sh"
+
+# The option is built only with a library of regular expressions.
+"$CLASSIAS_TRAIN" --help | grep -e '--filter' > /dev/null || exit 77
+
+regex='a[0-7]$'
+
+# Removes the attributes not matched by the regular expression.
+prefilter()
+{
+    awk -v regex="$regex" '{
+        line = $1;
+        for (i = 2;i <= NF;++i) {
+            name = $i;
+            sub(/:[^:]*$/, "", name);
+            if (name ~ regex) {
+                line = line " " $i;
+            }
+        }
+        print line;
+    }'
+}
+
+binary_data 2000 > "$tmpdir/binary.txt"
+multi_data 2000 > "$tmpdir/multi.txt"
+
+for type in b n; do
+    case $type in
+    b)  data="$tmpdir/binary.txt";;
+    n)  data="$tmpdir/multi.txt";;
+    esac
+    prefilter < "$data" > "$tmpdir/$type.filtered"
+
+    for options in "" "--read-threads=4" "--min-count=2" "--read-threads=4 --min-count=2"; do
+        train -t$type $options -m "$tmpdir/$type.expected" "$tmpdir/$type.filtered"
+        train -t$type $options -F "$regex" -m "$tmpdir/$type.model" "$data"
+        same "$tmpdir/$type.expected" "$tmpdir/$type.model" "-t$type $options -F '$regex'"
+
+        # --min-count keeps an attribute from its N-th occurrence in STDIN.
+        train -t$type $options -m "$tmpdir/$type.expected" < "$tmpdir/$type.filtered"
+        train -t$type $options -F "$regex" -m "$tmpdir/$type.model" < "$data"
+        same "$tmpdir/$type.expected" "$tmpdir/$type.model" "-t$type $options -F '$regex' (STDIN)"
+    done
+done
+exit 0
@@ -0,0 +1,70 @@
+#!/bin/sh
+# $Id$
+#
+# Tests that the pipeline reading data (--read-threads=N) assigns the same
+# identifiers to attributes as a single thread: the caches and the models
+# read by one and four threads must be identical. The data sets span
+# several batches of the pipeline, with new attributes in every batch.
+
+. "${srcdir:-.}/common.sh"
+
+# Writes a data set of N lines whose attributes have a long tail to STDOUT:
+# binary (b), multi-class (n), or candidate (c) instances.
+tail_data()
+{
+    awk -v n="$2" -v type="$1" 'BEGIN {
+        srand(3);
+        for (i = 0;i < n;++i) {
+            y = int(rand() * 2);
+            if (type == "b") {
+                line = y ? "+1" : "-1";
+            } else if (type == "n") {
+                line = "L" int(rand() * 3);
+            } else {
+                if (i % 3 == 0) {
+                    print "@boi";
+                }
+                line = (i % 3 == 0) ? "+c" : "-c";
+            }
+            for (j = 0;j < 6;++j) {
+                if (rand() < 0.5) {
+                    a = "a" (y * 8 + int(rand() * 8));
+                } else {
+                    a = "w" int(rand() * (i + 1));
+                }
+                line = line " " a ":" (1 + int(rand() * 4)) / 4;
+            }
+            print line;
+            if (type == "c" && i % 3 == 2) {
+                print "@eoi";
+            }
+        }
+        if (type == "c" && n % 3 != 0) {
+            print "@eoi";
+        }
+    }'
+}
+
+for type in b n c; do
+    tail_data $type 20000 > "$tmpdir/$type.txt"
+    for t in 1 4; do
+        train -t$type --read-threads=$t --cache="$tmpdir/$type.$t.cache" \
+            -m "$tmpdir/$type.$t.model" "$tmpdir/$type.txt"
+    done
+    same "$tmpdir/$type.1.cache" "$tmpdir/$type.4.cache" "-t$type --read-threads=4 (cache)"
+    same "$tmpdir/$type.1.model" "$tmpdir/$type.4.model" "-t$type --read-threads=4 (model)"
+
+    # The attributes dropped by --min-count while reading STDIN.
+    for t in 1 4; do
+        train -t$type --read-threads=$t --min-count=2 \
+            -m "$tmpdir/$type.$t.model" < "$tmpdir/$type.txt"
+    done
+    same "$tmpdir/$type.1.model" "$tmpdir/$type.4.model" "-t$type --read-threads=4 --min-count=2"
+done
+
+# Feature hashing does not intern attributes.
+for t in 1 4; do
+    train -tb --read-threads=$t --hash-bits=10 -m "$tmpdir/h.$t.model" "$tmpdir/b.txt"
+done
+same "$tmpdir/h.1.model" "$tmpdir/h.4.model" "-tb --read-threads=4 --hash-bits=10"
+exit 0
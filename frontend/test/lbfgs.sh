@@ -0,0 +1,37 @@
+#!/bin/sh
+# $Id$
+#
+# Tests that L-BFGS computes the loss and gradients on multiple threads
+# (-p num_threads=N) without changing the models: the shards are reduced in
+# a fixed order, so the text models of one, two, and four threads must be
+# identical, and a thread count larger than the data set must work.
+
+. "${srcdir:-.}/common.sh"
+
+binary_data 1000 > "$tmpdir/binary.txt"
+multi_data 1000 > "$tmpdir/multi.txt"
+binary_data 3 > "$tmpdir/small.txt"
+
+for type in b m n; do
+    case $type in
+    b)  data="$tmpdir/binary.txt";;
+    *)  data="$tmpdir/multi.txt";;
+    esac
+
+    train -t$type -m "$tmpdir/$type.model" "$data"
+    for threads in 1 2 4; do
+        train -t$type -p num_threads=$threads -m "$tmpdir/$type.$threads" "$data"
+        same "$tmpdir/$type.model" "$tmpdir/$type.$threads" "-t$type -p num_threads=$threads"
+    done
+done
+
+# The orthant-wise method of the L1 regularization.
+train -tb -p c1=1 -p c2=0 -m "$tmpdir/l1.model" "$tmpdir/binary.txt"
+train -tb -p c1=1 -p c2=0 -p num_threads=4 -m "$tmpdir/l1.4" "$tmpdir/binary.txt"
+same "$tmpdir/l1.model" "$tmpdir/l1.4" "-tb -p c1=1 -p num_threads=4"
+
+# More threads than instances.
+train -tb -m "$tmpdir/small.model" "$tmpdir/small.txt"
+train -tb -p num_threads=8 -m "$tmpdir/small.8" "$tmpdir/small.txt"
+same "$tmpdir/small.model" "$tmpdir/small.8" "-tb -p num_threads=8 (3 instances)"
+exit 0
@@ -0,0 +1,29 @@
+#!/bin/sh
+# $Id$
+#
+# Tests that a compiled model tags a data set in the same way as the text
+# model trained with the same options.
+
+. "${srcdir:-.}/common.sh"
+
+binary_data 500 > "$tmpdir/binary.txt"
+multi_data 500 > "$tmpdir/multi.txt"
+
+for type in b n; do
+    case $type in
+    b)  data="$tmpdir/binary.txt";;
+    n)  data="$tmpdir/multi.txt";;
+    esac
+
+    train -t$type -m "$tmpdir/$type.model" "$data"
+    train -t$type --model-format=binary -m "$tmpdir/$type.bmodel" "$data"
+
+    tag -m "$tmpdir/$type.model" -r < "$data" > "$tmpdir/$type.text.out"
+    tag -m "$tmpdir/$type.bmodel" -r < "$data" > "$tmpdir/$type.binary.out"
+    same "$tmpdir/$type.text.out" "$tmpdir/$type.binary.out" "-t$type --model-format=binary"
+
+    tag -m "$tmpdir/$type.model" -t -q < "$data" > "$tmpdir/$type.text.out"
+    tag -m "$tmpdir/$type.bmodel" -t -q < "$data" > "$tmpdir/$type.binary.out"
+    same "$tmpdir/$type.text.out" "$tmpdir/$type.binary.out" "-t$type --model-format=binary (-t)"
+done
+exit 0
@@ -0,0 +1,100 @@
+#!/bin/sh
+# $Id$
+#
+# Tests the locale-free number parser of the attribute values: the values
+# tagged with a model of a single weight 1 must be identical to those
+# converted by awk (std::strtod()) around the limits of the exact conversion
+# (19 significant digits, 2^53, and decimal exponents of +-22), and a model
+# trained on values written in other forms must be identical.
+
+. "${srcdir:-.}/common.sh"
+
+cat > "$tmpdir/values.txt" <<'END'
+0
+-0
+0.25
+-0.5
++2
+5.
+.5
+0.1
+1e-1
+2.5E-3
+1E5
+1e
+1e+
+12e+
+3.0000000000000004
+0.30000000000000000001
+00000000000000000000000000012
+0.00000000000000000000000012
+1234567890123456789
+12345678901234567890
+9007199254740991
+9007199254740992
+9007199254740993
+9007199254740995
+9007199254740995e-1
+9007199254740993e5
+9007199254740993e-22
+1e22
+1e23
+1e-22
+1e-23
+7e-23
+123e20
+4.5e-22
+1.7976931348623157e308
+4.9e-324
+1e-400
+END
+
+printf '@classias\tlinear\tbinary\n1\tx\n' > "$tmpdir/one.model"
+sed 's/^/+1 x:/' "$tmpdir/values.txt" > "$tmpdir/values.in"
+tag -m "$tmpdir/one.model" -w --precision=shortest < "$tmpdir/values.in" \
+    > "$tmpdir/values.out"
+test `wc -l < "$tmpdir/values.out"` -eq `wc -l < "$tmpdir/values.txt"` ||
+    fail "classias-tag did not tag every value"
+awk '{
+    value = $0;
+    if ((getline line < "'"$tmpdir/values.out"'") <= 0) {
+        exit 1;
+    }
+    sub(/^[^:]*:/, "", line);
+    if ((line + 0) != (value + 0)) {
+        print "FAIL: " value " was parsed as " line > "/dev/stderr";
+        exit 1;
+    }
+}' "$tmpdir/values.txt" || exit 1
+
+# Writes every value of a data set in another form.
+rewrite()
+{
+    awk '{
+        line = $1;
+        for (i = 2;i <= NF;++i) {
+            n = split($i, f, ":");
+            v = f[2];
+            k = i % 5;
+            if (k == 0) {
+                v = (v * 100) "e-2";
+            } else if (k == 1) {
+                v = "+" v ((v ~ /\./) ? "000" : ".000");
+            } else if (k == 2) {
+                v = (v * 10) "E-1";
+            } else if (k == 3 && v < 1) {
+                sub(/^0/, "", v);
+            }
+            line = line " " f[1] ":" v;
+        }
+        print line;
+    }'
+}
+
+binary_data 500 > "$tmpdir/binary.txt"
+rewrite < "$tmpdir/binary.txt" > "$tmpdir/rewritten.txt"
+cmp -s "$tmpdir/binary.txt" "$tmpdir/rewritten.txt" && fail "the values were not rewritten"
+train -tb -m "$tmpdir/binary.model" "$tmpdir/binary.txt"
+train -tb -m "$tmpdir/rewritten.model" "$tmpdir/rewritten.txt"
+same "$tmpdir/binary.model" "$tmpdir/rewritten.model" "-tb (values in other forms)"
+exit 0
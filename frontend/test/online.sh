@@ -0,0 +1,37 @@
+#!/bin/sh
+# $Id$
+#
+# Tests the lock-free parallel updates of the online algorithms
+# (-p num_threads=N): one thread must train the same models as the default
+# sequential scheduler, and the models of four threads, which depend on the
+# interleaving of the updates, must still classify the training data well.
+
+. "${srcdir:-.}/common.sh"
+
+binary_data 2000 > "$tmpdir/binary.txt"
+multi_data 2000 > "$tmpdir/multi.txt"
+
+# Prints the number of the instances tagged correctly by a model.
+correct()
+{
+    tag -m "$1" -t -q < "$2" | sed -n 's/^Accuracy: [0-9.]* (\([0-9]*\)\/.*/\1/p'
+}
+
+for type in b n; do
+    case $type in
+    b)  data="$tmpdir/binary.txt";;
+    n)  data="$tmpdir/multi.txt";;
+    esac
+
+    for algorithm in averaged_perceptron pegasos.logistic truncated_gradient.logistic; do
+        train -t$type -a $algorithm -m "$tmpdir/seq.model" "$data"
+        train -t$type -a $algorithm -p num_threads=1 -m "$tmpdir/1.model" "$data"
+        same "$tmpdir/seq.model" "$tmpdir/1.model" "-t$type -a $algorithm -p num_threads=1"
+
+        train -t$type -a $algorithm -p num_threads=4 -m "$tmpdir/4.model" "$data"
+        n=`correct "$tmpdir/4.model" "$data"`
+        test -n "$n" && test 1900 -le "$n" ||
+            fail "-t$type -a $algorithm -p num_threads=4: $n/2000 instances tagged correctly"
+    done
+done
+exit 0
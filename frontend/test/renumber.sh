@@ -0,0 +1,24 @@
+#!/bin/sh
+# $Id$
+#
+# Tests that renumbering the attributes (--renumber) does not change the
+# model files, in the text and binary formats.
+
+. "${srcdir:-.}/common.sh"
+
+binary_data 500 > "$tmpdir/binary.txt"
+multi_data 500 > "$tmpdir/multi.txt"
+
+for type in b m n; do
+    case $type in
+    b)  data="$tmpdir/binary.txt";;
+    *)  data="$tmpdir/multi.txt";;
+    esac
+
+    for format in text binary; do
+        train -t$type --model-format=$format -m "$tmpdir/$type.model" "$data"
+        train -t$type --model-format=$format --renumber -m "$tmpdir/$type.renumber" "$data"
+        same "$tmpdir/$type.model" "$tmpdir/$type.renumber" "-t$type --model-format=$format --renumber"
+    done
+done
+exit 0
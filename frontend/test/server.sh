@@ -0,0 +1,60 @@
+#!/bin/sh
+# $Id$
+#
+# Tests that the tagging server (--serve) answers a line, then '@stats' in a
+# later packet, and keeps serving other clients after the disconnection.
+
+. "${srcdir:-.}/common.sh"
+
+perl -MIO::Socket::UNIX -e 1 2>/dev/null || exit 77
+
+binary_data 200 > "$tmpdir/binary.txt"
+train -tb -m "$tmpdir/b.model" "$tmpdir/binary.txt"
+
+sock="$tmpdir/sock"
+"$CLASSIAS_TAG" -m "$tmpdir/b.model" --serve="unix:$sock" 2> "$tmpdir/serve.log" &
+pid=$!
+trap 'kill $pid 2>/dev/null; rm -rf "$tmpdir"' 0
+
+i=0
+while test ! -S "$sock"; do
+    kill -0 $pid 2>/dev/null || fail "--serve: `tail -n 1 "$tmpdir/serve.log"`"
+    i=`expr $i + 1`
+    test $i -lt 100 || fail "--serve: the socket was not created"
+    sleep 0.1
+done
+
+# Sends the packets given as arguments to the server, one at a time after
+# the reply to the previous one, and writes the replies to STDOUT.
+client()
+{
+    perl -MIO::Socket::UNIX -e '
+        my $s = IO::Socket::UNIX->new(Peer => shift @ARGV) or exit 1;
+        for my $packet (@ARGV) {
+            print $s $packet;
+            $s->flush;
+            my $reply;
+            defined($s->recv($reply, 65536)) or exit 1;
+            print $reply;
+        }
+    ' "$sock" "$@"
+}
+
+client "+1 a1
+" "@stats
+" > "$tmpdir/stats.out" || fail "--serve: a line, then @stats"
+kill -0 $pid 2>/dev/null || fail "--serve: the server exited after @stats"
+test -s "$tmpdir/stats.out" || fail "--serve: no reply to @stats"
+
+client "+1 a1
+" > "$tmpdir/line.out" || fail "--serve: a line after @stats"
+label=`head -n 1 "$tmpdir/line.out"`
+case "$label" in
++1|-1)  ;;
+*)  fail "--serve: unexpected reply '$label'";;
+esac
+
+kill $pid
+wait $pid || fail "--serve: the server exited with $?"
+trap 'rm -rf "$tmpdir"' 0
+exit 0
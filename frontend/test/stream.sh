@@ -0,0 +1,53 @@
+#!/bin/sh
+# $Id$
+#
+# Tests the training on a stream of cache blocks (--stream): with the
+# instances visited in a cycle (-p sample=cycle), the models and the holdout
+# evaluations of cross validation must be identical to those trained on the
+# data set held in memory, with blocks smaller than the data set.
+
+. "${srcdir:-.}/common.sh"
+
+binary_data 3000 > "$tmpdir/binary.txt"
+multi_data 3000 > "$tmpdir/multi.txt"
+multi_data 1000 | awk '{
+    print "@boi";
+    print "+" $1 " " $2 " " $3 " " $4;
+    print "-X " $5 " " $6 " " $7;
+    print "@eoi";
+}' > "$tmpdir/candidate.txt"
+
+for type in b m n c; do
+    case $type in
+    b)  data="$tmpdir/binary.txt";;
+    c)  data="$tmpdir/candidate.txt";;
+    *)  data="$tmpdir/multi.txt";;
+    esac
+
+    for algorithm in averaged_perceptron pegasos.logistic truncated_gradient.logistic; do
+        rm -f "$tmpdir/cache"
+        train -t$type -a $algorithm -p sample=cycle --cache="$tmpdir/cache" \
+            -m "$tmpdir/memory.model" "$data"
+        train -t$type -a $algorithm -p sample=cycle --cache="$tmpdir/cache" \
+            --stream --stream-block=500 -m "$tmpdir/stream.model" "$data"
+        same "$tmpdir/memory.model" "$tmpdir/stream.model" "-t$type -a $algorithm --stream"
+    done
+done
+
+# The folds of cross validation, trained one after another on the stream.
+for algorithm in averaged_perceptron pegasos.logistic; do
+    rm -f "$tmpdir/cache"
+    train -tb -a $algorithm -g3 -x -p sample=cycle --cache="$tmpdir/cache" \
+        "$tmpdir/binary.txt"
+    grep '^Accuracy' "$tmpdir/train.log" > "$tmpdir/memory.log"
+    train -tb -a $algorithm -g3 -x -p sample=cycle --cache="$tmpdir/cache" \
+        --stream --stream-block=500 "$tmpdir/binary.txt"
+    grep '^Accuracy' "$tmpdir/train.log" > "$tmpdir/stream.log"
+    test -s "$tmpdir/memory.log" || fail "-tb -a $algorithm -x: no holdout evaluation"
+    same "$tmpdir/memory.log" "$tmpdir/stream.log" "-tb -a $algorithm -x --stream"
+done
+
+# The batch algorithms cannot read a stream.
+"$CLASSIAS_TRAIN" -tb --cache="$tmpdir/cache" --stream "$tmpdir/binary.txt" \
+    > /dev/null 2>&1 && fail "-a lbfgs.logistic --stream was accepted"
+exit 0
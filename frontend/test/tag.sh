@@ -0,0 +1,83 @@
+#!/bin/sh
+# $Id$
+#
+# Tests the tagging pipeline (--threads=N) and the K best labels (--top=K)
+# of classias-tag. Four threads must write the same output as one thread
+# for every output option, on data sets spanning several batches. The K best
+# labels must be the K highest scores of --all, in descending order, with
+# or without pruning (--prune).
+
+. "${srcdir:-.}/common.sh"
+
+binary_data 10000 > "$tmpdir/binary.txt"
+multi_data 10000 > "$tmpdir/multi.txt"
+multi_data 3000 | awk '{
+    print "@boi";
+    print "+" $1 " " $2 " " $3 " " $4;
+    print "-X " $5 " " $6 " " $7;
+    print "-Y " $8 " " $9;
+    print "@eoi";
+}' > "$tmpdir/candidate.txt"
+
+# Selects the K highest scores of every instance in the output of --all
+# (stable for the same scores, as the labels are listed in the index order).
+top()
+{
+    awk -v k="$1" '
+    $0 == "@boi" {
+        n = 0;
+        print;
+        next;
+    }
+    $0 == "@eoi" {
+        for (i = 1;i <= n;++i) {
+            for (j = i;1 < j && score[j-1] < score[j];--j) {
+                t = score[j]; score[j] = score[j-1]; score[j-1] = t;
+                t = line[j]; line[j] = line[j-1]; line[j-1] = t;
+            }
+        }
+        for (i = 1;i <= n && i <= k;++i) {
+            print line[i];
+        }
+        print;
+        next;
+    }
+    {
+        ++n;
+        line[n] = $0;
+        score[n] = substr($0, match($0, /:[^:]*$/) + 1) + 0;
+    }'
+}
+
+for type in b n m c; do
+    case $type in
+    b)  data="$tmpdir/binary.txt";;
+    c)  data="$tmpdir/candidate.txt";;
+    *)  data="$tmpdir/multi.txt";;
+    esac
+    model="$tmpdir/$type.model"
+    train -t$type -m "$model" "$data"
+
+    for options in "" "-r" "-w" "-p" "-a -w" "-f -r" "-t -q" "--top=2 -w" "--top=2 -p"; do
+        tag -m "$model" $options < "$data" > "$tmpdir/1.out"
+        tag -m "$model" $options --threads=4 < "$data" > "$tmpdir/4.out"
+        test -s "$tmpdir/1.out" || fail "-t$type $options: no output"
+        same "$tmpdir/1.out" "$tmpdir/4.out" "-t$type $options --threads=4"
+    done
+
+    test $type = b && continue
+    tag -m "$model" -a -w --precision=shortest < "$data" | top 2 > "$tmpdir/all.out"
+    tag -m "$model" --top=2 -w --precision=shortest < "$data" > "$tmpdir/top.out"
+    same "$tmpdir/all.out" "$tmpdir/top.out" "-t$type --top=2"
+done
+
+# Pruning of the sparse and compiled multi-class models.
+train -tn --model-format=binary -m "$tmpdir/n.bmodel" "$tmpdir/multi.txt"
+for model in "$tmpdir/n.model" "$tmpdir/n.bmodel"; do
+    for k in 1 3; do
+        tag -m "$model" --top=$k -w < "$tmpdir/multi.txt" > "$tmpdir/top.out"
+        tag -m "$model" --top=$k -w --prune < "$tmpdir/multi.txt" > "$tmpdir/prune.out"
+        same "$tmpdir/top.out" "$tmpdir/prune.out" "$model --top=$k --prune"
+    done
+done
+exit 0
@@ -0,0 +1,356 @@
+/*
+ *		Ring allreduce over TCP for distributed training.
+ *
+ *
+ * Copyright (c) 2008,2009 Naoaki Okazaki
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the names of the authors nor the names of its contributors
+ *       may be used to endorse or promote products derived from this
+ *       software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifdef  HAVE_CONFIG_H
+#include <config.h>
+#endif/*HAVE_CONFIG_H*/
+
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "allreduce.h"
+
+#ifdef  TRAIN_DISTRIBUTED
+#include <netdb.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <unistd.h>
+#ifdef  HAVE_NETINET_TCP_H
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#endif/*HAVE_NETINET_TCP_H*/
+#endif/*TRAIN_DISTRIBUTED*/
+
+/**
+ * The number of seconds for waiting for the neighbors of a rank.
+ */
+#define RING_CONNECT_TIMEOUT    600
+
+#ifdef  MSG_NOSIGNAL
+#define RING_SEND_FLAGS         (MSG_DONTWAIT | MSG_NOSIGNAL)
+#else
+#define RING_SEND_FLAGS         MSG_DONTWAIT
+#endif
+
+/**
+ * The header exchanged by the neighbors of a ring.
+ */
+struct ring_header
+{
+    char magic[8];
+    int rank;
+    int size;
+    unsigned long long num_features;
+};
+
+static std::vector<std::string> split_peers(const std::string& peers)
+{
+    std::vector<std::string> ret;
+    size_t begin = 0;
+    for (;;) {
+        size_t end = peers.find(',', begin);
+        ret.push_back(peers.substr(begin, end == peers.npos ? end : end - begin));
+        if (end == peers.npos) {
+            break;
+        }
+        begin = end + 1;
+    }
+    return ret;
+}
+
+tcp_ring::tcp_ring() : m_rank(0), m_size(1), m_next(-1), m_prev(-1)
+{
+}
+
+tcp_ring::~tcp_ring()
+{
+    close();
+}
+
+int tcp_ring::count_peers(const std::string& peers)
+{
+    return (int)split_peers(peers).size();
+}
+
+#ifdef  TRAIN_DISTRIBUTED
+
+static std::string socket_error(const std::string& msg, const std::string& addr)
+{
+    std::stringstream ss;
+    ss << msg << ": " << addr << ": " << std::strerror(errno);
+    return ss.str();
+}
+
+/**
+ * Resolves HOST:PORT (a passive address if the host is empty).
+ */
+static struct addrinfo* resolve(const std::string& addr, bool passive)
+{
+    size_t pos = addr.rfind(':');
+    if (pos == addr.npos) {
+        throw allreduce_error("no port in the address of a rank: " + addr);
+    }
+    std::string host = passive ? std::string("") : addr.substr(0, pos);
+    std::string port = addr.substr(pos + 1);
+    if (2 <= host.size() && host[0] == '[' && host[host.size()-1] == ']') {
+        host = host.substr(1, host.size() - 2);
+    }
+
+    struct addrinfo hints, *res = NULL;
+    std::memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = passive ? AI_PASSIVE : 0;
+    int ret = getaddrinfo(host.empty() ? NULL : host.c_str(), port.c_str(), &hints, &res);
+    if (ret != 0) {
+        throw allreduce_error(
+            "failed to resolve the address: " + addr + ": " + gai_strerror(ret));
+    }
+    return res;
+}
+
+static void set_nodelay(int fd)
+{
+#ifdef  HAVE_NETINET_TCP_H
+    // Send the last segment of a chunk without waiting for an ACK.
+    int on = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+#endif/*HAVE_NETINET_TCP_H*/
+}
+
+void tcp_ring::open(const std::string& peers, int rank, size_t num_features)
+{
+    std::vector<std::string> addrs = split_peers(peers);
+    m_rank = rank;
+    m_size = (int)addrs.size();
+    if (m_size <= 1) {
+        return;
+    }
+    const std::string& self = addrs[m_rank];
+    const std::string& next = addrs[(m_rank + 1) % m_size];
+
+    // Listen on the port of this rank.
+    int ls = -1;
+    struct addrinfo* res = resolve(self, true);
+    for (struct addrinfo* ai = res;ai != NULL;ai = ai->ai_next) {
+        int on = 1;
+        ls = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (ls < 0) {
+            continue;
+        }
+        setsockopt(ls, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+        if (bind(ls, ai->ai_addr, ai->ai_addrlen) == 0 && listen(ls, 1) == 0) {
+            break;
+        }
+        ::close(ls);
+        ls = -1;
+    }
+    freeaddrinfo(res);
+    if (ls < 0) {
+        throw allreduce_error(socket_error("failed to listen on the address", self));
+    }
+
+    // Connect to the next rank, which may not be listening yet.
+    std::time_t start = std::time(NULL);
+    res = resolve(next, false);
+    while (m_next < 0) {
+        for (struct addrinfo* ai = res;ai != NULL;ai = ai->ai_next) {
+            int fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+            if (fd < 0) {
+                continue;
+            }
+            if (connect(fd, ai->ai_addr, ai->ai_addrlen) == 0) {
+                m_next = fd;
+                break;
+            }
+            ::close(fd);
+        }
+        if (m_next < 0) {
+            if (RING_CONNECT_TIMEOUT < std::difftime(std::time(NULL), start)) {
+                freeaddrinfo(res);
+                ::close(ls);
+                throw allreduce_error(socket_error("failed to connect to the next rank", next));
+            }
+            poll(NULL, 0, 100);
+        }
+    }
+    freeaddrinfo(res);
+
+    // Accept the connection from the previous rank.
+    struct pollfd pfd;
+    pfd.fd = ls;
+    pfd.events = POLLIN;
+    if (poll(&pfd, 1, RING_CONNECT_TIMEOUT * 1000) <= 0 ||
+        (m_prev = accept(ls, NULL, NULL)) < 0) {
+        ::close(ls);
+        throw allreduce_error(socket_error("no connection from the previous rank", self));
+    }
+    ::close(ls);
+    set_nodelay(m_next);
+    set_nodelay(m_prev);
+
+    // Verify that the previous rank agrees on the ring and the features.
+    ring_header out, in;
+    std::memset(&out, 0, sizeof(out));
+    std::memcpy(out.magic, "CLSRING", 8);
+    out.rank = m_rank;
+    out.size = m_size;
+    out.num_features = (unsigned long long)num_features;
+    exchange(&out, sizeof(out), &in, sizeof(in));
+    if (std::memcmp(in.magic, out.magic, 8) != 0 ||
+        in.rank != (m_rank + m_size - 1) % m_size || in.size != m_size) {
+        throw allreduce_error("the previous rank disagrees on the list of ranks");
+    }
+    if (in.num_features != out.num_features) {
+        std::stringstream ss;
+        ss << "the number of features differs from that of the previous rank: " <<
+            num_features << " != " << in.num_features;
+        throw allreduce_error(ss.str());
+    }
+}
+
+void tcp_ring::close()
+{
+    if (0 <= m_next) {
+        ::close(m_next);
+        m_next = -1;
+    }
+    if (0 <= m_prev) {
+        ::close(m_prev);
+        m_prev = -1;
+    }
+}
+
+void tcp_ring::exchange(const void *out, size_t nout, void *in, size_t nin)
+{
+    const char *p = reinterpret_cast<const char*>(out);
+    char *q = reinterpret_cast<char*>(in);
+
+    // Send to the next rank while receiving from the previous rank so that
+    // neither of them blocks on a full buffer.
+    while (0 < nout || 0 < nin) {
+        struct pollfd pfd[2];
+        pfd[0].fd = m_next;
+        pfd[0].events = (0 < nout) ? POLLOUT : 0;
+        pfd[1].fd = m_prev;
+        pfd[1].events = (0 < nin) ? POLLIN : 0;
+        pfd[0].revents = pfd[1].revents = 0;
+        if (poll(pfd, 2, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw allreduce_error(std::string("poll failed: ") + std::strerror(errno));
+        }
+
+        if (pfd[0].revents & (POLLOUT | POLLERR | POLLHUP)) {
+            ssize_t m = send(m_next, p, nout, RING_SEND_FLAGS);
+            if (m < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                throw allreduce_error(std::string("failed to send to the next rank: ") + std::strerror(errno));
+            } else if (0 < m) {
+                p += m;
+                nout -= (size_t)m;
+            }
+        }
+        if (pfd[1].revents & (POLLIN | POLLERR | POLLHUP)) {
+            ssize_t m = recv(m_prev, q, nin, MSG_DONTWAIT);
+            if (m == 0) {
+                throw allreduce_error("the previous rank closed the connection");
+            } else if (m < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                throw allreduce_error(std::string("failed to receive from the previous rank: ") + std::strerror(errno));
+            } else if (0 < m) {
+                q += m;
+                nin -= (size_t)m;
+            }
+        }
+    }
+}
+
+void tcp_ring::sum(double *v, size_t n)
+{
+    const int P = m_size;
+    if (P <= 1) {
+        return;
+    }
+
+    // The boundaries of the P chunks of the vector.
+    std::vector<size_t> b(P + 1);
+    for (int k = 0;k <= P;++k) {
+        b[k] = n * k / P;
+    }
+    m_buffer.resize(b[1] - b[0] + 1);
+
+    // Reduce-scatter: the rank r ends with the sum of the chunk (r+1) % P.
+    for (int s = 0;s < P - 1;++s) {
+        int cs = (m_rank - s + P) % P, cr = (m_rank - s - 1 + P) % P;
+        size_t nr = b[cr+1] - b[cr];
+        exchange(v + b[cs], (b[cs+1] - b[cs]) * sizeof(double), &m_buffer[0], nr * sizeof(double));
+        for (size_t i = 0;i < nr;++i) {
+            v[b[cr] + i] += m_buffer[i];
+        }
+    }
+
+    // Allgather: copy the sums of the chunks to all ranks.
+    for (int s = 0;s < P - 1;++s) {
+        int cs = (m_rank + 1 - s + P) % P, cr = (m_rank - s + P) % P;
+        exchange(v + b[cs], (b[cs+1] - b[cs]) * sizeof(double), v + b[cr], (b[cr+1] - b[cr]) * sizeof(double));
+    }
+}
+
+#else
+
+void tcp_ring::open(const std::string& peers, int rank, size_t num_features)
+{
+    m_rank = rank;
+    m_size = (int)split_peers(peers).size();
+    if (1 < m_size) {
+        throw allreduce_error("distributed training is not supported on this platform");
+    }
+}
+
+void tcp_ring::close()
+{
+}
+
+void tcp_ring::exchange(const void *out, size_t nout, void *in, size_t nin)
+{
+}
+
+void tcp_ring::sum(double *v, size_t n)
+{
+}
+
+#endif/*TRAIN_DISTRIBUTED*/
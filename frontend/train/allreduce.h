@@ -0,0 +1,124 @@
+/*
+ *		Ring allreduce over TCP for distributed training.
+ *
+ *
+ * Copyright (c) 2008,2009 Naoaki Okazaki
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the names of the authors nor the names of its contributors
+ *       may be used to endorse or promote products derived from this
+ *       software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* $Id$ */
+
+#ifndef __ALLREDUCE_H__
+#define __ALLREDUCE_H__
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <classias/allreduce.h>
+
+#if     defined(HAVE_SYS_SOCKET_H) && defined(HAVE_NETDB_H) && defined(HAVE_POLL_H)
+#define TRAIN_DISTRIBUTED   1
+#endif
+
+/**
+ * Exception class for failures of the network of distributed training.
+ */
+class allreduce_error : public std::runtime_error
+{
+public:
+    /**
+     * Constructs the object.
+     *  @param  msg             The error message.
+     */
+    explicit allreduce_error(const std::string& msg)
+        : std::runtime_error(msg)
+    {
+    }
+};
+
+/**
+ * A ring of processes summing vectors over TCP connections.
+ *  The rank #r listens on the r-th address of the list of peers, connects
+ *  to the next rank (r+1) and accepts the connection from the previous
+ *  rank (r-1). A vector is summed by the ring allreduce: a reduce-scatter
+ *  of P chunks followed by an allgather, each of which takes P-1 steps
+ *  of sending a chunk to the next rank while receiving another from the
+ *  previous rank. Every chunk is summed in the fixed order of the ring and
+ *  then copied to all ranks, so that the ranks receive the identical sums.
+ *  The ranks must share the byte order and the floating-point format.
+ */
+class tcp_ring : public classias::allreduce
+{
+protected:
+    int m_rank;
+    int m_size;
+    int m_next;
+    int m_prev;
+    std::vector<double> m_buffer;
+
+public:
+    tcp_ring();
+    virtual ~tcp_ring();
+
+    /**
+     * Counts the number of ranks in a list of peers.
+     *  @param  peers       The comma-separated list of HOST:PORT.
+     *  @return int         The number of ranks.
+     */
+    static int count_peers(const std::string& peers);
+
+    /**
+     * Connects the ranks into a ring.
+     *  This function waits until the neighbors of the rank are up, and
+     *  verifies that all ranks agree on the number of ranks and features.
+     *  @param  peers       The comma-separated list of HOST:PORT.
+     *  @param  rank        The rank of this process.
+     *  @param  num_features    The number of features.
+     */
+    void open(const std::string& peers, int rank, size_t num_features);
+
+    /**
+     * Closes the connections.
+     */
+    void close();
+
+    virtual void sum(double *v, size_t n);
+
+    virtual int rank() const
+    {
+        return m_rank;
+    }
+
+    virtual int size() const
+    {
+        return m_size;
+    }
+
+protected:
+    void exchange(const void *out, size_t nout, void *in, size_t nin);
+};
+
+#endif/*__ALLREDUCE_H__*/
@@ -40,10 +40,12 @@
 #include <classias/classias.h>
 #include <classias/classify/linear/binary.h>
 #include <classias/train/lbfgs.h>
+#include <classias/train/dcd.h>
 #include <classias/train/averaged_perceptron.h>
 #include <classias/train/pegasos.h>
 #include <classias/train/truncated_gradient.h>
 #include <classias/train/online_scheduler.h>
+#include <classias/train/svrg.h>
 
 #include "option.h"
 #include "tokenize.h"
@@ -61,35 +63,28 @@
 */
 
 template <
-    class instance_type,
-    class features_quark_type
+    class data_type
 >
 static void
-read_line(
-    const std::string& line,
-    instance_type& instance,
-    features_quark_type& features,
+store_line(
+    data_type& data,
+    const parsed_line& p,
     const option& opt,
-    int lines = 0
+    int group
     )
 {
     double value;
     std::string name;
+    typedef typename data_type::instance_type instance_type;
+    typedef typename data_type::attributes_quark_type features_quark_type;
+    features_quark_type& features = data.attributes;
 
-    // Split the line with tab characters.
-    tokenizer values(line, opt.token_separator);
-    tokenizer::iterator itv = values.begin();
-    if (itv == values.end()) {
-        throw invalid_data("no field found in the line", line, lines);
-    }
-
-    // Make sure that the first token (class) is not empty.
-    if (itv->empty()) {
-        throw invalid_data("an empty label found", line, lines);
-    }
+    // Create a new instance.
+    instance_type& instance = data.new_element();
+    instance.set_group(group);
 
     // Parse the instance label.
-    get_name_value(*itv, name, value, opt.value_separator);
+    get_name_value(p.label, name, value, opt.value_separator);
 
     // Set the class label of this instance.
     if (name == "+1" || name == "1") {
@@ -97,20 +92,17 @@ read_line(
     } else if (name == "-1") {
         instance.set_label(false);
     } else {
-        throw invalid_data("a class label must be either '+1', '1', or '-1'", line, lines);
+        throw invalid_data("a class label must be either '+1', '1', or '-1'", p.line, p.lines);
     }
 
     // Set the instance weight.
     instance.set_weight(value);
 
     // Set featuress for the instance.
-    for (++itv;itv != values.end();++itv) {
-        if (!itv->empty()) {
-            get_name_value(*itv, name, value, opt.value_separator);
-            if (opt.filter_string.empty() || REGEX_SEARCH(name, opt.filter)) {
-                instance.append(features(name), value);
-            }
-        }
+    for (size_t i = 0;i < p.fields.size();++i) {
+        double v = p.fields[i].second;
+        int a = get_attribute(features, p, i, v);
+        instance.append(a, v);
     }
 
     // Include a bias feature if necessary.
@@ -127,47 +119,22 @@ read_stream(
     std::istream& is,
     data_type& data,
     const option& opt,
-    int group = 0
+    int group = 0,
+    chunk_sink* sink = NULL,
+    attribute_counts* counts = NULL
     )
 {
-    int lines = 0;
-    typedef typename data_type::instance_type instance_type;
-
     // If necessary, generate a bias attribute here to reserve feature #0.
     if (opt.bias != 0.) {
-        int fid = (int)data.attributes("__BIAS__");
+        int fid = reserve_attribute(data.attributes, "__BIAS__");
         if (fid != 0) {
             throw invalid_data("A bias attribute could not obtain #0");
         }
         data.set_user_feature_start(fid+1);
     }
 
-    for (;;) {
-        // Read a line.
-        std::string line;
-        std::getline(is, line);
-        if (is.eof()) {
-            break;
-        }
-        ++lines;
-
-        // Skip an empty line.
-        if (line.empty()) {
-            continue;
-        }
-
-        // Skip a comment line.
-        if (line.compare(0, 1, "#") == 0) {
-            continue;
-        }
-
-        // Create a new instance.
-        instance_type& inst = data.new_element();
-        inst.set_group(group);
-
-        // Read the instance.
-        read_line(line, inst, data.attributes, opt, lines);
-    }
+    // Read the instances.
+    read_lines(is, data, opt, group, sink, counts);
 }
 
 template <
@@ -182,6 +149,26 @@ finalize_data(
     // Nothing to do.
 }
 
+/**
+ * Finalizes the data set read from a stream of cache blocks.
+ *  @param  source      The stream on the cache file.
+ *  @param  data        The data set holding the string tables.
+ *  @param  opt         The options.
+ */
+template <
+    class source_type,
+    class data_type
+>
+static void
+finalize_stream(
+    source_type& source,
+    data_type& data,
+    const option& opt
+    )
+{
+    finalize_data(data, opt);
+}
+
 template <
     class data_type,
     class model_type
@@ -190,7 +177,8 @@ static void
 output_model(
     data_type& data,
     const model_type& model,
-    const option& opt
+    const option& opt,
+    const std::vector<int>& perm
     )
 {
     typedef typename data_type::attributes_quark_type attributes_quark_type;
@@ -198,38 +186,105 @@ output_model(
     const attributes_quark_type& attributes = data.attributes;
     typedef typename model_type::value_type value_type;
 
+    const bool compiled = (opt.model_format == option::MODEL_FORMAT_BINARY);
+    model_file_writer mfw(MODEL_FILE_BINARY, opt.weight_type);
+
     // Open a model file for writing.
-    std::ofstream os(opt.model.c_str());
+    std::ofstream os;
+    if (!compiled) {
+        os.open(opt.model.c_str());
 
-    // Output a model type.
-    os << "@classias\tlinear\tbinary" << std::endl;
+        // Output a model type.
+        os << "@classias\tlinear\tbinary" << std::endl;
+        output_attributes_header(os, attributes);
+    }
 
-    // Store the feature weights.
-    for (aid_type i = 0;i < attributes.size();++i) {
+    // Store the feature weights in the original order of the attributes.
+    for (aid_type k = 0;k < attributes.size();++k) {
+        const int i = renumbered_attribute(perm, (int)k);
         value_type w = model[i];
         if (w != 0.) {
-            const std::string& attr = attributes.to_item(i);
+            const std::string attr = attribute_name(attributes, i);
             if (attr == "__BIAS__") {
                 w *= opt.bias;
             }
-            os << w << '\t' << attr << std::endl;
+            if (compiled) {
+                mfw.add(attr, 0, w);
+            } else {
+                os << w << '\t' << attr << std::endl;
+            }
         }
     }
+
+    // Write the compiled model.
+    if (compiled && !mfw.write(opt.model)) {
+        throw invalid_data("An error occurred when writing the model", opt.model);
+    }
 }
 
-int binary_train(option& opt)
+template <
+    class data_type,
+    class model_type
+>
+static int
+input_model(
+    data_type& data,
+    model_type& model,
+    const option& opt
+    )
+{
+    init_model im;
+    im.read(opt.init_model, MODEL_FILE_BINARY);
+    check_init_hashing(data.attributes, im.hash_bits);
+
+    // Associate the weights with the attributes of the data set.
+    int n = 0;
+    model.resize(data.num_features());
+    std::fill(model.begin(), model.end(), 0.);
+    for (size_t i = 0;i < im.weights.size();++i) {
+        const model_weight& e = im.weights[i];
+        int a = find_attribute(data.attributes, e.attribute);
+        if (0 <= a && a < (int)model.size()) {
+            model[a] = e.weight;
+            if (e.attribute == "__BIAS__" && opt.bias != 0.) {
+                model[a] /= opt.bias;
+            }
+            ++n;
+        }
+    }
+    return n;
+}
+
+template <class data_type>
+static int
+binary_train_data(option& opt)
 {
     // Branches for training algorithms.
     if (opt.algorithm == "lbfgs.logistic") {
         return train<
-            classias::bsdata,
-            classias::train::lbfgs_logistic_binary<classias::bsdata>
+            data_type,
+            classias::train::lbfgs_logistic_binary<data_type>
+        >(opt);
+    } else if (opt.algorithm == "svrg.logistic") {
+        return train<
+            data_type,
+            classias::train::svrg_logistic_binary<data_type>
+        >(opt);
+    } else if (opt.algorithm == "dcd.logistic") {
+        return train<
+            data_type,
+            classias::train::dcd_logistic_binary<data_type>
+        >(opt);
+    } else if (opt.algorithm == "dcd.hinge") {
+        return train<
+            data_type,
+            classias::train::dcd_hinge_binary<data_type>
         >(opt);
     } else if (opt.algorithm == "averaged_perceptron") {
         return train<
-            classias::bsdata,
+            data_type,
             classias::train::online_scheduler_binary<
-                classias::bsdata,
+                data_type,
                 classias::train::averaged_perceptron_binary<
                     classias::classify::linear_binary<classias::weight_vector>
                     >
@@ -237,9 +292,9 @@ int binary_train(option& opt)
             >(opt);
     } else if (opt.algorithm == "pegasos.logistic") {
         return train<
-            classias::bsdata,
+            data_type,
             classias::train::online_scheduler_binary<
-                classias::bsdata,
+                data_type,
                 classias::train::pegasos_binary<
                     classias::classify::linear_binary_logistic<classias::weight_vector>
                     >
@@ -247,9 +302,9 @@ int binary_train(option& opt)
             >(opt);
     } else if (opt.algorithm == "pegasos.hinge") {
         return train<
-            classias::bsdata,
+            data_type,
             classias::train::online_scheduler_binary<
-                classias::bsdata,
+                data_type,
                 classias::train::pegasos_binary<
                     classias::classify::linear_binary_hinge<classias::weight_vector>
                     >
@@ -257,9 +312,9 @@ int binary_train(option& opt)
             >(opt);
     } else if (opt.algorithm == "truncated_gradient.logistic") {
         return train<
-            classias::bsdata,
+            data_type,
             classias::train::online_scheduler_binary<
-                classias::bsdata,
+                data_type,
                 classias::train::truncated_gradient_binary<
                     classias::classify::linear_binary_logistic<classias::weight_vector>
                     >
@@ -267,9 +322,9 @@ int binary_train(option& opt)
             >(opt);
     } else if (opt.algorithm == "truncated_gradient.hinge") {
         return train<
-            classias::bsdata,
+            data_type,
             classias::train::online_scheduler_binary<
-                classias::bsdata,
+                data_type,
                 classias::train::truncated_gradient_binary<
                     classias::classify::linear_binary_hinge<classias::weight_vector>
                     >
@@ -279,3 +334,21 @@ int binary_train(option& opt)
         throw invalid_algorithm(opt.algorithm);
     }
 }
+
+int binary_train(option& opt)
+{
+    // Branch for the storage of instances and attributes.
+    if (opt.csr) {
+        if (0 < opt.hash_bits) {
+            return binary_train_data<classias::bsdata_csr_hashed>(opt);
+        } else {
+            return binary_train_data<classias::bsdata_csr>(opt);
+        }
+    } else {
+        if (0 < opt.hash_bits) {
+            return binary_train_data<classias::bsdata_hashed>(opt);
+        } else {
+            return binary_train_data<classias::bsdata>(opt);
+        }
+    }
+}
@@ -0,0 +1,921 @@
+/*
+ *		Binary cache of data sets.
+ *
+ * Copyright (c) 2008,2009 Naoaki Okazaki
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the names of the authors nor the names of its contributors
+ *       may be used to endorse or promote products derived from this
+ *       software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* $Id$ */
+
+#ifndef __CACHE_H__
+#define __CACHE_H__
+
+/*
+A cache file stores a data set as it is read from the source files, i.e.,
+before finalize_data() generates features; all values are written in the
+native byte order of the machine. The instances are stored in chunks of
+(at most) CLASSIAS_CACHE_CHUNK instances, which can be written while the
+source files are read and read in any order by a streaming trainer. The
+string tables follow the chunks since they are complete only at the end,
+and the last eight bytes locate the trailer.
+
+<cache>         ::= <magic> <signature> <chunk>* <trailer> <uint64: trailer offset>
+<magic>         ::= <string: "CLSCACHE"> <uint32: version>
+<signature>     ::= <string>
+<chunk>         ::= <instances> <rows>
+<instances>     ::= <uint64: M> (<int32: label> <double: weight> <int32: group> <uint32: rows>){M}
+<rows>          ::= <uint64: R> <uint64: offset>{R+1} <int32: id>{nnz} <double: value>{nnz}
+<trailer>       ::= <strings> <strings> <start> <uint64: C> (<uint64: chunk offset> <uint64: M>){C}
+<strings>       ::= <uint32: N> <string>{N}     (attributes, then labels)
+
+The rows of a candidate instance are its shared attributes followed by the
+candidates.
+<string>        ::= <uint32: length> <char>{length}
+<start>         ::= <int32: user feature start>
+*/
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include <mapped_file.h>
+#include <classias/classias.h>
+
+#define CLASSIAS_CACHE_MAGIC    "CLSCACHE"
+#define CLASSIAS_CACHE_VERSION  3
+#define CLASSIAS_CACHE_CHUNK    4096
+
+/**
+ * Builds the string identifying the options affecting the reader of data.
+ *  This is the first part of the signature of a cache, which is checked
+ *  even when the cache is read without the source files.
+ */
+inline static std::string
+cache_options_signature(const option& opt)
+{
+    std::stringstream ss;
+    ss << "type=" << opt.type << '\n';
+    ss << "bias=" << opt.bias << '\n';
+    ss << "filter=" << opt.filter_string << '\n';
+    ss << "hash=" << opt.hash_bits << '\t' << opt.hash_signed << '\n';
+    ss << "min_count=" << opt.min_count << '\n';
+    ss << "token_separator=" << (int)opt.token_separator << '\n';
+    ss << "value_separator=" << (int)opt.value_separator << '\n';
+    return ss.str();
+}
+
+/**
+ * Builds the string identifying the source of a cache.
+ *  A cache is reused only when the source files (with their sizes and
+ *  modification times) and the options affecting the reader are unchanged.
+ */
+inline static std::string
+cache_signature(const option& opt)
+{
+    std::stringstream ss;
+    ss << cache_options_signature(opt);
+    for (size_t i = 0;i < opt.files.size();++i) {
+        struct stat st;
+        ss << "file=" << opt.files[i];
+        if (stat(opt.files[i].c_str(), &st) == 0) {
+            ss << '\t' << (long long)st.st_size << '\t' << (long long)st.st_mtime;
+        }
+        ss << '\n';
+    }
+    return ss.str();
+}
+
+/**
+ * A writer of a cache file.
+ */
+class cache_writer
+{
+protected:
+    std::ofstream m_ofs;
+
+public:
+    /// The offsets and numbers of instances of the chunks written.
+    std::vector<std::pair<uint64_t, uint64_t> > chunks;
+
+    cache_writer(const std::string& filename)
+        : m_ofs(filename.c_str(), std::ios::out | std::ios::binary)
+    {
+        if (m_ofs.fail()) {
+            throw invalid_data("Failed to open a cache file for writing", filename);
+        }
+    }
+
+    template <class value_type>
+    void put(const value_type& value)
+    {
+        m_ofs.write(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+
+    void put_string(const std::string& str)
+    {
+        put((uint32_t)str.length());
+        m_ofs.write(str.c_str(), str.length());
+    }
+
+    template <class quark_type>
+    void put_strings(const quark_type& qrk)
+    {
+        put((uint32_t)qrk.size());
+        for (int i = 0;i < (int)qrk.size();++i) {
+            put_string(qrk.to_item(i));
+        }
+    }
+
+    /* A hashed quark stores only the reserved items. */
+    template <class item_type>
+    void put_strings(const classias::hashed_quark_base<item_type>& qrk)
+    {
+        put((uint32_t)qrk.num_reserved());
+        for (int i = 0;i < (int)qrk.num_reserved();++i) {
+            put_string(qrk.to_item(i));
+        }
+    }
+
+    uint64_t tell()
+    {
+        return (uint64_t)m_ofs.tellp();
+    }
+
+    void close()
+    {
+        m_ofs.close();
+        if (m_ofs.fail()) {
+            throw invalid_data("An error occurred when writing a cache file");
+        }
+    }
+};
+
+/**
+ * A reader of a cache file.
+ */
+class cache_reader
+{
+protected:
+    mapped_file m_file;
+    size_t m_offset;
+
+public:
+    cache_reader() : m_offset(0)
+    {
+    }
+
+    bool open(const std::string& filename)
+    {
+        m_offset = 0;
+        return m_file.open(filename);
+    }
+
+    void seek(size_t offset)
+    {
+        m_offset = offset;
+    }
+
+    size_t tell() const
+    {
+        return m_offset;
+    }
+
+    size_t size() const
+    {
+        return m_file.size();
+    }
+
+    const mapped_file& file() const
+    {
+        return m_file;
+    }
+
+    const char* get_block(size_t size)
+    {
+        if (m_file.size() < m_offset + size) {
+            throw invalid_data("A cache file is truncated");
+        }
+        const char* p = m_file.data() + m_offset;
+        m_offset += size;
+        return p;
+    }
+
+    template <class value_type>
+    void get(value_type& value)
+    {
+        std::memcpy(&value, get_block(sizeof(value)), sizeof(value));
+    }
+
+    void get_string(std::string& str)
+    {
+        uint32_t length;
+        get(length);
+        str.assign(get_block(length), length);
+    }
+
+    template <class quark_type>
+    void get_strings(quark_type& qrk)
+    {
+        uint32_t n;
+        get(n);
+        for (uint32_t i = 0;i < n;++i) {
+            std::string str;
+            get_string(str);
+            qrk(str);
+        }
+    }
+
+    template <class item_type>
+    void get_strings(classias::hashed_quark_base<item_type>& qrk)
+    {
+        uint32_t n;
+        get(n);
+        for (uint32_t i = 0;i < n;++i) {
+            std::string str;
+            get_string(str);
+            qrk.reserve(str);
+        }
+    }
+};
+
+/* Accessors for the (shared and candidate) rows of an instance. */
+template <class instance_type>
+static size_t cache_num_rows(const instance_type&)
+{
+    return 1;
+}
+
+inline static size_t cache_num_rows(const classias::cinstance& inst)
+{
+    return inst.size() + 1;
+}
+
+template <class instance_type>
+static const instance_type&
+cache_row(const instance_type& inst, size_t)
+{
+    return inst;
+}
+
+inline static const classias::sparse_attributes&
+cache_row(const classias::cinstance& inst, size_t i)
+{
+    return (i == 0) ? inst.shared() : inst.begin()[i-1];
+}
+
+template <class instance_type>
+static instance_type& cache_new_row(instance_type& inst, size_t)
+{
+    return inst;
+}
+
+inline static classias::sparse_attributes&
+cache_new_row(classias::cinstance& inst, size_t i)
+{
+    return (i == 0) ? inst.shared() : inst.new_element();
+}
+
+/* Accessors for the label quark (binary data sets have no label quark). */
+template <class data_type>
+static void cache_put_labels(cache_writer& cw, const data_type& data)
+{
+    cw.put_strings(data.labels);
+}
+
+template <class instance_type, class quark_type>
+static void cache_put_labels(
+    cache_writer& cw,
+    const classias::binary_data_with_quark_base<instance_type, quark_type>& data)
+{
+    cw.put((uint32_t)0);
+}
+
+template <class quark_type>
+static void cache_put_labels(
+    cache_writer& cw,
+    const classias::binary_csr_data_with_quark_base<quark_type>& data)
+{
+    cw.put((uint32_t)0);
+}
+
+template <class data_type>
+static void cache_get_labels(cache_reader& cr, data_type& data)
+{
+    cr.get_strings(data.labels);
+}
+
+template <class instance_type, class quark_type>
+static void cache_get_labels(
+    cache_reader& cr,
+    classias::binary_data_with_quark_base<instance_type, quark_type>& data)
+{
+    uint32_t n;
+    cr.get(n);
+    if (n != 0) {
+        throw invalid_data("A cache file is not for binary data");
+    }
+}
+
+template <class quark_type>
+static void cache_get_labels(
+    cache_reader& cr,
+    classias::binary_csr_data_with_quark_base<quark_type>& data)
+{
+    uint32_t n;
+    cr.get(n);
+    if (n != 0) {
+        throw invalid_data("A cache file is not for binary data");
+    }
+}
+
+/* Writers for the attribute identifiers and values of a row. */
+template <class row_type>
+static void cache_put_ids(cache_writer& cw, const row_type& row)
+{
+    typename row_type::const_iterator it;
+    for (it = row.begin();it != row.end();++it) {
+        cw.put((int32_t)it->first);
+    }
+}
+
+template <class row_type>
+static void cache_put_values(cache_writer& cw, const row_type& row)
+{
+    typename row_type::const_iterator it;
+    for (it = row.begin();it != row.end();++it) {
+        cw.put((double)it->second);
+    }
+}
+
+/* Reader for the attribute identifiers and values of a row. */
+template <class row_type>
+static void cache_fill_row(
+    row_type& row, const char* ids, const char* values, size_t& k, uint64_t last)
+{
+    for (;k < last;++k) {
+        int32_t id;
+        double value;
+        std::memcpy(&id, ids + k * sizeof(int32_t), sizeof(id));
+        std::memcpy(&value, values + k * sizeof(double), sizeof(value));
+        row.append(id, value);
+    }
+}
+
+/**
+ * Writes the header of a cache file.
+ *  @param  cw          The cache writer.
+ *  @param  opt         The options.
+ */
+inline static void
+write_cache_header(
+    cache_writer& cw,
+    const option& opt
+    )
+{
+    cw.put_string(std::string(CLASSIAS_CACHE_MAGIC));
+    cw.put((uint32_t)CLASSIAS_CACHE_VERSION);
+    cw.put_string(cache_signature(opt));
+}
+
+/**
+ * Writes a chunk of instances to a cache file.
+ *  @param  cw          The cache writer.
+ *  @param  first       The iterator for the first instance of the chunk.
+ *  @param  last        The iterator for the element just beyond the last
+ *                      instance of the chunk.
+ */
+template <class iterator_type>
+static void
+write_cache_chunk(
+    cache_writer& cw,
+    iterator_type first,
+    iterator_type last
+    )
+{
+    const uint64_t M = (uint64_t)std::distance(first, last);
+    cw.chunks.push_back(std::make_pair(cw.tell(), M));
+
+    // The instances.
+    uint64_t R = 0;
+    cw.put(M);
+    for (iterator_type it = first;it != last;++it) {
+        cw.put((int32_t)it->get_label());
+        cw.put((double)it->get_weight());
+        cw.put((int32_t)it->get_group());
+        cw.put((uint32_t)cache_num_rows(*it));
+        R += cache_num_rows(*it);
+    }
+
+    // The row offsets.
+    uint64_t offset = 0;
+    cw.put(R);
+    cw.put(offset);
+    for (iterator_type it = first;it != last;++it) {
+        for (size_t i = 0;i < cache_num_rows(*it);++i) {
+            offset += cache_row(*it, i).size();
+            cw.put(offset);
+        }
+    }
+
+    // The attribute identifiers and values.
+    for (iterator_type it = first;it != last;++it) {
+        for (size_t i = 0;i < cache_num_rows(*it);++i) {
+            cache_put_ids(cw, cache_row(*it, i));
+        }
+    }
+    for (iterator_type it = first;it != last;++it) {
+        for (size_t i = 0;i < cache_num_rows(*it);++i) {
+            cache_put_values(cw, cache_row(*it, i));
+        }
+    }
+}
+
+/**
+ * Writes the trailer of a cache file and closes the file.
+ *  @param  cw          The cache writer.
+ *  @param  data        The data set holding the string tables.
+ */
+template <class data_type>
+static void
+write_cache_trailer(
+    cache_writer& cw,
+    const data_type& data
+    )
+{
+    const uint64_t offset = cw.tell();
+    cw.put_strings(data.attributes);
+    cache_put_labels(cw, data);
+    cw.put((int32_t)data.get_user_feature_start());
+    cw.put((uint64_t)cw.chunks.size());
+    for (size_t i = 0;i < cw.chunks.size();++i) {
+        cw.put(cw.chunks[i].first);
+        cw.put(cw.chunks[i].second);
+    }
+    cw.put(offset);
+    cw.close();
+}
+
+/**
+ * Writes a data set to a cache file.
+ *  @param  data        The data set read from the source files.
+ *  @param  opt         The options.
+ */
+template <class data_type>
+static void
+write_cache(
+    const data_type& data,
+    const option& opt
+    )
+{
+    typedef typename data_type::const_iterator const_iterator;
+    cache_writer cw(opt.cache);
+
+    write_cache_header(cw, opt);
+    for (size_t i = 0;i < data.size();i += CLASSIAS_CACHE_CHUNK) {
+        size_t n = std::min((size_t)CLASSIAS_CACHE_CHUNK, data.size() - i);
+        const_iterator first = data.begin() + i;
+        write_cache_chunk(cw, first, first + n);
+    }
+    write_cache_trailer(cw, data);
+}
+
+/* Removes all the instances but the last one from a data set. */
+template <class data_type>
+static void cache_keep_last(data_type& data)
+{
+    typename data_type::instance_type inst = data.back();
+    data.clear();
+    data.new_element() = inst;
+}
+
+template <class quark_type>
+static void cache_keep_last(classias::binary_csr_data_with_quark_base<quark_type>& data)
+{
+    typedef typename classias::binary_csr_data_with_quark_base<quark_type>::instance_type instance_type;
+    std::vector<std::pair<int, double> > elems;
+    const instance_type inst = data.back();
+    for (typename instance_type::const_iterator it = inst.begin();it != inst.end();++it) {
+        elems.push_back(std::make_pair(it->first, it->second));
+    }
+    const bool label = inst.get_label();
+    const double weight = inst.get_weight();
+    const int group = inst.get_group();
+
+    data.clear();
+    instance_type& last = data.new_element();
+    last.set_label(label);
+    last.set_weight(weight);
+    last.set_group(group);
+    for (size_t i = 0;i < elems.size();++i) {
+        last.append(elems[i].first, elems[i].second);
+    }
+}
+
+/**
+ * A writer of a cache file that receives the instances while the source
+ * files are read.
+ *  The instances are written to the cache file in chunks and removed from
+ *  the data set, which thus holds at most one chunk of instances besides the
+ *  string tables; the last instance is retained until the next one arrives
+ *  since a candidate instance spans multiple lines.
+ */
+template <class data_type>
+class cache_spill : public chunk_sink
+{
+protected:
+    data_type& m_data;
+    cache_writer m_cw;
+
+public:
+    cache_spill(data_type& data, const option& opt)
+        : m_data(data), m_cw(opt.cache)
+    {
+        write_cache_header(m_cw, opt);
+    }
+
+    virtual void stored()
+    {
+        if (CLASSIAS_CACHE_CHUNK < m_data.size()) {
+            const data_type& data = m_data;
+            write_cache_chunk(m_cw, data.begin(), data.end() - 1);
+            cache_keep_last(m_data);
+        }
+    }
+
+    /**
+     * Writes the remaining instances and the trailer.
+     */
+    void finish()
+    {
+        if (!m_data.empty()) {
+            const data_type& data = m_data;
+            write_cache_chunk(m_cw, data.begin(), data.end());
+            m_data.clear();
+        }
+        write_cache_trailer(m_cw, m_data);
+    }
+
+    /**
+     * Returns the number of instances written.
+     */
+    size_t size() const
+    {
+        size_t n = 0;
+        for (size_t i = 0;i < m_cw.chunks.size();++i) {
+            n += (size_t)m_cw.chunks[i].second;
+        }
+        return n;
+    }
+};
+
+/**
+ * Reads the header and the trailer of a cache file.
+ *  @param  cr          The cache reader on the opened file.
+ *  @param  data        The empty data set to which this function stores the
+ *                      string tables.
+ *  @param  chunks      The offsets and numbers of instances of the chunks.
+ *  @param  opt         The options.
+ *  @return bool        \c true if the cache is valid, \c false if the cache
+ *                      is stale or of an older version.
+ *  @throws invalid_data    The cache is read without the source files and
+ *                          was stored with other options for reading data.
+ */
+template <class data_type>
+static bool
+read_cache_header(
+    cache_reader& cr,
+    data_type& data,
+    std::vector<std::pair<uint64_t, uint64_t> >& chunks,
+    const option& opt
+    )
+{
+    std::string magic, signature;
+    uint32_t version;
+
+    // Check the header.
+    cr.get_string(magic);
+    cr.get(version);
+    if (magic != CLASSIAS_CACHE_MAGIC || CLASSIAS_CACHE_VERSION < version) {
+        throw invalid_data("Not a cache file of this version", opt.cache);
+    } else if (version != CLASSIAS_CACHE_VERSION) {
+        return false;
+    }
+
+    // A cache read without the source files cannot be rebuilt; only the
+    // options affecting the reader are checked, and a mismatch is an error.
+    cr.get_string(signature);
+    if (opt.files.empty()) {
+        const std::string options = cache_options_signature(opt);
+        if (signature.compare(0, options.size(), options) != 0) {
+            throw invalid_data(
+                "A cache file was stored with other options for reading data "
+                "(-t, -b, -F, --hash-bits, --min-count, or the separators)",
+                opt.cache);
+        }
+    } else if (signature != cache_signature(opt)) {
+        return false;
+    }
+
+    // Locate the trailer.
+    uint64_t offset;
+    if (cr.size() < cr.tell() + sizeof(offset)) {
+        throw invalid_data("A cache file is truncated", opt.cache);
+    }
+    cr.seek(cr.size() - sizeof(offset));
+    cr.get(offset);
+    cr.seek((size_t)offset);
+
+    // Read the string tables.
+    cr.get_strings(data.attributes);
+    cache_get_labels(cr, data);
+    int32_t start;
+    cr.get(start);
+    data.set_user_feature_start(start);
+
+    // Read the chunk table.
+    uint64_t C;
+    cr.get(C);
+    chunks.resize((size_t)C);
+    for (uint64_t i = 0;i < C;++i) {
+        cr.get(chunks[i].first);
+        cr.get(chunks[i].second);
+        if (offset < chunks[i].first) {
+            throw invalid_data("A cache file is broken", opt.cache);
+        }
+    }
+    return true;
+}
+
+/**
+ * Reads the instances of a chunk in a cache file and appends them to a
+ * data set.
+ *  @param  cr          The cache reader.
+ *  @param  data        The data set.
+ *  @param  offset      The offset of the chunk.
+ *  @param  opt         The options.
+ *  @param  base        The index of the first instance of the chunk.
+ *  @param  split       The number of groups into which the instances are
+ *                      split by their indices, or zero to use the groups
+ *                      stored in the cache.
+ */
+template <class data_type>
+static void
+read_cache_chunk(
+    cache_reader& cr,
+    data_type& data,
+    uint64_t offset,
+    const option& opt,
+    size_t base = 0,
+    int split = 0
+    )
+{
+    typedef typename data_type::instance_type instance_type;
+    cr.seek((size_t)offset);
+
+    // Read the labels, weights, groups, and numbers of rows of instances.
+    uint64_t M;
+    cr.get(M);
+    std::vector<int32_t> labels((size_t)M), groups((size_t)M);
+    std::vector<double> weights((size_t)M);
+    std::vector<uint32_t> rows((size_t)M);
+    for (uint64_t i = 0;i < M;++i) {
+        cr.get(labels[i]);
+        cr.get(weights[i]);
+        cr.get(groups[i]);
+        cr.get(rows[i]);
+    }
+
+    // Locate the arrays of row offsets, identifiers, and values.
+    uint64_t R;
+    cr.get(R);
+    const char* offsets = cr.get_block((size_t)(R+1) * sizeof(uint64_t));
+    uint64_t nnz;
+    std::memcpy(&nnz, offsets + (size_t)R * sizeof(uint64_t), sizeof(nnz));
+    const char* ids = cr.get_block((size_t)nnz * sizeof(int32_t));
+    const char* values = cr.get_block((size_t)nnz * sizeof(double));
+
+    // Create the instances in order, filling their attributes at once so
+    // that data sets appending to the last instance can read the cache.
+    size_t r = 0, k = 0;
+    for (uint64_t i = 0;i < M;++i) {
+        instance_type& inst = data.new_element();
+        inst.set_label(labels[i]);
+        inst.set_weight(weights[i]);
+        inst.set_group(0 < split ? (int)((base + i) % split) : groups[i]);
+
+        for (uint32_t j = 0;j < rows[i];++j, ++r) {
+            if (R <= r) {
+                throw invalid_data("A cache file is broken", opt.cache);
+            }
+            uint64_t last;
+            std::memcpy(&last, offsets + (r+1) * sizeof(uint64_t), sizeof(last));
+            cache_fill_row(cache_new_row(inst, j), ids, values, k, last);
+        }
+    }
+}
+
+/**
+ * Reads a data set from a cache file.
+ *  @param  data        The empty data set to which this function stores.
+ *  @param  opt         The options.
+ *  @return bool        \c true if the data set was read from the cache,
+ *                      \c false if the cache is missing or stale.
+ */
+template <class data_type>
+static bool
+read_cache(
+    data_type& data,
+    const option& opt
+    )
+{
+    cache_reader cr;
+    std::vector<std::pair<uint64_t, uint64_t> > chunks;
+
+    if (!cr.open(opt.cache) || !read_cache_header(cr, data, chunks, opt)) {
+        return false;
+    }
+    for (size_t i = 0;i < chunks.size();++i) {
+        read_cache_chunk(cr, data, chunks[i].first, opt);
+    }
+    return true;
+}
+
+/**
+ * A source of data blocks read from a cache file for streaming training
+ * (see online_scheduler_binary::train_stream()).
+ *
+ *  A pass over the stream reads the chunks of the cache in the order of the
+ *  file, or in a random order for shuffled passes, and loads the instances
+ *  of a fixed number of consecutive chunks (a block) into the data set. The
+ *  chunks of the next block are advised to be read ahead while the trainer
+ *  works on the current block, and chunks loaded are released from the
+ *  memory of the process.
+ */
+template <class data_type>
+class cache_stream
+{
+protected:
+    data_type& m_data;
+    const option& m_opt;
+    cache_reader m_cr;
+    std::vector<std::pair<uint64_t, uint64_t> > m_chunks;
+    std::vector<uint64_t> m_ends;
+    std::vector<size_t> m_bases;
+    std::vector<size_t> m_order;
+    size_t m_num_instances;
+    size_t m_block_chunks;
+    size_t m_pos;
+    int m_split;
+
+public:
+    /**
+     * Constructs the object.
+     *  @param  data        The data set to which blocks are loaded.
+     *  @param  opt         The options.
+     *  @param  block_size  The number of instances in a block.
+     */
+    cache_stream(data_type& data, const option& opt, size_t block_size)
+        : m_data(data), m_opt(opt), m_num_instances(0), m_pos(0), m_split(0)
+    {
+        m_block_chunks = std::max((size_t)1, block_size / CLASSIAS_CACHE_CHUNK);
+    }
+
+    /**
+     * Opens the cache file and reads the string tables into the data set.
+     *  @return bool        \c true if the cache is valid.
+     */
+    bool open()
+    {
+        if (!m_cr.open(m_opt.cache) || !read_cache_header(m_cr, m_data, m_chunks, m_opt)) {
+            return false;
+        }
+
+        // Compute the extent and the index of the first instance of chunks.
+        std::vector<uint64_t> offsets;
+        for (size_t i = 0;i < m_chunks.size();++i) {
+            offsets.push_back(m_chunks[i].first);
+        }
+        offsets.push_back((uint64_t)m_cr.size());
+        std::sort(offsets.begin(), offsets.end());
+
+        m_num_instances = 0;
+        m_ends.resize(m_chunks.size());
+        m_bases.resize(m_chunks.size());
+        for (size_t i = 0;i < m_chunks.size();++i) {
+            m_ends[i] = *std::upper_bound(offsets.begin(), offsets.end(), m_chunks[i].first);
+            m_bases[i] = m_num_instances;
+            m_num_instances += (size_t)m_chunks[i].second;
+        }
+        m_order.resize(m_chunks.size());
+        for (size_t i = 0;i < m_order.size();++i) {
+            m_order[i] = i;
+        }
+        return true;
+    }
+
+    /**
+     * Assigns the instances to groups by their indices in the stream.
+     *  @param  split       The number of groups.
+     */
+    void set_split(int split)
+    {
+        m_split = split;
+    }
+
+    size_t size() const
+    {
+        return m_num_instances;
+    }
+
+    size_t num_chunks() const
+    {
+        return m_chunks.size();
+    }
+
+    size_t block_size() const
+    {
+        return m_block_chunks * CLASSIAS_CACHE_CHUNK;
+    }
+
+    const data_type& data() const
+    {
+        return m_data;
+    }
+
+    void rewind(bool shuffle)
+    {
+        for (size_t i = 0;i < m_order.size();++i) {
+            m_order[i] = i;
+        }
+        if (shuffle) {
+            std::random_shuffle(m_order.begin(), m_order.end());
+        }
+        m_pos = 0;
+        m_data.clear();
+        this->read_ahead();
+    }
+
+    const data_type* next()
+    {
+        m_data.clear();
+        if (m_order.size() <= m_pos) {
+            return NULL;
+        }
+
+        // Load the chunks of the block.
+        for (size_t j = 0;j < m_block_chunks && m_pos < m_order.size();++j, ++m_pos) {
+            size_t i = m_order[m_pos];
+            read_cache_chunk(m_cr, m_data, m_chunks[i].first, m_opt, m_bases[i], m_split);
+            m_cr.file().dont_need(
+                (size_t)m_chunks[i].first,
+                (size_t)(m_ends[i] - m_chunks[i].first));
+        }
+
+        // Read the next block ahead.
+        this->read_ahead();
+        return &m_data;
+    }
+
+protected:
+    void read_ahead()
+    {
+        for (size_t j = 0;j < m_block_chunks && m_pos + j < m_order.size();++j) {
+            size_t i = m_order[m_pos + j];
+            m_cr.file().will_need(
+                (size_t)m_chunks[i].first,
+                (size_t)(m_ends[i] - m_chunks[i].first));
+        }
+    }
+};
+
+#endif/*__CACHE_H__*/
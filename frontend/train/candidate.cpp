@@ -44,6 +44,7 @@
 #include <classias/train/pegasos.h>
 #include <classias/train/truncated_gradient.h>
 #include <classias/train/online_scheduler.h>
+#include <classias/train/svrg.h>
 
 #include "option.h"
 #include "tokenize.h"
@@ -52,11 +53,15 @@
 /* Automatic generation of bias features is not supported. */
 
 /*
-<line>          ::= <comment> | <boi> | <eoi> | <unreg> | <candidate> | <br>
+The features in "@shared" lines of an instance are shared by all the
+candidates of the instance, as if they were appended to every candidate.
+
+<line>          ::= <comment> | <boi> | <eoi> | <unreg> | <shared> | <candidate> | <br>
 <comment>       ::= "#" <string> <br>
 <boi>           ::= "@boi" [ <weight> ] <br>
 <eoi>           ::= "@eoi" <br>
 <unregularize>  ::= "@unregularize" ("\t" <label>)+ <br>
+<shared>        ::= "@shared" ("\t" <feature>)+ <br>
 <instance>      ::= <class> [ <label> ] ("\t" <feature>)+ <br>
 <class>         ::= "T" | "+" | "F" | "-"
 <label>         ::= <name>
@@ -68,44 +73,25 @@
 
 template <
     class instance_type,
-    class features_quark_type,
-    class label_quark_type
+    class features_quark_type
 >
 static void
-read_line(
-    const std::string& line,
+store_candidate(
     instance_type& instance,
     features_quark_type& features,
-    label_quark_type& labels,
-    const option& opt,
-    int lines = 0
+    const parsed_line& p
     )
 {
-    std::string name;
     typedef typename instance_type::candidate_type candidate_type;
 
-    // Split the line with tab characters.
-    tokenizer values(line, opt.token_separator);
-    tokenizer::iterator itv = values.begin();
-    if (itv == values.end()) {
-        throw invalid_data("no field found in the line", line, lines);
-    }
-
-    // Make sure that the first token (class) is not empty.
-    if (itv->empty()) {
-        throw invalid_data("an empty label found", line, lines);
-    }
-
-    name = *itv;
-
     // Set the truth value for this candidate.
     bool truth = false;
-    if (name.compare(0, 1, "+") == 0) {
+    if (p.label.compare(0, 1, "+") == 0) {
         truth = true;
-    } else if (name.compare(0, 1, "-") == 0) {
+    } else if (p.label.compare(0, 1, "-") == 0) {
         truth = false;
     } else {
-        throw invalid_data("a class label must begins with '+' or '-'", line, lines);
+        throw invalid_data("a class label must begins with '+' or '-'", p.line, p.lines);
     }
 
     // Create a new candidate.
@@ -115,14 +101,29 @@ read_line(
     }
 
     // Set featuress for the instance.
-    for (++itv;itv != values.end();++itv) {
-        if (!itv->empty()) {
-            double value;
-            get_name_value(*itv, name, value, opt.value_separator);
-            if (opt.filter_string.empty() || REGEX_SEARCH(name, opt.filter)) {
-                cand.append(features(name), value);
-            }
-        }
+    for (size_t i = 0;i < p.fields.size();++i) {
+        double v = p.fields[i].second;
+        int a = get_attribute(features, p, i, v);
+        cand.append(a, v);
+    }
+}
+
+template <
+    class instance_type,
+    class features_quark_type
+>
+static void
+store_shared(
+    instance_type& instance,
+    features_quark_type& features,
+    const parsed_line& p
+    )
+{
+    // Append the features to the shared attributes of the instance.
+    for (size_t i = 0;i < p.fields.size();++i) {
+        double v = p.fields[i].second;
+        int a = get_attribute(features, p, i, v);
+        instance.shared().append(a, v);
     }
 }
 
@@ -130,80 +131,82 @@ template <
     class data_type
 >
 static void
-read_stream(
-    std::istream& is,
+store_line(
     data_type& data,
+    const parsed_line& p,
     const option& opt,
-    int group = 0
+    int group
     )
 {
-    int lines = 0;
     typedef typename data_type::instance_type instance_type;
+    const std::string& line = p.line;
 
-    for (;;) {
-        // Read a line.
-        std::string line;
-        std::getline(is, line);
-        if (is.eof()) {
-            break;
+    if (!p.directive) {
+        if (p.label == "@shared") {
+            // Attributes shared by the candidates.
+            store_shared(data.back(), data.attributes, p);
+        } else {
+            // A new candidate.
+            store_candidate(data.back(), data.attributes, p);
         }
-        ++lines;
 
-        // Skip an empty line.
-        if (line.empty()) {
-            continue;
+    } else if (line.compare(0, 13, "@unregularize") == 0) {
+        // Read features that should not be regularized.
+        if (!data.empty()) {
+            throw invalid_data("Declarative @unregularize must precede an instance", line, p.lines);
         }
 
-        // Skip a comment line.
-        if (line.compare(0, 1, "#") == 0) {
-            continue;
+        // Feature names for unregularization.
+        tokenizer values(line, opt.token_separator);
+        tokenizer::iterator itv = values.begin();
+        for (++itv;itv != values.end();++itv) {
+            // Reserve early feature identifiers.
+            reserve_attribute(data.attributes, *itv);
         }
 
-        // Read features that should not be regularized.
-        if (line.compare(0, 13, "@unregularize") == 0) {
-            if (!data.empty()) {
-                throw invalid_data("Declarative @unregularize must precede an instance", line, lines);
-            }
-
-            // Feature names for unregularization.
-            tokenizer values(line, opt.token_separator);
-            tokenizer::iterator itv = values.begin();
-            for (++itv;itv != values.end();++itv) {
-                // Reserve early feature identifiers.
-                data.attributes(*itv);
-            }
+        // Set the start index of the user features.
+        data.set_user_feature_start(num_reserved_attributes(data.attributes));
 
-            // Set the start index of the user features.
-            data.set_user_feature_start(data.attributes.size());
+    } else if (line.compare(0, 4, "@boi") == 0) {
+        double value;
+        std::string name;
+        get_name_value(line, name, value, opt.value_separator);
 
-        } else if (line.compare(0, 4, "@boi") == 0) {
-            double value;
-            std::string name;
-            get_name_value(line, name, value, opt.value_separator);
-
-            if (name == "@boi") {
-                // Start of a new instance.
-                instance_type& inst = data.new_element();
-                inst.set_group(group);
-                inst.set_weight(value);
-            }
-
-        } else if (line == "@eoi") {
-            if (data.empty()) {
-                throw invalid_data("Declarative @eoi found before a declarative @boi", line, lines);
-            }
+        if (name == "@boi") {
+            // Start of a new instance.
+            instance_type& inst = data.new_element();
+            inst.set_group(group);
+            inst.set_weight(value);
+        }
 
-            if (data.back().get_label() < 0) {
-                throw invalid_data("No true candidate exists in the current instance", line, lines);
-            }
+    } else if (line == "@eoi") {
+        if (data.empty()) {
+            throw invalid_data("Declarative @eoi found before a declarative @boi", line, p.lines);
+        }
 
-        } else {
-            // A new candidate.
-            read_line(line, data.back(), data.attributes, data.labels, opt, lines);
+        if (data.back().get_label() < 0) {
+            throw invalid_data("No true candidate exists in the current instance", line, p.lines);
         }
     }
 }
 
+template <
+    class data_type
+>
+static void
+read_stream(
+    std::istream& is,
+    data_type& data,
+    const option& opt,
+    int group = 0,
+    chunk_sink* sink = NULL,
+    attribute_counts* counts = NULL
+    )
+{
+    // Read the instances.
+    read_lines(is, data, opt, group, sink, counts);
+}
+
 template <
     class data_type
 >
@@ -223,6 +226,26 @@ finalize_data(
     }
 }
 
+/**
+ * Finalizes the data set read from a stream of cache blocks.
+ *  @param  source      The stream on the cache file.
+ *  @param  data        The data set holding the string tables.
+ *  @param  opt         The options.
+ */
+template <
+    class source_type,
+    class data_type
+>
+static void
+finalize_stream(
+    source_type& source,
+    data_type& data,
+    const option& opt
+    )
+{
+    finalize_data(data, opt);
+}
+
 template <
     class data_type,
     class model_type
@@ -231,42 +254,97 @@ static void
 output_model(
     data_type& data,
     const model_type& model,
-    const option& opt
+    const option& opt,
+    const std::vector<int>& perm
     )
 {
     typedef int int_t;
     typedef typename model_type::value_type value_type;
 
+    const bool compiled = (opt.model_format == option::MODEL_FORMAT_BINARY);
+    model_file_writer mfw(MODEL_FILE_CANDIDATE, opt.weight_type);
+
     // Open a model file for writing.
-    std::ofstream os(opt.model.c_str());
+    std::ofstream os;
+    if (!compiled) {
+        os.open(opt.model.c_str());
 
-    // Output a model type.
-    os << "@classias\tlinear\tcandidate" << std::endl;
+        // Output a model type.
+        os << "@classias\tlinear\tcandidate" << std::endl;
+        output_attributes_header(os, data.attributes);
+    }
 
-    // Store the feature weights.
-    for (int i = 0;i < (int)data.attributes.size();++i) {
+    // Store the feature weights in the original order of the attributes.
+    for (int k = 0;k < (int)data.attributes.size();++k) {
+        const int i = renumbered_attribute(perm, k);
         value_type w = model[i];
         if (w != 0.) {
-            os <<
-                w << '\t' <<
-                data.attributes.to_item(i) << std::endl;
+            if (compiled) {
+                mfw.add(data.attributes.to_item(i), 0, w);
+            } else {
+                os <<
+                    w << '\t' <<
+                    attribute_name(data.attributes, i) << std::endl;
+            }
+        }
+    }
+
+    // Write the compiled model.
+    if (compiled && !mfw.write(opt.model)) {
+        throw invalid_data("An error occurred when writing the model", opt.model);
+    }
+}
+
+template <
+    class data_type,
+    class model_type
+>
+static int
+input_model(
+    data_type& data,
+    model_type& model,
+    const option& opt
+    )
+{
+    init_model im;
+    im.read(opt.init_model, MODEL_FILE_CANDIDATE);
+    check_init_hashing(data.attributes, im.hash_bits);
+
+    // Associate the weights with the attributes of the data set.
+    int n = 0;
+    model.resize(data.num_features());
+    std::fill(model.begin(), model.end(), 0.);
+    for (size_t i = 0;i < im.weights.size();++i) {
+        const model_weight& e = im.weights[i];
+        int a = find_attribute(data.attributes, e.attribute);
+        if (0 <= a && a < (int)model.size()) {
+            model[a] = e.weight;
+            ++n;
         }
     }
+    return n;
 }
 
-int candidate_train(option& opt)
+template <class data_type>
+static int
+candidate_train_data(option& opt)
 {
     // Branches for training algorithms.
     if (opt.algorithm == "lbfgs.logistic") {
         return train<
-            classias::csdata,
-            classias::train::lbfgs_logistic_multi<classias::csdata>
+            data_type,
+            classias::train::lbfgs_logistic_multi<data_type>
+        >(opt);
+    } else if (opt.algorithm == "svrg.logistic") {
+        return train<
+            data_type,
+            classias::train::svrg_logistic_multi<data_type>
         >(opt);
     } else if (opt.algorithm == "averaged_perceptron") {
         return train<
-            classias::csdata,
+            data_type,
             classias::train::online_scheduler_multi<
-                classias::csdata,
+                data_type,
                 classias::train::averaged_perceptron_multi<
                     classias::classify::linear_multi<classias::weight_vector>
                     >
@@ -274,9 +352,9 @@ int candidate_train(option& opt)
             >(opt);
     } else if (opt.algorithm == "pegasos.logistic") {
         return train<
-            classias::csdata,
+            data_type,
             classias::train::online_scheduler_multi<
-                classias::csdata,
+                data_type,
                 classias::train::pegasos_multi<
                     classias::classify::linear_multi_logistic<classias::weight_vector>
                     >
@@ -284,9 +362,9 @@ int candidate_train(option& opt)
             >(opt);
     } else if (opt.algorithm == "truncated_gradient.logistic") {
         return train<
-            classias::csdata,
+            data_type,
             classias::train::online_scheduler_multi<
-                classias::csdata,
+                data_type,
                 classias::train::truncated_gradient_multi<
                     classias::classify::linear_multi_logistic<classias::weight_vector>
                     >
@@ -296,3 +374,13 @@ int candidate_train(option& opt)
 
     throw invalid_algorithm(opt.algorithm);
 }
+
+int candidate_train(option& opt)
+{
+    // Branch for the attributes.
+    if (0 < opt.hash_bits) {
+        return candidate_train_data<classias::csdata_hashed>(opt);
+    } else {
+        return candidate_train_data<classias::csdata>(opt);
+    }
+}
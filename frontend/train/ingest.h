@@ -0,0 +1,616 @@
+/*
+ *		Pipelined reader for training data.
+ *
+ * Copyright (c) 2008,2009 Naoaki Okazaki
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the names of the authors nor the names of its contributors
+ *       may be used to endorse or promote products derived from this
+ *       software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* $Id$ */
+
+#ifndef __INGEST_H__
+#define __INGEST_H__
+
+#include <istream>
+#include <string>
+#include <utility>
+#include <vector>
+#include <classias/quark.h>
+#include <classias/concurrent_quark.h>
+#include <classias/hashed_quark.h>
+#include <classias/thread.h>
+#include <tokenize.h>
+#include <util.h>
+#include "sketch.h"
+
+/**
+ * The number of lines in a batch of the pipeline.
+ */
+#define INGEST_BATCH_LINES  4096
+
+/**
+ * The maximum number of decisions memoized by an attribute filter.
+ */
+#define FILTER_MEMO_SIZE    (1 << 22)
+
+/**
+ * A line of training data split into the fields.
+ *  The tokenization, the conversion of values, and the attribute filter are
+ *  applied by parse_line(), which does not touch a data set and can thus be
+ *  run on any thread. A task-specific store_line() function then interns the
+ *  names in the order of lines.
+ */
+struct parsed_line
+{
+    typedef std::pair<std::string, double> field_type;
+    typedef std::vector<field_type> fields_type;
+
+    /// The line number.
+    int lines;
+    /// The line.
+    std::string line;
+    /// \c true if the line is empty or a comment.
+    bool skip;
+    /// \c true if the line is a declarative of candidate data.
+    bool directive;
+    /// The first field (label) of the line.
+    std::string label;
+    /// The remaining fields that pass the attribute filter.
+    fields_type fields;
+    /// The identifiers of the attributes of the fields found by a parser
+    /// (-1 for an attribute unknown yet), or empty if not looked up.
+    std::vector<int> attributes;
+    /// The error message if the line could not be parsed.
+    std::string error;
+};
+
+/**
+ * The attribute filter (the option filter) with memoized decisions.
+ *  The regular expression is evaluated once for every distinct attribute
+ *  name (up to FILTER_MEMO_SIZE names) instead of once for every occurrence.
+ *  A filter is not shared by threads; every parser owns one.
+ */
+class attribute_filter
+{
+protected:
+    typedef UNORDERED_MAP<std::string, bool> memo_type;
+    memo_type m_memo;
+
+public:
+    /**
+     * Tests whether an attribute passes the filter.
+     *  @param  name        The attribute name.
+     *  @param  opt         The options.
+     *  @return bool        \c true if the attribute is used.
+     */
+    bool operator()(const std::string& name, const option& opt)
+    {
+        if (opt.filter_string.empty()) {
+            return true;
+        }
+
+        memo_type::const_iterator it = m_memo.find(name);
+        if (it != m_memo.end()) {
+            return it->second;
+        }
+
+        bool b = REGEX_SEARCH(name, opt.filter);
+        if (m_memo.size() < FILTER_MEMO_SIZE) {
+            m_memo.insert(memo_type::value_type(name, b));
+        }
+        return b;
+    }
+};
+
+/**
+ * Frequencies of attributes for dropping rare ones (the option min_count).
+ *  With source files, a first pass over the files fills the sketch, and
+ *  parse_line() drops the attributes whose estimated counts are below the
+ *  minimum. With a stream that cannot be read twice (STDIN), the counts are
+ *  accumulated while storing the lines (\c online), and an attribute is
+ *  kept from its min_count-th occurrence.
+ */
+struct attribute_counts
+{
+    /// The sketch of the numbers of occurrences of attributes.
+    count_min_sketch sketch;
+    /// \c true if the counts are accumulated while storing lines.
+    bool online;
+
+    attribute_counts() : online(false)
+    {
+    }
+};
+
+/**
+ * Parses a line of training data.
+ *  @param  p           The line, whose member line and lines are set.
+ *  @param  opt         The options.
+ *  @param  filter      The attribute filter.
+ *  @param  counts      The frequencies of attributes counted in advance,
+ *                      or \c NULL.
+ *  @throws invalid_data    The line does not have any field.
+ */
+inline static void
+parse_line(
+    parsed_line& p,
+    const option& opt,
+    attribute_filter& filter,
+    const attribute_counts* counts = NULL
+    )
+{
+    p.skip = false;
+    p.directive = false;
+    p.label.clear();
+    p.fields.clear();
+    p.attributes.clear();
+    p.error.clear();
+
+    // Skip an empty line and a comment line.
+    if (p.line.empty() || p.line.compare(0, 1, "#") == 0) {
+        p.skip = true;
+        return;
+    }
+
+    // Leave declaratives of candidate data as they are.
+    if (opt.type == option::TYPE_CANDIDATE) {
+        if (p.line.compare(0, 13, "@unregularize") == 0 ||
+            p.line.compare(0, 4, "@boi") == 0 ||
+            p.line == "@eoi") {
+            p.directive = true;
+            return;
+        }
+    }
+
+    // Split the line with tab characters (into views of the line).
+    view_tokenizer values(p.line, opt.token_separator);
+    view_tokenizer::iterator itv = values.begin();
+    if (itv == values.end()) {
+        throw invalid_data("no field found in the line", p.line, p.lines);
+    }
+
+    // Make sure that the first token (class) is not empty.
+    if (itv->empty()) {
+        throw invalid_data("an empty label found", p.line, p.lines);
+    }
+    itv->assign_to(p.label);
+
+    // Split the remaining fields into names and values.
+    for (++itv;itv != values.end();++itv) {
+        if (!itv->empty()) {
+            p.fields.push_back(parsed_line::field_type());
+            parsed_line::field_type& f = p.fields.back();
+            get_name_value(
+                itv->begin(), itv->end(), f.first, f.second,
+                opt.value_separator);
+            if (!filter(f.first, opt) || (counts != NULL && !counts->online &&
+                (int)counts->sketch.count(f.first) < opt.min_count)) {
+                p.fields.pop_back();
+            }
+        }
+    }
+}
+
+/**
+ * Counts the attributes of a line and drops those seen less than min_count
+ *  times so far (the online mode of attribute_counts).
+ *  @param  p           The parsed line.
+ *  @param  opt         The options.
+ *  @param  counts      The frequencies of attributes.
+ */
+inline static void
+count_line(
+    parsed_line& p,
+    const option& opt,
+    attribute_counts& counts
+    )
+{
+    size_t n = 0;
+    for (size_t i = 0;i < p.fields.size();++i) {
+        if (opt.min_count <= (int)counts.sketch.add(p.fields[i].first)) {
+            if (n != i) {
+                p.fields[n].first.swap(p.fields[i].first);
+                p.fields[n].second = p.fields[i].second;
+                if (!p.attributes.empty()) {
+                    p.attributes[n] = p.attributes[i];
+                }
+            }
+            ++n;
+        }
+    }
+    p.fields.resize(n);
+    if (!p.attributes.empty()) {
+        p.attributes.resize(n);
+    }
+}
+
+/**
+ * Counts the attributes in a stream of training data (the first pass for
+ *  the option min_count).
+ *  @param  is          The input stream.
+ *  @param  opt         The options.
+ *  @param  counts      The frequencies of attributes.
+ */
+inline static void
+count_attributes(
+    std::istream& is,
+    const option& opt,
+    attribute_counts& counts
+    )
+{
+    parsed_line p;
+    attribute_filter filter;
+    p.lines = 0;
+    for (;;) {
+        std::getline(is, p.line);
+        if (is.eof()) {
+            break;
+        }
+        ++p.lines;
+
+        parse_line(p, opt, filter);
+        for (size_t i = 0;i < p.fields.size();++i) {
+            counts.sketch.add(p.fields[i].first);
+        }
+    }
+}
+
+/**
+ * The attributes of a data set known to the parsers of the pipeline.
+ *  The storer of the pipeline, the only thread modifying the data set,
+ *  publishes every attribute that it adds to the data set with the same
+ *  identifier, and the parsers look up the attributes of their lines
+ *  concurrently. The storer thus interns only the attributes unknown when
+ *  their lines were parsed, and the identifiers are the same as those
+ *  assigned by a single thread.
+ */
+typedef classias::concurrent_quark_base<std::string> attribute_index;
+
+/**
+ * Starts an attribute index with the attributes of a data set.
+ *  @param  index       The attribute index.
+ *  @param  attributes  The attribute quark of the data set.
+ *  @return bool        \c false if the data set does not intern attributes
+ *                      (feature hashing).
+ */
+template <class quark_type>
+inline static bool
+start_attribute_index(attribute_index& index, const quark_type& attributes)
+{
+    for (size_t v = 0;v < (size_t)attributes.size();++v) {
+        index.associate(attributes.to_item(v));
+    }
+    return true;
+}
+
+template <class item_type>
+inline static bool
+start_attribute_index(
+    attribute_index& index,
+    const classias::hashed_quark_base<item_type>& attributes
+    )
+{
+    return false;
+}
+
+/**
+ * Publishes the attributes added to a data set since the last call.
+ *  @param  index       The attribute index.
+ *  @param  attributes  The attribute quark of the data set.
+ */
+template <class quark_type>
+inline static void
+publish_attributes(attribute_index& index, const quark_type& attributes)
+{
+    for (size_t v = index.size();v < (size_t)attributes.size();++v) {
+        index.associate(attributes.to_item(v));
+    }
+}
+
+template <class item_type>
+inline static void
+publish_attributes(
+    attribute_index& index,
+    const classias::hashed_quark_base<item_type>& attributes
+    )
+{
+}
+
+/**
+ * Looks up the identifiers of the attributes of a parsed line.
+ *  @param  p           The parsed line.
+ *  @param  index       The attribute index.
+ */
+inline static void
+find_attributes(parsed_line& p, const attribute_index& index)
+{
+    const attribute_index::value_type none = (attribute_index::value_type)-1;
+    p.attributes.resize(p.fields.size());
+    for (size_t i = 0;i < p.fields.size();++i) {
+        attribute_index::value_type v = index.to_value(p.fields[i].first, none);
+        p.attributes[i] = (v == none ? -1 : (int)v);
+    }
+}
+
+/**
+ * A receiver of instances while reading training data.
+ *  A reader calls stored() after storing every line. An implementation may
+ *  move the instances read so far out of the data set (e.g., to a cache
+ *  file) so that the data set holds a bounded number of instances; it must
+ *  leave the last instance, which may still receive lines, in the data set.
+ */
+class chunk_sink
+{
+public:
+    virtual ~chunk_sink()
+    {
+    }
+
+    /**
+     * Receives the instances after a line is stored.
+     */
+    virtual void stored() = 0;
+};
+
+/**
+ * A batch of consecutive lines in a stream.
+ */
+struct line_batch
+{
+    /// The lines (the first \c size elements are valid).
+    std::vector<parsed_line> items;
+    /// The number of lines in the batch.
+    size_t size;
+
+    line_batch() : size(0)
+    {
+    }
+};
+
+/**
+ * A stage of the pipeline reading training data.
+ *  The threads of the stages are started once (see classias::task_rounds),
+ *  and each round of the pipeline runs the three stages concurrently: the
+ *  reader fills a batch with the next lines from the stream, the parsers
+ *  process the lines of the previous batch, and the storer appends the
+ *  instances of the batch before the previous one to the data set. Only the storer
+ *  modifies the data set, in the order of lines, so that identifiers of
+ *  attributes and labels and the order of instances are the same as those
+ *  read by a single thread.
+ */
+template <class data_type>
+struct ingest_task
+{
+    enum {
+        READ = 0,
+        PARSE,
+        STORE
+    };
+
+    int role;
+    int index;
+    int num_parsers;
+    std::istream* is;
+    data_type* data;
+    const option* opt;
+    int group;
+    line_batch* batch;
+    int* lines;
+    bool* eof;
+    std::string* error;
+    chunk_sink* sink;
+    attribute_counts* counts;
+    attribute_index* names;
+    attribute_filter filter;
+
+    void run()
+    {
+        switch (role) {
+        case READ:
+            read();
+            break;
+        case PARSE:
+            parse();
+            break;
+        case STORE:
+            store();
+            break;
+        }
+    }
+
+protected:
+    void read()
+    {
+        const size_t n = batch->items.size();
+        batch->size = 0;
+        while (batch->size < n) {
+            parsed_line& p = batch->items[batch->size];
+            std::getline(*is, p.line);
+            if (is->eof()) {
+                *eof = true;
+                break;
+            }
+            p.lines = ++(*lines);
+            ++batch->size;
+        }
+    }
+
+    void parse()
+    {
+        for (size_t i = index;i < batch->size;i += num_parsers) {
+            parsed_line& p = batch->items[i];
+            try {
+                parse_line(p, *opt, filter, counts);
+                if (names != NULL && !p.skip && !p.directive) {
+                    find_attributes(p, *names);
+                }
+            } catch (const invalid_data& e) {
+                p.error = e.what();
+            }
+        }
+    }
+
+    void store()
+    {
+        try {
+            for (size_t i = 0;i < batch->size;++i) {
+                parsed_line& p = batch->items[i];
+                if (!p.error.empty()) {
+                    throw invalid_data(p.error);
+                }
+                if (!p.skip) {
+                    if (counts != NULL && counts->online) {
+                        count_line(p, *opt, *counts);
+                    }
+                    store_line(*data, p, *opt, group);
+                    if (names != NULL) {
+                        publish_attributes(*names, data->attributes);
+                    }
+                    if (sink != NULL) {
+                        sink->stored();
+                    }
+                }
+            }
+        } catch (const std::exception& e) {
+            *error = e.what();
+        }
+    }
+};
+
+/**
+ * Reads the lines of training data from a stream.
+ *  If the option read_threads is greater than one, the lines are read,
+ *  parsed, and stored by a pipeline of threads (see ingest_task).
+ *  @param  is          The input stream.
+ *  @param  data        The data set.
+ *  @param  opt         The options.
+ *  @param  group       The group number of the instances.
+ *  @param  sink        The receiver of the instances stored, or \c NULL.
+ *  @param  counts      The frequencies of attributes for the option
+ *                      min_count, or \c NULL.
+ */
+template <class data_type>
+static void
+read_lines(
+    std::istream& is,
+    data_type& data,
+    const option& opt,
+    int group,
+    chunk_sink* sink = NULL,
+    attribute_counts* counts = NULL
+    )
+{
+    int lines = 0;
+
+    if (opt.read_threads <= 1) {
+        parsed_line p;
+        attribute_filter filter;
+        for (;;) {
+            // Read a line.
+            std::getline(is, p.line);
+            if (is.eof()) {
+                break;
+            }
+            p.lines = ++lines;
+
+            // Parse and store the line.
+            parse_line(p, opt, filter, counts);
+            if (!p.skip) {
+                if (counts != NULL && counts->online) {
+                    count_line(p, opt, *counts);
+                }
+                store_line(data, p, opt, group);
+                if (sink != NULL) {
+                    sink->stored();
+                }
+            }
+        }
+        return;
+    }
+
+    typedef ingest_task<data_type> task_type;
+    const int num_parsers = opt.read_threads;
+    bool eof = false;
+    std::string error;
+    line_batch batches[3];
+    for (int k = 0;k < 3;++k) {
+        batches[k].items.resize(INGEST_BATCH_LINES);
+    }
+
+    // Share the attributes of the data set with the parsers.
+    attribute_index names;
+    const bool indexed = start_attribute_index(names, data.attributes);
+
+    line_batch none;
+    std::vector<task_type> tasks(num_parsers + 2);
+    for (size_t j = 0;j < tasks.size();++j) {
+        tasks[j].role = task_type::PARSE;
+        tasks[j].index = (int)j - 1;
+        tasks[j].num_parsers = num_parsers;
+        tasks[j].is = &is;
+        tasks[j].data = &data;
+        tasks[j].opt = &opt;
+        tasks[j].group = group;
+        tasks[j].lines = &lines;
+        tasks[j].eof = &eof;
+        tasks[j].error = &error;
+        tasks[j].sink = sink;
+        tasks[j].counts = counts;
+        tasks[j].names = (indexed ? &names : NULL);
+    }
+    tasks.front().role = task_type::STORE;
+    tasks.back().role = task_type::READ;
+
+    // Start the threads of the stages once for all the rounds.
+    classias::task_rounds<task_type> rounds(tasks);
+
+    // The batch #k is read, parsed, and stored at the rounds k, k+1, and
+    // k+2, respectively, until the batch #last that hits the end of stream
+    // goes through the pipeline. A stage without a batch works on an empty
+    // one.
+    for (int k = 0, last = -1;last < 0 || k <= last + 2;++k) {
+        line_batch* r = (last < 0 ? &batches[k % 3] : &none);
+        line_batch* p = ((1 <= k && (last < 0 || k - 1 <= last)) ? &batches[(k - 1) % 3] : &none);
+        line_batch* s = ((2 <= k && (last < 0 || k - 2 <= last)) ? &batches[(k - 2) % 3] : &none);
+
+        for (size_t j = 0;j < tasks.size();++j) {
+            switch (tasks[j].role) {
+            case task_type::READ:   tasks[j].batch = r;   break;
+            case task_type::PARSE:  tasks[j].batch = p;   break;
+            case task_type::STORE:  tasks[j].batch = s;   break;
+            }
+        }
+
+        rounds.run();
+        if (!error.empty()) {
+            throw invalid_data(error);
+        }
+        if (last < 0 && eof) {
+            last = k;
+        }
+    }
+}
+
+#endif/*__INGEST_H__*/
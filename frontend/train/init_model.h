@@ -0,0 +1,187 @@
+/*
+ *		Reader of a previous model for initializing the weights.
+ *
+ * Copyright (c) 2008,2009 Naoaki Okazaki
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the names of the authors nor the names of its contributors
+ *       may be used to endorse or promote products derived from this
+ *       software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* $Id$ */
+
+#ifndef __INIT_MODEL_H__
+#define __INIT_MODEL_H__
+
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <util.h>
+#include <model_file.h>
+
+/**
+ * A weight of a previous model with its attribute and label names.
+ */
+struct model_weight
+{
+    /// The attribute name.
+    std::string attribute;
+    /// The label name (empty for binary and candidate models).
+    std::string label;
+    /// The weight.
+    double weight;
+};
+
+/**
+ * A previous model read for initializing the weights of training.
+ *  This class reads the weights of a model stored by classias-train in the
+ *  text or compiled format, with the names of the attributes and labels so
+ *  that the weights can be associated with the identifiers of a new data
+ *  set.
+ */
+class init_model
+{
+public:
+    /// The weights of the model.
+    std::vector<model_weight> weights;
+    /// The number of bits of the hashed attributes (0 if not hashed, or
+    /// -1 if unknown to a compiled model).
+    int hash_bits;
+
+    init_model() : hash_bits(0)
+    {
+    }
+
+    /**
+     * Reads a model.
+     *  @param  filename    The file name of the model.
+     *  @param  type        The model type expected (MODEL_FILE_*).
+     */
+    void read(const std::string& filename, int type)
+    {
+        weights.clear();
+        hash_bits = 0;
+
+        model_file mf;
+        if (mf.open(filename)) {
+            this->read_compiled(mf, filename, type);
+            return;
+        }
+
+        std::ifstream ifs(filename.c_str());
+        if (ifs.fail()) {
+            throw invalid_model("cannot open the initial model", filename);
+        }
+        this->read_text(ifs, type);
+    }
+
+protected:
+    void read_compiled(const model_file& mf, const std::string& filename, int type)
+    {
+        if (!same_type(mf.type(), type)) {
+            throw invalid_model("the initial model is of a different task type", filename);
+        }
+
+        // The attribute names of a compiled model do not tell the hashing.
+        hash_bits = -1;
+        for (int a = 0;a < mf.num_attributes();++a) {
+            const std::string attr = mf.attribute(a);
+            for (size_t k = mf.row_begin(a);k < mf.row_end(a);++k) {
+                model_weight e;
+                e.attribute = attr;
+                if (0 < mf.num_labels()) {
+                    e.label = mf.label(mf.row_label(k));
+                }
+                e.weight = mf.row_weight(k);
+                weights.push_back(e);
+            }
+        }
+    }
+
+    void read_text(std::istream& is, int type)
+    {
+        std::string line;
+        std::getline(is, line);
+        if (line.compare(0, 17, "@classias\tlinear\t") != 0) {
+            throw invalid_model("the initial model is not a linear model", line);
+        }
+        const std::string name = line.substr(17, line.find('\t', 17) - 17);
+        const bool multi = (name == "multi");
+        if ((name == "binary" && type != MODEL_FILE_BINARY) ||
+            (name == "candidate" && type != MODEL_FILE_CANDIDATE) ||
+            (multi && type != MODEL_FILE_MULTI_SPARSE && type != MODEL_FILE_MULTI_DENSE) ||
+            (name != "binary" && name != "candidate" && !multi)) {
+            throw invalid_model("the initial model is of a different task type", line);
+        }
+
+        for (;;) {
+            std::getline(is, line);
+            if (is.eof()) {
+                break;
+            }
+
+            // Declarations: the hashing of attributes, labels, etc.
+            if (line.compare(0, 6, "@hash\t") == 0) {
+                hash_bits = std::atoi(line.c_str() + 6);
+                continue;
+            }
+            if (line.compare(0, 1, "@") == 0) {
+                continue;
+            }
+
+            // A weight line: "WEIGHT\tATTRIBUTE[\tLABEL]".
+            std::string::size_type pos = line.find('\t');
+            if (pos == line.npos || ++pos == line.size()) {
+                throw invalid_model("feature name is missing", line);
+            }
+            model_weight e;
+            e.weight = std::atof(line.c_str());
+            if (multi) {
+                std::string::size_type lpos = line.rfind('\t');
+                if (lpos < pos) {
+                    throw invalid_model("label is missing", line);
+                }
+                e.attribute = line.substr(pos, lpos - pos);
+                e.label = line.substr(lpos + 1);
+            } else {
+                e.attribute = line.substr(pos);
+            }
+            weights.push_back(e);
+        }
+    }
+
+    static bool same_type(int x, int y)
+    {
+        // Dense and sparse multi-class models share the feature space.
+        if (x == MODEL_FILE_MULTI_DENSE) {
+            x = MODEL_FILE_MULTI_SPARSE;
+        }
+        if (y == MODEL_FILE_MULTI_DENSE) {
+            y = MODEL_FILE_MULTI_SPARSE;
+        }
+        return (x == y);
+    }
+};
+
+#endif/*__INIT_MODEL_H__*/
@@ -34,17 +34,24 @@
 #include <config.h>
 #endif/*HAVE_CONFIG_H*/
 
+#include <algorithm>
 #include <cstdlib>
 #include <fstream>
+#include <functional>
 #include <iostream>
 #include <map>
+#include <sstream>
 #include <string>
 #include <typeinfo>
+#include <utility>
+#include <vector>
 #include <classias/version.h>
 #include <optparse.h>
 #include <tokenize.h>
+#include <util.h>
 
 #include "option.h"
+#include "allreduce.h"
 
 int binary_train(option& opt);
 int multi_train(option& opt);
@@ -66,6 +73,11 @@ public:
         // Build synsets for algorithms.
         m_algorithms["lbfgs.logistic"]              = "lbfgs.logistic";
         m_algorithms["lbfgs"]                       = "lbfgs.logistic";
+        m_algorithms["svrg.logistic"]               = "svrg.logistic";
+        m_algorithms["svrg"]                        = "svrg.logistic";
+        m_algorithms["dcd.logistic"]                = "dcd.logistic";
+        m_algorithms["dcd.hinge"]                   = "dcd.hinge";
+        m_algorithms["dcd.svm"]                     = "dcd.hinge";
         m_algorithms["averaged_perceptron"]         = "averaged_perceptron";
         m_algorithms["ap"]                          = "averaged_perceptron";
         m_algorithms["pegasos.logistic"]            = "pegasos.logistic";
@@ -78,6 +90,73 @@ public:
         m_algorithms["tg.svm"]                      = "truncated_gradient.hinge";
     }
 
+    /**
+     * Parses the regularization path of --sweep (NAME=VALUE,VALUE,...).
+     *  The values are sorted from the strongest to the weakest
+     *  regularization, i.e., in the descending order.
+     *  @param  arg         The argument of the option.
+     */
+    void parse_sweep(const char *arg)
+    {
+        std::string str(arg);
+        std::string::size_type pos = str.find('=');
+        if (pos == str.npos) {
+            throw invalid_value("the sweep must be NAME=VALUE,VALUE,...");
+        }
+        sweep_name = str.substr(0, pos);
+        if (sweep_name != "c1" && sweep_name != "c2") {
+            std::stringstream ss;
+            ss << "only c1 or c2 can be swept: " << sweep_name;
+            throw invalid_value(ss.str());
+        }
+
+        std::vector<std::pair<double, std::string> > points;
+        while (pos != str.npos) {
+            std::string::size_type next = str.find(',', pos+1);
+            std::string value = str.substr(
+                pos+1, (next == str.npos ? str.npos : next-pos-1));
+            char *end = NULL;
+            double v = std::strtod(value.c_str(), &end);
+            if (value.empty() || *end != 0 || v < 0) {
+                std::stringstream ss;
+                ss << "the values of a sweep must be non-negative numbers: " << value;
+                throw invalid_value(ss.str());
+            }
+            points.push_back(std::make_pair(v, value));
+            pos = next;
+        }
+        std::stable_sort(
+            points.begin(), points.end(),
+            std::greater<std::pair<double, std::string> >());
+
+        sweep_values.clear();
+        for (size_t i = 0;i < points.size();++i) {
+            sweep_values.push_back(points[i].second);
+        }
+    }
+
+    /**
+     * Parses the list of --memory-fallback (STEP,STEP,...).
+     *  @param  arg         The argument of the option.
+     */
+    void parse_memory_fallbacks(const char *arg)
+    {
+        std::string str(arg);
+        memory_fallbacks.clear();
+        for (std::string::size_type pos = 0;pos != str.npos;) {
+            std::string::size_type next = str.find(',', pos);
+            std::string step = str.substr(
+                pos, (next == str.npos ? str.npos : next-pos));
+            if (step != "min-count" && step != "hash" && step != "stream") {
+                std::stringstream ss;
+                ss << "unknown memory fallback specified: " << step;
+                throw invalid_value(ss.str());
+            }
+            memory_fallbacks.push_back(step);
+            pos = (next == str.npos ? next : next+1);
+        }
+    }
+
     BEGIN_OPTION_MAP_INLINE()
         ON_OPTION_WITH_ARG(SHORTOPT('t') || LONGOPT("type"))
             if (strcmp(arg, "binary") == 0 || strcmp(arg, "b") == 0) {
@@ -107,6 +186,29 @@ public:
         ON_OPTION_WITH_ARG(SHORTOPT('p') || LONGOPT("set"))
             params.push_back(arg);
 
+        ON_OPTION_WITH_ARG(LONGOPT("sweep"))
+            this->parse_sweep(arg);
+
+        ON_OPTION_WITH_ARG(LONGOPT("init-model"))
+            init_model = arg;
+
+        ON_OPTION_WITH_ARG(LONGOPT("checkpoint"))
+            checkpoint = arg;
+            if (checkpoint.empty()) {
+                throw invalid_value("no directory specified for checkpoints");
+            }
+
+        ON_OPTION_WITH_ARG(LONGOPT("checkpoint-every"))
+            checkpoint_every = atoi(arg);
+            if (checkpoint_every < 1) {
+                std::stringstream ss;
+                ss << "the interval of checkpoints must be positive: " << arg;
+                throw invalid_value(ss.str());
+            }
+
+        ON_OPTION(LONGOPT("resume"))
+            resume = true;
+
         ON_OPTION(SHORTOPT('f') || LONGOPT("shuffle"))
             shuffle = true;
 
@@ -116,6 +218,32 @@ public:
         ON_OPTION_WITH_ARG(SHORTOPT('m') || LONGOPT("model"))
             model = arg;
 
+        ON_OPTION_WITH_ARG(LONGOPT("model-format"))
+            if (strcmp(arg, "text") == 0 || strcmp(arg, "t") == 0) {
+                model_format = MODEL_FORMAT_TEXT;
+            } else if (strcmp(arg, "binary") == 0 || strcmp(arg, "b") == 0) {
+                model_format = MODEL_FORMAT_BINARY;
+            } else {
+                std::stringstream ss;
+                ss << "unknown model format specified: " << arg;
+                throw invalid_value(ss.str());
+            }
+
+        ON_OPTION_WITH_ARG(LONGOPT("weight-type"))
+            if (strcmp(arg, "double") == 0) {
+                weight_type = WEIGHT_DOUBLE;
+            } else if (strcmp(arg, "float") == 0) {
+                weight_type = WEIGHT_FLOAT;
+            } else if (strcmp(arg, "int16") == 0) {
+                weight_type = WEIGHT_INT16;
+            } else if (strcmp(arg, "int8") == 0) {
+                weight_type = WEIGHT_INT8;
+            } else {
+                std::stringstream ss;
+                ss << "unknown weight type specified: " << arg;
+                throw invalid_value(ss.str());
+            }
+
         ON_OPTION_WITH_ARG(SHORTOPT('g') || LONGOPT("split"))
             split = atoi(arg);
 
@@ -134,12 +262,152 @@ public:
         ON_OPTION_WITH_ARG(SHORTOPT('n') || LONGOPT("negative"))
             negative_labels.insert(arg);
 
+        ON_OPTION_WITH_ARG(LONGOPT("cv-jobs"))
+            cv_jobs = atoi(arg);
+            if (cv_jobs < 1) {
+                std::stringstream ss;
+                ss << "the number of cross-validation jobs must be positive: " << arg;
+                throw invalid_value(ss.str());
+            }
+
+        ON_OPTION_WITH_ARG(LONGOPT("holdout-threads"))
+            holdout_threads = atoi(arg);
+            if (holdout_threads < 1) {
+                std::stringstream ss;
+                ss << "the number of holdout threads must be positive: " << arg;
+                throw invalid_value(ss.str());
+            }
+
+        ON_OPTION_WITH_ARG(LONGOPT("holdout-sample"))
+            holdout_sample = atoi(arg);
+            if (holdout_sample < 1) {
+                std::stringstream ss;
+                ss << "the holdout sample size must be positive: " << arg;
+                throw invalid_value(ss.str());
+            }
+
+        ON_OPTION_WITH_ARG(LONGOPT("holdout-interval"))
+            holdout_interval = atoi(arg);
+            if (holdout_interval < 1) {
+                std::stringstream ss;
+                ss << "the holdout interval must be positive: " << arg;
+                throw invalid_value(ss.str());
+            }
+
         ON_OPTION(SHORTOPT('l') || LONGOPT("log-to-file"))
             logfile = true;
 
         ON_OPTION_WITH_ARG(SHORTOPT('L') || LONGOPT("logbase"))
             logbase = arg;
 
+        ON_OPTION_WITH_ARG(LONGOPT("cache"))
+            cache = arg;
+
+        ON_OPTION(LONGOPT("csr"))
+            csr = true;
+
+        ON_OPTION(LONGOPT("compress"))
+            csr = true;
+            compress = true;
+
+        ON_OPTION_WITH_ARG(LONGOPT("hash-bits"))
+            hash_bits = atoi(arg);
+            if (hash_bits < 1 || 30 < hash_bits) {
+                std::stringstream ss;
+                ss << "the number of hash bits must be in [1, 30]: " << arg;
+                throw invalid_value(ss.str());
+            }
+
+        ON_OPTION(LONGOPT("hash-signed"))
+            hash_signed = true;
+
+        ON_OPTION_WITH_ARG(LONGOPT("min-count"))
+            min_count = atoi(arg);
+            if (min_count < 1) {
+                std::stringstream ss;
+                ss << "the minimum count of attributes must be positive: " << arg;
+                throw invalid_value(ss.str());
+            }
+
+        ON_OPTION(LONGOPT("stream"))
+            stream = true;
+
+        ON_OPTION(LONGOPT("dedup"))
+            dedup = true;
+
+        ON_OPTION(LONGOPT("renumber"))
+            renumber = true;
+
+        ON_OPTION_WITH_ARG(LONGOPT("metrics"))
+            metrics = arg;
+
+        ON_OPTION_WITH_ARG(LONGOPT("max-memory"))
+            if (!classias::parse_memory_size(arg, max_memory) || max_memory <= 0.) {
+                std::stringstream ss;
+                ss << "the memory limit must be a positive size: " << arg;
+                throw invalid_value(ss.str());
+            }
+
+        ON_OPTION_WITH_ARG(LONGOPT("memory-fallback"))
+            parse_memory_fallbacks(arg);
+
+        ON_OPTION_WITH_ARG(LONGOPT("huge-pages"))
+            if (!classias::parse_huge_pages(memory, arg)) {
+                std::stringstream ss;
+                ss << "unknown size of huge pages specified: " << arg;
+                throw invalid_value(ss.str());
+            }
+            if (!classias::memory_policy::huge_pages_supported()) {
+                throw invalid_value("huge pages are not supported in this build");
+            }
+
+        ON_OPTION_WITH_ARG(LONGOPT("numa"))
+            if (!classias::parse_numa_policy(memory, arg)) {
+                std::stringstream ss;
+                ss << "unknown NUMA policy specified: " << arg;
+                throw invalid_value(ss.str());
+            }
+            if (memory.numa != classias::memory_policy::NUMA_LOCAL &&
+                !classias::memory_policy::numa_supported()) {
+                throw invalid_value("NUMA policies are not supported on this system");
+            }
+            if (memory.numa == classias::memory_policy::NUMA_BIND &&
+                classias::memory_policy::num_nodes() <= memory.node) {
+                std::stringstream ss;
+                ss << "no such NUMA node: " << memory.node;
+                throw invalid_value(ss.str());
+            }
+
+        ON_OPTION_WITH_ARG(LONGOPT("stream-block"))
+            stream_block = atoi(arg);
+            if (stream_block < 1) {
+                std::stringstream ss;
+                ss << "the number of instances in a block must be positive: " << arg;
+                throw invalid_value(ss.str());
+            }
+
+        ON_OPTION_WITH_ARG(LONGOPT("distribute"))
+            distribute = arg;
+            if (distribute.empty()) {
+                throw invalid_value("no rank specified for distributed training");
+            }
+
+        ON_OPTION_WITH_ARG(LONGOPT("rank"))
+            rank = atoi(arg);
+            if (rank < 0) {
+                std::stringstream ss;
+                ss << "the rank must be non-negative: " << arg;
+                throw invalid_value(ss.str());
+            }
+
+        ON_OPTION_WITH_ARG(LONGOPT("read-threads"))
+            read_threads = atoi(arg);
+            if (read_threads < 1) {
+                std::stringstream ss;
+                ss << "the number of threads for reading data must be positive: " << arg;
+                throw invalid_value(ss.str());
+            }
+
         ON_OPTION_WITH_ARG(SHORTOPT('s') || LONGOPT("token-separator"))
             if (strcmp(arg, " ") == 0 || strcasecmp(arg, "s") == 0 || strcasecmp(arg, "spc") == 0 || strcasecmp(arg, "space") == 0) {
                 token_separator = ' ';
@@ -175,6 +443,67 @@ public:
     END_OPTION_MAP()
 };
 
+/**
+ * Applies the next fallback of --memory-fallback to the options.
+ *  The fallbacks that are not applicable to the options are skipped.
+ *  @param  opt         The options.
+ *  @param  e           The exception of the memory limit.
+ *  @param  k           The index of the next fallback, which is advanced.
+ *  @return bool        \c true if a fallback is applied, \c false if no
+ *                      fallback remains.
+ */
+static bool
+apply_memory_fallback(option& opt, const memory_exceeded& e, size_t& k)
+{
+    std::ostream& os = *opt.os;
+
+    // STDIN cannot be read again.
+    if (opt.files.empty()) {
+        return false;
+    }
+
+    while (k < opt.memory_fallbacks.size()) {
+        const std::string& step = opt.memory_fallbacks[k++];
+        std::stringstream ss;
+
+        if (step == "min-count") {
+            opt.min_count = std::max(2, 2 * opt.min_count);
+            ss << "--min-count=" << opt.min_count;
+        } else if (step == "hash") {
+            if (0 < opt.hash_bits ||
+                opt.type == option::TYPE_MULTI_SPARSE ||
+                opt.model_format == option::MODEL_FORMAT_BINARY ||
+                !opt.init_model.empty() || opt.renumber) {
+                continue;
+            }
+            // Use as many buckets as the attributes read so far.
+            int bits = 16;
+            while (bits < 24 && ((size_t)1 << bits) < e.attributes) {
+                ++bits;
+            }
+            opt.hash_bits = bits;
+            ss << "--hash-bits=" << opt.hash_bits;
+        } else if (step == "stream") {
+            if (opt.stream || opt.cache.empty() || opt.shuffle || opt.dedup ||
+                opt.algorithm.compare(0, 6, "lbfgs.") == 0 ||
+                opt.algorithm.compare(0, 4, "dcd.") == 0 ||
+                0 < opt.holdout_sample || !opt.init_model.empty() ||
+                !opt.sweep_values.empty() || !opt.distribute.empty()) {
+                continue;
+            }
+            opt.stream = true;
+            ss << "--stream";
+        }
+
+        os << std::endl;
+        os << "Memory limit exceeded (" << e.bytes / 1048576. << " MB); ";
+        os << "reading the data set again with " << ss.str() << std::endl;
+        os << std::endl;
+        return true;
+    }
+    return false;
+}
+
 static void usage(std::ostream& os, const char *argv0)
 {
     os << "USAGE: " << argv0 << " [OPTIONS] [DATA1] [DATA2] ..." << std::endl;
@@ -183,9 +512,11 @@ static void usage(std::ostream& os, const char *argv0)
     os << "  DATA    file(s) corresponding to data set(s) for training; if multiple N files" << std::endl;
     os << "          are specified, this utility assigns a group number (1...N) to the" << std::endl;
     os << "          instances in each file if no file is specified, the utility reads a" << std::endl;
-    os << "          data set from STDIN; if a file name has an extension '.gz', '.bz2'," << std::endl;
-    os << "          and '.xz', the utility uses 'gzip', 'bzip2', and 'xv' to decompress" << std::endl;
-    os << "          the input file" << std::endl;
+    os << "          data set from STDIN; a file (or STDIN) compressed by gzip, bzip2, xz," << std::endl;
+    os << "          or zstd is decompressed in the process (by an external 'gzip'," << std::endl;
+    os << "          'bzip2', 'xz', or 'zstd' command if the library is not built in);" << std::endl;
+    os << "          with --read-threads=N, N threads decompress the members of a gzip" << std::endl;
+    os << "          file by bgzip, or the frames of a zstd file, concurrently" << std::endl;
     os << std::endl;
     os << "OPTIONS:" << std::endl;
     os << "  -t, --type=TYPE       specify a task type (DEFAULT='multi-dense'):" << std::endl;
@@ -201,10 +532,16 @@ static void usage(std::ostream& os, const char *argv0)
     os << "      c, candidate          an instance begins with a directive line '@boi'" << std::endl;
     os << "                            followed by lines that correspond to multiple" << std::endl;
     os << "                            candidates for the instance; a candidate line" << std::endl;
-    os << "                            consists of a class label and features; an instance" << std::endl;
-    os << "                            ends with a directive line '@eoi'" << std::endl;
+    os << "                            consists of a class label and features; a line" << std::endl;
+    os << "                            '@shared' lists features shared by all candidates;" << std::endl;
+    os << "                            an instance ends with a directive line '@eoi'" << std::endl;
     os << "  -a, --algorithm=NAME  specify a training algorithm (DEFAULT='lbfgs.logistic')" << std::endl;
     os << "      lbfgs.logistic        L1/L2-regularized logistic regression (LR) by L-BFGS" << std::endl;
+    os << "      svrg.logistic         L2-regularized LR by stochastic variance reduced" << std::endl;
+    os << "                            gradient (SVRG) for large data sets" << std::endl;
+    os << "      dcd.logistic          L2-regularized LR by dual coordinate descent" << std::endl;
+    os << "      dcd.hinge             L2-regularized linear L1-loss SVM by dual coordinate" << std::endl;
+    os << "                            descent" << std::endl;
     os << "      averaged_perceptron   averaged perceptron" << std::endl;
     os << "      pegasos.logistic      L2-regularized LR by Pegasos" << std::endl;
     os << "      pegasos.hinge         L2-regularized linear L1-loss SVM by Pegasos" << std::endl;
@@ -217,20 +554,131 @@ static void usage(std::ostream& os, const char *argv0)
     os << "                        specified by '-a' or '--algorithm' and the task type" << std::endl;
     os << "                        specified by '-t' or '--type' to see the list of the" << std::endl;
     os << "                        algorithm-specific parameters" << std::endl;
+    os << "      --sweep=NAME=VALUE,..." << std::endl;
+    os << "                        train a model for every VALUE of the regularization" << std::endl;
+    os << "                        coefficient NAME (c1 or c2) of lbfgs.logistic from" << std::endl;
+    os << "                        the largest VALUE; every training starts from the" << std::endl;
+    os << "                        weights of the previous one, and the model is stored" << std::endl;
+    os << "                        to FILE.NAME=VALUE for the model FILE (-m)" << std::endl;
+    os << "      --init-model=FILE start the training from the weights of the model FILE" << std::endl;
+    os << "                        (in the text or binary format) whose attributes and" << std::endl;
+    os << "                        labels appear in the data; use it with a small" << std::endl;
+    os << "                        '-p max_iterations=N' to update a model on new data" << std::endl;
+    os << "      --checkpoint=DIR  store the state of the training to DIR/checkpoint" << std::endl;
+    os << "                        after every N-th iteration (--checkpoint-every) by a" << std::endl;
+    os << "                        background thread; an online algorithm stores its" << std::endl;
+    os << "                        state and the iteration, and L-BFGS stores the weights" << std::endl;
+    os << "      --checkpoint-every=N store a checkpoint after every N-th iteration" << std::endl;
+    os << "                        (DEFAULT=1)" << std::endl;
+    os << "      --resume          continue the training from DIR/checkpoint (if any) with" << std::endl;
+    os << "                        the same options and data files; an online algorithm" << std::endl;
+    os << "                        (with num_threads=1) continues as if it had not been" << std::endl;
+    os << "                        stopped, and L-BFGS restarts from the stored weights" << std::endl;
+    os << "                        with a new approximation of the inverse hessian;" << std::endl;
+    os << "                        '-p max_iterations=N' may be raised for resuming" << std::endl;
     os << "  -f, --shuffle         shuffle (reorder) instances in the data" << std::endl;
     os << "  -b, --bias=VALUE      insert bias features with their values VALUE" << std::endl;
     os << "  -m, --model=FILE      store the model to FILE (DEFAULT=''); if the value is" << std::endl;
     os << "                        empty, this utility does not store the model" << std::endl;
+    os << "      --model-format=FORMAT store the model in FORMAT (DEFAULT='text'):" << std::endl;
+    os << "      t, text               a text file with a feature weight on each line" << std::endl;
+    os << "      b, binary             a compiled model that classias-tag maps to the" << std::endl;
+    os << "                            memory without parsing" << std::endl;
+    os << "      --weight-type=TYPE store the weights of a compiled model in TYPE" << std::endl;
+    os << "                        (DEFAULT='double'):" << std::endl;
+    os << "      double                double precision" << std::endl;
+    os << "      float                 single precision" << std::endl;
+    os << "      int16, int8           16/8-bit integers with a scale for every block of" << std::endl;
+    os << "                            64 weights" << std::endl;
     os << "  -g, --split=N         split the instances into N groups; this option is" << std::endl;
     os << "                        useful for holdout evaluation and cross validation" << std::endl;
     os << "  -e, --holdout=M       use the M-th data for holdout evaluation and the rest" << std::endl;
     os << "                        for training" << std::endl;
     os << "  -x, --cross-validate  repeat holdout evaluations for #i in {1, ..., N}" << std::endl;
     os << "                        (N-fold cross validation)" << std::endl;
+    os << "      --cv-jobs=N       train N folds of cross validation concurrently; the" << std::endl;
+    os << "                        log of each fold is printed in the order of folds;" << std::endl;
+    os << "                        with N>1, each fold samples instances at random from" << std::endl;
+    os << "                        its own sequence, so the models do not depend on N" << std::endl;
+    os << "                        (N>1) but differ from those of N=1 (DEFAULT=1)" << std::endl;
+    os << "      --holdout-threads=N evaluate the holdout instances with N threads" << std::endl;
+    os << "      --holdout-sample=N evaluate only N holdout instances chosen at random" << std::endl;
+    os << "                        (the same instances in every iteration)" << std::endl;
+    os << "      --holdout-interval=N run a holdout evaluation after every N-th iteration" << std::endl;
+    os << "                        (and after the last iteration allowed)" << std::endl;
     os << "  -l, --log-to-file     write the training log to a file instead of to STDOUT;" << std::endl;
     os << "                        The filename is determined automatically by the training" << std::endl;
     os << "                        algorithm, parameters, and source files" << std::endl;
     os << "  -L, --logbase=BASE    set the base name for a log file (used with -l option)" << std::endl;
+    os << "      --metrics=FILE    write the training metrics (wall-clock and CPU times" << std::endl;
+    os << "                        of phases, throughput, and peak memory) to FILE in" << std::endl;
+    os << "                        JSON lines; a rank R > 0 of --distribute writes to" << std::endl;
+    os << "                        FILE.R" << std::endl;
+    os << "      --cache=FILE      read the data set from the binary cache FILE if it is" << std::endl;
+    os << "                        up to date with the data files and options, or store" << std::endl;
+    os << "                        the data set to FILE after reading the data files;" << std::endl;
+    os << "                        if no data file is specified, the cache is used as is" << std::endl;
+    os << "      --csr             store binary instances in flat arrays (compressed" << std::endl;
+    os << "                        sparse rows) to save memory; only for '-t b'" << std::endl;
+    os << "      --compress        store binary instances with --csr, sorting and" << std::endl;
+    os << "                        delta-encoding the attributes of each instance" << std::endl;
+    os << "                        (stream-vbyte) and rounding the values to single" << std::endl;
+    os << "                        precision; only for '-t b'" << std::endl;
+    os << "      --hash-bits=B     map attributes to 2^B buckets by a hash function" << std::endl;
+    os << "                        instead of storing their names (feature hashing);" << std::endl;
+    os << "                        not for '-t n' and the binary model format" << std::endl;
+    os << "      --hash-signed     multiply attribute values by signs from the hash" << std::endl;
+    os << "                        function to reduce the bias of collisions" << std::endl;
+    os << "      --min-count=N     drop attributes occurring less than N times in the" << std::endl;
+    os << "                        data files before they are stored; the occurrences" << std::endl;
+    os << "                        are counted in a first pass over the files by a" << std::endl;
+    os << "                        count-min sketch, or while reading STDIN (an" << std::endl;
+    os << "                        attribute is then kept from its N-th occurrence)" << std::endl;
+    os << "      --dedup           merge the instances that have the same group, label," << std::endl;
+    os << "                        and attributes into one whose weight is the sum of" << std::endl;
+    os << "                        their weights" << std::endl;
+    os << "      --renumber        renumber the attributes in descending order of their" << std::endl;
+    os << "                        frequencies after reading the data set so that the" << std::endl;
+    os << "                        weights of frequent attributes are close in memory;" << std::endl;
+    os << "                        the model file does not change" << std::endl;
+    os << "      --stream          train an online algorithm on blocks of instances read" << std::endl;
+    os << "                        from the cache file (--cache) in every iteration" << std::endl;
+    os << "                        instead of holding the data set in memory" << std::endl;
+    os << "      --stream-block=N  load N instances in memory at a time with --stream" << std::endl;
+    os << "                        (DEFAULT=65536)" << std::endl;
+    os << "      --max-memory=SIZE stop reading the data set when the instances, the" << std::endl;
+    os << "                        string tables, and the features use more than SIZE" << std::endl;
+    os << "                        bytes (with a suffix K, M, G, or T)" << std::endl;
+    os << "      --memory-fallback=STEP,..." << std::endl;
+    os << "                        read the data set again with a cheaper representation" << std::endl;
+    os << "                        when --max-memory is exceeded, trying the steps in" << std::endl;
+    os << "                        order instead of failing:" << std::endl;
+    os << "      min-count             double the minimum count of attributes (--min-count)" << std::endl;
+    os << "      hash                  hash the attributes read so far (--hash-bits)" << std::endl;
+    os << "      stream                train on blocks of the cache file (--stream)" << std::endl;
+    os << "      --distribute=HOST:PORT,..." << std::endl;
+    os << "                        train on the ranks listening on the list of addresses," << std::endl;
+    os << "                        each of which reads the data files of its own;" << std::endl;
+    os << "                        the loss and gradients of L-BFGS are summed over the" << std::endl;
+    os << "                        ranks, and the models of online algorithms are mixed" << std::endl;
+    os << "                        after every epoch (-p mixing=uniform|updates);" << std::endl;
+    os << "                        the rank 0 reports the progress (with the" << std::endl;
+    os << "                        holdout evaluation on its files) and stores the model;" << std::endl;
+    os << "                        requires --hash-bits and '-t b' or '-t c'" << std::endl;
+    os << "      --rank=R          the index of this process in the list of --distribute" << std::endl;
+    os << "      --read-threads=N  parse the data files with N threads while a thread" << std::endl;
+    os << "                        reads lines and another one stores instances" << std::endl;
+    os << "      --huge-pages=MODE back the large memory blocks (the weights, the data" << std::endl;
+    os << "                        set, and the gradient buffers) with huge pages:" << std::endl;
+    os << "      none                  the page size of the system (DEFAULT)" << std::endl;
+    os << "      transparent           transparent huge pages" << std::endl;
+    os << "      2mb, 1gb              explicit huge pages reserved in the system, falling" << std::endl;
+    os << "                            back to transparent huge pages" << std::endl;
+    os << "      --numa=POLICY     place the large memory blocks on NUMA nodes by POLICY:" << std::endl;
+    os << "      local                 the node of the thread touching a page first; the" << std::endl;
+    os << "                            threads allocate their own buffers (DEFAULT)" << std::endl;
+    os << "      interleave            interleave the pages over all nodes" << std::endl;
+    os << "      bind:N                bind the pages to the node N" << std::endl;
 #if     defined(HAVE_REGEX) || defined(HAVE_BOOST_REGEX_HPP)
     os << "  -F, --filter=REGEX    filter attributes whose names are matched by REGEX" << std::endl;
 #endif/*defined(HAVE_REGEX) || defined(HAVE_BOOST_REGEX_HPP)*/
@@ -266,7 +714,11 @@ int main(int argc, char *argv[])
     int ret = 0;
     int arg_used = 0;
     optionparser opt;
-    std::istream& is = *opt.is;
+
+    // Do not synchronize the standard streams with C stdio so that the
+    // decompressor reads the bytes of STDIN in blocks.
+    std::ios::sync_with_stdio(false);
+
     std::ostream& os = *opt.os;
     std::ostream& es = *opt.es;
     std::ofstream ofs;
@@ -285,6 +737,159 @@ int main(int argc, char *argv[])
         return 1;
     }
 
+    // The flat storage is implemented only for binary instances.
+    if (opt.csr && opt.type != option::TYPE_BINARY) {
+        es << "ERROR: " << (opt.compress ? "--compress" : "--csr") << " is supported only for binary classification" << std::endl;
+        return 1;
+    }
+
+    // Only compiled models store the weights in the compact types.
+    if (opt.weight_type != option::WEIGHT_DOUBLE && opt.model_format != option::MODEL_FORMAT_BINARY) {
+        es << "ERROR: --weight-type requires --model-format=binary" << std::endl;
+        return 1;
+    }
+
+    // Feature hashing replaces the attribute quark.
+    if (0 < opt.hash_bits && opt.type == option::TYPE_MULTI_SPARSE) {
+        es << "ERROR: --hash-bits is not supported for sparse features (-t n)" << std::endl;
+        return 1;
+    }
+    if (0 < opt.hash_bits && opt.model_format == option::MODEL_FORMAT_BINARY) {
+        es << "ERROR: --hash-bits requires --model-format=text" << std::endl;
+        return 1;
+    }
+    if (opt.hash_signed && opt.hash_bits <= 0) {
+        es << "ERROR: --hash-signed requires --hash-bits" << std::endl;
+        return 1;
+    }
+
+    // Streaming reads the blocks of instances from a cache file.
+    if (opt.stream && opt.cache.empty()) {
+        es << "ERROR: --stream requires --cache" << std::endl;
+        return 1;
+    }
+    if (opt.stream && opt.shuffle) {
+        es << "ERROR: --stream cannot shuffle the data set (--shuffle)" << std::endl;
+        return 1;
+    }
+    if (opt.stream && opt.compress) {
+        es << "ERROR: --stream cannot compress the data set (--compress)" << std::endl;
+        return 1;
+    }
+
+    // Distributed training sums the gradients of the features agreed on by
+    // the hash function.
+    if (!opt.distribute.empty()) {
+        int size = tcp_ring::count_peers(opt.distribute);
+        if (size <= opt.rank) {
+            es << "ERROR: --rank must be less than the number of ranks in --distribute: " << opt.rank << std::endl;
+            return 1;
+        }
+#ifndef TRAIN_DISTRIBUTED
+        if (1 < size) {
+            es << "ERROR: --distribute is not supported on this platform" << std::endl;
+            return 1;
+        }
+#endif/*TRAIN_DISTRIBUTED*/
+        if (opt.type != option::TYPE_BINARY && opt.type != option::TYPE_CANDIDATE) {
+            es << "ERROR: --distribute is supported only for '-t b' and '-t c'" << std::endl;
+            return 1;
+        }
+        if (opt.hash_bits <= 0) {
+            es << "ERROR: --distribute requires --hash-bits for the features agreed on by the ranks" << std::endl;
+            return 1;
+        }
+        if (opt.algorithm.compare(0, 4, "dcd.") == 0 || opt.algorithm == "svrg.logistic") {
+            es << "ERROR: --distribute is not supported for " << opt.algorithm << std::endl;
+            return 1;
+        }
+        if (opt.cross_validation || opt.stream) {
+            es << "ERROR: --distribute cannot be used with -x or --stream" << std::endl;
+            return 1;
+        }
+    } else if (0 < opt.rank) {
+        es << "ERROR: --rank requires --distribute" << std::endl;
+        return 1;
+    }
+
+    // A holdout sample is chosen from the data set held in memory.
+    if (0 < opt.holdout_sample && opt.stream) {
+        es << "ERROR: --holdout-sample cannot be used with --stream" << std::endl;
+        return 1;
+    }
+
+    // Place the large memory blocks allocated from now on.
+    classias::global_memory_policy() = opt.memory;
+
+    // Duplicates are merged in the data set held in memory.
+    if (opt.dedup && opt.stream) {
+        es << "ERROR: --dedup cannot be used with --stream" << std::endl;
+        return 1;
+    }
+
+    // Attributes are renumbered in the data set held in memory, and hashed
+    // attributes keep the identifiers of their buckets.
+    if (opt.renumber && opt.stream) {
+        es << "ERROR: --renumber cannot be used with --stream" << std::endl;
+        return 1;
+    }
+    if (opt.renumber && 0 < opt.hash_bits) {
+        es << "ERROR: --renumber cannot be used with --hash-bits" << std::endl;
+        return 1;
+    }
+
+    // Only L-BFGS and the online algorithms start from given weights.
+    if (!opt.init_model.empty()) {
+        if (opt.algorithm.compare(0, 4, "dcd.") == 0) {
+            es << "ERROR: --init-model is not supported for " << opt.algorithm << std::endl;
+            return 1;
+        }
+        if (opt.cross_validation || opt.stream) {
+            es << "ERROR: --init-model cannot be used with -x or --stream" << std::endl;
+            return 1;
+        }
+    }
+
+    // Checkpoints store the state of a single training on the data in memory.
+    if (!opt.checkpoint.empty()) {
+        if (opt.algorithm.compare(0, 4, "dcd.") == 0) {
+            es << "ERROR: --checkpoint is not supported for " << opt.algorithm << std::endl;
+            return 1;
+        }
+        if (opt.cross_validation || opt.stream || !opt.sweep_values.empty() || !opt.distribute.empty()) {
+            es << "ERROR: --checkpoint cannot be used with -x, --stream, --sweep, or --distribute" << std::endl;
+            return 1;
+        }
+
+        // L-BFGS stores only the weights, not the correction pairs.
+        if (opt.resume && opt.algorithm.compare(0, 6, "lbfgs.") == 0) {
+            es << "WARNING: " << opt.algorithm << " resumes from the stored weights with a new " <<
+                "approximation of the inverse hessian; the model may differ from that of " <<
+                "an uninterrupted training" << std::endl;
+        }
+    } else if (opt.resume) {
+        es << "ERROR: --resume requires --checkpoint" << std::endl;
+        return 1;
+    }
+
+    // A sweep warm-starts the L-BFGS solver from the previous weights.
+    if (!opt.sweep_values.empty()) {
+        if (opt.algorithm != "lbfgs.logistic") {
+            es << "ERROR: --sweep is supported only for lbfgs.logistic" << std::endl;
+            return 1;
+        }
+        if (opt.cross_validation || opt.stream) {
+            es << "ERROR: --sweep cannot be used with -x or --stream" << std::endl;
+            return 1;
+        }
+    }
+
+    // The fallbacks of the memory limit read the data set again.
+    if (!opt.memory_fallbacks.empty() && opt.max_memory <= 0.) {
+        es << "ERROR: --memory-fallback requires --max-memory" << std::endl;
+        return 1;
+    }
+
     // Show the help message and exit.
     if (opt.mode == option::MODE_HELP) {
         usage(os, argv[0]);
@@ -324,19 +929,54 @@ int main(int argc, char *argv[])
         opt.os = &ofs;
     }
 
-    // Branch for tasks.
+    // Open the stream of training metrics if necessary.
+    std::ofstream mfs;
+    classias::metrics metrics(mfs, opt.rank);
+    if (!opt.metrics.empty()) {
+        std::string fname = opt.metrics;
+        if (0 < opt.rank) {
+            std::ostringstream ss;
+            ss << fname << '.' << opt.rank;
+            fname = ss.str();
+        }
+        mfs.open(fname.c_str());
+        if (mfs.fail()) {
+            es << "ERROR: failed to open the metrics file: " << fname << std::endl;
+            return 1;
+        }
+        opt.ms = &metrics;
+    }
+
+    // Only the rank 0 of distributed training reports and stores the model.
+    std::ostream null_stream(NULL);
+    if (0 < opt.rank) {
+        opt.os = &null_stream;
+        opt.model.clear();
+    }
+
+    // Branch for tasks, reading the data set again with the next fallback
+    // while the memory limit is exceeded.
     try {
-        switch (opt.type) {
-        case option::TYPE_BINARY:
-            ret = binary_train(opt);
-            break;
-        case option::TYPE_MULTI_SPARSE:
-        case option::TYPE_MULTI_DENSE:
-            ret = multi_train(opt);
-            break;
-        case option::TYPE_CANDIDATE:
-            ret = candidate_train(opt);
-            break;
+        for (size_t k = 0;;) {
+            try {
+                switch (opt.type) {
+                case option::TYPE_BINARY:
+                    ret = binary_train(opt);
+                    break;
+                case option::TYPE_MULTI_SPARSE:
+                case option::TYPE_MULTI_DENSE:
+                    ret = multi_train(opt);
+                    break;
+                case option::TYPE_CANDIDATE:
+                    ret = candidate_train(opt);
+                    break;
+                }
+                break;
+            } catch (const memory_exceeded& e) {
+                if (!apply_memory_fallback(opt, e, k)) {
+                    throw;
+                }
+            }
         }
     } catch (const std::exception& e) {
         es << "ERROR: " << typeid(e).name() << ": " << e.what() << std::endl;
@@ -44,6 +44,7 @@
 #include <classias/train/pegasos.h>
 #include <classias/train/truncated_gradient.h>
 #include <classias/train/online_scheduler.h>
+#include <classias/train/svrg.h>
 
 #include "option.h"
 #include "tokenize.h"
@@ -61,57 +62,41 @@
 */
 
 template <
-    class instance_type,
-    class attributes_quark_type,
-    class label_quark_type
+    class data_type
 >
 static void
-read_line(
-    const std::string& line,
-    instance_type& instance,
-    attributes_quark_type& attributes,
-    label_quark_type& labels,
+store_line(
+    data_type& data,
+    const parsed_line& p,
     const option& opt,
-    int lines = 0
+    int group
     )
 {
     double value;
     std::string name;
+    typedef typename data_type::instance_type instance_type;
 
-    // Split the line with tab characters.
-    tokenizer values(line, opt.token_separator);
-    tokenizer::iterator itv = values.begin();
-    if (itv == values.end()) {
-        throw invalid_data("no field found in the line", line, lines);
-    }
-
-    // Make sure that the first token (class) is not empty.
-    if (itv->empty()) {
-        throw invalid_data("an empty label found", line, lines);
-    }
+    // Create a new instance.
+    instance_type& instance = data.new_element();
+    instance.set_group(group);
 
     // Parse the instance label.
-    get_name_value(*itv, name, value, opt.value_separator);
+    get_name_value(p.label, name, value, opt.value_separator);
 
     // Set the instance label and weight.
-    instance.set_label(labels(name));
+    instance.set_label(data.labels(name));
     instance.set_weight(value);
 
     // Set attributes for the instance.
-    for (++itv;itv != values.end();++itv) {
-        if (!itv->empty()) {
-            double value;
-            std::string name;
-            get_name_value(*itv, name, value, opt.value_separator);
-            if (opt.filter_string.empty() || REGEX_SEARCH(name, opt.filter)) {
-                instance.append(attributes(name), value);
-            }
-        }
+    for (size_t i = 0;i < p.fields.size();++i) {
+        double v = p.fields[i].second;
+        int a = get_attribute(data.attributes, p, i, v);
+        instance.append(a, v);
     }
 
     // Include a bias feature if necessary.
     if (opt.bias != 0.) {
-        instance.append(attributes("__BIAS__"), opt.bias);
+        instance.append(data.attributes("__BIAS__"), opt.bias);
     }
 }
 
@@ -123,46 +108,22 @@ read_stream(
     std::istream& is,
     data_type& data,
     const option& opt,
-    int group = 0
+    int group = 0,
+    chunk_sink* sink = NULL,
+    attribute_counts* counts = NULL
     )
 {
-    int lines = 0;
-    typedef typename data_type::instance_type instance_type;
-
     // If necessary, generate a bias attribute here to reserve feature #0.
     if (opt.bias != 0.) {
-        int aid = (int)data.attributes("__BIAS__");
+        int aid = reserve_attribute(data.attributes, "__BIAS__");
         if (aid != 0) {
             throw invalid_data("A bias attribute could not obtain #0");
         }
         // We will reserve the bias feature(s) in finalize_data() function.
     }
 
-    for (;;) {
-        // Read a line.
-        std::string line;
-        std::getline(is, line);
-        if (is.eof()) {
-            break;
-        }
-        ++lines;
-
-        // Skip an empty line.
-        if (line.empty()) {
-            continue;
-        }
-
-        // Skip a comment line.
-        if (line.compare(0, 1, "#") == 0) {
-            continue;
-        }
-
-        // Create a new instance.
-        instance_type& inst = data.new_element();
-        inst.set_group(group);
-
-        read_line(line, inst, data.attributes, data.labels, opt, lines);
-    }
+    // Read the instances.
+    read_lines(is, data, opt, group, sink, counts);
 }
 
 template <
@@ -196,6 +157,35 @@ finalize_data(
     }
 }
 
+/**
+ * Finalizes the data set read from a stream of cache blocks.
+ *  A feature generator that registers the pairs of attributes and labels
+ *  in the data (-t m) requires a pass over the stream.
+ *  @param  source      The stream on the cache file.
+ *  @param  data        The data set holding the string tables.
+ *  @param  opt         The options.
+ */
+template <
+    class source_type,
+    class data_type
+>
+static void
+finalize_stream(
+    source_type& source,
+    data_type& data,
+    const option& opt
+    )
+{
+    finalize_data(data, opt);
+
+    if (data.feature_generator.needs_registration()) {
+        source.rewind(false);
+        while (source.next() != NULL) {
+            data.generate_features();
+        }
+    }
+}
+
 template <
     class data_type,
     class model_type
@@ -204,7 +194,8 @@ static void
 output_model(
     data_type& data,
     const model_type& model,
-    const option& opt
+    const option& opt,
+    const std::vector<int>& perm
     )
 {
     typedef int int_t;
@@ -214,115 +205,176 @@ output_model(
     typedef typename labels_quark_type::item_type label_type;
     typedef typename model_type::value_type value_type;
 
+    const bool compiled = (opt.model_format == option::MODEL_FORMAT_BINARY);
+    model_file_writer mfw(
+        opt.type == option::TYPE_MULTI_SPARSE ?
+        MODEL_FILE_MULTI_SPARSE : MODEL_FILE_MULTI_DENSE,
+        opt.weight_type);
+
     // Open a model file for writing.
-    std::ofstream os(opt.model.c_str());
+    std::ofstream os;
+    if (!compiled) {
+        os.open(opt.model.c_str());
 
-    // Output a model type.
-    os << "@classias\tlinear\tmulti\t";
-    os << data.feature_generator.name() << std::endl;
+        // Output a model type.
+        os << "@classias\tlinear\tmulti\t";
+        os << data.feature_generator.name() << std::endl;
+        output_attributes_header(os, data.attributes);
+    }
 
     // Output a set of labels.
     for (int_t l = 0;l < data.num_labels();++l) {
-        os << "@label\t" << data.labels.to_item(l) << std::endl;
+        if (compiled) {
+            mfw.add_label(data.labels.to_item(l));
+        } else {
+            os << "@label\t" << data.labels.to_item(l) << std::endl;
+        }
+    }
+
+    // Enumerate the features in the original order of the attributes. The
+    // sparse features are numbered in the order of their occurrences, which
+    // the renumbering does not change.
+    std::vector<int_t> features;
+    if (perm.empty() || opt.type == option::TYPE_MULTI_SPARSE) {
+        for (int_t i = 0;i < data.num_features();++i) {
+            features.push_back(i);
+        }
+    } else {
+        for (int_t k = 0;k < (int_t)data.attributes.size();++k) {
+            const int_t a = renumbered_attribute(perm, k);
+            for (int_t l = 0;l < data.num_labels();++l) {
+                int_t f;
+                if (data.feature_generator.forward(a, l, f)) {
+                    features.push_back(f);
+                }
+            }
+        }
     }
 
     // Store the feature weights.
-    for (int_t i = 0;i < data.num_features();++i) {
+    for (size_t j = 0;j < features.size();++j) {
+        const int_t i = features[j];
         value_type w = model[i];
         if (w != 0.) {
             int_t a, l;
             data.feature_generator.backward(i, a, l);
-            const std::string& attr = data.attributes.to_item(a);
+            const std::string attr = attribute_name(data.attributes, a);
             const std::string& label = data.labels.to_item(l);
             if (attr == "__BIAS__") {
                 w *= opt.bias;
             }
-            os << w << '\t' << attr << '\t' << label << std::endl;
+            if (compiled) {
+                mfw.add(attr, l, w);
+            } else {
+                os << w << '\t' << attr << '\t' << label << std::endl;
+            }
         }
     }
+
+    // Write the compiled model.
+    if (compiled && !mfw.write(opt.model)) {
+        throw invalid_data("An error occurred when writing the model", opt.model);
+    }
 }
 
-int multi_train(option& opt)
+template <
+    class data_type,
+    class model_type
+>
+static int
+input_model(
+    data_type& data,
+    model_type& model,
+    const option& opt
+    )
+{
+    typedef int int_t;
+
+    init_model im;
+    im.read(opt.init_model, MODEL_FILE_MULTI_SPARSE);
+    check_init_hashing(data.attributes, im.hash_bits);
+
+    // Associate the weights with the features (pairs of attributes and
+    // labels) of the data set.
+    int n = 0;
+    model.resize(data.num_features());
+    std::fill(model.begin(), model.end(), 0.);
+    for (size_t i = 0;i < im.weights.size();++i) {
+        const model_weight& e = im.weights[i];
+        int_t a = find_attribute(data.attributes, e.attribute);
+        int_t l = (int_t)data.labels.to_value(e.label, data.labels.size());
+        int_t f;
+        if (0 <= a && l < (int_t)data.labels.size() &&
+            data.feature_generator.forward(a, l, f) &&
+            0 <= f && f < (int_t)model.size()) {
+            model[f] = e.weight;
+            if (e.attribute == "__BIAS__" && opt.bias != 0.) {
+                model[f] /= opt.bias;
+            }
+            ++n;
+        }
+    }
+    return n;
+}
+
+template <class data_type>
+static int
+multi_train_data(option& opt)
 {
     // Branches for training algorithms.
     if (opt.algorithm == "lbfgs.logistic") {
-        if (opt.type == option::TYPE_MULTI_SPARSE) {
-            return train<
-                classias::nsdata,
-                classias::train::lbfgs_logistic_multi<classias::nsdata>
-            >(opt);
-        } else if (opt.type == option::TYPE_MULTI_DENSE) {
-            return train<
-                classias::msdata,
-                classias::train::lbfgs_logistic_multi<classias::msdata>
-            >(opt);
-        }
+        return train<
+            data_type,
+            classias::train::lbfgs_logistic_multi<data_type>
+        >(opt);
+    } else if (opt.algorithm == "svrg.logistic") {
+        return train<
+            data_type,
+            classias::train::svrg_logistic_multi<data_type>
+        >(opt);
     } else if (opt.algorithm == "averaged_perceptron") {
-        if (opt.type == option::TYPE_MULTI_SPARSE) {
-            return train<
-                classias::nsdata,
-                classias::train::online_scheduler_multi<
-                    classias::nsdata,
-                    classias::train::averaged_perceptron_multi<
-                        classias::classify::linear_multi<classias::weight_vector>
-                        >
+        return train<
+            data_type,
+            classias::train::online_scheduler_multi<
+                data_type,
+                classias::train::averaged_perceptron_multi<
+                    classias::classify::linear_multi<classias::weight_vector>
                     >
-                >(opt);
-        } else if (opt.type == option::TYPE_MULTI_DENSE) {
-            return train<
-                classias::msdata,
-                classias::train::online_scheduler_multi<
-                    classias::msdata,
-                    classias::train::averaged_perceptron_multi<
-                        classias::classify::linear_multi<classias::weight_vector>
-                        >
-                    >
-                >(opt);
-        }
+                >
+            >(opt);
     } else if (opt.algorithm == "pegasos.logistic") {
-        if (opt.type == option::TYPE_MULTI_SPARSE) {
-            return train<
-                classias::nsdata,
-                classias::train::online_scheduler_multi<
-                    classias::nsdata,
-                    classias::train::pegasos_multi<
-                        classias::classify::linear_multi_logistic<classias::weight_vector>
-                        >
+        return train<
+            data_type,
+            classias::train::online_scheduler_multi<
+                data_type,
+                classias::train::pegasos_multi<
+                    classias::classify::linear_multi_logistic<classias::weight_vector>
                     >
-                >(opt);
-        } else if (opt.type == option::TYPE_MULTI_DENSE) {
-            return train<
-                classias::msdata,
-                classias::train::online_scheduler_multi<
-                    classias::msdata,
-                    classias::train::pegasos_multi<
-                        classias::classify::linear_multi_logistic<classias::weight_vector>
-                        >
-                    >
-                >(opt);
-        }
+                >
+            >(opt);
     } else if (opt.algorithm == "truncated_gradient.logistic") {
-        if (opt.type == option::TYPE_MULTI_SPARSE) {
-            return train<
-                classias::nsdata,
-                classias::train::online_scheduler_multi<
-                    classias::nsdata,
-                    classias::train::truncated_gradient_multi<
-                        classias::classify::linear_multi_logistic<classias::weight_vector>
-                        >
-                    >
-                >(opt);
-        } else if (opt.type == option::TYPE_MULTI_DENSE) {
-            return train<
-                classias::msdata,
-                classias::train::online_scheduler_multi<
-                    classias::msdata,
-                    classias::train::truncated_gradient_multi<
-                        classias::classify::linear_multi_logistic<classias::weight_vector>
-                        >
+        return train<
+            data_type,
+            classias::train::online_scheduler_multi<
+                data_type,
+                classias::train::truncated_gradient_multi<
+                    classias::classify::linear_multi_logistic<classias::weight_vector>
                     >
-                >(opt);
-        }
+                >
+            >(opt);
+    } else {
+        throw invalid_algorithm(opt.algorithm);
+    }
+}
+
+int multi_train(option& opt)
+{
+    // Branch for the feature generator and the attributes.
+    if (opt.type == option::TYPE_MULTI_SPARSE) {
+        return multi_train_data<classias::nsdata>(opt);
+    } else if (0 < opt.hash_bits) {
+        return multi_train_data<classias::msdata_hashed>(opt);
+    } else {
+        return multi_train_data<classias::msdata>(opt);
     }
-    throw invalid_algorithm(opt.algorithm);
 }
@@ -36,6 +36,8 @@
 #include <vector>
 #include <set>
 #include <string>
+#include <classias/memory.h>
+#include <classias/metrics.h>
 
 #if defined _MSC_VER
 
@@ -86,6 +88,18 @@ public:
         TYPE_CANDIDATE,     /// Multi-candidate ranker.
     };
 
+    enum {
+        MODEL_FORMAT_TEXT = 0,  /// Text format.
+        MODEL_FORMAT_BINARY,    /// Compiled (binary) format.
+    };
+
+    enum {
+        WEIGHT_DOUBLE = 0,      /// Double precision.
+        WEIGHT_FLOAT,           /// Single precision.
+        WEIGHT_INT16,           /// 16-bit integers with block scales.
+        WEIGHT_INT8,            /// 8-bit integers with block scales.
+    };
+
     std::istream*   is;
     std::ostream*   os;
     std::ostream*   es;
@@ -97,6 +111,8 @@ public:
     std::string algorithm;
     params_type params;
     std::string model;
+    int         model_format;
+    int         weight_type;
     bool        shuffle;
     double      bias;
     int         split;
@@ -104,9 +120,37 @@ public:
     REGEX       filter;
     std::string filter_string;
     bool        cross_validation;
+    int         cv_jobs;
+    int         holdout_threads;
+    int         holdout_sample;
+    int         holdout_interval;
     labels_type negative_labels;
     bool        logfile;
     std::string logbase;
+    std::string cache;
+    int         read_threads;
+    classias::memory_policy memory;
+    bool        csr;
+    bool        compress;
+    int         hash_bits;
+    bool        hash_signed;
+    int         min_count;
+    bool        stream;
+    int         stream_block;
+    std::string distribute;
+    int         rank;
+    std::string sweep_name;
+    std::string init_model;
+    std::string checkpoint;
+    int         checkpoint_every;
+    bool        resume;
+    bool        dedup;
+    bool        renumber;
+    double      max_memory;
+    params_type memory_fallbacks;
+    params_type sweep_values;
+    std::string metrics;
+    classias::metrics*  ms;
 
     char        token_separator;
     char        value_separator;
@@ -117,11 +161,19 @@ public:
         std::ostream* _es = &std::cerr
         ) :
         is(_is), os(_os), es(_es),
-        mode(MODE_NORMAL), type(TYPE_MULTI_DENSE), model(""),
-        algorithm("lbfgs.logistic"),        
+        mode(MODE_NORMAL), type(TYPE_MULTI_DENSE),
+        algorithm("lbfgs.logistic"), model(""),
+        model_format(MODEL_FORMAT_TEXT), weight_type(WEIGHT_DOUBLE),
         shuffle(false), bias(1.),
-        split(0), holdout(-1), cross_validation(false),
-        logfile(false), logbase(""),
+        split(0), holdout(-1), cross_validation(false), cv_jobs(1),
+        holdout_threads(1), holdout_sample(0), holdout_interval(1),
+        logfile(false), logbase(""), cache(""), read_threads(1), csr(false),
+        compress(false), hash_bits(0), hash_signed(false), min_count(0),
+        stream(false), stream_block(65536), distribute(""), rank(0),
+        sweep_name(""), init_model(""),
+        checkpoint(""), checkpoint_every(1), resume(false),
+        dedup(false), renumber(false), max_memory(0.),
+        metrics(""), ms(NULL),
         token_separator(' '), value_separator(':')
     {
     }
@@ -0,0 +1,127 @@
+/*
+ *		Count-min sketch for frequencies of attributes.
+ *
+ * Copyright (c) 2008,2009 Naoaki Okazaki
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the names of the authors nor the names of its contributors
+ *       may be used to endorse or promote products derived from this
+ *       software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* $Id$ */
+
+#ifndef __SKETCH_H__
+#define __SKETCH_H__
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <classias/hashed_quark.h>
+
+/**
+ * The number of counters in a row of a sketch (a power of two).
+ */
+#define SKETCH_WIDTH    (1 << 20)
+
+/**
+ * The number of rows (hash functions) of a sketch.
+ */
+#define SKETCH_DEPTH    4
+
+/**
+ * Count-min sketch of the numbers of occurrences of strings.
+ *  A sketch estimates the frequencies of any number of strings in a fixed
+ *  amount of memory (SKETCH_WIDTH * SKETCH_DEPTH counters). An estimate is
+ *  never smaller than the true count; it may be larger when other strings
+ *  collide with the string in every row. The counters are incremented by
+ *  conservative update, which increments only the counters at the minimum.
+ */
+class count_min_sketch
+{
+protected:
+    std::vector<uint32_t> m_counters;
+
+public:
+    /**
+     * Constructs an empty sketch.
+     */
+    count_min_sketch() : m_counters(SKETCH_WIDTH * SKETCH_DEPTH, 0)
+    {
+    }
+
+    /**
+     * Counts an occurrence of a string.
+     *  @param  x           The string.
+     *  @return uint32_t    The estimated count after the occurrence.
+     */
+    uint32_t add(const std::string& x)
+    {
+        size_t c[SKETCH_DEPTH];
+        uint32_t m = locate(x, c);
+        if (m < 0xFFFFFFFFU) {
+            for (int i = 0;i < SKETCH_DEPTH;++i) {
+                if (m_counters[c[i]] == m) {
+                    ++m_counters[c[i]];
+                }
+            }
+            ++m;
+        }
+        return m;
+    }
+
+    /**
+     * Estimates the number of occurrences of a string.
+     *  @param  x           The string.
+     *  @return uint32_t    The estimated count.
+     */
+    uint32_t count(const std::string& x) const
+    {
+        size_t c[SKETCH_DEPTH];
+        return locate(x, c);
+    }
+
+protected:
+    /**
+     * Finds the counters of a string.
+     *  @param  x           The string.
+     *  @param  c           The array receiving the indices of the counters.
+     *  @return uint32_t    The minimum of the counters.
+     */
+    uint32_t locate(const std::string& x, size_t* c) const
+    {
+        // Derive the rows from two hash values (Kirsch and Mitzenmacher).
+        const uint32_t h1 = classias::murmurhash3(x.data(), x.size());
+        const uint32_t h2 = classias::murmurhash3(x.data(), x.size(), h1) | 1;
+        uint32_t m = 0xFFFFFFFFU;
+        for (int i = 0;i < SKETCH_DEPTH;++i) {
+            uint32_t j = (h1 + (uint32_t)i * h2) & (SKETCH_WIDTH - 1);
+            c[i] = (size_t)i * SKETCH_WIDTH + j;
+            if (m_counters[c[i]] < m) {
+                m = m_counters[c[i]];
+            }
+        }
+        return m;
+    }
+};
+
+#endif/*__SKETCH_H__*/
@@ -34,153 +34,1491 @@
 #define __TRAIN_H__
 
 #include <algorithm>
+#include <cstdlib>
 #include <fstream>
 #include <ios>
 #include <iostream>
+#include <sstream>
+#include <stdexcept>
 #include <string>
 #include <vector>
+#if defined(_MSC_VER)
+#include <direct.h>
+#endif
+#include <classias/checkpoint.h>
+#include <classias/evaluation.h>
+#include <classias/thread.h>
 #include <libexecstream/exec-stream.h>
 #include <util.h>
+#include <decompress.h>
+#include <decompress_command.h>
+#include <model_file.h>
+#include "ingest.h"
+#include "cache.h"
+#include "allreduce.h"
+#include "init_model.h"
+
+/*
+ * Accessors for the attribute quark of a data set. With --hash-bits, the
+ * attributes are mapped to buckets by classias::hashed_quark_base, which
+ * stores only the names reserved for unregularized attributes (e.g., the
+ * bias) and may give signs to attribute values. The other attributes are
+ * written to a model by their identifiers.
+ */
+template <class quark_type>
+static void
+setup_attributes(quark_type& attributes, const option& opt)
+{
+}
+
+template <class item_type>
+static void
+setup_attributes(classias::hashed_quark_base<item_type>& attributes, const option& opt)
+{
+    attributes.set_bits(opt.hash_bits);
+    attributes.set_signed(opt.hash_signed);
+}
+
+template <class quark_type>
+static int
+reserve_attribute(quark_type& attributes, const std::string& name)
+{
+    return (int)attributes(name);
+}
+
+template <class item_type>
+static int
+reserve_attribute(classias::hashed_quark_base<item_type>& attributes, const std::string& name)
+{
+    return (int)attributes.reserve(name);
+}
+
+template <class quark_type>
+static int
+num_reserved_attributes(const quark_type& attributes)
+{
+    return (int)attributes.size();
+}
+
+template <class item_type>
+static int
+num_reserved_attributes(const classias::hashed_quark_base<item_type>& attributes)
+{
+    return (int)attributes.num_reserved();
+}
+
+template <class quark_type>
+static int
+get_attribute(quark_type& attributes, const std::string& name, double& value)
+{
+    return (int)attributes(name);
+}
+
+template <class item_type>
+static int
+get_attribute(classias::hashed_quark_base<item_type>& attributes, const std::string& name, double& value)
+{
+    double sign;
+    int a = (int)attributes(name, sign);
+    value *= sign;
+    return a;
+}
+
+/**
+ * Gets the identifier of the attribute of a field in a parsed line, which
+ *  may have been looked up by a parser of the pipeline.
+ */
+template <class quark_type>
+static int
+get_attribute(quark_type& attributes, const parsed_line& p, size_t i, double& value)
+{
+    if (i < p.attributes.size() && 0 <= p.attributes[i]) {
+        return p.attributes[i];
+    }
+    return get_attribute(attributes, p.fields[i].first, value);
+}
+
+template <class quark_type>
+static int
+find_attribute(const quark_type& attributes, const std::string& name)
+{
+    typename quark_type::value_type a = attributes.to_value(name, attributes.size());
+    return (a < attributes.size() ? (int)a : -1);
+}
+
+template <class item_type>
+static int
+find_attribute(const classias::hashed_quark_base<item_type>& attributes, const std::string& name)
+{
+    for (int i = 0;i < (int)attributes.num_reserved();++i) {
+        if (attributes.to_item(i) == name) {
+            return i;
+        }
+    }
+
+    // A model stores a hashed attribute by its identifier.
+    char *end = NULL;
+    long a = std::strtol(name.c_str(), &end, 10);
+    if (name.empty() || *end != 0 ||
+        a < (long)attributes.num_reserved() || (long)attributes.size() <= a) {
+        return -1;
+    }
+    return (int)a;
+}
+
+template <class quark_type>
+static void
+check_init_hashing(const quark_type& attributes, int bits)
+{
+    if (0 < bits) {
+        throw invalid_model("the initial model has hashed attributes (--hash-bits)");
+    }
+}
+
+template <class item_type>
+static void
+check_init_hashing(const classias::hashed_quark_base<item_type>& attributes, int bits)
+{
+    if (0 <= bits && bits != attributes.bits()) {
+        throw invalid_model("the initial model has a different number of hash bits");
+    }
+}
+
+template <class quark_type>
+static std::string
+attribute_name(const quark_type& attributes, int a)
+{
+    return attributes.to_item(a);
+}
+
+template <class item_type>
+static std::string
+attribute_name(const classias::hashed_quark_base<item_type>& attributes, int a)
+{
+    if (a < (int)attributes.num_reserved()) {
+        return attributes.to_item(a);
+    } else {
+        std::stringstream ss;
+        ss << a;
+        return ss.str();
+    }
+}
+
+template <class quark_type>
+static void
+output_attributes_header(std::ostream& os, const quark_type& attributes)
+{
+}
+
+template <class item_type>
+static void
+output_attributes_header(std::ostream& os, const classias::hashed_quark_base<item_type>& attributes)
+{
+    os << "@hash\t" << attributes.bits() << '\t';
+    os << (attributes.is_signed() ? "signed" : "unsigned") << std::endl;
+    for (int i = 0;i < (int)attributes.num_reserved();++i) {
+        os << "@reserve\t" << attributes.to_item(i) << std::endl;
+    }
+}
+
+/*
+ * Accessors for the memory used by the components of a data set. A binary
+ * data set has neither the label quark nor a feature generator.
+ */
+template <class data_type>
+static size_t
+labels_memory_usage(const data_type& data)
+{
+    return data.labels.memory_usage();
+}
+
+template <class instance_type, class quark_type>
+static size_t
+labels_memory_usage(const classias::binary_data_with_quark_base<instance_type, quark_type>& data)
+{
+    return 0;
+}
+
+template <class quark_type>
+static size_t
+labels_memory_usage(const classias::binary_csr_data_with_quark_base<quark_type>& data)
+{
+    return 0;
+}
+
+template <class data_type>
+static size_t
+features_memory_usage(const data_type& data)
+{
+    return data.feature_generator.memory_usage();
+}
+
+template <class instance_type, class quark_type>
+static size_t
+features_memory_usage(const classias::binary_data_with_quark_base<instance_type, quark_type>& data)
+{
+    return 0;
+}
+
+template <class quark_type>
+static size_t
+features_memory_usage(const classias::binary_csr_data_with_quark_base<quark_type>& data)
+{
+    return 0;
+}
+
+/**
+ * Returns the memory used by the string tables and feature generator.
+ *  @param  data        The data set.
+ *  @return size_t      The number of bytes.
+ */
+template <class data_type>
+static size_t
+tables_memory_usage(const data_type& data)
+{
+    return
+        data.attributes.memory_usage() +
+        labels_memory_usage(data) +
+        features_memory_usage(data);
+}
+
+/**
+ * Reports the memory used by a data set.
+ *  @param  os          The output stream.
+ *  @param  data        The data set.
+ */
+template <class data_type>
+static void
+output_memory_usage(std::ostream& os, const data_type& data)
+{
+    os << "Memory of instances: " << data.memory_usage() / 1048576. << " MB" << std::endl;
+    os << "Memory of attributes: " << data.attributes.memory_usage() / 1048576. << " MB" << std::endl;
+    os << "Memory of labels: " << labels_memory_usage(data) / 1048576. << " MB" << std::endl;
+    os << "Memory of features: " << features_memory_usage(data) / 1048576. << " MB" << std::endl;
+}
+
+/**
+ * Throws memory_exceeded if a data set exceeds the memory limit.
+ *  @param  data        The data set.
+ *  @param  opt         The options.
+ */
+template <class data_type>
+static void
+check_memory_usage(const data_type& data, const option& opt)
+{
+    if (0 < opt.max_memory) {
+        const double bytes = (double)(data.memory_usage() + tables_memory_usage(data));
+        if (opt.max_memory < bytes) {
+            throw memory_exceeded(bytes, opt.max_memory, data.attributes.size());
+        }
+    }
+}
 
 template <
     class trainer_type,
     class data_type>
 static void
-set_parameters(
+set_parameters(
+    trainer_type& trainer,
+    data_type& data,
+    const option& opt,
+    bool fold_random = false
+    )
+{
+    typename option::params_type::const_iterator itp;
+    classias::parameter_exchange& params = trainer.params();
+    for (itp = opt.params.begin();itp != opt.params.end();++itp) {
+        std::string name, value;
+        std::string::size_type pos = itp->find('=');
+        if (pos != itp->npos) {
+            name = std::string(*itp, 0, pos);
+            value = itp->substr(pos+1);
+        } else {
+            name = *itp;
+        }
+        params.set(name, value);
+    }
+    trainer.set_metrics(opt.ms);
+
+    classias::holdout_options ho;
+    ho.num_threads = opt.holdout_threads;
+    ho.sample = (size_t)opt.holdout_sample;
+    ho.interval = opt.holdout_interval;
+    ho.fold_random = fold_random;
+    trainer.set_holdout_options(ho);
+}
+
+/**
+ * Writes a record of reading the data set to the stream of training metrics.
+ *  @param  opt         The options.
+ *  @param  data        The data set.
+ *  @param  n           The number of instances.
+ *  @param  num_groups  The number of groups.
+ *  @param  sw          The stopwatch of reading.
+ */
+template <class data_type>
+static void
+write_metrics_read(
+    const option& opt,
+    const data_type& data,
+    size_t n,
+    int num_groups,
+    const stopwatch& sw
+    )
+{
+    if (opt.ms != NULL) {
+        classias::metrics_record rec("read");
+        rec.add("algorithm", opt.algorithm);
+        rec.add("instances", n);
+        rec.add("groups", num_groups);
+        rec.add("attributes", data.num_attributes());
+        rec.add("labels", data.num_labels());
+        rec.add("features", data.num_features());
+        rec.add("memory_instances", data.memory_usage());
+        rec.add("memory_attributes", data.attributes.memory_usage());
+        rec.add("memory_labels", labels_memory_usage(data));
+        rec.add("memory_features", features_memory_usage(data));
+        rec.add("seconds", sw.get());
+        rec.add("cpu_seconds", sw.get_cpu());
+        rec.add("instances_per_second", 0. < sw.get() ? n / sw.get() : 0.);
+        opt.ms->write(rec);
+    }
+}
+
+/**
+ * Writes a record of a training to the stream of training metrics.
+ *  @param  opt         The options.
+ *  @param  holdout     The group number for holdout evaluation.
+ *  @param  sw          The stopwatch of the training.
+ *  @param  memory      The number of bytes used by the trainer.
+ *  @param  point       The parameter of a point of --sweep, or empty.
+ */
+static void
+write_metrics_train(
+    const option& opt,
+    int holdout,
+    const stopwatch& sw,
+    size_t memory,
+    const std::string& point = ""
+    )
+{
+    if (opt.ms != NULL) {
+        classias::metrics_record rec("train");
+        rec.add("algorithm", opt.algorithm);
+        rec.add("holdout", holdout);
+        if (!point.empty()) {
+            rec.add("sweep", point);
+        }
+        rec.add("seconds", sw.get());
+        rec.add("cpu_seconds", sw.get_cpu());
+        rec.add("memory", memory);
+        opt.ms->write(rec);
+    }
+}
+
+/**
+ * Reports the memory used by a trainer.
+ *  @param  os          The output stream.
+ *  @param  trainer     The trainer.
+ */
+template <class trainer_type>
+static void
+output_trainer_memory(std::ostream& os, const trainer_type& trainer)
+{
+    os << "Memory of the trainer: " << trainer.memory_usage() / 1048576. << " MB" << std::endl;
+}
+
+template <class data_type>
+static int
+split_data(
+    data_type& data,
+    const option& opt
+    )
+{
+    int i = 0;
+    typename data_type::iterator it;
+    for (it = data.begin();it != data.end();++it, ++i) {
+        it->set_group(i % opt.split);
+    }
+    return opt.split;
+}
+
+template <class data_type>
+static void
+shuffle_data(data_type& data)
+{
+    std::random_shuffle(data.begin(), data.end());
+}
+
+template <class attributes_quark_type>
+static void
+shuffle_data(
+    classias::binary_csr_data_with_quark_base<attributes_quark_type>& data
+    )
+{
+    data.shuffle();
+}
+
+/* Only the instances in CSR layout can be compressed. */
+template <class data_type>
+static void
+compress_data(data_type& data)
+{
+}
+
+template <class attributes_quark_type>
+static void
+compress_data(
+    classias::binary_csr_data_with_quark_base<attributes_quark_type>& data
+    )
+{
+    data.compress();
+}
+
+/* The key of an instance (with its group and label) for merging duplicates. */
+template <class value_type>
+static void
+append_key(std::string& key, const value_type& value)
+{
+    key.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+template <class iterator_type>
+static void
+append_key(std::string& key, iterator_type first, iterator_type last)
+{
+    // The same elements in a different order make the same key.
+    std::vector<std::pair<int, double> > elems;
+    for (iterator_type it = first;it != last;++it) {
+        elems.push_back(std::make_pair((int)it->first, (double)it->second));
+    }
+    std::sort(elems.begin(), elems.end());
+    append_key(key, (int)elems.size());
+    for (size_t i = 0;i < elems.size();++i) {
+        append_key(key, elems[i].first);
+        append_key(key, elems[i].second);
+    }
+}
+
+template <class instance_type>
+static void
+instance_key(std::string& key, const instance_type& inst)
+{
+    key.clear();
+    append_key(key, (int)inst.get_group());
+    append_key(key, (int)inst.get_label());
+    append_key(key, inst.begin(), inst.end());
+}
+
+template <class attributes_type, class weight_type, class group_type>
+static void
+instance_key(
+    std::string& key,
+    const classias::candidate_instance_base<attributes_type, weight_type, group_type>& inst
+    )
+{
+    key.clear();
+    append_key(key, (int)inst.get_group());
+    append_key(key, (int)inst.get_label());
+    append_key(key, (int)inst.size());
+    typename classias::candidate_instance_base<
+        attributes_type, weight_type, group_type>::const_iterator it;
+    for (it = inst.begin();it != inst.end();++it) {
+        append_key(key, it->begin(), it->end());
+    }
+    append_key(key, inst.shared().begin(), inst.shared().end());
+}
+
+/**
+ * Merges the duplicates of instances.
+ *  Instances with the same group, label, and attributes are merged into
+ *  the first one, whose weight becomes the sum of the weights.
+ *  @param  data        The data set.
+ *  @return int         The number of instances removed.
+ */
+template <class data_type>
+static int
+dedup_data(data_type& data)
+{
+    typedef typename data_type::size_type size_type;
+    typedef UNORDERED_MAP<std::string, size_type> keys_type;
+
+    std::string key;
+    keys_type keys;
+    std::vector<size_type> indices;
+    size_type i = 0;
+    for (typename data_type::iterator it = data.begin();it != data.end();++it, ++i) {
+        instance_key(key, *it);
+        std::pair<typename keys_type::iterator, bool> ret =
+            keys.insert(std::make_pair(key, indices.size()));
+        if (ret.second) {
+            indices.push_back(i);
+        } else {
+            typename data_type::iterator first = data.begin() + indices[ret.first->second];
+            first->set_weight(first->get_weight() + it->get_weight());
+        }
+    }
+
+    const int n = (int)(data.size() - indices.size());
+    if (0 < n) {
+        data.select(indices);
+    }
+    return n;
+}
+
+/* The frequencies and new identifiers of attributes for --renumber. */
+template <class iterator_type>
+static void
+count_elements(std::vector<size_t>& counts, iterator_type first, iterator_type last)
+{
+    for (iterator_type it = first;it != last;++it) {
+        ++counts[it->first];
+    }
+}
+
+template <class iterator_type>
+static void
+renumber_elements(const std::vector<int>& perm, iterator_type first, iterator_type last)
+{
+    for (iterator_type it = first;it != last;++it) {
+        it->first = perm[it->first];
+    }
+}
+
+template <class instance_type>
+static void
+count_instance(std::vector<size_t>& counts, const instance_type& inst)
+{
+    count_elements(counts, inst.begin(), inst.end());
+}
+
+template <class attributes_type, class weight_type, class group_type>
+static void
+count_instance(
+    std::vector<size_t>& counts,
+    const classias::candidate_instance_base<attributes_type, weight_type, group_type>& inst
+    )
+{
+    typename classias::candidate_instance_base<
+        attributes_type, weight_type, group_type>::const_iterator it;
+    for (it = inst.begin();it != inst.end();++it) {
+        count_elements(counts, it->begin(), it->end());
+    }
+    count_elements(counts, inst.shared().begin(), inst.shared().end());
+}
+
+template <class instance_type>
+static void
+renumber_instance(const std::vector<int>& perm, instance_type& inst)
+{
+    renumber_elements(perm, inst.begin(), inst.end());
+}
+
+template <class attributes_type, class weight_type, class group_type>
+static void
+renumber_instance(
+    const std::vector<int>& perm,
+    classias::candidate_instance_base<attributes_type, weight_type, group_type>& inst
+    )
+{
+    typename classias::candidate_instance_base<
+        attributes_type, weight_type, group_type>::iterator it;
+    for (it = inst.begin();it != inst.end();++it) {
+        renumber_elements(perm, it->begin(), it->end());
+    }
+    renumber_elements(perm, inst.shared().begin(), inst.shared().end());
+}
+
+template <class data_type>
+static void
+renumber_instances(data_type& data, const std::vector<int>& perm)
+{
+    typename data_type::iterator it;
+    for (it = data.begin();it != data.end();++it) {
+        renumber_instance(perm, *it);
+    }
+}
+
+template <class attributes_quark_type>
+static void
+renumber_instances(
+    classias::binary_csr_data_with_quark_base<attributes_quark_type>& data,
+    const std::vector<int>& perm
+    )
+{
+    data.renumber(perm);
+}
+
+template <class quark_type>
+static void
+renumber_attributes(quark_type& attributes, const std::vector<int>& perm)
+{
+    attributes.renumber(perm);
+}
+
+template <class item_type>
+static void
+renumber_attributes(classias::hashed_quark_base<item_type>& attributes, const std::vector<int>& perm)
+{
+    // The identifiers of hashed attributes are their buckets (see main()).
+    throw std::logic_error("Hashed attributes cannot be renumbered");
+}
+
+struct attribute_count_greater
+{
+    const std::vector<size_t>* counts;
+
+    bool operator()(int x, int y) const
+    {
+        return (*counts)[y] < (*counts)[x];
+    }
+};
+
+/**
+ * Renumbers the attributes in descending order of their frequencies.
+ *  The frequent attributes obtain small identifiers so that their weights
+ *  (and the features generated from them afterwards) are close in memory.
+ *  The reserved attributes (e.g., the bias) keep their identifiers, and the
+ *  attributes of the same frequency keep their order.
+ *  @param  data        The data set, whose features are not generated yet.
+ *  @param  opt         The options.
+ *  @param  perm        Receives the new identifiers of the attributes.
+ */
+template <class data_type>
+static void
+renumber_data(data_type& data, const option& opt, std::vector<int>& perm)
+{
+    const int n = (int)data.attributes.size();
+    std::vector<size_t> counts(n, 0);
+    typename data_type::const_iterator it;
+    for (it = data.begin();it != data.end();++it) {
+        count_instance(counts, *it);
+    }
+
+    int reserved = data.get_user_feature_start();
+    if (opt.bias != 0. && reserved < 1) {
+        reserved = 1;
+    }
+    reserved = std::min(reserved, n);
+
+    std::vector<int> order;
+    for (int a = reserved;a < n;++a) {
+        order.push_back(a);
+    }
+    attribute_count_greater comp = {&counts};
+    std::stable_sort(order.begin(), order.end(), comp);
+
+    perm.resize(n);
+    for (int a = 0;a < reserved;++a) {
+        perm[a] = a;
+    }
+    for (size_t i = 0;i < order.size();++i) {
+        perm[order[i]] = reserved + (int)i;
+    }
+
+    renumber_instances(data, perm);
+    renumber_attributes(data.attributes, perm);
+}
+
+/**
+ * Returns the identifier of an attribute after --renumber.
+ *  The model writers iterate the attributes in their original order so
+ *  that the model file does not depend on the renumbering.
+ *  @param  perm        The new identifiers of the attributes, or empty if
+ *                      the attributes were not renumbered.
+ *  @param  a           The original identifier of the attribute.
+ *  @return int         The identifier of the attribute in the data set.
+ */
+inline static int
+renumbered_attribute(const std::vector<int>& perm, int a)
+{
+    return perm.empty() ? a : perm[a];
+}
+
+/**
+ * A reader that stores the instances in a stream to a data set.
+ */
+template <class data_type>
+struct data_reader
+{
+    data_type* data;
+    const option* opt;
+    chunk_sink* sink;
+    attribute_counts* counts;
+
+    void operator()(std::istream& is, int group)
+    {
+        read_stream(is, *data, *opt, group, sink, counts);
+    }
+};
+
+/**
+ * A reader that counts the attributes in a stream.
+ */
+struct attribute_counter
+{
+    const option* opt;
+    attribute_counts* counts;
+
+    void operator()(std::istream& is, int group)
+    {
+        count_attributes(is, *opt, *counts);
+    }
+};
+
+/**
+ * Reads the data files (or STDIN) with a reader.
+ *  @param  reader      The reader called with every input stream and its
+ *                      group number.
+ *  @param  opt         The options.
+ */
+template <class reader_type>
+static void
+read_files(
+    reader_type& reader,
+    const option& opt
+    )
+{
+    std::ostream& os = *opt.os;
+    // Read files for training data.
+    if (opt.files.empty()) {
+        // Read the data from STDIN (decompressing it if necessary).
+        decompress_streambuf buf(std::cin.rdbuf(), opt.read_threads);
+        os << "STDIN";
+        if (buf.format() != decompress_streambuf::FORMAT_NONE) {
+            os << " (" << buf.format_name() << ")";
+        }
+        os << std::endl;
+        if (!buf.supported()) {
+            // Read STDIN from an external decompressor.
+            decompress_command command;
+            command.start(buf);
+            std::istream is(command.rdbuf());
+            reader(is, 0);
+            if (command.finish() != 0) {
+                throw invalid_data("An error occurred when decompressing STDIN");
+            }
+            return;
+        }
+        std::istream is(&buf);
+        reader(is, 0);
+        if (!buf.error().empty()) {
+            throw invalid_data("An error occurred when decompressing STDIN", buf.error());
+        }
+    } else {
+        // Read the data from files.
+        for (int i = 0;i < (int)opt.files.size();++i) {
+            const std::string& file = opt.files[i];
+
+            // Open the file and detect its compression format.
+            std::ifstream ifs(file.c_str(), std::ios::in | std::ios::binary);
+            if (ifs.fail()) {
+                os << "- " << i+1 << ": " << file << ": failed" << std::endl;
+                throw invalid_data("An error occurred when reading a file");
+            }
+            decompress_streambuf buf(ifs.rdbuf(), opt.read_threads);
+
+            // Output the file name (and its decompressor).
+            os << "- " << i+1;
+            if (buf.format() != decompress_streambuf::FORMAT_NONE) {
+                os << " (" << buf.format_name() << ")";
+            }
+            os << ": " << file;
+            os.flush();
+
+            if (buf.format() == decompress_streambuf::FORMAT_NONE) {
+                // Read an uncompressed file.
+                std::ifstream ifs(file.c_str());
+                reader(ifs, i);
+            } else if (buf.supported()) {
+                // Read the file, decompressing it in this process.
+                std::istream is(&buf);
+                reader(is, i);
+                if (!buf.error().empty()) {
+                    os << ": failed (" << buf.error() << ")" << std::endl;
+                    throw invalid_data("An error occurred when decompressing a file");
+                }
+            } else {
+                // Read a compressed file from an external decompressor.
+                std::string decomp_cmd = buf.format_name();
+                std::string decomp_arg = "-dc";
+                if (buf.format() == decompress_streambuf::FORMAT_BZIP2 ||
+                    buf.format() == decompress_streambuf::FORMAT_XZ) {
+                    decomp_arg = "-dck";
+                }
+
+                exec_stream_t proc;
+                proc.set_text_mode(exec_stream_t::s_out);
+                proc.start(decomp_cmd, decomp_arg.c_str(), file.c_str());
+                std::istream& ifs = proc.out();
+                if (!ifs.fail()) {
+                    reader(ifs, i);
+                    proc.close();
+                    if (proc.exit_code() != 0) {
+                        os << ": failed (exit_code = " << proc.exit_code() << ")";
+                        throw invalid_data("An error occurred when decompressing a file");
+                    }
+                } else {
+                    os << ": failed (exit_code = " << proc.exit_code() << ")" << std::endl;
+                    throw invalid_data("An error occurred when decompressing a file");
+                }
+            }
+            os << std::endl;
+            os.flush();
+        }
+    }
+}
+
+/**
+ * A receiver of instances that enforces the memory limit while reading.
+ *  Every MEMORY_CHECK_LINES lines, the guard adds the memory of the
+ *  instances appended since the previous check (except for the last one,
+ *  which may still grow) to the memory of the string tables, and throws
+ *  memory_exceeded if the sum exceeds the limit. The instances are passed
+ *  to another receiver (e.g., cache_spill) first; the count restarts when
+ *  that receiver moves the instances out of the data set.
+ */
+template <class data_type>
+class memory_guard : public chunk_sink
+{
+protected:
+    enum {
+        MEMORY_CHECK_LINES = 4096,
+    };
+
+    const data_type& m_data;
+    const option& m_opt;
+    chunk_sink* m_next;
+    size_t m_lines;
+    size_t m_counted;
+    size_t m_bytes;
+
+public:
+    memory_guard(const data_type& data, const option& opt, chunk_sink* next = NULL)
+        : m_data(data), m_opt(opt), m_next(next),
+        m_lines(0), m_counted(0), m_bytes(0)
+    {
+    }
+
+    virtual void stored()
+    {
+        if (m_next != NULL) {
+            m_next->stored();
+        }
+        if (++m_lines % MEMORY_CHECK_LINES != 0) {
+            return;
+        }
+
+        const size_t n = m_data.size();
+        if (n < m_counted) {
+            m_counted = 0;
+            m_bytes = 0;
+        }
+        if (m_counted + 1 < n) {
+            m_bytes += m_data.memory_usage(m_counted, n - 1);
+            m_counted = n - 1;
+        }
+
+        const double bytes = (double)(m_bytes + tables_memory_usage(m_data));
+        if (m_opt.max_memory < bytes) {
+            throw memory_exceeded(bytes, m_opt.max_memory, m_data.attributes.size());
+        }
+    }
+};
+
+template <class data_type>
+static void
+read_data(
+    data_type& data,
+    const option& opt,
+    chunk_sink* sink = NULL
+    )
+{
+    std::ostream& os = *opt.os;
+    attribute_counts* counts = NULL;
+
+    try {
+        // Count the attributes for dropping rare ones.
+        if (0 < opt.min_count) {
+            counts = new attribute_counts;
+            if (opt.files.empty()) {
+                // STDIN cannot be read twice; count attributes while reading.
+                counts->online = true;
+            } else {
+                os << "Counting attributes:" << std::endl;
+                attribute_counter counter = {&opt, counts};
+                read_files(counter, opt);
+                os << "Reading instances:" << std::endl;
+            }
+        }
+
+        // Enforce the memory limit while reading if specified.
+        memory_guard<data_type> guard(data, opt, sink);
+        if (0 < opt.max_memory) {
+            sink = &guard;
+        }
+
+        data_reader<data_type> reader = {&data, &opt, sink, counts};
+        read_files(reader, opt);
+    } catch (...) {
+        delete counts;
+        throw;
+    }
+    delete counts;
+}
+
+template <class data_type>
+static int
+read_dataset(
+    data_type& data,
+    const option& opt,
+    std::vector<int>& perm
+    )
+{
+    std::ostream& os = *opt.os;
+
+    // Read the training data (from the cache if possible).
+    if (!opt.cache.empty() && read_cache(data, opt)) {
+        os << "- cache: " << opt.cache << std::endl;
+    } else {
+        read_data(data, opt);
+
+        // Store the data to the cache if necessary.
+        if (!opt.cache.empty()) {
+            write_cache(data, opt);
+            os << "- cache (stored): " << opt.cache << std::endl;
+        }
+    }
+
+    // Renumber the attributes if necessary.
+    if (opt.renumber) {
+        renumber_data(data, opt, perm);
+    }
+
+    // Finalize the data.
+    finalize_data(data, opt);
+
+    // Compress the instances if necessary.
+    if (opt.compress) {
+        compress_data(data);
+    }
+    check_memory_usage(data, opt);
+
+    // Merge duplicated instances if necessary.
+    if (opt.dedup) {
+        os << "- duplicates merged: " << dedup_data(data) << std::endl;
+    }
+
+    // Shuffle instances if necessary.
+    if (opt.shuffle) {
+        shuffle_data(data);
+    }
+
+    // Split the training data if necessary.
+    if (0 < opt.split) {
+        split_data(data, opt);
+        return opt.split;
+    } else {
+        return (int)opt.files.size();
+    }
+}
+
+/**
+ * Opens a stream of data blocks on the cache file.
+ *  If the cache is missing or stale, this function builds the cache from
+ *  the source files while reading them, without holding all the instances
+ *  in memory.
+ *  @param  source      The stream on the cache file.
+ *  @param  data        The empty data set to which the stream loads blocks.
+ *  @param  opt         The options.
+ *  @return int         The number of groups.
+ */
+template <class data_type>
+static int
+read_dataset_stream(
+    cache_stream<data_type>& source,
+    data_type& data,
+    const option& opt
+    )
+{
+    std::ostream& os = *opt.os;
+
+    if (source.open()) {
+        os << "- cache: " << opt.cache << std::endl;
+    } else {
+        // Write the instances to the cache while reading the source files.
+        data_type tmp;
+        setup_attributes(tmp.attributes, opt);
+        cache_spill<data_type> spill(tmp, opt);
+        read_data(tmp, opt, &spill);
+        spill.finish();
+        os << "- cache (stored): " << opt.cache << std::endl;
+
+        if (!source.open()) {
+            throw invalid_data("Failed to read the cache file", opt.cache);
+        }
+    }
+
+    // Finalize the data (with a pass over the stream if necessary).
+    finalize_stream(source, data, opt);
+
+    // Split the training data if necessary.
+    if (0 < opt.split) {
+        source.set_split(opt.split);
+        return opt.split;
+    } else {
+        return (int)opt.files.size();
+    }
+}
+
+/* Distributed training is implemented by L-BFGS and the online schedulers. */
+template <class trainer_type>
+static void
+set_allreduce(trainer_type& trainer, classias::allreduce* ar)
+{
+}
+
+template <class data_type, class model_type>
+static void
+set_allreduce(classias::train::lbfgs_logistic_binary<data_type, model_type>& trainer, classias::allreduce* ar)
+{
+    trainer.set_allreduce(ar);
+}
+
+template <class data_type, class model_type>
+static void
+set_allreduce(classias::train::lbfgs_logistic_multi<data_type, model_type>& trainer, classias::allreduce* ar)
+{
+    trainer.set_allreduce(ar);
+}
+
+template <class data_type, class algorithm_type>
+static void
+set_allreduce(classias::train::online_scheduler_binary<data_type, algorithm_type>& trainer, classias::allreduce* ar)
+{
+    trainer.set_allreduce(ar);
+}
+
+template <class data_type, class algorithm_type>
+static void
+set_allreduce(classias::train::online_scheduler_multi<data_type, algorithm_type>& trainer, classias::allreduce* ar)
+{
+    trainer.set_allreduce(ar);
+}
+
+/* Checkpoints are implemented by L-BFGS, SVRG, and the online schedulers. */
+template <class trainer_type>
+static void
+set_checkpoint(trainer_type& trainer, classias::checkpoint* cp)
+{
+}
+
+template <class data_type, class model_type>
+static void
+set_checkpoint(classias::train::lbfgs_logistic_binary<data_type, model_type>& trainer, classias::checkpoint* cp)
+{
+    trainer.set_checkpoint(cp);
+}
+
+template <class data_type, class model_type>
+static void
+set_checkpoint(classias::train::lbfgs_logistic_multi<data_type, model_type>& trainer, classias::checkpoint* cp)
+{
+    trainer.set_checkpoint(cp);
+}
+
+template <class data_type, class model_type>
+static void
+set_checkpoint(classias::train::svrg_logistic_binary<data_type, model_type>& trainer, classias::checkpoint* cp)
+{
+    trainer.set_checkpoint(cp);
+}
+
+template <class data_type, class model_type>
+static void
+set_checkpoint(classias::train::svrg_logistic_multi<data_type, model_type>& trainer, classias::checkpoint* cp)
+{
+    trainer.set_checkpoint(cp);
+}
+
+template <class data_type, class algorithm_type>
+static void
+set_checkpoint(classias::train::online_scheduler_binary<data_type, algorithm_type>& trainer, classias::checkpoint* cp)
+{
+    trainer.set_checkpoint(cp);
+}
+
+template <class data_type, class algorithm_type>
+static void
+set_checkpoint(classias::train::online_scheduler_multi<data_type, algorithm_type>& trainer, classias::checkpoint* cp)
+{
+    trainer.set_checkpoint(cp);
+}
+
+/**
+ * Builds the string identifying the training stored by a checkpoint.
+ *  A checkpoint is restored only when the data files and the options
+ *  affecting the training are unchanged, except for the maximum number of
+ *  iterations, which may be raised to continue a finished training.
+ */
+static std::string
+checkpoint_signature(const option& opt)
+{
+    std::stringstream ss;
+    ss << cache_signature(opt);
+    ss << "cache=" << opt.cache << '\n';
+    ss << "algorithm=" << opt.algorithm << '\n';
+    for (size_t i = 0;i < opt.params.size();++i) {
+        const std::string& param = opt.params[i];
+        const std::string name = param.substr(0, param.find('='));
+        const std::string key = "max_iterations";
+        if (key.size() <= name.size() &&
+            name.compare(name.size() - key.size(), key.size(), key) == 0) {
+            continue;
+        }
+        ss << "param=" << param << '\n';
+    }
+    ss << "shuffle=" << opt.shuffle << '\n';
+    ss << "split=" << opt.split << '\t' << opt.holdout << '\n';
+    ss << "csr=" << opt.csr << '\t' << opt.compress << '\n';
+    ss << "dedup=" << opt.dedup << '\n';
+    ss << "renumber=" << opt.renumber << '\n';
+    ss << "init_model=" << opt.init_model << '\n';
+    return ss.str();
+}
+
+/**
+ * Creates the directory of checkpoints unless it exists.
+ */
+static void
+make_checkpoint_directory(const std::string& dir)
+{
+    struct stat st;
+    if (stat(dir.c_str(), &st) == 0) {
+        return;
+    }
+#if defined(_MSC_VER)
+    const int ret = _mkdir(dir.c_str());
+#else
+    const int ret = mkdir(dir.c_str(), 0777);
+#endif
+    if (ret != 0) {
+        throw std::runtime_error("Failed to create the directory of checkpoints: " + dir);
+    }
+}
+
+/* Warm starts are implemented only by L-BFGS. */
+template <class trainer_type>
+static void
+set_warm_start(trainer_type& trainer, bool warm)
+{
+}
+
+template <class data_type, class model_type>
+static void
+set_warm_start(classias::train::lbfgs_logistic_binary<data_type, model_type>& trainer, bool warm)
+{
+    trainer.set_warm_start(warm);
+}
+
+template <class data_type, class model_type>
+static void
+set_warm_start(classias::train::lbfgs_logistic_multi<data_type, model_type>& trainer, bool warm)
+{
+    trainer.set_warm_start(warm);
+}
+
+/* Initial weights are implemented by L-BFGS, SVRG, and the online schedulers. */
+template <class trainer_type, class model_type>
+static void
+set_initial_weights(trainer_type& trainer, const model_type& w)
+{
+}
+
+template <class data_type, class model_type>
+static void
+set_initial_weights(classias::train::lbfgs_logistic_binary<data_type, model_type>& trainer, const model_type& w)
+{
+    trainer.set_initial_weights(w);
+}
+
+template <class data_type, class model_type>
+static void
+set_initial_weights(classias::train::lbfgs_logistic_multi<data_type, model_type>& trainer, const model_type& w)
+{
+    trainer.set_initial_weights(w);
+}
+
+template <class data_type, class algorithm_type, class model_type>
+static void
+set_initial_weights(classias::train::online_scheduler_binary<data_type, algorithm_type>& trainer, const model_type& w)
+{
+    trainer.set_initial_weights(w);
+}
+
+template <class data_type, class algorithm_type, class model_type>
+static void
+set_initial_weights(classias::train::online_scheduler_multi<data_type, algorithm_type>& trainer, const model_type& w)
+{
+    trainer.set_initial_weights(w);
+}
+
+template <class data_type, class model_type>
+static void
+set_initial_weights(classias::train::svrg_logistic_binary<data_type, model_type>& trainer, const model_type& w)
+{
+    trainer.set_initial_weights(w);
+}
+
+template <class data_type, class model_type>
+static void
+set_initial_weights(classias::train::svrg_logistic_multi<data_type, model_type>& trainer, const model_type& w)
+{
+    trainer.set_initial_weights(w);
+}
+
+/* Training on a stream is implemented only by the online schedulers. */
+template <class trainer_type>
+static bool
+can_train_stream(trainer_type& trainer)
+{
+    return false;
+}
+
+template <class data_type, class algorithm_type>
+static bool
+can_train_stream(classias::train::online_scheduler_binary<data_type, algorithm_type>& trainer)
+{
+    return true;
+}
+
+template <class data_type, class algorithm_type>
+static bool
+can_train_stream(classias::train::online_scheduler_multi<data_type, algorithm_type>& trainer)
+{
+    return true;
+}
+
+template <class trainer_type, class source_type>
+static void
+train_stream(
     trainer_type& trainer,
-    data_type& data,
-    const option& opt
+    source_type& source,
+    std::ostream& os,
+    int holdout,
+    bool acconly
     )
 {
-    typename option::params_type::const_iterator itp;
-    classias::parameter_exchange& params = trainer.params();
-    for (itp = opt.params.begin();itp != opt.params.end();++itp) {
-        std::string name, value;
-        std::string::size_type pos = itp->find('=');
-        if (pos != itp->npos) {
-            name = std::string(*itp, 0, pos);
-            value = itp->substr(pos+1);
-        } else {
-            name = *itp;
-        }
-        params.set(name, value);
-    }
 }
 
-template <class data_type>
-static int
-split_data(
-    data_type& data,
-    const option& opt
+template <class data_type, class algorithm_type, class source_type>
+static void
+train_stream(
+    classias::train::online_scheduler_binary<data_type, algorithm_type>& trainer,
+    source_type& source,
+    std::ostream& os,
+    int holdout,
+    bool acconly
     )
 {
-    int i = 0;
-    typename data_type::iterator it;
-    for (it = data.begin();it != data.end();++it, ++i) {
-        it->set_group(i % opt.split);
-    }
-    return opt.split;
+    trainer.train_stream(source, os, holdout, acconly);
 }
 
-template <class data_type>
+template <class data_type, class algorithm_type, class source_type>
 static void
-read_data(
-    data_type& data,
-    const option& opt
+train_stream(
+    classias::train::online_scheduler_multi<data_type, algorithm_type>& trainer,
+    source_type& source,
+    std::ostream& os,
+    int holdout,
+    bool acconly
     )
 {
+    trainer.train_stream(source, os, holdout, acconly);
+}
+
+/**
+ * Trains a model with repeated passes over the cache file (--stream).
+ *  Only a block of instances is held in memory at a time. The folds of
+ *  cross validation are trained one after another.
+ */
+template <
+    class data_type,
+    class trainer_type
+>
+static int
+train_streaming(option& opt)
+{
+    stopwatch sw;
+    data_type data;
+    setup_attributes(data.attributes, opt);
+    cache_stream<data_type> source(data, opt, (size_t)opt.stream_block);
+    int num_groups = 0;
     std::ostream& os = *opt.os;
-    std::ostream& es = *opt.es;
 
-    // Read files for training data.
-    if (opt.files.empty()) {
-        // Read the data from STDIN.
-        os << "STDIN" << std::endl;
-        read_stream(std::cin, data, opt, 0);
-    } else {
-        // Read the data from files.
-        for (int i = 0;i < (int)opt.files.size();++i) {
-            std::string decomp, decomp_cmd, decomp_arg;
-            const std::string& file = opt.files[i];
+    // Make sure that the algorithm can train a model on a stream.
+    {
+        trainer_type trainer;
+        if (!can_train_stream(trainer)) {
+            throw invalid_algorithm(
+                "an online algorithm is necessary for --stream: " + opt.algorithm);
+        }
+    }
 
-            // Set a compressor and its arguments.
-            if (file.compare(file.length()-3, 3, ".gz") == 0) {
-                decomp = " (gzip)";
-                decomp_cmd = "gzip";
-                decomp_arg = "-dc";
-            } else if (file.compare(file.length()-4, 4, ".bz2") == 0) {
-                decomp = " (bzip2)";
-                decomp_cmd = "bzip2";
-                decomp_arg = "-dck";
-            } else if (file.compare(file.length()-3, 3, ".xz") == 0) {
-                decomp = " (xz)";
-                decomp_cmd = "xz";
-                decomp_arg = "-dck";
-            }
+    // Read the source data.
+    os << "Reading the data set from " << opt.files.size() << " files" << std::endl;
+    sw.start();
+    num_groups = read_dataset_stream(source, data, opt);
+    sw.stop();
+    write_metrics_read(opt, data, source.size(), num_groups, sw);
+    os << "Number of instances: " << source.size() << std::endl;
+    os << "Number of chunks: " << source.num_chunks() << std::endl;
+    os << "Number of instances in a block: " << source.block_size() << std::endl;
+    os << "Number of groups: " << num_groups << std::endl;
+    os << "Number of attributes: " << data.num_attributes() << std::endl;
+    os << "Number of labels: " << data.num_labels() << std::endl;
+    os << "Number of features: " << data.num_features() << std::endl;
+    output_memory_usage(os, data);
+    os << "Seconds required: " << sw.get() << std::endl;
+    os << std::endl;
 
-            // Output the file name (and its decompressor).
-            os << "- " << i+1 << decomp << ": " << file;
-            os.flush();
+    // Exit if the data set is empty.
+    if (source.size() == 0) {
+        throw invalid_data("The data set is empty", 0);
+    }
 
-            if (decomp_cmd.empty()) {
-                // Read an uncompressed file.
-                std::ifstream ifs(file.c_str());
-                if (!ifs.fail()) {
-                    read_stream(ifs, data, opt, i);
-                } else {
-                    os << ": failed" << std::endl;
-                    throw invalid_data("An error occurred when reading a file");
-                }
-            } else {
-                // Read a compressed file from an external decompressor.
-                exec_stream_t proc;
-                proc.set_text_mode(exec_stream_t::s_out);
-                proc.start(decomp_cmd, decomp_arg.c_str(), file.c_str());
-                std::istream& ifs = proc.out();
-                if (!ifs.fail()) {
-                    read_stream(ifs, data, opt, i);
-                    proc.close();
-                    if (proc.exit_code() != 0) {
-                        os << ": failed (exit_code = " << proc.exit_code() << ")";
-                        throw invalid_data("An error occurred when decompressing a file");
-                    }
-                } else {
-                    os << ": failed (exit_code = " << proc.exit_code() << ")" << std::endl;
-                    throw invalid_data("An error occurred when decompressing a file");
-                }
-            }
+    // Start training.
+    if (opt.cross_validation) {
+        for (int i = 0;i < num_groups;++i) {
+            trainer_type trainer;
+            set_parameters(trainer, data, opt);
+
+            os << "===== Cross validation (" << (i + 1) << "/" << num_groups << ") =====" << std::endl;
+            sw.start();
+            train_stream(
+                trainer,
+                source,
+                os,
+                i,
+                (opt.type == option::TYPE_CANDIDATE)
+                );
+            sw.stop();
+            write_metrics_train(opt, i, sw, trainer.memory_usage());
+            output_trainer_memory(os, trainer);
+            os << "Seconds required: " << sw.get() << std::endl;
             os << std::endl;
-            os.flush();
+        }
+    } else {
+        // Set training parameters.
+        trainer_type trainer;
+        set_parameters(trainer, data, opt);
+
+        // Start training.
+        sw.start();
+        train_stream(
+            trainer,
+            source,
+            os,
+            (0 < opt.holdout ? (opt.holdout-1) : -1),
+            (opt.type == option::TYPE_CANDIDATE)
+            );
+        sw.stop();
+        write_metrics_train(opt, (0 < opt.holdout ? (opt.holdout-1) : -1), sw, trainer.memory_usage());
+        output_trainer_memory(os, trainer);
+        os << "Seconds required: " << sw.get() << std::endl;
+        os << std::endl;
+
+        // Store the model.
+        if (!opt.model.empty()) {
+            output_model(data, trainer.model(), opt, std::vector<int>());
         }
     }
+
+	// Report the finish time.
+    os << "Finish time: " << timestamp << std::endl;
+    os << std::endl;
+
+    return 0;
 }
 
-template <class data_type>
-static int
-read_dataset(
+template <
+    class data_type,
+    class trainer_type
+>
+static void
+train_fold(
     data_type& data,
-    const option& opt
+    const option& opt,
+    int i,
+    int num_groups,
+    std::ostream& os,
+    bool concurrent = false
     )
 {
-    // Read the training data.
-    read_data(data, opt);
+    stopwatch sw;
 
-    // Finalize the data.
-    finalize_data(data, opt);
+    // Set training parameters; a fold trained concurrently with the others
+    // draws random numbers from its own sequence.
+    trainer_type trainer;
+    set_parameters(trainer, data, opt, concurrent);
 
-    // Shuffle instances if necessary.
-    if (opt.shuffle) {
-        std::random_shuffle(data.begin(), data.end());
-    }
+    os << "===== Cross validation (" << (i + 1) << "/" << num_groups << ") =====" << std::endl;
+    sw.start();
+    trainer.train(
+        data,
+        os,
+        i,
+        (opt.type == option::TYPE_CANDIDATE)
+        );
+    sw.stop();
+    write_metrics_train(opt, i, sw, trainer.memory_usage());
+    output_trainer_memory(os, trainer);
+    os << "Seconds required: " << sw.get() << std::endl;
+    os << std::endl;
+}
 
-    // Split the training data if necessary.
-    if (0 < opt.split) {
-        split_data(data, opt);
-        return opt.split;
-    } else {
-        return (int)opt.files.size();
+/**
+ * A task training the folds of cross validation that are not taken yet.
+ *  The log of the fold #i is stored in logs[i], and the error message of an
+ *  exception thrown in the fold is stored in errors[i].
+ */
+template <
+    class data_type,
+    class trainer_type
+>
+struct train_fold_task
+{
+    data_type* data;
+    const option* opt;
+    int num_groups;
+    int* next;
+    classias::mutex* mutex;
+    std::vector<std::string>* logs;
+    std::vector<std::string>* errors;
+
+    void run()
+    {
+        for (;;) {
+            // Take the next fold.
+            int i;
+            {
+                classias::scoped_lock lock(*mutex);
+                i = (*next)++;
+            }
+            if (num_groups <= i) {
+                break;
+            }
+
+            std::ostringstream os;
+            try {
+                train_fold<data_type, trainer_type>(*data, *opt, i, num_groups, os, true);
+            } catch (const std::exception& e) {
+                (*errors)[i] = e.what();
+            }
+            (*logs)[i] = os.str();
+        }
     }
-}
+};
 
 template <
     class data_type,
@@ -191,7 +1529,9 @@ train(option& opt)
 {
     stopwatch sw;
     data_type data;
+    setup_attributes(data.attributes, opt);
     int num_groups = 0;
+    std::vector<int> perm;
     std::ostream& os = *opt.os;
 
     // Show the help message for the algorithm and exit if necessary.
@@ -214,23 +1554,59 @@ train(option& opt)
     os << "Instance shuffle: " << std::boolalpha << opt.shuffle << std::endl;
     os << "Bias feature value: " << opt.bias << std::endl;
     os << "Model file: " << opt.model << std::endl;
+    os << "Model format: " << (opt.model_format == option::MODEL_FORMAT_BINARY ? "binary" : "text") << std::endl;
+    os << "Model weight type: ";
+    switch (opt.weight_type) {
+    case option::WEIGHT_DOUBLE: os << "double";         break;
+    case option::WEIGHT_FLOAT:  os << "float";          break;
+    case option::WEIGHT_INT16:  os << "int16";          break;
+    case option::WEIGHT_INT8:   os << "int8";           break;
+    }
+    os << std::endl;
     os << "Instance splitting: " << opt.split << std::endl;
     os << "Holdout group: " << opt.holdout << std::endl;
     os << "Cross validation: " << std::boolalpha << opt.cross_validation << std::endl;
+    os << "Cross validation jobs: " << opt.cv_jobs << std::endl;
     os << "Attribute filter: " << opt.filter_string << std::endl;
+    os << "Data cache: " << opt.cache << std::endl;
+    os << "Instance storage: " << (opt.compress ? "csr (compressed)" : (opt.csr ? "csr" : "vector")) << std::endl;
+    os << "Hash bits: " << opt.hash_bits << std::endl;
+    os << "Signed hashing: " << std::boolalpha << opt.hash_signed << std::endl;
+    os << "Minimum count of attributes: " << opt.min_count << std::endl;
+    os << "Reading threads: " << opt.read_threads << std::endl;
+    os << "Streaming: " << std::boolalpha << opt.stream << std::endl;
+    os << "Duplicate merging: " << std::boolalpha << opt.dedup << std::endl;
+    os << "Attribute renumbering: " << std::boolalpha << opt.renumber << std::endl;
+    if (0 < opt.max_memory) {
+        os << "Memory limit: " << opt.max_memory / 1048576. << " MB" << std::endl;
+    }
+    if (opt.stream) {
+        os << "Stream block: " << opt.stream_block << std::endl;
+    }
+    if (!opt.checkpoint.empty()) {
+        os << "Checkpoint: " << opt.checkpoint << " (every " << opt.checkpoint_every << " iterations";
+        os << (opt.resume ? ", resuming" : "") << ")" << std::endl;
+    }
     os << "Start time: " << timestamp << std::endl;
     os << std::endl;
 
+    // Train a model on the stream of the cache file if specified.
+    if (opt.stream) {
+        return train_streaming<data_type, trainer_type>(opt);
+    }
+
     // Read the source data.
     os << "Reading the data set from " << opt.files.size() << " files" << std::endl;
     sw.start();
-    num_groups = read_dataset(data, opt);
+    num_groups = read_dataset(data, opt, perm);
     sw.stop();
+    write_metrics_read(opt, data, data.size(), num_groups, sw);
     os << "Number of instances: " << data.size() << std::endl;
     os << "Number of groups: " << num_groups << std::endl;
     os << "Number of attributes: " << data.num_attributes() << std::endl;
     os << "Number of labels: " << data.num_labels() << std::endl;
     os << "Number of features: " << data.num_features() << std::endl;
+    output_memory_usage(os, data);
     os << "Seconds required: " << sw.get() << std::endl;
     os << std::endl;
 
@@ -242,43 +1618,128 @@ train(option& opt)
     // Start training.
     if (opt.cross_validation) {
         // Training with cross validation
-        for (int i = 0;i < num_groups;++i) {
-            // Set training parameters.
-            trainer_type trainer;
-            set_parameters(trainer, data, opt);
+        if (opt.cv_jobs <= 1 || num_groups <= 1) {
+            for (int i = 0;i < num_groups;++i) {
+                train_fold<data_type, trainer_type>(data, opt, i, num_groups, os);
+            }
+        } else {
+            // Train folds concurrently with a bounded number of jobs.
+            typedef train_fold_task<data_type, trainer_type> task_type;
+            int next = 0;
+            classias::mutex mutex;
+            std::vector<std::string> logs(num_groups), errors(num_groups);
+            std::vector<task_type> tasks(std::min(opt.cv_jobs, num_groups));
+            for (size_t j = 0;j < tasks.size();++j) {
+                tasks[j].data = &data;
+                tasks[j].opt = &opt;
+                tasks[j].num_groups = num_groups;
+                tasks[j].next = &next;
+                tasks[j].mutex = &mutex;
+                tasks[j].logs = &logs;
+                tasks[j].errors = &errors;
+            }
+            classias::run_tasks(tasks);
 
-            os << "===== Cross validation (" << (i + 1) << "/" << num_groups << ") =====" << std::endl;
+            // Output the logs in the order of folds.
+            for (int i = 0;i < num_groups;++i) {
+                os << logs[i];
+                if (!errors[i].empty()) {
+                    os.flush();
+                    throw std::runtime_error(errors[i]);
+                }
+            }
+        }
+    } else {
+        // Set training parameters.
+        trainer_type trainer;
+        set_parameters(trainer, data, opt);
+
+        // Start from the weights of a previous model if specified.
+        if (!opt.init_model.empty()) {
+            classias::weight_vector init;
+            os << "Reading the initial model: " << opt.init_model << std::endl;
+            int n = input_model(data, init, opt);
+            os << "Number of initial weights: " << n << std::endl;
+            os << std::endl;
+            set_initial_weights(trainer, init);
+        }
+
+        // Connect the ranks of distributed training.
+        tcp_ring ring;
+        if (!opt.distribute.empty()) {
+            os << "Connecting to the ranks: " << opt.distribute << std::endl;
+            ring.open(opt.distribute, opt.rank, data.num_features());
+            set_allreduce(trainer, &ring);
+            os << "Number of ranks: " << ring.size() << std::endl;
+            os << std::endl;
+        }
+
+        // Store the state of the training to the checkpoint file.
+        classias::checkpoint cp;
+        if (!opt.checkpoint.empty()) {
+            make_checkpoint_directory(opt.checkpoint);
+            cp.open(
+                opt.checkpoint + "/checkpoint",
+                opt.checkpoint_every,
+                opt.resume,
+                checkpoint_signature(opt)
+                );
+            set_checkpoint(trainer, &cp);
+        }
+
+        if (opt.sweep_values.empty()) {
+            // Start training.
             sw.start();
             trainer.train(
                 data,
                 os,
-                i,
+                (0 < opt.holdout ? (opt.holdout-1) : -1),
                 (opt.type == option::TYPE_CANDIDATE)
                 );
             sw.stop();
+            write_metrics_train(opt, (0 < opt.holdout ? (opt.holdout-1) : -1), sw, trainer.memory_usage());
+            output_trainer_memory(os, trainer);
             os << "Seconds required: " << sw.get() << std::endl;
             os << std::endl;
-        }
-    } else {
-        // Set training parameters.
-        trainer_type trainer;
-        set_parameters(trainer, data, opt);
 
-        // Start training.
-        sw.start();
-        trainer.train(
-            data,
-            os,
-            (0 < opt.holdout ? (opt.holdout-1) : -1),
-            (opt.type == option::TYPE_CANDIDATE)
-            );
-        sw.stop();
-        os << "Seconds required: " << sw.get() << std::endl;
-        os << std::endl;
+            // Store the model.
+            if (!opt.model.empty()) {
+                output_model(data, trainer.model(), opt, perm);
+            }
+        } else {
+            // Train along the regularization path on the same data set,
+            // starting every training from the weights of the previous one.
+            const size_t n = opt.sweep_values.size();
+            set_warm_start(trainer, true);
+            for (size_t i = 0;i < n;++i) {
+                const std::string& value = opt.sweep_values[i];
+                trainer.params().set(opt.sweep_name, value);
 
-        // Store the model.
-        if (!opt.model.empty()) {
-            output_model(data, trainer.model(), opt);
+                os << "===== Sweep (" << (i + 1) << "/" << n << "): " <<
+                    opt.sweep_name << "=" << value << " =====" << std::endl;
+                sw.start();
+                trainer.train(
+                    data,
+                    os,
+                    (0 < opt.holdout ? (opt.holdout-1) : -1),
+                    (opt.type == option::TYPE_CANDIDATE)
+                    );
+                sw.stop();
+                write_metrics_train(
+                    opt, (0 < opt.holdout ? (opt.holdout-1) : -1), sw,
+                    trainer.memory_usage(), opt.sweep_name + "=" + value);
+                output_trainer_memory(os, trainer);
+                os << "Seconds required: " << sw.get() << std::endl;
+
+                // Store the model of this point.
+                if (!opt.model.empty()) {
+                    option mopt = opt;
+                    mopt.model = opt.model + "." + opt.sweep_name + "=" + value;
+                    output_model(data, trainer.model(), mopt, perm);
+                    os << "Model file: " << mopt.model << std::endl;
+                }
+                os << std::endl;
+            }
         }
     }
 
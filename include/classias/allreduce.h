@@ -0,0 +1,82 @@
+/*
+ *		Interface of collective operations for distributed training.
+ *
+ * Copyright (c) 2008,2009 Naoaki Okazaki
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the names of the authors nor the names of its contributors
+ *       may be used to endorse or promote products derived from this
+ *       software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* $Id$ */
+
+#ifndef __CLASSIAS_ALLREDUCE_H__
+#define __CLASSIAS_ALLREDUCE_H__
+
+#include <cstddef>
+
+namespace classias
+{
+
+/**
+ * The interface of a collective operation over the processes (ranks) of
+ * distributed training.
+ *  Every rank calls sum() with a vector of the same size in the same
+ *  order of calls, and receives the element-wise sum of the vectors of all
+ *  ranks. An implementation must return the identical values (bit by bit)
+ *  to all ranks so that the ranks running a deterministic algorithm on the
+ *  sums stay in lockstep.
+ */
+class allreduce
+{
+public:
+    /**
+     * Destructs the object.
+     */
+    virtual ~allreduce()
+    {
+    }
+
+    /**
+     * Sums a vector over all ranks.
+     *  @param  v           The vector, which receives the sum.
+     *  @param  n           The number of elements of the vector.
+     */
+    virtual void sum(double *v, size_t n) = 0;
+
+    /**
+     * Returns the index of this process.
+     *  @return int         The rank (0 is the rank reporting the progress).
+     */
+    virtual int rank() const = 0;
+
+    /**
+     * Returns the number of processes.
+     *  @return int         The number of ranks.
+     */
+    virtual int size() const = 0;
+};
+
+};
+
+#endif/*__CLASSIAS_ALLREDUCE_H__*/
@@ -0,0 +1,437 @@
+/*
+ *		Checkpoints of training processes.
+ *
+ * Copyright (c) 2008,2009 Naoaki Okazaki
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the names of the authors nor the names of its contributors
+ *       may be used to endorse or promote products derived from this
+ *       software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* $Id$ */
+
+#ifndef __CLASSIAS_CHECKPOINT_H__
+#define __CLASSIAS_CHECKPOINT_H__
+
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#include "thread.h"
+
+namespace classias
+{
+
+/**
+ * Exception class for errors of checkpoints.
+ */
+class checkpoint_error : public std::runtime_error
+{
+public:
+    /**
+     * Constructs an object.
+     *  @param  msg             The error message.
+     */
+    explicit checkpoint_error(const std::string& msg)
+        : std::runtime_error(msg)
+    {
+    }
+};
+
+/**
+ * An archive storing the state of a training process to a byte buffer.
+ *
+ *  A training algorithm exposes its state by a member function
+ *  template <class archive_type> void serialize(archive_type& ar), which
+ *  passes every member of the state to value() or vector(); the same
+ *  function stores the state with this class and restores it with
+ *  checkpoint_reader. The values are stored in the native byte order of
+ *  the machine.
+ */
+class checkpoint_writer
+{
+protected:
+    std::string m_buffer;
+
+public:
+    /**
+     * Stores a value.
+     *  @param  v               The value.
+     */
+    template <class value_type>
+    void value(const value_type& v)
+    {
+        m_buffer.append(reinterpret_cast<const char*>(&v), sizeof(v));
+    }
+
+    /**
+     * Stores the size and elements of a vector.
+     *  @param  v               The vector with contiguous elements.
+     */
+    template <class vector_type>
+    void vector(const vector_type& v)
+    {
+        const unsigned long long n = (unsigned long long)v.size();
+        this->value(n);
+        if (0 < n) {
+            m_buffer.append(
+                reinterpret_cast<const char*>(&v[0]),
+                (size_t)n * sizeof(typename vector_type::value_type));
+        }
+    }
+
+    /**
+     * Stores a string.
+     *  @param  str             The string.
+     */
+    void string(const std::string& str)
+    {
+        this->value((unsigned long long)str.size());
+        m_buffer += str;
+    }
+
+    /**
+     * Obtains the buffer.
+     *  @return std::string&    The buffer of the stored bytes.
+     */
+    std::string& buffer()
+    {
+        return m_buffer;
+    }
+};
+
+/**
+ * An archive restoring the state of a training process from a byte buffer.
+ *  @see    checkpoint_writer
+ */
+class checkpoint_reader
+{
+protected:
+    const std::string& m_buffer;
+    size_t m_pos;
+
+public:
+    /**
+     * Constructs an object.
+     *  @param  buffer          The buffer of the bytes stored by
+     *                          checkpoint_writer.
+     */
+    explicit checkpoint_reader(const std::string& buffer)
+        : m_buffer(buffer), m_pos(0)
+    {
+    }
+
+    /**
+     * Restores a value.
+     *  @param  v               The value.
+     */
+    template <class value_type>
+    void value(value_type& v)
+    {
+        std::memcpy(&v, this->get(sizeof(v)), sizeof(v));
+    }
+
+    /**
+     * Restores the size and elements of a vector.
+     *  @param  v               The vector with contiguous elements.
+     */
+    template <class vector_type>
+    void vector(vector_type& v)
+    {
+        unsigned long long n;
+        this->value(n);
+        const size_t bytes = (size_t)n * sizeof(typename vector_type::value_type);
+        const char* p = this->get(bytes);
+        v.resize((size_t)n);
+        if (0 < n) {
+            std::memcpy(&v[0], p, bytes);
+        }
+    }
+
+    /**
+     * Restores a string.
+     *  @param  str             The string.
+     */
+    void string(std::string& str)
+    {
+        unsigned long long n;
+        this->value(n);
+        str.assign(this->get((size_t)n), (size_t)n);
+    }
+
+    /**
+     * Tests whether all the bytes are restored.
+     *  @return bool            \c true if no byte remains.
+     */
+    bool eof() const
+    {
+        return m_pos == m_buffer.size();
+    }
+
+protected:
+    const char* get(size_t n)
+    {
+        if (m_buffer.size() - m_pos < n) {
+            throw checkpoint_error("A checkpoint is truncated");
+        }
+        const char* p = m_buffer.data() + m_pos;
+        m_pos += n;
+        return p;
+    }
+};
+
+/**
+ * A checkpoint file of a training process.
+ *
+ *  A training algorithm stores its state at the end of every interval-th
+ *  iteration with save(), and restores the state stored last with load()
+ *  when the training resumes. A file starts with a magic string, the name
+ *  of the state, and the signature of the training (e.g., the options and
+ *  data files) so that a state is not restored to a different training.
+ *
+ *  A thread writes a state while the training proceeds to the next
+ *  iterations; the state is written to a temporary file, which then
+ *  replaces the checkpoint file so that a process killed while writing a
+ *  state leaves the previous checkpoint intact. An error of writing a state
+ *  is thrown by the next call of save() or wait().
+ */
+class checkpoint
+{
+protected:
+    /// A task writing a state to the file.
+    struct write_task
+    {
+        /// The name of the checkpoint file.
+        std::string filename;
+        /// The bytes of the state.
+        std::string buffer;
+        /// The error message (empty for no error).
+        std::string error;
+
+        void run()
+        {
+            const std::string tmp = filename + ".tmp";
+            std::FILE* fp = std::fopen(tmp.c_str(), "wb");
+            if (fp == NULL) {
+                error = "Failed to open a checkpoint file for writing: " + tmp;
+                return;
+            }
+            const size_t n = std::fwrite(buffer.data(), 1, buffer.size(), fp);
+            if (std::fclose(fp) != 0 || n != buffer.size()) {
+                error = "Failed to write a checkpoint file: " + tmp;
+                return;
+            }
+#if defined(_MSC_VER)
+            std::remove(filename.c_str());
+#endif
+            if (std::rename(tmp.c_str(), filename.c_str()) != 0) {
+                error = "Failed to rename a checkpoint file: " + tmp;
+            }
+        }
+    };
+
+    /// The interval of iterations for storing states.
+    int m_interval;
+    /// The flag to restore the state stored last.
+    bool m_resume;
+    /// The signature of the training.
+    std::string m_signature;
+    /// The task writing the last state.
+    write_task m_task;
+    /// The thread running the task.
+    thread m_thread;
+
+public:
+    /**
+     * Constructs an object storing no state.
+     */
+    checkpoint() : m_interval(0), m_resume(false)
+    {
+    }
+
+    /**
+     * Constructs an object.
+     *  @param  filename        The name of the checkpoint file.
+     *  @param  interval        The interval of iterations for storing
+     *                          states.
+     *  @param  resume          \c true to restore the state stored last.
+     *  @param  signature       The signature of the training.
+     */
+    checkpoint(
+        const std::string& filename,
+        int interval,
+        bool resume,
+        const std::string& signature
+        ) : m_interval(interval), m_resume(resume), m_signature(signature)
+    {
+        m_task.filename = filename;
+    }
+
+    /**
+     * Destructs the object after waiting for the state being written.
+     */
+    virtual ~checkpoint()
+    {
+        m_thread.join();
+    }
+
+    /**
+     * Sets the checkpoint file of an object constructed without one.
+     *  @param  filename        The name of the checkpoint file.
+     *  @param  interval        The interval of iterations for storing
+     *                          states.
+     *  @param  resume          \c true to restore the state stored last.
+     *  @param  signature       The signature of the training.
+     */
+    void open(
+        const std::string& filename,
+        int interval,
+        bool resume,
+        const std::string& signature
+        )
+    {
+        m_task.filename = filename;
+        m_interval = interval;
+        m_resume = resume;
+        m_signature = signature;
+    }
+
+    /**
+     * Tests whether a state is stored at the end of an iteration.
+     *  @param  k               The iteration number (starting from one).
+     *  @return bool            \c true if a state is stored.
+     */
+    bool scheduled(int k) const
+    {
+        return 0 < m_interval && k % m_interval == 0;
+    }
+
+    /**
+     * Starts writing a state to the file.
+     *  The bytes of the state are moved from the archive.
+     *  @param  name            The name of the state.
+     *  @param  ar              The archive storing the state.
+     *  @throws checkpoint_error    Writing the previous state failed.
+     */
+    void save(const std::string& name, checkpoint_writer& ar)
+    {
+        this->wait();
+
+        checkpoint_writer header;
+        header.string(magic());
+        header.string(name);
+        header.string(m_signature);
+        m_task.buffer.swap(header.buffer());
+        m_task.buffer += ar.buffer();
+        ar.buffer().clear();
+        m_thread.start(m_task);
+    }
+
+    /**
+     * Reads the state stored last.
+     *  @param  name            The name of the state.
+     *  @param  state           The string receiving the bytes of the state.
+     *  @return bool            \c true if a state is read, \c false if the
+     *                          training does not resume or no checkpoint
+     *                          file exists.
+     *  @throws checkpoint_error    The file is not a checkpoint of the
+     *                              state of this training.
+     */
+    bool load(const std::string& name, std::string& state)
+    {
+        if (!m_resume) {
+            return false;
+        }
+
+        // Read the whole file.
+        std::string buffer;
+        std::FILE* fp = std::fopen(m_task.filename.c_str(), "rb");
+        if (fp == NULL) {
+            return false;
+        }
+        char chunk[65536];
+        for (;;) {
+            size_t n = std::fread(chunk, 1, sizeof(chunk), fp);
+            buffer.append(chunk, n);
+            if (n < sizeof(chunk)) {
+                break;
+            }
+        }
+        const bool failed = (std::ferror(fp) != 0);
+        std::fclose(fp);
+        if (failed) {
+            throw checkpoint_error("Failed to read a checkpoint file: " + m_task.filename);
+        }
+
+        // Check the header.
+        checkpoint_reader ar(buffer);
+        std::string str;
+        ar.string(str);
+        if (str != magic()) {
+            throw checkpoint_error("Not a checkpoint file: " + m_task.filename);
+        }
+        ar.string(str);
+        if (str != name) {
+            throw checkpoint_error("A checkpoint of another algorithm (" + str + "): " + m_task.filename);
+        }
+        ar.string(str);
+        if (str != m_signature) {
+            throw checkpoint_error("A checkpoint of another training (options or data files): " + m_task.filename);
+        }
+
+        // Skip the header: magic, name, and signature with their sizes.
+        const size_t header = 3 * sizeof(unsigned long long) +
+            magic().size() + name.size() + m_signature.size();
+        state.assign(buffer, header, std::string::npos);
+        return true;
+    }
+
+    /**
+     * Waits for the state being written.
+     *  @throws checkpoint_error    Writing the state failed.
+     */
+    void wait()
+    {
+        m_thread.join();
+        if (!m_task.error.empty()) {
+            std::string msg;
+            msg.swap(m_task.error);
+            throw checkpoint_error(msg);
+        }
+    }
+
+protected:
+    static std::string magic()
+    {
+        return "CLSCKPT1";
+    }
+
+private:
+    checkpoint(const checkpoint&);
+    checkpoint& operator=(const checkpoint&);
+};
+
+};
+
+#endif/*__CLASSIAS_CHECKPOINT_H__*/
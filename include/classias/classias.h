@@ -38,12 +38,19 @@
 #include "feature_generator.h"
 #include "instance.h"
 #include "data.h"
+#include "csr_data.h"
+#include "compact_vector.h"
+#include "hashed_quark.h"
+#include "memory.h"
 
 namespace classias
 {
 
-typedef std::vector<double> weight_vector;
+typedef std::vector<double, placed_allocator<double> > weight_vector;
 typedef default_vector<double> expandable_weight_vector;
+typedef compact_vector_base<float> float_weight_vector;
+typedef compact_vector_base<int16_t> int16_weight_vector;
+typedef compact_vector_base<int8_t> int8_weight_vector;
 
 typedef dense_feature_generator_base<int, int, int> dense_feature_generator;
 typedef sparse_feature_generator_base<int, int, int> sparse_feature_generator;
@@ -54,14 +61,19 @@ typedef sparse_vector_base<int, double> sparse_attributes;
 typedef binary_instance_base<sparse_attributes> binstance;
 typedef binary_data_base<binstance> bdata;
 typedef binary_data_with_quark_base<binstance, quark> bsdata;
+typedef binary_csr_data_with_quark_base<quark> bsdata_csr;
+typedef binary_data_with_quark_base<binstance, hashed_quark> bsdata_hashed;
+typedef binary_csr_data_with_quark_base<hashed_quark> bsdata_csr_hashed;
 
 typedef candidate_instance_base<sparse_attributes> cinstance;
 typedef candidate_data_base<cinstance, thru_feature_generator> cdata;
 typedef candidate_data_with_quark_base<cinstance, quark, quark, thru_feature_generator> csdata;
+typedef candidate_data_with_quark_base<cinstance, hashed_quark, quark, thru_feature_generator> csdata_hashed;
 
 typedef multi_instance_base<sparse_attributes> minstance;
 typedef multi_data_base<minstance, dense_feature_generator> mdata;
 typedef multi_data_with_quark_base<minstance, quark, quark, dense_feature_generator> msdata;
+typedef multi_data_with_quark_base<minstance, hashed_quark, quark, dense_feature_generator> msdata_hashed;
 
 typedef multi_instance_base<sparse_attributes> ninstance;
 typedef multi_data_base<ninstance, sparse_feature_generator> ndata;
@@ -90,6 +102,10 @@ typedef multi_data_with_quark_base<ninstance, quark, quark, sparse_feature_gener
         \ref classias::binary_data_base
     - Binary data set with a string quark for attributes:
         \ref classias::binary_data_with_quark_base
+    - Binary data set in a flat CSR layout:
+        \ref classias::binary_csr_data_base
+    - Binary data set in a flat CSR layout with a string quark for attributes:
+        \ref classias::binary_csr_data_with_quark_base
     - Multi-class data set:
         \ref classias::multi_data_base
     - Multi-class data set with string quarks for attributes and labels:
@@ -145,10 +161,16 @@ typedef multi_data_with_quark_base<ninstance, quark, quark, sparse_feature_gener
         \ref classias::group_base
     - Sparse vector:
         \ref classias::sparse_vector_base
+    - Weight vector in single precision or quantized integers:
+        \ref classias::compact_vector_base
     - Quark with one item (item-to-integer mapping):
         \ref classias::quark_base
     - Quark with two items (item-pair-to-integer mapping):
         \ref classias::quark2_base
+    - Quark shared by multiple threads (with deterministic identifiers):
+        \ref classias::concurrent_quark_base
+    - Quark mapping items to hashed identifiers (feature hashing):
+        \ref classias::hashed_quark_base
     - Quark exception:
         \ref classias::quark_error
 - Miscellaneous utilities
@@ -0,0 +1,426 @@
+/*
+ *		Batch prediction with linear models.
+ *
+ * Copyright (c) 2008,2009 Naoaki Okazaki
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the names of the authors nor the names of its contributors
+ *       may be used to endorse or promote products derived from this
+ *       software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/* $Id$ */
+
+#ifndef __CLASSIAS_CLASSIFY_LINEAR_BATCH_H__
+#define __CLASSIAS_CLASSIFY_LINEAR_BATCH_H__
+
+#include <cmath>
+#include <cstddef>
+
+#include <classias/csr_data.h>
+#include <classias/feature_generator.h>
+#include <classias/simd.h>
+#include <classias/compact_vector.h>
+
+namespace classias
+{
+
+namespace classify
+{
+
+/*
+The functions in this file score a block of instances at a time. Unlike the
+classifier objects (linear_binary, linear_multi), which hold the scores of
+an instance, the functions keep no state and write the results to arrays
+provided by the caller; any number of threads can therefore score their own
+blocks with a read-only model shared among them. The scores and
+probabilities are the same as those computed by the classifier objects.
+*/
+
+/**
+ * A block of instances in the compressed sparse row (CSR) layout.
+ *  The elements of the instance #i are stored in the range
+ *  [offsets[i], offsets[i+1]) of the arrays ids and values. The block does
+ *  not own the arrays; the caller must keep them alive while using it.
+ */
+struct csr_block
+{
+    /// The number of instances.
+    size_t size;
+    /// The offsets of the instances (size + 1 elements).
+    const size_t* offsets;
+    /// The attribute identifiers of the elements.
+    const int* ids;
+    /// The attribute values of the elements (\c NULL if all values are 1).
+    const double* values;
+
+    /**
+     * Constructs a block on arrays.
+     *  @param  n           The number of instances.
+     *  @param  _offsets    The offsets of the instances (n + 1 elements).
+     *  @param  _ids        The attribute identifiers of the elements.
+     *  @param  _values     The attribute values of the elements, or \c NULL
+     *                      if the values are implicitly 1.
+     */
+    csr_block(
+        size_t n,
+        const size_t* _offsets,
+        const int* _ids,
+        const double* _values = NULL
+        ) : size(n), offsets(_offsets), ids(_ids), values(_values)
+    {
+    }
+
+    /**
+     * Constructs a block on the instances [first, last) of CSR arrays.
+     *  @param  arrays      The CSR arrays (not compressed) of a data set.
+     *  @param  first       The index of the first instance.
+     *  @param  last        The index just beyond the last instance.
+     */
+    csr_block(const csr_arrays& arrays, size_t first, size_t last) :
+        size(last - first), offsets(&arrays.offsets[first]),
+        ids(arrays.id_data()),
+        values(arrays.implicit_values() ? NULL : arrays.value_data())
+    {
+    }
+
+    /**
+     * Tests whether the values are implicit (all 1).
+     *  @return bool        \c true if the values are implicit.
+     */
+    inline bool implicit_values() const
+    {
+        return (values == NULL);
+    }
+};
+
+/**
+ * Computes the scores of binary classification for a block of instances.
+ *  @param  model       The model.
+ *  @param  block       The block of instances.
+ *  @param  scores      The array receiving the scores (block.size elements).
+ */
+template <class model_type>
+inline void binary_scores(
+    const model_type& model,
+    const csr_block& block,
+    double* scores
+    )
+{
+    for (size_t i = 0;i < block.size;++i) {
+        double score = 0.;
+        const int* p = block.ids + block.offsets[i];
+        const int* last = block.ids + block.offsets[i+1];
+        if (block.implicit_values()) {
+            for (;p != last;++p) {
+                score += model[*p];
+            }
+        } else {
+            const double* v = block.values + block.offsets[i];
+            for (;p != last;++p, ++v) {
+                score += model[*p] * *v;
+            }
+        }
+        scores[i] = score;
+    }
+}
+
+/**
+ * Computes the probabilities of binary classification (the logistic
+ * sigmoid of the scores) for a block of instances.
+ *  @param  model       The model.
+ *  @param  block       The block of instances.
+ *  @param  probs       The array receiving the probabilities of the
+ *                      instances being positive (block.size elements).
+ */
+template <class model_type>
+inline void binary_probs(
+    const model_type& model,
+    const csr_block& block,
+    double* probs
+    )
+{
+    binary_scores(model, block, probs);
+    for (size_t i = 0;i < block.size;++i) {
+        const double s = probs[i];
+        probs[i] = ((-100. < s) ? (1. / (1. + std::exp(-s))) : 0.);
+    }
+}
+
+/**
+ * Computes the scores of all labels for a block of multi-class instances
+ * label by label.
+ *  @param  model       The model.
+ *  @param  fgen        The feature generator.
+ *  @param  block       The block of instances.
+ *  @param  L           The number of labels.
+ *  @param  scores      The row-major matrix receiving the scores
+ *                      (block.size by L elements).
+ */
+template <class model_type, class feature_generator_type>
+inline void multi_scores_labelwise(
+    const model_type& model,
+    const feature_generator_type& fgen,
+    const csr_block& block,
+    int L,
+    double* scores
+    )
+{
+    for (size_t i = 0;i < block.size;++i) {
+        double* y = scores + i * L;
+        for (int l = 0;l < L;++l) {
+            y[l] = 0.;
+            for (size_t k = block.offsets[i];k < block.offsets[i+1];++k) {
+                typename feature_generator_type::feature_type f;
+                if (fgen.forward(block.ids[k], l, f)) {
+                    y[l] += model[f] * (block.implicit_values() ? 1. : block.values[k]);
+                }
+            }
+        }
+    }
+}
+
+/**
+ * Computes the scores of all labels for a block of multi-class instances.
+ *  @param  model       The model.
+ *  @param  fgen        The feature generator.
+ *  @param  block       The block of instances.
+ *  @param  L           The number of labels.
+ *  @param  scores      The row-major matrix receiving the scores
+ *                      (block.size by L elements).
+ */
+template <class model_type, class feature_generator_type>
+inline void multi_scores(
+    const model_type& model,
+    const feature_generator_type& fgen,
+    const csr_block& block,
+    int L,
+    double* scores
+    )
+{
+    multi_scores_labelwise(model, fgen, block, L, scores);
+}
+
+/**
+ * Computes the scores of all labels for a block of multi-class instances
+ * with a dense feature generator.
+ *  The weights of an attribute for all labels are contiguous, and are
+ *  added to the row of the scores with a vector instruction (AXPY).
+ *  @param  model       The model storing the weights in a contiguous memory
+ *                      block (e.g., \c std::vector) or a
+ *                      compact_vector_base.
+ *  @param  fgen        The feature generator.
+ *  @param  block       The block of instances.
+ *  @param  L           The number of labels.
+ *  @param  scores      The row-major matrix receiving the scores
+ *                      (block.size by L elements).
+ */
+template <class model_type, class A, class Lb, class F>
+inline void multi_scores(
+    const model_type& model,
+    const dense_feature_generator_base<A, Lb, F>& fgen,
+    const csr_block& block,
+    int L,
+    double* scores
+    )
+{
+    // Fall back to the generic computation when the weights of an
+    // attribute are not laid out for L labels.
+    if (L == 0 || (int)fgen.num_labels() != L) {
+        multi_scores_labelwise(model, fgen, block, L, scores);
+        return;
+    }
+
+    for (size_t i = 0;i < block.size;++i) {
+        double* y = scores + i * L;
+        for (int l = 0;l < L;++l) {
+            y[l] = 0.;
+        }
+        for (size_t k = block.offsets[i];k < block.offsets[i+1];++k) {
+            F f;
+            if (fgen.forward(block.ids[k], 0, f)) {
+                const double v = (block.implicit_values() ? 1. : block.values[k]);
+                axpy_model(L, v, model, (size_t)f, y);
+            }
+        }
+    }
+}
+
+/**
+ * A function object adding the weights of the postings of an attribute to
+ * a row of scores.
+ */
+template <class model_type, class feature_generator_type>
+struct posting_row_adder
+{
+    const model_type& model;
+    double* y;
+    double value;
+    int L;
+
+    posting_row_adder(const model_type& _model, double* _y, double _value, int _L)
+        : model(_model), y(_y), value(_value), L(_L)
+    {
+    }
+
+    inline void operator()(
+        const typename feature_generator_type::label_type& l,
+        const typename feature_generator_type::feature_type& f
+        )
+    {
+        if ((int)l < L) {
+            y[l] += model[f] * value;
+        }
+    }
+};
+
+/**
+ * Computes the scores of all labels for a block of multi-class instances
+ * with a sparse feature generator.
+ *  The weights are added from the posting lists of the attributes (as
+ *  linear_multi::inner_product_postings() does), which visit only the
+ *  labels having features for the attributes.
+ *  @param  model       The model.
+ *  @param  fgen        The feature generator.
+ *  @param  block       The block of instances.
+ *  @param  L           The number of labels.
+ *  @param  scores      The row-major matrix receiving the scores
+ *                      (block.size by L elements).
+ */
+template <class model_type, class A, class Lb, class F>
+inline void multi_scores(
+    const model_type& model,
+    const sparse_feature_generator_base<A, Lb, F>& fgen,
+    const csr_block& block,
+    int L,
+    double* scores
+    )
+{
+    typedef sparse_feature_generator_base<A, Lb, F> feature_generator_type;
+    for (size_t i = 0;i < block.size;++i) {
+        double* y = scores + i * L;
+        for (int l = 0;l < L;++l) {
+            y[l] = 0.;
+        }
+        for (size_t k = block.offsets[i];k < block.offsets[i+1];++k) {
+            const double v = (block.implicit_values() ? 1. : block.values[k]);
+            posting_row_adder<model_type, feature_generator_type> add(model, y, v, L);
+            fgen.postings(block.ids[k], add);
+        }
+    }
+}
+
+/**
+ * Converts the rows of scores into probabilities with the soft-max function.
+ *  @param  n           The number of rows (instances).
+ *  @param  L           The number of labels.
+ *  @param  y           The row-major matrix of scores, which receives the
+ *                      probabilities (n by L elements).
+ *  @param  fast_exp    \c true to use the fast exponential function
+ *                      (simd::exp_sum()).
+ */
+inline void multi_softmax(size_t n, int L, double* y, bool fast_exp = false)
+{
+    if (L == 0) {
+        return;
+    }
+
+    for (size_t i = 0;i < n;++i, y += L) {
+        // Start the partition factor from the maximum value.
+        double max = y[0];
+        for (int l = 0;l < L;++l) {
+            if (max < y[l]) {
+                max = y[l];
+            }
+        }
+
+        if (fast_exp) {
+            const double norm = 1. / simd::exp_sum(L, y, max, y);
+            for (int l = 0;l < L;++l) {
+                y[l] *= norm;
+            }
+        } else {
+            double sum = 0.;
+            for (int l = 0;l < L;++l) {
+                sum += std::exp(y[l] - max);
+            }
+            const double lognorm = max + std::log(sum);
+            for (int l = 0;l < L;++l) {
+                y[l] = std::exp(y[l] - lognorm);
+            }
+        }
+    }
+}
+
+/**
+ * Computes the probabilities of all labels for a block of multi-class
+ * instances.
+ *  @param  model       The model.
+ *  @param  fgen        The feature generator.
+ *  @param  block       The block of instances.
+ *  @param  L           The number of labels.
+ *  @param  probs       The row-major matrix receiving the probabilities
+ *                      (block.size by L elements).
+ *  @param  fast_exp    \c true to use the fast exponential function.
+ */
+template <class model_type, class feature_generator_type>
+inline void multi_probs(
+    const model_type& model,
+    const feature_generator_type& fgen,
+    const csr_block& block,
+    int L,
+    double* probs,
+    bool fast_exp = false
+    )
+{
+    multi_scores(model, fgen, block, L, probs);
+    multi_softmax(block.size, L, probs, fast_exp);
+}
+
+/**
+ * Finds the label with the highest score in every row of scores.
+ *  A tie is broken by the smallest index, as linear_multi::finalize() does.
+ *  @param  n           The number of rows (instances).
+ *  @param  L           The number of labels.
+ *  @param  y           The row-major matrix of scores or probabilities.
+ *  @param  argmax      The array receiving the labels (n elements); -1 is
+ *                      set if L is zero.
+ */
+inline void multi_argmax(size_t n, int L, const double* y, int* argmax)
+{
+    for (size_t i = 0;i < n;++i, y += L) {
+        int m = (0 < L ? 0 : -1);
+        for (int l = 1;l < L;++l) {
+            if (y[m] < y[l]) {
+                m = l;
+            }
+        }
+        argmax[i] = m;
+    }
+}
+
+};
+
+};
+
+#endif/*__CLASSIAS_CLASSIFY_LINEAR_BATCH_H__*/
@@ -34,6 +34,7 @@
 #define __CLASSIAS_CLASSIFY_LINEAR_BINARY_H__
 
 #include <cmath>
+#include <classias/csr_data.h>
 
 namespace classias
 {
@@ -168,6 +169,45 @@ public:
         }
     }
 
+    /**
+     * Computes the inner product between a feature vector in CSR layout and
+     * the model.
+     *  This function sums up the weights without reading and multiplying
+     *  the values if the values are implicit, and decodes compressed
+     *  identifiers by blocks.
+     *  @param  first       The iterator for the first element of attributes.
+     *  @param  last        The iterator for the element just beyond the
+     *                      last element of attributes.
+     */
+    inline void inner_product(csr_element_iterator first, csr_element_iterator last)
+    {
+        if (first.compressed()) {
+            int ids[csr_element_iterator::block_size];
+            double s = 0.;
+            this->clear();
+            while (first != last) {
+                const float* v = first.fvalue_data();
+                const int step = first.step();
+                const int n = first.decode(last, ids);
+                for (int i = 0;i < n;++i) {
+                    s += m_model[ids[i]] * v[i * step];
+                }
+            }
+            m_score = s;
+            return;
+        }
+
+        if (!first.implicit_values()) {
+            this->template inner_product<csr_element_iterator>(first, last);
+            return;
+        }
+
+        this->clear();
+        for (const int* p = first.id_data();p != last.id_data();++p) {
+            m_score += m_model[*p];
+        }
+    }
+
     /**
      * Returns the name of this classifier.
      *  @return const char* The name of the classifier.
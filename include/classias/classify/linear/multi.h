@@ -33,7 +33,16 @@
 #ifndef __CLASSIAS_CLASSIFY_LINEAR_MULTI_H__
 #define __CLASSIAS_CLASSIFY_LINEAR_MULTI_H__
 
+#include <algorithm>
 #include <cmath>
+#include <functional>
+#include <utility>
+#include <vector>
+
+#include <classias/feature_generator.h>
+#include <classias/instance.h>
+#include <classias/simd.h>
+#include <classias/compact_vector.h>
 
 namespace classias
 {
@@ -164,6 +173,16 @@ public:
         m_scores[i] *= scale;
     }
 
+    /**
+     * Adds a value to a score.
+     *  @param  i           The index for the candidate.
+     *  @param  value       The value added to the score.
+     */
+    inline void add(int i, const value_type& value)
+    {
+        m_scores[i] += value;
+    }
+
     /**
      * Sets an attribute for a candidate.
      *
@@ -224,6 +243,310 @@ public:
         }
     }
 
+    /**
+     * Computes the scores of all labels for an attribute vector.
+     *
+     *  This function sets the number of candidates to the number of labels,
+     *  and computes the score of every label #i as the inner product between
+     *  the attribute vector [first, last) and the model for the label.
+     *
+     *  @param  fgen        The feature generator.
+     *  @param  first       The iterator for the first element of attributes.
+     *  @param  last        The iterator for the element just beyond the
+     *                      last element of attributes.
+     *  @param  L           The number of labels.
+     */
+    template <class feature_generator_type, class iterator_type>
+    inline void inner_product_labels(
+        const feature_generator_type& fgen,
+        iterator_type first,
+        iterator_type last,
+        int L
+        )
+    {
+        this->resize(L);
+        for (int i = 0;i < L;++i) {
+            this->inner_product(i, fgen, first, last, i);
+        }
+    }
+
+    /**
+     * Computes the scores of all labels for an attribute vector with a
+     * dense feature generator.
+     *
+     *  A dense feature generator lays out the weights of an attribute for
+     *  all labels contiguously, which allows this function to update the
+     *  scores of all labels with a vector instruction (AXPY) for every
+     *  attribute. The model must store its weights in a contiguous memory
+     *  block (e.g., \c std::vector) or be a compact_vector_base.
+     *
+     *  @param  fgen        The feature generator.
+     *  @param  first       The iterator for the first element of attributes.
+     *  @param  last        The iterator for the element just beyond the
+     *                      last element of attributes.
+     *  @param  L           The number of labels.
+     */
+    template <class A, class Lb, class F, class iterator_type>
+    inline void inner_product_labels(
+        const dense_feature_generator_base<A, Lb, F>& fgen,
+        iterator_type first,
+        iterator_type last,
+        int L
+        )
+    {
+        // Fall back to the generic computation when the weights of an
+        // attribute are not laid out for L labels.
+        if (L == 0 || (int)fgen.num_labels() != L) {
+            this->resize(L);
+            for (int i = 0;i < L;++i) {
+                this->inner_product(i, fgen, first, last, i);
+            }
+            return;
+        }
+
+        this->resize(L);
+        for (int i = 0;i < L;++i) {
+            m_scores[i] = 0.;
+        }
+        for (iterator_type it = first;it != last;++it) {
+            F f;
+            if (fgen.forward(it->first, 0, f)) {
+                axpy_model(L, it->second, m_model, (size_t)f, &m_scores[0]);
+            }
+        }
+    }
+
+    /**
+     * Computes the scores of all labels for an attribute vector from the
+     * posting lists of the attributes.
+     *
+     *  The feature generator must implement postings(a, func), which calls
+     *  func(l, f) for every label l having a feature f for the attribute a.
+     *  This function touches only the labels that have features for the
+     *  attributes instead of computing the feature of every label.
+     *
+     *  @param  fgen        The feature generator.
+     *  @param  first       The iterator for the first element of attributes.
+     *  @param  last        The iterator for the element just beyond the
+     *                      last element of attributes.
+     *  @param  L           The number of labels.
+     */
+    template <class feature_generator_type, class iterator_type>
+    inline void inner_product_postings(
+        const feature_generator_type& fgen,
+        iterator_type first,
+        iterator_type last,
+        int L
+        )
+    {
+        this->resize(L);
+        for (int i = 0;i < L;++i) {
+            m_scores[i] = 0.;
+        }
+        for (iterator_type it = first;it != last;++it) {
+            posting_adder<feature_generator_type> add(m_model, m_scores, it->second, L);
+            fgen.postings(it->first, add);
+        }
+    }
+
+    /**
+     * Computes the scores of all labels for an attribute vector with a
+     * sparse feature generator.
+     *  The scores are computed from the posting lists of the attributes
+     *  (see inner_product_postings()).
+     *  @param  fgen        The feature generator.
+     *  @param  first       The iterator for the first element of attributes.
+     *  @param  last        The iterator for the element just beyond the
+     *                      last element of attributes.
+     *  @param  L           The number of labels.
+     */
+    template <class A, class Lb, class F, class iterator_type>
+    inline void inner_product_labels(
+        const sparse_feature_generator_base<A, Lb, F>& fgen,
+        iterator_type first,
+        iterator_type last,
+        int L
+        )
+    {
+        this->inner_product_postings(fgen, first, last, L);
+    }
+
+    /**
+     * Computes the upper bounds of the contributions of attributes to the
+     * scores of labels (see inner_product_postings_top()).
+     *  @param  fgen        The feature generator implementing postings().
+     *  @param  A           The number of attributes.
+     *  @param  bounds      The vector receiving the maximum of the absolute
+     *                      weights in the posting list of every attribute.
+     */
+    template <class feature_generator_type, class bounds_type>
+    inline void posting_bounds(
+        const feature_generator_type& fgen,
+        int A,
+        bounds_type& bounds
+        ) const
+    {
+        bounds.assign(A, 0.);
+        for (int a = 0;a < A;++a) {
+            posting_maximizer<feature_generator_type, typename bounds_type::value_type>
+                maximize(m_model, bounds[a]);
+            fgen.postings(a, maximize);
+        }
+    }
+
+    /**
+     * Computes the scores of the k best labels for an attribute vector from
+     * the posting lists of the attributes.
+     *
+     *  This function bounds the contribution of an attribute to the score
+     *  of any label by |value| * bounds[a], and accumulates the postings of
+     *  the attributes in descending order of their bounds. Whenever the
+     *  bound of the remaining attributes is halved, the labels that cannot
+     *  reach the k-th highest score any more are discarded from the
+     *  candidates. As soon as only k labels remain, the remaining postings
+     *  are skipped and the scores of the k labels are recomputed in the
+     *  order of the attribute vector. The scores of the k best labels and
+     *  argmax() are thus identical to those of inner_product_postings();
+     *  the scores of the other labels may be left incomplete (but below
+     *  those of the k best labels), so that the probabilities are not
+     *  available.
+     *
+     *  @param  fgen        The feature generator.
+     *  @param  first       The random access iterator for the first element
+     *                      of attributes.
+     *  @param  last        The iterator for the element just beyond the
+     *                      last element of attributes.
+     *  @param  L           The number of labels.
+     *  @param  k           The number of the best labels.
+     *  @param  bounds      The bounds computed by posting_bounds().
+     */
+    template <class feature_generator_type, class iterator_type, class bounds_type>
+    inline void inner_product_postings_top(
+        const feature_generator_type& fgen,
+        iterator_type first,
+        iterator_type last,
+        int L,
+        int k,
+        const bounds_type& bounds
+        )
+    {
+        if (k <= 0 || L <= k) {
+            this->inner_product_postings(fgen, first, last, L);
+            return;
+        }
+
+        // Order the attributes by the bounds of their contributions.
+        const int n = (int)(last - first);
+        value_type total = 0.;
+        m_order.clear();
+        for (int j = 0;j < n;++j) {
+            const int a = (int)first[j].first;
+            value_type b = 0.;
+            if (0 <= a && (size_t)a < bounds.size()) {
+                b = bounds[a] * std::fabs((value_type)first[j].second);
+            }
+            m_order.push_back(std::make_pair(-b, j));
+            total += b;
+        }
+        std::sort(m_order.begin(), m_order.end());
+
+        this->resize(L);
+        for (int i = 0;i < L;++i) {
+            m_scores[i] = 0.;
+        }
+
+        // A margin for the rounding errors of the scores.
+        const value_type margin = total * 1e-10;
+
+        // Discard the labels whenever the bound of the remaining attributes
+        // is halved.
+        bool determined = false;
+        value_type r = total, check = total / 2;
+        m_alive.clear();
+        for (int j = 0;j < n;++j) {
+            iterator_type it = first + m_order[j].second;
+            posting_adder<feature_generator_type> add(m_model, m_scores, it->second, L);
+            fgen.postings(it->first, add);
+            r += m_order[j].first;
+
+            if (j + 1 == n || r <= check) {
+                if (this->discard_labels(L, k, 2 * r + margin)) {
+                    determined = true;
+                    break;
+                }
+                check = r / 2;
+            }
+        }
+
+        if (!determined) {
+            // The scores are too close to choose the k best labels.
+            this->inner_product_postings(fgen, first, last, L);
+            return;
+        }
+
+        // Recompute the scores of the k best labels in the original order.
+        for (int j = 0;j < k;++j) {
+            const int l = m_alive[j];
+            this->inner_product(l, fgen, first, last, l);
+        }
+    }
+
+    /**
+     * Computes the scores of all candidates of an instance.
+     *  The inner product of the attributes shared by the candidates is
+     *  computed once and added to the score of every candidate.
+     *  @param  fgen        The feature generator.
+     *  @param  inst        The instance.
+     *  @param  L           The number of labels.
+     */
+    template <class feature_generator_type, class instance_type>
+    inline void inner_product_instance(
+        const feature_generator_type& fgen,
+        const instance_type& inst,
+        int L
+        )
+    {
+        typedef typename instance_type::attributes_type attributes_type;
+
+        // The score of the shared attributes.
+        value_type s = 0.;
+        const attributes_type* shared = shared_attributes(inst);
+        if (shared != NULL) {
+            typename attributes_type::const_iterator it;
+            for (it = shared->begin();it != shared->end();++it) {
+                typename feature_generator_type::feature_type f;
+                if (fgen.forward(it->first, 0, f)) {
+                    s += m_model[f] * it->second;
+                }
+            }
+        }
+
+        const int n = inst.num_candidates(L);
+        this->resize(n);
+        for (int i = 0;i < n;++i) {
+            this->inner_product(
+                i, fgen, inst.attributes(i).begin(), inst.attributes(i).end(), i);
+            m_scores[i] += s;
+        }
+    }
+
+    /**
+     * Computes the scores of all candidates of a multi-class instance.
+     *  The candidates of a multi-class instance share the attribute vector.
+     *  @param  fgen        The feature generator.
+     *  @param  inst        The instance.
+     *  @param  L           The number of labels.
+     */
+    template <class feature_generator_type, class T, class W, class G>
+    inline void inner_product_instance(
+        const feature_generator_type& fgen,
+        const multi_instance_base<T, W, G>& inst,
+        int L
+        )
+    {
+        this->inner_product_labels(fgen, inst.begin(), inst.end(), L);
+    }
+
     /**
      * Finalize the classification.
      *  Call this function before using argmax() function.
@@ -245,6 +568,35 @@ public:
         }
     }
 
+    /**
+     * Finds the candidates of the k highest scores.
+     *  This function selects the k candidates by a partial selection, and
+     *  sorts only these candidates. Candidates having the same score are
+     *  ordered by their indices as argmax() chooses the first one.
+     *  @param  k           The number of candidates.
+     *  @param  indices     The vector receiving the indices of min(k, size())
+     *                      candidates in descending order of their scores.
+     */
+    inline void top(int k, std::vector<int>& indices) const
+    {
+        const int n = this->size();
+        if (n < k) {
+            k = n;
+        }
+
+        indices.resize(n);
+        for (int i = 0;i < n;++i) {
+            indices[i] = i;
+        }
+
+        score_greater greater(m_scores);
+        if (k < n) {
+            std::nth_element(indices.begin(), indices.begin() + k, indices.end(), greater);
+        }
+        std::sort(indices.begin(), indices.begin() + k, greater);
+        indices.resize(k);
+    }
+
     /**
      * Returns the name of this classifier.
      *  @return const char* The name of the classifier.
@@ -254,6 +606,131 @@ public:
         const static char *str = "linear classifier (multi)";
         return str;
     }
+
+protected:
+    /// The attributes in descending order of the bounds of contributions.
+    std::vector<std::pair<value_type, int> > m_order;
+    /// The labels that can still be one of the k best labels.
+    std::vector<int> m_alive;
+    /// The working space for finding the k-th highest score.
+    scores_type     m_work;
+
+    /**
+     * Discards the labels that cannot be one of the k best labels.
+     *  @param  L           The number of labels.
+     *  @param  k           The number of the best labels.
+     *  @param  gap         The maximum increase of the difference between
+     *                      two scores by the remaining attributes.
+     *  @return bool        \c true if only k labels remain.
+     */
+    inline bool discard_labels(int L, int k, const value_type& gap)
+    {
+        // Start with all labels.
+        if (m_alive.empty()) {
+            for (int l = 0;l < L;++l) {
+                m_alive.push_back(l);
+            }
+        }
+
+        // Find the k-th highest score of the remaining labels.
+        const int n = (int)m_alive.size();
+        m_work.resize(n);
+        for (int j = 0;j < n;++j) {
+            m_work[j] = m_scores[m_alive[j]];
+        }
+        std::nth_element(
+            m_work.begin(), m_work.begin() + (k-1), m_work.end(),
+            std::greater<value_type>());
+        const value_type threshold = m_work[k-1] - gap;
+
+        // Keep the labels that may reach the k-th highest score.
+        int m = 0;
+        for (int j = 0;j < n;++j) {
+            if (threshold <= m_scores[m_alive[j]]) {
+                m_alive[m++] = m_alive[j];
+            }
+        }
+        m_alive.resize(m);
+        return (m == k);
+    }
+
+    /**
+     * A function object ordering candidates in descending order of scores.
+     */
+    struct score_greater
+    {
+        const scores_type& scores;
+
+        score_greater(const scores_type& _scores) : scores(_scores)
+        {
+        }
+
+        inline bool operator()(int x, int y) const
+        {
+            return (scores[y] < scores[x] || (scores[x] == scores[y] && x < y));
+        }
+    };
+
+    /**
+     * A function object finding the maximum of the absolute weights in the
+     * postings of an attribute.
+     */
+    template <class feature_generator_type, class bound_type>
+    struct posting_maximizer
+    {
+        const model_type& model;
+        bound_type& bound;
+
+        posting_maximizer(
+            const model_type& _model,
+            bound_type& _bound
+            ) : model(_model), bound(_bound)
+        {
+        }
+
+        inline void operator()(
+            const typename feature_generator_type::label_type& l,
+            const typename feature_generator_type::feature_type& f
+            )
+        {
+            bound_type w = (bound_type)std::fabs((double)model[f]);
+            if (bound < w) {
+                bound = w;
+            }
+        }
+    };
+
+    /**
+     * A function object adding the weights of the postings of an attribute
+     * to the scores of the labels.
+     */
+    template <class feature_generator_type>
+    struct posting_adder
+    {
+        const model_type& model;
+        scores_type& scores;
+        value_type value;
+        int L;
+
+        posting_adder(
+            const model_type& _model,
+            scores_type& _scores,
+            const value_type& _value,
+            int _L
+            ) : model(_model), scores(_scores), value(_value), L(_L)
+        {
+        }
+
+        inline void operator()(
+            const typename feature_generator_type::label_type& l,
+            const typename feature_generator_type::feature_type& f
+            )
+        {
+            if ((int)l < L) {
+                scores[l] += model[f] * value;
+            }
+        }
+    };
 };
 
 
@@ -295,7 +772,16 @@ public:
     typedef linear_multi<model_tmpl> base_type;
 
 protected:
+    /// The type representing an array of probabilities.
+    typedef typename base_type::scores_type probs_type;
+
     value_type  m_lognorm;
+    /// The flag indicating whether the partition factor is computed.
+    bool        m_normalized;
+    /// The flag indicating whether finalize() uses the fast exponential.
+    bool        m_fast_exp;
+    /// The probabilities of labels computed by the fast exponential.
+    probs_type  m_probs;
 
 public:
     /**
@@ -303,7 +789,7 @@ public:
      *  @param  model       The model associated with the classifier.
      */
     linear_multi_logistic(const model_type& model)
-        : base_type(model), m_lognorm(0)
+        : base_type(model), m_lognorm(0), m_normalized(true), m_fast_exp(false)
     {
         clear();
     }
@@ -323,6 +809,21 @@ public:
     {
         base_type::clear();
         m_lognorm = 0.;
+        m_normalized = true;
+    }
+
+    /**
+     * Chooses the exponential function used by finalize().
+     *  With the exact mode (default), the probabilities are computed by
+     *  std::exp() one by one. With the fast mode, finalize() computes the
+     *  probabilities of all candidates at a time with a vectorized
+     *  polynomial approximation (simd::exp_sum()), whose relative error is
+     *  below 1e-14.
+     *  @param  fast        \c true to use the fast exponential function.
+     */
+    inline void set_fast_exp(bool fast)
+    {
+        m_fast_exp = fast;
     }
 
     /**
@@ -332,6 +833,12 @@ public:
      */
     inline value_type prob(int i)
     {
+        if (!m_normalized) {
+            this->normalize();
+        }
+        if (m_fast_exp) {
+            return m_probs[i];
+        }
         return std::exp(this->m_scores[i] - m_lognorm);
     }
 
@@ -342,6 +849,9 @@ public:
      */
     inline value_type logprob(int i)
     {
+        if (!m_normalized) {
+            this->normalize();
+        }
         return (this->m_scores[i] - m_lognorm);
     }
 
@@ -359,23 +869,14 @@ public:
     /**
      * Finalize the classification.
      *  Call this function before using argmax(), prob(), logprob(),
-     *  and error() function.
+     *  and error() function. The partition factor is computed on the first
+     *  call of prob(), logprob(), or error() so that the soft-max function
+     *  is skipped when only argmax() and scores are necessary.
      */
     inline void finalize()
     {
         base_type::finalize();
-
-        if (this->size() == 0) {
-            return;
-        }
-
-        // Compute the partition factor, starting from the maximum value.
-        value_type sum = 0.;
-        value_type max = this->m_scores[this->m_argmax];
-        for (int i = 0;i < this->size();++i) {
-            sum += std::exp(this->m_scores[i] - max);
-        }
-        m_lognorm = max + std::log(sum);
+        m_normalized = (this->size() == 0);
     }
 
     /**
@@ -387,6 +888,35 @@ public:
         const static char *str = "linear classifier (multi) with logistic loss";
         return str;
     }
+
+protected:
+    /**
+     * Computes the partition factor (and the probabilities of all
+     * candidates with the fast exponential function).
+     */
+    inline void normalize()
+    {
+        m_normalized = true;
+
+        // Compute the partition factor, starting from the maximum value.
+        value_type sum = 0.;
+        value_type max = this->m_scores[this->m_argmax];
+        if (m_fast_exp) {
+            // Compute the probabilities of all candidates at a time.
+            const int n = this->size();
+            m_probs.resize(n);
+            sum = simd::exp_sum(n, &this->m_scores[0], max, &m_probs[0]);
+            const value_type norm = 1. / sum;
+            for (int i = 0;i < n;++i) {
+                m_probs[i] *= norm;
+            }
+        } else {
+            for (int i = 0;i < this->size();++i) {
+                sum += std::exp(this->m_scores[i] - max);
+            }
+        }
+        m_lognorm = max + std::log(sum);
+    }
 };
 
 };
@@ -0,0 +1,301 @@
+/*
+ *		Weight vectors in single precision and quantized integers.
+ *
+ * Copyright (c) 2008,2009 Naoaki Okazaki
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the names of the authors nor the names of its contributors
+ *       may be used to endorse or promote products derived from this
+ *       software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* $Id$ */
+
+#ifndef __CLASSIAS_COMPACT_VECTOR_H__
+#define __CLASSIAS_COMPACT_VECTOR_H__
+
+#include <cmath>
+#include <vector>
+#include <stdint.h>
+#include <classias/memory.h>
+#include <classias/simd.h>
+
+namespace classias
+{
+
+/**
+ * Traits of the element types of compact vectors.
+ *  A quantized type stores an element as an integer code that is multiplied
+ *  by the scale of the block to which the element belongs; max_code() is the
+ *  largest magnitude of a code. A type that is not quantized (float) stores
+ *  an element as it is.
+ */
+template <class code_tmpl>
+struct compact_code_traits
+{
+    enum { quantized = 1 };
+    static double max_code();
+};
+
+template <>
+struct compact_code_traits<float>
+{
+    enum { quantized = 0 };
+    static double max_code() { return 0.; }
+};
+
+template <>
+struct compact_code_traits<int16_t>
+{
+    enum { quantized = 1 };
+    static double max_code() { return 32767.; }
+};
+
+template <>
+struct compact_code_traits<int8_t>
+{
+    enum { quantized = 1 };
+    static double max_code() { return 127.; }
+};
+
+/**
+ * A read-only weight vector in a compact representation.
+ *
+ *  This template class stores the weights of a model in single precision
+ *  (\c float) or as integers quantized with a scale for every block of
+ *  consecutive elements (\c int16_t and \c int8_t), and yields the weights
+ *  in double precision with operator \c []. A model of this type can thus
+ *  be used in place of \c std::vector<double> by the classifiers, which
+ *  accumulate the scores in double precision; the model takes 1/2, 1/4, or
+ *  1/8 of the memory and of the memory bandwidth for scoring.
+ *
+ *  The scale of a block is the largest magnitude of the weights in the
+ *  block divided by the largest code, so that the quantization error of a
+ *  weight is at most a half of the scale. Choose a block size that groups
+ *  weights of similar magnitudes (e.g., the number of labels for a dense
+ *  multi-class model, which assigns a scale to each attribute).
+ *
+ *  @param  code_tmpl       The element type (\c float, \c int16_t, or
+ *                          \c int8_t).
+ */
+template <class code_tmpl>
+class compact_vector_base
+{
+public:
+    /// The type of an element stored in the vector.
+    typedef code_tmpl code_type;
+    /// The type of a weight.
+    typedef double value_type;
+    /// The type of an index.
+    typedef size_t size_type;
+
+protected:
+    /// The traits of the element type.
+    typedef compact_code_traits<code_type> traits_type;
+
+    /// The array of elements.
+    std::vector<code_type, placed_allocator<code_type> > m_codes;
+    /// The array of the scales of blocks (empty for float elements).
+    std::vector<float> m_scales;
+    /// The number of elements in a block.
+    size_type m_block_size;
+
+public:
+    /**
+     * Constructs an object.
+     *  @param  block_size  The number of elements sharing a scale.
+     */
+    compact_vector_base(size_type block_size = 64)
+        : m_block_size(block_size < 1 ? 1 : block_size)
+    {
+    }
+
+    /**
+     * Destructs the object.
+     */
+    virtual ~compact_vector_base()
+    {
+    }
+
+    /**
+     * Converts weights into the compact representation.
+     *  @param  first       The iterator for the first weight.
+     *  @param  last        The iterator for the element just beyond the
+     *                      last weight.
+     */
+    template <class iterator_type>
+    void assign(iterator_type first, iterator_type last)
+    {
+        std::vector<double> w(first, last);
+        const size_type n = w.size();
+        m_codes.resize(n);
+        m_scales.clear();
+
+        if (!traits_type::quantized) {
+            for (size_type i = 0;i < n;++i) {
+                m_codes[i] = (code_type)w[i];
+            }
+            return;
+        }
+
+        const double max_code = traits_type::max_code();
+        for (size_type b = 0;b < n;b += m_block_size) {
+            const size_type e = (n < b + m_block_size ? n : b + m_block_size);
+
+            // Find the largest magnitude in the block.
+            double amax = 0.;
+            for (size_type i = b;i < e;++i) {
+                amax = (amax < std::fabs(w[i]) ? std::fabs(w[i]) : amax);
+            }
+
+            // Round the weights to the nearest codes.
+            const float scale = (float)(amax / max_code);
+            m_scales.push_back(scale);
+            for (size_type i = b;i < e;++i) {
+                double c = (0. < scale ? std::floor(w[i] / scale + 0.5) : 0.);
+                c = (max_code < c ? max_code : c);
+                c = (c < -max_code ? -max_code : c);
+                m_codes[i] = (code_type)c;
+            }
+        }
+    }
+
+    /**
+     * Returns the number of elements.
+     *  @return size_type   The number of elements.
+     */
+    inline size_type size() const
+    {
+        return m_codes.size();
+    }
+
+    /**
+     * Tests whether the vector is empty.
+     *  @return bool        \c true if the vector has no element.
+     */
+    inline bool empty() const
+    {
+        return m_codes.empty();
+    }
+
+    /**
+     * Returns the number of elements in a block.
+     *  @return size_type   The block size.
+     */
+    inline size_type block_size() const
+    {
+        return m_block_size;
+    }
+
+    /**
+     * Returns the pointer to the array of elements.
+     *  @return const code_type*    The pointer to the first element.
+     */
+    inline const code_type* codes() const
+    {
+        return m_codes.empty() ? NULL : &m_codes[0];
+    }
+
+    /**
+     * Returns the pointer to the array of the scales of blocks.
+     *  @return const float*    The pointer to the scale of the first block,
+     *                          or \c NULL for float elements.
+     */
+    inline const float* scales() const
+    {
+        return m_scales.empty() ? NULL : &m_scales[0];
+    }
+
+    /**
+     * Returns the weight of an element.
+     *  @param  i           The index of the element.
+     *  @return value_type  The weight.
+     */
+    inline value_type operator[](size_type i) const
+    {
+        if (traits_type::quantized) {
+            return m_codes[i] * (double)m_scales[i / m_block_size];
+        } else {
+            return m_codes[i];
+        }
+    }
+
+    /**
+     * Computes y += a * w[f..f+n) with the SIMD kernels.
+     *  @param  n           The number of elements.
+     *  @param  a           The scalar.
+     *  @param  f           The index of the first element.
+     *  @param  y           The array y to which this function adds the
+     *                      scaled weights.
+     */
+    inline void axpy(int n, double a, size_type f, double *y) const
+    {
+        if (!traits_type::quantized) {
+            simd::axpy(n, a, &m_codes[f], y);
+            return;
+        }
+
+        // Apply the kernel to each range within a block.
+        while (0 < n) {
+            const size_type b = f / m_block_size;
+            int m = (int)((b + 1) * m_block_size - f);
+            m = (n < m ? n : m);
+            simd::axpy(m, a * m_scales[b], &m_codes[f], y);
+            f += m;
+            y += m;
+            n -= m;
+        }
+    }
+};
+
+/**
+ * Computes y += a * model[f..f+n) for a model storing the weights in a
+ * contiguous memory block (e.g., \c std::vector<double>).
+ *  @param  n           The number of elements.
+ *  @param  a           The scalar.
+ *  @param  model       The model.
+ *  @param  f           The index of the first element.
+ *  @param  y           The array y to which this function adds the weights.
+ */
+template <class model_type>
+inline void axpy_model(int n, double a, const model_type& model, size_t f, double *y)
+{
+    simd::axpy(n, a, &model[f], y);
+}
+
+/**
+ * Computes y += a * model[f..f+n) for a compact model.
+ *  @param  n           The number of elements.
+ *  @param  a           The scalar.
+ *  @param  model       The model.
+ *  @param  f           The index of the first element.
+ *  @param  y           The array y to which this function adds the weights.
+ */
+template <class code_tmpl>
+inline void axpy_model(int n, double a, const compact_vector_base<code_tmpl>& model, size_t f, double *y)
+{
+    model.axpy(n, a, f, y);
+}
+
+};
+
+#endif/*__CLASSIAS_COMPACT_VECTOR_H__*/
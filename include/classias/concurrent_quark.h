@@ -0,0 +1,424 @@
+/*
+ *		Quark that can be shared by multiple threads.
+ *
+ * Copyright (c) 2008,2009 Naoaki Okazaki
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the names of the authors nor the names of its contributors
+ *       may be used to endorse or promote products derived from this
+ *       software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* $Id$ */
+
+#ifndef __CLASSIAS_CONCURRENT_QUARK_H__
+#define __CLASSIAS_CONCURRENT_QUARK_H__
+
+#include <algorithm>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "quark.h"
+#include "thread.h"
+
+namespace classias {
+
+/**
+ * Hash function choosing the shard of an item.
+ *  This generic version supports items convertible to an integer; the
+ *  specializations below support strings and pairs of integers.
+ *
+ *  @param  item_base       The type of an item.
+ */
+template <class item_base>
+struct shard_hash
+{
+    inline size_t operator()(const item_base& x) const
+    {
+        return (size_t)x * 2654435761U;
+    }
+};
+
+/**
+ * Hash function choosing the shard of a string (FNV-1a).
+ */
+template <>
+struct shard_hash<std::string>
+{
+    inline size_t operator()(const std::string& x) const
+    {
+        size_t h = 2166136261U;
+        for (std::string::const_iterator it = x.begin();it != x.end();++it) {
+            h ^= (unsigned char)*it;
+            h *= 16777619U;
+        }
+        return h;
+    }
+};
+
+/**
+ * Hash function choosing the shard of a pair of integers.
+ */
+template <>
+struct shard_hash<std::pair<int, int> >
+{
+    inline size_t operator()(const std::pair<int, int>& x) const
+    {
+        return ((size_t)x.first * 2654435761U) ^ (size_t)x.second;
+    }
+};
+
+
+
+/**
+ * Quark for associating an item with an identifier from multiple threads.
+ *
+ *  This class exposes the interface of \ref quark_base and can thus be used
+ *  for the quark parameters of the data sets (e.g., \ref
+ *  binary_data_with_quark_base). Items are distributed to a fixed number of
+ *  shards, each of which is a forward map guarded by a mutex of its own, so
+ *  that threads interning different items seldom wait for each other. Only
+ *  the assignment of a new identifier takes a lock shared by all threads.
+ *
+ *  Identifiers assigned by threads depend on the timing of the threads. In
+ *  the deterministic mode (see set_deterministic()), the quark additionally
+ *  records the smallest sequence number, such as the position in the data,
+ *  with which each item was associated; freeze() then renumbers the items
+ *  in the order of the sequence numbers, i.e., the order in which a single
+ *  thread would have seen the items, and returns the mapping from the old
+ *  identifiers to the new ones so that the caller can rewrite the
+ *  identifiers stored in instances.
+ *
+ *  The functions size(), exists(), associate(), and to_value() can be called
+ *  concurrently. The functions to_item(), freeze(), and the copy operations
+ *  must not be called while other threads modify the quark.
+ *
+ *  @param  item_base       The type of an item.
+ *  @param  num_shards      The number of shards.
+ */
+template <class item_base, int num_shards = 64>
+class concurrent_quark_base {
+public:
+    /// The type representing an item.
+    typedef item_base item_type;
+    /// The type of this class.
+    typedef concurrent_quark_base<item_base, num_shards> this_class;
+
+    /// The type implementing a vector of items.
+    typedef std::vector<item_type> inverse_map_type;
+    /// The type representing a unique identifier.
+    typedef typename inverse_map_type::size_type value_type;
+    /// The type representing a sequence number.
+    typedef size_t sequence_type;
+    /// The type of a vector mapping old identifiers to new identifiers.
+    typedef std::vector<value_type> remap_type;
+
+protected:
+    /// An identifier and the smallest sequence number of an item.
+    struct entry_type
+    {
+        value_type value;
+        sequence_type seq;
+    };
+
+    /// The type associating an item to its entry.
+    typedef UNORDERED_MAP<item_type, entry_type> forward_map_type;
+
+    /// A shard of the forward map.
+    struct shard_type
+    {
+        mutable mutex lock;
+        forward_map_type fwd;
+    };
+
+    /// Forward mapping: item -> value (in the shards).
+    shard_type m_shards[num_shards];
+    /// Inverse mapping: value -> item.
+    inverse_map_type m_inv;
+    /// The mutex guarding the inverse mapping.
+    mutable mutex m_inv_lock;
+    /// The flag for the deterministic mode.
+    bool m_deterministic;
+
+public:
+    /**
+     * Constructs the object.
+     */
+    concurrent_quark_base() : m_deterministic(false)
+    {
+    }
+
+    /**
+     * Constructs the object by copying the source object.
+     *  @param  src             The source object.
+     */
+    concurrent_quark_base(const this_class& src)
+    {
+        operator=(src);
+    }
+
+    /**
+     * Destructs the object.
+     */
+    virtual ~concurrent_quark_base()
+    {
+    }
+
+    /**
+     * Copies another object to this object.
+     *  @param  src             The source object.
+     *  @return this_class&     The reference to this object.
+     */
+    this_class& operator=(const this_class& src)
+    {
+        if (this != &src) {
+            for (int i = 0;i < num_shards;++i) {
+                m_shards[i].fwd = src.m_shards[i].fwd;
+            }
+            m_inv = src.m_inv;
+            m_deterministic = src.m_deterministic;
+        }
+        return *this;
+    }
+
+    /**
+     * Enables or disables the deterministic mode.
+     *  @param  deterministic   \c true to record the sequence numbers of
+     *                          items for freeze().
+     */
+    void set_deterministic(bool deterministic)
+    {
+        m_deterministic = deterministic;
+    }
+
+    /**
+     * Returns the number of item-identifier associations.
+     *  @retval value_type      The number of associations between items and
+     *                          identifiers.
+     */
+    inline value_type size() const
+    {
+        scoped_lock lock(m_inv_lock);
+        return m_inv.size();
+    }
+
+    /**
+     * Tests whether an item has an identifier assigned.
+     *  @param  x               The item.
+     *  @retval bool            \c true if the item is known.
+     */
+    inline bool exists(const item_type& x)
+    {
+        shard_type& s = shard(x);
+        scoped_lock lock(s.lock);
+        return s.fwd.find(x) != s.fwd.end();
+    }
+
+    /**
+     * Assigns the unique identifier for an item.
+     *  If the item is unknown, this function assigns a new unique identifier
+     *  to the item and return it.
+     *  @param  x               The item.
+     *  @return value_type      The unique identifier.
+     */
+    inline value_type operator() (const item_type& x)
+    {
+        return associate(x);
+    }
+
+    /**
+     * Assigns a unique identifier for a new item.
+     *  If the item is unknown, this function assigns a new unique identifier
+     *  to the item and return it. If the item is known, this function returns
+     *  the existing identifier that was associated with the item. In the
+     *  deterministic mode, an item associated by this function without a
+     *  sequence number is ordered after the items with sequence numbers.
+     *  @param  x               The item.
+     *  @return value_type      The unique identifier.
+     */
+    inline value_type associate(const item_type& x)
+    {
+        return associate(x, (sequence_type)-1);
+    }
+
+    /**
+     * Assigns a unique identifier for an item seen at a sequence number.
+     *  @param  x               The item.
+     *  @param  seq             The sequence number (e.g., the position of
+     *                          the item in the data), which determines the
+     *                          order of identifiers in the deterministic
+     *                          mode.
+     *  @return value_type      The unique identifier.
+     */
+    inline value_type associate(const item_type& x, sequence_type seq)
+    {
+        shard_type& s = shard(x);
+        scoped_lock lock(s.lock);
+        typename forward_map_type::iterator it = s.fwd.find(x);
+        if (it != s.fwd.end()) {
+            if (m_deterministic && seq < it->second.seq) {
+                it->second.seq = seq;
+            }
+            return it->second.value;
+        } else {
+            entry_type e;
+            e.seq = seq;
+            {
+                scoped_lock lock_inv(m_inv_lock);
+                e.value = m_inv.size();
+                m_inv.push_back(x);
+            }
+            s.fwd.insert(typename forward_map_type::value_type(x, e));
+            return e.value;
+        }
+    }
+
+    /**
+     * Returns the unique identifier for an item.
+     *  If the item is unknown, this function throws quark_error.
+     *  @param  x               The item.
+     *  @return value_type      The unique identifier.
+     *  @throws quark_error.
+     */
+    inline value_type to_value(const item_type& x) const
+    {
+        const shard_type& s = shard(x);
+        scoped_lock lock(s.lock);
+        typename forward_map_type::const_iterator it = s.fwd.find(x);
+        if (it != s.fwd.end()) {
+            return it->second.value;
+        } else {
+            throw quark_error("Unknown forward mapping");
+        }
+    }
+
+    /**
+     * Returns the unique identifier for an item.
+     *  If the item is unknown, this function returns the default identifier.
+     *  @param  x               The item.
+     *  @param  def             The default identifier if the item is unknown.
+     *  @return value_type      The unique identifier.
+     */
+    inline value_type to_value(const item_type& x, const value_type& def) const
+    {
+        const shard_type& s = shard(x);
+        scoped_lock lock(s.lock);
+        typename forward_map_type::const_iterator it = s.fwd.find(x);
+        if (it != s.fwd.end()) {
+            return it->second.value;
+        } else {
+            return def;
+        }
+    }
+
+    /**
+     * Returns the item for the unique identifier.
+     *  If the unique identifier is unknown, this function throws quark_error.
+     *  @param  v               The unique identifier.
+     *  @return item_type&      The reference to the item associated with
+     *                          the identifier.
+     *  @throws quark_error.
+     */
+    inline const item_type& to_item(const value_type& v) const
+    {
+        if (v < m_inv.size()) {
+            return m_inv[v];
+        } else {
+            throw quark_error("Unknown inverse mapping");
+        }
+    }
+
+    /**
+     * Renumbers the items in the order of their sequence numbers.
+     *  Items with the same sequence number keep the order of their current
+     *  identifiers. This function does nothing unless the deterministic mode
+     *  is enabled.
+     *  @param  remap           The vector receiving the new identifier of
+     *                          each current identifier; it is empty if the
+     *                          identifiers are unchanged.
+     *  @return bool            \c true if any identifier is changed.
+     */
+    bool freeze(remap_type& remap)
+    {
+        remap.clear();
+        if (!m_deterministic) {
+            return false;
+        }
+
+        // Sort the current identifiers by the sequence numbers.
+        const value_type n = m_inv.size();
+        std::vector<std::pair<sequence_type, value_type> > order;
+        order.reserve(n);
+        for (int i = 0;i < num_shards;++i) {
+            typename forward_map_type::const_iterator it;
+            for (it = m_shards[i].fwd.begin();it != m_shards[i].fwd.end();++it) {
+                order.push_back(std::make_pair(it->second.seq, it->second.value));
+            }
+        }
+        std::sort(order.begin(), order.end());
+
+        // Build the mapping from old identifiers to new ones.
+        bool changed = false;
+        remap.resize(n);
+        for (value_type v = 0;v < n;++v) {
+            remap[order[v].second] = v;
+            if (order[v].second != v) {
+                changed = true;
+            }
+        }
+        if (!changed) {
+            remap.clear();
+            return false;
+        }
+
+        // Renumber the forward and inverse mappings.
+        inverse_map_type inv(n);
+        for (int i = 0;i < num_shards;++i) {
+            typename forward_map_type::iterator it;
+            for (it = m_shards[i].fwd.begin();it != m_shards[i].fwd.end();++it) {
+                it->second.value = remap[it->second.value];
+                inv[it->second.value] = it->first;
+            }
+        }
+        m_inv.swap(inv);
+        return true;
+    }
+
+protected:
+    inline shard_type& shard(const item_type& x)
+    {
+        return m_shards[shard_hash<item_type>()(x) % num_shards];
+    }
+
+    inline const shard_type& shard(const item_type& x) const
+    {
+        return m_shards[shard_hash<item_type>()(x) % num_shards];
+    }
+};
+
+/// The string quark that can be shared by multiple threads.
+typedef concurrent_quark_base<std::string> concurrent_quark;
+
+};
+
+#endif/*__CLASSIAS_CONCURRENT_QUARK_H__*/
@@ -0,0 +1,1392 @@
+/*
+ *		Data set of binary instances in a compressed sparse row layout.
+ *
+ * Copyright (c) 2008,2009 Naoaki Okazaki
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the names of the authors nor the names of its contributors
+ *       may be used to endorse or promote products derived from this
+ *       software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* $Id$ */
+
+#ifndef __CLASSIAS_CSR_DATA_H__
+#define __CLASSIAS_CSR_DATA_H__
+
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <utility>
+#include <vector>
+#include <stdint.h>
+
+#include "memory.h"
+#include "simd.h"
+
+namespace classias
+{
+
+/**
+ * The arrays of a data set in the compressed sparse row (CSR) layout.
+ *  The elements of the instance #i are stored in the range
+ *  [offsets[i], offsets[i+1]) of the arrays ids and values. The arrays are
+ *  used as arenas: a new instance and its elements are always appended to
+ *  the end of the arrays. The array values is left empty while all values
+ *  are 1 (e.g., binary features written without values in the data), in
+ *  which case the values are implicit and only the identifiers are stored.
+ *
+ *  The arrays can be compressed after all instances are stored (see
+ *  binary_csr_data_base::compress()). The elements of the instance #i are then
+ *  sorted by the identifiers, whose differences are stored in the
+ *  stream-vbyte format in the array codes from codes[code_offsets[i]]: the
+ *  (n+3)/4 control bytes of the n elements followed by the data bytes. The
+ *  last group of an instance is filled up with zero differences, and the
+ *  array ends with code_padding bytes so that a decoder can read 16 bytes
+ *  from any group. The values are stored in single precision in the array
+ *  fvalues unless implicit; the arrays ids and values are then empty.
+ */
+struct csr_arrays
+{
+    /// The number of bytes padded at the end of the codes.
+    enum { code_padding = 16 };
+
+    /// The offsets of the instances (the number of instances + 1).
+    std::vector<size_t, placed_allocator<size_t> > offsets;
+    /// The attribute identifiers of the elements.
+    std::vector<int, placed_allocator<int> > ids;
+    /// The attribute values of the elements (empty if implicit).
+    std::vector<double, placed_allocator<double> > values;
+    /// The labels of the instances.
+    std::vector<char> labels;
+    /// The weights of the instances.
+    std::vector<double> weights;
+    /// The group numbers of the instances.
+    std::vector<int> groups;
+    /// The offsets of the compressed instances (empty if not compressed).
+    std::vector<size_t> code_offsets;
+    /// The compressed attribute identifiers.
+    std::vector<uint8_t, placed_allocator<uint8_t> > codes;
+    /// The attribute values of the compressed elements (empty if implicit).
+    std::vector<float, placed_allocator<float> > fvalues;
+
+    csr_arrays() : offsets(1, 0)
+    {
+    }
+
+    /// Tests whether the arrays are compressed.
+    inline bool compressed() const
+    {
+        return !code_offsets.empty();
+    }
+
+    /// Returns the pointer to the compressed attribute identifiers.
+    inline const uint8_t* code_data() const
+    {
+        return (codes.empty() ? NULL : &codes[0]);
+    }
+
+    /// Returns the pointer to the attribute values of compressed elements.
+    inline const float* fvalue_data() const
+    {
+        return (fvalues.empty() ? unit_fvalue() : &fvalues[0]);
+    }
+
+    /// Returns the pointer to the attribute identifiers.
+    inline const int* id_data() const
+    {
+        return (ids.empty() ? NULL : &ids[0]);
+    }
+
+    /// Returns the pointer to the attribute values.
+    inline const double* value_data() const
+    {
+        return (values.empty() ? unit_value() : &values[0]);
+    }
+
+    /// Tests whether the values are implicit (all 1).
+    inline bool implicit_values() const
+    {
+        return (compressed() ? fvalues.empty() : values.empty());
+    }
+
+    /// Returns the pointer to the value 1 shared by implicit values.
+    static const double* unit_value()
+    {
+        static const double one = 1.;
+        return &one;
+    }
+
+    /// Returns the pointer to the value 1 shared by implicit values of
+    /// compressed elements.
+    static const float* unit_fvalue()
+    {
+        static const float one = 1.f;
+        return &one;
+    }
+};
+
+
+
+/**
+ * A random-access iterator for the elements of an instance in CSR layout.
+ *  Dereferencing the iterator yields a pair of an attribute identifier and
+ *  its value as an iterator of \ref sparse_vector_base does. For implicit
+ *  values, the iterator does not advance the pointer to the value 1, and
+ *  algorithms can test implicit_values() to skip reading and multiplying
+ *  values.
+ *
+ *  For compressed elements, the iterator decodes an identifier at a time
+ *  while moving forward; it can neither move backward nor be dereferenced
+ *  at an offset other than zero. Algorithms can test compressed() to decode
+ *  the identifiers by blocks with decode() instead.
+ */
+class csr_element_iterator
+{
+public:
+    typedef std::random_access_iterator_tag iterator_category;
+    typedef std::pair<int, double> value_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef const value_type* pointer;
+    typedef const value_type& reference;
+
+    /// The maximum number of identifiers decoded by decode().
+    enum { block_size = 128 };
+
+protected:
+    const int* m_id;
+    const double* m_value;
+    int m_step;
+    size_t m_pos;
+    const uint8_t* m_ctrl;
+    const uint8_t* m_code;
+    const float* m_fvalue;
+    int m_shift;
+    int m_prev;
+    size_t m_first;
+    const uint8_t* m_first_ctrl;
+    const uint8_t* m_first_code;
+    mutable value_type m_elem;
+
+public:
+    csr_element_iterator()
+        : m_id(NULL), m_value(NULL), m_step(1), m_pos(0),
+        m_ctrl(NULL), m_code(NULL), m_fvalue(NULL), m_shift(0), m_prev(0),
+        m_first(0), m_first_ctrl(NULL), m_first_code(NULL)
+    {
+    }
+
+    /**
+     * Constructs an iterator for uncompressed elements.
+     *  @param  pos         The index of the element in the arrays.
+     *  @param  id          The pointer to the attribute identifier.
+     *  @param  value       The pointer to the attribute value.
+     *  @param  step        The step of the value pointer (0 if implicit).
+     */
+    csr_element_iterator(
+        size_t pos, const int* id, const double* value, int step = 1)
+        : m_id(id), m_value(value), m_step(step), m_pos(pos),
+        m_ctrl(NULL), m_code(NULL), m_fvalue(NULL), m_shift(0), m_prev(0),
+        m_first(0), m_first_ctrl(NULL), m_first_code(NULL)
+    {
+    }
+
+    /**
+     * Constructs an iterator for compressed elements of an instance.
+     *  The iterator points to the first element of the instance, or just
+     *  beyond the last element; the latter must not be dereferenced or
+     *  advanced, but can be moved backward.
+     *  @param  pos         The index of the element in the arrays (the
+     *                      first element or just beyond the last one).
+     *  @param  first       The index of the first element of the instance.
+     *  @param  ctrl        The pointer to the control bytes of the instance.
+     *  @param  code        The pointer to the data bytes of the instance.
+     *  @param  fvalue      The pointer to the value of the first element.
+     *  @param  step        The step of the value pointer (0 if implicit).
+     */
+    csr_element_iterator(
+        size_t pos, size_t first, const uint8_t* ctrl, const uint8_t* code,
+        const float* fvalue, int step)
+        : m_id(NULL), m_value(NULL), m_step(step), m_pos(pos),
+        m_ctrl(ctrl), m_code(code), m_fvalue(fvalue + (pos - first) * step),
+        m_shift(0), m_prev(0),
+        m_first(first), m_first_ctrl(ctrl), m_first_code(code)
+    {
+    }
+
+    inline bool implicit_values() const
+    {
+        return (m_step == 0);
+    }
+
+    inline bool compressed() const
+    {
+        return (m_ctrl != NULL);
+    }
+
+    inline const int* id_data() const
+    {
+        return m_id;
+    }
+
+    inline const float* fvalue_data() const
+    {
+        return m_fvalue;
+    }
+
+    inline int step() const
+    {
+        return m_step;
+    }
+
+    /**
+     * Decodes the identifiers of compressed elements by a block.
+     *  This function decodes up to \ref block_size identifiers from the
+     *  current element, and advances the iterator beyond them. The values of
+     *  the elements start at fvalue_data() before the call, stepping by
+     *  step().
+     *  @param  last        The iterator just beyond the last element.
+     *  @param  ids         The array of \ref block_size elements receiving
+     *                      the identifiers.
+     *  @return int         The number of identifiers decoded.
+     */
+    inline int decode(const csr_element_iterator& last, int* ids)
+    {
+        // Decode an element at a time inside a group.
+        if (m_shift != 0) {
+            ids[0] = operator*().first;
+            ++*this;
+            return 1;
+        }
+
+        const size_t rest = last.m_pos - m_pos;
+        int groups = (int)((rest + 3) / 4);
+        if (block_size / 4 < groups) {
+            groups = block_size / 4;
+        }
+        const uint8_t* code = simd::svb_decode(groups, m_ctrl, m_code, m_prev, ids);
+        const int n = groups * 4;
+        if ((size_t)n <= rest) {
+            m_ctrl += groups;
+            m_code = code;
+            m_prev = ids[n-1];
+            m_pos += n;
+            m_fvalue += n * m_step;
+            return n;
+        } else {
+            // The last group is filled up with zero differences.
+            *this = last;
+            return (int)rest;
+        }
+    }
+
+    inline reference operator*() const
+    {
+        if (m_ctrl == NULL) {
+            m_elem.first = *m_id;
+            m_elem.second = *m_value;
+        } else {
+            m_elem.first = m_prev + (int)read_code();
+            m_elem.second = *m_fvalue;
+        }
+        return m_elem;
+    }
+
+    inline pointer operator->() const
+    {
+        return &operator*();
+    }
+
+    inline value_type operator[](difference_type n) const
+    {
+        if (m_ctrl == NULL) {
+            return value_type(m_id[n], m_value[n * m_step]);
+        } else {
+            // Decode the identifiers up to the element.
+            return *(*this + n);
+        }
+    }
+
+    inline csr_element_iterator& operator++()
+    {
+        ++m_pos;
+        if (m_ctrl == NULL) {
+            ++m_id;
+            m_value += m_step;
+        } else {
+            m_prev += (int)read_code();
+            m_code += code_length();
+            m_fvalue += m_step;
+            m_shift += 2;
+            if (m_shift == 8) {
+                ++m_ctrl;
+                m_shift = 0;
+            }
+        }
+        return *this;
+    }
+
+    inline csr_element_iterator operator++(int)
+    {
+        csr_element_iterator x = *this;
+        ++*this;
+        return x;
+    }
+
+    inline csr_element_iterator& operator--()
+    {
+        if (m_ctrl == NULL) {
+            --m_pos;
+            --m_id;
+            m_value -= m_step;
+        } else {
+            this->seek(m_pos - 1);
+        }
+        return *this;
+    }
+
+    inline csr_element_iterator operator--(int)
+    {
+        csr_element_iterator x = *this;
+        --*this;
+        return x;
+    }
+
+    inline csr_element_iterator& operator+=(difference_type n)
+    {
+        if (m_ctrl == NULL) {
+            m_pos += n;
+            m_id += n;
+            m_value += n * m_step;
+        } else if (n < 0) {
+            this->seek(m_pos + n);
+        } else {
+            for (;0 < n;--n) {
+                ++*this;
+            }
+        }
+        return *this;
+    }
+
+    inline csr_element_iterator& operator-=(difference_type n)
+    {
+        return (*this += -n);
+    }
+
+    inline csr_element_iterator operator+(difference_type n) const
+    {
+        csr_element_iterator x = *this;
+        x += n;
+        return x;
+    }
+
+    inline csr_element_iterator operator-(difference_type n) const
+    {
+        csr_element_iterator x = *this;
+        x -= n;
+        return x;
+    }
+
+    inline difference_type operator-(const csr_element_iterator& x) const
+    {
+        return (difference_type)m_pos - (difference_type)x.m_pos;
+    }
+
+    inline bool operator==(const csr_element_iterator& x) const
+    {
+        return m_pos == x.m_pos;
+    }
+
+    inline bool operator!=(const csr_element_iterator& x) const
+    {
+        return m_pos != x.m_pos;
+    }
+
+    inline bool operator<(const csr_element_iterator& x) const
+    {
+        return m_pos < x.m_pos;
+    }
+
+protected:
+    /**
+     * Moves the iterator backward to a compressed element.
+     *  The identifiers are decoded again from the first element of the
+     *  instance, since the deltas can be read only forward.
+     *  @param  pos         The index of the element in the arrays.
+     */
+    inline void seek(size_t pos)
+    {
+        m_fvalue -= (difference_type)(m_pos - m_first) * m_step;
+        m_pos = m_first;
+        m_ctrl = m_first_ctrl;
+        m_code = m_first_code;
+        m_shift = 0;
+        m_prev = 0;
+        while (m_pos < pos) {
+            ++*this;
+        }
+    }
+
+    inline int code_length() const
+    {
+        return ((*m_ctrl >> m_shift) & 3) + 1;
+    }
+
+    inline uint32_t read_code() const
+    {
+        const int len = code_length();
+        uint32_t x = 0;
+        for (int b = 0;b < len;++b) {
+            x |= (uint32_t)m_code[b] << (8 * b);
+        }
+        return x;
+    }
+};
+
+
+
+/**
+ * A binary instance in CSR layout.
+ *  This class is a view of an instance stored in \ref csr_arrays, which
+ *  exposes the interface of \ref binary_instance_base to the training
+ *  algorithms. Elements can be appended only to the last instance of the
+ *  arrays.
+ */
+class binary_csr_instance
+{
+public:
+    /// The type of a feature vector.
+    typedef binary_csr_instance features_type;
+    /// The type of an attribute identifier.
+    typedef int attribute_type;
+    /// The type of an element identifier.
+    typedef int identifier_type;
+    /// The type of an attribute value.
+    typedef double value_type;
+    /// The type of an element.
+    typedef std::pair<int, double> element_type;
+    /// A type counting the number of elements.
+    typedef size_t size_type;
+    /// A type providing a random-access iterator for the elements.
+    typedef csr_element_iterator iterator;
+    /// A type providing a read-only random-access iterator.
+    typedef csr_element_iterator const_iterator;
+
+protected:
+    /// The arrays storing the instance.
+    csr_arrays* m_arrays;
+    /// The index of the instance.
+    size_t m_i;
+
+public:
+    /**
+     * Constructs the view of an instance.
+     *  @param  arrays      The arrays storing the instance.
+     *  @param  i           The index of the instance.
+     */
+    binary_csr_instance(csr_arrays* arrays = NULL, size_t i = 0)
+        : m_arrays(arrays), m_i(i)
+    {
+    }
+
+    /**
+     * Changes the instance that this object views.
+     *  @param  arrays      The arrays storing the instance.
+     *  @param  i           The index of the instance.
+     */
+    inline void reset(csr_arrays* arrays, size_t i)
+    {
+        m_arrays = arrays;
+        m_i = i;
+    }
+
+    /**
+     * Tests if the instance has no element.
+     *  @retval bool        \c true if the instance is empty.
+     */
+    inline bool empty() const
+    {
+        return size() == 0;
+    }
+
+    /**
+     * Returns the number of elements in the instance.
+     *  @retval size_type   The number of elements.
+     */
+    inline size_type size() const
+    {
+        return m_arrays->offsets[m_i+1] - m_arrays->offsets[m_i];
+    }
+
+    /**
+     * Returns an iterator to the first element.
+     *  @retval const_iterator  The iterator.
+     */
+    inline const_iterator begin() const
+    {
+        return element(m_arrays->offsets[m_i]);
+    }
+
+    /**
+     * Returns an iterator pointing just beyond the last element.
+     *  @retval const_iterator  The iterator.
+     */
+    inline const_iterator end() const
+    {
+        return element(m_arrays->offsets[m_i+1]);
+    }
+
+    /**
+     * Appends an element to the instance.
+     *  This function must be called only for the last instance of
+     *  uncompressed arrays.
+     *  @param  id          The attribute identifier.
+     *  @param  value       The attribute value.
+     */
+    inline void append(const attribute_type& id, const value_type& value)
+    {
+        std::vector<double, placed_allocator<double> >& values = m_arrays->values;
+        if (values.empty() && value != 1.) {
+            // Store the implicit values of the preceding elements.
+            values.assign(m_arrays->ids.size(), 1.);
+        }
+        m_arrays->ids.push_back(id);
+        if (!values.empty() || value != 1.) {
+            values.push_back(value);
+        }
+        m_arrays->offsets.back() = m_arrays->ids.size();
+    }
+
+    /**
+     * Sets the boolean label of the instance.
+     *  @param  l           The boolean label.
+     */
+    inline void set_label(bool l)
+    {
+        m_arrays->labels[m_i] = (l ? 1 : 0);
+    }
+
+    /**
+     * Gets the boolean label of the instance.
+     *  @return bool        The boolean label of this instance.
+     */
+    inline bool get_label() const
+    {
+        return (m_arrays->labels[m_i] != 0);
+    }
+
+    /**
+     * Sets the instance weight.
+     *  @param  weight      The instance weight.
+     */
+    inline void set_weight(const double& weight)
+    {
+        m_arrays->weights[m_i] = weight;
+    }
+
+    /**
+     * Gets the instance weight.
+     *  @return double      The instance weight.
+     */
+    inline double get_weight() const
+    {
+        return m_arrays->weights[m_i];
+    }
+
+    /**
+     * Sets the group number.
+     *  @param  group       The group number.
+     */
+    inline void set_group(const int& group)
+    {
+        m_arrays->groups[m_i] = group;
+    }
+
+    /**
+     * Gets the group number.
+     *  @return int         The group number.
+     */
+    inline int get_group() const
+    {
+        return m_arrays->groups[m_i];
+    }
+
+protected:
+    /**
+     * Returns an iterator to an element of the instance.
+     *  @param  k           The index of the element in the arrays (the
+     *                      first element or just beyond the last one).
+     */
+    inline const_iterator element(size_t k) const
+    {
+        if (m_arrays->compressed()) {
+            // The data bytes follow the control bytes of the instance.
+            const size_t first = m_arrays->offsets[m_i];
+            const size_t n = m_arrays->offsets[m_i+1] - first;
+            const uint8_t* ctrl = m_arrays->code_data() + m_arrays->code_offsets[m_i];
+            const uint8_t* code = ctrl + (n + 3) / 4;
+            if (m_arrays->implicit_values()) {
+                return const_iterator(k, first, ctrl, code, m_arrays->fvalue_data(), 0);
+            } else {
+                return const_iterator(k, first, ctrl, code, m_arrays->fvalue_data() + first, 1);
+            }
+        } else if (m_arrays->implicit_values()) {
+            return const_iterator(
+                k, m_arrays->id_data() + k, m_arrays->value_data(), 0);
+        } else {
+            return const_iterator(
+                k, m_arrays->id_data() + k, m_arrays->value_data() + k);
+        }
+    }
+
+private:
+    // Views cannot be assigned, so that algorithms swapping instances
+    // (e.g., std::random_shuffle) are rejected at compile time; use
+    // binary_csr_data_base::shuffle() instead.
+    binary_csr_instance& operator=(const binary_csr_instance&);
+};
+
+
+
+/**
+ * A random-access iterator for the instances in CSR layout.
+ *  The iterator holds the view of the current instance, to which the
+ *  dereference operators return the reference.
+ *
+ *  @param  reference_tmpl  The type of a reference to an instance.
+ *  @param  pointer_tmpl    The type of a pointer to an instance.
+ */
+template <class reference_tmpl, class pointer_tmpl>
+class csr_instance_iterator
+{
+public:
+    typedef std::random_access_iterator_tag iterator_category;
+    typedef binary_csr_instance value_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef pointer_tmpl pointer;
+    typedef reference_tmpl reference;
+
+protected:
+    csr_arrays* m_arrays;
+    size_t m_i;
+    mutable binary_csr_instance m_inst;
+
+public:
+    csr_instance_iterator() : m_arrays(NULL), m_i(0)
+    {
+    }
+
+    csr_instance_iterator(csr_arrays* arrays, size_t i)
+        : m_arrays(arrays), m_i(i)
+    {
+    }
+
+    csr_instance_iterator(const csr_instance_iterator& x)
+        : m_arrays(x.m_arrays), m_i(x.m_i)
+    {
+    }
+
+    template <class reference_type, class pointer_type>
+    csr_instance_iterator(
+        const csr_instance_iterator<reference_type, pointer_type>& x)
+        : m_arrays(x.arrays()), m_i(x.index())
+    {
+    }
+
+    inline csr_instance_iterator& operator=(const csr_instance_iterator& x)
+    {
+        m_arrays = x.m_arrays;
+        m_i = x.m_i;
+        return *this;
+    }
+
+    inline csr_arrays* arrays() const
+    {
+        return m_arrays;
+    }
+
+    inline size_t index() const
+    {
+        return m_i;
+    }
+
+    inline reference operator*() const
+    {
+        m_inst.reset(m_arrays, m_i);
+        return m_inst;
+    }
+
+    inline pointer operator->() const
+    {
+        return &operator*();
+    }
+
+    inline csr_instance_iterator& operator++()
+    {
+        ++m_i;
+        return *this;
+    }
+
+    inline csr_instance_iterator operator++(int)
+    {
+        csr_instance_iterator x = *this;
+        ++m_i;
+        return x;
+    }
+
+    inline csr_instance_iterator& operator--()
+    {
+        --m_i;
+        return *this;
+    }
+
+    inline csr_instance_iterator operator--(int)
+    {
+        csr_instance_iterator x = *this;
+        --m_i;
+        return x;
+    }
+
+    inline csr_instance_iterator& operator+=(difference_type n)
+    {
+        m_i += n;
+        return *this;
+    }
+
+    inline csr_instance_iterator& operator-=(difference_type n)
+    {
+        m_i -= n;
+        return *this;
+    }
+
+    inline csr_instance_iterator operator+(difference_type n) const
+    {
+        return csr_instance_iterator(m_arrays, m_i + n);
+    }
+
+    inline csr_instance_iterator operator-(difference_type n) const
+    {
+        return csr_instance_iterator(m_arrays, m_i - n);
+    }
+
+    inline difference_type operator-(const csr_instance_iterator& x) const
+    {
+        return (difference_type)m_i - (difference_type)x.m_i;
+    }
+
+    inline bool operator==(const csr_instance_iterator& x) const
+    {
+        return m_i == x.m_i;
+    }
+
+    inline bool operator!=(const csr_instance_iterator& x) const
+    {
+        return m_i != x.m_i;
+    }
+
+    inline bool operator<(const csr_instance_iterator& x) const
+    {
+        return m_i < x.m_i;
+    }
+};
+
+
+
+/**
+ * A collection of binary-classification instances in CSR layout.
+ *
+ *  This class provides the interface of \ref binary_data_base, but stores
+ *  all instances into a few flat arrays (see \ref csr_arrays) instead of a
+ *  vector of instance objects, each of which owns a vector of elements.
+ *  This saves the allocator overhead and the padding of (int, double) pairs,
+ *  and lets training algorithms scan the elements sequentially. Iterators
+ *  yield views of instances (\ref binary_csr_instance); an instance can be
+ *  appended only at the end of the data set, and its elements only while it
+ *  is the last instance. After all instances are appended, compress() can
+ *  shrink the arrays further.
+ */
+class binary_csr_data_base
+{
+public:
+    /// The type of an instance.
+    typedef binary_csr_instance instance_type;
+    /// A type counting the number of instances.
+    typedef size_t size_type;
+    /// A type providing a random-access iterator.
+    typedef csr_instance_iterator<
+        binary_csr_instance&, binary_csr_instance*> iterator;
+    /// A type providing a read-only random-access iterator.
+    typedef csr_instance_iterator<
+        const binary_csr_instance&, const binary_csr_instance*> const_iterator;
+    /// The type of an attribute.
+    typedef instance_type::attribute_type attribute_type;
+
+protected:
+    /// The arrays storing the instances.
+    csr_arrays m_arrays;
+    /// The view of the last instance.
+    instance_type m_back;
+    /// The number of features.
+    int m_num_features;
+    /// The start index of features.
+    int m_feature_start_index;
+
+public:
+    /**
+     * Constructs the object.
+     */
+    binary_csr_data_base() : m_num_features(0), m_feature_start_index(0)
+    {
+    }
+
+    /**
+     * Constructs the object by copying the source object.
+     *  @param  src             The source object.
+     */
+    binary_csr_data_base(const binary_csr_data_base& src)
+        : m_arrays(src.m_arrays),
+        m_num_features(src.m_num_features),
+        m_feature_start_index(src.m_feature_start_index)
+    {
+    }
+
+    /**
+     * Copies another object to this object.
+     *  @param  src             The source object.
+     *  @return binary_csr_data_base&   The reference to this object.
+     */
+    binary_csr_data_base& operator=(const binary_csr_data_base& src)
+    {
+        m_arrays = src.m_arrays;
+        m_num_features = src.m_num_features;
+        m_feature_start_index = src.m_feature_start_index;
+        return *this;
+    }
+
+    /**
+     * Destructs the object.
+     */
+    virtual ~binary_csr_data_base()
+    {
+    }
+
+    /**
+     * Erases all the instances of the data.
+     */
+    inline void clear()
+    {
+        m_arrays = csr_arrays();
+    }
+
+    /**
+     * Reserves the arrays for instances and elements.
+     *  The array of values is allocated when the first value other than 1
+     *  is appended.
+     *  @param  n           The number of instances.
+     *  @param  nnz         The total number of elements.
+     */
+    inline void reserve(size_type n, size_type nnz)
+    {
+        m_arrays.offsets.reserve(n + 1);
+        m_arrays.labels.reserve(n);
+        m_arrays.weights.reserve(n);
+        m_arrays.groups.reserve(n);
+        m_arrays.ids.reserve(nnz);
+    }
+
+    /**
+     * Tests if the data is empty.
+     *  @retval bool        \c true if the data is empty,
+     *                      \c false otherwise.
+     */
+    inline bool empty() const
+    {
+        return m_arrays.labels.empty();
+    }
+
+    /**
+     * Returns the number of instances in the data.
+     *  @retval size_type   The current size of the data.
+     */
+    inline size_type size() const
+    {
+        return m_arrays.labels.size();
+    }
+
+    /**
+     * Returns the total number of elements in the data.
+     *  @retval size_type   The number of elements.
+     */
+    inline size_type num_elements() const
+    {
+        return m_arrays.offsets.back();
+    }
+
+    /**
+     * Returns the memory used by the instances in the data.
+     *  @retval size_t      The number of bytes allocated for the arrays.
+     */
+    inline size_t memory_usage() const
+    {
+        return
+            classias::memory_usage(m_arrays.offsets) +
+            classias::memory_usage(m_arrays.ids) +
+            classias::memory_usage(m_arrays.values) +
+            classias::memory_usage(m_arrays.labels) +
+            classias::memory_usage(m_arrays.weights) +
+            classias::memory_usage(m_arrays.groups) +
+            classias::memory_usage(m_arrays.code_offsets) +
+            classias::memory_usage(m_arrays.codes) +
+            classias::memory_usage(m_arrays.fvalues);
+    }
+
+    /**
+     * Returns the memory used by a range of instances.
+     *  @param  first       The index of the first instance.
+     *  @param  last        The index succeeding the last instance.
+     *  @retval size_t      The number of bytes used by the instances.
+     */
+    inline size_t memory_usage(size_type first, size_type last) const
+    {
+        const size_t n = m_arrays.offsets[last] - m_arrays.offsets[first];
+        if (m_arrays.compressed()) {
+            return
+                m_arrays.code_offsets[last] - m_arrays.code_offsets[first] +
+                n * (m_arrays.fvalues.empty() ? 0 : sizeof(float)) +
+                (last - first) * (
+                    2 * sizeof(size_t) + sizeof(char) + sizeof(double) + sizeof(int));
+        }
+        return
+            n * (sizeof(int) + (m_arrays.values.empty() ? 0 : sizeof(double))) +
+            (last - first) * (
+                sizeof(size_t) + sizeof(char) + sizeof(double) + sizeof(int));
+    }
+
+    /**
+     * Tests whether the instances are compressed.
+     *  @retval bool        \c true if compress() has been called.
+     */
+    inline bool compressed() const
+    {
+        return m_arrays.compressed();
+    }
+
+    /**
+     * Tests whether the attribute values are implicit.
+     *  @retval bool        \c true if all attribute values are 1 and thus
+     *                      not stored.
+     */
+    inline bool implicit_values() const
+    {
+        return m_arrays.implicit_values();
+    }
+
+    /**
+     * Returns the view of an instance.
+     *  @param  i               The index number for an instance.
+     *  @retval instance_type   The view of the instance.
+     */
+    inline instance_type operator[](size_type i) const
+    {
+        return instance_type(const_cast<csr_arrays*>(&m_arrays), i);
+    }
+
+    /**
+     * Returns a random-access iterator to the first instance.
+     *  @retval iterator    A random-access iterator (for read/write).
+     */
+    inline iterator begin()
+    {
+        return iterator(&m_arrays, 0);
+    }
+
+    /**
+     * Returns a random-access iterator to the first instance.
+     *  @retval const_iterator  A random-access iterator (for read-only).
+     */
+    inline const_iterator begin() const
+    {
+        return const_iterator(const_cast<csr_arrays*>(&m_arrays), 0);
+    }
+
+    /**
+     * Returns a random-access iterator pointing just beyond the last instance.
+     *  @retval iterator    A random-access iterator (for read/write).
+     */
+    inline iterator end()
+    {
+        return iterator(&m_arrays, size());
+    }
+
+    /**
+     * Returns a random-access iterator pointing just beyond the last instance.
+     *  @retval const_iterator  A random-access iterator (for read-only).
+     */
+    inline const_iterator end() const
+    {
+        return const_iterator(const_cast<csr_arrays*>(&m_arrays), size());
+    }
+
+    /**
+     * Returns the reference to the view of the last instance.
+     *  @retval instance_type&  The reference to the last instance.
+     */
+    inline instance_type& back()
+    {
+        m_back.reset(&m_arrays, size() - 1);
+        return m_back;
+    }
+
+    /**
+     * Creates and returns a new instance at the end of the data.
+     *  This function must not be called after compress().
+     *  @retval instance_type&  The reference to the view of the new
+     *                          instance, which is valid until the next
+     *                          call of this function.
+     */
+    inline instance_type& new_element()
+    {
+        m_arrays.offsets.push_back(m_arrays.ids.size());
+        m_arrays.labels.push_back(0);
+        m_arrays.weights.push_back(1.);
+        m_arrays.groups.push_back(0);
+        return this->back();
+    }
+
+    /**
+     * Reorders the instances randomly.
+     *  The elements are moved so that the instances stay contiguous.
+     */
+    void shuffle()
+    {
+        const size_type n = size();
+        std::vector<size_type> order(n);
+        for (size_type i = 0;i < n;++i) {
+            order[i] = i;
+        }
+        std::random_shuffle(order.begin(), order.end());
+        this->select(order);
+    }
+
+    /**
+     * Keeps only the instances of the given indices.
+     *  The data then stores the instances in the order of the indices; the
+     *  elements are moved so that the instances stay contiguous.
+     *  @param  indices     The indices of the instances to keep.
+     */
+    void select(const std::vector<size_type>& indices)
+    {
+        if (m_arrays.compressed()) {
+            this->select_compressed(indices);
+            return;
+        }
+
+        const size_type n = indices.size();
+        csr_arrays dst;
+        dst.offsets.reserve(n + 1);
+        dst.labels.reserve(n);
+        dst.weights.reserve(n);
+        dst.groups.reserve(n);
+        dst.ids.reserve(m_arrays.ids.size());
+        dst.values.reserve(m_arrays.values.size());
+        for (size_type i = 0;i < n;++i) {
+            const size_type j = indices[i];
+            const size_t first = m_arrays.offsets[j];
+            const size_t last = m_arrays.offsets[j+1];
+            dst.ids.insert(dst.ids.end(),
+                m_arrays.ids.begin() + first, m_arrays.ids.begin() + last);
+            if (!m_arrays.implicit_values()) {
+                dst.values.insert(dst.values.end(),
+                    m_arrays.values.begin() + first, m_arrays.values.begin() + last);
+            }
+            dst.offsets.push_back(dst.ids.size());
+            dst.labels.push_back(m_arrays.labels[j]);
+            dst.weights.push_back(m_arrays.weights[j]);
+            dst.groups.push_back(m_arrays.groups[j]);
+        }
+        std::swap(m_arrays, dst);
+    }
+
+    /**
+     * Renumbers the attribute identifiers of the elements.
+     *  This function must be called before compress().
+     *  @param  perm        The new identifiers of the attribute identifiers.
+     */
+    template <class perm_type>
+    void renumber(const perm_type& perm)
+    {
+        for (size_t k = 0;k < m_arrays.ids.size();++k) {
+            m_arrays.ids[k] = (int)perm[m_arrays.ids[k]];
+        }
+    }
+
+    /**
+     * Compresses the elements of the instances.
+     *  The elements of each instance are sorted by the attribute
+     *  identifiers, and the differences of the identifiers are encoded in
+     *  the stream-vbyte format (see \ref csr_arrays), which mostly takes one
+     *  or two bytes per element instead of four. Unless implicit, the values
+     *  are rounded to single precision. The training algorithms decode the
+     *  identifiers by blocks in their inner loops. No instance can be
+     *  appended after the compression, but the instances can still be
+     *  shuffled and selected.
+     */
+    void compress()
+    {
+        if (m_arrays.compressed()) {
+            return;
+        }
+
+        const size_type n = size();
+        const bool implicit = m_arrays.implicit_values();
+        csr_arrays& a = m_arrays;
+
+        // Sort the elements of each instance and count the bytes of codes.
+        size_t bytes = 0;
+        std::vector<std::pair<int, double> > elems;
+        a.code_offsets.reserve(n + 1);
+        for (size_type i = 0;i < n;++i) {
+            const size_t first = a.offsets[i];
+            const size_t last = a.offsets[i+1];
+            elems.clear();
+            for (size_t k = first;k < last;++k) {
+                elems.push_back(std::make_pair(
+                    a.ids[k], (implicit ? 1. : a.values[k])));
+            }
+            std::sort(elems.begin(), elems.end());
+
+            int prev = 0;
+            // The control bytes, and the zero differences filling up the
+            // last group, which take a byte each.
+            a.code_offsets.push_back(bytes);
+            bytes += (last - first + 3) / 4 + (4 - (last - first) % 4) % 4;
+            for (size_t k = first;k < last;++k) {
+                a.ids[k] = elems[k - first].first;
+                if (!implicit) {
+                    a.values[k] = elems[k - first].second;
+                }
+                bytes += code_length((uint32_t)(a.ids[k] - prev));
+                prev = a.ids[k];
+            }
+        }
+        a.code_offsets.push_back(bytes);
+
+        // Encode the identifiers.
+        a.codes.resize(bytes + csr_arrays::code_padding, 0);
+        for (size_type i = 0;i < n;++i) {
+            const size_t first = a.offsets[i];
+            const size_t last = a.offsets[i+1];
+            uint8_t* ctrl = &a.codes[a.code_offsets[i]];
+            uint8_t* code = ctrl + (last - first + 3) / 4;
+            int prev = 0;
+            for (size_t k = first;k < last;++k) {
+                const uint32_t x = (uint32_t)(a.ids[k] - prev);
+                const int len = code_length(x);
+                ctrl[(k - first) / 4] |= (uint8_t)((len - 1) << (2 * ((k - first) % 4)));
+                for (int b = 0;b < len;++b) {
+                    *code++ = (uint8_t)(x >> (8 * b));
+                }
+                prev = a.ids[k];
+            }
+        }
+
+        // Store the values in single precision.
+        if (!implicit) {
+            a.fvalues.assign(a.values.begin(), a.values.end());
+        }
+        std::vector<int, placed_allocator<int> >().swap(a.ids);
+        std::vector<double, placed_allocator<double> >().swap(a.values);
+    }
+
+    /**
+     * Sets the start index of user features.
+     *  @param  index       The start index of user features.
+     */
+    inline void set_user_feature_start(int index)
+    {
+        m_feature_start_index = index;
+    }
+
+    /**
+     * Returns the start index of user features.
+     *  @return fid_type    The start index of user features.
+     */
+    inline int get_user_feature_start() const
+    {
+        return m_feature_start_index;
+    }
+
+    /**
+     * Sets the total number of features.
+     *  @param  num         The number of features.
+     */
+    inline void set_num_features(int num)
+    {
+        m_num_features = num;
+    }
+
+    /**
+     * Returns the total number of attributes.
+     *  @return int         The total number of attributes.
+     */
+    int num_attributes() const
+    {
+        return m_num_features;
+    }
+
+    /**
+     * Returns the total number of labels.
+     *  @return int         The total number of labels. This is always 2 for
+     *                      the data collection for binary instances.
+     */
+    int num_labels() const
+    {
+        return 2;
+    }
+
+    /**
+     * Returns the total number of features.
+     *  @return int         The total number of features.
+     */
+    int num_features() const
+    {
+        return m_num_features;
+    }
+
+protected:
+    /**
+     * Keeps only the instances of the given indices (compressed version).
+     *  @param  indices     The indices of the instances to keep.
+     */
+    void select_compressed(const std::vector<size_type>& indices)
+    {
+        const size_type n = indices.size();
+        csr_arrays dst;
+        dst.offsets.reserve(n + 1);
+        dst.labels.reserve(n);
+        dst.weights.reserve(n);
+        dst.groups.reserve(n);
+        dst.code_offsets.reserve(n + 1);
+        dst.codes.reserve(m_arrays.codes.size());
+        dst.fvalues.reserve(m_arrays.fvalues.size());
+        dst.code_offsets.push_back(0);
+        for (size_type i = 0;i < n;++i) {
+            const size_type j = indices[i];
+            const size_t first = m_arrays.offsets[j];
+            const size_t last = m_arrays.offsets[j+1];
+            dst.codes.insert(dst.codes.end(),
+                m_arrays.codes.begin() + m_arrays.code_offsets[j],
+                m_arrays.codes.begin() + m_arrays.code_offsets[j+1]);
+            if (!m_arrays.fvalues.empty()) {
+                dst.fvalues.insert(dst.fvalues.end(),
+                    m_arrays.fvalues.begin() + first, m_arrays.fvalues.begin() + last);
+            }
+            dst.offsets.push_back(dst.offsets.back() + (last - first));
+            dst.code_offsets.push_back(dst.codes.size());
+            dst.labels.push_back(m_arrays.labels[j]);
+            dst.weights.push_back(m_arrays.weights[j]);
+            dst.groups.push_back(m_arrays.groups[j]);
+        }
+        dst.codes.insert(dst.codes.end(), csr_arrays::code_padding, 0);
+        std::swap(m_arrays, dst);
+    }
+
+    /**
+     * Returns the number of bytes encoding an integer in stream-vbyte.
+     *  @param  x           The integer.
+     *  @return int         The number of bytes (1 to 4).
+     */
+    static int code_length(uint32_t x)
+    {
+        return (x < (1U << 8) ? 1 : (x < (1U << 16) ? 2 : (x < (1U << 24) ? 3 : 4)));
+    }
+};
+
+
+
+/**
+ * A collection of binary-classification instances in CSR layout with a
+ * quark assigning attribute identifiers.
+ *
+ *  @param  attributes_quark_tmpl   The type of an attribute quark.
+ */
+template <
+    class attributes_quark_tmpl
+>
+class binary_csr_data_with_quark_base : public binary_csr_data_base
+{
+public:
+    /// The type of attribute quark.
+    typedef attributes_quark_tmpl attributes_quark_type;
+    /// The base class.
+    typedef binary_csr_data_base base_type;
+
+    /// A feature quark.
+    attributes_quark_type attributes;
+
+public:
+    /**
+     * Constructs the object.
+     */
+    binary_csr_data_with_quark_base()
+    {
+    }
+
+    /**
+     * Destructs the object.
+     */
+    virtual ~binary_csr_data_with_quark_base()
+    {
+    }
+
+    /**
+     * Returns the total number of attributes.
+     *  @return int         The total number of attributes.
+     */
+    int num_attributes() const
+    {
+        return attributes.size();
+    }
+
+    /**
+     * Returns the total number of labels.
+     *  @return int         The total number of labels. This is always 2 for
+     *                      the data collection for binary instances.
+     */
+    int num_labels() const
+    {
+        return 2;
+    }
+
+    /**
+     * Returns the total number of features.
+     *  @return int         The total number of features.
+     */
+    int num_features() const
+    {
+        return attributes.size();
+    }
+};
+
+};
+
+#endif/*__CLASSIAS_CSR_DATA_H__*/
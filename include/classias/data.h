@@ -35,6 +35,8 @@
 
 #include <vector>
 
+#include "memory.h"
+
 namespace classias
 {
 
@@ -60,7 +62,7 @@ public:
     typedef instance_tmpl instance_type;
 
     /// A type providing a container of instances.
-    typedef std::vector<instance_type> instances_type;
+    typedef std::vector<instance_type, placed_allocator<instance_type> > instances_type;
     /// A type counting the number of pairs in a container.
     typedef typename instances_type::size_type size_type;
     /// A type providing a random-access iterator.
@@ -120,6 +122,47 @@ public:
         return instances.size();
     }
 
+    /**
+     * Returns the memory used by the instances in the data.
+     *  @retval size_t      The approximate number of bytes.
+     */
+    inline size_t memory_usage() const
+    {
+        return
+            (instances.capacity() - instances.size()) * sizeof(instance_type) +
+            memory_usage(0, instances.size());
+    }
+
+    /**
+     * Returns the memory used by a range of instances.
+     *  @param  first       The index of the first instance.
+     *  @param  last        The index succeeding the last instance.
+     *  @retval size_t      The approximate number of bytes.
+     */
+    inline size_t memory_usage(size_type first, size_type last) const
+    {
+        size_t bytes = (last - first) * sizeof(instance_type);
+        for (size_type i = first;i < last;++i) {
+            bytes += instances[i].memory_usage();
+        }
+        return bytes;
+    }
+
+    /**
+     * Keeps only the instances of the given indices.
+     *  The data then stores the instances in the order of the indices.
+     *  @param  indices     The indices of the instances to keep.
+     */
+    void select(const std::vector<size_type>& indices)
+    {
+        instances_type dst;
+        dst.reserve(indices.size());
+        for (size_type i = 0;i < indices.size();++i) {
+            dst.push_back(instances[indices[i]]);
+        }
+        instances.swap(dst);
+    }
+
     /**
      * Returns a read/write reference to an instance.
      *  @param  i               The index number for an instance.
@@ -33,9 +33,12 @@
 #ifndef __CLASSIAS_EVALUATION_H__
 #define __CLASSIAS_EVALUATION_H__
 
+#include <algorithm>
 #include <iomanip>
 #include <vector>
 
+#include "thread.h"
+
 namespace classias
 {
 
@@ -77,6 +80,18 @@ public:
         ++m_n;
     }
 
+    /**
+     * Adds the counts of another counter (e.g., of another thread).
+     *  @param  rho         The counter.
+     *  @return accuracy&   The reference to this object.
+     */
+    accuracy& operator+=(const accuracy& rho)
+    {
+        m_m += rho.m_m;
+        m_n += rho.m_n;
+        return *this;
+    }
+
     /**
      * Gets the accuracy.
      *  @return double      The accuracy.
@@ -162,6 +177,24 @@ public:
         if (r == p) m_stat[p].num_match++;
     }
 
+    /**
+     * Adds the counts of another counter (e.g., of another thread).
+     *  @param  rho         The counter.
+     *  @return precall&    The reference to this object.
+     */
+    precall& operator+=(const precall& rho)
+    {
+        if (m_stat.size() < rho.m_stat.size()) {
+            m_stat.resize(rho.m_stat.size());
+        }
+        for (size_t i = 0;i < rho.m_stat.size();++i) {
+            m_stat[i].num_match += rho.m_stat[i].num_match;
+            m_stat[i].num_reference += rho.m_stat[i].num_reference;
+            m_stat[i].num_prediction += rho.m_stat[i].num_prediction;
+        }
+        return *this;
+    }
+
     template <class labels_type, class positive_iterator_type>
     void output_labelwise(
         std::ostream& os,
@@ -282,31 +315,129 @@ private:
 
 
 /**
- * Hold-out evaluation for binary classification.
- *  @param  os              The output stream.
+ * Settings of the holdout evaluations during training.
+ */
+struct holdout_options
+{
+    /// The number of threads for a holdout evaluation.
+    int num_threads;
+    /// The number of holdout instances evaluated (zero for all instances).
+    size_t sample;
+    /// The interval of iterations between holdout evaluations.
+    int interval;
+    /// Draw the random numbers of sampling from the sequence of the holdout
+    /// group instead of std::rand() (for the folds trained concurrently).
+    bool fold_random;
+
+    /**
+     * Constructs the object with the settings evaluating all holdout
+     * instances on one thread after every iteration.
+     */
+    holdout_options() : num_threads(1), sample(0), interval(1), fold_random(false)
+    {
+    }
+
+    /**
+     * Tests whether a holdout evaluation is scheduled after an iteration.
+     *  An evaluation runs after every interval-th iteration and after the
+     *  last iteration allowed.
+     *  @param  k           The iteration number (starting from one).
+     *  @param  last        \c true if the iteration is the last one.
+     *  @return bool        \c true to run a holdout evaluation.
+     */
+    bool scheduled(int k, bool last) const
+    {
+        return (interval <= 1 || k % interval == 0 || last);
+    }
+};
+
+/**
+ * Lists the holdout instances of a data set.
+ *  The list is built once before training so that an evaluation does not
+ *  need to skip the training instances one by one. If the number of the
+ *  holdout instances exceeds the sample size, this function chooses the
+ *  instances at random with a fixed seed, so that every evaluation (and
+ *  every run) uses the same subset; the instances in the list keep the
+ *  order of the data set.
+ *  @param  index           The vector to which this function stores the
+ *                          iterators of the holdout instances.
+ *  @param  first           The iterator pointing to the first element of the
+ *                          dataset.
+ *  @param  last            The iterator pointing just beyond the last element
+ *                          of the dataset.
+ *  @param  holdout         The group number for holdout evaluation.
+ *  @param  sample          The maximum number of instances in the list
+ *                          (zero for all holdout instances).
+ */
+template <class iterator_type>
+static void holdout_instances(
+    std::vector<iterator_type>& index,
+    iterator_type first,
+    iterator_type last,
+    int holdout,
+    size_t sample = 0
+    )
+{
+    index.clear();
+    for (iterator_type it = first;it != last;++it) {
+        if (it->get_group() == holdout) {
+            index.push_back(it);
+        }
+    }
+
+    const size_t n = index.size();
+    if (sample == 0 || n <= sample) {
+        return;
+    }
+
+    // Choose the positions by a partial Fisher-Yates shuffle (xorshift).
+    std::vector<size_t> pos(n);
+    for (size_t i = 0;i < n;++i) {
+        pos[i] = i;
+    }
+    unsigned int x = 2463534242U;
+    for (size_t i = 0;i < sample;++i) {
+        x ^= (x << 13);
+        x ^= (x >> 17);
+        x ^= (x << 5);
+        std::swap(pos[i], pos[i + (size_t)x % (n - i)]);
+    }
+    pos.resize(sample);
+    std::sort(pos.begin(), pos.end());
+
+    std::vector<iterator_type> chosen(sample);
+    for (size_t i = 0;i < sample;++i) {
+        chosen[i] = index[pos[i]];
+    }
+    index.swap(chosen);
+}
+
+/**
+ * Counts the results of binary classification on holdout instances.
+ *  This function accumulates the results into the counters, so that a data
+ *  set can be evaluated in parts (e.g., in the blocks of a data stream).
  *  @param  first           The iterator pointing to the first element of the
  *                          dataset.
  *  @param  last            The iterator pointing just beyond the last element
  *                          of the dataset.
  *  @param  cls             The classifier object.
  *  @param  holdout         The group number for holdout evaluation.
+ *  @param  acc             The accuracy counter.
+ *  @param  pr              The precision/recall counter for two labels.
  */
 template <
     class iterator_type,
     class classifier_type
 >
-static void holdout_evaluation_binary(
-    std::ostream& os,
+static void holdout_count_binary(
     iterator_type first,
     iterator_type last,
     classifier_type& cls,
-    int holdout
+    int holdout,
+    accuracy& acc,
+    precall& pr
     )
 {
-    accuracy acc;
-    precall pr(2);
-    static const int positive_labels[] = {1};
-
     // For each instance in the data.
     for (iterator_type it = first;it != last;++it) {
         // Skip instances for training.
@@ -323,6 +454,141 @@ static void holdout_evaluation_binary(
         acc.set(ml == rl);
         pr.set(ml, rl);
     }
+}
+
+/**
+ * Hold-out evaluation for binary classification.
+ *  @param  os              The output stream.
+ *  @param  first           The iterator pointing to the first element of the
+ *                          dataset.
+ *  @param  last            The iterator pointing just beyond the last element
+ *                          of the dataset.
+ *  @param  cls             The classifier object.
+ *  @param  holdout         The group number for holdout evaluation.
+ */
+template <
+    class iterator_type,
+    class classifier_type
+>
+static void holdout_evaluation_binary(
+    std::ostream& os,
+    iterator_type first,
+    iterator_type last,
+    classifier_type& cls,
+    int holdout
+    )
+{
+    accuracy acc;
+    precall pr(2);
+    static const int positive_labels[] = {1};
+
+    holdout_count_binary(first, last, cls, holdout, acc, pr);
+
+    acc.output(os);
+    pr.output_micro(os, positive_labels, positive_labels+1);
+}
+
+
+
+/**
+ * A task counting the results of binary classification on a range of
+ * holdout instances.
+ */
+template <class index_iterator_type, class classifier_type>
+struct holdout_binary_task
+{
+    index_iterator_type first;
+    index_iterator_type last;
+    classifier_type cls;
+    accuracy acc;
+    precall pr;
+
+    holdout_binary_task(const classifier_type& c) : cls(c), pr(2)
+    {
+    }
+
+    void run()
+    {
+        for (index_iterator_type it = first;it != last;++it) {
+            cls.inner_product((*it)->begin(), (*it)->end());
+            int rl = static_cast<int>((*it)->get_label());
+            int ml = static_cast<int>(static_cast<bool>(cls));
+            acc.set(ml == rl);
+            pr.set(ml, rl);
+        }
+    }
+};
+
+/**
+ * Counts the results of binary classification on a list of holdout
+ * instances with multiple threads.
+ *  The list is split into contiguous ranges, each of which is evaluated
+ *  by a thread with its own copy of the classifier and counters; the
+ *  counters are then added to \c acc and \c pr.
+ *  @param  index           The iterators of the holdout instances.
+ *  @param  cls             The classifier object.
+ *  @param  num_threads     The number of threads.
+ *  @param  acc             The accuracy counter.
+ *  @param  pr              The precision/recall counter for two labels.
+ */
+template <
+    class iterator_type,
+    class classifier_type
+>
+static void holdout_count_binary(
+    const std::vector<iterator_type>& index,
+    const classifier_type& cls,
+    int num_threads,
+    accuracy& acc,
+    precall& pr
+    )
+{
+    typedef typename std::vector<iterator_type>::const_iterator index_iterator_type;
+    typedef holdout_binary_task<index_iterator_type, classifier_type> task_type;
+
+    const size_t M = index.size();
+    size_t N = (0 < num_threads) ? (size_t)num_threads : 1;
+    if (M < N) {
+        N = (0 < M) ? M : 1;
+    }
+
+    std::vector<task_type> tasks(N, task_type(cls));
+    for (size_t t = 0;t < N;++t) {
+        tasks[t].first = index.begin() + M * t / N;
+        tasks[t].last = index.begin() + M * (t+1) / N;
+    }
+    run_tasks(tasks);
+
+    for (size_t t = 0;t < N;++t) {
+        acc += tasks[t].acc;
+        pr += tasks[t].pr;
+    }
+}
+
+/**
+ * Hold-out evaluation for binary classification on a list of holdout
+ * instances.
+ *  @param  os              The output stream.
+ *  @param  index           The iterators of the holdout instances.
+ *  @param  cls             The classifier object.
+ *  @param  num_threads     The number of threads.
+ */
+template <
+    class iterator_type,
+    class classifier_type
+>
+static void holdout_evaluation_binary(
+    std::ostream& os,
+    const std::vector<iterator_type>& index,
+    const classifier_type& cls,
+    int num_threads
+    )
+{
+    accuracy acc;
+    precall pr(2);
+    static const int positive_labels[] = {1};
+
+    holdout_count_binary(index, cls, num_threads, acc, pr);
 
     acc.output(os);
     pr.output_micro(os, positive_labels, positive_labels+1);
@@ -330,6 +596,58 @@ static void holdout_evaluation_binary(
 
 
 
+/**
+ * Counts the results of multi-class classification on holdout instances.
+ *  This function accumulates the results into the counters, so that a data
+ *  set can be evaluated in parts (e.g., in the blocks of a data stream).
+ *  @param  first           The iterator pointing to the first element of the
+ *                          dataset.
+ *  @param  last            The iterator pointing just beyond the last element
+ *                          of the dataset.
+ *  @param  cls             The classifier object.
+ *  @param  fgen            The feature generator.
+ *  @param  holdout         The group number for holdout evaluation.
+ *  @param  acconly         \c true to count the accuracy only.
+ *  @param  acc             The accuracy counter.
+ *  @param  pr              The precision/recall counter for the labels.
+ */
+template <
+    class iterator_type,
+    class classifier_type,
+    class feature_generator_type
+>
+static void holdout_count_multi(
+    iterator_type first,
+    iterator_type last,
+    classifier_type& cls,
+    feature_generator_type& fgen,
+    int holdout,
+    bool acconly,
+    accuracy& acc,
+    precall& pr
+    )
+{
+    const int L = fgen.num_labels();
+
+    // For each instance in the data.
+    for (iterator_type it = first;it != last;++it) {
+        // Exclude instances for holdout evaluation.
+        if (it->get_group() != holdout) {
+            continue;
+        }
+
+        // Compute the scores of the candidates.
+        cls.inner_product_instance(fgen, *it, L);
+        cls.finalize();
+
+        int argmax = cls.argmax();
+        acc.set(argmax == it->get_label());
+        if (!acconly) {    
+            pr.set(argmax, it->get_label());
+        }
+    }
+}
+
 /**
  * Hold-out evaluation for multi-class classification.
  *  @param  os              The output stream.
@@ -369,33 +687,148 @@ static void holdout_evaluation_multi(
     accuracy acc;
     precall pr(L);
 
-    // For each instance in the data.
-    for (iterator_type it = first;it != last;++it) {
-        // Exclude instances for holdout evaluation.
-        if (it->get_group() != holdout) {
-            continue;
-        }
+    holdout_count_multi(first, last, cls, fgen, holdout, acconly, acc, pr);
 
-        // Tell the classifier the number of possible labels.
-        cls.resize(it->num_candidates(L));
-
-        for (int i = 0;i < it->num_candidates(L);++i) {
-            cls.inner_product(
-                i,
-                fgen,
-                it->attributes(i).begin(),
-                it->attributes(i).end(),
-                i
-                );
-        }
-        cls.finalize();
+    // Report accuracy, precision, recall, and f1 score.
+    acc.output(os);
+    if (!acconly) {
+        pr.output_labelwise(os, labels, label_first, label_last);
+        pr.output_micro(os, label_first, label_last);
+        pr.output_macro(os, label_first, label_last);
+    }
+}
 
-        int argmax = cls.argmax();
-        acc.set(argmax == it->get_label());
-        if (!acconly) {    
-            pr.set(argmax, it->get_label());
+/**
+ * A task counting the results of multi-class classification on a range of
+ * holdout instances.
+ */
+template <
+    class index_iterator_type,
+    class classifier_type,
+    class feature_generator_type
+>
+struct holdout_multi_task
+{
+    index_iterator_type first;
+    index_iterator_type last;
+    classifier_type cls;
+    const feature_generator_type* fgen;
+    bool acconly;
+    accuracy acc;
+    precall pr;
+
+    holdout_multi_task(
+        const classifier_type& c, const feature_generator_type& fg, bool ao) :
+        cls(c), fgen(&fg), acconly(ao), pr(fg.num_labels())
+    {
+    }
+
+    void run()
+    {
+        const int L = fgen->num_labels();
+        for (index_iterator_type it = first;it != last;++it) {
+            cls.inner_product_instance(*fgen, **it, L);
+            cls.finalize();
+
+            int argmax = cls.argmax();
+            acc.set(argmax == (*it)->get_label());
+            if (!acconly) {
+                pr.set(argmax, (*it)->get_label());
+            }
         }
     }
+};
+
+/**
+ * Counts the results of multi-class classification on a list of holdout
+ * instances with multiple threads.
+ *  The list is split into contiguous ranges, each of which is evaluated
+ *  by a thread with its own copy of the classifier and counters; the
+ *  counters are then added to \c acc and \c pr.
+ *  @param  index           The iterators of the holdout instances.
+ *  @param  cls             The classifier object.
+ *  @param  fgen            The feature generator.
+ *  @param  acconly         \c true to count the accuracy only.
+ *  @param  num_threads     The number of threads.
+ *  @param  acc             The accuracy counter.
+ *  @param  pr              The precision/recall counter for the labels.
+ */
+template <
+    class iterator_type,
+    class classifier_type,
+    class feature_generator_type
+>
+static void holdout_count_multi(
+    const std::vector<iterator_type>& index,
+    const classifier_type& cls,
+    const feature_generator_type& fgen,
+    bool acconly,
+    int num_threads,
+    accuracy& acc,
+    precall& pr
+    )
+{
+    typedef typename std::vector<iterator_type>::const_iterator index_iterator_type;
+    typedef holdout_multi_task<
+        index_iterator_type, classifier_type, feature_generator_type> task_type;
+
+    const size_t M = index.size();
+    size_t N = (0 < num_threads) ? (size_t)num_threads : 1;
+    if (M < N) {
+        N = (0 < M) ? M : 1;
+    }
+
+    std::vector<task_type> tasks(N, task_type(cls, fgen, acconly));
+    for (size_t t = 0;t < N;++t) {
+        tasks[t].first = index.begin() + M * t / N;
+        tasks[t].last = index.begin() + M * (t+1) / N;
+    }
+    run_tasks(tasks);
+
+    for (size_t t = 0;t < N;++t) {
+        acc += tasks[t].acc;
+        pr += tasks[t].pr;
+    }
+}
+
+/**
+ * Hold-out evaluation for multi-class classification on a list of holdout
+ * instances.
+ *  @param  os              The output stream.
+ *  @param  index           The iterators of the holdout instances.
+ *  @param  cls             The classifier object.
+ *  @param  fgen            The feature generator.
+ *  @param  acconly         \c true to report the accuracy only.
+ *  @param  num_threads     The number of threads.
+ *  @param  labels          The label set.
+ *  @param  label_first     The iterator pointing to the first element of the
+ *                          set of positive labels.
+ *  @param  label_last      The iterator pointing just beyond the last element
+ *                          of the set of positive labels.
+ */
+template <
+    class iterator_type,
+    class classifier_type,
+    class feature_generator_type,
+    class labels_type,
+    class label_iterator_type
+>
+static void holdout_evaluation_multi(
+    std::ostream& os,
+    const std::vector<iterator_type>& index,
+    const classifier_type& cls,
+    const feature_generator_type& fgen,
+    bool acconly,
+    int num_threads,
+    const labels_type& labels,
+    label_iterator_type label_first,
+    label_iterator_type label_last
+    )
+{
+    accuracy acc;
+    precall pr(fgen.num_labels());
+
+    holdout_count_multi(index, cls, fgen, acconly, num_threads, acc, pr);
 
     // Report accuracy, precision, recall, and f1 score.
     acc.output(os);
@@ -33,6 +33,8 @@
 #ifndef __CLASSIAS_FEATURE_GENERATOR_H__
 #define __CLASSIAS_FEATURE_GENERATOR_H__
 
+#include <utility>
+#include <vector>
 #include "quark.h"
 
 namespace classias
@@ -138,6 +140,16 @@ public:
     {
     }
 
+    /**
+     * Returns the memory used by the feature generator.
+     *  @return size_t      The number of bytes, which is always zero since
+     *                      features are computed without a table.
+     */
+    size_t memory_usage() const
+    {
+        return 0;
+    }
+
     /**
      * Returns if this class requires registration.
      *  @return bool            This class always returns \c false.
@@ -308,6 +320,16 @@ public:
         m_num_labels = num_labels;
     }
 
+    /**
+     * Returns the memory used by the feature generator.
+     *  @return size_t      The number of bytes, which is always zero since
+     *                      features are computed without a table.
+     */
+    size_t memory_usage() const
+    {
+        return 0;
+    }
+
     /**
      * Returns if this class requires registration.
      *  @return bool    This class always returns \c false.
@@ -402,6 +424,10 @@ public:
     typedef label_tmpl label_type;
     /// The type of a feature.
     typedef feature_tmpl feature_type;
+    /// The type of a posting: a label and its feature for an attribute.
+    typedef std::pair<label_type, feature_type> posting_type;
+    /// The type of the posting list of an attribute.
+    typedef std::vector<posting_type> postings_type;
 
 protected:
     /// The total number of labels.
@@ -414,6 +440,8 @@ protected:
     typedef quark2_base<attribute_type, label_type> feature_generator_type;
     /// Associations between (attribute, label) and features.
     feature_generator_type m_features;
+    /// The posting lists of the labels associated with the attributes.
+    std::vector<postings_type> m_postings;
 
 public:
     /**
@@ -477,6 +505,20 @@ public:
         m_num_labels = num_labels;
     }
 
+    /**
+     * Returns the memory used by the feature generator.
+     *  @return size_t      The approximate number of bytes held by the
+     *                      associations and the posting lists.
+     */
+    size_t memory_usage() const
+    {
+        size_t bytes = m_features.memory_usage() + classias::memory_usage(m_postings);
+        for (size_t i = 0;i < m_postings.size();++i) {
+            bytes += classias::memory_usage(m_postings[i]);
+        }
+        return bytes;
+    }
+
     /**
      * Returns if this class requires registration.
      *  @return bool    This class always returns \c true.
@@ -494,7 +536,16 @@ public:
      */
     inline feature_type regist(const attribute_type& a, const label_type& l)
     {
-        return m_features.associate(a, l);
+        const size_t n = m_features.size();
+        feature_type f = m_features.associate(a, l);
+        if (n != m_features.size()) {
+            // Append the new association to the posting list.
+            if (m_postings.size() <= (size_t)a) {
+                m_postings.resize((size_t)a + 1);
+            }
+            m_postings[a].push_back(posting_type(l, f));
+        }
+        return f;
     }
 
     /**
@@ -516,6 +567,27 @@ public:
         return (f != -1);
     }
 
+    /**
+     * Calls a function for every label associated with an attribute.
+     *  Most pairs of an attribute and label have no feature in a sparse
+     *  model; this function visits only the pairs registered for the
+     *  attribute (in the order of registration) by calling func(l, f) for
+     *  every label l and its feature f, without a lookup of the hash table.
+     *  The attributes must be non-negative integers.
+     *  @param  a               The attribute.
+     *  @param  func            The function object.
+     */
+    template <class function_type>
+    inline void postings(const attribute_type& a, function_type& func) const
+    {
+        if ((size_t)a < m_postings.size()) {
+            const postings_type& p = m_postings[a];
+            for (typename postings_type::const_iterator it = p.begin();it != p.end();++it) {
+                func(it->first, it->second);
+            }
+        }
+    }
+
     /**
      * Returns the attribute and label associated with a feature.
      *  @param  f               The feature.
@@ -0,0 +1,326 @@
+/*
+ *		Quark mapping items to hashed identifiers.
+ *
+ * Copyright (c) 2008,2009 Naoaki Okazaki
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the names of the authors nor the names of its contributors
+ *       may be used to endorse or promote products derived from this
+ *       software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* $Id$ */
+
+#ifndef __CLASSIAS_HASHED_QUARK_H__
+#define __CLASSIAS_HASHED_QUARK_H__
+
+#include <cstring>
+#include <string>
+#include <stdint.h>
+#include "quark.h"
+
+namespace classias
+{
+
+/**
+ * Computes the 32-bit MurmurHash3 value of a byte sequence.
+ *  @param  key         The pointer to the byte sequence.
+ *  @param  len         The length of the byte sequence.
+ *  @param  seed        The seed.
+ *  @return uint32_t    The hash value.
+ */
+inline uint32_t murmurhash3(const void* key, size_t len, uint32_t seed = 0)
+{
+    const uint32_t c1 = 0xcc9e2d51;
+    const uint32_t c2 = 0x1b873593;
+    const unsigned char* p = (const unsigned char*)key;
+    const size_t nblocks = len / 4;
+    uint32_t h = seed;
+
+    for (size_t i = 0;i < nblocks;++i) {
+        uint32_t k;
+        std::memcpy(&k, p + i * 4, sizeof(k));
+        k *= c1;
+        k = (k << 15) | (k >> 17);
+        k *= c2;
+        h ^= k;
+        h = (h << 13) | (h >> 19);
+        h = h * 5 + 0xe6546b64;
+    }
+
+    const unsigned char* tail = p + nblocks * 4;
+    uint32_t k = 0;
+    switch (len & 3) {
+    case 3:
+        k ^= (uint32_t)tail[2] << 16;
+        /* FALLTHROUGH */
+    case 2:
+        k ^= (uint32_t)tail[1] << 8;
+        /* FALLTHROUGH */
+    case 1:
+        k ^= (uint32_t)tail[0];
+        k *= c1;
+        k = (k << 15) | (k >> 17);
+        k *= c2;
+        h ^= k;
+    }
+
+    h ^= (uint32_t)len;
+    h ^= h >> 16;
+    h *= 0x85ebca6b;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35;
+    h ^= h >> 16;
+    return h;
+}
+
+/**
+ * Quark mapping items to the buckets of a hashed feature space.
+ *
+ *  This class exposes the interface of \ref quark_base for attributes, but
+ *  stores no item: an item is mapped to one of 2^b buckets by the lower
+ *  b bits of its hash value. A few items (e.g., the bias attribute) can be
+ *  reserved to obtain the identifiers 0, 1, ... before the buckets, which
+ *  start from the number of reserved items. The upper bit of the hash value
+ *  gives an optional sign of an item, by which the attribute value is
+ *  multiplied to reduce the bias of hash collisions in inner products
+ *  (signed hashing).
+ *
+ *  Items must be reserved before mapping any other item, since reserving
+ *  an item shifts the identifiers of the buckets.
+ *
+ *  @param  item_base       The type of an item, which provides data() and
+ *                          size() to access its bytes (e.g., std::string).
+ */
+template <class item_base>
+class hashed_quark_base
+{
+public:
+    /// The type representing an item.
+    typedef item_base item_type;
+    /// The type of this class.
+    typedef hashed_quark_base<item_base> this_class;
+    /// The type representing an identifier.
+    typedef size_t value_type;
+
+protected:
+    /// The reserved items.
+    quark_base<item_type> m_reserved;
+    /// The number of bits of the buckets.
+    int m_bits;
+    /// Whether items have signs.
+    bool m_signed;
+    /// Whether an item has been mapped to a bucket.
+    bool m_hashed;
+
+public:
+    /**
+     * Constructs the object.
+     *  @param  bits            The number of bits of the buckets (1-30).
+     *  @param  sign            \c true to give signs to items.
+     */
+    hashed_quark_base(int bits = 18, bool sign = false)
+        : m_bits(bits), m_signed(sign), m_hashed(false)
+    {
+    }
+
+    /**
+     * Destructs the object.
+     */
+    virtual ~hashed_quark_base()
+    {
+    }
+
+    /**
+     * Sets the number of bits of the buckets.
+     *  @param  bits            The number of bits (1-30).
+     */
+    void set_bits(int bits)
+    {
+        if (bits < 1 || 30 < bits) {
+            throw quark_error("The number of hash bits must be in [1, 30]");
+        }
+        m_bits = bits;
+    }
+
+    /**
+     * Returns the number of bits of the buckets.
+     *  @return int             The number of bits.
+     */
+    int bits() const
+    {
+        return m_bits;
+    }
+
+    /**
+     * Enables or disables signs of items.
+     *  @param  sign            \c true to give signs to items.
+     */
+    void set_signed(bool sign)
+    {
+        m_signed = sign;
+    }
+
+    /**
+     * Tests whether items have signs.
+     *  @retval bool            \c true if items have signs.
+     */
+    bool is_signed() const
+    {
+        return m_signed;
+    }
+
+    /**
+     * Returns the number of identifiers (reserved items and buckets).
+     *  @return value_type      The number of identifiers.
+     */
+    inline value_type size() const
+    {
+        return m_reserved.size() + ((value_type)1 << m_bits);
+    }
+
+    /**
+     * Returns the number of bytes held by the reserved items.
+     *  The buckets are computed by the hash function and take no memory.
+     *  @retval size_t          The number of bytes (approximate).
+     */
+    inline size_t memory_usage() const
+    {
+        return m_reserved.memory_usage();
+    }
+
+    /**
+     * Returns the number of reserved items.
+     *  @return value_type      The number of reserved items.
+     */
+    inline value_type num_reserved() const
+    {
+        return m_reserved.size();
+    }
+
+    /**
+     * Tests whether an item has an identifier assigned, which is always
+     * \c true.
+     *  @param  x               The item.
+     *  @retval bool            \c true.
+     */
+    inline bool exists(const item_type& x) const
+    {
+        return true;
+    }
+
+    /**
+     * Reserves an identifier for an item.
+     *  @param  x               The item.
+     *  @return value_type      The identifier of the item.
+     *  @throws quark_error     A new item is reserved after the buckets are
+     *                          used.
+     */
+    inline value_type reserve(const item_type& x)
+    {
+        value_type v = m_reserved.to_value(x, m_reserved.size());
+        if (v == m_reserved.size()) {
+            if (m_hashed) {
+                throw quark_error("An item must be reserved before hashing items");
+            }
+            v = m_reserved(x);
+        }
+        return v;
+    }
+
+    /**
+     * Returns the identifier for an item.
+     *  @param  x               The item.
+     *  @return value_type      The identifier.
+     */
+    inline value_type operator() (const item_type& x)
+    {
+        double sign;
+        m_hashed = true;
+        return to_value(x, sign);
+    }
+
+    /**
+     * Returns the identifier and the sign for an item.
+     *  @param  x               The item.
+     *  @param  sign            The sign of the item, which is -1 or +1 if
+     *                          items have signs, and always +1 otherwise.
+     *  @return value_type      The identifier.
+     */
+    inline value_type operator() (const item_type& x, double& sign)
+    {
+        m_hashed = true;
+        return to_value(x, sign);
+    }
+
+    /**
+     * Returns the identifier for an item.
+     *  @param  x               The item.
+     *  @return value_type      The identifier.
+     */
+    inline value_type to_value(const item_type& x) const
+    {
+        double sign;
+        return to_value(x, sign);
+    }
+
+    /**
+     * Returns the identifier and the sign for an item.
+     *  @param  x               The item.
+     *  @param  sign            The sign of the item.
+     *  @return value_type      The identifier.
+     */
+    inline value_type to_value(const item_type& x, double& sign) const
+    {
+        const value_type R = m_reserved.size();
+        if (0 < R) {
+            value_type v = m_reserved.to_value(x, R);
+            if (v < R) {
+                sign = 1.;
+                return v;
+            }
+        }
+
+        uint32_t h = murmurhash3(x.data(), x.size() * sizeof(x[0]));
+        sign = (m_signed && (h & 0x80000000U) ? -1. : 1.);
+        return R + (value_type)(h & (((uint32_t)1 << m_bits) - 1));
+    }
+
+    /**
+     * Returns the item of a reserved identifier.
+     *  @param  v               The identifier.
+     *  @return item_type&      The reference to the reserved item.
+     *  @throws quark_error     The identifier is not reserved (buckets
+     *                          have no item).
+     */
+    inline const item_type& to_item(const value_type& v) const
+    {
+        return m_reserved.to_item(v);
+    }
+};
+
+/// The quark hashing strings.
+typedef hashed_quark_base<std::string> hashed_quark;
+
+};
+
+#endif/*__CLASSIAS_HASHED_QUARK_H__*/
@@ -244,9 +244,15 @@ public:
  *  instance for candidate classification consists of multiple candidates
  *  each of which consists of a feature vector (implemented by
  *  attributes_tmpl). The true candidate is specified by a candidate index
- *  (implemented in this class). In addition, an instance class exposes the
- *  interfaces for instance weighting (implemented by weight_tmpl) and
- *  instance group numbers (implemented by group_tmpl).
+ *  (implemented in this class). An instance may also have a block of
+ *  attributes shared by all candidates (e.g., query-level attributes for
+ *  reranking), which is stored once instead of being repeated in every
+ *  candidate; the attributes of a candidate are then the shared attributes
+ *  plus its own ones. The shared attributes must yield the same features
+ *  for all candidates (as thru_feature_generator_base does). In addition,
+ *  an instance class exposes the interfaces for instance weighting
+ *  (implemented by weight_tmpl) and instance group numbers (implemented by
+ *  group_tmpl).
  *
  *  @param  attributes_tmpl The type of an attribute vector.
  *  @param  weight_tmpl     The base class implementing instance weighting.
@@ -285,6 +291,8 @@ public:
 protected:
     /// A container of all candidates associated with the instance.
     candidates_type candidates;
+    /// The attributes shared by all candidates.
+    attributes_type m_shared;
     /// The label of this instance.
     int m_label;
 
@@ -309,6 +317,7 @@ public:
     inline void clear()
     {
         candidates.clear();
+        m_shared.clear();
         m_label = -1;
     }
 
@@ -331,6 +340,20 @@ public:
         return candidates.size();
     }
 
+    /**
+     * Returns the memory used by the candidates.
+     *  @retval size_t      The number of bytes allocated for the candidates
+     *                      and their attributes.
+     */
+    inline size_t memory_usage() const
+    {
+        size_t bytes = candidates.capacity() * sizeof(candidate_type);
+        for (const_iterator it = candidates.begin();it != candidates.end();++it) {
+            bytes += it->memory_usage();
+        }
+        return bytes + m_shared.memory_usage();
+    }
+
     /**
      * Returns a random-access iterator to the first candidate.
      *  @retval iterator    A random-access iterator (for read/write)
@@ -444,8 +467,57 @@ public:
     {
         return this->candidates[i];
     }
+
+    /**
+     * Returns a read-only access to the attributes shared by all candidates.
+     *  @return const attributes_type&  The reference to the shared attribute
+     *                                  vector, which is not included in
+     *                                  attributes(i).
+     */
+    inline const attributes_type& shared() const
+    {
+        return this->m_shared;
+    }
+
+    /**
+     * Returns an access to the attributes shared by all candidates.
+     *  @return attributes_type&        The reference to the shared attribute
+     *                                  vector, which is not included in
+     *                                  attributes(i).
+     */
+    inline attributes_type& shared()
+    {
+        return this->m_shared;
+    }
 };
 
+
+
+/**
+ * Returns the attributes shared by all candidates of an instance.
+ *  The candidates of a multi-class instance share the attribute vector but
+ *  not the features, which depend on the labels; thus this function
+ *  returns \c NULL for a multi-class instance.
+ *  @param  inst        The instance.
+ *  @return const attributes_type*  The pointer to the shared attributes, or
+ *                                  \c NULL if the instance has none.
+ */
+template <class attributes_type, class weight_type, class group_type>
+inline const attributes_type* shared_attributes(
+    const multi_instance_base<attributes_type, weight_type, group_type>& inst
+    )
+{
+    return NULL;
+}
+
+template <class attributes_type, class weight_type, class group_type>
+inline const attributes_type* shared_attributes(
+    const candidate_instance_base<attributes_type, weight_type, group_type>& inst
+    )
+{
+    return inst.shared().empty() ? NULL : &inst.shared();
+}
+
 };
 
 #endif/*__CLASSIAS_INSTANCE_H__*/
@@ -0,0 +1,509 @@
+/*
+ *		Placement of large memory blocks (huge pages and NUMA policies) and
+ *		accounting of memory usage.
+ *
+ * Copyright (c) 2008,2009 Naoaki Okazaki
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the names of the authors nor the names of its contributors
+ *       may be used to endorse or promote products derived from this
+ *       software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* $Id$ */
+
+#ifndef __CLASSIAS_MEMORY_H__
+#define __CLASSIAS_MEMORY_H__
+
+#include <cstddef>
+#include <cstdlib>
+#include <limits>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#if defined(HAVE_SYS_MMAN_H)
+#include <sys/mman.h>
+#include <unistd.h>
+#endif/*HAVE_SYS_MMAN_H*/
+
+#if defined(HAVE_NUMAIF_H) && defined(HAVE_LIBNUMA)
+#include <numa.h>
+#include <numaif.h>
+#endif/*defined(HAVE_NUMAIF_H) && defined(HAVE_LIBNUMA)*/
+
+namespace classias
+{
+
+/**
+ * The policy for placing large memory blocks.
+ *
+ *  A block larger than the threshold (e.g., a weight vector, the flat
+ *  arrays of a data set, or a gradient buffer of a thread) is mapped
+ *  directly from the system, so that it can be backed by huge pages
+ *  and placed on NUMA nodes by the policy; smaller blocks are allocated
+ *  by the operator new as usual.
+ */
+struct memory_policy
+{
+    enum {
+        PAGES_DEFAULT = 0,      ///< The page size of the system.
+        PAGES_TRANSPARENT,      ///< Transparent huge pages (madvise).
+        PAGES_2MB,              ///< Explicit 2MB huge pages (hugetlbfs).
+        PAGES_1GB,              ///< Explicit 1GB huge pages (hugetlbfs).
+    };
+
+    enum {
+        NUMA_LOCAL = 0,         ///< The node of the thread touching a page.
+        NUMA_INTERLEAVE,        ///< Pages interleaved over all nodes.
+        NUMA_BIND,              ///< Pages bound to a node.
+    };
+
+    /// The size of pages.
+    int pages;
+    /// The NUMA policy.
+    int numa;
+    /// The node for NUMA_BIND.
+    int node;
+    /// The minimum size of a block in bytes placed by this policy.
+    size_t threshold;
+
+    /**
+     * Constructs the object with the default policy of the system.
+     */
+    memory_policy() :
+        pages(PAGES_DEFAULT), numa(NUMA_LOCAL), node(0), threshold(1 << 21)
+    {
+    }
+
+    /**
+     * Tests whether the policy differs from the default of the system.
+     *  @return bool        \c true if large blocks are placed by the policy.
+     */
+    bool enabled() const
+    {
+        return (pages != PAGES_DEFAULT || numa != NUMA_LOCAL);
+    }
+
+    /**
+     * Tests whether the build supports huge pages.
+     */
+    static bool huge_pages_supported()
+    {
+#if defined(HAVE_SYS_MMAN_H)
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    /**
+     * Tests whether the build (and the system) supports NUMA policies.
+     */
+    static bool numa_supported()
+    {
+#if defined(HAVE_NUMAIF_H) && defined(HAVE_LIBNUMA)
+        return (numa_available() != -1);
+#else
+        return false;
+#endif
+    }
+
+    /**
+     * Obtains the number of NUMA nodes of the system.
+     *  @return int         The number of nodes (one without NUMA support).
+     */
+    static int num_nodes()
+    {
+#if defined(HAVE_NUMAIF_H) && defined(HAVE_LIBNUMA)
+        if (numa_available() != -1) {
+            return numa_max_node() + 1;
+        }
+#endif
+        return 1;
+    }
+};
+
+/**
+ * Obtains the policy for placing large memory blocks in the process.
+ *  Set the policy before allocating the data set and models; a block keeps
+ *  the placement chosen at its allocation.
+ *  @return memory_policy&  The policy.
+ */
+inline memory_policy& global_memory_policy()
+{
+    static memory_policy policy;
+    return policy;
+}
+
+/**
+ * The header preceding a block, which records how the block was obtained.
+ *  The header occupies a cache line so that the block is aligned to 64
+ *  bytes.
+ */
+union memory_block_header
+{
+    /// The length of the mapping (zero for a block from the operator new).
+    size_t length;
+    char padding[64];
+};
+
+#if defined(HAVE_SYS_MMAN_H)
+/**
+ * Maps a block of memory with the policy.
+ *  @param  bytes           The size of the block including the header.
+ *  @param  mp              The policy.
+ *  @param  length          The length of the mapping.
+ *  @return void*           The pointer to the mapping, or \c NULL.
+ */
+inline void* map_memory(size_t bytes, const memory_policy& mp, size_t& length)
+{
+    void *p = MAP_FAILED;
+    const size_t page = (size_t)sysconf(_SC_PAGESIZE);
+
+#if defined(MAP_HUGETLB)
+    // Explicit huge pages, falling back to 2MB pages for a block smaller
+    // than half of a 1GB page, and to normal pages if none is reserved.
+    if (mp.pages == memory_policy::PAGES_2MB || mp.pages == memory_policy::PAGES_1GB) {
+        int shift = 21;
+        if (mp.pages == memory_policy::PAGES_1GB && ((size_t)1 << 29) <= bytes) {
+            shift = 30;
+        }
+        const size_t huge = (size_t)1 << shift;
+        length = (bytes + huge - 1) / huge * huge;
+        int flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB;
+#if defined(MAP_HUGE_SHIFT)
+        flags |= (shift << MAP_HUGE_SHIFT);
+#endif
+        p = mmap(NULL, length, PROT_READ | PROT_WRITE, flags, -1, 0);
+    }
+#endif/*MAP_HUGETLB*/
+
+    if (p == MAP_FAILED) {
+        length = (bytes + page - 1) / page * page;
+        p = mmap(
+            NULL, length, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (p == MAP_FAILED) {
+            return NULL;
+        }
+#if defined(MADV_HUGEPAGE)
+        if (mp.pages != memory_policy::PAGES_DEFAULT) {
+            madvise(p, length, MADV_HUGEPAGE);
+        }
+#endif/*MADV_HUGEPAGE*/
+    }
+
+#if defined(HAVE_NUMAIF_H) && defined(HAVE_LIBNUMA)
+    // Set the NUMA policy before the pages are touched.
+    if (mp.numa != memory_policy::NUMA_LOCAL && numa_available() != -1) {
+        const int N = numa_max_node() + 1;
+        const int B = (int)(8 * sizeof(unsigned long));
+        std::vector<unsigned long> mask((size_t)(N + B - 1) / B, 0UL);
+        if (mp.numa == memory_policy::NUMA_INTERLEAVE) {
+            for (int i = 0;i < N;++i) {
+                mask[i / B] |= (1UL << (i % B));
+            }
+            mbind(p, length, MPOL_INTERLEAVE, &mask[0], (unsigned long)N + 1, 0);
+        } else if (0 <= mp.node && mp.node < N) {
+            mask[mp.node / B] |= (1UL << (mp.node % B));
+            mbind(p, length, MPOL_BIND, &mask[0], (unsigned long)N + 1, 0);
+        }
+    }
+#endif/*defined(HAVE_NUMAIF_H) && defined(HAVE_LIBNUMA)*/
+
+    return p;
+}
+#endif/*HAVE_SYS_MMAN_H*/
+
+/**
+ * Allocates a block of memory with the policy of the process.
+ *  @param  bytes           The size of the block.
+ *  @return void*           The pointer to the block.
+ *  @throw  std::bad_alloc  If the memory is exhausted.
+ */
+inline void* allocate_memory(size_t bytes)
+{
+    const size_t H = sizeof(memory_block_header);
+
+#if defined(HAVE_SYS_MMAN_H)
+    const memory_policy& mp = global_memory_policy();
+    if (mp.enabled() && mp.threshold <= bytes) {
+        size_t length = 0;
+        void *p = map_memory(bytes + H, mp, length);
+        if (p == NULL) {
+            throw std::bad_alloc();
+        }
+        reinterpret_cast<memory_block_header*>(p)->length = length;
+        return reinterpret_cast<char*>(p) + H;
+    }
+#endif/*HAVE_SYS_MMAN_H*/
+
+    void *p = ::operator new(bytes + H);
+    reinterpret_cast<memory_block_header*>(p)->length = 0;
+    return reinterpret_cast<char*>(p) + H;
+}
+
+/**
+ * Releases a block allocated by allocate_memory().
+ *  @param  block           The pointer to the block.
+ */
+inline void deallocate_memory(void *block)
+{
+    if (block == NULL) {
+        return;
+    }
+
+    void *p = reinterpret_cast<char*>(block) - sizeof(memory_block_header);
+#if defined(HAVE_SYS_MMAN_H)
+    const size_t length = reinterpret_cast<memory_block_header*>(p)->length;
+    if (0 < length) {
+        munmap(p, length);
+        return;
+    }
+#endif/*HAVE_SYS_MMAN_H*/
+    ::operator delete(p);
+}
+
+
+
+/**
+ * An allocator placing large blocks with the policy of the process.
+ *  The allocator is stateless: a block records how it was obtained, so that
+ *  any instance of the allocator can release it.
+ *  @param  T               The type of elements.
+ */
+template <class T>
+class placed_allocator
+{
+public:
+    typedef T value_type;
+    typedef T* pointer;
+    typedef const T* const_pointer;
+    typedef T& reference;
+    typedef const T& const_reference;
+    typedef size_t size_type;
+    typedef ptrdiff_t difference_type;
+
+    template <class U>
+    struct rebind
+    {
+        typedef placed_allocator<U> other;
+    };
+
+    placed_allocator()
+    {
+    }
+
+    placed_allocator(const placed_allocator&)
+    {
+    }
+
+    template <class U>
+    placed_allocator(const placed_allocator<U>&)
+    {
+    }
+
+    pointer address(reference x) const
+    {
+        return &x;
+    }
+
+    const_pointer address(const_reference x) const
+    {
+        return &x;
+    }
+
+    pointer allocate(size_type n, const void* = 0)
+    {
+        if (max_size() < n) {
+            throw std::bad_alloc();
+        }
+        return reinterpret_cast<pointer>(allocate_memory(n * sizeof(T)));
+    }
+
+    void deallocate(pointer p, size_type)
+    {
+        deallocate_memory(p);
+    }
+
+    size_type max_size() const
+    {
+        return (std::numeric_limits<size_type>::max() - 64) / sizeof(T);
+    }
+
+    void construct(pointer p, const T& value)
+    {
+        new(p) T(value);
+    }
+
+    void destroy(pointer p)
+    {
+        p->~T();
+    }
+};
+
+template <class T, class U>
+inline bool operator==(const placed_allocator<T>&, const placed_allocator<U>&)
+{
+    return true;
+}
+
+template <class T, class U>
+inline bool operator!=(const placed_allocator<T>&, const placed_allocator<U>&)
+{
+    return false;
+}
+
+/**
+ * Returns the number of bytes held by a vector for its capacity.
+ *  This and the following functions account the memory of the containers
+ *  approximately: the elements of the heap blocks are counted, but the
+ *  bookkeeping of the allocator is not.
+ *  @param  v               The vector.
+ *  @return size_t          The number of bytes.
+ */
+template <class value_type, class allocator_type>
+inline size_t memory_usage(const std::vector<value_type, allocator_type>& v)
+{
+    return v.capacity() * sizeof(value_type);
+}
+
+/**
+ * Returns the number of bytes held by an item outside the item.
+ *  @param  x               The item.
+ *  @return size_t          The number of bytes (zero for an item without
+ *                          a heap block).
+ */
+template <class item_type>
+inline size_t item_memory_usage(const item_type&)
+{
+    return 0;
+}
+
+inline size_t item_memory_usage(const std::string& x)
+{
+    // A short string is stored in the object itself by common libraries.
+    return (15 < x.capacity() ? x.capacity() + 1 : 0);
+}
+
+/**
+ * Returns the number of bytes held by the nodes of an associative
+ * container (a tree or a hash table), excluding the heap blocks of the
+ * keys and values.
+ *  A node holds an element and about four words: the links of a tree, or
+ *  the link, the hash value, and the bucket of a hash table.
+ *  @param  m               The container.
+ *  @return size_t          The number of bytes.
+ */
+template <class map_type>
+inline size_t map_memory_usage(const map_type& m)
+{
+    return m.size() * (sizeof(typename map_type::value_type) + 4 * sizeof(void*));
+}
+
+/**
+ * Parses a size of memory.
+ *  @param  value           The size in bytes with an optional suffix, 'K',
+ *                          'M', 'G', or 'T' (powers of 1024).
+ *  @param  bytes           The size in bytes.
+ *  @return bool            \c false if the value is invalid.
+ */
+inline bool parse_memory_size(const std::string& value, double& bytes)
+{
+    char *end = NULL;
+    double x = std::strtod(value.c_str(), &end);
+    if (value.empty() || end == value.c_str() || x < 0.) {
+        return false;
+    }
+    switch (*end) {
+    case 0:                 break;
+    case 'K': case 'k':     x *= 1024.; ++end; break;
+    case 'M': case 'm':     x *= 1024. * 1024.; ++end; break;
+    case 'G': case 'g':     x *= 1024. * 1024. * 1024.; ++end; break;
+    case 'T': case 't':     x *= 1024. * 1024. * 1024. * 1024.; ++end; break;
+    default:                return false;
+    }
+    if (*end == 'B' || *end == 'b') {
+        ++end;
+    }
+    if (*end != 0) {
+        return false;
+    }
+    bytes = x;
+    return true;
+}
+
+/**
+ * Parses the size of pages for memory_policy.
+ *  @param  mp              The policy.
+ *  @param  value           The size: "none", "transparent", "2mb", or "1gb".
+ *  @return bool            \c false if the value is unknown.
+ */
+inline bool parse_huge_pages(memory_policy& mp, const std::string& value)
+{
+    if (value == "none") {
+        mp.pages = memory_policy::PAGES_DEFAULT;
+    } else if (value == "transparent") {
+        mp.pages = memory_policy::PAGES_TRANSPARENT;
+    } else if (value == "2mb") {
+        mp.pages = memory_policy::PAGES_2MB;
+    } else if (value == "1gb") {
+        mp.pages = memory_policy::PAGES_1GB;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Parses the NUMA policy for memory_policy.
+ *  @param  mp              The policy.
+ *  @param  value           The policy: "local", "interleave", or "bind:N".
+ *  @return bool            \c false if the value is unknown.
+ */
+inline bool parse_numa_policy(memory_policy& mp, const std::string& value)
+{
+    if (value == "local") {
+        mp.numa = memory_policy::NUMA_LOCAL;
+    } else if (value == "interleave") {
+        mp.numa = memory_policy::NUMA_INTERLEAVE;
+    } else if (value.compare(0, 5, "bind:") == 0 && 5 < value.size()) {
+        int node = 0;
+        for (size_t i = 5;i < value.size();++i) {
+            if (value[i] < '0' || '9' < value[i]) {
+                return false;
+            }
+            node = node * 10 + (value[i] - '0');
+        }
+        mp.numa = memory_policy::NUMA_BIND;
+        mp.node = node;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+};
+
+#endif/*__CLASSIAS_MEMORY_H__*/
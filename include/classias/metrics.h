@@ -0,0 +1,331 @@
+/*
+ *		Timers and the stream of training metrics.
+ *
+ * Copyright (c) 2008,2009 Naoaki Okazaki
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the names of the authors nor the names of its contributors
+ *       may be used to endorse or promote products derived from this
+ *       software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* $Id$ */
+
+#ifndef __CLASSIAS_METRICS_H__
+#define __CLASSIAS_METRICS_H__
+
+#include <cstddef>
+#include <ctime>
+#include <iomanip>
+#include <ostream>
+#include <sstream>
+#include <string>
+
+#if defined(_MSC_VER)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#elif defined __GNUC__
+#include <time.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#endif
+
+#include "instance.h"
+#include "thread.h"
+
+namespace classias
+{
+
+/**
+ * Returns the time elapsed from an arbitrary origin in seconds.
+ *  The clock is monotonic where the platform provides such a clock, so
+ *  that the difference of two readings is not disturbed by adjustments of
+ *  the system time.
+ *  @return double          The wall-clock time in seconds.
+ */
+inline double wall_clock()
+{
+#if defined(_MSC_VER)
+    LARGE_INTEGER freq, count;
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&count);
+    return count.QuadPart / (double)freq.QuadPart;
+#elif defined(CLOCK_MONOTONIC)
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+#elif defined __GNUC__
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec * 1e-6;
+#else
+    return (double)std::time(NULL);
+#endif
+}
+
+/**
+ * Returns the processor time used by the process (of all threads).
+ *  @return double          The CPU time in seconds.
+ */
+inline double cpu_clock()
+{
+    return std::clock() / (double)CLOCKS_PER_SEC;
+}
+
+/**
+ * Returns the peak resident set size of the process.
+ *  @return double          The peak RSS in bytes, or zero if unknown.
+ */
+inline double peak_rss()
+{
+#if defined(_MSC_VER)
+    return 0.;
+#elif defined __GNUC__
+    struct rusage ru;
+    if (getrusage(RUSAGE_SELF, &ru) != 0) {
+        return 0.;
+    }
+#if defined(__APPLE__)
+    return (double)ru.ru_maxrss;
+#else
+    return ru.ru_maxrss * 1024.;
+#endif
+#else
+    return 0.;
+#endif
+}
+
+/**
+ * Returns the number of elements (attribute-value pairs) of an instance.
+ *  @param  inst            The instance.
+ *  @return size_t          The number of elements.
+ */
+template <class instance_type>
+inline size_t num_elements(const instance_type& inst)
+{
+    return (size_t)inst.size();
+}
+
+template <class attributes_type, class weight_type, class group_type>
+inline size_t num_elements(
+    const candidate_instance_base<attributes_type, weight_type, group_type>& inst
+    )
+{
+    size_t n = 0;
+    typename candidate_instance_base<
+        attributes_type, weight_type, group_type>::const_iterator it;
+    for (it = inst.begin();it != inst.end();++it) {
+        n += (size_t)it->size();
+    }
+    return n + (size_t)inst.shared().size();
+}
+
+/**
+ * Counts the instances and elements used for training.
+ *  @param  data            The data set.
+ *  @param  holdout         The group number of the instances excluded.
+ *  @param  instances       The number of instances.
+ *  @param  elements        The number of elements in the instances.
+ */
+template <class data_type>
+inline void count_training(
+    const data_type& data,
+    int holdout,
+    double& instances,
+    double& elements
+    )
+{
+    instances = 0.;
+    elements = 0.;
+    for (typename data_type::const_iterator it = data.begin();it != data.end();++it) {
+        if (it->get_group() != holdout) {
+            instances += 1.;
+            elements += (double)num_elements(*it);
+        }
+    }
+}
+
+/**
+ * Writes a string in JSON to a stream.
+ *  @param  os              The output stream.
+ *  @param  str             The string.
+ */
+inline void write_json_string(std::ostream& os, const std::string& str)
+{
+    static const char hex[] = "0123456789abcdef";
+    os << '"';
+    for (size_t i = 0;i < str.size();++i) {
+        const char c = str[i];
+        if (c == '"' || c == '\\') {
+            os << '\\' << c;
+        } else if ((unsigned char)c < 0x20) {
+            os << "\\u00" << hex[(c >> 4) & 0xF] << hex[c & 0xF];
+        } else {
+            os << c;
+        }
+    }
+    os << '"';
+}
+
+/**
+ * A record of training metrics.
+ *  Add the fields of a record with add(), and pass the record to
+ *  metrics::write().
+ */
+class metrics_record
+{
+protected:
+    std::string m_event;
+    std::ostringstream m_fields;
+
+public:
+    /**
+     * Constructs the object.
+     *  @param  event           The name of the event.
+     */
+    explicit metrics_record(const char *event) : m_event(event)
+    {
+        m_fields << std::setprecision(10);
+    }
+
+    /**
+     * Adds a numeric field.
+     *  @param  name            The name of the field.
+     *  @param  value           The value.
+     */
+    template <class value_type>
+    void add(const char *name, const value_type& value)
+    {
+        m_fields << ", ";
+        write_json_string(m_fields, name);
+        m_fields << ": " << value;
+    }
+
+    /**
+     * Adds a real-valued field; a value that is not finite is written as
+     * null since JSON has no representation for it.
+     *  @param  name            The name of the field.
+     *  @param  value           The value.
+     */
+    void add(const char *name, double value)
+    {
+        m_fields << ", ";
+        write_json_string(m_fields, name);
+        if (value - value == 0.) {
+            m_fields << ": " << value;
+        } else {
+            m_fields << ": null";
+        }
+    }
+
+    /**
+     * Adds a string field.
+     *  @param  name            The name of the field.
+     *  @param  value           The value.
+     */
+    void add(const char *name, const std::string& value)
+    {
+        m_fields << ", ";
+        write_json_string(m_fields, name);
+        m_fields << ": ";
+        write_json_string(m_fields, value);
+    }
+
+    void add(const char *name, const char *value)
+    {
+        add(name, std::string(value));
+    }
+
+    /**
+     * Obtains the name of the event.
+     *  @return const std::string&  The name of the event.
+     */
+    const std::string& event() const
+    {
+        return m_event;
+    }
+
+    /**
+     * Obtains the fields, each of which is preceded by a comma.
+     *  @return std::string The fields.
+     */
+    std::string fields() const
+    {
+        return m_fields.str();
+    }
+};
+
+/**
+ * A writer of training metrics in JSON lines.
+ *  A record is an object on a line, which starts with the name of the
+ *  event, the rank of the process, and the wall-clock time from the
+ *  construction of the writer, and ends with the peak RSS of the process:
+ *
+ *  {"event": "iteration", "rank": 0, "time": 1.25, ..., "peak_rss": 1048576}
+ *
+ *  Records may be written by multiple threads (e.g., the folds of a cross
+ *  validation trained concurrently).
+ */
+class metrics
+{
+protected:
+    std::ostream* m_os;
+    int m_rank;
+    double m_origin;
+    mutex m_mutex;
+
+public:
+    /**
+     * Constructs the object.
+     *  @param  os              The output stream.
+     *  @param  rank            The rank of this process.
+     */
+    metrics(std::ostream& os, int rank = 0)
+        : m_os(&os), m_rank(rank), m_origin(wall_clock())
+    {
+    }
+
+    /**
+     * Writes a record to the stream.
+     *  @param  rec             The record.
+     */
+    void write(const metrics_record& rec)
+    {
+        std::ostringstream line;
+        line << std::setprecision(10);
+        line << "{\"event\": ";
+        write_json_string(line, rec.event());
+        line << ", \"rank\": " << m_rank;
+        line << ", \"time\": " << (wall_clock() - m_origin);
+        line << rec.fields();
+        line << ", \"peak_rss\": " << peak_rss() << "}";
+
+        scoped_lock lock(m_mutex);
+        *m_os << line.str() << std::endl;
+    }
+};
+
+};
+
+#endif/*__CLASSIAS_METRICS_H__*/
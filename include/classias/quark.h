@@ -33,9 +33,12 @@
 #ifndef __CLASSIAS_QUARK_H__
 #define __CLASSIAS_QUARK_H__
 
+#include <algorithm>
 #include <stdexcept>
 #include <vector>
 
+#include "memory.h"
+
 #if defined(_MSC_VER)
 #if defined(HAVE_UNORDERED_MAP)
 #include <unordered_map>
@@ -141,12 +144,14 @@ protected:
     forward_map_type m_fwd;
     /// Inverse mapping: value -> (item0, item1).
     inverse_map_type m_inv;
+    /// The number of bytes held by the items outside the maps.
+    size_t m_item_bytes;
 
 public:
     /**
      * Constructs the object.
      */
-    quark_base()
+    quark_base() : m_item_bytes(0)
     {
     }
 
@@ -158,6 +163,7 @@ public:
     {
         m_fwd = src.m_fwd;
         m_inv = src.m_inv;
+        m_item_bytes = src.m_item_bytes;
     }
 
     /**
@@ -176,6 +182,7 @@ public:
     {
         m_fwd = src.m_fwd;
         m_inv = src.m_inv;
+        m_item_bytes = src.m_item_bytes;
         return *this;
     }
 
@@ -189,6 +196,15 @@ public:
         return m_fwd.size();
     }
 
+    /**
+     * Returns the number of bytes held by the forward and inverse maps.
+     *  @retval size_t          The number of bytes (approximate).
+     */
+    inline size_t memory_usage() const
+    {
+        return map_memory_usage(m_fwd) + classias::memory_usage(m_inv) + m_item_bytes;
+    }
+
     /**
      * Tests whether an item has an identifier assigned.
      *  @param  x               The item.
@@ -228,6 +244,7 @@ public:
             value_type v = m_inv.size();
             m_fwd.insert(typename forward_map_type::value_type(x, v));
             m_inv.push_back(x);
+            m_item_bytes += 2 * item_memory_usage(x);
             return v;
         }
     }
@@ -282,6 +299,25 @@ public:
             throw quark_error("Unknown inverse mapping");
         }
     }
+
+    /**
+     * Renumbers the unique identifiers.
+     *  This function rewrites the forward and inverse mappings so that the
+     *  item of the identifier #v obtains the identifier perm[v].
+     *  @param  perm            The new identifiers of the identifiers, which
+     *                          must be a permutation of [0, size()).
+     */
+    template <class perm_type>
+    void renumber(const perm_type& perm)
+    {
+        inverse_map_type inv(m_inv.size());
+        for (value_type v = 0;v < m_inv.size();++v) {
+            const value_type w = (value_type)perm[v];
+            m_fwd.find(m_inv[v])->second = w;
+            std::swap(inv[w], m_inv[v]);
+        }
+        m_inv.swap(inv);
+    }
 };
 
 
@@ -340,6 +376,15 @@ public:
         return m_fwd.size();
     }
 
+    /**
+     * Returns the number of bytes held by the forward and inverse maps.
+     *  @retval size_t          The number of bytes (approximate).
+     */
+    inline size_t memory_usage() const
+    {
+        return map_memory_usage(m_fwd) + classias::memory_usage(m_inv);
+    }
+
     /**
      * Tests whether a pair of items has an identifier assigned.
      *  @param  x               The item #0.
@@ -0,0 +1,658 @@
+/*
+ *		Vector kernels with run-time dispatch to SIMD instructions.
+ *
+ * Copyright (c) 2008,2009 Naoaki Okazaki
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the names of the authors nor the names of its contributors
+ *       may be used to endorse or promote products derived from this
+ *       software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* $Id$ */
+
+#ifndef __CLASSIAS_SIMD_H__
+#define __CLASSIAS_SIMD_H__
+
+#include <cmath>
+#include <cstring>
+#include <stdint.h>
+
+/*
+The kernels are compiled for AVX-512 and AVX2/FMA (SSSE3 for the integer
+decoder) with the target attribute of GCC (4.9 or later) on x86, and the best
+one supported by the CPU is chosen at run time; other compilers and CPUs use
+the scalar code.
+*/
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && \
+    (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#define CLASSIAS_SIMD_X86   1
+#include <immintrin.h>
+#endif
+
+namespace classias
+{
+
+namespace simd
+{
+
+/// The type of a function computing y += a * x.
+typedef void (*axpy_type)(int n, double a, const double *x, double *y);
+
+/**
+ * Computes y += a * x (scalar version).
+ *  @param  n           The number of elements.
+ *  @param  a           The scalar.
+ *  @param  x           The array x.
+ *  @param  y           The array y to which this function adds a * x.
+ */
+inline void axpy_scalar(int n, double a, const double *x, double *y)
+{
+    for (int i = 0;i < n;++i) {
+        y[i] += a * x[i];
+    }
+}
+
+/**
+ * The type of a function computing y += a * x for an array x of compact
+ * elements (float, int16_t, or int8_t).
+ */
+template <class code_type>
+struct compact_axpy
+{
+    typedef void (*type)(int n, double a, const code_type *x, double *y);
+};
+
+/**
+ * Computes y += a * x for an array x of compact elements (scalar version).
+ *  @param  n           The number of elements.
+ *  @param  a           The scalar.
+ *  @param  x           The array x.
+ *  @param  y           The array y to which this function adds a * x.
+ */
+template <class code_type>
+inline void axpy_scalar(int n, double a, const code_type *x, double *y)
+{
+    for (int i = 0;i < n;++i) {
+        y[i] += a * x[i];
+    }
+}
+
+/*
+The fast exponential function reduces the argument as x = k * log(2) + r with
+|r| <= log(2)/2, approximates exp(r) with the Taylor polynomial of degree 11,
+and scales the result by 2^k. The relative error is below 1e-14 for arguments
+in [-708, 709]; arguments out of the range are clamped to the range.
+*/
+const double exp_min = -708.;
+const double exp_max = 709.;
+const double log2e = 1.4426950408889634074;
+const double ln2_hi = 6.93145751953125e-1;
+const double ln2_lo = 1.42860682030941723212e-6;
+
+/// The coefficients 1/n! (n = 11, ..., 2) of the Taylor polynomial.
+const double exp_c11 = 2.5052108385441718775e-8;
+const double exp_c10 = 2.7557319223985890653e-7;
+const double exp_c9 = 2.7557319223985890653e-6;
+const double exp_c8 = 2.4801587301587301587e-5;
+const double exp_c7 = 1.9841269841269841270e-4;
+const double exp_c6 = 1.3888888888888888889e-3;
+const double exp_c5 = 8.3333333333333333333e-3;
+const double exp_c4 = 4.1666666666666666667e-2;
+const double exp_c3 = 1.6666666666666666667e-1;
+const double exp_c2 = 5.0e-1;
+
+/**
+ * Computes exp(x) with the polynomial approximation.
+ *  @param  x           The argument.
+ *  @return double      The approximation of exp(x).
+ */
+inline double exp_fast(double x)
+{
+    x = (x < exp_min ? exp_min : x);
+    x = (exp_max < x ? exp_max : x);
+    double k = std::floor(x * log2e + 0.5);
+    double r = x - k * ln2_hi - k * ln2_lo;
+    double p = exp_c11;
+    p = p * r + exp_c10;
+    p = p * r + exp_c9;
+    p = p * r + exp_c8;
+    p = p * r + exp_c7;
+    p = p * r + exp_c6;
+    p = p * r + exp_c5;
+    p = p * r + exp_c4;
+    p = p * r + exp_c3;
+    p = p * r + exp_c2;
+    p = p * r + 1.;
+    p = p * r + 1.;
+    return std::ldexp(p, (int)k);
+}
+
+/// The type of a function computing y = exp(x - shift).
+typedef double (*exp_sum_type)(int n, const double *x, double shift, double *y);
+
+/**
+ * Computes y[i] = exp(x[i] - shift) with the fast exponential function, and
+ * returns the sum of y[i] (scalar version).
+ *  @param  n           The number of elements.
+ *  @param  x           The array x.
+ *  @param  shift       The value subtracted from the elements of x.
+ *  @param  y           The array y to which this function stores.
+ *  @return double      The sum of the elements of y.
+ */
+inline double exp_sum_scalar(int n, const double *x, double shift, double *y)
+{
+    double sum = 0.;
+    for (int i = 0;i < n;++i) {
+        y[i] = exp_fast(x[i] - shift);
+        sum += y[i];
+    }
+    return sum;
+}
+
+/*
+The stream-vbyte format stores a sequence of 32-bit integers in groups of
+four: a control byte holds the byte lengths (minus one) of the four integers
+in its 2-bit fields from the lowest bits, and the integers are stored in the
+data bytes of the group in little endian without the leading zero bytes.
+The integers decoded here are the differences of increasing identifiers,
+which are summed up from an initial value.
+*/
+
+/// The type of a function decoding groups of differences in stream-vbyte.
+typedef const uint8_t *(*svb_decode_type)(
+    int groups, const uint8_t *ctrl, const uint8_t *data, int prev, int *out);
+
+/**
+ * Decodes groups of differences in the stream-vbyte format and sums them up
+ * (scalar version).
+ *  @param  groups      The number of groups (of four integers).
+ *  @param  ctrl        The control bytes of the groups.
+ *  @param  data        The data bytes of the groups.
+ *  @param  prev        The value to which the first difference is added.
+ *  @param  out         The array receiving the 4 * groups values.
+ *  @return const uint8_t*  The pointer just beyond the data bytes read.
+ */
+inline const uint8_t *svb_decode_scalar(
+    int groups, const uint8_t *ctrl, const uint8_t *data, int prev, int *out)
+{
+    for (int g = 0;g < groups;++g) {
+        const int c = ctrl[g];
+        for (int j = 0;j < 4;++j) {
+            const int len = ((c >> (2 * j)) & 3) + 1;
+            uint32_t x = 0;
+            for (int b = 0;b < len;++b) {
+                x |= (uint32_t)data[b] << (8 * b);
+            }
+            data += len;
+            prev += (int)x;
+            *out++ = prev;
+        }
+    }
+    return data;
+}
+
+/**
+ * The tables for decoding a group of stream-vbyte with a byte shuffle.
+ */
+struct svb_tables
+{
+    /// The shuffle masks gathering the integers of a group.
+    uint8_t shuffle[256][16];
+    /// The number of data bytes of a group.
+    uint8_t length[256];
+
+    svb_tables()
+    {
+        for (int c = 0;c < 256;++c) {
+            int k = 0;
+            for (int j = 0;j < 4;++j) {
+                const int len = ((c >> (2 * j)) & 3) + 1;
+                for (int b = 0;b < 4;++b) {
+                    shuffle[c][4 * j + b] = (uint8_t)(b < len ? k + b : 0x80);
+                }
+                k += len;
+            }
+            length[c] = (uint8_t)k;
+        }
+    }
+
+    static const svb_tables& get()
+    {
+        static const svb_tables tables;
+        return tables;
+    }
+};
+
+#if defined(CLASSIAS_SIMD_X86)
+
+__attribute__((target("avx2,fma")))
+inline void axpy_avx2(int n, double a, const double *x, double *y)
+{
+    int i = 0;
+    const __m256d va = _mm256_set1_pd(a);
+    for (;i + 4 <= n;i += 4) {
+        __m256d vy = _mm256_loadu_pd(y + i);
+        vy = _mm256_fmadd_pd(va, _mm256_loadu_pd(x + i), vy);
+        _mm256_storeu_pd(y + i, vy);
+    }
+    for (;i < n;++i) {
+        y[i] += a * x[i];
+    }
+}
+
+__attribute__((target("avx512f")))
+inline void axpy_avx512(int n, double a, const double *x, double *y)
+{
+    int i = 0;
+    const __m512d va = _mm512_set1_pd(a);
+    for (;i + 8 <= n;i += 8) {
+        __m512d vy = _mm512_loadu_pd(y + i);
+        vy = _mm512_fmadd_pd(va, _mm512_loadu_pd(x + i), vy);
+        _mm512_storeu_pd(y + i, vy);
+    }
+    for (;i < n;++i) {
+        y[i] += a * x[i];
+    }
+}
+
+__attribute__((target("avx2,fma")))
+inline __m256d exp_poly_avx2(__m256d r)
+{
+    __m256d p = _mm256_set1_pd(exp_c11);
+    p = _mm256_fmadd_pd(p, r, _mm256_set1_pd(exp_c10));
+    p = _mm256_fmadd_pd(p, r, _mm256_set1_pd(exp_c9));
+    p = _mm256_fmadd_pd(p, r, _mm256_set1_pd(exp_c8));
+    p = _mm256_fmadd_pd(p, r, _mm256_set1_pd(exp_c7));
+    p = _mm256_fmadd_pd(p, r, _mm256_set1_pd(exp_c6));
+    p = _mm256_fmadd_pd(p, r, _mm256_set1_pd(exp_c5));
+    p = _mm256_fmadd_pd(p, r, _mm256_set1_pd(exp_c4));
+    p = _mm256_fmadd_pd(p, r, _mm256_set1_pd(exp_c3));
+    p = _mm256_fmadd_pd(p, r, _mm256_set1_pd(exp_c2));
+    p = _mm256_fmadd_pd(p, r, _mm256_set1_pd(1.));
+    return _mm256_fmadd_pd(p, r, _mm256_set1_pd(1.));
+}
+
+__attribute__((target("avx2,fma")))
+inline double exp_sum_avx2(int n, const double *x, double shift, double *y)
+{
+    int i = 0;
+    const __m256d vshift = _mm256_set1_pd(shift);
+    const __m256d vmin = _mm256_set1_pd(exp_min);
+    const __m256d vmax = _mm256_set1_pd(exp_max);
+    __m256d vsum = _mm256_setzero_pd();
+    for (;i + 4 <= n;i += 4) {
+        __m256d v = _mm256_sub_pd(_mm256_loadu_pd(x + i), vshift);
+        v = _mm256_min_pd(_mm256_max_pd(v, vmin), vmax);
+        __m256d k = _mm256_round_pd(
+            _mm256_mul_pd(v, _mm256_set1_pd(log2e)),
+            _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+        __m256d r = _mm256_fnmadd_pd(k, _mm256_set1_pd(ln2_hi), v);
+        r = _mm256_fnmadd_pd(k, _mm256_set1_pd(ln2_lo), r);
+        __m256i e = _mm256_cvtepi32_epi64(_mm256_cvtpd_epi32(k));
+        e = _mm256_slli_epi64(_mm256_add_epi64(e, _mm256_set1_epi64x(1023)), 52);
+        __m256d vy = _mm256_mul_pd(exp_poly_avx2(r), _mm256_castsi256_pd(e));
+        _mm256_storeu_pd(y + i, vy);
+        vsum = _mm256_add_pd(vsum, vy);
+    }
+    double buffer[4];
+    _mm256_storeu_pd(buffer, vsum);
+    double sum = (buffer[0] + buffer[1]) + (buffer[2] + buffer[3]);
+    return sum + exp_sum_scalar(n - i, x + i, shift, y + i);
+}
+
+__attribute__((target("avx512f")))
+inline double exp_sum_avx512(int n, const double *x, double shift, double *y)
+{
+    int i = 0;
+    const __m512d vshift = _mm512_set1_pd(shift);
+    const __m512d vmin = _mm512_set1_pd(exp_min);
+    const __m512d vmax = _mm512_set1_pd(exp_max);
+    __m512d vsum = _mm512_setzero_pd();
+    // The unmasked forms of min, max, roundscale, and scalef pass an
+    // undefined vector as the source of the masked lanes; the masked forms
+    // with all lanes selected take an initialized one instead.
+    const __mmask8 all = 0xFF;
+    for (;i + 8 <= n;i += 8) {
+        __m512d v = _mm512_sub_pd(_mm512_loadu_pd(x + i), vshift);
+        v = _mm512_mask_max_pd(v, all, v, vmin);
+        v = _mm512_mask_min_pd(v, all, v, vmax);
+        __m512d k = _mm512_mul_pd(v, _mm512_set1_pd(log2e));
+        k = _mm512_mask_roundscale_pd(k, all, k, _MM_FROUND_TO_NEAREST_INT);
+        __m512d r = _mm512_fnmadd_pd(k, _mm512_set1_pd(ln2_hi), v);
+        r = _mm512_fnmadd_pd(k, _mm512_set1_pd(ln2_lo), r);
+        __m512d p = _mm512_set1_pd(exp_c11);
+        p = _mm512_fmadd_pd(p, r, _mm512_set1_pd(exp_c10));
+        p = _mm512_fmadd_pd(p, r, _mm512_set1_pd(exp_c9));
+        p = _mm512_fmadd_pd(p, r, _mm512_set1_pd(exp_c8));
+        p = _mm512_fmadd_pd(p, r, _mm512_set1_pd(exp_c7));
+        p = _mm512_fmadd_pd(p, r, _mm512_set1_pd(exp_c6));
+        p = _mm512_fmadd_pd(p, r, _mm512_set1_pd(exp_c5));
+        p = _mm512_fmadd_pd(p, r, _mm512_set1_pd(exp_c4));
+        p = _mm512_fmadd_pd(p, r, _mm512_set1_pd(exp_c3));
+        p = _mm512_fmadd_pd(p, r, _mm512_set1_pd(exp_c2));
+        p = _mm512_fmadd_pd(p, r, _mm512_set1_pd(1.));
+        p = _mm512_fmadd_pd(p, r, _mm512_set1_pd(1.));
+        __m512d vy = _mm512_mask_scalef_pd(p, all, p, k);
+        _mm512_storeu_pd(y + i, vy);
+        vsum = _mm512_add_pd(vsum, vy);
+    }
+    double buffer[8];
+    _mm512_storeu_pd(buffer, vsum);
+    double sum =
+        ((buffer[0] + buffer[1]) + (buffer[2] + buffer[3])) +
+        ((buffer[4] + buffer[5]) + (buffer[6] + buffer[7]));
+    return sum + exp_sum_scalar(n - i, x + i, shift, y + i);
+}
+
+/*
+The kernels for compact elements convert four (AVX2) or eight (AVX-512)
+elements to double precision at a time before the multiply-add.
+*/
+__attribute__((target("avx2,fma")))
+inline void axpy_avx2(int n, double a, const float *x, double *y)
+{
+    int i = 0;
+    const __m256d va = _mm256_set1_pd(a);
+    for (;i + 4 <= n;i += 4) {
+        __m256d vx = _mm256_cvtps_pd(_mm_loadu_ps(x + i));
+        _mm256_storeu_pd(y + i, _mm256_fmadd_pd(va, vx, _mm256_loadu_pd(y + i)));
+    }
+    axpy_scalar(n - i, a, x + i, y + i);
+}
+
+__attribute__((target("avx2,fma")))
+inline void axpy_avx2(int n, double a, const int16_t *x, double *y)
+{
+    int i = 0;
+    const __m256d va = _mm256_set1_pd(a);
+    for (;i + 4 <= n;i += 4) {
+        __m128i vc = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(x + i));
+        __m256d vx = _mm256_cvtepi32_pd(_mm_cvtepi16_epi32(vc));
+        _mm256_storeu_pd(y + i, _mm256_fmadd_pd(va, vx, _mm256_loadu_pd(y + i)));
+    }
+    axpy_scalar(n - i, a, x + i, y + i);
+}
+
+__attribute__((target("avx2,fma")))
+inline void axpy_avx2(int n, double a, const int8_t *x, double *y)
+{
+    int i = 0;
+    const __m256d va = _mm256_set1_pd(a);
+    for (;i + 4 <= n;i += 4) {
+        int32_t c;
+        std::memcpy(&c, x + i, sizeof(c));
+        __m256d vx = _mm256_cvtepi32_pd(_mm_cvtepi8_epi32(_mm_cvtsi32_si128(c)));
+        _mm256_storeu_pd(y + i, _mm256_fmadd_pd(va, vx, _mm256_loadu_pd(y + i)));
+    }
+    axpy_scalar(n - i, a, x + i, y + i);
+}
+
+__attribute__((target("avx512f")))
+inline void axpy_avx512(int n, double a, const float *x, double *y)
+{
+    int i = 0;
+    const __m512d va = _mm512_set1_pd(a);
+    // The zero-masked conversions (as in exp_sum_avx512) do not read an
+    // undefined vector for the masked lanes.
+    const __mmask8 all = 0xFF;
+    for (;i + 8 <= n;i += 8) {
+        __m512d vx = _mm512_maskz_cvtps_pd(all, _mm256_loadu_ps(x + i));
+        _mm512_storeu_pd(y + i, _mm512_fmadd_pd(va, vx, _mm512_loadu_pd(y + i)));
+    }
+    axpy_scalar(n - i, a, x + i, y + i);
+}
+
+__attribute__((target("avx512f")))
+inline void axpy_avx512(int n, double a, const int16_t *x, double *y)
+{
+    int i = 0;
+    const __m512d va = _mm512_set1_pd(a);
+    const __mmask8 all = 0xFF;
+    for (;i + 8 <= n;i += 8) {
+        __m128i vc = _mm_loadu_si128(reinterpret_cast<const __m128i*>(x + i));
+        __m512d vx = _mm512_maskz_cvtepi32_pd(all, _mm256_cvtepi16_epi32(vc));
+        _mm512_storeu_pd(y + i, _mm512_fmadd_pd(va, vx, _mm512_loadu_pd(y + i)));
+    }
+    axpy_scalar(n - i, a, x + i, y + i);
+}
+
+__attribute__((target("avx512f")))
+inline void axpy_avx512(int n, double a, const int8_t *x, double *y)
+{
+    int i = 0;
+    const __m512d va = _mm512_set1_pd(a);
+    const __mmask8 all = 0xFF;
+    for (;i + 8 <= n;i += 8) {
+        __m128i vc = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(x + i));
+        __m512d vx = _mm512_maskz_cvtepi32_pd(all, _mm256_cvtepi8_epi32(vc));
+        _mm512_storeu_pd(y + i, _mm512_fmadd_pd(va, vx, _mm512_loadu_pd(y + i)));
+    }
+    axpy_scalar(n - i, a, x + i, y + i);
+}
+
+/*
+The SSSE3 kernel gathers the four integers of a group from the 16 bytes
+following the data pointer (which must be readable) with a byte shuffle,
+and computes the prefix sums with two shifted additions.
+*/
+__attribute__((target("ssse3")))
+inline const uint8_t *svb_decode_ssse3(
+    int groups, const uint8_t *ctrl, const uint8_t *data, int prev, int *out)
+{
+    const svb_tables& tables = svb_tables::get();
+    __m128i vp = _mm_set1_epi32(prev);
+    for (int g = 0;g < groups;++g) {
+        const int c = ctrl[g];
+        __m128i vx = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+        vx = _mm_shuffle_epi8(vx,
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(tables.shuffle[c])));
+        vx = _mm_add_epi32(vx, _mm_slli_si128(vx, 4));
+        vx = _mm_add_epi32(vx, _mm_slli_si128(vx, 8));
+        vx = _mm_add_epi32(vx, vp);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out), vx);
+        vp = _mm_shuffle_epi32(vx, 0xFF);
+        data += tables.length[c];
+        out += 4;
+    }
+    return data;
+}
+
+#endif/*CLASSIAS_SIMD_X86*/
+
+/// Instruction sets.
+enum {
+    ISA_SCALAR = 0,
+    ISA_AVX2,
+    ISA_AVX512
+};
+
+/**
+ * Detects the best instruction set supported by the CPU.
+ *  @return int         One of ISA_SCALAR, ISA_AVX2, and ISA_AVX512.
+ */
+inline int detect_isa()
+{
+#if defined(CLASSIAS_SIMD_X86)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) {
+        return ISA_AVX512;
+    } else if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+        return ISA_AVX2;
+    }
+#endif/*CLASSIAS_SIMD_X86*/
+    return ISA_SCALAR;
+}
+
+/**
+ * Returns the name of the instruction set used by the kernels.
+ *  @return const char* "avx512", "avx2", or "scalar".
+ */
+inline const char *isa_name()
+{
+    switch (detect_isa()) {
+    case ISA_AVX512:    return "avx512";
+    case ISA_AVX2:      return "avx2";
+    default:            return "scalar";
+    }
+}
+
+inline axpy_type select_axpy()
+{
+#if defined(CLASSIAS_SIMD_X86)
+    switch (detect_isa()) {
+    case ISA_AVX512:    return axpy_avx512;
+    case ISA_AVX2:      return axpy_avx2;
+    }
+#endif/*CLASSIAS_SIMD_X86*/
+    return axpy_scalar;
+}
+
+/**
+ * Computes y += a * x with the best kernel for the CPU.
+ *  @param  n           The number of elements.
+ *  @param  a           The scalar.
+ *  @param  x           The array x.
+ *  @param  y           The array y to which this function adds a * x.
+ */
+inline void axpy(int n, double a, const double *x, double *y)
+{
+    static const axpy_type func = select_axpy();
+    func(n, a, x, y);
+}
+
+inline exp_sum_type select_exp_sum()
+{
+#if defined(CLASSIAS_SIMD_X86)
+    switch (detect_isa()) {
+    case ISA_AVX512:    return exp_sum_avx512;
+    case ISA_AVX2:      return exp_sum_avx2;
+    }
+#endif/*CLASSIAS_SIMD_X86*/
+    return exp_sum_scalar;
+}
+
+/**
+ * Computes y[i] = exp(x[i] - shift) with the fast exponential function, and
+ * returns the sum of y[i], using the best kernel for the CPU.
+ *  @param  n           The number of elements.
+ *  @param  x           The array x.
+ *  @param  shift       The value subtracted from the elements of x.
+ *  @param  y           The array y to which this function stores.
+ *  @return double      The sum of the elements of y.
+ */
+inline double exp_sum(int n, const double *x, double shift, double *y)
+{
+    static const exp_sum_type func = select_exp_sum();
+    return func(n, x, shift, y);
+}
+
+template <class code_type>
+inline typename compact_axpy<code_type>::type select_compact_axpy()
+{
+    typedef typename compact_axpy<code_type>::type func_type;
+#if defined(CLASSIAS_SIMD_X86)
+    switch (detect_isa()) {
+    case ISA_AVX512:    return static_cast<func_type>(axpy_avx512);
+    case ISA_AVX2:      return static_cast<func_type>(axpy_avx2);
+    }
+#endif/*CLASSIAS_SIMD_X86*/
+    return static_cast<func_type>(axpy_scalar<code_type>);
+}
+
+/**
+ * Computes y += a * x for an array x of single-precision elements with the
+ * best kernel for the CPU.
+ *  @param  n           The number of elements.
+ *  @param  a           The scalar.
+ *  @param  x           The array x.
+ *  @param  y           The array y to which this function adds a * x.
+ */
+inline void axpy(int n, double a, const float *x, double *y)
+{
+    static const compact_axpy<float>::type func = select_compact_axpy<float>();
+    func(n, a, x, y);
+}
+
+/**
+ * Computes y += a * x for an array x of 16-bit integers with the best
+ * kernel for the CPU.
+ *  @param  n           The number of elements.
+ *  @param  a           The scalar.
+ *  @param  x           The array x.
+ *  @param  y           The array y to which this function adds a * x.
+ */
+inline void axpy(int n, double a, const int16_t *x, double *y)
+{
+    static const compact_axpy<int16_t>::type func = select_compact_axpy<int16_t>();
+    func(n, a, x, y);
+}
+
+/**
+ * Computes y += a * x for an array x of 8-bit integers with the best kernel
+ * for the CPU.
+ *  @param  n           The number of elements.
+ *  @param  a           The scalar.
+ *  @param  x           The array x.
+ *  @param  y           The array y to which this function adds a * x.
+ */
+inline void axpy(int n, double a, const int8_t *x, double *y)
+{
+    static const compact_axpy<int8_t>::type func = select_compact_axpy<int8_t>();
+    func(n, a, x, y);
+}
+
+
+inline svb_decode_type select_svb_decode()
+{
+#if defined(CLASSIAS_SIMD_X86)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("ssse3")) {
+        return svb_decode_ssse3;
+    }
+#endif/*CLASSIAS_SIMD_X86*/
+    return svb_decode_scalar;
+}
+
+/**
+ * Decodes groups of differences in the stream-vbyte format and sums them up
+ * with the best kernel for the CPU.
+ *  The 16 bytes following the data bytes of each group must be readable.
+ *  @param  groups      The number of groups (of four integers).
+ *  @param  ctrl        The control bytes of the groups.
+ *  @param  data        The data bytes of the groups.
+ *  @param  prev        The value to which the first difference is added.
+ *  @param  out         The array receiving the 4 * groups values.
+ *  @return const uint8_t*  The pointer just beyond the data bytes read.
+ */
+inline const uint8_t *svb_decode(
+    int groups, const uint8_t *ctrl, const uint8_t *data, int prev, int *out)
+{
+    static const svb_decode_type func = select_svb_decode();
+    return func(groups, ctrl, data, prev, out);
+}
+
+};
+
+};
+
+#endif/*__CLASSIAS_SIMD_H__*/
@@ -0,0 +1,574 @@
+/*
+ *		Portable threading utilities for Classias.
+ *
+ * Copyright (c) 2008,2009 Naoaki Okazaki
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the names of the authors nor the names of its contributors
+ *       may be used to endorse or promote products derived from this
+ *       software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* $Id$ */
+
+#ifndef __CLASSIAS_THREAD_H__
+#define __CLASSIAS_THREAD_H__
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#if defined(_MSC_VER)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#elif defined __GNUC__
+#include <pthread.h>
+#include <errno.h>
+#include <sys/time.h>
+#endif
+
+namespace classias
+{
+
+/**
+ * Exception class for threading errors.
+ */
+class thread_error : public std::runtime_error
+{
+public:
+    /**
+     * Constructs the object.
+     *  @param  msg             The error message.
+     */
+    explicit thread_error(const std::string& msg)
+        : std::runtime_error(msg)
+    {
+    }
+};
+
+
+
+/**
+ * A non-recursive mutex.
+ */
+class mutex
+{
+protected:
+#if defined(_MSC_VER)
+    CRITICAL_SECTION m_cs;
+#elif defined __GNUC__
+    pthread_mutex_t m_mutex;
+#endif
+
+public:
+    /**
+     * Constructs the object.
+     */
+    mutex()
+    {
+#if defined(_MSC_VER)
+        InitializeCriticalSection(&m_cs);
+#elif defined __GNUC__
+        pthread_mutex_init(&m_mutex, NULL);
+#endif
+    }
+
+    /**
+     * Destructs the object.
+     */
+    virtual ~mutex()
+    {
+#if defined(_MSC_VER)
+        DeleteCriticalSection(&m_cs);
+#elif defined __GNUC__
+        pthread_mutex_destroy(&m_mutex);
+#endif
+    }
+
+    /**
+     * Acquires the lock.
+     */
+    void lock()
+    {
+#if defined(_MSC_VER)
+        EnterCriticalSection(&m_cs);
+#elif defined __GNUC__
+        pthread_mutex_lock(&m_mutex);
+#endif
+    }
+
+    /**
+     * Releases the lock.
+     */
+    void unlock()
+    {
+#if defined(_MSC_VER)
+        LeaveCriticalSection(&m_cs);
+#elif defined __GNUC__
+        pthread_mutex_unlock(&m_mutex);
+#endif
+    }
+
+private:
+    friend class condition;
+    mutex(const mutex&);
+    mutex& operator=(const mutex&);
+};
+
+
+
+/**
+ * A condition variable.
+ *  A thread waits on a condition with a mutex that it has locked; the mutex
+ *  is released while waiting and acquired again before returning.
+ */
+class condition
+{
+protected:
+#if defined(_MSC_VER)
+    CONDITION_VARIABLE m_cv;
+#elif defined __GNUC__
+    pthread_cond_t m_cond;
+#endif
+
+public:
+    /**
+     * Constructs the object.
+     */
+    condition()
+    {
+#if defined(_MSC_VER)
+        InitializeConditionVariable(&m_cv);
+#elif defined __GNUC__
+        pthread_cond_init(&m_cond, NULL);
+#endif
+    }
+
+    /**
+     * Destructs the object.
+     */
+    virtual ~condition()
+    {
+#if defined(_MSC_VER)
+#elif defined __GNUC__
+        pthread_cond_destroy(&m_cond);
+#endif
+    }
+
+    /**
+     * Waits until the condition is signaled.
+     *  @param  m               The mutex locked by the calling thread.
+     */
+    void wait(mutex& m)
+    {
+#if defined(_MSC_VER)
+        SleepConditionVariableCS(&m_cv, &m.m_cs, INFINITE);
+#elif defined __GNUC__
+        pthread_cond_wait(&m_cond, &m.m_mutex);
+#endif
+    }
+
+    /**
+     * Waits until the condition is signaled or the time passes.
+     *  @param  m               The mutex locked by the calling thread.
+     *  @param  seconds         The maximum time to wait in seconds.
+     *  @return bool            \c false if the time has passed.
+     */
+    bool wait(mutex& m, double seconds)
+    {
+#if defined(_MSC_VER)
+        return (SleepConditionVariableCS(
+            &m_cv, &m.m_cs, (DWORD)(seconds * 1000.)) != 0);
+#elif defined __GNUC__
+        struct timeval now;
+        struct timespec until;
+        gettimeofday(&now, NULL);
+        double t = now.tv_sec + now.tv_usec * 1e-6 + seconds;
+        until.tv_sec = (time_t)t;
+        until.tv_nsec = (long)((t - (double)until.tv_sec) * 1e9);
+        return (pthread_cond_timedwait(&m_cond, &m.m_mutex, &until) != ETIMEDOUT);
+#else
+        return true;
+#endif
+    }
+
+    /**
+     * Wakes up a thread waiting on the condition.
+     */
+    void signal()
+    {
+#if defined(_MSC_VER)
+        WakeConditionVariable(&m_cv);
+#elif defined __GNUC__
+        pthread_cond_signal(&m_cond);
+#endif
+    }
+
+    /**
+     * Wakes up all threads waiting on the condition.
+     */
+    void broadcast()
+    {
+#if defined(_MSC_VER)
+        WakeAllConditionVariable(&m_cv);
+#elif defined __GNUC__
+        pthread_cond_broadcast(&m_cond);
+#endif
+    }
+
+private:
+    condition(const condition&);
+    condition& operator=(const condition&);
+};
+
+
+
+/**
+ * A lock that holds a mutex during the life time of the object.
+ */
+class scoped_lock
+{
+protected:
+    mutex& m_mutex;
+
+public:
+    /**
+     * Constructs the object and acquires the lock.
+     *  @param  m               The mutex.
+     */
+    explicit scoped_lock(mutex& m) : m_mutex(m)
+    {
+        m_mutex.lock();
+    }
+
+    /**
+     * Destructs the object and releases the lock.
+     */
+    virtual ~scoped_lock()
+    {
+        m_mutex.unlock();
+    }
+
+private:
+    scoped_lock(const scoped_lock&);
+    scoped_lock& operator=(const scoped_lock&);
+};
+
+
+
+#if defined(_MSC_VER)
+template <class task_type>
+static DWORD WINAPI __run_task(LPVOID arg)
+{
+    reinterpret_cast<task_type*>(arg)->run();
+    return 0;
+}
+#elif defined __GNUC__
+template <class task_type>
+static void* __run_task(void *arg)
+{
+    reinterpret_cast<task_type*>(arg)->run();
+    return NULL;
+}
+#endif
+
+/**
+ * A thread running a task while the creator does other work.
+ *  Unlike run_tasks(), which runs a set of tasks in a parallel region, the
+ *  thread runs the member function run() of a task until the creator calls
+ *  join(). The task must outlive the thread and must not throw an exception
+ *  from run().
+ */
+class thread
+{
+protected:
+    bool m_started;
+#if defined(_MSC_VER)
+    HANDLE m_thread;
+#elif defined __GNUC__
+    pthread_t m_thread;
+#endif
+
+public:
+    /**
+     * Constructs the object.
+     */
+    thread() : m_started(false)
+    {
+    }
+
+    /**
+     * Destructs the object after waiting for the completion of the task.
+     */
+    virtual ~thread()
+    {
+        join();
+    }
+
+    /**
+     * Starts a task on the thread.
+     *  @param  task            The task.
+     */
+    template <class task_type>
+    void start(task_type& task)
+    {
+        join();
+#if defined(_MSC_VER)
+        m_thread = CreateThread(NULL, 0, __run_task<task_type>, &task, 0, NULL);
+        if (m_thread == NULL) {
+            throw thread_error("Failed to create a thread");
+        }
+#elif defined __GNUC__
+        if (pthread_create(&m_thread, NULL, __run_task<task_type>, &task) != 0) {
+            throw thread_error("Failed to create a thread");
+        }
+#else
+        task.run();
+        return;
+#endif
+        m_started = true;
+    }
+
+    /**
+     * Waits for the completion of the task.
+     */
+    void join()
+    {
+        if (m_started) {
+#if defined(_MSC_VER)
+            WaitForSingleObject(m_thread, INFINITE);
+            CloseHandle(m_thread);
+#elif defined __GNUC__
+            pthread_join(m_thread, NULL);
+#endif
+            m_started = false;
+        }
+    }
+
+private:
+    thread(const thread&);
+    thread& operator=(const thread&);
+};
+
+/**
+ * Runs tasks in parallel and waits for their completion.
+ *  This function calls the member function run() of each task on a thread
+ *  of its own; the first task is processed by the calling thread. A task
+ *  must not throw an exception from run().
+ *  @param  tasks           The vector of tasks.
+ */
+template <class task_type>
+void run_tasks(std::vector<task_type>& tasks)
+{
+    const size_t n = tasks.size();
+    if (n == 0) {
+        return;
+    } else if (n == 1) {
+        tasks[0].run();
+        return;
+    }
+
+#if defined(_MSC_VER)
+    std::vector<HANDLE> threads(n, (HANDLE)NULL);
+    for (size_t i = 1;i < n;++i) {
+        threads[i] = CreateThread(
+            NULL, 0, __run_task<task_type>, &tasks[i], 0, NULL);
+        if (threads[i] == NULL) {
+            for (size_t j = 1;j < i;++j) {
+                WaitForSingleObject(threads[j], INFINITE);
+                CloseHandle(threads[j]);
+            }
+            throw thread_error("Failed to create a thread");
+        }
+    }
+    tasks[0].run();
+    for (size_t i = 1;i < n;++i) {
+        WaitForSingleObject(threads[i], INFINITE);
+        CloseHandle(threads[i]);
+    }
+
+#elif defined __GNUC__
+    std::vector<pthread_t> threads(n);
+    for (size_t i = 1;i < n;++i) {
+        if (pthread_create(
+            &threads[i], NULL, __run_task<task_type>, &tasks[i]) != 0) {
+            for (size_t j = 1;j < i;++j) {
+                pthread_join(threads[j], NULL);
+            }
+            throw thread_error("Failed to create a thread");
+        }
+    }
+    tasks[0].run();
+    for (size_t i = 1;i < n;++i) {
+        pthread_join(threads[i], NULL);
+    }
+
+#else
+    for (size_t i = 0;i < n;++i) {
+        tasks[i].run();
+    }
+
+#endif
+}
+
+/**
+ * A group of threads running tasks in rounds.
+ *  Unlike run_tasks(), which creates and joins the threads at every call,
+ *  the group starts a thread for every task except for the first one once,
+ *  and the thread waits for the next round after running its task. Each
+ *  call of run() is a round, which calls the member function run() of each
+ *  task in parallel (the first task on the calling thread) and waits for
+ *  their completion; the caller may modify the tasks between rounds. A task
+ *  must not throw an exception from run().
+ */
+template <class task_type>
+class task_rounds
+{
+protected:
+    /// The loop of a thread, waiting for rounds and running its task.
+    struct runner
+    {
+        task_rounds* group;
+        size_t index;
+
+        void run()
+        {
+            group->serve(index);
+        }
+    };
+
+    std::vector<task_type>& m_tasks;
+    std::vector<runner> m_runners;
+    std::vector<thread*> m_threads;
+    mutex m_mutex;
+    condition m_start;
+    condition m_done;
+    int m_round;
+    size_t m_pending;
+    bool m_stop;
+
+public:
+    /**
+     * Constructs the object and starts the threads.
+     *  @param  tasks           The vector of tasks, which must outlive the
+     *                          object and must not be resized.
+     */
+    task_rounds(std::vector<task_type>& tasks)
+        : m_tasks(tasks), m_runners(tasks.size()),
+        m_round(0), m_pending(0), m_stop(false)
+    {
+#if defined(_MSC_VER) || defined(__GNUC__)
+        try {
+            for (size_t i = 1;i < tasks.size();++i) {
+                m_runners[i].group = this;
+                m_runners[i].index = i;
+                m_threads.push_back(new thread);
+                m_threads.back()->start(m_runners[i]);
+            }
+        } catch (const thread_error&) {
+            stop();
+            throw;
+        }
+#endif
+    }
+
+    /**
+     * Destructs the object after stopping the threads.
+     */
+    virtual ~task_rounds()
+    {
+        stop();
+    }
+
+    /**
+     * Runs a round of the tasks and waits for their completion.
+     */
+    void run()
+    {
+#if defined(_MSC_VER) || defined(__GNUC__)
+        {
+            scoped_lock lock(m_mutex);
+            m_pending = m_threads.size();
+            ++m_round;
+            m_start.broadcast();
+        }
+        if (!m_tasks.empty()) {
+            m_tasks[0].run();
+        }
+        scoped_lock lock(m_mutex);
+        while (0 < m_pending) {
+            m_done.wait(m_mutex);
+        }
+#else
+        for (size_t i = 0;i < m_tasks.size();++i) {
+            m_tasks[i].run();
+        }
+#endif
+    }
+
+protected:
+    void serve(size_t index)
+    {
+        int round = 0;
+        for (;;) {
+            {
+                scoped_lock lock(m_mutex);
+                while (!m_stop && m_round == round) {
+                    m_start.wait(m_mutex);
+                }
+                if (m_stop) {
+                    return;
+                }
+                round = m_round;
+            }
+            m_tasks[index].run();
+            scoped_lock lock(m_mutex);
+            if (--m_pending == 0) {
+                m_done.signal();
+            }
+        }
+    }
+
+    void stop()
+    {
+        {
+            scoped_lock lock(m_mutex);
+            m_stop = true;
+            m_start.broadcast();
+        }
+        for (size_t i = 0;i < m_threads.size();++i) {
+            m_threads[i]->join();
+            delete m_threads[i];
+        }
+        m_threads.clear();
+    }
+
+private:
+    task_rounds(const task_rounds&);
+    task_rounds& operator=(const task_rounds&);
+};
+
+};
+
+#endif/*__CLASSIAS_THREAD_H__*/
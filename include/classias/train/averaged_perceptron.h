@@ -35,7 +35,10 @@
 
 #include <iostream>
 
+#include <vector>
 #include <classias/types.h>
+#include <classias/allreduce.h>
+#include <classias/csr_data.h>
 #include <classias/parameters.h>
 
 namespace classias
@@ -89,6 +92,11 @@ protected:
     /// The update count.
     int m_c;
 
+    /// The weight vector updated by update() (m_w, or that of the master).
+    model_type* m_pw;
+    /// The increment of the update count (the number of workers).
+    int m_stride;
+
     /// Parameter interface.
     parameter_exchange m_params;
 
@@ -96,7 +104,7 @@ public:
     /**
      * Constructs the object.
      */
-    averaged_perceptron_base()
+    averaged_perceptron_base() : m_pw(&m_w), m_stride(1)
     {
         clear();
     }
@@ -172,6 +180,106 @@ public:
         m_loss = 0;
     }
 
+    /**
+     * Returns the number of instances in a minibatch.
+     *  Averaged Perceptron updates the weights for every instance.
+     *  @return int         The number of instances in a minibatch (1).
+     */
+    int batch_size() const
+    {
+        return 1;
+    }
+
+    /**
+     * Prepares this object as a worker of lock-free parallel training.
+     *
+     *  A worker applies updates directly to the weight vector of the master
+     *  without locks. It keeps its own cumulative weights and the update
+     *  count, which advances by the number of workers so that the worker
+     *  #index receives the update counts of the instances #index,
+     *  #index + num_workers, ... in the epoch.
+     *
+     *  @param  master      The master trainer holding the weight vector.
+     *  @param  index       The index of this worker.
+     *  @param  num_workers The number of workers.
+     */
+    void start_worker(this_class& master, int index, int num_workers)
+    {
+        m_pw = master.m_pw;
+        m_ws.resize(master.m_w.size());
+        for (size_t i = 0;i < m_ws.size();++i) {
+            m_ws[i] = 0.;
+        }
+        m_c = master.m_c + index;
+        m_stride = num_workers;
+        m_loss = 0;
+    }
+
+    /**
+     * Merges the states of workers at the end of an epoch.
+     *  @param  first       The iterator pointing to the first worker.
+     *  @param  last        The iterator pointing just beyond the last worker.
+     */
+    template <class iterator_type>
+    void merge_workers(iterator_type first, iterator_type last)
+    {
+        int c = m_c;
+        for (iterator_type it = first;it != last;++it) {
+            const this_class& worker = **it;
+            for (size_t i = 0;i < m_ws.size();++i) {
+                m_ws[i] += worker.m_ws[i];
+            }
+            m_loss += worker.m_loss;
+
+            // The update count next to the last update of the worker.
+            if (c < worker.m_c - worker.m_stride + 1) {
+                c = worker.m_c - worker.m_stride + 1;
+            }
+        }
+        m_c = c;
+    }
+
+    /**
+     * Sets the weights from which the training starts.
+     *  This function must be called after start(); the average of the
+     *  weights then starts from the given weights.
+     *  @param  w           The initial weights.
+     */
+    void set_weights(const model_type& w)
+    {
+        for (size_t i = 0;i < m_w.size() && i < w.size();++i) {
+            m_w[i] = w[i];
+        }
+    }
+
+    /**
+     * Mixes the weight vectors of the ranks of distributed training.
+     *  This function replaces the averaged weights of every rank with the
+     *  weighted average of them over the ranks (iterative parameter
+     *  mixing), and sums the losses of the epoch over the ranks.
+     *  @param  ar          The collective operation over the ranks.
+     *  @param  weight      The mixing weight of this rank.
+     */
+    void mix(allreduce& ar, value_type weight)
+    {
+        this->average_weights();
+
+        const size_t n = m_w.size();
+        std::vector<double> v(n + 2);
+        for (size_t i = 0;i < n;++i) {
+            v[i] = weight * m_w[i];
+        }
+        v[n] = weight;
+        v[n+1] = m_loss;
+        ar.sum(&v[0], n + 2);
+
+        for (size_t i = 0;i < n;++i) {
+            m_w[i] = v[i] / v[n];
+            m_ws[i] = m_w[i];
+        }
+        m_loss = v[n+1];
+    }
+
 public:
     /**
      * Shows the copyright information.
@@ -204,6 +312,7 @@ protected:
             m_ws[i] = 0.;
         }
         m_c = 1;
+        m_averaged = false;
     }
 
     /**
@@ -256,6 +365,30 @@ public:
         return const_cast<this_class*>(this)->model();
     }
 
+    /**
+     * Returns the memory used by the training algorithm.
+     *  @return size_t      The approximate number of bytes.
+     */
+    size_t memory_usage() const
+    {
+        return (m_w.size() + m_ws.size()) * sizeof(value_type);
+    }
+
+    /**
+     * Stores or restores the state of the training process.
+     *  @param  ar          The archive (checkpoint_writer or
+     *                      checkpoint_reader).
+     */
+    template <class archive_type>
+    void serialize(archive_type& ar)
+    {
+        ar.vector(m_w);
+        ar.vector(m_ws);
+        ar.value(m_averaged);
+        ar.value(m_loss);
+        ar.value(m_c);
+    }
+
     value_type loss() const
     {
         return m_report.loss;
@@ -299,7 +432,7 @@ public:
         // Define synonyms to avoid using "this->" for member variables.
         int& c = this->m_c;
         value_type& loss = this->m_loss;
-        model_type& w = this->m_w;
+        model_type& w = *this->m_pw;
         model_type& ws = this->m_ws;
 
         error_type cls(w);
@@ -312,7 +445,7 @@ public:
             loss += 1;
         }
 
-        ++c;
+        c += this->m_stride;
     }
 
     /**
@@ -330,6 +463,22 @@ public:
         }
     }
 
+    /**
+     * Receives a minibatch of training instances and updates feature
+     * weights for each of them.
+     *  @param  first       The iterator pointing to the first iterator of
+     *                      the instances.
+     *  @param  last        The iterator pointing just beyond the last
+     *                      iterator of the instances.
+     */
+    template <class iterator_type>
+    inline void update_batch(iterator_type first, iterator_type last)
+    {
+        for (iterator_type it = first;it != last;++it) {
+            this->update(*it);
+        }
+    }
+
 protected:
     /**
      * Adds a value to weights associated with a feature vector.
@@ -352,6 +501,47 @@ protected:
             w[it->first] += (delta * it->second);
         }
     }
+
+    /**
+     * Adds a value to weights associated with a feature vector in CSR
+     * layout, skipping the multiplication for implicit values and decoding
+     * compressed identifiers by blocks.
+     *  @param  w           The weight vector.
+     *  @param  first       The iterator pointing to the first element of
+     *                      the feature vector.
+     *  @param  last        The iterator pointing just beyond the last
+     *                      element of the feature vector.
+     *  @param  delta       The value to be added to the weights.
+     */
+    inline void update_weights(
+        model_type& w,
+        csr_element_iterator first,
+        csr_element_iterator last,
+        value_type delta
+        )
+    {
+        if (first.compressed()) {
+            int ids[csr_element_iterator::block_size];
+            while (first != last) {
+                const float* v = first.fvalue_data();
+                const int step = first.step();
+                const int n = first.decode(last, ids);
+                for (int i = 0;i < n;++i) {
+                    w[ids[i]] += (delta * v[i * step]);
+                }
+            }
+            return;
+        }
+
+        if (!first.implicit_values()) {
+            this->template update_weights<csr_element_iterator>(w, first, last, delta);
+            return;
+        }
+
+        for (const int* p = first.id_data();p != last.id_data();++p) {
+            w[*p] += delta;
+        }
+    }
 };
 
 
@@ -394,26 +584,19 @@ public:
         // Define synonyms to avoid using "this->" for member variables.
         int& c = this->m_c;
         value_type& loss = this->m_loss;
-        model_type& w = this->m_w;
+        model_type& w = *this->m_pw;
         model_type& ws = this->m_ws;
 
         error_type cls(w);
-        cls.resize(it->num_candidates(L));
-        for (int i = 0;i < it->num_candidates(L);++i) {
-            cls.inner_product(
-                i,
-                fgen,
-                it->attributes(i).begin(),
-                it->attributes(i).end(),
-                i
-                );
-        }
+        cls.inner_product_instance(fgen, *it, L);
         cls.finalize();
 
         if (cls.argmax() != it->get_label()) {
             int lr = it->get_label();
             int la = cls.argmax();
 
+            // The attributes shared by the candidates cancel out in the
+            // updates for the two candidates; they are thus left untouched.
             update_weights(
                 w,
                 lr,
@@ -450,7 +633,7 @@ public:
             loss += 1;
         }
 
-        ++c;
+        c += this->m_stride;
     }
 
     /**
@@ -468,6 +651,27 @@ public:
         }
     }
 
+    /**
+     * Receives a minibatch of training instances and updates feature
+     * weights for each of them.
+     *  @param  first       The iterator pointing to the first iterator of
+     *                      the instances.
+     *  @param  last        The iterator pointing just beyond the last
+     *                      iterator of the instances.
+     *  @param  fgen        The feature generator.
+     */
+    template <class iterator_type, class feature_generator_type>
+    inline void update_batch(
+        iterator_type first,
+        iterator_type last,
+        feature_generator_type& fgen
+        )
+    {
+        for (iterator_type it = first;it != last;++it) {
+            this->update(*it, fgen);
+        }
+    }
+
 protected:
     /**
      * Adds a value to weights associated with a feature vector.
@@ -0,0 +1,864 @@
+/*
+ *      Dual coordinate descent for L2-regularized linear classifiers.
+ *
+ * Copyright (c) 2008,2009 Naoaki Okazaki
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the names of the authors nor the names of its contributors
+ *       may be used to endorse or promote products derived from this
+ *       software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* $Id$ */
+
+#ifndef __CLASSIAS_TRAIN_DCD_H__
+#define __CLASSIAS_TRAIN_DCD_H__
+
+#include <algorithm>
+#include <cmath>
+#include <ctime>
+#include <float.h>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <classias/types.h>
+#include <classias/parameters.h>
+#include <classias/evaluation.h>
+#include <classias/metrics.h>
+#include <classias/csr_data.h>
+#include <classias/classify/linear/binary.h>
+#include <classias/train/online_scheduler.h>
+
+namespace classias
+{
+
+namespace train
+{
+
+/**
+ * The base class for dual coordinate descent.
+ *  This class implements internal variables, operations, and interface
+ *  that are common for training a binary classifier by dual coordinate
+ *  descent (Hsieh et al., ICML 2008; Yu et al., Machine Learning 2011).
+ *  The objective is the primal objective of L-BFGS with L2 regularization,
+ *      c * |w|^2 + \sum_i weight_i * loss_i(w),
+ *  which is equivalent to the objective of LIBLINEAR with the upper bound
+ *  of the dual variables, weight_i / (2c). Unlike L-BFGS, this regularizes
+ *  the bias feature as well.
+ *
+ *  @param  data_tmpl   The type of the data set for training.
+ *  @param  error_tmpl  The type of the error (loss) function.
+ *  @param  model_tmpl  The type of a weight vector for features.
+ */
+template <
+    class data_tmpl,
+    class error_tmpl,
+    class model_tmpl
+>
+class dcd_binary_base
+{
+public:
+    /// A type representing a data set for training.
+    typedef data_tmpl data_type;
+    /// The type implementing an error function.
+    typedef error_tmpl error_type;
+    /// The type implementing a model (weight vector for features).
+    typedef model_tmpl model_type;
+    /// The type representing a value.
+    typedef typename model_type::value_type value_type;
+    /// A type providing a read-only random-access iterator for instances.
+    typedef typename data_type::const_iterator const_iterator;
+
+protected:
+    /// The array of feature weights.
+    model_type m_w;
+    /// The instances for training.
+    std::vector<const_iterator> m_insts;
+    /// The squared norms of the instances (x_i \cdot x_i).
+    std::vector<value_type> m_qd;
+    /// The upper bounds of the dual variables (weight_i / (2c)).
+    std::vector<value_type> m_upper;
+    /// The order of the instances in an iteration.
+    std::vector<int> m_index;
+    /// The holdout instances.
+    std::vector<const_iterator> m_holdout_index;
+
+    /// Parameter interface.
+    parameter_exchange m_params;
+    /// The coefficient for L2 regularization.
+    value_type m_c;
+    /// The tolerance of the stopping criterion.
+    value_type m_epsilon;
+    /// The maximum number of iterations.
+    int m_max_iterations;
+    /// The sample method.
+    std::string m_sample;
+    /// The generator of random numbers for sampling instances.
+    random_generator m_random;
+
+    /// The writer of training metrics (NULL for no metrics).
+    metrics* m_metrics;
+    /// The settings of holdout evaluations.
+    holdout_options m_holdout_options;
+    /// The wall-clock time at the start of the iteration.
+    double m_clk;
+    /// The CPU time at the start of the iteration.
+    double m_cpu;
+    /// The seconds spent updating the dual variables in the iteration.
+    double m_time_update;
+    /// The seconds of the iteration excluding the holdout evaluation.
+    double m_time_iteration;
+    /// The CPU seconds of the iteration excluding the holdout evaluation.
+    double m_time_cpu;
+    /// The number of elements (attribute-value pairs) of the instances.
+    double m_num_elements;
+
+public:
+    /**
+     * Constructs the object.
+     */
+    dcd_binary_base() : m_metrics(NULL)
+    {
+        clear();
+    }
+
+    /**
+     * Destructs the object.
+     */
+    virtual ~dcd_binary_base()
+    {
+    }
+
+    /**
+     * Resets the internal states and parameters to default.
+     */
+    void clear()
+    {
+        m_w.clear();
+        m_insts.clear();
+        m_qd.clear();
+        m_upper.clear();
+        m_index.clear();
+
+        m_params.init("c", &m_c, 1.0,
+            "Coefficient for L2-regularization.");
+        m_params.init("epsilon", &m_epsilon, 0.1,
+            "The tolerance of the stopping criterion; the training stops when the maximum\n"
+            "violation of the optimality conditions of the dual variables in an iteration\n"
+            "is no greater than this value.");
+        m_params.init("max_iterations", &m_max_iterations, 1000,
+            "The maximum number of iterations (epochs).");
+        m_params.init("sample", &m_sample, "shuffle",
+            "The order of the instances in an iteration:\n"
+            "{'shuffle': a random order, 'cycle': the order in the data set}");
+    }
+
+    /**
+     * Obtains the parameter interface.
+     *  @return parameter_exchange& The parameter interface associated with
+     *                              the algorithm.
+     */
+    parameter_exchange& params()
+    {
+        return m_params;
+    }
+
+    /**
+     * Obtains the current model.
+     *  @return const model_type&   The model.
+     */
+    const model_type& model() const
+    {
+        return m_w;
+    }
+
+    /**
+     * Returns the memory used by the training algorithm.
+     *  @return size_t      The approximate number of bytes.
+     */
+    virtual size_t memory_usage() const
+    {
+        return
+            m_w.size() * sizeof(value_type) +
+            classias::memory_usage(m_insts) +
+            classias::memory_usage(m_qd) +
+            classias::memory_usage(m_upper) +
+            classias::memory_usage(m_index) +
+            classias::memory_usage(m_holdout_index);
+    }
+
+    /**
+     * Sets the writer of training metrics.
+     *  Every iteration writes a record with the wall-clock and CPU times,
+     *  the times of the phases (the updates of the dual variables and the
+     *  holdout evaluation), and the throughput of the updates in instances
+     *  and elements.
+     *  @param  m           The writer, or \c NULL for no metrics.
+     */
+    void set_metrics(metrics* m)
+    {
+        m_metrics = m;
+    }
+
+    /**
+     * Sets the settings of holdout evaluations.
+     *  The holdout instances are listed once before training (a random
+     *  subset of them with a sample size), and evaluated by multiple
+     *  threads after every interval-th iteration.
+     *  @param  ho          The settings.
+     */
+    void set_holdout_options(const holdout_options& ho)
+    {
+        m_holdout_options = ho;
+    }
+
+protected:
+    /**
+     * Prepares the instances, dual bounds, and squared norms for training.
+     *  @param  data        The data set for training.
+     *  @param  holdout     The group number for holdout evaluation.
+     */
+    void initialize(const data_type& data, int holdout)
+    {
+        if (m_c <= 0) {
+            throw invalid_parameter("The coefficient c must be positive");
+        }
+        if (m_sample != "shuffle" && m_sample != "cycle") {
+            throw invalid_parameter("Unknown sampling method for instances");
+        }
+
+        // Initialize the weight vector.
+        const size_t K = data.num_features();
+        m_w.resize(K);
+        for (size_t k = 0;k < K;++k) {
+            m_w[k] = 0;
+        }
+
+        // Draw the random numbers of a fold trained concurrently with the
+        // others from the sequence of its holdout group.
+        if (m_holdout_options.fold_random) {
+            m_random.seed((unsigned int)holdout);
+        } else {
+            m_random.share();
+        }
+
+        // Each instance appears once in the dual problem.
+        sample_instances(m_insts, data, "cycle", holdout, m_random);
+        holdout_instances(
+            m_holdout_index, data.begin(), data.end(), holdout,
+            m_holdout_options.sample);
+        const int M = (int)m_insts.size();
+        m_qd.resize(M);
+        m_upper.resize(M);
+        m_index.resize(M);
+        m_num_elements = 0.;
+        for (int i = 0;i < M;++i) {
+            const_iterator it = m_insts[i];
+            m_num_elements += (double)num_elements(*it);
+            m_qd[i] = this->norm2(it->begin(), it->end());
+            m_upper[i] = it->get_weight() / (2. * m_c);
+            m_index[i] = i;
+        }
+    }
+
+    /**
+     * Computes the signed score y_i * (w \cdot x_i) of an instance.
+     *  @param  i           The index of the instance.
+     *  @return value_type  The signed score.
+     */
+    inline value_type signed_score(int i)
+    {
+        const_iterator it = m_insts[i];
+        value_type s = this->inner_product(it->begin(), it->end());
+        return it->get_label() ? s : -s;
+    }
+
+    /**
+     * Adds y_i * delta * x_i to the weight vector.
+     *  @param  i           The index of the instance.
+     *  @param  delta       The change of the dual variable.
+     */
+    inline void add_instance(int i, value_type delta)
+    {
+        const_iterator it = m_insts[i];
+        this->add(it->begin(), it->end(), it->get_label() ? delta : -delta);
+    }
+
+    /**
+     * Computes the squared norm of a feature vector.
+     *  @param  first       The iterator for the first element of features.
+     *  @param  last        The iterator for the element just beyond the
+     *                      last element of features.
+     *  @return value_type  The squared norm.
+     */
+    template <class iterator_type>
+    static inline value_type norm2(iterator_type first, iterator_type last)
+    {
+        value_type s = 0.;
+        for (iterator_type it = first;it != last;++it) {
+            s += it->second * it->second;
+        }
+        return s;
+    }
+
+    /**
+     * Computes the inner product of a feature vector and the weights.
+     *  @param  first       The iterator for the first element of features.
+     *  @param  last        The iterator for the element just beyond the
+     *                      last element of features.
+     *  @return value_type  The inner product.
+     */
+    template <class iterator_type>
+    inline value_type inner_product(iterator_type first, iterator_type last)
+    {
+        value_type s = 0.;
+        for (iterator_type it = first;it != last;++it) {
+            s += m_w[it->first] * it->second;
+        }
+        return s;
+    }
+
+    /**
+     * Computes the inner product of a feature vector in CSR layout and the
+     * weights, skipping the multiplication for implicit values and decoding
+     * compressed identifiers by blocks.
+     *  @param  first       The iterator for the first element of features.
+     *  @param  last        The iterator for the element just beyond the
+     *                      last element of features.
+     *  @return value_type  The inner product.
+     */
+    inline value_type inner_product(
+        csr_element_iterator first,
+        csr_element_iterator last
+        )
+    {
+        if (first.compressed()) {
+            int ids[csr_element_iterator::block_size];
+            value_type s = 0.;
+            while (first != last) {
+                const float* v = first.fvalue_data();
+                const int step = first.step();
+                const int n = first.decode(last, ids);
+                for (int i = 0;i < n;++i) {
+                    s += m_w[ids[i]] * v[i * step];
+                }
+            }
+            return s;
+        }
+
+        if (!first.implicit_values()) {
+            return this->template inner_product<csr_element_iterator>(first, last);
+        }
+
+        value_type s = 0.;
+        for (const int* p = first.id_data();p != last.id_data();++p) {
+            s += m_w[*p];
+        }
+        return s;
+    }
+
+    /**
+     * Adds a multiple of a feature vector to the weights.
+     *  @param  first       The iterator for the first element of features.
+     *  @param  last        The iterator for the element just beyond the
+     *                      last element of features.
+     *  @param  delta       The multiplier.
+     */
+    template <class iterator_type>
+    inline void add(iterator_type first, iterator_type last, value_type delta)
+    {
+        for (iterator_type it = first;it != last;++it) {
+            m_w[it->first] += delta * it->second;
+        }
+    }
+
+    /**
+     * Adds a multiple of a feature vector in CSR layout to the weights,
+     * skipping the multiplication for implicit values and decoding
+     * compressed identifiers by blocks.
+     *  @param  first       The iterator for the first element of features.
+     *  @param  last        The iterator for the element just beyond the
+     *                      last element of features.
+     *  @param  delta       The multiplier.
+     */
+    inline void add(
+        csr_element_iterator first,
+        csr_element_iterator last,
+        value_type delta
+        )
+    {
+        if (first.compressed()) {
+            int ids[csr_element_iterator::block_size];
+            while (first != last) {
+                const float* v = first.fvalue_data();
+                const int step = first.step();
+                const int n = first.decode(last, ids);
+                for (int i = 0;i < n;++i) {
+                    m_w[ids[i]] += delta * v[i * step];
+                }
+            }
+            return;
+        }
+
+        if (!first.implicit_values()) {
+            this->template add<csr_element_iterator>(first, last, delta);
+            return;
+        }
+
+        for (const int* p = first.id_data();p != last.id_data();++p) {
+            m_w[*p] += delta;
+        }
+    }
+
+    /**
+     * Starts the clocks of an iteration.
+     */
+    void start_iteration()
+    {
+        m_clk = wall_clock();
+        m_cpu = cpu_clock();
+    }
+
+    /**
+     * Reports the progress of an iteration.
+     *  @param  os          The output stream.
+     *  @param  k           The iteration number.
+     *  @param  violation   The maximum violation in the iteration.
+     */
+    void report_iteration(std::ostream& os, int k, value_type violation)
+    {
+        m_time_update = wall_clock() - m_clk;
+
+        int num_actives = 0;
+        value_type norm2 = 0.;
+        for (size_t j = 0;j < m_w.size();++j) {
+            if (m_w[j] != 0.) {
+                ++num_actives;
+            }
+            norm2 += m_w[j] * m_w[j];
+        }
+
+        os << "***** Iteration #" << k << " *****" << std::endl;
+        os << "Maximum violation: " << violation << std::endl;
+        os << "Feature L2-norm: " << std::sqrt(norm2) << std::endl;
+        os << "Active features: " << num_actives << " / " << m_w.size() << std::endl;
+        this->report_dual(os);
+        m_time_iteration = wall_clock() - m_clk;
+        m_time_cpu = cpu_clock() - m_cpu;
+        os << "Seconds required for this iteration: " << m_time_iteration << std::endl;
+    }
+
+    /**
+     * Reports the algorithm-specific state of the dual variables.
+     *  @param  os          The output stream.
+     */
+    virtual void report_dual(std::ostream& os)
+    {
+    }
+
+    /**
+     * Finishes an iteration: runs a holdout evaluation if necessary, and
+     * writes the metrics of the iteration.
+     *  @param  os          The output stream.
+     *  @param  data        The data set for training (and holdout evaluation).
+     *  @param  holdout     The group number for holdout evaluation.
+     *  @param  k           The iteration number.
+     *  @param  violation   The maximum violation in the iteration.
+     */
+    void finish_iteration(
+        std::ostream& os, const data_type& data, int holdout,
+        int k, value_type violation)
+    {
+        const double clk = wall_clock();
+        if (0 <= holdout && m_holdout_options.scheduled(k, k == m_max_iterations)) {
+            error_type cla(m_w);
+            holdout_evaluation_binary(
+                os,
+                m_holdout_index,
+                cla,
+                m_holdout_options.num_threads
+                );
+        }
+        os << std::endl;
+        os.flush();
+
+        if (m_metrics != NULL) {
+            const double t = m_time_update;
+            metrics_record rec("iteration");
+            rec.add("solver", "dcd");
+            rec.add("holdout", holdout);
+            rec.add("iteration", k);
+            rec.add("violation", (double)violation);
+            rec.add("seconds", m_time_iteration);
+            rec.add("cpu_seconds", m_time_cpu);
+            rec.add("update_seconds", m_time_update);
+            rec.add("holdout_seconds", wall_clock() - clk);
+            rec.add("instances_per_second", 0. < t ? m_insts.size() / t : 0.);
+            rec.add("nnz_per_second", 0. < t ? m_num_elements / t : 0.);
+            m_metrics->write(rec);
+        }
+    }
+
+    /**
+     * Reports the primal objective at the end of the training.
+     *  @param  os          The output stream.
+     */
+    void report_loss(std::ostream& os)
+    {
+        value_type loss = 0., norm2 = 0.;
+        error_type cls(m_w);
+        for (size_t i = 0;i < m_insts.size();++i) {
+            const_iterator it = m_insts[i];
+            value_type nlogp = 0.;
+            cls.inner_product(it->begin(), it->end());
+            cls.error(it->get_label(), nlogp);
+            loss += it->get_weight() * nlogp;
+        }
+        for (size_t k = 0;k < m_w.size();++k) {
+            norm2 += m_w[k] * m_w[k];
+        }
+        os << "Loss: " << loss + m_c * norm2 << std::endl;
+    }
+};
+
+
+
+/**
+ * Dual coordinate descent for L2-regularized L1-loss SVM.
+ *  This implements the dual coordinate descent with shrinking: an instance
+ *  whose dual variable stays at a bound is removed from the iterations
+ *  until the maximum violation of the remaining instances gets small.
+ *
+ *  @param  data_tmpl       The type of the data set for training.
+ *  @param  model_tmpl      The type of the feature weights.
+ */
+template <
+    class data_tmpl,
+    class model_tmpl = weight_vector
+>
+class dcd_hinge_binary :
+    public dcd_binary_base<
+        data_tmpl,
+        classify::linear_binary_hinge<model_tmpl>,
+        model_tmpl
+        >
+{
+public:
+    /// A type representing a data set for training.
+    typedef data_tmpl data_type;
+    /// The type implementing a model (weight vector for features).
+    typedef model_tmpl model_type;
+    /// The type implementing an error function.
+    typedef classify::linear_binary_hinge<model_type> error_type;
+    /// A synonym of the base class.
+    typedef dcd_binary_base<data_tmpl, error_type, model_tmpl> base_class;
+    /// The type representing a value.
+    typedef typename model_type::value_type value_type;
+
+protected:
+    /// The dual variables.
+    std::vector<value_type> m_alpha;
+    /// The number of instances that are not shrunk.
+    int m_active_size;
+
+public:
+    /**
+     * Trains a model on a data set.
+     *  @param  data        The data set for training (and holdout evaluation).
+     *  @param  os          The output stream for progress reports.
+     *  @param  holdout     The group number for holdout evaluation. Specify
+     *                      a negative value if a holdout evaluation is
+     *                      unnecessary.
+     *  @param  acconly     Unused (reserved only for the compatibility with
+     *                      multi-class classification).
+     */
+    void train(
+        const data_type& data,
+        std::ostream& os,
+        int holdout = -1,
+        bool acconly = true
+        )
+    {
+        std::vector<int>& index = this->m_index;
+
+        // Show the information for training.
+        os << "L2-regularized L1-loss SVM using dual coordinate descent" << std::endl;
+        this->m_params.show(os);
+        os << std::endl;
+
+        this->initialize(data, holdout);
+        const int M = (int)index.size();
+        m_alpha.assign(M, 0.);
+        m_active_size = M;
+
+        // The bounds of the projected gradients for shrinking.
+        value_type pgmax_old = DBL_MAX;
+        value_type pgmin_old = -DBL_MAX;
+
+        for (int k = 1;k <= this->m_max_iterations;++k) {
+            this->start_iteration();
+            value_type pgmax_new = -DBL_MAX;
+            value_type pgmin_new = DBL_MAX;
+
+            if (this->m_sample == "shuffle") {
+                this->m_random.shuffle(
+                    index.begin(), index.begin() + m_active_size);
+            }
+
+            for (int s = 0;s < m_active_size;++s) {
+                const int i = index[s];
+                const value_type U = this->m_upper[i];
+                const value_type G = this->signed_score(i) - 1.;
+
+                // Compute the projected gradient, or shrink the variable.
+                value_type PG = 0.;
+                if (m_alpha[i] == 0.) {
+                    if (pgmax_old < G) {
+                        std::swap(index[s--], index[--m_active_size]);
+                        continue;
+                    } else if (G < 0.) {
+                        PG = G;
+                    }
+                } else if (m_alpha[i] == U) {
+                    if (G < pgmin_old) {
+                        std::swap(index[s--], index[--m_active_size]);
+                        continue;
+                    } else if (0. < G) {
+                        PG = G;
+                    }
+                } else {
+                    PG = G;
+                }
+
+                pgmax_new = std::max(pgmax_new, PG);
+                pgmin_new = std::min(pgmin_new, PG);
+
+                // Minimize the dual objective along the variable.
+                if (1e-12 < std::fabs(PG) && 0. < this->m_qd[i]) {
+                    const value_type a = m_alpha[i];
+                    m_alpha[i] = std::min(std::max(a - G / this->m_qd[i], 0.), U);
+                    this->add_instance(i, m_alpha[i] - a);
+                }
+            }
+
+            const value_type violation = pgmax_new - pgmin_new;
+            this->report_iteration(os, k, violation);
+            this->finish_iteration(os, data, holdout, k, violation);
+
+            if (violation <= this->m_epsilon) {
+                if (m_active_size == M) {
+                    os << "Terminated with the stopping criterion" << std::endl;
+                    os << std::endl;
+                    break;
+                }
+                // Check the convergence on all instances.
+                m_active_size = M;
+                pgmax_old = DBL_MAX;
+                pgmin_old = -DBL_MAX;
+                continue;
+            }
+
+            pgmax_old = (pgmax_new <= 0.) ? DBL_MAX : pgmax_new;
+            pgmin_old = (0. <= pgmin_new) ? -DBL_MAX : pgmin_new;
+        }
+
+        this->report_loss(os);
+    }
+
+protected:
+    /**
+     * Reports the number of instances that are not shrunk.
+     *  @param  os          The output stream.
+     */
+    virtual void report_dual(std::ostream& os)
+    {
+        os << "Active instances: " << m_active_size << " / " << m_alpha.size() << std::endl;
+    }
+};
+
+
+
+/**
+ * Dual coordinate descent for L2-regularized logistic regression.
+ *  Each dual variable (and its complement upper - alpha) is updated by a
+ *  few Newton steps of the one-variable sub-problem; the tolerance of the
+ *  Newton steps is tightened as the iterations proceed.
+ *
+ *  @param  data_tmpl       The type of the data set for training.
+ *  @param  model_tmpl      The type of the feature weights.
+ */
+template <
+    class data_tmpl,
+    class model_tmpl = weight_vector
+>
+class dcd_logistic_binary :
+    public dcd_binary_base<
+        data_tmpl,
+        classify::linear_binary_logistic<model_tmpl>,
+        model_tmpl
+        >
+{
+public:
+    /// A type representing a data set for training.
+    typedef data_tmpl data_type;
+    /// The type implementing a model (weight vector for features).
+    typedef model_tmpl model_type;
+    /// The type implementing an error function.
+    typedef classify::linear_binary_logistic<model_type> error_type;
+    /// A synonym of the base class.
+    typedef dcd_binary_base<data_tmpl, error_type, model_tmpl> base_class;
+    /// The type representing a value.
+    typedef typename model_type::value_type value_type;
+
+protected:
+    /// The dual variables; [2i] for alpha_i and [2i+1] for upper - alpha_i.
+    std::vector<value_type> m_alpha;
+    /// The number of Newton steps in the last iteration.
+    int m_newton_steps;
+
+public:
+    /**
+     * Trains a model on a data set.
+     *  @param  data        The data set for training (and holdout evaluation).
+     *  @param  os          The output stream for progress reports.
+     *  @param  holdout     The group number for holdout evaluation. Specify
+     *                      a negative value if a holdout evaluation is
+     *                      unnecessary.
+     *  @param  acconly     Unused (reserved only for the compatibility with
+     *                      multi-class classification).
+     */
+    void train(
+        const data_type& data,
+        std::ostream& os,
+        int holdout = -1,
+        bool acconly = true
+        )
+    {
+        static const int max_inner_iterations = 100;
+        static const value_type newton_shrink = 0.1;
+        std::vector<int>& index = this->m_index;
+
+        // Show the information for training.
+        os << "L2-regularized logistic regression using dual coordinate descent" << std::endl;
+        this->m_params.show(os);
+        os << std::endl;
+
+        this->initialize(data, holdout);
+        const int M = (int)index.size();
+
+        // Start from small dual variables in (0, upper).
+        m_alpha.resize(2 * M);
+        for (int i = 0;i < M;++i) {
+            const value_type U = this->m_upper[i];
+            m_alpha[2*i] = std::min(0.001 * U, 1e-8);
+            m_alpha[2*i+1] = U - m_alpha[2*i];
+            this->add_instance(i, m_alpha[2*i]);
+        }
+
+        value_type inner_eps = 1e-2;
+        const value_type inner_eps_min = std::min(1e-8, (double)this->m_epsilon);
+
+        for (int k = 1;k <= this->m_max_iterations;++k) {
+            this->start_iteration();
+            value_type gmax = 0.;
+            m_newton_steps = 0;
+
+            if (this->m_sample == "shuffle") {
+                this->m_random.shuffle(index.begin(), index.end());
+            }
+
+            for (int s = 0;s < M;++s) {
+                const int i = index[s];
+                const value_type U = this->m_upper[i];
+                const value_type a = this->m_qd[i];
+                const value_type b = this->signed_score(i);
+
+                // Minimize either the variable or its complement, whichever
+                // is farther from the bound.
+                int ind1 = 2*i, ind2 = 2*i+1;
+                value_type sign = 1.;
+                if (0.5 * a * (m_alpha[ind2] - m_alpha[ind1]) + b < 0.) {
+                    std::swap(ind1, ind2);
+                    sign = -1.;
+                }
+
+                const value_type z_old = m_alpha[ind1];
+                value_type z = z_old;
+                if (U - z < 0.5 * U) {
+                    z *= 0.1;
+                }
+                value_type gp = a * (z - z_old) + sign * b + std::log(z / (U - z));
+                gmax = std::max(gmax, std::fabs(gp));
+
+                // Newton steps for the one-variable sub-problem.
+                int t = 0;
+                for (;t <= max_inner_iterations;++t) {
+                    if (std::fabs(gp) < inner_eps) {
+                        break;
+                    }
+                    const value_type gpp = a + U / (U - z) / z;
+                    const value_type z_new = z - gp / gpp;
+                    z = (z_new <= 0.) ? z * newton_shrink : z_new;
+                    gp = a * (z - z_old) + sign * b + std::log(z / (U - z));
+                }
+                m_newton_steps += t;
+
+                if (0 < t) {
+                    m_alpha[ind1] = z;
+                    m_alpha[ind2] = U - z;
+                    this->add_instance(i, sign * (z - z_old));
+                }
+            }
+
+            this->report_iteration(os, k, gmax);
+            this->finish_iteration(os, data, holdout, k, gmax);
+
+            if (gmax < this->m_epsilon) {
+                os << "Terminated with the stopping criterion" << std::endl;
+                os << std::endl;
+                break;
+            }
+            if (m_newton_steps <= M / 10) {
+                inner_eps = std::max(inner_eps_min, 0.1 * inner_eps);
+            }
+        }
+
+        this->report_loss(os);
+    }
+
+protected:
+    /**
+     * Reports the number of Newton steps in the iteration.
+     *  @param  os          The output stream.
+     */
+    virtual void report_dual(std::ostream& os)
+    {
+        os << "Newton steps: " << m_newton_steps << std::endl;
+    }
+};
+
+};
+
+};
+
+#endif/*__CLASSIAS_TRAIN_DCD_H__*/
@@ -33,6 +33,7 @@
 #ifndef __CLASSIAS_TRAIN_LBFGS_H__
 #define __CLASSIAS_TRAIN_LBFGS_H__
 
+#include <algorithm>
 #include <cmath>
 #include <ctime>
 #include <float.h>
@@ -45,8 +46,14 @@
 #include <lbfgs.h>
 
 #include <classias/types.h>
+#include <classias/allreduce.h>
+#include <classias/checkpoint.h>
 #include <classias/parameters.h>
 #include <classias/evaluation.h>
+#include <classias/memory.h>
+#include <classias/metrics.h>
+#include <classias/simd.h>
+#include <classias/thread.h>
 #include <classias/classify/linear/binary.h>
 #include <classias/classify/linear/multi.h>
 
@@ -101,17 +108,50 @@ protected:
     std::string m_lbfgs_linesearch;
     /// The maximum number of trials for the line search algorithm.
     int m_lbfgs_max_linesearch;
+    /// The number of threads for computing the loss and gradients.
+    int m_num_threads;
 
     /// A group number for holdout evaluation.
     int m_holdout;
     /// An output stream to which this object outputs log messages.
     std::ostream* m_os;
 
-    /// An internal variable (previous timestamp).
-    clock_t m_clk_prev;
+    /// An internal variable (wall-clock time at the end of the previous
+    /// iteration).
+    double m_wall_prev;
+    /// An internal variable (CPU time at the end of the previous iteration).
+    double m_cpu_prev;
+    /// The seconds spent computing the loss and gradients in the iteration.
+    double m_time_gradient;
+    /// The seconds spent summing the loss and gradients over the ranks.
+    double m_time_allreduce;
+    /// The seconds spent computing the L2 regularization term.
+    double m_time_regularization;
+    /// The number of evaluations of the loss and gradients in the iteration.
+    int m_num_evaluations;
+    /// The number of instances used for training.
+    double m_num_instances;
+    /// The number of elements (attribute-value pairs) of the instances.
+    double m_num_elements;
+    /// The writer of training metrics (NULL for no metrics).
+    metrics* m_metrics;
+    /// The settings of holdout evaluations.
+    holdout_options m_holdout_options;
     /// The start index for regularization.
     int m_regularization_start;
 
+    /// The collective operation summing the loss and gradients over the
+    /// ranks of distributed training (NULL for training on one process).
+    allreduce* m_allreduce;
+    /// The buffer of the loss and gradients sent to the collective operation.
+    std::vector<value_type> m_reduced;
+    /// The flag to start training from the weights of the previous training.
+    bool m_warm_start;
+    /// The checkpoint of the training process (NULL for no checkpoint).
+    checkpoint* m_checkpoint;
+    /// The number of the iterations completed before resuming the training.
+    int m_iteration_offset;
+
 public:
     /**
      * Constructs the object.
@@ -138,6 +178,14 @@ public:
         // Initialize the members.
         m_holdout = -1;
         m_os = NULL;
+        m_allreduce = NULL;
+        m_warm_start = false;
+        m_checkpoint = NULL;
+        m_iteration_offset = 0;
+        m_metrics = NULL;
+        m_holdout_options = holdout_options();
+        m_num_instances = 0.;
+        m_num_elements = 0.;
 
         // Initialize the parameters.
         m_params.init("c1", &m_c1, 0.0,
@@ -161,16 +209,24 @@ public:
             "{'MoreThuente': More and Thuente's method, 'Backtracking': backtracking}");
         m_params.init("max_linesearch", &m_lbfgs_max_linesearch, 20,
             "The maximum number of trials for the line search algorithm.");
+        m_params.init("num_threads", &m_num_threads, 1,
+            "The number of threads for computing the loss and gradients. Instances are\n"
+            "split into contiguous shards, and the partial gradients of the shards are\n"
+            "summed in a fixed order so that the result does not depend on scheduling.");
     }
 
 protected:
     /**
      * Initializes the weight vector of the size K.
-     *  This function prepares a vector of the size K, and sets W = 0.
+     *  This function prepares a vector of the size K, and sets W = 0. With
+     *  a warm start, the weights of the previous training are kept.
      *  @param  K           The size of the weight vector.
      */
     void initialize_weights(const size_t K)
     {
+        if (m_warm_start && m_w.size() == K) {
+            return;
+        }
         m_w.resize(K);
         for (size_t k = 0;k < K;++k) {
             m_w[k] = 0;
@@ -193,9 +249,25 @@ protected:
         )
     {
         // Compute the loss and gradients.
+        double clk = wall_clock();
         value_type loss = loss_and_gradient(x, g, n);
+        m_time_gradient += wall_clock() - clk;
+        ++m_num_evaluations;
+
+        // Sum the loss and gradients of the data shards of all ranks.
+        if (m_allreduce != NULL) {
+            clk = wall_clock();
+            m_reduced.resize(n + 1);
+            std::copy(g, g + n, m_reduced.begin());
+            m_reduced[n] = loss;
+            m_allreduce->sum(&m_reduced[0], n + 1);
+            std::copy(m_reduced.begin(), m_reduced.begin() + n, g);
+            loss = m_reduced[n];
+            m_time_allreduce += wall_clock() - clk;
+        }
 
 	    // L2 regularization.
+        clk = wall_clock();
 	    if (m_c2 != 0.) {
             value_type norm = 0.;
             const value_type lambda = 2 * m_c2;
@@ -205,6 +277,7 @@ protected:
             }
             loss += (m_c2 * norm);
 	    }
+        m_time_regularization += wall_clock() - clk;
 
         return loss;
     }
@@ -237,11 +310,13 @@ protected:
         int k,
         int ls)
     {
+        // Count the iterations completed before resuming the training.
+        k += m_iteration_offset;
+
         // Compute the duration required for this iteration.
         std::ostream& os = *m_os;
-        clock_t duration, clk = std::clock();
-        duration = clk - m_clk_prev;
-        m_clk_prev = clk;
+        const double duration = wall_clock() - m_wall_prev;
+        const double cpu = cpu_clock() - m_cpu_prev;
 
         // Count the number of active features.
         int num_active = 0;
@@ -259,22 +334,71 @@ protected:
         os << "Active features: " << num_active << " / " << n << std::endl;
         os << "Line search trials: " << ls << std::endl;
         os << "Line search step: " << step << std::endl;
-        os << "Seconds required for this iteration: " <<
-            duration / (double)CLOCKS_PER_SEC << std::endl;
+        os << "Seconds required for this iteration: " << duration << std::endl;
         os.flush();
 
         // Holdout evaluation if necessary.
-        if (0 <= m_holdout) {
+        double holdout = wall_clock();
+        if (0 <= m_holdout && m_holdout_options.scheduled(k, k == m_lbfgs_maxiter)) {
             holdout_evaluation();
         }
+        holdout = wall_clock() - holdout;
 
         // Output an empty line.
         os << std::endl;
         os.flush();
 
+        // Write the metrics of this iteration.
+        if (m_metrics != NULL) {
+            const double processed = m_num_evaluations * m_num_instances;
+            metrics_record rec("iteration");
+            rec.add("solver", "lbfgs");
+            rec.add("holdout", m_holdout);
+            rec.add("iteration", k);
+            rec.add("loss", (double)fx);
+            rec.add("active_features", num_active);
+            rec.add("evaluations", m_num_evaluations);
+            rec.add("seconds", duration);
+            rec.add("cpu_seconds", cpu);
+            rec.add("gradient_seconds", m_time_gradient);
+            rec.add("allreduce_seconds", m_time_allreduce);
+            rec.add("regularization_seconds", m_time_regularization);
+            rec.add("linesearch_seconds",
+                duration - m_time_gradient - m_time_allreduce - m_time_regularization);
+            rec.add("holdout_seconds", holdout);
+            rec.add("instances_per_second", 0. < duration ? processed / duration : 0.);
+            rec.add("nnz_per_second", 0. < duration ?
+                m_num_evaluations * m_num_elements / duration : 0.);
+            m_metrics->write(rec);
+        }
+
+        // Store the weights to the checkpoint if scheduled.
+        if (m_checkpoint != NULL && m_checkpoint->scheduled(k)) {
+            checkpoint_writer ar;
+            model_type w(x, x + n);
+            ar.value(k);
+            ar.vector(w);
+            m_checkpoint->save("lbfgs", ar);
+        }
+
+        // The holdout evaluation is not a part of the next iteration.
+        this->start_iteration();
         return 0;
     }
 
+    /**
+     * Resets the clocks and the times of the phases for an iteration.
+     */
+    void start_iteration()
+    {
+        m_wall_prev = wall_clock();
+        m_cpu_prev = cpu_clock();
+        m_time_gradient = 0.;
+        m_time_allreduce = 0.;
+        m_time_regularization = 0.;
+        m_num_evaluations = 0;
+    }
+
     int lbfgs_solve(
         const int K,
         std::ostream& os,
@@ -300,12 +424,31 @@ protected:
 
         // Store the start clock.
         m_os = &os;
-        m_clk_prev = clock();
+        this->start_iteration();
         m_holdout = holdout;
         m_regularization_start = regularization_start;
 
+        // Resume from the weights stored last by the checkpoint.
+        m_iteration_offset = 0;
+        std::string state;
+        if (m_checkpoint != NULL && m_checkpoint->load("lbfgs", state)) {
+            checkpoint_reader ar(state);
+            ar.value(m_iteration_offset);
+            ar.vector(this->m_w);
+            if (!ar.eof() || (int)this->m_w.size() != K) {
+                throw checkpoint_error("A checkpoint has an inconsistent state");
+            }
+            os << "Resumed from the checkpoint of iteration #" << m_iteration_offset << std::endl;
+            os << std::endl;
+            if (m_lbfgs_maxiter <= m_iteration_offset) {
+                return LBFGSERR_MAXIMUMITERATION;
+            }
+            param.max_iterations = m_lbfgs_maxiter - m_iteration_offset;
+            this->start_iteration();
+        }
+
         // Call L-BFGS routine.
-        return lbfgs(
+        int ret = lbfgs(
             K,
             &this->m_w[0],
             NULL,
@@ -314,6 +457,10 @@ protected:
             this,
             &param
             );
+        if (m_checkpoint != NULL) {
+            m_checkpoint->wait();
+        }
+        return ret;
     }
 
     void lbfgs_output_status(std::ostream& os, int status)
@@ -327,12 +474,146 @@ protected:
         }
     }
 
+    /**
+     * A task computing the loss and gradients of a shard of instances.
+     */
+    struct gradient_task
+    {
+        this_class* owner;
+        size_t first;
+        size_t last;
+        int n;
+        std::vector<value_type, placed_allocator<value_type> > g;
+        value_type loss;
+
+        void run()
+        {
+            // The thread touches its buffer first, so that the pages are
+            // placed on its NUMA node under the default policy.
+            g.assign((size_t)n, 0.);
+            loss = owner->partial_loss_and_gradient(first, last, &g[0]);
+        }
+    };
+
+    /**
+     * A task summing the partial gradients within a range of features.
+     */
+    struct reduction_task
+    {
+        std::vector<value_type*>* buffers;
+        value_type* g;
+        int first;
+        int last;
+
+        void run()
+        {
+            std::vector<value_type*>& b = *buffers;
+            const size_t N = b.size();
+
+            // Pairwise (tree) summation in a fixed order.
+            for (size_t stride = 1;stride < N;stride *= 2) {
+                for (size_t t = 0;t + stride < N;t += 2 * stride) {
+                    value_type* dst = b[t];
+                    const value_type* src = b[t + stride];
+                    for (int i = first;i < last;++i) {
+                        dst[i] += src[i];
+                    }
+                }
+            }
+
+            const value_type* src = b[0];
+            for (int i = first;i < last;++i) {
+                g[i] += src[i];
+            }
+        }
+    };
+
+    /**
+     * Accumulates the loss and gradients of the data set.
+     *  This function adds the gradients of the instances [0, M) to the
+     *  vector g, which must be initialized by the caller. If the parameter
+     *  num_threads is greater than one, the instances are split into
+     *  contiguous shards each of which is processed by a thread with its
+     *  own gradient buffer; the buffers are then summed into g by a tree
+     *  reduction in a fixed order.
+     *  @param  g           The gradient vector to which this function adds.
+     *  @param  n           The number of features.
+     *  @param  M           The number of instances.
+     *  @return value_type  The loss of the instances.
+     */
+    value_type accumulate_loss_and_gradient(
+        value_type *g,
+        const int n,
+        const size_t M
+        )
+    {
+        size_t N = (0 < m_num_threads) ? (size_t)m_num_threads : 1;
+        if (M < N) {
+            N = (0 < M) ? M : 1;
+        }
+
+        // A single thread works directly on g.
+        if (N == 1) {
+            return partial_loss_and_gradient(0, M, g);
+        }
+
+        // Compute the loss and gradients for the shards in parallel; every
+        // thread allocates its own gradient buffer.
+        std::vector<gradient_task> tasks(N);
+        for (size_t t = 0;t < N;++t) {
+            tasks[t].owner = this;
+            tasks[t].first = M * t / N;
+            tasks[t].last = M * (t+1) / N;
+            tasks[t].n = n;
+            tasks[t].loss = 0.;
+        }
+        run_tasks(tasks);
+
+        std::vector<value_type*> buffers(N);
+        for (size_t t = 0;t < N;++t) {
+            buffers[t] = &tasks[t].g[0];
+        }
+
+        // Sum the gradient buffers into g for ranges of features in parallel.
+        std::vector<reduction_task> reductions(N);
+        for (size_t t = 0;t < N;++t) {
+            reductions[t].buffers = &buffers;
+            reductions[t].g = g;
+            reductions[t].first = (int)((size_t)n * t / N);
+            reductions[t].last = (int)((size_t)n * (t+1) / N);
+        }
+        run_tasks(reductions);
+
+        // Sum the losses in the same order.
+        for (size_t stride = 1;stride < N;stride *= 2) {
+            for (size_t t = 0;t + stride < N;t += 2 * stride) {
+                tasks[t].loss += tasks[t + stride].loss;
+            }
+        }
+        return tasks[0].loss;
+    }
+
     virtual value_type loss_and_gradient(
         const value_type *x,
         value_type *g,
         const int n
         ) = 0;
 
+    /**
+     * Adds the loss and gradients of a range of instances.
+     *  This function may be called concurrently for disjoint ranges; an
+     *  implementation must not modify the state of the object.
+     *  @param  first       The index of the first instance.
+     *  @param  last        The index just beyond the last instance.
+     *  @param  g           The gradient vector to which this function adds.
+     *  @return value_type  The loss of the instances.
+     */
+    virtual value_type partial_loss_and_gradient(
+        size_t first,
+        size_t last,
+        value_type *g
+        ) = 0;
+
     virtual void holdout_evaluation() = 0;
 
 public:
@@ -347,6 +628,86 @@ public:
         return m_params;
     }
 
+    /**
+     * Sets the collective operation for distributed training.
+     *  Every rank trains on its own shard of the data set; the loss and
+     *  gradients are summed over the ranks before they are sent to the
+     *  L-BFGS routine, so that all ranks proceed with the identical
+     *  weights. The number of features and their identifiers must agree
+     *  among the ranks.
+     *  @param  ar          The collective operation, or \c NULL for
+     *                      training on one process.
+     */
+    void set_allreduce(allreduce* ar)
+    {
+        m_allreduce = ar;
+    }
+
+    /**
+     * Sets the checkpoint of the training process.
+     *  The weights are stored after every interval-th iteration. When the
+     *  training resumes, the L-BFGS routine restarts from the weights
+     *  stored last with the iteration numbers continued; the correction
+     *  pairs approximating the inverse hessian matrix and the history of
+     *  the stopping criterion are internal to the routine, and are rebuilt
+     *  in the iterations after resuming.
+     *  @param  cp          The checkpoint, or \c NULL for no checkpoint.
+     */
+    void set_checkpoint(checkpoint* cp)
+    {
+        m_checkpoint = cp;
+    }
+
+    /**
+     * Sets the writer of training metrics.
+     *  Every iteration writes a record with the wall-clock and CPU times,
+     *  the times of the phases (the loss and gradients, the sum over the
+     *  ranks, the L2 regularization, the rest of the L-BFGS routine such as
+     *  the line search and the L1 regularization, and the holdout
+     *  evaluation), and the throughput in instances and elements.
+     *  @param  m           The writer, or \c NULL for no metrics.
+     */
+    void set_metrics(metrics* m)
+    {
+        m_metrics = m;
+    }
+
+    /**
+     * Sets the settings of holdout evaluations.
+     *  The holdout instances are listed once before training (a random
+     *  subset of them with a sample size), and evaluated by multiple
+     *  threads after every interval-th iteration.
+     *  @param  ho          The settings.
+     */
+    void set_holdout_options(const holdout_options& ho)
+    {
+        m_holdout_options = ho;
+    }
+
+    /**
+     * Sets the starting point of the next training.
+     *  A warm start keeps the weights of the previous training as the
+     *  starting point, which saves iterations when the model is trained
+     *  repeatedly with slightly different parameters on the same data set.
+     *  @param  warm        \c true to start from the previous weights, or
+     *                      \c false to start from zero weights.
+     */
+    void set_warm_start(bool warm)
+    {
+        m_warm_start = warm;
+    }
+
+    /**
+     * Sets the weights from which the next training starts.
+     *  @param  w           The initial weights storing the weights for all
+     *                      features of the data set.
+     */
+    void set_initial_weights(const model_type& w)
+    {
+        m_w = w;
+        m_warm_start = true;
+    }
+
     /**
      * Obtains a read-only access to the weight vector (model).
      *  @return const model_type&   The weight vector (model).
@@ -355,6 +716,21 @@ public:
     {
         return m_w;
     }
+
+    /**
+     * Returns the memory used by the training algorithm.
+     *  This includes the weight vector and the buffers allocated by
+     *  liblbfgs, the correction pairs of the m memories and five vectors
+     *  for the solution, gradients and the search direction.
+     *  @return size_t      The approximate number of bytes.
+     */
+    virtual size_t memory_usage() const
+    {
+        const size_t n = m_w.size();
+        return
+            (n + (2 * m_lbfgs_num_memories + 5) * n) * sizeof(value_type) +
+            classias::memory_usage(m_reduced);
+    }
 };
 
 
@@ -397,6 +773,8 @@ public:
 protected:
     /// A data set for training.
     const data_type* m_data;
+    /// The holdout instances.
+    std::vector<const_iterator> m_holdout_index;
 
 public:
     /**
@@ -414,6 +792,15 @@ public:
     {
     }
 
+    /**
+     * Returns the memory used by the training algorithm.
+     *  @return size_t      The approximate number of bytes.
+     */
+    virtual size_t memory_usage() const
+    {
+        return base_class::memory_usage() + classias::memory_usage(m_holdout_index);
+    }
+
     /**
      * Resets the internal states and parameters to default.
      */
@@ -437,18 +824,33 @@ protected:
         const int n
         )
     {
-        typename data_type::const_iterator iti;
-        typename instance_type::const_iterator it;
-        value_type loss = 0;
-        error_type cls(this->m_w); // we know that &m_w[0] and x are identical.
-
         // Initialize the gradients with zero.
         for (int i = 0;i < n;++i) {
             g[i] = 0.;
         }
 
-        // For each instance in the data.
-        for (iti = m_data->begin();iti != m_data->end();++iti) {
+        return this->accumulate_loss_and_gradient(g, n, m_data->size());
+    }
+
+    /**
+     * Adds the loss and gradients of a range of instances.
+     *  @param  first       The index of the first instance.
+     *  @param  last        The index just beyond the last instance.
+     *  @param  g           The gradient vector to which this function adds.
+     *  @return value_type  The loss of the instances.
+     */
+    virtual value_type partial_loss_and_gradient(
+        size_t first,
+        size_t last,
+        value_type *g
+        )
+    {
+        const_iterator iti;
+        value_type loss = 0;
+        error_type cls(this->m_w); // we know that &m_w[0] and x are identical.
+
+        // For each instance in the range.
+        for (iti = m_data->begin() + first;iti != m_data->begin() + last;++iti) {
             // Exclude instances for holdout evaluation.
             if (iti->get_group() == this->m_holdout) {
                 continue;
@@ -466,14 +868,73 @@ protected:
 
             // Update the gradients for the weights.
             err *= iti->get_weight();
-            for (it = iti->begin();it != iti->end();++it) {
-                g[it->first] += err * it->second;
-            }
+            this->add_gradient(g, iti->begin(), iti->end(), err);
         }
 
         return loss;
     }
 
+    /**
+     * Adds the gradients of an instance.
+     *  @param  g           The gradient vector to which this function adds.
+     *  @param  first       The iterator for the first element of attributes.
+     *  @param  last        The iterator for the element just beyond the
+     *                      last element of attributes.
+     *  @param  err         The error multiplied by the instance weight.
+     */
+    template <class iterator_type>
+    inline void add_gradient(
+        value_type *g,
+        iterator_type first,
+        iterator_type last,
+        value_type err
+        )
+    {
+        for (iterator_type it = first;it != last;++it) {
+            g[it->first] += err * it->second;
+        }
+    }
+
+    /**
+     * Adds the gradients of an instance in CSR layout, skipping the
+     * multiplication for implicit values and decoding compressed identifiers
+     * by blocks.
+     *  @param  g           The gradient vector to which this function adds.
+     *  @param  first       The iterator for the first element of attributes.
+     *  @param  last        The iterator for the element just beyond the
+     *                      last element of attributes.
+     *  @param  err         The error multiplied by the instance weight.
+     */
+    inline void add_gradient(
+        value_type *g,
+        csr_element_iterator first,
+        csr_element_iterator last,
+        value_type err
+        )
+    {
+        if (first.compressed()) {
+            int ids[csr_element_iterator::block_size];
+            while (first != last) {
+                const float* v = first.fvalue_data();
+                const int step = first.step();
+                const int n = first.decode(last, ids);
+                for (int i = 0;i < n;++i) {
+                    g[ids[i]] += err * v[i * step];
+                }
+            }
+            return;
+        }
+
+        if (!first.implicit_values()) {
+            this->template add_gradient<csr_element_iterator>(g, first, last, err);
+            return;
+        }
+
+        for (const int* p = first.id_data();p != last.id_data();++p) {
+            g[*p] += err;
+        }
+    }
+
 public:
     /**
      * Trains a model on a data set.
@@ -504,6 +965,10 @@ public:
 
         // Call the L-BFGS solver.
         m_data = &data;
+        count_training(data, holdout, this->m_num_instances, this->m_num_elements);
+        holdout_instances(
+            m_holdout_index, data.begin(), data.end(), holdout,
+            this->m_holdout_options.sample);
         int ret = this->lbfgs_solve(
             (const int)K,
             os,
@@ -525,10 +990,9 @@ protected:
 
         holdout_evaluation_binary(
             *this->m_os,
-            this->m_data->begin(),
-            this->m_data->end(),
+            m_holdout_index,
             cla,
-            this->m_holdout
+            this->m_holdout_options.num_threads
             );
     }
 };
@@ -576,8 +1040,12 @@ protected:
     value_type *m_oexps;
     /// A data set for training.
     const data_type* m_data;
+    /// The holdout instances.
+    std::vector<const_iterator> m_holdout_index;
     /// The flag indicating whether 
     bool m_acconly;
+    /// The mode of computing soft-max probabilities.
+    std::string m_softmax;
 
 public:
     /**
@@ -599,6 +1067,19 @@ public:
         clear();
     }
 
+    /**
+     * Returns the memory used by the training algorithm.
+     *  @return size_t      The approximate number of bytes, including the
+     *                      observed feature expectations.
+     */
+    virtual size_t memory_usage() const
+    {
+        return
+            base_class::memory_usage() +
+            (m_oexps != NULL ? this->m_w.size() * sizeof(value_type) : 0) +
+            classias::memory_usage(m_holdout_index);
+    }
+
     /**
      * Resets the internal states and parameters to default.
      */
@@ -608,6 +1089,11 @@ public:
         m_oexps = NULL;
         m_data = NULL;
         base_class::clear();
+
+        this->m_params.init("softmax", &m_softmax, "exact",
+            "The exponential function for computing the soft-max probabilities:\n"
+            "{'exact': std::exp() of the C++ library, 'fast': vectorized polynomial\n"
+            "approximation whose relative error is below 1e-14}");
     }
 
 protected:
@@ -624,18 +1110,36 @@ protected:
         const int n
         )
     {
-        value_type loss = 0;
-        const data_type& data = *m_data;
-        const int L = data.num_labels();
-        error_type cls(this->m_w); // We know that &m_w[0] and x are identical.
-
         // Initialize the gradients with (the negative of) observation expexcations.
         for (int i = 0;i < n;++i) {
             g[i] = -m_oexps[i];
         }
 
-        // For each instance in the data.
-        for (const_iterator iti = data.begin();iti != data.end();++iti) {
+        return this->accumulate_loss_and_gradient(g, n, m_data->size());
+    }
+
+    /**
+     * Adds the loss and gradients of a range of instances.
+     *  @param  first       The index of the first instance.
+     *  @param  last        The index just beyond the last instance.
+     *  @param  g           The gradient vector to which this function adds.
+     *  @return value_type  The loss of the instances.
+     */
+    virtual value_type partial_loss_and_gradient(
+        size_t first,
+        size_t last,
+        value_type *g
+        )
+    {
+        value_type loss = 0;
+        const data_type& data = *m_data;
+        const int L = data.num_labels();
+        error_type cls(this->m_w); // We know that &m_w[0] and x are identical.
+        std::vector<value_type> prob;
+        cls.set_fast_exp(m_softmax == "fast");
+
+        // For each instance in the range.
+        for (const_iterator iti = data.begin() + first;iti != data.begin() + last;++iti) {
             const instance_type& inst = *iti;
 
             // Exclude instances for holdout evaluation.
@@ -643,25 +1147,16 @@ protected:
                 continue;
             }
 
-            // Tell the classifier the number of possible labels.
-            cls.resize(inst.num_candidates(L));
-
             // Compute the probability prob[l] for each label #l.
-            for (int i = 0;i < inst.num_candidates(L);++i) {
-                const attributes_type& v = inst.attributes(i);
-                cls.inner_product(i, data.feature_generator, v.begin(), v.end(), i);
-            }
+            cls.inner_product_instance(data.feature_generator, inst, L);
             cls.finalize();
 
             // Accumulate the model expectations of features.
-            for (int i = 0;i < inst.num_candidates(L);++i) {
-                const attributes_type& v = inst.attributes(i);
-                this->add_weights(
-                    g, i, data.feature_generator, v.begin(), v.end(), cls.prob(i));
-            }
+            this->add_expectations(
+                g, data.feature_generator, inst, cls, L, inst.get_weight(), prob);
 
             // Accumulate the loss for predicting the instance.
-            loss -= cls.logprob(inst.get_label());
+            loss -= inst.get_weight() * cls.logprob(inst.get_label());
         }
 
         return loss;
@@ -688,8 +1183,13 @@ public:
         const size_t K = data.num_features();
         const size_t L = data.num_labels();
 
+        if (m_softmax != "exact" && m_softmax != "fast") {
+            throw invalid_parameter("Unknown mode for computing soft-max probabilities");
+        }
+
         // Initialize feature expectations and weights.
         this->initialize_weights(K);
+        delete[] m_oexps;
         m_oexps = new double[K];
         for (size_t k = 0;k < K;++k) {
             m_oexps[k] = 0.;
@@ -712,12 +1212,24 @@ public:
             const int l = iti->get_label();
             const attributes_type& v = iti->attributes(l);
             this->add_weights(
-                m_oexps, l, data.feature_generator, v.begin(), v.end(), 1.0);
+                m_oexps, l, data.feature_generator, v.begin(), v.end(), iti->get_weight());
+
+            // Count the attributes shared by the candidates as well.
+            const attributes_type* shared = shared_attributes(*iti);
+            if (shared != NULL) {
+                this->add_weights(
+                    m_oexps, l, data.feature_generator,
+                    shared->begin(), shared->end(), iti->get_weight());
+            }
         }
 
         // Call the L-BFGS solver.
         m_data = &data;
         m_acconly = acconly;
+        count_training(data, holdout, this->m_num_instances, this->m_num_elements);
+        holdout_instances(
+            m_holdout_index, data.begin(), data.end(), holdout,
+            this->m_holdout_options.sample);
         int ret = this->lbfgs_solve(
             (const int)K,
             os,
@@ -736,15 +1248,15 @@ protected:
     void holdout_evaluation()
     {
         error_type cla(this->m_w);
+        cla.set_fast_exp(m_softmax == "fast");
 
         holdout_evaluation_multi(
             *this->m_os,
-            this->m_data->begin(),
-            this->m_data->end(),
+            m_holdout_index,
             cla,
             this->m_data->feature_generator,
-            this->m_holdout,
             this->m_acconly,
+            this->m_holdout_options.num_threads,
             this->m_data->labels,
             this->m_data->positive_labels.begin(),
             this->m_data->positive_labels.end()
@@ -752,6 +1264,150 @@ protected:
     }
 
 protected:
+    /**
+     * Adds the model expectations of the features of an instance.
+     *  The attributes shared by the candidates are added once with the sum
+     *  of the probabilities of the candidates.
+     *  @param  g           The gradient vector to which an update occurs.
+     *  @param  fgen        The feature generator.
+     *  @param  inst        The instance.
+     *  @param  cls         The classifier holding the probabilities.
+     *  @param  L           The number of labels.
+     *  @param  weight      The weight of the instance.
+     *  @param  prob        The working space (unused).
+     */
+    template <class feature_generator_type, class instance_type>
+    inline void add_expectations(
+        value_type* g,
+        const feature_generator_type& fgen,
+        const instance_type& inst,
+        error_type& cls,
+        int L,
+        value_type weight,
+        std::vector<value_type>& prob
+        )
+    {
+        value_type sum = 0.;
+        for (int i = 0;i < inst.num_candidates(L);++i) {
+            const attributes_type& v = inst.attributes(i);
+            const value_type p = weight * cls.prob(i);
+            this->add_weights(g, i, fgen, v.begin(), v.end(), p);
+            sum += p;
+        }
+
+        const attributes_type* shared = shared_attributes(inst);
+        if (shared != NULL) {
+            this->add_weights(g, 0, fgen, shared->begin(), shared->end(), sum);
+        }
+    }
+
+    /**
+     * Adds the model expectations of the features of a multi-class instance
+     * with a dense feature generator.
+     *  The weights of an attribute for all labels are laid out contiguously,
+     *  so that this function adds the probability vector scaled by the value
+     *  of every attribute with a vector instruction (AXPY).
+     *  @param  g           The gradient vector to which an update occurs.
+     *  @param  fgen        The feature generator.
+     *  @param  inst        The instance.
+     *  @param  cls         The classifier holding the probabilities.
+     *  @param  L           The number of labels.
+     *  @param  weight      The weight of the instance.
+     *  @param  prob        The working space for the probabilities.
+     */
+    template <class A, class Lb, class F, class T, class W, class G>
+    inline void add_expectations(
+        value_type* g,
+        const dense_feature_generator_base<A, Lb, F>& fgen,
+        const multi_instance_base<T, W, G>& inst,
+        error_type& cls,
+        int L,
+        value_type weight,
+        std::vector<value_type>& prob
+        )
+    {
+        if (L == 0 || (int)fgen.num_labels() != L) {
+            for (int i = 0;i < L;++i) {
+                this->add_weights(
+                    g, i, fgen, inst.begin(), inst.end(), weight * cls.prob(i));
+            }
+            return;
+        }
+
+        prob.resize(L);
+        for (int i = 0;i < L;++i) {
+            prob[i] = weight * cls.prob(i);
+        }
+        for (typename T::const_iterator it = inst.begin();it != inst.end();++it) {
+            F f;
+            if (fgen.forward(it->first, 0, f)) {
+                simd::axpy(L, it->second, &prob[0], g + f);
+            }
+        }
+    }
+
+    /**
+     * A function object adding the probabilities of the labels scaled by
+     * the value of an attribute to the gradients of the postings.
+     */
+    template <class feature_generator_type>
+    struct expectation_adder
+    {
+        value_type* g;
+        const value_type* prob;
+        value_type value;
+        int L;
+
+        inline void operator()(
+            const typename feature_generator_type::label_type& l,
+            const typename feature_generator_type::feature_type& f
+            )
+        {
+            if ((int)l < L) {
+                g[f] += prob[l] * value;
+            }
+        }
+    };
+
+    /**
+     * Adds the model expectations of the features of a multi-class instance
+     * with a sparse feature generator.
+     *  Only the labels in the posting list of every attribute are visited.
+     *  @param  g           The gradient vector to which an update occurs.
+     *  @param  fgen        The feature generator.
+     *  @param  inst        The instance.
+     *  @param  cls         The classifier holding the probabilities.
+     *  @param  L           The number of labels.
+     *  @param  weight      The weight of the instance.
+     *  @param  prob        The working space for the probabilities.
+     */
+    template <class A, class Lb, class F, class T, class W, class G>
+    inline void add_expectations(
+        value_type* g,
+        const sparse_feature_generator_base<A, Lb, F>& fgen,
+        const multi_instance_base<T, W, G>& inst,
+        error_type& cls,
+        int L,
+        value_type weight,
+        std::vector<value_type>& prob
+        )
+    {
+        typedef sparse_feature_generator_base<A, Lb, F> fgen_type;
+        prob.resize(L);
+        for (int i = 0;i < L;++i) {
+            prob[i] = weight * cls.prob(i);
+        }
+
+        expectation_adder<fgen_type> add;
+        add.g = g;
+        add.prob = (L == 0 ? NULL : &prob[0]);
+        add.L = L;
+        for (typename T::const_iterator it = inst.begin();it != inst.end();++it) {
+            add.value = it->second;
+            fgen.postings(it->first, add);
+        }
+    }
+
     /**
      * Adds a value to weights associated with a feature vector.
      *  @param  w           The weight vector to which an update occurs.
@@ -40,36 +40,165 @@
 #include <iostream>
 #include <iterator>
 #include <vector>
+#include <classias/allreduce.h>
+#include <classias/checkpoint.h>
 #include <classias/parameters.h>
 #include <classias/evaluation.h>
+#include <classias/metrics.h>
+#include <classias/thread.h>
 
 namespace classias {
 
 namespace train {
 
+/**
+ * A generator of pseudo-random numbers for sampling instances.
+ *  By default, the generator draws the numbers from std::rand(), as the
+ *  trainers did before, so that a training yields the same model as that
+ *  of the previous versions. A seeded generator draws the numbers from its
+ *  own sequence (xorshift, as in the sampling of holdout instances), so
+ *  that trainers running at the same time (the folds of cross validation
+ *  trained with --cv-jobs) yield the same models whatever the scheduling of
+ *  the threads is.
+ */
+class random_generator
+{
+protected:
+    /// The state of the generator (zero to draw from std::rand()).
+    unsigned int m_x;
+
+public:
+    /**
+     * Constructs an object drawing the numbers from std::rand().
+     */
+    random_generator() : m_x(0)
+    {
+    }
+
+    /**
+     * Draws the numbers from std::rand(), shared by the process.
+     */
+    void share()
+    {
+        m_x = 0;
+    }
+
+    /**
+     * Draws the numbers from the own sequence of a seed.
+     *  @param  seed        The seed.
+     */
+    void seed(unsigned int seed)
+    {
+        m_x = 2463534242U ^ (seed * 2654435761U);
+        if (m_x == 0) {
+            m_x = 2463534242U;
+        }
+    }
+
+    /**
+     * Draws a random number.
+     *  @param  n           The number of the possible values.
+     *  @return size_t      A random number in [0, n).
+     */
+    size_t operator()(size_t n)
+    {
+        if (m_x == 0) {
+            return (size_t)std::rand() % n;
+        }
+        m_x ^= (m_x << 13);
+        m_x ^= (m_x >> 17);
+        m_x ^= (m_x << 5);
+        return (size_t)m_x % n;
+    }
+
+    /**
+     * Shuffles the elements in a range.
+     *  @param  first       The random-access iterator to the first element.
+     *  @param  last        The random-access iterator just beyond the last
+     *                      element.
+     */
+    template <class iterator_type>
+    void shuffle(iterator_type first, iterator_type last)
+    {
+        if (m_x == 0) {
+            std::random_shuffle(first, last);
+        } else {
+            std::random_shuffle(first, last, *this);
+        }
+    }
+};
+
 template <class iterator_type>
 static iterator_type
 random_sample(
-    iterator_type first, iterator_type last
+    iterator_type first, iterator_type last, random_generator& rnd
     )
 {
-    int n = (int)std::distance(first, last);
-    int i = std::rand() % n;
-    std::advance(first, i);
+    size_t n = (size_t)std::distance(first, last);
+    std::advance(first, rnd(n));
     return first;
 }
 
 template <class container_type, class iterator_type>
 static void
 shuffle_permutation(
-    container_type& cont, iterator_type first, iterator_type last
+    container_type& cont, iterator_type first, iterator_type last,
+    random_generator& rnd
     )
 {
     size_t i = 0;
     for (iterator_type it = first;it != last;++it) {
         cont[i++] = it;
     }
-    std::random_shuffle(cont.begin(), cont.end());
+    rnd.shuffle(cont.begin(), cont.end());
+}
+
+/**
+ * Lists the instances sent to an online algorithm in an epoch.
+ *  @param  perm        The container to which this function stores the
+ *                      iterators of the instances.
+ *  @param  data        The data set.
+ *  @param  sample      The method for sampling instances.
+ *  @param  holdout     The group number for holdout evaluation.
+ *  @param  rnd         The generator of random numbers.
+ */
+template <class container_type, class data_type>
+static void
+sample_instances(
+    container_type& perm, const data_type& data, const std::string& sample, int holdout,
+    random_generator& rnd
+    )
+{
+    typedef typename data_type::const_iterator const_iterator;
+
+    perm.clear();
+    if (sample == "random") {
+        // Choose N instances at random.
+        for (size_t i = 0;i < data.size();++i) {
+            const_iterator it = random_sample(data.begin(), data.end(), rnd);
+            if (it->get_group() != holdout) {
+                perm.push_back(it);
+            }
+        }
+    } else if (sample == "cycle") {
+        // Do not change the ordering of instances.
+        for (const_iterator it = data.begin();it != data.end();++it) {
+            if (it->get_group() != holdout) {
+                perm.push_back(it);
+            }
+        }
+    } else if (sample == "shuffle") {
+        // Shuffle N instances first.
+        container_type all(data.size());
+        shuffle_permutation(all, data.begin(), data.end(), rnd);
+        for (size_t i = 0;i < all.size();++i) {
+            if (all[i]->get_group() != holdout) {
+                perm.push_back(all[i]);
+            }
+        }
+    } else {
+        throw invalid_parameter("Unknown sampling method for instances");
+    }
 }
 
 template <class value_type, class iterator_type>
@@ -134,12 +263,85 @@ protected:
     int m_period;
     /// The epsilon for improvement ratio.
     value_type m_epsilon;
+    /// The number of threads.
+    int m_num_threads;
+    /// The weights for mixing the models of the ranks.
+    std::string m_mixing;
+    /// The collective operation of distributed training (or NULL).
+    allreduce* m_allreduce;
+    /// The initial weights (empty for training from zero weights).
+    model_type m_init;
+    /// The writer of training metrics (NULL for no metrics).
+    metrics* m_metrics;
+    /// The settings of holdout evaluations.
+    holdout_options m_holdout_options;
+    /// The checkpoint of the training process (or NULL).
+    checkpoint* m_checkpoint;
+    /// The generator of random numbers for sampling instances.
+    random_generator m_random;
+
+    /// The wall-clock time at the start of the iteration.
+    double m_clk;
+    /// The CPU time at the start of the iteration.
+    double m_cpu;
+    /// The seconds spent updating the model with the instances.
+    double m_time_update;
+    /// The seconds spent mixing the models of the ranks.
+    double m_time_mixing;
+    /// The seconds of the iteration excluding the holdout evaluation.
+    double m_time_iteration;
+    /// The CPU seconds of the iteration excluding the holdout evaluation.
+    double m_time_cpu;
+    /// The loss of the iteration.
+    value_type m_loss;
+    /// The number of instances sent to the algorithm in the iteration.
+    double m_num_instances;
+    /// The number of elements of the instances sent in the iteration.
+    double m_num_elements;
+
+    /// The workers for parallel training.
+    std::vector<trainer_type*> m_workers;
+
+    /// A task sending a partition of instances to a worker.
+    struct update_task
+    {
+        /// The worker.
+        trainer_type* trainer;
+        /// The instances in the epoch.
+        const std::vector<const_iterator>* perm;
+        /// The index of the first instance for the worker.
+        size_t first;
+        /// The interval of the instances for the worker.
+        size_t stride;
+
+        void run()
+        {
+            const size_t B = (size_t)trainer->batch_size();
+            if (1 < B) {
+                // Send the minibatches of the instances for the worker.
+                std::vector<const_iterator> batch;
+                for (size_t i = first;i < perm->size();i += stride) {
+                    batch.push_back((*perm)[i]);
+                    if (batch.size() == B) {
+                        trainer->update_batch(batch.begin(), batch.end());
+                        batch.clear();
+                    }
+                }
+                trainer->update_batch(batch.begin(), batch.end());
+            } else {
+                for (size_t i = first;i < perm->size();i += stride) {
+                    trainer->update((*perm)[i]);
+                }
+            }
+        }
+    };
 
 public:
     /**
      * Constructs the object.
      */
-    online_scheduler_binary()
+    online_scheduler_binary() :
+        m_allreduce(NULL), m_metrics(NULL), m_checkpoint(NULL)
     {
         clear();
     }
@@ -149,6 +351,9 @@ public:
      */
     virtual ~online_scheduler_binary()
     {
+        for (size_t i = 0;i < m_workers.size();++i) {
+            delete m_workers[i];
+        }
     }
 
     /**
@@ -169,6 +374,13 @@ public:
             "The period to measure the improvement ratio");
         par.init("epsilon", &m_epsilon, 1e-4,
             "The stopping criterion for the improvement ratio");
+        par.init("num_threads", &m_num_threads, 1,
+            "The number of threads updating the weight vector without locks (Hogwild!);\n"
+            "the thread #i receives the instances #i, #i + ${num_threads}, ... in an epoch.");
+        par.init("mixing", &m_mixing, "uniform",
+            "The weights for averaging the models of the ranks after every epoch of\n"
+            "distributed training (iterative parameter mixing):\n"
+            "{'uniform': the same weights, 'updates': the numbers of the updates of the ranks}");
     }
 
     /**
@@ -191,6 +403,86 @@ public:
         return m_trainer.model();
     }
 
+    /**
+     * Returns the memory used by the training algorithm.
+     *  @return size_t      The approximate number of bytes, including the
+     *                      states of the worker threads.
+     */
+    size_t memory_usage() const
+    {
+        size_t bytes = m_trainer.memory_usage() + m_init.size() * sizeof(value_type);
+        for (size_t i = 0;i < m_workers.size();++i) {
+            bytes += m_workers[i]->memory_usage();
+        }
+        return bytes;
+    }
+
+    /**
+     * Sets the collective operation of distributed training.
+     *  Every rank trains the model on the data set of its own in an epoch,
+     *  and the ranks replace their models with the weighted average of them
+     *  at the end of the epoch.
+     *  @param  ar          The collective operation over the ranks, or
+     *                      \c NULL for training in a single process.
+     */
+    void set_allreduce(allreduce* ar)
+    {
+        m_allreduce = ar;
+    }
+
+    /**
+     * Sets the weights from which the training starts.
+     *  @param  w           The initial weights storing the weights for all
+     *                      features of the data set.
+     */
+    void set_initial_weights(const model_type& w)
+    {
+        m_init = w;
+    }
+
+    /**
+     * Sets the writer of training metrics.
+     *  Every iteration writes a record with the wall-clock and CPU times,
+     *  the times of the phases (the updates, the mixing of the models over
+     *  the ranks, and the holdout evaluation), and the throughput of the
+     *  updates in instances and elements.
+     *  @param  m           The writer, or \c NULL for no metrics.
+     */
+    void set_metrics(metrics* m)
+    {
+        m_metrics = m;
+    }
+
+    /**
+     * Sets the settings of holdout evaluations.
+     *  The holdout instances are listed once before training (a random
+     *  subset of them with a sample size), and evaluated by multiple
+     *  threads after every interval-th iteration. Training on a stream
+     *  ignores the sample size, and lists the holdout instances of every
+     *  block.
+     *  @param  ho          The settings.
+     */
+    void set_holdout_options(const holdout_options& ho)
+    {
+        m_holdout_options = ho;
+    }
+
+    /**
+     * Sets the checkpoint of the training process.
+     *  The state of the training algorithm, the recent losses, and the
+     *  iteration number are stored after every interval-th iteration of
+     *  train(). When the training resumes, train() restores the state
+     *  stored last and replays the random numbers drawn by the completed
+     *  iterations for sampling the instances, so that the training
+     *  continues as if it had not stopped (except for parallel training,
+     *  whose updates are not deterministic).
+     *  @param  cp          The checkpoint, or \c NULL for no checkpoint.
+     */
+    void set_checkpoint(checkpoint* cp)
+    {
+        m_checkpoint = cp;
+    }
+
     /**
      * Trains a model on a data set.
      *  @param  data        The data set for training (and holdout evaluation).
@@ -211,9 +503,16 @@ public:
         // Ring buffer for moving averages.
         std::vector<value_type> pf(m_period);
 
-        // Set the number of instances for the target algorithm.
+        // Set the number of instances (of all ranks) for the target algorithm.
         parameter_exchange& par = this->params();
-        par.set("n", (double)data.size(), false);
+        double n = (double)data.size();
+        if (m_allreduce != NULL) {
+            m_allreduce->sum(&n, 1);
+        }
+        par.set("n", n, false);
+
+        // The weight of this rank for mixing the models.
+        value_type weight = this->mixing_weight(data, holdout);
 
         // Reserve the weight vector.
         m_trainer.set_num_features(data.num_features());
@@ -223,94 +522,169 @@ public:
         m_trainer.params().show(os);
         os << std::endl;
 
+        // Draw the random numbers of a fold trained concurrently with the
+        // others from the sequence of its holdout group.
+        if (m_holdout_options.fold_random) {
+            m_random.seed((unsigned int)holdout);
+        } else {
+            m_random.share();
+        }
+
         // Initialize the training algorithm.
         m_trainer.start();
+        if (!m_init.empty()) {
+            m_trainer.set_weights(m_init);
+        }
+        count_training(data, holdout, m_num_instances, m_num_elements);
+        std::vector<const_iterator> index;
+        holdout_instances(
+            index, data.begin(), data.end(), holdout, m_holdout_options.sample);
+        const int k0 = this->resume_checkpoint(data, holdout, pf, os);
 
         // Loop for iterations.
-        for (int k = 1;k <= m_max_iterations;++k) {
-            value_type loss = 0;
-            value_type avg = 0, var = 0, nvar = m_epsilon;
-            clock_t clk = std::clock();
+        for (int k = k0 + 1;k <= m_max_iterations;++k) {
+            this->start_iteration();
 
             // Send instances to the algorithm.
-            if (m_sample == "random") {
-                // Choose N instances at random.
-                for (size_t i = 0;i < data.size();++i) {
-                    const_iterator it = random_sample(data.begin(), data.end());
-                    if (it->get_group() != holdout) {
-                        m_trainer.update(it);
-                    }
-                }
-            } else if (m_sample == "cycle") {
-                // Do not change the ordering of instances.
-                for (const_iterator it = data.begin();it != data.end();++it) {
-                    if (it->get_group() != holdout) {
-                        m_trainer.update(it);
-                    }
-                }
-            } else if (m_sample == "shuffle") {
-                // Shuffle N instances first.
-                std::vector<const_iterator> perm(data.size());
-                shuffle_permutation(perm, data.begin(), data.end());
-                for (size_t i = 0;i < perm.size();++i) {
-                    const_iterator it = perm[i];
-                    if (it->get_group() != holdout) {
-                        m_trainer.update(it);
-                    }
-                }
-            } else {
-                throw invalid_parameter("Unknown sampling method for instances");
-            }
-
-            // Pause the training process, and compute the loss.
-            m_trainer.discontinue();
-            loss = m_trainer.loss();
-
-            // Store the current loss to the ring buffer
-            pf[(k-1) % m_period] = loss;
-            if (m_period < k) {
-                // Compute the average and variance of the recent losses.
-                avg = std::accumulate(pf.begin(), pf.end(), 0.) / pf.size();
-                var = compute_variance(pf.begin(), pf.end(), avg);
-                // nvar = var / min(1, fabs(loss))
-                nvar = fabs(loss);
-                if (1. < nvar) {
-                    nvar = var / nvar;
-                } else {
-                    nvar = var;
-                }
+            this->update_instances(data, holdout);
+            m_time_update = wall_clock() - m_clk;
+            if (m_allreduce != NULL) {
+                const double clk = wall_clock();
+                m_trainer.mix(*m_allreduce, weight);
+                m_time_mixing = wall_clock() - clk;
             }
-
-            // Report the progress.
-            os << "***** Iteration #" << k << " *****" << std::endl;
-            m_trainer.report(os);
-            if (m_period < k) {
-                os << "Loss variance: " << nvar << std::endl;
-            }
-            os << "Seconds required for this iteration: " <<
-                (std::clock() - clk) / (double)CLOCKS_PER_SEC << std::endl;
+            value_type nvar = this->report_iteration(k, pf, os);
 
             // Holdout evaluation if necessary.
-            if (0 <= holdout) {
+            const double clk = wall_clock();
+            if (0 <= holdout && m_holdout_options.scheduled(k, k == m_max_iterations)) {
                 error_type cla(m_trainer.model());
                 holdout_evaluation_binary(
                     os,
-                    data.begin(),
-                    data.end(),
+                    index,
                     cla,
-                    holdout
+                    m_holdout_options.num_threads
                     );
             }
 
-            // Flush the output stream.
-            os << std::endl;
-            os.flush();
+            this->write_metrics(k, holdout, wall_clock() - clk);
+
+            if (this->stop_iteration(nvar, os)) {
+                break;
+            }
+            this->save_checkpoint(k, pf);
+        }
+
+        // Finalize the training procedure.
+        if (m_checkpoint != NULL) {
+            m_checkpoint->wait();
+        }
+        m_trainer.finish();
+    }
+
+    /**
+     * Trains a model on a stream of data blocks.
+     *
+     *  This function makes repeated passes over a data set that does not
+     *  fit in memory. A source object (e.g., a reader of a data cache on a
+     *  disk) loads a block of instances at a time into a data set, and the
+     *  instances in a block are sent to the training algorithm as in
+     *  train(); with the "shuffle" sampling, the source reads the blocks in
+     *  a random order and the instances are shuffled within each block. The
+     *  holdout evaluation runs another pass over the stream after every
+     *  iteration. A source object must implement the following functions:
+     *      - size_t size() const: returns the number of instances;
+     *      - const data_type& data() const: returns the data set to which
+     *        blocks are loaded (with the numbers of features and labels);
+     *      - void rewind(bool shuffle): starts a pass over the stream (in a
+     *        random order of blocks if \c shuffle is \c true);
+     *      - const data_type* next(): loads the next block and returns the
+     *        data set holding it, or \c NULL at the end of the pass.
+     *
+     *  @param  source      The source of data blocks.
+     *  @param  os          The output stream for progress reports.
+     *  @param  holdout     The group number for holdout evaluation. Specify
+     *                      a negative value if a holdout evaluation is
+     *                      unnecessary.
+     *  @param  acconly     Unused (reserved only for the compatibility with
+     *                      multi-class classification).
+     */
+    template <class source_type>
+    void train_stream(
+        source_type& source,
+        std::ostream& os,
+        int holdout = -1,
+        bool acconly = true
+        )
+    {
+        static const int positive_labels[] = {1};
+
+        // Ring buffer for moving averages.
+        std::vector<value_type> pf(m_period);
 
-            // Terminate if the stopping criterion is satisfied.
-            if (nvar < m_epsilon) {
-                os << "Terminated with the stopping criterion" << std::endl;
-                os << std::endl;
-                os.flush();
+        // Set the number of instances for the target algorithm.
+        parameter_exchange& par = this->params();
+        par.set("n", (double)source.size(), false);
+
+        // Reserve the weight vector.
+        m_trainer.set_num_features(source.data().num_features());
+
+        // Show the algorithm name and parameters.
+        m_trainer.copyright(os);
+        m_trainer.params().show(os);
+        os << std::endl;
+
+        // Draw the random numbers of a fold trained concurrently with the
+        // others from the sequence of its holdout group.
+        if (m_holdout_options.fold_random) {
+            m_random.seed((unsigned int)holdout);
+        } else {
+            m_random.share();
+        }
+
+        // Initialize the training algorithm.
+        m_trainer.start();
+
+        // Loop for iterations.
+        for (int k = 1;k <= m_max_iterations;++k) {
+            this->start_iteration();
+            m_num_instances = 0.;
+            m_num_elements = 0.;
+
+            // Send the instances of every block to the algorithm.
+            source.rewind(m_sample == "shuffle");
+            for (const data_type* block = source.next();block != NULL;block = source.next()) {
+                this->update_instances(*block, holdout);
+                if (m_metrics != NULL) {
+                    double n, e;
+                    count_training(*block, holdout, n, e);
+                    m_num_instances += n;
+                    m_num_elements += e;
+                }
+            }
+            m_time_update = wall_clock() - m_clk;
+            value_type nvar = this->report_iteration(k, pf, os);
+
+            // Holdout evaluation if necessary.
+            const double clk = wall_clock();
+            if (0 <= holdout && m_holdout_options.scheduled(k, k == m_max_iterations)) {
+                error_type cla(m_trainer.model());
+                accuracy acc;
+                precall pr(2);
+                std::vector<const_iterator> index;
+                source.rewind(false);
+                for (const data_type* block = source.next();block != NULL;block = source.next()) {
+                    holdout_instances(index, block->begin(), block->end(), holdout);
+                    holdout_count_binary(
+                        index, cla, m_holdout_options.num_threads, acc, pr);
+                }
+                acc.output(os);
+                pr.output_micro(os, positive_labels, positive_labels+1);
+            }
+
+            this->write_metrics(k, holdout, wall_clock() - clk);
+
+            if (this->stop_iteration(nvar, os)) {
                 break;
             }
         }
@@ -318,6 +692,280 @@ public:
         // Finalize the training procedure.
         m_trainer.finish();
     }
+
+protected:
+    /**
+     * Computes the weight of this rank for mixing the models.
+     *  @param  data        The data set for training.
+     *  @param  holdout     The group number for holdout evaluation.
+     *  @return value_type  The weight of the model of this rank.
+     */
+    value_type mixing_weight(const data_type& data, int holdout)
+    {
+        if (m_mixing == "uniform") {
+            return 1.;
+        } else if (m_mixing == "updates") {
+            // An epoch updates the model with every training instance.
+            int n = 0;
+            for (const_iterator it = data.begin();it != data.end();++it) {
+                if (it->get_group() != holdout) {
+                    ++n;
+                }
+            }
+            return (value_type)n;
+        } else {
+            throw invalid_parameter("Unknown mixing method for distributed training");
+        }
+    }
+
+    /**
+     * Starts the clocks of an iteration.
+     */
+    void start_iteration()
+    {
+        m_clk = wall_clock();
+        m_cpu = cpu_clock();
+        m_time_update = 0.;
+        m_time_mixing = 0.;
+    }
+
+    /**
+     * Finishes an iteration: computes the loss and reports the progress.
+     *  @param  k           The iteration number.
+     *  @param  pf          The ring buffer of recent losses.
+     *  @param  os          The output stream for progress reports.
+     *  @return value_type  The variance of the recent losses.
+     */
+    value_type report_iteration(
+        int k, std::vector<value_type>& pf, std::ostream& os)
+    {
+        value_type loss = 0;
+        value_type avg = 0, var = 0, nvar = m_epsilon;
+
+        // Pause the training process, and compute the loss.
+        m_trainer.discontinue();
+        loss = m_trainer.loss();
+
+        // Store the current loss to the ring buffer
+        pf[(k-1) % m_period] = m_loss = loss;
+        if (m_period < k) {
+            // Compute the average and variance of the recent losses.
+            avg = std::accumulate(pf.begin(), pf.end(), 0.) / pf.size();
+            var = compute_variance(pf.begin(), pf.end(), avg);
+            // nvar = var / min(1, fabs(loss))
+            nvar = fabs(loss);
+            if (1. < nvar) {
+                nvar = var / nvar;
+            } else {
+                nvar = var;
+            }
+        }
+
+        // Report the progress.
+        os << "***** Iteration #" << k << " *****" << std::endl;
+        m_trainer.report(os);
+        if (m_period < k) {
+            os << "Loss variance: " << nvar << std::endl;
+        }
+        m_time_iteration = wall_clock() - m_clk;
+        m_time_cpu = cpu_clock() - m_cpu;
+        os << "Seconds required for this iteration: " << m_time_iteration << std::endl;
+        return nvar;
+    }
+
+    /**
+     * Writes the metrics of an iteration.
+     *  @param  k           The iteration number.
+     *  @param  holdout     The group number for holdout evaluation.
+     *  @param  seconds     The seconds of the holdout evaluation.
+     */
+    void write_metrics(int k, int holdout, double seconds)
+    {
+        if (m_metrics == NULL) {
+            return;
+        }
+
+        const double t = m_time_update;
+        metrics_record rec("iteration");
+        rec.add("solver", "online");
+        rec.add("holdout", holdout);
+        rec.add("iteration", k);
+        rec.add("loss", (double)m_loss);
+        rec.add("seconds", m_time_iteration);
+        rec.add("cpu_seconds", m_time_cpu);
+        rec.add("update_seconds", m_time_update);
+        rec.add("mixing_seconds", m_time_mixing);
+        rec.add("holdout_seconds", seconds);
+        rec.add("instances_per_second", 0. < t ? m_num_instances / t : 0.);
+        rec.add("nnz_per_second", 0. < t ? m_num_elements / t : 0.);
+        m_metrics->write(rec);
+    }
+
+    /**
+     * Restores the state stored last by the checkpoint.
+     *  @param  data        The data set for training.
+     *  @param  holdout     The group number for holdout evaluation.
+     *  @param  pf          The ring buffer of recent losses.
+     *  @param  os          The output stream for progress reports.
+     *  @return int         The number of the completed iterations (zero if
+     *                      the training does not resume).
+     */
+    int resume_checkpoint(
+        const data_type& data, int holdout,
+        std::vector<value_type>& pf, std::ostream& os)
+    {
+        std::string state;
+        if (m_checkpoint == NULL || !m_checkpoint->load("online", state)) {
+            return 0;
+        }
+
+        int k;
+        checkpoint_reader ar(state);
+        ar.value(k);
+        ar.vector(pf);
+        m_trainer.serialize(ar);
+        if (!ar.eof() || (int)pf.size() != m_period) {
+            throw checkpoint_error("A checkpoint has an inconsistent state");
+        }
+
+        // Draw the random numbers of the completed iterations.
+        std::vector<const_iterator> perm;
+        for (int i = 0;i < k;++i) {
+            sample_instances(perm, data, m_sample, holdout, m_random);
+        }
+
+        os << "Resumed from the checkpoint of iteration #" << k << std::endl;
+        os << std::endl;
+        return k;
+    }
+
+    /**
+     * Stores the state at the end of an iteration if scheduled.
+     *  @param  k           The iteration number.
+     *  @param  pf          The ring buffer of recent losses.
+     */
+    void save_checkpoint(int k, const std::vector<value_type>& pf)
+    {
+        if (m_checkpoint != NULL && m_checkpoint->scheduled(k)) {
+            checkpoint_writer ar;
+            ar.value(k);
+            ar.vector(pf);
+            m_trainer.serialize(ar);
+            m_checkpoint->save("online", ar);
+        }
+    }
+
+    /**
+     * Tests the stopping criterion at the end of an iteration.
+     *  @param  nvar        The variance of the recent losses.
+     *  @param  os          The output stream for progress reports.
+     *  @return bool        \c true if the training should terminate.
+     */
+    bool stop_iteration(value_type nvar, std::ostream& os)
+    {
+        // Flush the output stream.
+        os << std::endl;
+        os.flush();
+
+        // Terminate if the stopping criterion is satisfied.
+        if (nvar < m_epsilon) {
+            os << "Terminated with the stopping criterion" << std::endl;
+            os << std::endl;
+            os.flush();
+            return true;
+        }
+        return false;
+    }
+
+    /**
+     * Sends the instances of a data set to the algorithm (an epoch).
+     *  @param  data        The data set for training.
+     *  @param  holdout     The group number for holdout evaluation.
+     */
+    void update_instances(const data_type& data, int holdout)
+    {
+        if (1 < m_num_threads) {
+            // Send instances to the workers running in parallel.
+            this->update_parallel(data, holdout);
+        } else if (1 < m_trainer.batch_size()) {
+            // Send minibatches of instances.
+            this->update_batches(data, holdout);
+        } else if (m_sample == "random") {
+            // Choose N instances at random.
+            for (size_t i = 0;i < data.size();++i) {
+                const_iterator it = random_sample(data.begin(), data.end(), m_random);
+                if (it->get_group() != holdout) {
+                    m_trainer.update(it);
+                }
+            }
+        } else if (m_sample == "cycle") {
+            // Do not change the ordering of instances.
+            for (const_iterator it = data.begin();it != data.end();++it) {
+                if (it->get_group() != holdout) {
+                    m_trainer.update(it);
+                }
+            }
+        } else if (m_sample == "shuffle") {
+            // Shuffle N instances first.
+            std::vector<const_iterator> perm(data.size());
+            shuffle_permutation(perm, data.begin(), data.end(), m_random);
+            for (size_t i = 0;i < perm.size();++i) {
+                const_iterator it = perm[i];
+                if (it->get_group() != holdout) {
+                    m_trainer.update(it);
+                }
+            }
+        } else {
+            throw invalid_parameter("Unknown sampling method for instances");
+        }
+    }
+
+    /**
+     * Sends the instances of an epoch to the algorithm in minibatches.
+     *  @param  data        The data set for training.
+     *  @param  holdout     The group number for holdout evaluation.
+     */
+    void update_batches(const data_type& data, int holdout)
+    {
+        const size_t B = (size_t)m_trainer.batch_size();
+        std::vector<const_iterator> perm;
+        sample_instances(perm, data, m_sample, holdout, m_random);
+
+        for (size_t i = 0;i < perm.size();i += B) {
+            size_t n = std::min(B, perm.size() - i);
+            m_trainer.update_batch(perm.begin() + i, perm.begin() + i + n);
+        }
+    }
+
+    /**
+     * Sends the instances of an epoch to the workers running in parallel.
+     *  The workers update the weight vector of m_trainer without locks, and
+     *  their states are merged into m_trainer at the end of the epoch.
+     *  @param  data        The data set for training.
+     *  @param  holdout     The group number for holdout evaluation.
+     */
+    void update_parallel(const data_type& data, int holdout)
+    {
+        const int T = m_num_threads;
+        std::vector<const_iterator> perm;
+        sample_instances(perm, data, m_sample, holdout, m_random);
+
+        // Assign the instances #i, #i+T, ... to the worker #i.
+        while ((int)m_workers.size() < T) {
+            m_workers.push_back(new trainer_type);
+        }
+        std::vector<update_task> tasks(T);
+        for (int i = 0;i < T;++i) {
+            m_workers[i]->start_worker(m_trainer, i, T);
+            tasks[i].trainer = m_workers[i];
+            tasks[i].perm = &perm;
+            tasks[i].first = i;
+            tasks[i].stride = T;
+        }
+
+        run_tasks(tasks);
+        m_trainer.merge_workers(m_workers.begin(), m_workers.begin() + T);
+    }
 };
 
 
@@ -368,12 +1016,87 @@ protected:
     int m_period;
     /// The epsilon for improvement ratio.
     value_type m_epsilon;
+    /// The number of threads.
+    int m_num_threads;
+    /// The weights for mixing the models of the ranks.
+    std::string m_mixing;
+    /// The collective operation of distributed training (or NULL).
+    allreduce* m_allreduce;
+    /// The initial weights (empty for training from zero weights).
+    model_type m_init;
+    /// The writer of training metrics (NULL for no metrics).
+    metrics* m_metrics;
+    /// The settings of holdout evaluations.
+    holdout_options m_holdout_options;
+    /// The checkpoint of the training process (or NULL).
+    checkpoint* m_checkpoint;
+    /// The generator of random numbers for sampling instances.
+    random_generator m_random;
+
+    /// The wall-clock time at the start of the iteration.
+    double m_clk;
+    /// The CPU time at the start of the iteration.
+    double m_cpu;
+    /// The seconds spent updating the model with the instances.
+    double m_time_update;
+    /// The seconds spent mixing the models of the ranks.
+    double m_time_mixing;
+    /// The seconds of the iteration excluding the holdout evaluation.
+    double m_time_iteration;
+    /// The CPU seconds of the iteration excluding the holdout evaluation.
+    double m_time_cpu;
+    /// The loss of the iteration.
+    value_type m_loss;
+    /// The number of instances sent to the algorithm in the iteration.
+    double m_num_instances;
+    /// The number of elements of the instances sent in the iteration.
+    double m_num_elements;
+
+    /// The workers for parallel training.
+    std::vector<trainer_type*> m_workers;
+
+    /// A task sending a partition of instances to a worker.
+    struct update_task
+    {
+        /// The worker.
+        trainer_type* trainer;
+        /// The feature generator.
+        typename data_type::feature_generator_type* fgen;
+        /// The instances in the epoch.
+        const std::vector<const_iterator>* perm;
+        /// The index of the first instance for the worker.
+        size_t first;
+        /// The interval of the instances for the worker.
+        size_t stride;
+
+        void run()
+        {
+            const size_t B = (size_t)trainer->batch_size();
+            if (1 < B) {
+                // Send the minibatches of the instances for the worker.
+                std::vector<const_iterator> batch;
+                for (size_t i = first;i < perm->size();i += stride) {
+                    batch.push_back((*perm)[i]);
+                    if (batch.size() == B) {
+                        trainer->update_batch(batch.begin(), batch.end(), *fgen);
+                        batch.clear();
+                    }
+                }
+                trainer->update_batch(batch.begin(), batch.end(), *fgen);
+            } else {
+                for (size_t i = first;i < perm->size();i += stride) {
+                    trainer->update((*perm)[i], *fgen);
+                }
+            }
+        }
+    };
 
 public:
     /**
      * Constructs the object.
      */
-    online_scheduler_multi()
+    online_scheduler_multi() :
+        m_allreduce(NULL), m_metrics(NULL), m_checkpoint(NULL)
     {
         clear();
     }
@@ -383,6 +1106,9 @@ public:
      */
     virtual ~online_scheduler_multi()
     {
+        for (size_t i = 0;i < m_workers.size();++i) {
+            delete m_workers[i];
+        }
     }
 
     /**
@@ -403,6 +1129,13 @@ public:
             "The period to measure the improvement ratio");
         par.init("epsilon", &m_epsilon, 1e-6,
             "The stopping criterion for the improvement ratio");
+        par.init("num_threads", &m_num_threads, 1,
+            "The number of threads updating the weight vector without locks (Hogwild!);\n"
+            "the thread #i receives the instances #i, #i + ${num_threads}, ... in an epoch.");
+        par.init("mixing", &m_mixing, "uniform",
+            "The weights for averaging the models of the ranks after every epoch of\n"
+            "distributed training (iterative parameter mixing):\n"
+            "{'uniform': the same weights, 'updates': the numbers of the updates of the ranks}");
     }
 
     /**
@@ -425,6 +1158,86 @@ public:
         return m_trainer.model();
     }
 
+    /**
+     * Returns the memory used by the training algorithm.
+     *  @return size_t      The approximate number of bytes, including the
+     *                      states of the worker threads.
+     */
+    size_t memory_usage() const
+    {
+        size_t bytes = m_trainer.memory_usage() + m_init.size() * sizeof(value_type);
+        for (size_t i = 0;i < m_workers.size();++i) {
+            bytes += m_workers[i]->memory_usage();
+        }
+        return bytes;
+    }
+
+    /**
+     * Sets the collective operation of distributed training.
+     *  Every rank trains the model on the data set of its own in an epoch,
+     *  and the ranks replace their models with the weighted average of them
+     *  at the end of the epoch.
+     *  @param  ar          The collective operation over the ranks, or
+     *                      \c NULL for training in a single process.
+     */
+    void set_allreduce(allreduce* ar)
+    {
+        m_allreduce = ar;
+    }
+
+    /**
+     * Sets the weights from which the training starts.
+     *  @param  w           The initial weights storing the weights for all
+     *                      features of the data set.
+     */
+    void set_initial_weights(const model_type& w)
+    {
+        m_init = w;
+    }
+
+    /**
+     * Sets the writer of training metrics.
+     *  Every iteration writes a record with the wall-clock and CPU times,
+     *  the times of the phases (the updates, the mixing of the models over
+     *  the ranks, and the holdout evaluation), and the throughput of the
+     *  updates in instances and elements.
+     *  @param  m           The writer, or \c NULL for no metrics.
+     */
+    void set_metrics(metrics* m)
+    {
+        m_metrics = m;
+    }
+
+    /**
+     * Sets the settings of holdout evaluations.
+     *  The holdout instances are listed once before training (a random
+     *  subset of them with a sample size), and evaluated by multiple
+     *  threads after every interval-th iteration. Training on a stream
+     *  ignores the sample size, and lists the holdout instances of every
+     *  block.
+     *  @param  ho          The settings.
+     */
+    void set_holdout_options(const holdout_options& ho)
+    {
+        m_holdout_options = ho;
+    }
+
+    /**
+     * Sets the checkpoint of the training process.
+     *  The state of the training algorithm, the recent losses, and the
+     *  iteration number are stored after every interval-th iteration of
+     *  train(). When the training resumes, train() restores the state
+     *  stored last and replays the random numbers drawn by the completed
+     *  iterations for sampling the instances, so that the training
+     *  continues as if it had not stopped (except for parallel training,
+     *  whose updates are not deterministic).
+     *  @param  cp          The checkpoint, or \c NULL for no checkpoint.
+     */
+    void set_checkpoint(checkpoint* cp)
+    {
+        m_checkpoint = cp;
+    }
+
     /**
      * Trains a model on a data set.
      *  @param  data        The data set for training (and holdout evaluation).
@@ -445,9 +1258,16 @@ public:
         // Ring buffer for moving averages.
         std::vector<value_type> pf(m_period);
 
-        // Set the number of instances for the target algorithm.
+        // Set the number of instances (of all ranks) for the target algorithm.
         parameter_exchange& par = this->params();
-        par.set("n", (double)data.size(), false);
+        double n = (double)data.size();
+        if (m_allreduce != NULL) {
+            m_allreduce->sum(&n, 1);
+        }
+        par.set("n", n, false);
+
+        // The weight of this rank for mixing the models.
+        value_type weight = this->mixing_weight(data, holdout);
 
         // Reserve the weight vector.
         m_trainer.set_num_features(data.num_features());
@@ -457,102 +1277,184 @@ public:
         m_trainer.params().show(os);
         os << std::endl;
 
+        // Draw the random numbers of a fold trained concurrently with the
+        // others from the sequence of its holdout group.
+        if (m_holdout_options.fold_random) {
+            m_random.seed((unsigned int)holdout);
+        } else {
+            m_random.share();
+        }
+
         // Initialize the training algorithm.
         m_trainer.start();
+        if (!m_init.empty()) {
+            m_trainer.set_weights(m_init);
+        }
+        count_training(data, holdout, m_num_instances, m_num_elements);
+        std::vector<const_iterator> index;
+        holdout_instances(
+            index, data.begin(), data.end(), holdout, m_holdout_options.sample);
+        const int k0 = this->resume_checkpoint(data, holdout, pf, os);
 
         // Loop for iterations.
-        for (int k = 1;k <= m_max_iterations;++k) {
-            value_type loss = 0;
-            value_type avg = 0, var = 0, nvar = m_epsilon;
-            clock_t clk = std::clock();
+        for (int k = k0 + 1;k <= m_max_iterations;++k) {
+            this->start_iteration();
 
             // Send instances to the algorithm.
-            if (m_sample == "random") {
-                // Choose N instances at random.
-                for (size_t i = 0;i < data.size();++i) {
-                    const_iterator it = random_sample(data.begin(), data.end());
-                    if (it->get_group() != holdout) {
-                        m_trainer.update(
-                            it, const_cast<data_type&>(data).feature_generator);
-                    }
-                }
-            } else if (m_sample == "cycle") {
-                // Do not change the ordering of instances.
-                for (const_iterator it = data.begin();it != data.end();++it) {
-                    if (it->get_group() != holdout) {
-                        m_trainer.update(
-                            it, const_cast<data_type&>(data).feature_generator);
-                    }
-                }
-            } else if (m_sample == "shuffle") {
-                // Shuffle N instances first.
-                std::vector<const_iterator> perm(data.size());
-                shuffle_permutation(perm, data.begin(), data.end());
-                for (size_t i = 0;i < perm.size();++i) {
-                    const_iterator it = perm[i];
-                    if (it->get_group() != holdout) {
-                        m_trainer.update(
-                            it, const_cast<data_type&>(data).feature_generator);
-                    }
-                }
-            } else {
-                throw invalid_parameter("Unknown sampling method for instances");
+            this->update_instances(data, holdout);
+            m_time_update = wall_clock() - m_clk;
+            if (m_allreduce != NULL) {
+                const double clk = wall_clock();
+                m_trainer.mix(*m_allreduce, weight);
+                m_time_mixing = wall_clock() - clk;
             }
-
-            // Pause the training process, and compute the loss.
-            m_trainer.discontinue();
-            loss = m_trainer.loss();
-
-            // Store the current loss to the ring buffer
-            pf[(k-1) % m_period] = loss;
-            if (m_period < k) {
-                // Compute the average and variance of the recent losses.
-                avg = std::accumulate(pf.begin(), pf.end(), 0.) / pf.size();
-                var = compute_variance(pf.begin(), pf.end(), avg);
-                // nvar = var / min(1, fabs(loss))
-                nvar = fabs(loss);
-                if (1. < nvar) {
-                    nvar = var / nvar;
-                } else {
-                    nvar = var;
-                }
-            }
-
-            // Report the progress.
-            os << "***** Iteration #" << k << " *****" << std::endl;
-            m_trainer.report(os);
-            if (m_period < k) {
-                os << "Loss variance: " << nvar << std::endl;
-            }
-            os << "Seconds required for this iteration: " <<
-                (std::clock() - clk) / (double)CLOCKS_PER_SEC << std::endl;
+            value_type nvar = this->report_iteration(k, pf, os);
 
             // Holdout evaluation if necessary.
-            if (0 <= holdout) {
+            const double clk = wall_clock();
+            if (0 <= holdout && m_holdout_options.scheduled(k, k == m_max_iterations)) {
                 error_type cla(m_trainer.model());
                 holdout_evaluation_multi(
                     os,
-                    data.begin(),
-                    data.end(),
+                    index,
                     cla,
                     data.feature_generator,
-                    holdout,
                     acconly,
+                    m_holdout_options.num_threads,
                     data.labels,
                     data.positive_labels.begin(),
                     data.positive_labels.end()
                     );
             }
 
-            // Flush the output stream.
-            os << std::endl;
-            os.flush();
+            this->write_metrics(k, holdout, wall_clock() - clk);
+
+            if (this->stop_iteration(nvar, os)) {
+                break;
+            }
+            this->save_checkpoint(k, pf);
+        }
+
+        // Finalize the training procedure.
+        if (m_checkpoint != NULL) {
+            m_checkpoint->wait();
+        }
+        m_trainer.finish();
+    }
+
+    /**
+     * Trains a model on a stream of data blocks.
+     *
+     *  This function makes repeated passes over a data set that does not
+     *  fit in memory. A source object (e.g., a reader of a data cache on a
+     *  disk) loads a block of instances at a time into a data set, and the
+     *  instances in a block are sent to the training algorithm as in
+     *  train(); with the "shuffle" sampling, the source reads the blocks in
+     *  a random order and the instances are shuffled within each block. The
+     *  holdout evaluation runs another pass over the stream after every
+     *  iteration. A source object must implement the following functions:
+     *      - size_t size() const: returns the number of instances;
+     *      - const data_type& data() const: returns the data set to which
+     *        blocks are loaded (with the numbers of features and labels);
+     *      - void rewind(bool shuffle): starts a pass over the stream (in a
+     *        random order of blocks if \c shuffle is \c true);
+     *      - const data_type* next(): loads the next block and returns the
+     *        data set holding it, or \c NULL at the end of the pass.
+     *
+     *  @param  source      The source of data blocks.
+     *  @param  os          The output stream for progress reports.
+     *  @param  holdout     The group number for holdout evaluation. Specify
+     *                      a negative value if a holdout evaluation is
+     *                      unnecessary.
+     *  @param  acconly     The flag indicating whether precision, recall, and
+     *                      F1 scores are unnecessary.
+     */
+    template <class source_type>
+    void train_stream(
+        source_type& source,
+        std::ostream& os,
+        int holdout = -1,
+        bool acconly = true
+        )
+    {
+        const data_type& data = source.data();
+
+        // Ring buffer for moving averages.
+        std::vector<value_type> pf(m_period);
+
+        // Set the number of instances for the target algorithm.
+        parameter_exchange& par = this->params();
+        par.set("n", (double)source.size(), false);
+
+        // Reserve the weight vector.
+        m_trainer.set_num_features(data.num_features());
+
+        // Show the algorithm name and parameters.
+        m_trainer.copyright(os);
+        m_trainer.params().show(os);
+        os << std::endl;
+
+        // Draw the random numbers of a fold trained concurrently with the
+        // others from the sequence of its holdout group.
+        if (m_holdout_options.fold_random) {
+            m_random.seed((unsigned int)holdout);
+        } else {
+            m_random.share();
+        }
+
+        // Initialize the training algorithm.
+        m_trainer.start();
+
+        // Loop for iterations.
+        for (int k = 1;k <= m_max_iterations;++k) {
+            this->start_iteration();
+            m_num_instances = 0.;
+            m_num_elements = 0.;
 
-            // Terminate if the stopping criterion is satisfied.
-            if (nvar < m_epsilon) {
-                os << "Terminated with the stopping criterion" << std::endl;
-                os << std::endl;
-                os.flush();
+            // Send the instances of every block to the algorithm.
+            source.rewind(m_sample == "shuffle");
+            for (const data_type* block = source.next();block != NULL;block = source.next()) {
+                this->update_instances(*block, holdout);
+                if (m_metrics != NULL) {
+                    double n, e;
+                    count_training(*block, holdout, n, e);
+                    m_num_instances += n;
+                    m_num_elements += e;
+                }
+            }
+            m_time_update = wall_clock() - m_clk;
+            value_type nvar = this->report_iteration(k, pf, os);
+
+            // Holdout evaluation if necessary.
+            const double clk = wall_clock();
+            if (0 <= holdout && m_holdout_options.scheduled(k, k == m_max_iterations)) {
+                error_type cla(m_trainer.model());
+                accuracy acc;
+                precall pr(data.feature_generator.num_labels());
+                std::vector<const_iterator> index;
+                source.rewind(false);
+                for (const data_type* block = source.next();block != NULL;block = source.next()) {
+                    holdout_instances(index, block->begin(), block->end(), holdout);
+                    holdout_count_multi(
+                        index, cla, block->feature_generator, acconly,
+                        m_holdout_options.num_threads, acc, pr);
+                }
+
+                // Report accuracy, precision, recall, and f1 score.
+                acc.output(os);
+                if (!acconly) {
+                    pr.output_labelwise(os, data.labels,
+                        data.positive_labels.begin(), data.positive_labels.end());
+                    pr.output_micro(os,
+                        data.positive_labels.begin(), data.positive_labels.end());
+                    pr.output_macro(os,
+                        data.positive_labels.begin(), data.positive_labels.end());
+                }
+            }
+
+            this->write_metrics(k, holdout, wall_clock() - clk);
+
+            if (this->stop_iteration(nvar, os)) {
                 break;
             }
         }
@@ -560,6 +1462,288 @@ public:
         // Finalize the training procedure.
         m_trainer.finish();
     }
+
+protected:
+    /**
+     * Computes the weight of this rank for mixing the models.
+     *  @param  data        The data set for training.
+     *  @param  holdout     The group number for holdout evaluation.
+     *  @return value_type  The weight of the model of this rank.
+     */
+    value_type mixing_weight(const data_type& data, int holdout)
+    {
+        if (m_mixing == "uniform") {
+            return 1.;
+        } else if (m_mixing == "updates") {
+            // An epoch updates the model with every training instance.
+            int n = 0;
+            for (const_iterator it = data.begin();it != data.end();++it) {
+                if (it->get_group() != holdout) {
+                    ++n;
+                }
+            }
+            return (value_type)n;
+        } else {
+            throw invalid_parameter("Unknown mixing method for distributed training");
+        }
+    }
+
+    /**
+     * Starts the clocks of an iteration.
+     */
+    void start_iteration()
+    {
+        m_clk = wall_clock();
+        m_cpu = cpu_clock();
+        m_time_update = 0.;
+        m_time_mixing = 0.;
+    }
+
+    /**
+     * Finishes an iteration: computes the loss and reports the progress.
+     *  @param  k           The iteration number.
+     *  @param  pf          The ring buffer of recent losses.
+     *  @param  os          The output stream for progress reports.
+     *  @return value_type  The variance of the recent losses.
+     */
+    value_type report_iteration(
+        int k, std::vector<value_type>& pf, std::ostream& os)
+    {
+        value_type loss = 0;
+        value_type avg = 0, var = 0, nvar = m_epsilon;
+
+        // Pause the training process, and compute the loss.
+        m_trainer.discontinue();
+        loss = m_trainer.loss();
+
+        // Store the current loss to the ring buffer
+        pf[(k-1) % m_period] = m_loss = loss;
+        if (m_period < k) {
+            // Compute the average and variance of the recent losses.
+            avg = std::accumulate(pf.begin(), pf.end(), 0.) / pf.size();
+            var = compute_variance(pf.begin(), pf.end(), avg);
+            // nvar = var / min(1, fabs(loss))
+            nvar = fabs(loss);
+            if (1. < nvar) {
+                nvar = var / nvar;
+            } else {
+                nvar = var;
+            }
+        }
+
+        // Report the progress.
+        os << "***** Iteration #" << k << " *****" << std::endl;
+        m_trainer.report(os);
+        if (m_period < k) {
+            os << "Loss variance: " << nvar << std::endl;
+        }
+        m_time_iteration = wall_clock() - m_clk;
+        m_time_cpu = cpu_clock() - m_cpu;
+        os << "Seconds required for this iteration: " << m_time_iteration << std::endl;
+        return nvar;
+    }
+
+    /**
+     * Writes the metrics of an iteration.
+     *  @param  k           The iteration number.
+     *  @param  holdout     The group number for holdout evaluation.
+     *  @param  seconds     The seconds of the holdout evaluation.
+     */
+    void write_metrics(int k, int holdout, double seconds)
+    {
+        if (m_metrics == NULL) {
+            return;
+        }
+
+        const double t = m_time_update;
+        metrics_record rec("iteration");
+        rec.add("solver", "online");
+        rec.add("holdout", holdout);
+        rec.add("iteration", k);
+        rec.add("loss", (double)m_loss);
+        rec.add("seconds", m_time_iteration);
+        rec.add("cpu_seconds", m_time_cpu);
+        rec.add("update_seconds", m_time_update);
+        rec.add("mixing_seconds", m_time_mixing);
+        rec.add("holdout_seconds", seconds);
+        rec.add("instances_per_second", 0. < t ? m_num_instances / t : 0.);
+        rec.add("nnz_per_second", 0. < t ? m_num_elements / t : 0.);
+        m_metrics->write(rec);
+    }
+
+    /**
+     * Restores the state stored last by the checkpoint.
+     *  @param  data        The data set for training.
+     *  @param  holdout     The group number for holdout evaluation.
+     *  @param  pf          The ring buffer of recent losses.
+     *  @param  os          The output stream for progress reports.
+     *  @return int         The number of the completed iterations (zero if
+     *                      the training does not resume).
+     */
+    int resume_checkpoint(
+        const data_type& data, int holdout,
+        std::vector<value_type>& pf, std::ostream& os)
+    {
+        std::string state;
+        if (m_checkpoint == NULL || !m_checkpoint->load("online", state)) {
+            return 0;
+        }
+
+        int k;
+        checkpoint_reader ar(state);
+        ar.value(k);
+        ar.vector(pf);
+        m_trainer.serialize(ar);
+        if (!ar.eof() || (int)pf.size() != m_period) {
+            throw checkpoint_error("A checkpoint has an inconsistent state");
+        }
+
+        // Draw the random numbers of the completed iterations.
+        std::vector<const_iterator> perm;
+        for (int i = 0;i < k;++i) {
+            sample_instances(perm, data, m_sample, holdout, m_random);
+        }
+
+        os << "Resumed from the checkpoint of iteration #" << k << std::endl;
+        os << std::endl;
+        return k;
+    }
+
+    /**
+     * Stores the state at the end of an iteration if scheduled.
+     *  @param  k           The iteration number.
+     *  @param  pf          The ring buffer of recent losses.
+     */
+    void save_checkpoint(int k, const std::vector<value_type>& pf)
+    {
+        if (m_checkpoint != NULL && m_checkpoint->scheduled(k)) {
+            checkpoint_writer ar;
+            ar.value(k);
+            ar.vector(pf);
+            m_trainer.serialize(ar);
+            m_checkpoint->save("online", ar);
+        }
+    }
+
+    /**
+     * Tests the stopping criterion at the end of an iteration.
+     *  @param  nvar        The variance of the recent losses.
+     *  @param  os          The output stream for progress reports.
+     *  @return bool        \c true if the training should terminate.
+     */
+    bool stop_iteration(value_type nvar, std::ostream& os)
+    {
+        // Flush the output stream.
+        os << std::endl;
+        os.flush();
+
+        // Terminate if the stopping criterion is satisfied.
+        if (nvar < m_epsilon) {
+            os << "Terminated with the stopping criterion" << std::endl;
+            os << std::endl;
+            os.flush();
+            return true;
+        }
+        return false;
+    }
+
+    /**
+     * Sends the instances of a data set to the algorithm (an epoch).
+     *  @param  data        The data set for training.
+     *  @param  holdout     The group number for holdout evaluation.
+     */
+    void update_instances(const data_type& data, int holdout)
+    {
+        if (1 < m_num_threads) {
+            // Send instances to the workers running in parallel.
+            this->update_parallel(data, holdout);
+        } else if (1 < m_trainer.batch_size()) {
+            // Send minibatches of instances.
+            this->update_batches(data, holdout);
+        } else if (m_sample == "random") {
+            // Choose N instances at random.
+            for (size_t i = 0;i < data.size();++i) {
+                const_iterator it = random_sample(data.begin(), data.end(), m_random);
+                if (it->get_group() != holdout) {
+                    m_trainer.update(
+                        it, const_cast<data_type&>(data).feature_generator);
+                }
+            }
+        } else if (m_sample == "cycle") {
+            // Do not change the ordering of instances.
+            for (const_iterator it = data.begin();it != data.end();++it) {
+                if (it->get_group() != holdout) {
+                    m_trainer.update(
+                        it, const_cast<data_type&>(data).feature_generator);
+                }
+            }
+        } else if (m_sample == "shuffle") {
+            // Shuffle N instances first.
+            std::vector<const_iterator> perm(data.size());
+            shuffle_permutation(perm, data.begin(), data.end(), m_random);
+            for (size_t i = 0;i < perm.size();++i) {
+                const_iterator it = perm[i];
+                if (it->get_group() != holdout) {
+                    m_trainer.update(
+                        it, const_cast<data_type&>(data).feature_generator);
+                }
+            }
+        } else {
+            throw invalid_parameter("Unknown sampling method for instances");
+        }
+    }
+
+    /**
+     * Sends the instances of an epoch to the algorithm in minibatches.
+     *  @param  data        The data set for training.
+     *  @param  holdout     The group number for holdout evaluation.
+     */
+    void update_batches(const data_type& data, int holdout)
+    {
+        const size_t B = (size_t)m_trainer.batch_size();
+        std::vector<const_iterator> perm;
+        sample_instances(perm, data, m_sample, holdout, m_random);
+
+        for (size_t i = 0;i < perm.size();i += B) {
+            size_t n = std::min(B, perm.size() - i);
+            m_trainer.update_batch(
+                perm.begin() + i,
+                perm.begin() + i + n,
+                const_cast<data_type&>(data).feature_generator
+                );
+        }
+    }
+
+    /**
+     * Sends the instances of an epoch to the workers running in parallel.
+     *  The workers update the weight vector of m_trainer without locks, and
+     *  their states are merged into m_trainer at the end of the epoch.
+     *  @param  data        The data set for training.
+     *  @param  holdout     The group number for holdout evaluation.
+     */
+    void update_parallel(const data_type& data, int holdout)
+    {
+        const int T = m_num_threads;
+        std::vector<const_iterator> perm;
+        sample_instances(perm, data, m_sample, holdout, m_random);
+
+        // Assign the instances #i, #i+T, ... to the worker #i.
+        while ((int)m_workers.size() < T) {
+            m_workers.push_back(new trainer_type);
+        }
+        std::vector<update_task> tasks(T);
+        for (int i = 0;i < T;++i) {
+            m_workers[i]->start_worker(m_trainer, i, T);
+            tasks[i].trainer = m_workers[i];
+            tasks[i].fgen = &const_cast<data_type&>(data).feature_generator;
+            tasks[i].perm = &perm;
+            tasks[i].first = i;
+            tasks[i].stride = T;
+        }
+
+        run_tasks(tasks);
+        m_trainer.merge_workers(m_workers.begin(), m_workers.begin() + T);
+    }
 };
 
 };
@@ -34,8 +34,12 @@
 #define __CLASSIAS_TRAIN_PEGASOS_H__
 
 #include <iostream>
+#include <iterator>
+#include <vector>
 
 #include <classias/types.h>
+#include <classias/allreduce.h>
+#include <classias/csr_data.h>
 #include <classias/parameters.h>
 
 namespace classias
@@ -106,6 +110,15 @@ protected:
     /// The update count.
     value_type m_t;
 
+    /// The weight vector updated by update() (m_model, or that of the master).
+    model_type* m_pmodel;
+    /// The increment of the update count (the number of workers).
+    int m_stride;
+    /// The update count of the previous update by this worker.
+    value_type m_tprev;
+    /// The errors of the instances (and candidates) in a minibatch.
+    std::vector<value_type> m_errors;
+
     /// Parameter interface.
     parameter_exchange m_params;
     /// The coefficient for L2 regularization.
@@ -114,12 +127,16 @@ protected:
     value_type m_n;
     /// The initial learning rate.
     value_type m_eta0;
+    /// The number of instances in a minibatch.
+    int m_batch_size;
+    /// The flag for averaging the gradients in a minibatch.
+    int m_batch_average;
 
 public:
     /**
      * Constructs the object.
      */
-    pegasos_base()
+    pegasos_base() : m_pmodel(&m_model), m_stride(1), m_tprev(0)
     {
         clear();
     }
@@ -147,6 +164,12 @@ public:
             "The number of instances in the data set.");
         m_params.init("eta", &m_eta0, 0.1,
             "Initial learning rate");
+        m_params.init("batch_size", &m_batch_size, 1,
+            "The number of instances whose errors are computed on the same weights\n"
+            "before their gradients are applied in a merged update (minibatch).");
+        m_params.init("batch_average", &m_batch_average, 0,
+            "Apply the average of the gradients in a minibatch as an update (1),\n"
+            "instead of the sum of them as the updates of the instances (0).");
     }
 
     /**
@@ -160,6 +183,15 @@ public:
         this->initialize_weights();
     }
 
+    /**
+     * Returns the number of instances in a minibatch.
+     *  @return int         The number of instances in a minibatch.
+     */
+    int batch_size() const
+    {
+        return m_batch_size;
+    }
+
 public:
     /**
      * Starts a training process.
@@ -199,6 +231,120 @@ public:
         m_loss = 0;
     }
 
+    /**
+     * Prepares this object as a worker of lock-free parallel training.
+     *
+     *  A worker applies updates directly to the weight vector of the master
+     *  without locks. The update count of a worker advances by the number
+     *  of workers so that the worker #index receives the update counts of
+     *  the instances #index, #index + num_workers, ... in the epoch. Since
+     *  the decay factor is determined by the update count, every worker
+     *  keeps its own decay and scaling factors that cover the updates of
+     *  the other workers. The projection within the L2 ball, which needs
+     *  the norm of the shared weights, is postponed to merge_workers().
+     *
+     *  @param  master      The master trainer holding the weight vector.
+     *  @param  index       The index of this worker.
+     *  @param  num_workers The number of workers.
+     */
+    void start_worker(this_class& master, int index, int num_workers)
+    {
+        m_pmodel = master.m_pmodel;
+        m_lambda = master.m_lambda;
+        m_norm22 = master.m_norm22;
+        m_decay = master.m_decay;
+        m_proj = master.m_proj;
+        m_scale = master.m_scale;
+        m_eta = master.m_eta;
+        m_t0 = master.m_t0;
+        m_t = master.m_t + index;
+        m_tprev = master.m_t - 1;
+        m_stride = num_workers;
+        m_batch_size = master.m_batch_size;
+        m_batch_average = master.m_batch_average;
+        m_loss = 0;
+    }
+
+    /**
+     * Merges the states of workers at the end of an epoch.
+     *  @param  first       The iterator pointing to the first worker.
+     *  @param  last        The iterator pointing just beyond the last worker.
+     */
+    template <class iterator_type>
+    void merge_workers(iterator_type first, iterator_type last)
+    {
+        value_type t = m_t;
+        for (iterator_type it = first;it != last;++it) {
+            const this_class& worker = **it;
+            m_loss += worker.m_loss;
+
+            // The update count next to the last update of the worker.
+            if (t < worker.m_t - worker.m_stride + 1) {
+                t = worker.m_t - worker.m_stride + 1;
+            }
+        }
+
+        // Apply the decay factors of the updates [m_t, t).
+        if (m_t < t && 0 < m_t0 + m_t - 1) {
+            m_decay *= (m_t0 + m_t - 1) / (m_t0 + t - 1);
+            m_eta = 1. / (m_lambda * (m_t0 + t - 1));
+        }
+        m_t = t;
+        m_scale = m_decay * m_proj;
+        this->rescale_weights();
+
+        // Project the weight vector within an L2 ball.
+        if (1 < m_lambda * m_norm22) {
+            m_proj = 1.0 / std::sqrt(m_lambda * m_norm22);
+            m_scale = m_decay * m_proj;
+        }
+    }
+
+    /**
+     * Sets the weights from which the training starts.
+     *  This function must be called after start().
+     *  @param  w           The initial weights.
+     */
+    void set_weights(const model_type& w)
+    {
+        this->rescale_weights();
+        m_norm22 = 0;
+        for (size_t i = 0;i < m_model.size() && i < w.size();++i) {
+            m_model[i] = w[i];
+            m_norm22 += (m_model[i] * m_model[i]);
+        }
+    }
+
+    /**
+     * Mixes the weight vectors of the ranks of distributed training.
+     *  This function replaces the weights of every rank with the weighted
+     *  average of them over the ranks (iterative parameter mixing), and
+     *  sums the losses of the epoch over the ranks. The average stays
+     *  within the L2 ball containing the weights of the ranks.
+     *  @param  ar          The collective operation over the ranks.
+     *  @param  weight      The mixing weight of this rank.
+     */
+    void mix(allreduce& ar, value_type weight)
+    {
+        this->rescale_weights();
+
+        const size_t n = m_model.size();
+        std::vector<double> v(n + 2);
+        for (size_t i = 0;i < n;++i) {
+            v[i] = weight * m_model[i];
+        }
+        v[n] = weight;
+        v[n+1] = m_loss;
+        ar.sum(&v[0], n + 2);
+
+        m_norm22 = 0;
+        for (size_t i = 0;i < n;++i) {
+            m_model[i] = v[i] / v[n];
+            m_norm22 += (m_model[i] * m_model[i]);
+        }
+        m_loss = v[n+1];
+    }
+
 public:
     /**
      * Shows the copyright information.
@@ -237,8 +383,9 @@ protected:
      */
     void initialize_weights()
     {
-        for (size_t i = 0;i < m_model.size();++i) {
-            m_model[i] = 0.;
+        model_type& model = *m_pmodel;
+        for (size_t i = 0;i < model.size();++i) {
+            model[i] = 0.;
         }
         m_norm22 = 0;
         m_decay = 1;
@@ -246,6 +393,57 @@ protected:
         m_scale = 1;
     }
 
+    /**
+     * Applies the decay factors of the update counts of a minibatch.
+     *
+     *  The sum of the gradients in a minibatch takes the update counts of
+     *  the instances, [t, tlast], and the average of them takes one count
+     *  (tlast = t). Since (1 - eta * lambda) = (t0 + u - 1) / (t0 + u) for
+     *  the update count u, the product of the decay factors of the counts
+     *  telescopes to (t0 + t - 1) / (t0 + tlast). The gradient applied at
+     *  the count u and decayed by the following counts of the minibatch
+     *  is thus multiplied by the learning rate of the last count, eta(tlast),
+     *  for any u.
+     *
+     *  @param  tlast       The update count of the last update.
+     *  @return value_type  The gain multiplied by the gradients for V.
+     */
+    value_type decay_batch(value_type tlast)
+    {
+        m_eta = 1. / (m_lambda * (m_t0 + tlast));
+        if (m_stride == 1) {
+            m_decay *= (m_t0 + m_t - 1) / (m_t0 + tlast);
+        } else {
+            // Apply the decay factors of the updates by the other workers
+            // since the previous update of this worker as well.
+            m_decay *= (m_t0 + m_tprev) / (m_t0 + tlast);
+            m_tprev = tlast;
+        }
+        m_scale = m_decay * m_proj;
+
+        if (0 < m_decay) {
+            return m_eta / m_scale;
+        } else {
+            // decay = 0 implies that W should be initialized to 0.
+            this->initialize_weights();
+            return 1;
+        }
+    }
+
+    /**
+     * Projects the weight vector within an L2 ball after a minibatch, and
+     * advances the update count.
+     *  @param  tlast       The update count of the last update.
+     */
+    void finish_batch(value_type tlast)
+    {
+        if (m_stride == 1 && 1 < m_lambda * m_norm22 * m_scale * m_scale) {
+            m_proj = 1.0 / (std::sqrt(m_lambda * m_norm22) * m_scale);
+            m_scale = m_decay * m_proj;
+        }
+        m_t = tlast + m_stride;
+    }
+
     /**
      * Finalizes the weight vector.
      *  This function computes the actual weight vector W from the internal
@@ -299,6 +497,36 @@ public:
         return const_cast<this_class*>(this)->model();
     }
 
+    /**
+     * Returns the memory used by the training algorithm.
+     *  @return size_t      The approximate number of bytes.
+     */
+    size_t memory_usage() const
+    {
+        return
+            m_model.size() * sizeof(value_type) +
+            classias::memory_usage(m_errors);
+    }
+
+    /**
+     * Stores or restores the state of the training process.
+     *  @param  ar          The archive (checkpoint_writer or
+     *                      checkpoint_reader).
+     */
+    template <class archive_type>
+    void serialize(archive_type& ar)
+    {
+        ar.vector(m_model);
+        ar.value(m_norm22);
+        ar.value(m_decay);
+        ar.value(m_proj);
+        ar.value(m_scale);
+        ar.value(m_eta);
+        ar.value(m_loss);
+        ar.value(m_t);
+        ar.value(m_tprev);
+    }
+
     value_type loss() const
     {
         return m_report.loss;
@@ -340,7 +568,7 @@ public:
     void update(iterator_type it)
     {
         // Define synonyms to avoid using "this->" for member variables.
-        model_type& model = this->m_model;
+        model_type& model = *this->m_pmodel;
         value_type& eta = this->m_eta;
         value_type& lambda = this->m_lambda;
         value_type& decay = this->m_decay;
@@ -367,7 +595,14 @@ public:
         // let W = (decay * proj) * V and remember the products of
         // decay factors. This avoids an O(K) computation for every
         // updates.
-        decay *= (1. - eta * lambda);
+        if (this->m_stride == 1) {
+            decay *= (1. - eta * lambda);
+        } else {
+            // Apply the decay factors of the updates by the other workers
+            // since the previous update of this worker as well.
+            decay *= (t0 + this->m_tprev) / (t0 + t);
+            this->m_tprev = t;
+        }
         scale = decay * proj;
 
         // W -= (err * eta * x) <==> V -= (err * eta * x) / (decay * proj).
@@ -385,13 +620,13 @@ public:
         update_weights(it->begin(), it->end(), -gain * err * it->get_weight());
 
         // Project the weight vector within an L2 ball.
-        if (1 < lambda * norm22 * scale * scale) {
+        if (this->m_stride == 1 && 1 < lambda * norm22 * scale * scale) {
             proj = 1.0 / (sqrt(lambda * norm22) * scale);
             scale = decay * proj;
         }
 
         // Increment the update count.
-        ++t;
+        t += this->m_stride;
     }
 
     /**
@@ -409,6 +644,58 @@ public:
         }
     }
 
+    /**
+     * Receives a minibatch of training instances and updates feature
+     * weights.
+     *  This function computes the errors of all instances with the current
+     *  weights, and then applies the decay and projection once for the
+     *  gradients of the instances.
+     *  @param  first       The iterator pointing to the first iterator of
+     *                      the instances.
+     *  @param  last        The iterator pointing just beyond the last
+     *                      iterator of the instances.
+     */
+    template <class iterator_type>
+    void update_batch(iterator_type first, iterator_type last)
+    {
+        model_type& model = *this->m_pmodel;
+        std::vector<value_type>& errors = this->m_errors;
+        const int n = (int)std::distance(first, last);
+        if (n == 0) {
+            return;
+        }
+
+        // Compute the errors for the instances with the current weights.
+        errors.resize(n);
+        iterator_type it = first;
+        for (int i = 0;i < n;++i, ++it) {
+            value_type nlogp = 0.;
+            error_type cls(model);
+            cls.inner_product((*it)->begin(), (*it)->end());
+            cls.scale(this->m_scale);
+            errors[i] = cls.error((*it)->get_label(), nlogp);
+            this->m_loss += ((*it)->get_weight() * nlogp);
+        }
+
+        // The update counts taken by the minibatch.
+        const int m = this->m_batch_average ? 1 : n;
+        const value_type tlast = this->m_t + (m - 1) * this->m_stride;
+        value_type gain = this->decay_batch(tlast);
+        if (this->m_batch_average) {
+            gain /= n;
+        }
+
+        // Update the feature weights.
+        it = first;
+        for (int i = 0;i < n;++i, ++it) {
+            update_weights(
+                (*it)->begin(), (*it)->end(),
+                -gain * errors[i] * (*it)->get_weight());
+        }
+
+        this->finish_batch(tlast);
+    }
+
 protected:
     /**
      * Adds a value to weights associated with a feature vector.
@@ -421,7 +708,7 @@ protected:
     template <class iterator_type>
     inline void update_weights(iterator_type first, iterator_type last, value_type delta)
     {
-        model_type& model = this->m_model;
+        model_type& model = *this->m_pmodel;
         value_type& norm22 = this->m_norm22;
 
         for (iterator_type it = first;it != last;++it) {
@@ -431,6 +718,49 @@ protected:
             norm22 += d * (d + w + w);
         }
     }
+
+    /**
+     * Adds a value to weights associated with a feature vector in CSR
+     * layout, skipping the multiplication for implicit values and decoding
+     * compressed identifiers by blocks.
+     *  @param  first       The iterator pointing to the first element of
+     *                      the feature vector.
+     *  @param  last        The iterator pointing just beyond the last
+     *                      element of the feature vector.
+     *  @param  delta       The value to be added to the weights.
+     */
+    inline void update_weights(csr_element_iterator first, csr_element_iterator last, value_type delta)
+    {
+        model_type& model = *this->m_pmodel;
+        value_type& norm22 = this->m_norm22;
+
+        if (first.compressed()) {
+            int ids[csr_element_iterator::block_size];
+            while (first != last) {
+                const float* v = first.fvalue_data();
+                const int step = first.step();
+                const int n = first.decode(last, ids);
+                for (int i = 0;i < n;++i) {
+                    value_type w = model[ids[i]];
+                    value_type d = delta * v[i * step];
+                    model[ids[i]] += d;
+                    norm22 += d * (d + w + w);
+                }
+            }
+            return;
+        }
+
+        if (!first.implicit_values()) {
+            this->template update_weights<csr_element_iterator>(first, last, delta);
+            return;
+        }
+
+        for (const int* p = first.id_data();p != last.id_data();++p) {
+            value_type w = model[*p];
+            model[*p] += delta;
+            norm22 += delta * (delta + w + w);
+        }
+    }
 };
 
 
@@ -472,7 +802,7 @@ public:
         const int L = (int)fgen.num_labels();
 
         // Define synonyms to avoid using "this->" for member variables.
-        model_type& model = this->m_model;
+        model_type& model = *this->m_pmodel;
         value_type& eta = this->m_eta;
         value_type& lambda = this->m_lambda;
         value_type& decay = this->m_decay;
@@ -489,15 +819,8 @@ public:
         // Compute the scores for the labels (candidates) in the instance.
         value_type nlogp = 0.;
         error_type cls(model);
-        cls.resize(it->num_candidates(L));
-        for (int i = 0;i < it->num_candidates(L);++i) {
-            cls.inner_product(
-                i,
-                fgen,
-                it->attributes(i).begin(),
-                it->attributes(i).end(),
-                i
-                );
+        cls.inner_product_instance(fgen, *it, L);
+        for (int i = 0;i < cls.size();++i) {
             cls.scale(i, scale);
         }
         cls.finalize();
@@ -510,7 +833,14 @@ public:
         // let W = (decay * proj) * V and remember the products of
         // decay factors. This avoids an O(K) computation for every
         // updates.
-        decay *= (1. - eta * lambda);
+        if (this->m_stride == 1) {
+            decay *= (1. - eta * lambda);
+        } else {
+            // Apply the decay factors of the updates by the other workers
+            // since the previous update of this worker as well.
+            decay *= (t0 + this->m_tprev) / (t0 + t);
+            this->m_tprev = t;
+        }
         scale = decay * proj;
 
         // W -= (err * eta * x) <==> V -= (err * eta * x) / (decay * proj).
@@ -526,9 +856,11 @@ public:
         gain *= it->get_weight();
 
         // Updates the feature weights.
+        value_type sum = 0.;
         for (int i = 0;i < it->num_candidates(L);++i) {
             // Computes the error for the label (candidate).
             value_type err = cls.error(i, it->get_label());
+            sum += err;
 
             // Update the feature weights.
             update_weights(
@@ -540,15 +872,19 @@ public:
                 );
         }
 
+        // Update the weights of the shared attributes once with the sum of
+        // the errors of the candidates.
+        this->update_weights_shared(fgen, *it, -sum * gain);
+
 
         // Project the weight vector within an L2 ball.
-        if (1 < lambda * norm22 * scale * scale) {
+        if (this->m_stride == 1 && 1 < lambda * norm22 * scale * scale) {
             proj = 1.0 / (sqrt(lambda * norm22) * scale);
             scale = decay * proj;
         }
 
         // Increment the update count.
-        ++t;
+        t += this->m_stride;
     }
 
     /**
@@ -566,6 +902,77 @@ public:
         }
     }
 
+    /**
+     * Receives a minibatch of training instances and updates feature
+     * weights.
+     *  This function computes the errors of all candidates of the instances
+     *  with the current weights, and then applies the decay and projection
+     *  once for the gradients of the instances.
+     *  @param  first       The iterator pointing to the first iterator of
+     *                      the instances.
+     *  @param  last        The iterator pointing just beyond the last
+     *                      iterator of the instances.
+     *  @param  fgen        The feature generator.
+     */
+    template <class iterator_type, class feature_generator_type>
+    void update_batch(
+        iterator_type first,
+        iterator_type last,
+        feature_generator_type& fgen
+        )
+    {
+        const int L = (int)fgen.num_labels();
+        model_type& model = *this->m_pmodel;
+        std::vector<value_type>& errors = this->m_errors;
+        const int n = (int)std::distance(first, last);
+        if (n == 0) {
+            return;
+        }
+
+        // Compute the errors for the candidates with the current weights.
+        errors.clear();
+        error_type cls(model);
+        for (iterator_type it = first;it != last;++it) {
+            cls.inner_product_instance(fgen, **it, L);
+            for (int i = 0;i < cls.size();++i) {
+                cls.scale(i, this->m_scale);
+            }
+            cls.finalize();
+            this->m_loss += -(*it)->get_weight() * cls.logprob((*it)->get_label());
+            for (int i = 0;i < (*it)->num_candidates(L);++i) {
+                errors.push_back(cls.error(i, (*it)->get_label()));
+            }
+        }
+
+        // The update counts taken by the minibatch.
+        const int m = this->m_batch_average ? 1 : n;
+        const value_type tlast = this->m_t + (m - 1) * this->m_stride;
+        value_type gain = this->decay_batch(tlast);
+        if (this->m_batch_average) {
+            gain /= n;
+        }
+
+        // Update the feature weights.
+        size_t k = 0;
+        for (iterator_type it = first;it != last;++it) {
+            const value_type g = gain * (*it)->get_weight();
+            value_type sum = 0.;
+            for (int i = 0;i < (*it)->num_candidates(L);++i) {
+                sum += errors[k];
+                update_weights(
+                    i,
+                    fgen,
+                    (*it)->attributes(i).begin(),
+                    (*it)->attributes(i).end(),
+                    -errors[k++] * g
+                    );
+            }
+            this->update_weights_shared(fgen, **it, -sum * g);
+        }
+
+        this->finish_batch(tlast);
+    }
+
 protected:
     /**
      * Adds a value to weights associated with a feature vector.
@@ -586,7 +993,7 @@ protected:
         value_type delta
         )
     {
-        model_type& model = this->m_model;
+        model_type& model = *this->m_pmodel;
         value_type& norm22 = this->m_norm22;
 
         for (iterator_type it = first;it != last;++it) {
@@ -599,6 +1006,27 @@ protected:
             }
         }
     }
+
+    /**
+     * Adds a value to weights associated with the attributes shared by the
+     * candidates of an instance.
+     *  @param  fgen        The feature generator.
+     *  @param  inst        The instance.
+     *  @param  delta       The value to be added to the weights.
+     */
+    template <class feature_generator_type, class instance_type>
+    inline void update_weights_shared(
+        feature_generator_type& fgen,
+        const instance_type& inst,
+        value_type delta
+        )
+    {
+        typedef typename instance_type::attributes_type attributes_type;
+        const attributes_type* shared = shared_attributes(inst);
+        if (shared != NULL) {
+            update_weights(0, fgen, shared->begin(), shared->end(), delta);
+        }
+    }
 };
 
 };
@@ -0,0 +1,1110 @@
+/*
+ *      Stochastic variance reduced gradient (SVRG) for logistic regression.
+ *
+ * Copyright (c) 2008,2009 Naoaki Okazaki
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the names of the authors nor the names of its contributors
+ *       may be used to endorse or promote products derived from this
+ *       software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* $Id$ */
+
+#ifndef __CLASSIAS_TRAIN_SVRG_H__
+#define __CLASSIAS_TRAIN_SVRG_H__
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <math.h>
+#include <string>
+#include <vector>
+
+#include <classias/types.h>
+#include <classias/checkpoint.h>
+#include <classias/parameters.h>
+#include <classias/evaluation.h>
+#include <classias/memory.h>
+#include <classias/metrics.h>
+#include <classias/classify/linear/binary.h>
+#include <classias/classify/linear/multi.h>
+#include <classias/train/online_scheduler.h>
+
+namespace classias
+{
+
+namespace train
+{
+
+/**
+ * Stochastic variance reduced gradient (SVRG).
+ *
+ *  This class implements internal variables, operations, and interface
+ *  that are common for training a logistic regression model by SVRG
+ *  (Johnson and Zhang, NIPS 2013). The objective is that of L-BFGS with
+ *  L2 regularization,
+ *      c2 * |w|^2 + \sum_i weight_i * loss_i(w),
+ *  where the bias features are not regularized. Every iteration (epoch)
+ *  computes the gradient of the data set at a snapshot of the weights in a
+ *  pass, and updates the weights with every instance of the epoch by the
+ *  stochastic gradient corrected with the full gradient at the snapshot,
+ *      w <- w - eta * (g_i(w) - g_i(w_s) + mu(w_s) + 2 * c2 / n * w),
+ *  which converges linearly with a constant step size. The correction and
+ *  the regularization for the features absent from an instance are applied
+ *  lazily when the features appear in an instance, so that an update costs
+ *  the number of elements of the instance. An epoch thus costs about three
+ *  passes over the data set (the full gradient and two gradients of every
+ *  instance), which are reported as the data passes.
+ *
+ *  @param  model_tmpl  The type of a weight vector for features.
+ */
+template <
+    class model_tmpl
+>
+class svrg_base
+{
+public:
+    /// The type implementing a model (weight vector for features).
+    typedef model_tmpl model_type;
+    /// The type representing a value.
+    typedef typename model_type::value_type value_type;
+
+protected:
+    /// The array of feature weights.
+    model_type m_w;
+    /// The weights at the snapshot of the epoch.
+    model_type m_snapshot;
+    /// The average gradients of the losses of the instances at the snapshot.
+    model_type m_mu;
+    /// The number of the updates of the epoch applied to every weight.
+    std::vector<int> m_last;
+    /// The number of the updates in the epoch.
+    int m_t;
+    /// The step size.
+    value_type m_eta;
+    /// The coefficient of the regularization of the average loss (2 * c2 / n).
+    value_type m_lambda;
+    /// The number of instances for training.
+    value_type m_n;
+    /// The largest smoothness constant of the losses of the instances.
+    value_type m_smoothness;
+    /// The number of elements (attribute-value pairs) of the instances.
+    double m_num_elements;
+    /// The start index for regularization.
+    int m_regularization_start;
+    /// The group number for holdout evaluation.
+    int m_holdout;
+    /// The initial weights (empty for training from zero weights).
+    model_type m_init;
+
+    /// Parameter interface.
+    parameter_exchange m_params;
+    /// The coefficient for L2 regularization.
+    value_type m_c2;
+    /// The step size specified by the parameter (zero for the default).
+    value_type m_eta0;
+    /// The sample method.
+    std::string m_sample;
+    /// The generator of random numbers for sampling instances.
+    random_generator m_random;
+    /// The maximum number of iterations.
+    int m_max_iterations;
+    /// The epsilon for the convergence test.
+    value_type m_epsilon;
+    /// The threshold for the improvement ratio of the loss.
+    value_type m_delta;
+
+    /// The writer of training metrics (NULL for no metrics).
+    metrics* m_metrics;
+    /// The settings of holdout evaluations.
+    holdout_options m_holdout_options;
+    /// The checkpoint of the training process (NULL for no checkpoint).
+    checkpoint* m_checkpoint;
+    /// The seconds spent updating the weights in the iteration.
+    double m_time_update;
+    /// The seconds spent computing the full gradient in the iteration.
+    double m_time_gradient;
+
+public:
+    /**
+     * Constructs the object.
+     */
+    svrg_base() : m_metrics(NULL), m_checkpoint(NULL)
+    {
+        clear();
+    }
+
+    /**
+     * Destructs the object.
+     */
+    virtual ~svrg_base()
+    {
+    }
+
+    /**
+     * Resets the internal states and parameters to default.
+     */
+    void clear()
+    {
+        m_w.clear();
+        m_snapshot.clear();
+        m_mu.clear();
+        m_last.clear();
+
+        m_params.init("c2", &m_c2, 1.0,
+            "Coefficient for L2-regularization.");
+        m_params.init("eta", &m_eta0, 0.0,
+            "The step size; the default (0) is 1 / (L + 2 * c2 / n), where L is the largest\n"
+            "smoothness constant of the losses of the n training instances.");
+        m_params.init("sample", &m_sample, "shuffle",
+            "The order of the instances in an iteration:\n"
+            "{'shuffle': a random order, 'cycle': the order in the data set,\n"
+            "'random': instances chosen at random with replacement}");
+        m_params.init("max_iterations", &m_max_iterations, 100,
+            "The maximum number of iterations (epochs).");
+        m_params.init("epsilon", &m_epsilon, 1e-5,
+            "Epsilon for testing the convergence; the training stops when the norm of the\n"
+            "gradient is no greater than epsilon * max(1, |w|).");
+        m_params.init("delta", &m_delta, 1e-5,
+            "The threshold for the stopping criterion; the training stops when the\n"
+            "improvement ratio of the loss in an iteration is below this threshold.");
+    }
+
+    /**
+     * Obtains the parameter interface.
+     *  @return parameter_exchange& The parameter interface associated with
+     *                              the algorithm.
+     */
+    parameter_exchange& params()
+    {
+        return m_params;
+    }
+
+    /**
+     * Obtains the current model.
+     *  @return const model_type&   The model.
+     */
+    const model_type& model() const
+    {
+        return m_w;
+    }
+
+    /**
+     * Returns the memory used by the training algorithm.
+     *  @return size_t      The approximate number of bytes, including the
+     *                      snapshot and the average gradients.
+     */
+    virtual size_t memory_usage() const
+    {
+        return
+            (m_w.size() + m_snapshot.size() + m_mu.size() + m_init.size()) *
+            sizeof(value_type) + classias::memory_usage(m_last);
+    }
+
+    /**
+     * Sets the writer of training metrics.
+     *  Every iteration writes a record with the loss, the norm of the
+     *  gradient, the data passes, the wall-clock and CPU times, the times of
+     *  the phases (the updates, the full gradient, and the holdout
+     *  evaluation), and the throughput of the updates.
+     *  @param  m           The writer, or \c NULL for no metrics.
+     */
+    void set_metrics(metrics* m)
+    {
+        m_metrics = m;
+    }
+
+    /**
+     * Sets the settings of holdout evaluations.
+     *  The holdout instances are listed once before training (a random
+     *  subset of them with a sample size), and evaluated by multiple
+     *  threads after every interval-th iteration.
+     *  @param  ho          The settings.
+     */
+    void set_holdout_options(const holdout_options& ho)
+    {
+        m_holdout_options = ho;
+    }
+
+    /**
+     * Sets the checkpoint of the training process.
+     *  The weights are stored after every interval-th iteration. When the
+     *  training resumes, the weights stored last are restored and the
+     *  random numbers drawn by the completed iterations are replayed, so
+     *  that the training continues as if it had not stopped.
+     *  @param  cp          The checkpoint, or \c NULL for no checkpoint.
+     */
+    void set_checkpoint(checkpoint* cp)
+    {
+        m_checkpoint = cp;
+    }
+
+    /**
+     * Sets the weights from which the training starts.
+     *  @param  w           The initial weights storing the weights for all
+     *                      features of the data set.
+     */
+    void set_initial_weights(const model_type& w)
+    {
+        m_init = w;
+    }
+
+protected:
+    /**
+     * Adds the losses and gradients of the training instances.
+     *  @param  g           The gradient vector (initialized with zero) to
+     *                      which this function adds.
+     *  @return value_type  The sum of the losses of the instances.
+     */
+    virtual value_type loss_and_gradient(value_type* g) = 0;
+
+    /**
+     * Lists the instances of an epoch, and updates the weights with them.
+     *  @param  update      \c false to draw only the random numbers of the
+     *                      epoch without updating the weights.
+     *  @return int         The number of the instances of the epoch.
+     */
+    virtual int update_epoch(bool update) = 0;
+
+    /**
+     * Performs a holdout evaluation.
+     *  @param  os          The output stream.
+     */
+    virtual void holdout_evaluation(std::ostream& os) = 0;
+
+    /**
+     * Initializes the weight vector of the size K.
+     *  @param  K           The size of the weight vector.
+     */
+    void initialize_weights(size_t K)
+    {
+        if (m_init.size() == K) {
+            m_w = m_init;
+        } else {
+            m_w.resize(K);
+            for (size_t k = 0;k < K;++k) {
+                m_w[k] = 0;
+            }
+        }
+        m_num_elements = 0.;
+        m_smoothness = 0.;
+        m_n = 0.;
+    }
+
+    /**
+     * Applies the updates of the average gradient and the regularization
+     * to a weight.
+     *  @param  j           The feature index.
+     *  @param  s           The number of the updates.
+     */
+    inline void advance(int j, int s)
+    {
+        if (j < m_regularization_start || m_lambda == 0.) {
+            m_w[j] -= s * m_eta * m_mu[j];
+        } else if (s == 1) {
+            m_w[j] = (1. - m_eta * m_lambda) * m_w[j] - m_eta * m_mu[j];
+        } else {
+            // w <- a^s * w - (1 - a^s) / lambda * mu for a = 1 - eta * lambda.
+            const value_type r = s * log1p(-m_eta * m_lambda);
+            m_w[j] = std::exp(r) * m_w[j] + expm1(r) / m_lambda * m_mu[j];
+        }
+    }
+
+    /**
+     * Brings a weight up to date before the current update.
+     *  @param  j           The feature index.
+     */
+    inline void catch_up(int j)
+    {
+        const int s = m_t - m_last[j];
+        if (0 < s) {
+            this->advance(j, s);
+            m_last[j] = m_t;
+        }
+    }
+
+    /**
+     * Adds a value of the current update to a weight.
+     *  The first call for a weight in an update applies the average
+     *  gradient and the regularization of the update as well.
+     *  @param  j           The feature index.
+     *  @param  delta       The value.
+     */
+    inline void update(int j, value_type delta)
+    {
+        this->catch_up(j);
+        if (m_last[j] == m_t) {
+            this->advance(j, 1);
+            m_last[j] = m_t + 1;
+        }
+        m_w[j] += delta;
+    }
+
+    /**
+     * Computes the loss and the average gradients at the current weights.
+     *  @param  gnorm       The norm of the gradient of the objective.
+     *  @return value_type  The objective.
+     */
+    value_type compute_gradient(value_type& gnorm)
+    {
+        const size_t K = m_w.size();
+        for (size_t k = 0;k < K;++k) {
+            m_mu[k] = 0.;
+        }
+        value_type loss = this->loss_and_gradient(&m_mu[0]);
+
+        value_type norm2 = 0., gnorm2 = 0.;
+        for (size_t k = 0;k < K;++k) {
+            value_type g = m_mu[k];
+            if (m_regularization_start <= (int)k) {
+                g += 2. * m_c2 * m_w[k];
+                norm2 += m_w[k] * m_w[k];
+            }
+            gnorm2 += g * g;
+            m_mu[k] /= m_n;
+        }
+        gnorm = std::sqrt(gnorm2);
+        return loss + m_c2 * norm2;
+    }
+
+    /**
+     * Trains the weights.
+     *  @param  os          The output stream for progress reports.
+     */
+    void solve(std::ostream& os)
+    {
+        const size_t K = m_w.size();
+        if (m_c2 < 0) {
+            throw invalid_parameter("The coefficient c2 must be non-negative");
+        }
+        if (m_eta0 < 0) {
+            throw invalid_parameter("The step size eta must be non-negative");
+        }
+        if (m_sample != "shuffle" && m_sample != "cycle" && m_sample != "random") {
+            throw invalid_parameter("Unknown sampling method for instances");
+        }
+
+        // Determine the step size.
+        m_n = std::max(m_n, (value_type)1.);
+        m_lambda = 2. * m_c2 / m_n;
+        m_eta = (0. < m_eta0 ? m_eta0 : 1. / (m_smoothness + m_lambda));
+        if (1. <= m_eta * m_lambda) {
+            throw invalid_parameter("The step size eta is too large for the coefficient c2");
+        }
+        os << "Step size: " << m_eta << std::endl;
+        os << std::endl;
+
+        m_snapshot.resize(K);
+        m_mu.resize(K);
+        m_last.assign(K, 0);
+        m_t = 0;
+
+        // Draw the random numbers of a fold trained concurrently with the
+        // others from the sequence of its holdout group.
+        if (m_holdout_options.fold_random) {
+            m_random.seed((unsigned int)m_holdout);
+        } else {
+            m_random.share();
+        }
+
+        // Resume from the weights stored last by the checkpoint.
+        int k0 = 0;
+        double passes = 1.;
+        value_type prev = 0.;
+        std::string state;
+        if (m_checkpoint != NULL && m_checkpoint->load("svrg", state)) {
+            checkpoint_reader ar(state);
+            ar.value(k0);
+            ar.value(passes);
+            ar.value(prev);
+            ar.vector(m_w);
+            if (!ar.eof() || m_w.size() != K) {
+                throw checkpoint_error("A checkpoint has an inconsistent state");
+            }
+            os << "Resumed from the checkpoint of iteration #" << k0 << std::endl;
+            os << std::endl;
+
+            // Draw the random numbers of the completed iterations.
+            for (int k = 0;k < k0;++k) {
+                this->update_epoch(false);
+            }
+        }
+
+        // Compute the gradient at the starting weights.
+        value_type gnorm = 0.;
+        value_type loss = this->compute_gradient(gnorm);
+        if (k0 == 0) {
+            prev = loss;
+        }
+
+        for (int k = k0 + 1;k <= m_max_iterations;++k) {
+            const double clk = wall_clock();
+            const double cpu = cpu_clock();
+
+            // Update the weights with the instances of the epoch.
+            std::copy(m_w.begin(), m_w.end(), m_snapshot.begin());
+            const int m = this->update_epoch(true);
+            for (size_t j = 0;j < K;++j) {
+                this->catch_up((int)j);
+            }
+            m_last.assign(K, 0);
+            m_t = 0;
+            m_time_update = wall_clock() - clk;
+
+            // Compute the gradient for the next epoch.
+            double t = wall_clock();
+            loss = this->compute_gradient(gnorm);
+            m_time_gradient = wall_clock() - t;
+            passes += 1. + 2. * m / m_n;
+
+            // Report the progress.
+            int num_actives = 0;
+            value_type xnorm = 0.;
+            for (size_t j = 0;j < K;++j) {
+                if (m_w[j] != 0.) {
+                    ++num_actives;
+                }
+                xnorm += m_w[j] * m_w[j];
+            }
+            xnorm = std::sqrt(xnorm);
+            const double seconds = wall_clock() - clk;
+            const double cpu_seconds = cpu_clock() - cpu;
+            os << "***** Iteration #" << k << " *****" << std::endl;
+            os << "Loss: " << loss << std::endl;
+            os << "Feature L2-norm: " << xnorm << std::endl;
+            os << "Error norm: " << gnorm << std::endl;
+            os << "Active features: " << num_actives << " / " << K << std::endl;
+            os << "Data passes: " << passes << std::endl;
+            os << "Seconds required for this iteration: " << seconds << std::endl;
+
+            // Holdout evaluation if necessary.
+            t = wall_clock();
+            if (0 <= m_holdout && m_holdout_options.scheduled(k, k == m_max_iterations)) {
+                this->holdout_evaluation(os);
+            }
+            t = wall_clock() - t;
+            os << std::endl;
+            os.flush();
+
+            if (m_metrics != NULL) {
+                const double tu = m_time_update;
+                metrics_record rec("iteration");
+                rec.add("solver", "svrg");
+                rec.add("holdout", m_holdout);
+                rec.add("iteration", k);
+                rec.add("loss", (double)loss);
+                rec.add("gradient_norm", (double)gnorm);
+                rec.add("passes", passes);
+                rec.add("seconds", seconds);
+                rec.add("cpu_seconds", cpu_seconds);
+                rec.add("update_seconds", m_time_update);
+                rec.add("gradient_seconds", m_time_gradient);
+                rec.add("holdout_seconds", t);
+                rec.add("instances_per_second", 0. < tu ? m / tu : 0.);
+                rec.add("nnz_per_second", 0. < tu ? m * m_num_elements / m_n / tu : 0.);
+                m_metrics->write(rec);
+            }
+
+            // Test the stopping criteria of L-BFGS.
+            if (gnorm <= m_epsilon * std::max((value_type)1., xnorm)) {
+                os << "SVRG resulted in convergence" << std::endl;
+                os << std::endl;
+                break;
+            }
+            if ((prev - loss) / loss < m_delta) {
+                os << "SVRG terminated with the stopping criterion" << std::endl;
+                os << std::endl;
+                break;
+            }
+            prev = loss;
+
+            // Store the weights to the checkpoint if scheduled.
+            if (m_checkpoint != NULL && m_checkpoint->scheduled(k)) {
+                checkpoint_writer ar;
+                ar.value(k);
+                ar.value(passes);
+                ar.value(prev);
+                ar.vector(m_w);
+                m_checkpoint->save("svrg", ar);
+            }
+        }
+
+        if (m_checkpoint != NULL) {
+            m_checkpoint->wait();
+        }
+    }
+};
+
+
+
+/**
+ * SVRG for binary logistic regression.
+ *
+ *  @param  data_tmpl       The type of the data set for training.
+ *  @param  model_tmpl      The type of the feature weights.
+ */
+template <
+    class data_tmpl,
+    class model_tmpl = weight_vector
+>
+class svrg_logistic_binary : public svrg_base<model_tmpl>
+{
+public:
+    /// A type representing a data set for training.
+    typedef data_tmpl data_type;
+    /// The type implementing a model (weight vector for features).
+    typedef model_tmpl model_type;
+    /// A synonym of the base class.
+    typedef svrg_base<model_tmpl> base_class;
+    /// The type representing a value.
+    typedef typename model_type::value_type value_type;
+    /// A type representing an instance in the training data.
+    typedef typename data_type::instance_type instance_type;
+    /// A type providing a read-only random-access iterator for instances.
+    typedef typename data_type::const_iterator const_iterator;
+    /// A classifier type.
+    typedef classify::linear_binary_logistic<model_type> error_type;
+
+protected:
+    /// A data set for training.
+    const data_type* m_data;
+    /// The holdout instances.
+    std::vector<const_iterator> m_holdout_index;
+
+public:
+    /**
+     * Constructs the object.
+     */
+    svrg_logistic_binary() : m_data(NULL)
+    {
+    }
+
+    /**
+     * Destructs the object.
+     */
+    virtual ~svrg_logistic_binary()
+    {
+    }
+
+    /**
+     * Returns the memory used by the training algorithm.
+     *  @return size_t      The approximate number of bytes.
+     */
+    virtual size_t memory_usage() const
+    {
+        return base_class::memory_usage() + classias::memory_usage(m_holdout_index);
+    }
+
+    /**
+     * Trains a model on a data set.
+     *  @param  data        The data set for training (and holdout evaluation).
+     *  @param  os          The output stream for progress reports.
+     *  @param  holdout     The group number for holdout evaluation. Specify
+     *                      a negative value if a holdout evaluation is
+     *                      unnecessary.
+     *  @param  acconly     Unused (reserved only for the compatibility with
+     *                      multi-class classification).
+     */
+    void train(
+        const data_type& data,
+        std::ostream& os,
+        int holdout = -1,
+        bool acconly = true
+        )
+    {
+        this->initialize_weights(data.num_features());
+
+        // Show the information for training.
+        os << "Binary logistic regression using SVRG" << std::endl;
+        this->m_params.show(os);
+        os << "svrg.regularization_start: " << data.get_user_feature_start() << std::endl;
+
+        // Find the largest smoothness constant, weight * |x|^2 / 4.
+        for (const_iterator it = data.begin();it != data.end();++it) {
+            if (it->get_group() != holdout) {
+                value_type norm2 = 0.;
+                for (typename instance_type::const_iterator e = it->begin();e != it->end();++e) {
+                    norm2 += e->second * e->second;
+                }
+                this->m_smoothness = std::max(
+                    this->m_smoothness, it->get_weight() * norm2 / 4.);
+                this->m_num_elements += (double)num_elements(*it);
+                this->m_n += 1.;
+            }
+        }
+
+        m_data = &data;
+        this->m_holdout = holdout;
+        this->m_regularization_start = data.get_user_feature_start();
+        holdout_instances(
+            m_holdout_index, data.begin(), data.end(), holdout,
+            this->m_holdout_options.sample);
+        this->solve(os);
+    }
+
+protected:
+    virtual value_type loss_and_gradient(value_type* g)
+    {
+        value_type loss = 0.;
+        error_type cls(this->m_w);
+        for (const_iterator it = m_data->begin();it != m_data->end();++it) {
+            if (it->get_group() == this->m_holdout) {
+                continue;
+            }
+
+            value_type nlogp = 0.;
+            cls.inner_product(it->begin(), it->end());
+            const value_type err = it->get_weight() * cls.error(it->get_label(), nlogp);
+            loss += it->get_weight() * nlogp;
+            for (typename instance_type::const_iterator e = it->begin();e != it->end();++e) {
+                g[e->first] += err * e->second;
+            }
+        }
+        return loss;
+    }
+
+    virtual int update_epoch(bool update)
+    {
+        std::vector<const_iterator> perm;
+        sample_instances(
+            perm, *m_data, this->m_sample, this->m_holdout, this->m_random);
+        if (!update) {
+            return (int)perm.size();
+        }
+
+        error_type cls(this->m_w), cls_s(this->m_snapshot);
+        for (size_t i = 0;i < perm.size();++i) {
+            const instance_type& inst = *perm[i];
+            typename instance_type::const_iterator e;
+            for (e = inst.begin();e != inst.end();++e) {
+                this->catch_up(e->first);
+            }
+
+            // The difference of the gradients at the weights and snapshot.
+            cls.inner_product(inst.begin(), inst.end());
+            cls_s.inner_product(inst.begin(), inst.end());
+            const value_type d = -this->m_eta * inst.get_weight() *
+                (cls.error(inst.get_label()) - cls_s.error(inst.get_label()));
+            for (e = inst.begin();e != inst.end();++e) {
+                this->update(e->first, d * e->second);
+            }
+            ++this->m_t;
+        }
+        return (int)perm.size();
+    }
+
+    virtual void holdout_evaluation(std::ostream& os)
+    {
+        error_type cla(this->m_w);
+        holdout_evaluation_binary(
+            os,
+            m_holdout_index,
+            cla,
+            this->m_holdout_options.num_threads
+            );
+    }
+};
+
+
+
+/**
+ * SVRG for multi-class (or candidate) logistic regression.
+ *  The attributes shared by the candidates of an instance have no effect on
+ *  the probabilities, and receive only the regularization.
+ *
+ *  @param  data_tmpl       The type of the data set for training.
+ *  @param  model_tmpl      The type of the feature weights.
+ */
+template <
+    class data_tmpl,
+    class model_tmpl = weight_vector
+>
+class svrg_logistic_multi : public svrg_base<model_tmpl>
+{
+public:
+    /// A type representing a data set for training.
+    typedef data_tmpl data_type;
+    /// The type implementing a model (weight vector for features).
+    typedef model_tmpl model_type;
+    /// A synonym of the base class.
+    typedef svrg_base<model_tmpl> base_class;
+    /// A synonym of this class.
+    typedef svrg_logistic_multi<data_tmpl, model_tmpl> this_class;
+    /// The type representing a value.
+    typedef typename model_type::value_type value_type;
+    /// A type representing an instance in the training data.
+    typedef typename data_type::instance_type instance_type;
+    /// A type providing a read-only random-access iterator for instances.
+    typedef typename data_type::const_iterator const_iterator;
+    /// A type representing an attribute.
+    typedef typename instance_type::attributes_type attributes_type;
+    /// A type representing a feature generator.
+    typedef typename data_type::feature_generator_type feature_generator_type;
+    /// The type of a classifier.
+    typedef classify::linear_multi_logistic<model_type> error_type;
+
+protected:
+    /// A data set for training.
+    const data_type* m_data;
+    /// The holdout instances.
+    std::vector<const_iterator> m_holdout_index;
+    /// The flag indicating whether precision, recall, and F1 are unnecessary.
+    bool m_acconly;
+    /// The coefficients of the features of the candidates of an instance.
+    std::vector<value_type> m_coef;
+
+    /// A function object bringing a weight up to date.
+    struct catch_up_op
+    {
+        this_class* owner;
+
+        inline void operator()(int f, int i, value_type v)
+        {
+            owner->catch_up(f);
+        }
+    };
+
+    /// A function object adding the coefficients of candidates to weights.
+    struct update_op
+    {
+        this_class* owner;
+        const value_type* coef;
+        value_type shared;
+
+        inline void operator()(int f, int i, value_type v)
+        {
+            owner->update(f, (i < 0 ? shared : coef[i]) * v);
+        }
+    };
+
+    /// A function object adding the coefficients of candidates to gradients.
+    struct gradient_op
+    {
+        value_type* g;
+        const value_type* coef;
+        value_type shared;
+
+        inline void operator()(int f, int i, value_type v)
+        {
+            g[f] += (i < 0 ? shared : coef[i]) * v;
+        }
+    };
+
+    /// A function object visiting the labels in a posting list.
+    template <class op_type, class fgen_type>
+    struct posting_op
+    {
+        op_type* op;
+        value_type value;
+        int L;
+
+        inline void operator()(
+            const typename fgen_type::label_type& l,
+            const typename fgen_type::feature_type& f
+            )
+        {
+            if ((int)l < L) {
+                (*op)((int)f, (int)l, value);
+            }
+        }
+    };
+
+public:
+    /**
+     * Constructs the object.
+     */
+    svrg_logistic_multi() : m_data(NULL), m_acconly(true)
+    {
+    }
+
+    /**
+     * Destructs the object.
+     */
+    virtual ~svrg_logistic_multi()
+    {
+    }
+
+    /**
+     * Returns the memory used by the training algorithm.
+     *  @return size_t      The approximate number of bytes.
+     */
+    virtual size_t memory_usage() const
+    {
+        return base_class::memory_usage() + classias::memory_usage(m_holdout_index);
+    }
+
+    /**
+     * Trains a model on a data set.
+     *  @param  data        The data set for training (and holdout evaluation).
+     *  @param  os          The output stream for progress reports.
+     *  @param  holdout     The group number for holdout evaluation. Specify
+     *                      a negative value if a holdout evaluation is
+     *                      unnecessary.
+     *  @param  acconly     The flag indicating whether precision, recall, and
+     *                      F1 scores are unnecessary.
+     */
+    void train(
+        const data_type& data,
+        std::ostream& os,
+        int holdout = -1,
+        bool acconly = true
+        )
+    {
+        this->initialize_weights(data.num_features());
+
+        // Show the information for training.
+        os << "Multi-class logistic regression using SVRG" << std::endl;
+        this->m_params.show(os);
+        os << "svrg.regularization_start: " << data.get_user_feature_start() << std::endl;
+
+        // Find the largest smoothness constant of the instances.
+        const int L = data.num_labels();
+        for (const_iterator it = data.begin();it != data.end();++it) {
+            if (it->get_group() != holdout) {
+                this->m_smoothness = std::max(
+                    this->m_smoothness, it->get_weight() * smoothness(*it, L));
+                this->m_num_elements += (double)num_elements(*it);
+                this->m_n += 1.;
+            }
+        }
+
+        m_data = &data;
+        m_acconly = acconly;
+        this->m_holdout = holdout;
+        this->m_regularization_start = data.get_user_feature_start();
+        holdout_instances(
+            m_holdout_index, data.begin(), data.end(), holdout,
+            this->m_holdout_options.sample);
+        this->solve(os);
+    }
+
+protected:
+    virtual value_type loss_and_gradient(value_type* g)
+    {
+        value_type loss = 0.;
+        const data_type& data = *m_data;
+        const int L = data.num_labels();
+        error_type cls(this->m_w);
+
+        gradient_op op;
+        op.g = g;
+        for (const_iterator it = data.begin();it != data.end();++it) {
+            const instance_type& inst = *it;
+            const int N = inst.num_candidates(L);
+            if (inst.get_group() == this->m_holdout || N == 0) {
+                continue;
+            }
+
+            // The gradient is the model expectation minus the observation.
+            cls.inner_product_instance(data.feature_generator, inst, L);
+            cls.finalize();
+            m_coef.resize(N);
+            op.shared = 0.;
+            for (int i = 0;i < N;++i) {
+                m_coef[i] = inst.get_weight() *
+                    (cls.prob(i) - (i == inst.get_label() ? 1. : 0.));
+                op.shared += m_coef[i];
+            }
+            op.coef = &m_coef[0];
+            for_each_feature(data.feature_generator, inst, L, op);
+            loss -= inst.get_weight() * cls.logprob(inst.get_label());
+        }
+        return loss;
+    }
+
+    virtual int update_epoch(bool update)
+    {
+        const data_type& data = *m_data;
+        std::vector<const_iterator> perm;
+        sample_instances(
+            perm, data, this->m_sample, this->m_holdout, this->m_random);
+        if (!update) {
+            return (int)perm.size();
+        }
+
+        const int L = data.num_labels();
+        error_type cls(this->m_w), cls_s(this->m_snapshot);
+        catch_up_op cop;
+        cop.owner = this;
+        update_op uop;
+        uop.owner = this;
+        for (size_t j = 0;j < perm.size();++j) {
+            const instance_type& inst = *perm[j];
+            const int N = inst.num_candidates(L);
+            if (N == 0) {
+                ++this->m_t;
+                continue;
+            }
+            for_each_feature(data.feature_generator, inst, L, cop);
+
+            // The difference of the gradients at the weights and snapshot.
+            cls.inner_product_instance(data.feature_generator, inst, L);
+            cls.finalize();
+            cls_s.inner_product_instance(data.feature_generator, inst, L);
+            cls_s.finalize();
+            m_coef.resize(N);
+            uop.shared = 0.;
+            for (int i = 0;i < N;++i) {
+                m_coef[i] = -this->m_eta * inst.get_weight() *
+                    (cls.prob(i) - cls_s.prob(i));
+                uop.shared += m_coef[i];
+            }
+            uop.coef = &m_coef[0];
+            for_each_feature(data.feature_generator, inst, L, uop);
+            ++this->m_t;
+        }
+        return (int)perm.size();
+    }
+
+    virtual void holdout_evaluation(std::ostream& os)
+    {
+        error_type cla(this->m_w);
+        holdout_evaluation_multi(
+            os,
+            m_holdout_index,
+            cla,
+            m_data->feature_generator,
+            m_acconly,
+            this->m_holdout_options.num_threads,
+            m_data->labels,
+            m_data->positive_labels.begin(),
+            m_data->positive_labels.end()
+            );
+    }
+
+    /**
+     * Visits the features of the candidates of an instance.
+     *  @param  fgen        The feature generator.
+     *  @param  inst        The instance.
+     *  @param  L           The number of labels.
+     *  @param  op          The function object receiving the feature index,
+     *                      the candidate index (-1 for the attributes
+     *                      shared by the candidates), and the value.
+     */
+    template <class fgen_type, class inst_type, class op_type>
+    static inline void for_each_feature(
+        const fgen_type& fgen,
+        const inst_type& inst,
+        int L,
+        op_type& op
+        )
+    {
+        typename fgen_type::feature_type f;
+        for (int i = 0;i < inst.num_candidates(L);++i) {
+            const attributes_type& v = inst.attributes(i);
+            for (typename attributes_type::const_iterator it = v.begin();it != v.end();++it) {
+                if (fgen.forward(it->first, i, f)) {
+                    op((int)f, i, it->second);
+                }
+            }
+        }
+
+        const attributes_type* shared = shared_attributes(inst);
+        if (shared != NULL) {
+            for (typename attributes_type::const_iterator it = shared->begin();it != shared->end();++it) {
+                if (fgen.forward(it->first, 0, f)) {
+                    op((int)f, -1, it->second);
+                }
+            }
+        }
+    }
+
+    /**
+     * Visits the features of a multi-class instance with a sparse feature
+     * generator; only the labels in the posting list of every attribute are
+     * visited.
+     *  @param  fgen        The feature generator.
+     *  @param  inst        The instance.
+     *  @param  L           The number of labels.
+     *  @param  op          The function object.
+     */
+    template <class A, class Lb, class F, class T, class W, class G, class op_type>
+    static inline void for_each_feature(
+        const sparse_feature_generator_base<A, Lb, F>& fgen,
+        const multi_instance_base<T, W, G>& inst,
+        int L,
+        op_type& op
+        )
+    {
+        typedef sparse_feature_generator_base<A, Lb, F> fgen_type;
+        posting_op<op_type, fgen_type> p;
+        p.op = &op;
+        p.L = L;
+        for (typename T::const_iterator it = inst.begin();it != inst.end();++it) {
+            p.value = it->second;
+            fgen.postings(it->first, p);
+        }
+    }
+
+    /**
+     * Computes the smoothness constant of the loss of an instance (without
+     * the weight) from the squared norms of the features of the candidates.
+     *  @param  inst        The instance.
+     *  @param  L           The number of labels.
+     *  @return value_type  The largest squared norm of the features of a
+     *                      candidate.
+     */
+    template <class inst_type>
+    static value_type smoothness(const inst_type& inst, int L)
+    {
+        value_type norm2 = 0., shared = 0.;
+        for (int i = 0;i < inst.num_candidates(L);++i) {
+            const attributes_type& v = inst.attributes(i);
+            value_type s = 0.;
+            for (typename attributes_type::const_iterator it = v.begin();it != v.end();++it) {
+                s += it->second * it->second;
+            }
+            norm2 = std::max(norm2, s);
+        }
+        const attributes_type* sa = shared_attributes(inst);
+        if (sa != NULL) {
+            for (typename attributes_type::const_iterator it = sa->begin();it != sa->end();++it) {
+                shared += it->second * it->second;
+            }
+        }
+        return norm2 + shared;
+    }
+
+    /**
+     * Computes the smoothness constant of the loss of a multi-class
+     * instance (without the weight), |x|^2 / 2.
+     *  @param  inst        The instance.
+     *  @param  L           The number of labels.
+     *  @return value_type  The smoothness constant.
+     */
+    template <class T, class W, class G>
+    static value_type smoothness(const multi_instance_base<T, W, G>& inst, int L)
+    {
+        value_type norm2 = 0.;
+        for (typename T::const_iterator it = inst.begin();it != inst.end();++it) {
+            norm2 += it->second * it->second;
+        }
+        return norm2 / 2.;
+    }
+};
+
+};
+
+};
+
+#endif/*__CLASSIAS_TRAIN_SVRG_H__*/
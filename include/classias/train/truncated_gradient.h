@@ -34,8 +34,12 @@
 #define __CLASSIAS_TRAIN_TRUNCATED_GRADIENT_H__
 
 #include <iostream>
+#include <iterator>
+#include <vector>
 
 #include <classias/types.h>
+#include <classias/allreduce.h>
+#include <classias/csr_data.h>
 #include <classias/parameters.h>
 
 namespace classias
@@ -113,6 +117,17 @@ protected:
     /// The total amount of L1 penalty.
     value_type m_sum_penalty;
 
+    /// The weight vector updated by update() (m_w, or that of the master).
+    model_type* m_pw;
+    /// The L1 penalties updated by update() (m_penalty, or that of the master).
+    model_type* m_ppenalty;
+    /// The increment of the update count (the number of workers).
+    int m_stride;
+    /// The update count of the previous update by this worker.
+    int m_tprev;
+    /// The errors of the instances (and candidates) in a minibatch.
+    std::vector<value_type> m_errors;
+
     /// Parameter interface.
     parameter_exchange m_params;
     /// The coefficient for L2 regularization.
@@ -125,12 +140,17 @@ protected:
     int m_truncate_period;
     /// The boolean value indicating whether m_w is truncated.
     bool m_truncated;
+    /// The number of instances in a minibatch.
+    int m_batch_size;
+    /// The flag for averaging the gradients in a minibatch.
+    int m_batch_average;
 
 public:
     /**
      * Constructs the object.
      */
-    truncated_gradient_base()
+    truncated_gradient_base() :
+        m_pw(&m_w), m_ppenalty(&m_penalty), m_stride(1), m_tprev(0)
     {
         clear();
     }
@@ -161,6 +181,21 @@ public:
             "Initial learning rate");
         m_params.init("truncate_period", &m_truncate_period, 1,
             "Period for truncate");
+        m_params.init("batch_size", &m_batch_size, 1,
+            "The number of instances whose errors are computed on the same weights\n"
+            "before their gradients are applied in a merged update (minibatch).");
+        m_params.init("batch_average", &m_batch_average, 0,
+            "Apply the average of the gradients in a minibatch as an update (1),\n"
+            "instead of the sum of them as the updates of the instances (0).");
+    }
+
+    /**
+     * Returns the number of instances in a minibatch.
+     *  @return int         The number of instances in a minibatch.
+     */
+    int batch_size() const
+    {
+        return m_batch_size;
     }
 
     /**
@@ -223,6 +258,113 @@ public:
         m_loss = 0;
     }
 
+    /**
+     * Sets the weights from which the training starts.
+     *  This function must be called after start(); the L1 penalties are
+     *  applied to the given weights from the current total penalty.
+     *  @param  w           The initial weights.
+     */
+    void set_weights(const model_type& w)
+    {
+        this->apply_penalty();
+        for (size_t i = 0;i < m_w.size() && i < w.size();++i) {
+            m_w[i] = w[i];
+            m_penalty[i] = m_sum_penalty;
+        }
+    }
+
+    /**
+     * Mixes the weight vectors of the ranks of distributed training.
+     *  This function replaces the weights of every rank with the weighted
+     *  average of them over the ranks (iterative parameter mixing), and
+     *  sums the losses of the epoch over the ranks. The L1 penalties
+     *  accumulated so far are applied before the mixing so that the mixed
+     *  weights start from the current total penalty.
+     *  @param  ar          The collective operation over the ranks.
+     *  @param  weight      The mixing weight of this rank.
+     */
+    void mix(allreduce& ar, value_type weight)
+    {
+        this->apply_penalty();
+
+        const size_t n = m_w.size();
+        std::vector<double> v(n + 2);
+        for (size_t i = 0;i < n;++i) {
+            v[i] = weight * m_w[i];
+        }
+        v[n] = weight;
+        v[n+1] = m_loss;
+        ar.sum(&v[0], n + 2);
+
+        for (size_t i = 0;i < n;++i) {
+            m_w[i] = v[i] / v[n];
+            m_penalty[i] = m_sum_penalty;
+        }
+        m_loss = v[n+1];
+    }
+
+    /**
+     * Prepares this object as a worker of lock-free parallel training.
+     *
+     *  A worker applies updates and L1 penalties directly to the weight
+     *  vector of the master without locks. The update count of a worker
+     *  advances by the number of workers so that the worker #index receives
+     *  the update counts of the instances #index, #index + num_workers, ...
+     *  in the epoch. Every worker accumulates the L1 penalties of all the
+     *  update counts, including those of the other workers.
+     *
+     *  @param  master      The master trainer holding the weight vector.
+     *  @param  index       The index of this worker.
+     *  @param  num_workers The number of workers.
+     */
+    void start_worker(this_class& master, int index, int num_workers)
+    {
+        m_pw = master.m_pw;
+        m_ppenalty = master.m_ppenalty;
+        m_lambda = master.m_lambda;
+        m_eta = master.m_eta;
+        m_t0 = master.m_t0;
+        m_t = master.m_t + index + 1 - num_workers;
+        m_tprev = master.m_t;
+        m_sum_penalty = master.m_sum_penalty;
+        m_truncate_period = master.m_truncate_period;
+        m_truncated = true;
+        m_stride = num_workers;
+        m_batch_size = master.m_batch_size;
+        m_batch_average = master.m_batch_average;
+        m_loss = 0;
+    }
+
+    /**
+     * Merges the states of workers at the end of an epoch.
+     *  @param  first       The iterator pointing to the first worker.
+     *  @param  last        The iterator pointing just beyond the last worker.
+     */
+    template <class iterator_type>
+    void merge_workers(iterator_type first, iterator_type last)
+    {
+        int t = m_t;
+        for (iterator_type it = first;it != last;++it) {
+            const this_class& worker = **it;
+            m_loss += worker.m_loss;
+            if (t < worker.m_t) {
+                t = worker.m_t;
+            }
+        }
+
+        // Accumulate the L1 penalties of the updates (m_t, t].
+        for (int u = m_t + 1;u <= t;++u) {
+            if (u % m_truncate_period == 0) {
+                m_sum_penalty += m_lambda * m_truncate_period * learning_rate(u);
+            }
+        }
+        if (m_t < t) {
+            m_eta = learning_rate(t);
+        }
+        m_t = t;
+        m_truncated = false;
+    }
+
 public:
     /**
      * Shows the copyright information.
@@ -265,9 +407,38 @@ protected:
      */
     inline void accumulate_penalty(int t, value_type eta)
     {
-        if (t % m_truncate_period == 0) {
-            m_sum_penalty += m_lambda * m_truncate_period * eta;
-            m_truncated = false;
+        if (m_stride == 1) {
+            if (t % m_truncate_period == 0) {
+                m_sum_penalty += m_lambda * m_truncate_period * eta;
+                m_truncated = false;
+            }
+        } else {
+            // Accumulate the penalties of the updates by the other workers
+            // since the previous update of this worker as well.
+            for (int u = m_tprev + 1;u <= t;++u) {
+                if (u % m_truncate_period == 0) {
+                    m_sum_penalty += m_lambda * m_truncate_period * learning_rate(u);
+                    m_truncated = false;
+                }
+            }
+            m_tprev = t;
+        }
+    }
+
+    /**
+     * Advances the update count by a minibatch, and accumulates the L1
+     * penalties of the update counts taken by the minibatch.
+     *  The gradients of a minibatch are applied before the penalties so
+     *  that the gradients of the instances sharing a feature do not skip
+     *  the penalties delayed for the feature.
+     *  @param  m           The number of the update counts.
+     */
+    inline void accumulate_batch(int m)
+    {
+        for (int i = 0;i < m;++i) {
+            m_t += m_stride;
+            m_eta = learning_rate(m_t);
+            this->accumulate_penalty(m_t, m_eta);
         }
     }
 
@@ -315,24 +486,26 @@ protected:
      */
     inline void apply_penalty(int i)
     {
-        value_type alpha = m_sum_penalty - m_penalty[i];
+        model_type& w = *m_pw;
+        model_type& penalty = *m_ppenalty;
+        value_type alpha = m_sum_penalty - penalty[i];
         if (0 < alpha) {
-            if (0 < m_w[i]) {
-                m_w[i] -= alpha;
-                if (m_w[i] < 0) {
-                    m_w[i] = 0;
-                    m_penalty[i] = 0;
+            if (0 < w[i]) {
+                w[i] -= alpha;
+                if (w[i] < 0) {
+                    w[i] = 0;
+                    penalty[i] = 0;
                     return;
                 }
-            } else if (m_w[i] < 0) {
-                m_w[i] += alpha;
-                if (0 < m_w[i]) {
-                    m_w[i] = 0;
-                    m_penalty[i] = 0;
+            } else if (w[i] < 0) {
+                w[i] += alpha;
+                if (0 < w[i]) {
+                    w[i] = 0;
+                    penalty[i] = 0;
                     return;
                 }
             }
-            m_penalty[i] = m_sum_penalty;
+            penalty[i] = m_sum_penalty;
         }
     }
 
@@ -368,6 +541,35 @@ public:
         return const_cast<this_class*>(this)->model();
     }
 
+    /**
+     * Returns the memory used by the training algorithm.
+     *  @return size_t      The approximate number of bytes.
+     */
+    size_t memory_usage() const
+    {
+        return
+            (m_w.size() + m_penalty.size()) * sizeof(value_type) +
+            classias::memory_usage(m_errors);
+    }
+
+    /**
+     * Stores or restores the state of the training process.
+     *  @param  ar          The archive (checkpoint_writer or
+     *                      checkpoint_reader).
+     */
+    template <class archive_type>
+    void serialize(archive_type& ar)
+    {
+        ar.vector(m_w);
+        ar.vector(m_penalty);
+        ar.value(m_eta);
+        ar.value(m_t);
+        ar.value(m_loss);
+        ar.value(m_sum_penalty);
+        ar.value(m_tprev);
+        ar.value(m_truncated);
+    }
+
     value_type loss() const
     {
         return m_report.loss;
@@ -409,13 +611,14 @@ public:
     void update(iterator_type it)
     {
         // Synonyms to avoid "this->" for member variables in the base class.
-        model_type& w = this->m_w;
+        model_type& w = *this->m_pw;
         value_type& eta = this->m_eta;
         int& t = this->m_t;
         value_type& loss = this->m_loss;
 
         // Compute the learning rate for the current update.
-        eta = this->learning_rate(++t);
+        t += this->m_stride;
+        eta = this->learning_rate(t);
 
         // Delay application of L1 penalties to the feature weights that
         // are relevant to the current instance.
@@ -451,6 +654,62 @@ public:
         }
     }
 
+    /**
+     * Receives a minibatch of training instances and updates feature
+     * weights.
+     *  This function applies the delayed L1 penalties to the features of
+     *  all instances, computes the errors of the instances with these
+     *  weights, applies the gradients, and then accumulates the L1
+     *  penalties of the update counts taken by the minibatch.
+     *  @param  first       The iterator pointing to the first iterator of
+     *                      the instances.
+     *  @param  last        The iterator pointing just beyond the last
+     *                      iterator of the instances.
+     */
+    template <class iterator_type>
+    void update_batch(iterator_type first, iterator_type last)
+    {
+        model_type& w = *this->m_pw;
+        std::vector<value_type>& errors = this->m_errors;
+        const int n = (int)std::distance(first, last);
+        if (n == 0) {
+            return;
+        }
+
+        // Delay application of L1 penalties to the feature weights that
+        // are relevant to the instances.
+        for (iterator_type it = first;it != last;++it) {
+            this->apply_penalty((*it)->begin(), (*it)->end());
+        }
+
+        // Compute the errors for the instances with the current weights.
+        errors.resize(n);
+        iterator_type it = first;
+        for (int i = 0;i < n;++i, ++it) {
+            error_type cls(w);
+            cls.inner_product((*it)->begin(), (*it)->end());
+            value_type nlogp = 0.;
+            errors[i] = cls.error((*it)->get_label(), nlogp);
+            this->m_loss += ((*it)->get_weight() * nlogp);
+        }
+
+        // Update the feature weights with the learning rates of the update
+        // counts of the instances (or of one count for the average).
+        const int m = this->m_batch_average ? 1 : n;
+        const value_type scale = this->m_batch_average ? 1. / n : 1.;
+        it = first;
+        for (int i = 0;i < n;++i, ++it) {
+            int u = this->m_t + (i % m + 1) * this->m_stride;
+            value_type gain = this->learning_rate(u) * scale;
+            this->update_weights(
+                (*it)->begin(), (*it)->end(),
+                -errors[i] * gain * (*it)->get_weight());
+        }
+
+        // Accumulate the L1 penalties of the update counts.
+        this->accumulate_batch(m);
+    }
+
 protected:
     /**
      * Adds a value to weights associated with a feature vector.
@@ -464,8 +723,45 @@ protected:
     inline void update_weights(iterator_type first, iterator_type last, value_type delta)
     {
         for (iterator_type it = first;it != last;++it) {
-            this->m_w[it->first] += delta * it->second;
-            this->m_penalty[it->first] = this->m_sum_penalty;
+            (*this->m_pw)[it->first] += delta * it->second;
+            (*this->m_ppenalty)[it->first] = this->m_sum_penalty;
+        }
+    }
+
+    /**
+     * Adds a value to weights associated with a feature vector in CSR
+     * layout, skipping the multiplication for implicit values and decoding
+     * compressed identifiers by blocks.
+     *  @param  first       The iterator pointing to the first element of
+     *                      the feature vector.
+     *  @param  last        The iterator pointing just beyond the last
+     *                      element of the feature vector.
+     *  @param  delta       The value to be added to the weights.
+     */
+    inline void update_weights(csr_element_iterator first, csr_element_iterator last, value_type delta)
+    {
+        if (first.compressed()) {
+            int ids[csr_element_iterator::block_size];
+            while (first != last) {
+                const float* v = first.fvalue_data();
+                const int step = first.step();
+                const int n = first.decode(last, ids);
+                for (int i = 0;i < n;++i) {
+                    (*this->m_pw)[ids[i]] += delta * v[i * step];
+                    (*this->m_ppenalty)[ids[i]] = this->m_sum_penalty;
+                }
+            }
+            return;
+        }
+
+        if (!first.implicit_values()) {
+            this->template update_weights<csr_element_iterator>(first, last, delta);
+            return;
+        }
+
+        for (const int* p = first.id_data();p != last.id_data();++p) {
+            (*this->m_pw)[*p] += delta;
+            (*this->m_ppenalty)[*p] = this->m_sum_penalty;
         }
     }
 
@@ -524,13 +820,14 @@ public:
         const int L = (int)fgen.num_labels();
 
         // Synonyms to avoid "this->" for member variables in the base class.
-        model_type& w = this->m_w;
+        model_type& w = *this->m_pw;
         value_type& eta = this->m_eta;
         int& t = this->m_t;
         value_type& loss = this->m_loss;
 
         // Compute the learning rate for the current update.
-        eta = this->learning_rate(++t);
+        t += this->m_stride;
+        eta = this->learning_rate(t);
 
         // Delay application of L1 penalties to the feature weights that
         // are relevant to the current instance.
@@ -542,19 +839,11 @@ public:
                 it->attributes(i).end()
                 );
         }
+        this->apply_penalty_shared(fgen, *it);
 
         // Compute the scores for the labels (candidates) in the instance.
         error_type cls(w);
-        cls.resize(it->num_candidates(L));
-        for (int i = 0;i < it->num_candidates(L);++i) {
-            cls.inner_product(
-                i,
-                fgen,
-                it->attributes(i).begin(),
-                it->attributes(i).end(),
-                i
-                );
-        }
+        cls.inner_product_instance(fgen, *it, L);
         cls.finalize();
 
         // Compute the loss for the instance.
@@ -562,9 +851,11 @@ public:
 
         // Updates the feature weights.
         value_type gain = eta * it->get_weight();
+        value_type sum = 0.;
         for (int i = 0;i < it->num_candidates(L);++i) {
             // Computes the error for the label (candidate).
             value_type err = cls.error(i, it->get_label());
+            sum += err;
 
             // Update the feature weights.
             update_weights(
@@ -576,6 +867,10 @@ public:
                 );
         }
 
+        // Update the weights of the shared attributes once with the sum of
+        // the errors of the candidates.
+        this->update_weights_shared(fgen, *it, -sum * gain);
+
         // Accumulate the L1 penalty that should be applied in this update.
         this->accumulate_penalty(t, eta);
     }
@@ -595,6 +890,87 @@ public:
         }
     }
 
+    /**
+     * Receives a minibatch of training instances and updates feature
+     * weights.
+     *  This function applies the delayed L1 penalties to the features of
+     *  all instances, computes the errors of the candidates with these
+     *  weights, applies the gradients, and then accumulates the L1
+     *  penalties of the update counts taken by the minibatch.
+     *  @param  first       The iterator pointing to the first iterator of
+     *                      the instances.
+     *  @param  last        The iterator pointing just beyond the last
+     *                      iterator of the instances.
+     *  @param  fgen        The feature generator.
+     */
+    template <class iterator_type, class feature_generator_type>
+    void update_batch(
+        iterator_type first,
+        iterator_type last,
+        feature_generator_type& fgen
+        )
+    {
+        const int L = (int)fgen.num_labels();
+        model_type& w = *this->m_pw;
+        std::vector<value_type>& errors = this->m_errors;
+        const int n = (int)std::distance(first, last);
+        if (n == 0) {
+            return;
+        }
+
+        // Delay application of L1 penalties to the feature weights that
+        // are relevant to the instances.
+        for (iterator_type it = first;it != last;++it) {
+            for (int i = 0;i < (*it)->num_candidates(L);++i) {
+                this->apply_penalty(
+                    i,
+                    fgen,
+                    (*it)->attributes(i).begin(),
+                    (*it)->attributes(i).end()
+                    );
+            }
+            this->apply_penalty_shared(fgen, **it);
+        }
+
+        // Compute the errors for the candidates with the current weights.
+        errors.clear();
+        error_type cls(w);
+        for (iterator_type it = first;it != last;++it) {
+            cls.inner_product_instance(fgen, **it, L);
+            cls.finalize();
+            this->m_loss += -(*it)->get_weight() * cls.logprob((*it)->get_label());
+            for (int i = 0;i < (*it)->num_candidates(L);++i) {
+                errors.push_back(cls.error(i, (*it)->get_label()));
+            }
+        }
+
+        // Update the feature weights with the learning rates of the update
+        // counts of the instances (or of one count for the average).
+        const int m = this->m_batch_average ? 1 : n;
+        const value_type scale = this->m_batch_average ? 1. / n : 1.;
+        size_t k = 0;
+        int j = 0;
+        for (iterator_type it = first;it != last;++it, ++j) {
+            int u = this->m_t + (j % m + 1) * this->m_stride;
+            value_type gain = this->learning_rate(u) * scale * (*it)->get_weight();
+            value_type sum = 0.;
+            for (int i = 0;i < (*it)->num_candidates(L);++i) {
+                sum += errors[k];
+                update_weights(
+                    i,
+                    fgen,
+                    (*it)->attributes(i).begin(),
+                    (*it)->attributes(i).end(),
+                    -errors[k++] * gain
+                    );
+            }
+            this->update_weights_shared(fgen, **it, -sum * gain);
+        }
+
+        // Accumulate the L1 penalties of the update counts.
+        this->accumulate_batch(m);
+    }
+
 protected:
     /**
      * Adds a value to weights associated with a feature vector.
@@ -618,8 +994,8 @@ protected:
         for (iterator_type it = first;it != last;++it) {
             typename feature_generator_type::feature_type f;
             if (fgen.forward(it->first, l, f)) {
-                this->m_w[f] += delta * it->second;
-                this->m_penalty[f] = this->m_sum_penalty;
+                (*this->m_pw)[f] += delta * it->second;
+                (*this->m_ppenalty)[f] = this->m_sum_penalty;
             }
         }
     }
@@ -649,6 +1025,46 @@ protected:
             }
         }
     }
+
+    /**
+     * Adds a value to weights associated with the attributes shared by the
+     * candidates of an instance.
+     *  @param  fgen        The feature generator.
+     *  @param  inst        The instance.
+     *  @param  delta       The value to be added to the weights.
+     */
+    template <class feature_generator_type, class instance_type>
+    inline void update_weights_shared(
+        feature_generator_type& fgen,
+        const instance_type& inst,
+        value_type delta
+        )
+    {
+        typedef typename instance_type::attributes_type attributes_type;
+        const attributes_type* shared = shared_attributes(inst);
+        if (shared != NULL) {
+            update_weights(0, fgen, shared->begin(), shared->end(), delta);
+        }
+    }
+
+    /**
+     * Applies L1 penalties to the weights of the attributes shared by the
+     * candidates of an instance.
+     *  @param  fgen        The feature generator.
+     *  @param  inst        The instance.
+     */
+    template <class feature_generator_type, class instance_type>
+    inline void apply_penalty_shared(
+        feature_generator_type& fgen,
+        const instance_type& inst
+        )
+    {
+        typedef typename instance_type::attributes_type attributes_type;
+        const attributes_type* shared = shared_attributes(inst);
+        if (shared != NULL) {
+            this->apply_penalty(0, fgen, shared->begin(), shared->end());
+        }
+    }
 };
 
 };
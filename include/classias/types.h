@@ -331,6 +331,15 @@ public:
         return cont.size();
     }
 
+    /**
+     * Returns the memory used by the elements of the vector.
+     *  @retval std::size_t The number of bytes allocated for the elements.
+     */
+    inline std::size_t memory_usage() const
+    {
+        return cont.capacity() * sizeof(element_type);
+    }
+
     /**
      * Returns a random-access iterator to the first element.
      *  @retval iterator    A random-access iterator (for read/write)